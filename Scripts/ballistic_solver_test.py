@@ -0,0 +1,133 @@
+# Host accuracy test of the ballistic solver (components/algorithm/ballistic_solver.c).
+# Reference: the same drag law, dv/dt = -g - k |v| v, integrated in time with classical Runge-Kutta at a small step,
+# the crossing of the target distance interpolated. The solver's pitch is fired on the reference and the height at the
+# target distance compared with the target.
+# Checks, over random speeds, distances, elevations and drag coefficients:
+#   - every solved shot hits within a couple of mm, with the time of flight within a fraction of a ms
+#   - a target reported out of reach is out of reach of the reference at every pitch
+#   - trajectories per solve stay few, they are the cost on the M4F
+#   - without drag the same shots miss by cm, so the drag term matters
+# ballistic_solver.c is built by firmware_host.py. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(["components/algorithm/ballistic_solver.c"], headers=["ballistic_solver.h"],
+                    structs={"ballistic_solution_t": {"pitch": ctypes.c_float, "time": ctypes.c_float,
+                                                      "iterations": ctypes.c_uint8}},
+                    constants=["BALLISTIC_SOLVER_GRAVITY", "BALLISTIC_SOLVER_DRAG_17MM"])
+
+REFERENCE_STEP = 2e-4  # s
+
+
+def solve(distance, height, speed, drag):
+    """ballistic_solve(), returns (solved, pitch, time, trajectories)"""
+    solution = FIRMWARE.new("ballistic_solution_t")
+    solved = FIRMWARE.ballistic_solve(distance, height, speed, drag, solution)
+    return bool(solved), solution.pitch, solution.time, solution.iterations
+
+
+def reference(speed, pitch, distance, drag, dt=REFERENCE_STEP):
+    """height and time at the target distance, None if the projectile never gets there"""
+    g = FIRMWARE.BALLISTIC_SOLVER_GRAVITY
+
+    def derivative(s):
+        _, _, vx, vy = s
+        v = math.hypot(vx, vy)
+        return (vx, vy, -drag * v * vx, -g - drag * v * vy)
+
+    s, t = (0.0, 0.0, speed * math.cos(pitch), speed * math.sin(pitch)), 0.0
+    while t < 5.0:
+        k1 = derivative(s)
+        k2 = derivative(tuple(s[i] + 0.5 * dt * k1[i] for i in range(4)))
+        k3 = derivative(tuple(s[i] + 0.5 * dt * k2[i] for i in range(4)))
+        k4 = derivative(tuple(s[i] + dt * k3[i] for i in range(4)))
+        n = tuple(s[i] + dt / 6.0 * (k1[i] + 2.0 * k2[i] + 2.0 * k3[i] + k4[i]) for i in range(4))
+        if n[0] >= distance:
+            # cubic Hermite in x for the height, the path is smooth over one step
+            fraction = (distance - s[0]) / (n[0] - s[0])
+            return s[1] + fraction * (n[1] - s[1]) + hermite_correction(s, n, fraction), t + fraction * dt
+        s, t = n, t + dt
+    return None
+
+
+def hermite_correction(s, n, f):
+    """cubic Hermite minus linear interpolation of y over x, from the slopes at both ends"""
+    dx = n[0] - s[0]
+    m0, m1 = s[3] / s[2] * dx, n[3] / n[2] * dx
+    dy = n[1] - s[1]
+    h10, h01, h11 = f ** 3 - 2 * f ** 2 + f, -2 * f ** 3 + 3 * f ** 2, f ** 3 - f ** 2
+    return h10 * m0 + h01 * dy + h11 * m1 - f * dy
+
+
+def reachable(distance, height, speed, drag):
+    """whether the reference gets up to the height at the distance at any pitch of a scan"""
+    best = -1e9
+    for degrees in range(-60, 80, 2):
+        result = reference(speed, math.radians(degrees), distance, drag, dt=1e-3)
+        if result is not None:
+            best = max(best, result[0])
+    return best >= height
+
+
+def test_accuracy(report, seed, cases):
+    rng = random.Random(seed)
+    worst_height, worst_time, no_drag_miss = 0.0, 0.0, 0.0
+    trajectories, unsolved, wrongly_unsolved = [], 0, 0
+    for _ in range(cases):
+        speed = rng.uniform(10.0, 30.0)
+        line_of_sight = rng.uniform(0.5, 15.0)
+        elevation = rng.uniform(-0.8, 0.8)
+        drag = FIRMWARE.BALLISTIC_SOLVER_DRAG_17MM * rng.uniform(0.5, 1.5)
+        distance, height = line_of_sight * math.cos(elevation), line_of_sight * math.sin(elevation)
+        solved, pitch, time, iterations = solve(distance, height, speed, drag)
+        if not solved:
+            unsolved += 1
+            wrongly_unsolved += 1 if reachable(distance, height, speed, drag) else 0
+            continue
+        trajectories.append(iterations)
+        hit_height, hit_time = reference(speed, pitch, distance, drag)
+        worst_height = max(worst_height, abs(hit_height - height))
+        worst_time = max(worst_time, abs(hit_time - time))
+        no_drag_pitch = solve(distance, height, speed, 0.0)[1]
+        no_drag_hit = reference(speed, no_drag_pitch, distance, drag)
+        if no_drag_hit is not None:
+            no_drag_miss = max(no_drag_miss, abs(no_drag_hit[0] - height))
+    report.check("solved shots hit the target", worst_height < 0.002 and worst_time < 0.0005,
+                 "%d solved, worst height %.2f mm, worst time of flight %.3f ms"
+                 % (len(trajectories), worst_height * 1000.0, worst_time * 1000.0))
+    report.check("out of reach only when it is", wrongly_unsolved == 0, "%d not solved, %d of them reachable" % (unsolved, wrongly_unsolved))
+    # near the edge of reach the height error flattens out and the secant takes longer
+    trajectories.sort()
+    percentile = trajectories[int(0.95 * (len(trajectories) - 1))]
+    mean = sum(trajectories) / len(trajectories)
+    report.check("few trajectories per solve", percentile <= 5 and mean <= 4.0,
+                 "mean %.2f, 95%% within %d, max %d" % (mean, percentile, trajectories[-1]))
+    report.check("drag matters", no_drag_miss > 0.05, "the same shots solved without drag miss by up to %.0f mm" % (no_drag_miss * 1000.0))
+
+
+def test_bad_input(report):
+    cases = [(0.0, 1.0, 25.0), (-1.0, 0.0, 25.0), (5.0, 0.0, 0.0), (float("nan"), 0.0, 25.0), (5.0, 0.0, float("nan")),
+             (12.0, 6.0, 10.0)]
+    solved = [solve(d, h, v, FIRMWARE.BALLISTIC_SOLVER_DRAG_17MM)[0] for d, h, v in cases]
+    report.check("bad input and out of reach not solved", not any(solved), "%s" % solved)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the ballistic solver against a fine numerical integration")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--cases", type=int, default=200)
+    args = parser.parse_args()
+    report = Report()
+    test_accuracy(report, args.seed, args.cases)
+    test_bad_input(report)
+    if not report.ok:
+        raise SystemExit("ballistic solver test failed")
+
+
+if __name__ == "__main__":
+    main()
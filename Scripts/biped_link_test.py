@@ -0,0 +1,242 @@
+# Host test of the multi-frame biped CAN link (application/biped_link.c): encode/decode round trip and loss detection.
+# Checks:
+#   - field layout: every field in one frame, frames don't overlap and fit the 56 payload bits
+#   - round trip of random leg states within half a level of every field
+#   - values beyond the limits saturate instead of wrapping
+#   - header: frame index and sequence survive, sequence wraps at 64
+#   - a stream with dropped frames: only complete sets are published, never fields of two sets mixed, lost and
+#     broken set counters match what was dropped
+#   - decode_biped_chassis_feedback hands complete sets to chassis_platform
+# biped_link.c and, for the last check, CAN_receive.c of a biped build with BIPED_LINK_MULTI_FRAME are built by
+# firmware_host.py. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import random
+
+from firmware_host import Firmware, Report
+
+LEG_STATE = {"yaw": ctypes.c_float, "roll": ctypes.c_float, "pitch": ctypes.c_float, "L0": ctypes.c_float}
+LINK = {"state": ctypes.c_uint8, "staging": ctypes.c_uint8, "seq": ctypes.c_uint8, "rx_mask": ctypes.c_uint8,
+        "fSynced": ctypes.c_uint8, "complete_sets": ctypes.c_uint32, "lost_sets": ctypes.c_uint32,
+        "broken_sets": ctypes.c_uint32, "bad_frames": ctypes.c_uint32}
+CONSTANTS = ["BIPED_LINK_FRAME_NUM", "BIPED_LINK_SEQ_MASK", "BIPED_LINK_PAYLOAD_BITS", "BIPED_RAD_ECD_MAX_LIMIT",
+             "BIPED_TILT_RAD_ECD_MAX_LIMIT", "BIPED_METER_ECD_MAX_LIMIT", "BIPED_LEG_LEFT", "BIPED_LEG_RIGHT"]
+FIRMWARE = Firmware(["application/biped_link.c"], headers=["biped_link.h"],
+                    structs={"biped_leg_state_t": LEG_STATE, "biped_link_t": LINK}, constants=CONSTANTS)
+CHASSIS_FIRMWARE = Firmware(["application/CAN_receive.c", "application/chassis_task.c", "application/biped_link.c",
+                             "application/detect_task.c"],
+                            headers=["biped_link.h", "chassis_task.h"],
+                            structs={"chassis_move_t": {"chassis_platform": ctypes.c_uint8},
+                                     "chassis_platform_t": {"feedback_yaw": ctypes.c_float, "feedback_roll": ctypes.c_float,
+                                                            "feedback_pitch": ctypes.c_float, "feedback_simplified_L0": ctypes.c_float},
+                                     "biped_leg_state_t": LEG_STATE, "biped_link_t": LINK},
+                            config={"ROBOT_TYPE": "INFANTRY_2024_BIPED", "BIPED_LINK_MULTI_FRAME": 1},
+                            prototypes={"decode_biped_chassis_feedback": (ctypes.c_uint8, [ctypes.c_char_p])})
+
+FRAME_NUM = int(FIRMWARE.BIPED_LINK_FRAME_NUM)
+SEQ_MASK = int(FIRMWARE.BIPED_LINK_SEQ_MASK)
+PAYLOAD_BITS = int(FIRMWARE.BIPED_LINK_PAYLOAD_BITS)
+LEFT = int(FIRMWARE.BIPED_LEG_LEFT)
+RIGHT = int(FIRMWARE.BIPED_LEG_RIGHT)
+# field: (biped_leg_state_t member, index, limit)
+FIELDS = {
+    "yaw": ("yaw", None, FIRMWARE.BIPED_RAD_ECD_MAX_LIMIT),
+    "roll": ("roll", None, FIRMWARE.BIPED_TILT_RAD_ECD_MAX_LIMIT),
+    "pitch": ("pitch", None, FIRMWARE.BIPED_TILT_RAD_ECD_MAX_LIMIT),
+    "L0_left": ("L0", LEFT, FIRMWARE.BIPED_METER_ECD_MAX_LIMIT),
+    "L0_right": ("L0", RIGHT, FIRMWARE.BIPED_METER_ECD_MAX_LIMIT),
+}
+
+
+def leg_state(fw, values):
+    state = fw.new("biped_leg_state_t")
+    for name, value in values.items():
+        member, index, _ = FIELDS[name]
+        if index is None:
+            setattr(state, member, value)
+        else:
+            legs = getattr(state, member)
+            legs[index] = value
+            setattr(state, member, legs)
+    return state
+
+
+def read_state(state):
+    values = {}
+    for name, (member, index, _) in FIELDS.items():
+        values[name] = getattr(state, member) if index is None else getattr(state, member)[index]
+    return values
+
+
+def pack(values, frame_index, seq, fw=FIRMWARE):
+    data = (ctypes.c_uint8 * 8)()
+    fw.biped_link_pack(leg_state(fw, values), frame_index, seq, data)
+    return bytes(data)
+
+
+def encode_set(values, seq, fw=FIRMWARE):
+    return [pack(values, frame, seq, fw) for frame in range(FRAME_NUM)]
+
+
+def decode_set(frames):
+    state = FIRMWARE.new("biped_leg_state_t")
+    for data in frames:
+        FIRMWARE.biped_link_unpack(data, state)
+    return read_state(state)
+
+
+def field_layout():
+    """frame and payload bit mask of every field, from what biped_link_pack sets at -limit and +limit"""
+    layout = {}
+    for name, (_, _, limit) in FIELDS.items():
+        layout[name] = []
+        for frame in range(FRAME_NUM):
+            mask = 0
+            for value in (-limit, limit):
+                values = {other: 0.0 for other in FIELDS}
+                values[name] = value
+                mask |= int.from_bytes(pack(values, frame, 0)[1:], "little")
+            if mask:
+                layout[name].append((frame, mask))
+    return layout
+
+
+LAYOUT = field_layout()
+
+
+def level(name):
+    """unit per level of a field, from its width"""
+    bits = bin(LAYOUT[name][0][1]).count("1")
+    return FIELDS[name][2] / (1 << (bits - 1))
+
+
+def random_state(rng, margin=1.0):
+    return {name: rng.uniform(-limit, limit) * margin for name, (_, _, limit) in FIELDS.items()}
+
+
+def test_layout(report):
+    passed = all(len(frames) == 1 for frames in LAYOUT.values())
+    used = [0] * FRAME_NUM
+    for frames in LAYOUT.values():
+        for frame, mask in frames:
+            passed &= (used[frame] & mask) == 0 and mask < (1 << PAYLOAD_BITS)
+            used[frame] |= mask
+    report.check("field layout fits the payload", passed,
+                 ", ".join("%s frame %d %d bits" % (name, frames[0][0], bin(frames[0][1]).count("1")) for name, frames in LAYOUT.items()))
+
+
+def test_round_trip(report, rng):
+    worst = {name: 0.0 for name in FIELDS}
+    for _ in range(2000):
+        # the top level saturates one level short of +limit
+        state = random_state(rng, 0.999)
+        decoded = decode_set(encode_set(state, rng.randrange(64)))
+        for name in FIELDS:
+            worst[name] = max(worst[name], abs(decoded[name] - state[name]) / level(name))
+    # half a level, with float rounding of value * ratio
+    passed = all(w <= 0.5 + 1e-3 for w in worst.values())
+    report.check("round trip within half a level", passed, "worst %.3f level (%s)" % (max(worst.values()), max(worst, key=worst.get)))
+
+
+def test_saturation(report, rng):
+    passed = True
+    for _ in range(500):
+        state = random_state(rng, 3.0)
+        decoded = decode_set(encode_set(state, 0))
+        for name, (_, _, limit) in FIELDS.items():
+            expected = max(-limit, min(limit - level(name), state[name]))
+            passed &= abs(decoded[name] - expected) <= 0.5 * level(name) + 1e-6
+    report.check("out of range values saturate", passed)
+
+
+def test_header(report, rng):
+    passed = True
+    for seq in range(200):
+        for frame, data in enumerate(encode_set(random_state(rng), seq)):
+            state = FIRMWARE.new("biped_leg_state_t")
+            passed &= len(data) == 8 and FIRMWARE.biped_link_unpack(data, state) == frame and (data[0] >> 2) == seq % 64
+    report.check("header frame index and sequence", passed)
+
+
+def run_stream(rng, sets, drop_probability, duplicate_probability):
+    # sets sent at 1 kHz, each frame dropped independently, sometimes one sent twice
+    # returns the link, ground truth complete / lost / broken counts and the number of wrongly published sets
+    link = FIRMWARE.new("biped_link_t")
+    published = FIRMWARE.view("biped_leg_state_t", link.field_address("state"))
+    frames_received = []
+    mixed = 0
+    for n in range(sets):
+        seq = n & SEQ_MASK
+        frames = encode_set(random_state(rng), seq)
+        expected = decode_set(frames)
+        if rng.random() < duplicate_probability:
+            frames.append(frames[rng.randrange(FRAME_NUM)])
+        delivered = [data for data in frames if rng.random() >= drop_probability]
+        frames_received.append(len(set(data[0] & 0x03 for data in delivered)))
+        for data in delivered:
+            if FIRMWARE.biped_link_receive(link, data) and read_state(published) != expected:
+                mixed += 1
+    # the link judges a set when a later one shows up: sets before the first and after the last received frame are
+    # invisible, and so is whether the last one was broken
+    seen = [n for n, count in enumerate(frames_received) if count]
+    judged = frames_received[seen[0]:seen[-1]]
+    complete = sum(1 for count in frames_received if count == FRAME_NUM)
+    lost = sum(1 for count in judged if count == 0)
+    broken = sum(1 for count in judged if 0 < count < FRAME_NUM)
+    return link, complete, lost, broken, mixed
+
+
+def test_stream(report, rng):
+    passed = True
+    details = []
+    for drop in (0.0, 0.01, 0.1, 0.3):
+        link, complete, lost, broken, mixed = run_stream(rng, 5000, drop, 0.02)
+        ok = link.complete_sets == complete and link.lost_sets == lost and link.broken_sets == broken and mixed == 0
+        passed &= ok
+        details.append("drop %.2f: %d complete, %d/%d lost, %d/%d broken" % (drop, link.complete_sets, link.lost_sets, lost, link.broken_sets, broken))
+    report.check("loss detection on a lossy stream", passed, "; ".join(details))
+
+    link = FIRMWARE.new("biped_link_t")
+    FIRMWARE.biped_link_receive(link, bytes([0x03]) + bytes(7))
+    report.check("invalid frame index rejected", link.bad_frames == 1 and link.fSynced == 0)
+
+
+def test_chassis_feedback(report, rng):
+    fw = CHASSIS_FIRMWARE
+    chassis = fw.global_struct("chassis_move_t", "chassis_move")
+    platform = fw.view("chassis_platform_t", chassis.field_address("chassis_platform"))
+    first = random_state(rng, 0.9)
+    second = random_state(rng, 0.9)
+    frames = encode_set(first, 0, fw)
+    partial = [fw.decode_biped_chassis_feedback(data) for data in frames[:-1]]
+    untouched = platform.feedback_yaw == 0.0
+    complete = fw.decode_biped_chassis_feedback(frames[-1])
+    # the next set loses its last frame and is never handed over
+    for data in encode_set(second, 1, fw)[:-1]:
+        fw.decode_biped_chassis_feedback(data)
+    fed = {"feedback_yaw": first["yaw"], "feedback_roll": first["roll"], "feedback_pitch": first["pitch"],
+           "feedback_simplified_L0": 0.5 * (first["L0_left"] + first["L0_right"])}
+    error = max(abs(getattr(platform, name) - value) for name, value in fed.items())
+    report.check("chassis platform fed complete sets only", not any(partial) and untouched and complete and error < 1e-4,
+                 "worst error %.1e" % error)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the multi-frame biped CAN link")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    report = Report()
+    test_layout(report)
+    test_round_trip(report, rng)
+    test_saturation(report, rng)
+    test_header(report, rng)
+    test_stream(report, rng)
+    test_chassis_feedback(report, rng)
+    if not report.ok:
+        raise SystemExit("biped link check failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,189 @@
+# Host test of the biquad filter cascade (components/algorithm/biquad_filter.c) and of the spectrum analyzer
+# (components/algorithm/spectrum_analyzer.c) used to find the gimbal resonances it is tuned on. Both are built from the
+# firmware sources by firmware_host.py and run at the gimbal loop rate of gimbal_task.h.
+# Filter checks:
+#   - notch: no gain at its frequency, unity DC gain, -3dB bandwidth freq / Q
+#   - low-pass: unity DC gain, -3dB at its cutoff for Q = 0.707
+#   - sines run through biquad_filter_calc settle on the gain the designed coefficients give analytically
+#   - biquad_filter_reset on a constant input starts the filter without a transient
+#   - out of range and bypassed stages are left out of the cascade
+# Spectrum checks, sines in noise through spectrum_analyzer_add / spectrum_analyzer_calc:
+#   - the largest peaks are found within 0.05Hz of the tones, amplitude within 2%
+# Exit code is non-zero on failure.
+
+import argparse
+import cmath
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["components/algorithm/biquad_filter.c", "components/algorithm/spectrum_analyzer.c"],
+    headers=["biquad_filter.h", "spectrum_analyzer.h", "gimbal_task.h"],
+    structs={
+        "biquad_stage_config_t": {"type": ctypes.c_int, "freq_hz": ctypes.c_float, "q": ctypes.c_float},
+        "biquad_filter_t": {"stages": ctypes.c_uint8, "coeffs": ctypes.c_float},
+        "spectrum_analyzer_t": {"peak_freq": ctypes.c_float, "peak_amplitude": ctypes.c_float},
+    },
+    constants=["GIMBAL_CONTROL_TIME_S", "BIQUAD_FILTER_MAX_STAGES", "SPECTRUM_FFT_LENGTH", "SPECTRUM_PEAK_COUNT",
+               "BIQUAD_BYPASS", "BIQUAD_LOWPASS", "BIQUAD_NOTCH"])
+SAMPLE_RATE_HZ = 1.0 / FIRMWARE.GIMBAL_CONTROL_TIME_S
+BYPASS, LOWPASS, NOTCH = int(FIRMWARE.BIQUAD_BYPASS), int(FIRMWARE.BIQUAD_LOWPASS), int(FIRMWARE.BIQUAD_NOTCH)
+FFT_LENGTH = int(FIRMWARE.SPECTRUM_FFT_LENGTH)
+
+
+class BiquadFilter:
+    """a biquad_filter_t designed by biquad_filter_init from a table of (type, freq_hz, q)"""
+
+    def __init__(self, table, fs):
+        config = FIRMWARE.new_array("biquad_stage_config_t", [{"type": t, "freq_hz": f, "q": q} for t, f, q in table])
+        self.filter = FIRMWARE.new("biquad_filter_t")
+        self.all_designed = FIRMWARE.biquad_filter_init(self.filter, config, len(table), fs) == 1
+        coeffs = self.filter.coeffs
+        self.coeffs = [coeffs[5 * i:5 * i + 5] for i in range(self.filter.stages)]
+
+    def reset(self, value):
+        FIRMWARE.biquad_filter_reset(self.filter, value)
+
+    def calc(self, x):
+        return FIRMWARE.biquad_filter_calc(self.filter, x)
+
+    def response(self, freq_hz, fs):
+        """frequency response of the designed coefficients, {b0, b1, b2, a1, a2} in the CMSIS sign convention"""
+        z1 = cmath.exp(-2j * math.pi * freq_hz / fs)
+        h = 1.0
+        for c in self.coeffs:
+            h *= (c[0] + c[1] * z1 + c[2] * z1 * z1) / (1.0 - c[3] * z1 - c[4] * z1 * z1)
+        return h
+
+
+def db(h):
+    return 20.0 * math.log10(max(abs(h), 1e-12))
+
+
+def bisect(f, lo, hi):
+    for _ in range(60):
+        mid = 0.5 * (lo + hi)
+        if f(lo) * f(mid) <= 0.0:
+            hi = mid
+        else:
+            lo = mid
+    return 0.5 * (lo + hi)
+
+
+def test_frequency_response(report):
+    fs = SAMPLE_RATE_HZ
+    for f0, q in [(30.0, 2.0), (62.0, 5.0), (95.0, 3.0)]:
+        notch = BiquadFilter([(NOTCH, f0, q)], fs)
+        # the bilinear transform keeps the bandwidth relation on the prewarped axis
+        warp = lambda f: math.tan(math.pi * f / fs)
+        low = bisect(lambda f: abs(notch.response(f, fs)) - math.sqrt(0.5), 0.1, f0)
+        high = bisect(lambda f: abs(notch.response(f, fs)) - math.sqrt(0.5), f0, 0.5 * fs - 0.1)
+        bandwidth = (warp(high) - warp(low)) / warp(f0)
+        # single precision coefficients leave the zeros a few 1e-7 off the unit circle
+        report.check("notch %.0fHz Q %.0f depth" % (f0, q), db(notch.response(f0, fs)) < -60.0, "%.0f dB" % db(notch.response(f0, fs)))
+        report.check("notch %.0fHz Q %.0f DC gain" % (f0, q), abs(abs(notch.response(0.0, fs)) - 1.0) < 1e-5)
+        report.check("notch %.0fHz Q %.0f bandwidth" % (f0, q), abs(bandwidth * q - 1.0) < 1e-3,
+                     "%.1f Hz to %.1f Hz" % (low, high))
+    for fc in [10.0, 40.0, 80.0]:
+        lowpass = BiquadFilter([(LOWPASS, fc, 1.0 / math.sqrt(2.0))], fs)
+        report.check("low-pass %.0fHz DC gain" % fc, abs(abs(lowpass.response(0.0, fs)) - 1.0) < 1e-5)
+        report.check("low-pass %.0fHz -3dB at cutoff" % fc, abs(db(lowpass.response(fc, fs)) + 3.0103) < 0.01,
+                     "%.3f dB" % db(lowpass.response(fc, fs)))
+
+
+def test_time_domain(report, rng):
+    fs = SAMPLE_RATE_HZ
+    cascade = BiquadFilter([(NOTCH, 45.0, 3.0), (NOTCH, 90.0, 4.0), (LOWPASS, 100.0, 0.707)], fs)
+    worst = 0.0
+    for _ in range(20):
+        freq = rng.uniform(1.0, 120.0)
+        h = cascade.response(freq, fs)
+        cascade.reset(0.0)
+        n = int(fs * 4.0)
+        tail = []
+        for i in range(n):
+            y = cascade.calc(math.sin(2.0 * math.pi * freq * i / fs))
+            if i >= n - int(fs):
+                expected = abs(h) * math.sin(2.0 * math.pi * freq * i / fs + cmath.phase(h))
+                tail.append(abs(y - expected))
+        worst = max(worst, max(tail))
+    report.check("sines settle on the analytic gain", worst < 1e-3, "worst error %.1e" % worst)
+
+
+def test_reset(report, rng):
+    fs = SAMPLE_RATE_HZ
+    cascade = BiquadFilter([(NOTCH, 60.0, 2.0), (LOWPASS, 50.0, 0.707)], fs)
+    worst = 0.0
+    for _ in range(20):
+        value = rng.uniform(-10.0, 10.0)
+        cascade.reset(value)
+        for _ in range(200):
+            worst = max(worst, abs(cascade.calc(value) - value))
+    # relative to the input, single precision rounding of the state
+    report.check("reset starts without a transient", worst < 1e-4, "worst error %.1e" % worst)
+
+
+def test_table(report):
+    fs = SAMPLE_RATE_HZ
+    bypass = BiquadFilter([(BYPASS, 0.0, 0.0)], fs)
+    report.check("bypass table passes the input", len(bypass.coeffs) == 0 and bypass.all_designed and bypass.calc(1.5) == 1.5)
+    aliased = BiquadFilter([(NOTCH, 150.0, 3.0), (LOWPASS, 40.0, 0.707)], fs)
+    report.check("stage above Nyquist left out and reported", len(aliased.coeffs) == 1 and not aliased.all_designed)
+    max_stages = int(FIRMWARE.BIQUAD_FILTER_MAX_STAGES)
+    too_many = BiquadFilter([(NOTCH, 20.0 + 10.0 * i, 3.0) for i in range(max_stages + 1)], fs)
+    report.check("stages over the limit left out and reported", len(too_many.coeffs) == max_stages and not too_many.all_designed)
+
+
+def test_spectrum(report, rng, blocks):
+    fs = SAMPLE_RATE_HZ
+    worst_freq, worst_amplitude, found = 0.0, 0.0, True
+    for _ in range(5):
+        tones = [(rng.uniform(10.0, 115.0), rng.uniform(0.5, 2.0), rng.uniform(0.0, 2.0 * math.pi)) for _ in range(int(FIRMWARE.SPECTRUM_PEAK_COUNT))]
+        # tones closer than the Hann main lobe can't be told apart
+        if min(abs(a[0] - b[0]) for i, a in enumerate(tones) for b in tones[i + 1:]) < 4.0 * fs / FFT_LENGTH:
+            continue
+        analyzer = FIRMWARE.new("spectrum_analyzer_t")
+        FIRMWARE.spectrum_analyzer_init(analyzer, fs, 0.2)
+        offset = rng.uniform(-5.0, 5.0)
+        t = 0
+        for _ in range(blocks):
+            full = False
+            while not full:
+                sample = offset + sum(a * math.sin(2.0 * math.pi * f * t / fs + p) for f, a, p in tones) + rng.gauss(0.0, 0.1)
+                full = FIRMWARE.spectrum_analyzer_add(analyzer, sample) == 1
+                t += 1
+            FIRMWARE.spectrum_analyzer_calc(analyzer)
+        peaks = list(zip(analyzer.peak_freq, analyzer.peak_amplitude))
+        for f, a, _ in tones:
+            match = [p for p in peaks if abs(p[0] - f) < 1.0]
+            if not match:
+                found = False
+                continue
+            worst_freq = max(worst_freq, abs(match[0][0] - f))
+            worst_amplitude = max(worst_amplitude, abs(match[0][1] / a - 1.0))
+    report.check("spectrum finds every tone", found)
+    report.check("spectrum peak frequency", worst_freq < 0.05, "worst %.3f Hz, bin %.3f Hz" % (worst_freq, fs / FFT_LENGTH))
+    report.check("spectrum peak amplitude", worst_amplitude < 0.02, "worst %.1f %%" % (worst_amplitude * 100.0))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the biquad filter cascade and the spectrum analyzer")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--blocks", type=int, default=8)
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    report = Report()
+    test_frequency_response(report)
+    test_time_domain(report, rng)
+    test_reset(report, rng)
+    test_table(report)
+    test_spectrum(report, rng, args.blocks)
+    if not report.ok:
+        raise SystemExit("biquad filter test failed")
+
+
+if __name__ == "__main__":
+    main()
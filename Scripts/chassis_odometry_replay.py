@@ -0,0 +1,233 @@
+# Host replay test of the chassis odometry estimator (application/chassis_odometry.c)
+# Replays wheel, gyro and accelerometer data through chassis_odometry_update() and compares it with pure wheel odometry
+# (what chassis_feedback_update gave before). The estimator is the firmware's, built by firmware_host.py with INS_task.c
+# for the INS data it reads; chassis_move is filled in as chassis_feedback_update does.
+# Log is a csv with a header row, one row per chassis period:
+#   time_s, rpm1..rpm4 (rotor), accel_nav_x, accel_nav_y (INS, navigation frame), chassis_yaw, wz_gyro
+#   optional ground truth: true_x, true_y (m, odometry frame)
+# Without --log a drive is synthesized: translation while spinning, one wheel slipping on a line, all four wheels
+# spinning on a hard launch, imu noise and a tilt-induced accelerometer bias. It checks that the estimator beats wheel
+# odometry on velocity error and final position error. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import csv
+import math
+
+from firmware_host import Firmware
+
+FIRMWARE = Firmware(
+    ["application/chassis_odometry.c", "application/chassis_task.c", "application/INS_task.c",
+     "components/algorithm/AHRS_middleware.c"],
+    headers=["chassis_odometry.h", "chassis_task.h", "INS_task.h"],
+    structs={"chassis_move_t": {"wheel_rot_radii": ctypes.c_float, "motor_chassis": ctypes.c_uint8, "vx": ctypes.c_float,
+                                "vy": ctypes.c_float, "wz": ctypes.c_float, "chassis_yaw": ctypes.c_float,
+                                "chassis_yaw_motor": ctypes.c_void_p},
+             "chassis_motor_t": {"speed": ctypes.c_float},
+             "chassis_loop_timing_t": {"dt": ctypes.c_float},
+             "chassis_odometry_t": {"vx": ctypes.c_float, "vy": ctypes.c_float, "x": ctypes.c_float, "y": ctypes.c_float},
+             "gimbal_motor_t": {"motor_gyro": ctypes.c_float, "gimbal_motor_measure": ctypes.c_void_p},
+             "motor_measure_t": {"speed_rpm": ctypes.c_int16}},
+    constants=["CHASSIS_CONTROL_TIME_S", "MOTOR_DISTANCE_TO_CENTER_DEFAULT", "CHASSIS_MOTOR_RPM_TO_VECTOR_SEN",
+               "MOTOR_SPEED_TO_CHASSIS_SPEED_VX", "MOTOR_SPEED_TO_CHASSIS_SPEED_VY", "MOTOR_SPEED_TO_CHASSIS_SPEED_WZ",
+               "CHASSIS_ODOMETRY_ACTIVE"])
+CHASSIS = FIRMWARE.global_struct("chassis_move_t", "chassis_move")
+TIMING = FIRMWARE.global_struct("chassis_loop_timing_t", "chassis_loop_timing")
+ODOMETRY = FIRMWARE.global_struct("chassis_odometry_t", "chassis_odometry_data")
+MOTORS = [FIRMWARE.view("chassis_motor_t", CHASSIS.field_address("motor_chassis"), i) for i in range(4)]
+INS_QUAT = (ctypes.c_float * 4).from_address(FIRMWARE.get_INS_quat_point())
+INS_ACCEL = (ctypes.c_float * 3).from_address(FIRMWARE.get_accel_data_point())
+
+DT = FIRMWARE.CHASSIS_CONTROL_TIME_S
+ROT_RADIUS = FIRMWARE.MOTOR_DISTANCE_TO_CENTER_DEFAULT
+RPM_TO_VECTOR = FIRMWARE.CHASSIS_MOTOR_RPM_TO_VECTOR_SEN
+GRAVITY = 9.81
+
+WHEEL_SX = (-1.0, 1.0, 1.0, -1.0)
+WHEEL_SY = (-1.0, -1.0, 1.0, 1.0)
+
+
+def rad_format(angle):
+    return (angle + math.pi) % (2.0 * math.pi) - math.pi
+
+
+def wheel_kinematics(speeds):
+    # chassis_feedback_update
+    vx = FIRMWARE.MOTOR_SPEED_TO_CHASSIS_SPEED_VX * sum(sx * s for sx, s in zip(WHEEL_SX, speeds))
+    vy = FIRMWARE.MOTOR_SPEED_TO_CHASSIS_SPEED_VY * sum(sy * s for sy, s in zip(WHEEL_SY, speeds))
+    wz = -FIRMWARE.MOTOR_SPEED_TO_CHASSIS_SPEED_WZ * sum(speeds) / ROT_RADIUS
+    return vx, vy, wz
+
+
+class Odometry:
+    """chassis_odometry_data, updated by chassis_odometry_update()"""
+
+    def __init__(self):
+        self.yaw_measure = FIRMWARE.new("motor_measure_t", speed_rpm=0)
+        self.yaw_motor = FIRMWARE.new("gimbal_motor_t", gimbal_motor_measure=self.yaw_measure.address)
+        CHASSIS.chassis_yaw_motor = self.yaw_motor.address
+        CHASSIS.wheel_rot_radii = [ROT_RADIUS] * 4
+        TIMING.dt = DT
+        # INS level: navigation frame acceleration is the accelerometer with gravity on z
+        INS_QUAT[:] = [1.0, 0.0, 0.0, 0.0]
+        FIRMWARE.chassis_odometry_init()
+
+    def update(self, rpm, accel_nav, chassis_yaw, wz_gyro):
+        speeds = [r * RPM_TO_VECTOR for r in rpm]
+        for motor, speed in zip(MOTORS, speeds):
+            motor.speed = speed
+        CHASSIS.vx, CHASSIS.vy, CHASSIS.wz = wheel_kinematics(speeds)
+        CHASSIS.chassis_yaw = chassis_yaw
+        # the log has the chassis yaw rate, seen as gimbal gyro with the yaw motor still
+        self.yaw_motor.motor_gyro = wz_gyro
+        INS_ACCEL[:] = [accel_nav[0], accel_nav[1], GRAVITY]
+        FIRMWARE.chassis_odometry_update()
+
+    def __getattr__(self, name):
+        if name in ("vx", "vy", "x", "y"):
+            return getattr(ODOMETRY, name)
+        raise AttributeError(name)
+
+
+class WheelOdometry:
+    # baseline: wheel kinematics only, integrated with the same heading
+    def __init__(self):
+        self.vx = self.vy = 0.0
+        self.x = self.y = 0.0
+        self.yaw_origin = None
+
+    def update(self, rpm, accel_nav, chassis_yaw, wz_gyro):
+        self.vx, self.vy, _ = wheel_kinematics([r * RPM_TO_VECTOR for r in rpm])
+        if self.yaw_origin is None:
+            self.yaw_origin = chassis_yaw
+        yaw = rad_format(chassis_yaw - self.yaw_origin)
+        self.x += (math.cos(yaw) * self.vx - math.sin(yaw) * self.vy) * DT
+        self.y += (math.sin(yaw) * self.vx + math.cos(yaw) * self.vy) * DT
+
+
+class Lcg:
+    def __init__(self, seed):
+        self.seed = seed
+
+    def gauss(self):
+        # sum of uniforms, good enough and identical on every machine
+        total = 0.0
+        for _ in range(12):
+            self.seed = (1103515245 * self.seed + 12345) & 0x7FFFFFFF
+            total += self.seed / float(0x7FFFFFFF)
+        return total - 6.0
+
+
+def synthesize(duration, seed):
+    # yields (row, truth), truth = (vx, vy, x, y) in chassis / odometry frame
+    rand = Lcg(seed)
+    heading = 0.3
+    x = y = 0.0
+    vx_nav_last = vy_nav_last = 0.0
+    bias = (0.12, -0.08)  # m/s^2, about 0.7 degree tilt error
+    for n in range(int(duration / DT)):
+        # robot waits 1s before the drive, like after power on
+        t = n * DT - 1.0
+        # chassis frame command: accelerate forward, strafe, spin while translating, stop
+        vx = 2.0 * min(max(t, 0.0) / 0.6, 1.0) if t < 3.0 else max(2.0 - (t - 3.0) * 4.0, 0.0)
+        vy = 0.8 * math.sin(2.0 * math.pi * 0.4 * t) if 1.0 < t < 4.0 else 0.0
+        wz = 4.0 if 1.5 < t < 3.5 else 0.0
+        heading += wz * DT
+        c, s = math.cos(heading), math.sin(heading)
+        vx_nav, vy_nav = c * vx - s * vy, s * vx + c * vy
+        ax_nav, ay_nav = (vx_nav - vx_nav_last) / DT, (vy_nav - vy_nav_last) / DT
+        vx_nav_last, vy_nav_last = vx_nav, vy_nav
+        x += vx_nav * DT
+        y += vy_nav * DT
+
+        speeds = [sx * vx + sy * vy - ROT_RADIUS * wz for sx, sy in zip(WHEEL_SX, WHEEL_SY)]
+        if 0.0 < t < 0.35:
+            # hard launch, all four wheels spinning ahead of the ground
+            spin = 0.6 * math.sin(math.pi * t / 0.35)
+            speeds = [sp + sx * spin for sp, sx in zip(speeds, WHEEL_SX)]
+        if 2.2 < t < 2.7:
+            # wheel 2 on a slippery line
+            speeds[2] += 0.8
+        rpm = [round(sp / RPM_TO_VECTOR) for sp in speeds]
+        accel = (ax_nav + bias[0] + 0.3 * rand.gauss(), ay_nav + bias[1] + 0.3 * rand.gauss())
+        # gyro is fine, yaw motor speed is 1rpm resolution
+        wz_gyro = wz + 0.01 * rand.gauss() + round(0.5 * rand.gauss()) * 2.0 * math.pi / 60.0
+        row = (n * DT, rpm, accel, rad_format(heading + 0.002 * rand.gauss()), wz_gyro)
+        yield row, (vx, vy, x, y)
+
+
+def read_log(path):
+    with open(path, newline="") as f:
+        for rec in csv.DictReader(f):
+            row = (float(rec["time_s"]), [float(rec["rpm%d" % i]) for i in range(1, 5)],
+                   (float(rec["accel_nav_x"]), float(rec["accel_nav_y"])), float(rec["chassis_yaw"]), float(rec["wz_gyro"]))
+            truth = None
+            if "true_x" in rec and rec["true_x"] != "":
+                truth = (None, None, float(rec["true_x"]), float(rec["true_y"]))
+            yield row, truth
+
+
+def replay(rows):
+    estimators = {"odometry": Odometry(), "wheel only": WheelOdometry()}
+    vel_err = {name: 0.0 for name in estimators}
+    samples = 0
+    truth = None
+    first_truth_pose = None
+    for row, truth in rows:
+        for est in estimators.values():
+            est.update(*row[1:])
+        if truth is None:
+            continue
+        if first_truth_pose is None:
+            first_truth_pose = truth[2:]
+        if truth[0] is not None:
+            samples += 1
+            for name, est in estimators.items():
+                vel_err[name] += (est.vx - truth[0]) ** 2 + (est.vy - truth[1]) ** 2
+    results = {}
+    for name, est in estimators.items():
+        result = {"x": est.x, "y": est.y}
+        if samples:
+            result["vel_rms"] = math.sqrt(vel_err[name] / samples)
+        if truth is not None:
+            # truth pose is in the frame the log started in; estimator pose starts at zero, same heading origin
+            dx = truth[2] - first_truth_pose[0]
+            dy = truth[3] - first_truth_pose[1]
+            result["pos_err"] = math.hypot(est.x - dx, est.y - dy)
+        results[name] = result
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Replay chassis odometry against wheel-only odometry")
+    parser.add_argument("--log", help="csv log, see header of this file")
+    parser.add_argument("--duration", type=float, default=6.0, help="synthesized log length, s")
+    parser.add_argument("--seed", type=int, default=12345)
+    args = parser.parse_args()
+    if not FIRMWARE.CHASSIS_ODOMETRY_ACTIVE:
+        raise SystemExit("chassis odometry is off for this ROBOT_TYPE")
+
+    if args.log:
+        results = replay(read_log(args.log))
+    else:
+        # synthesized heading starts at 0.3 rad, odometry frame is the chassis pose at t = 0
+        rows = []
+        for row, truth in synthesize(args.duration, args.seed):
+            c, s = math.cos(-0.3), math.sin(-0.3)
+            rows.append((row, (truth[0], truth[1], c * truth[2] - s * truth[3], s * truth[2] + c * truth[3])))
+        results = replay(rows)
+
+    for name, result in results.items():
+        print("%-10s: pose (%.3f, %.3f) m" % (name, result["x"], result["y"]) +
+              ("".join(", %s %.3f" % (key, result[key]) for key in ("vel_rms", "pos_err") if key in result)))
+
+    if not args.log:
+        odom, wheel = results["odometry"], results["wheel only"]
+        if odom["vel_rms"] >= wheel["vel_rms"] or odom["pos_err"] >= wheel["pos_err"]:
+            raise SystemExit("odometry is not better than wheel-only odometry")
+        if odom["pos_err"] > 0.05:
+            raise SystemExit("odometry position error %.3f m above 0.05 m" % odom["pos_err"])
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,405 @@
+# Host simulation of the chassis power limiter (application/chassis_power_control.c)
+# 1. Fits the per-wheel power model P = k1 * I^2 + k2 * I * w + k3 to logged referee power data, offline least squares
+#    and the same recursive least squares as the firmware, and prints the macros to paste into chassis_power_control.h.
+# 2. Replays the log through the limiter and reports how often and how hard it would have limited.
+# 3. Closes the loop on a 4-wheel chassis model driven by the 1kHz speed PIDs, with and without limiter, and checks
+#    that referee buffer energy never runs out.
+# 4. Checks that the online fit survives a referee outage and a long gap in the power reports.
+# Log is a csv with a header row, one row per chassis period (e.g. exported from J-Scope or Ozone):
+#   time_s, chassis_power, buffer_energy, power_limit, current1..current4 (raw CAN command), rpm1..rpm4 (rotor)
+# Without --log a log is synthesized from the closed loop model without limiter.
+# Limiter, online fit and speed PIDs are application/chassis_power_control.c and components/controller/pid.c built by
+# firmware_host.py, fed the referee power reports as frames; the replay runs a build without the online fit.
+# Exit code is non-zero on failure.
+
+import argparse
+import csv
+import ctypes
+import math
+
+from firmware_host import Firmware, Report
+
+SOURCES = ["application/chassis_power_control.c", "application/supercap_manager.c", "application/chassis_task.c",
+           "application/referee.c", "application/detect_task.c", "application/CAN_receive.c", "components/controller/pid.c"]
+HEADERS = ["chassis_power_control.h", "chassis_task.h", "referee.h", "protocol.h", "detect_task.h", "pid.h"]
+STRUCTS = {
+    "chassis_power_control_t": {"k1": ctypes.c_float, "k2": ctypes.c_float, "k3": ctypes.c_float, "scale": ctypes.c_float,
+                                "regressor_count": ctypes.c_uint16},
+    "chassis_move_t": {"motor_chassis": ctypes.c_uint8, "motor_speed_pid": ctypes.c_uint8},
+    "chassis_motor_t": {"chassis_motor_measure": ctypes.c_void_p},
+    "motor_measure_t": {"speed_rpm": ctypes.c_int16},
+    "pid_type_def": {"out": ctypes.c_float, "Iout": ctypes.c_float},
+    "error_t": {"error_exist": ctypes.c_uint8},
+    "ext_game_robot_state_t": {"robot_id": ctypes.c_uint8, "chassis_power_limit": ctypes.c_uint16},
+    "ext_power_heat_data_t": {"chassis_power": ctypes.c_float, "buffer_energy": ctypes.c_uint16},
+}
+CONSTANTS = ["M3508_CAN_CURRENT_TO_AMP", "M3508_RPM_TO_RAD_S", "CHASSIS_POWER_K1", "CHASSIS_POWER_K2", "CHASSIS_POWER_K3",
+             "CHASSIS_CONTROL_TIME_S", "M3508_MOTOR_GEAR_RATIO", "DRIVE_WHEEL_RADIUS", "M3508_MOTOR_RPM_TO_VECTOR",
+             "M3508_MOTOR_SPEED_PID_KP", "M3508_MOTOR_SPEED_PID_KI", "M3508_MOTOR_SPEED_PID_KD", "M3508_MOTOR_SPEED_PID_MAX_OUT",
+             "M3508_MOTOR_SPEED_PID_MAX_IOUT", "PID_POSITION", "REFEREE_TOE", "REF_PROTOCOL_HEADER_SIZE", "ROBOT_STATE_CMD_ID",
+             "POWER_HEAT_DATA_CMD_ID"]
+PROTOTYPES = {"PID_init": (None, [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_void_p, ctypes.c_float, ctypes.c_float,
+                                  ctypes.c_float, ctypes.c_void_p])}
+FIRMWARE = Firmware(SOURCES, headers=HEADERS, structs=STRUCTS, constants=CONSTANTS, prototypes=PROTOTYPES)
+# the replay limits with a fixed model
+REPLAY_FIRMWARE = Firmware(SOURCES, headers=HEADERS, structs=STRUCTS, constants=CONSTANTS, prototypes=PROTOTYPES,
+                           config={"CHASSIS_POWER_MODEL_ONLINE_FIT": 0})
+
+M3508_CAN_CURRENT_TO_AMP = FIRMWARE.M3508_CAN_CURRENT_TO_AMP
+M3508_RPM_TO_RAD_S = FIRMWARE.M3508_RPM_TO_RAD_S
+CHASSIS_POWER_K1 = FIRMWARE.CHASSIS_POWER_K1
+CHASSIS_POWER_K2 = FIRMWARE.CHASSIS_POWER_K2
+CHASSIS_POWER_K3 = FIRMWARE.CHASSIS_POWER_K3
+CHASSIS_CONTROL_TIME_S = FIRMWARE.CHASSIS_CONTROL_TIME_S
+M3508_MOTOR_GEAR_RATIO = FIRMWARE.M3508_MOTOR_GEAR_RATIO
+DRIVE_WHEEL_RADIUS = FIRMWARE.DRIVE_WHEEL_RADIUS
+M3508_MOTOR_RPM_TO_VECTOR = FIRMWARE.M3508_MOTOR_RPM_TO_VECTOR
+# a robot id of a red infantry, 0 means no referee data yet
+ROBOT_ID = 3
+
+# referee rules
+REFEREE_BUFFER_MAX = 60.0
+REFEREE_PERIOD_S = 0.02
+
+
+def constrain(value, low, high):
+    return max(low, min(high, value))
+
+
+def referee_frame(firmware, cmd_id, data):
+    """a frame as referee_data_solve takes it from the unpacker, header and CRCs unchecked there"""
+    frame = bytes(int(firmware.REF_PROTOCOL_HEADER_SIZE)) + int(cmd_id).to_bytes(2, "little") + data.raw()
+    return ctypes.create_string_buffer(frame, len(frame) + 2)
+
+
+class PowerLimiter:
+    """chassis_power_control() with the supercap offline, on the four speed PIDs of chassis_move"""
+
+    def __init__(self, firmware=FIRMWARE, robot_id=ROBOT_ID):
+        self.fw = firmware
+        self.robot_id = robot_id
+        fw = firmware
+        chassis = fw.global_struct("chassis_move_t", "chassis_move")
+        self.pids = [fw.view("pid_type_def", chassis.field_address("motor_speed_pid"), i) for i in range(4)]
+        self.motors = [fw.global_struct("motor_measure_t", "motor_chassis", i) for i in range(4)]
+        gains = (ctypes.c_float * 3)(fw.M3508_MOTOR_SPEED_PID_KP, fw.M3508_MOTOR_SPEED_PID_KI, fw.M3508_MOTOR_SPEED_PID_KD)
+        for i in range(4):
+            wheel = fw.view("chassis_motor_t", chassis.field_address("motor_chassis"), i)
+            wheel.chassis_motor_measure = self.motors[i].address
+            fw.PID_init(self.pids[i], int(fw.PID_POSITION), gains, fw.M3508_MOTOR_SPEED_PID_MAX_OUT,
+                        fw.M3508_MOTOR_SPEED_PID_MAX_IOUT, 0.0, ctypes.cast(fw.lib.raw_err_handler, ctypes.c_void_p))
+        self.data = fw.global_struct("chassis_power_control_t", "chassis_power_control_data")
+        self.referee_error = fw.global_struct("error_t", "error_list", int(fw.REFEREE_TOE))
+        self.referee_error.error_exist = 0
+        fw.init_referee_struct_data()
+        self.power_limit = None
+        fw.chassis_power_control_init()
+
+    @property
+    def k(self):
+        return [self.data.k1, self.data.k2, self.data.k3]
+
+    @k.setter
+    def k(self, value):
+        self.data.k1, self.data.k2, self.data.k3 = value
+
+    def referee(self, chassis_power, buffer_energy, power_limit):
+        """a power report, with the robot state before it if the limit changed"""
+        if power_limit != self.power_limit:
+            self.power_limit = power_limit
+            state = self.fw.new("ext_game_robot_state_t", robot_id=self.robot_id, chassis_power_limit=int(power_limit))
+            self.fw.referee_data_solve(referee_frame(self.fw, self.fw.ROBOT_STATE_CMD_ID, state))
+        power_heat = self.fw.new("ext_power_heat_data_t", chassis_power=chassis_power, buffer_energy=int(buffer_energy))
+        self.fw.referee_data_solve(referee_frame(self.fw, self.fw.POWER_HEAT_DATA_CMD_ID, power_heat))
+
+    def speed_pid(self, speeds, sets, dt):
+        return [self.fw.PID_calc(pid, speed, s, dt) for pid, speed, s in zip(self.pids, speeds, sets)]
+
+    def limit(self, rpms, outputs=None):
+        """scale the speed PID outputs, or the given commands; returns the scale"""
+        for i in range(4):
+            self.motors[i].speed_rpm = int(rpms[i])
+            if outputs is not None:
+                self.pids[i].out = outputs[i]
+        self.fw.chassis_power_control()
+        return self.data.scale
+
+    def outputs(self):
+        return [pid.out for pid in self.pids]
+
+
+class Chassis:
+    # four M3508 wheels, each carrying a quarter of the robot mass, with the true electrical power of the motors
+    def __init__(self, mass, true_k, noise, seed=12345):
+        self.rotor_inertia = mass / 4.0 * (DRIVE_WHEEL_RADIUS / M3508_MOTOR_GEAR_RATIO) ** 2 + 1.5e-5
+        self.torque_constant = 0.3 / M3508_MOTOR_GEAR_RATIO
+        self.rolling_loss = 0.002  # Nm at rotor
+        self.true_k = true_k
+        self.noise = noise
+        self.omega = [0.0] * 4
+        self.seed = seed
+
+    def rand(self):
+        self.seed = (1103515245 * self.seed + 12345) & 0x7FFFFFFF
+        return self.seed / float(0x7FFFFFFF) - 0.5
+
+    def rpm(self):
+        return [w / M3508_RPM_TO_RAD_S for w in self.omega]
+
+    def step(self, raw_currents, dt):
+        power = 0.0
+        for i, raw in enumerate(raw_currents):
+            current = raw * M3508_CAN_CURRENT_TO_AMP
+            power += self.true_k[0] * current * current + self.true_k[1] * current * self.omega[i] + self.true_k[2]
+            friction = self.rolling_loss * (1.0 if self.omega[i] > 0 else -1.0 if self.omega[i] < 0 else 0.0)
+            self.omega[i] += (self.torque_constant * current - friction) / self.rotor_inertia * dt
+        return power
+
+
+def wheel_set_speed(t):
+    # aggressive driver: full speed sprints back and forth, then spinning while translating
+    phase = t % 6.0
+    if phase < 1.5:
+        vx, wz = 2.0, 0.0
+    elif phase < 3.0:
+        vx, wz = -2.0, 0.0
+    elif phase < 4.5:
+        vx, wz = 0.0, 8.0
+    else:
+        vx, wz = 1.5, 6.0
+    rot = wz * 0.25
+    return [constrain(s, -4.0, 4.0) for s in (-vx + rot, vx + rot, vx + rot, -vx + rot)]
+
+
+def run_closed_loop(duration, power_limit, use_limiter, true_k, noise):
+    chassis = Chassis(20.0, true_k, noise)
+    limiter = PowerLimiter()
+    buffer_energy = REFEREE_BUFFER_MAX
+    referee_power = 0.0
+    window_energy = 0.0
+    window_time = 0.0
+    referee_timer = 0.0
+    limiter.referee(referee_power, buffer_energy, power_limit)
+    log = []
+    stats = {"max_power": 0.0, "min_buffer": REFEREE_BUFFER_MAX, "buffer_empty_s": 0.0, "limited_ratio": 0.0, "distance": 0.0}
+    dt = CHASSIS_CONTROL_TIME_S
+    steps = int(duration / dt)
+    for n in range(steps):
+        t = n * dt
+        rpms = [int(rpm) for rpm in chassis.rpm()]
+        speeds = [rpm * M3508_MOTOR_RPM_TO_VECTOR for rpm in rpms]
+        limiter.speed_pid(speeds, wheel_set_speed(t), dt)
+        if use_limiter and limiter.limit(rpms) < 1.0:
+            stats["limited_ratio"] += 1.0 / steps
+        commands = [float(int(out)) for out in limiter.outputs()]
+        power = chassis.step(commands, dt)
+        # referee: buffer drains while power exceeds the limit, refills otherwise
+        buffer_energy = constrain(buffer_energy - (power - power_limit) * dt, 0.0, REFEREE_BUFFER_MAX)
+        if buffer_energy <= 0.0:
+            stats["buffer_empty_s"] += dt
+        window_energy += power * dt
+        window_time += dt
+        referee_timer += dt
+        if referee_timer >= REFEREE_PERIOD_S:
+            referee_timer -= REFEREE_PERIOD_S
+            referee_power = window_energy / window_time + noise * chassis.rand()
+            window_energy = window_time = 0.0
+            limiter.referee(referee_power, buffer_energy, power_limit)
+        stats["max_power"] = max(stats["max_power"], power)
+        stats["min_buffer"] = min(stats["min_buffer"], buffer_energy)
+        stats["distance"] += sum(abs(s) for s in speeds) / 4.0 * dt
+        log.append([t, referee_power, buffer_energy, power_limit] + commands + rpms)
+    return stats, limiter, log
+
+
+def read_log(path):
+    rows = []
+    with open(path, newline="") as f:
+        reader = csv.DictReader(f)
+        for row in reader:
+            rows.append([float(row["time_s"]), float(row["chassis_power"]), float(row["buffer_energy"]), float(row["power_limit"])] +
+                        [float(row["current%d" % i]) for i in range(1, 5)] + [float(row["rpm%d" % i]) for i in range(1, 5)])
+    return rows
+
+
+def regressors(row):
+    sum_sq = sum_cross = 0.0
+    for raw, rpm in zip(row[4:8], row[8:12]):
+        current = raw * M3508_CAN_CURRENT_TO_AMP
+        sum_sq += current * current
+        sum_cross += current * rpm * M3508_RPM_TO_RAD_S
+    return sum_sq, sum_cross
+
+
+def referee_windows(log):
+    # average model regressors over the rows between two changes of the referee power sample
+    windows = []
+    acc = [0.0, 0.0]
+    count = 0
+    last_power = None
+    for row in log:
+        sum_sq, sum_cross = regressors(row)
+        acc[0] += sum_sq
+        acc[1] += sum_cross
+        count += 1
+        if last_power is not None and row[1] != last_power:
+            windows.append((acc[0] / count, acc[1] / count, row[1]))
+            acc = [0.0, 0.0]
+            count = 0
+        last_power = row[1]
+    return windows
+
+
+def solve3(a, b):
+    # gaussian elimination with partial pivoting, like sysid_solve_linear
+    n = 3
+    a = [r[:] for r in a]
+    b = b[:]
+    for k in range(n):
+        pivot = max(range(k, n), key=lambda i: abs(a[i][k]))
+        if abs(a[pivot][k]) < 1e-12:
+            return None
+        a[k], a[pivot] = a[pivot], a[k]
+        b[k], b[pivot] = b[pivot], b[k]
+        for i in range(k + 1, n):
+            f = a[i][k] / a[k][k]
+            for j in range(k, n):
+                a[i][j] -= f * a[k][j]
+            b[i] -= f * b[k]
+    x = [0.0] * n
+    for i in reversed(range(n)):
+        x[i] = (b[i] - sum(a[i][j] * x[j] for j in range(i + 1, n))) / a[i][i]
+    return x
+
+
+def fit_model(windows):
+    ata = [[0.0] * 3 for _ in range(3)]
+    atb = [0.0] * 3
+    for sum_sq, sum_cross, power in windows:
+        phi = (sum_sq, sum_cross, 4.0)
+        for i in range(3):
+            for j in range(3):
+                ata[i][j] += phi[i] * phi[j]
+            atb[i] += phi[i] * power
+    return solve3(ata, atb)
+
+
+def rms_error(windows, k):
+    if not windows:
+        return float("nan")
+    err = sum((k[0] * s + k[1] * c + 4.0 * k[2] - p) ** 2 for s, c, p in windows)
+    return math.sqrt(err / len(windows))
+
+
+def analyse_log(log):
+    windows = referee_windows(log)
+    if len(windows) < 10:
+        raise SystemExit("log has too few referee power samples")
+    default_k = [CHASSIS_POWER_K1, CHASSIS_POWER_K2, CHASSIS_POWER_K3]
+    fitted_k = fit_model(windows)
+    # the firmware fit on the logged commands, unlimited: no robot id yet
+    limiter = PowerLimiter(robot_id=0)
+    last_power = None
+    for row in log:
+        if last_power is not None and row[1] != last_power:
+            limiter.referee(row[1], row[2], row[3])
+        last_power = row[1]
+        limiter.limit(row[8:12], row[4:8])
+    print("referee samples %d" % len(windows))
+    print("default model   k1 %.4f k2 %.5f k3 %.3f -> rms error %.2f W" % (default_k[0], default_k[1], default_k[2], rms_error(windows, default_k)))
+    if fitted_k is not None:
+        print("least squares   k1 %.4f k2 %.5f k3 %.3f -> rms error %.2f W" % (fitted_k[0], fitted_k[1], fitted_k[2], rms_error(windows, fitted_k)))
+    print("firmware RLS    k1 %.4f k2 %.5f (k3 fixed) -> rms error %.2f W" % (limiter.k[0], limiter.k[1], rms_error(windows, limiter.k)))
+
+    # what the limiter would have done on the logged commands
+    model_k = fitted_k if fitted_k is not None else default_k
+    replay = PowerLimiter(REPLAY_FIRMWARE)
+    replay.k = list(model_k)
+    limited = over_limit = 0
+    min_scale = 1.0
+    for row in log:
+        replay.referee(row[1], row[2], row[3])
+        scale = replay.limit(row[8:12], row[4:8])
+        limited += scale < 1.0
+        min_scale = min(min_scale, scale)
+        over_limit += row[1] > row[3]
+    print("replay: logged power above limit in %.1f%% of periods, limiter active in %.1f%%, min scale %.2f" % (
+        100.0 * over_limit / len(log), 100.0 * limited / len(log), min_scale))
+    if fitted_k is not None:
+        print("#define CHASSIS_POWER_K1 %.4ff // W / A^2" % fitted_k[0])
+        print("#define CHASSIS_POWER_K2 %.5ff // W / (A * rad/s)" % fitted_k[1])
+        print("#define CHASSIS_POWER_K3 %.3ff // W per wheel" % fitted_k[2])
+
+
+def test_referee_gaps(report):
+    """the referee offline, then online without power reports, each longer than the regressor count holds"""
+    limiter = PowerLimiter()
+    limiter.referee(40.0, REFEREE_BUFFER_MAX, 60.0)
+    true_k = (0.22, 0.0172, 1.1)
+    rpms = [3000.0, -3000.0, 3000.0, -3000.0]
+    outputs = [6000.0, -6000.0, 6000.0, -6000.0]
+    sum_sq = sum((out * M3508_CAN_CURRENT_TO_AMP) ** 2 for out in outputs)
+    sum_cross = sum(out * M3508_CAN_CURRENT_TO_AMP * rpm * M3508_RPM_TO_RAD_S for out, rpm in zip(outputs, rpms))
+    power = true_k[0] * sum_sq + true_k[1] * sum_cross + 4.0 * true_k[2]
+    gap = 70000  # periods, 70s at 1kHz
+
+    limiter.referee_error.error_exist = 1
+    max_count = 0
+    for _ in range(gap):
+        limiter.limit(rpms, outputs)
+        max_count = max(max_count, limiter.data.regressor_count)
+    limiter.referee_error.error_exist = 0
+    report.check("referee offline: no regressors kept", max_count == 0, "count up to %d" % max_count)
+
+    wrapped = False
+    last_count = 0
+    for _ in range(gap):
+        limiter.limit(rpms, outputs)
+        count = limiter.data.regressor_count
+        wrapped = wrapped or (count < last_count and count != 1)
+        last_count = count
+    for _ in range(20):
+        limiter.referee(power, REFEREE_BUFFER_MAX, 60.0)
+        for _ in range(20):
+            limiter.limit(rpms, outputs)
+    k = limiter.k
+    finite = all(math.isfinite(value) for value in k)
+    error = abs(k[0] * sum_sq + k[1] * sum_cross + 4.0 * k[2] - power)
+    report.check("no power reports: the count restarts instead of wrapping, the fit goes on", not wrapped and finite and error < 2.0,
+                 "k1 %.4f k2 %.5f, model error %.2f W" % (k[0], k[1], error))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Fit the chassis power model to logged referee data and simulate the power limiter")
+    parser.add_argument("--log", help="csv log, see header of this script for the columns")
+    parser.add_argument("--power-limit", type=float, default=60.0, help="referee chassis power limit, W")
+    parser.add_argument("--duration", type=float, default=12.0, help="closed loop simulation time, s")
+    parser.add_argument("--noise", type=float, default=1.0, help="referee power noise, W")
+    args = parser.parse_args()
+    report = Report()
+
+    # true motors differ from the default model, online fit has to find them
+    true_k = (0.22, 0.0172, 1.1)
+    if args.log:
+        log = read_log(args.log)
+        print("log %s, %d periods" % (args.log, len(log)))
+    else:
+        _, _, log = run_closed_loop(args.duration, args.power_limit, False, true_k, args.noise)
+        print("synthetic log, true k1 %.4f k2 %.5f k3 %.3f" % true_k)
+    analyse_log(log)
+
+    for use_limiter in (False, True):
+        stats, limiter, _ = run_closed_loop(args.duration, args.power_limit, use_limiter, true_k, args.noise)
+        print("%-16s limit %.0f W: peak %6.1f W, min buffer %5.1f J, buffer empty %.2f s, limited %4.1f%% of time, mean wheel distance %.1f m%s" % (
+            "with limiter" if use_limiter else "without limiter", args.power_limit, stats["max_power"], stats["min_buffer"],
+            stats["buffer_empty_s"], 100.0 * stats["limited_ratio"], stats["distance"],
+            ", online k1 %.4f k2 %.5f" % (limiter.k[0], limiter.k[1]) if use_limiter else ""))
+        if use_limiter:
+            report.check("limiter: buffer energy never runs out", stats["buffer_empty_s"] == 0.0)
+    test_referee_gaps(report)
+    if not report.ok:
+        raise SystemExit("chassis power simulation failed")
+
+
+if __name__ == "__main__":
+    main()
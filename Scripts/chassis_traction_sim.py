@@ -0,0 +1,160 @@
+# Host simulation of the mecanum traction controller (application/chassis_traction_control.c)
+# A 4-wheel mecanum chassis with a slip dependent tyre force (peak grip at small slip, less grip when spinning) is driven
+# by the 1kHz wheel speed PIDs of chassis_task.c, with and without traction control, on low and high friction floors.
+# Reports time to reach the target speed, electrical energy and kinetic energy gained per joule.
+# chassis_traction_control(), and the speed PIDs of chassis_move set up as chassis_init does, are the firmware's, built
+# by firmware_host.py. Exit code is non-zero when traction control does not improve acceleration per joule on the low
+# friction floor.
+
+import argparse
+import ctypes
+import math
+
+from firmware_host import Firmware
+
+FIRMWARE = Firmware(
+    ["application/chassis_traction_control.c", "application/chassis_task.c", "application/chassis_odometry.c",
+     "components/controller/pid.c"],
+    headers=["chassis_traction_control.h", "chassis_task.h", "chassis_odometry.h", "pid.h"],
+    structs={"chassis_move_t": {"wheel_rot_radii": ctypes.c_float, "motor_chassis": ctypes.c_uint8,
+                                "motor_speed_pid": ctypes.c_uint8},
+             "chassis_motor_t": {"speed": ctypes.c_float, "speed_set": ctypes.c_float},
+             "pid_type_def": {"out": ctypes.c_float},
+             "chassis_loop_timing_t": {"dt": ctypes.c_float},
+             "chassis_odometry_t": {"accel_x": ctypes.c_float, "accel_y": ctypes.c_float}},
+    constants=["CHASSIS_CONTROL_TIME_S", "M3508_MOTOR_GEAR_RATIO", "DRIVE_WHEEL_RADIUS", "MOTOR_DISTANCE_TO_CENTER_DEFAULT",
+               "CHASSIS_MOTOR_RPM_TO_VECTOR_SEN", "M3508_MOTOR_SPEED_PID_KP", "M3508_MOTOR_SPEED_PID_KI",
+               "M3508_MOTOR_SPEED_PID_KD", "M3508_MOTOR_SPEED_PID_MAX_OUT", "M3508_MOTOR_SPEED_PID_MAX_IOUT",
+               "PID_POSITION"],
+    prototypes={"PID_init": (None, [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_void_p, ctypes.c_float, ctypes.c_float,
+                                    ctypes.c_float, ctypes.c_void_p])})
+CHASSIS = FIRMWARE.global_struct("chassis_move_t", "chassis_move")
+TIMING = FIRMWARE.global_struct("chassis_loop_timing_t", "chassis_loop_timing")
+ODOMETRY = FIRMWARE.global_struct("chassis_odometry_t", "chassis_odometry_data")
+MOTORS = [FIRMWARE.view("chassis_motor_t", CHASSIS.field_address("motor_chassis"), i) for i in range(4)]
+PIDS = [FIRMWARE.view("pid_type_def", CHASSIS.field_address("motor_speed_pid"), i) for i in range(4)]
+
+DT = FIRMWARE.CHASSIS_CONTROL_TIME_S
+GEAR = FIRMWARE.M3508_MOTOR_GEAR_RATIO
+WHEEL_RADIUS = FIRMWARE.DRIVE_WHEEL_RADIUS
+ROT_RADIUS = FIRMWARE.MOTOR_DISTANCE_TO_CENTER_DEFAULT
+RPM_TO_VECTOR = FIRMWARE.CHASSIS_MOTOR_RPM_TO_VECTOR_SEN
+CAN_TO_AMP = 20.0 / 16384.0
+
+# wheel speed = WHEEL_SX * vx + WHEEL_SY * vy - R * wz, as in chassis_traction_control.c
+WHEEL_SX = (-1.0, 1.0, 1.0, -1.0)
+WHEEL_SY = (-1.0, -1.0, 1.0, 1.0)
+
+# true motor power, same form as chassis_power_control.h
+POWER_K = (0.25, 0.0156, 1.0)
+
+
+def chassis_init():
+    """the part of chassis_init the wheel loop and traction control use"""
+    gains = (ctypes.c_float * 3)(FIRMWARE.M3508_MOTOR_SPEED_PID_KP, FIRMWARE.M3508_MOTOR_SPEED_PID_KI,
+                                 FIRMWARE.M3508_MOTOR_SPEED_PID_KD)
+    for pid in PIDS:
+        FIRMWARE.PID_init(pid.address, int(FIRMWARE.PID_POSITION), gains, FIRMWARE.M3508_MOTOR_SPEED_PID_MAX_OUT,
+                          FIRMWARE.M3508_MOTOR_SPEED_PID_MAX_IOUT, 0.0, ctypes.cast(FIRMWARE.lib.raw_err_handler, ctypes.c_void_p))
+    CHASSIS.wheel_rot_radii = [ROT_RADIUS] * 4
+    TIMING.dt = DT
+    FIRMWARE.chassis_traction_control_init()
+
+
+class MecanumChassis:
+    def __init__(self, mu, mass=20.0, seed=12345):
+        self.mass = mass
+        self.inertia_z = 0.6
+        self.mu = mu
+        self.normal = mass * 9.81 / 4.0
+        self.rotor_inertia = 1.5e-5 + 8e-4 / GEAR ** 2
+        self.torque_constant = 0.3 / GEAR
+        self.omega = [0.0] * 4  # rotor rad/s
+        self.vx = self.vy = self.wz = 0.0
+        self.accel = (0.0, 0.0)
+        self.seed = seed
+
+    def rand(self):
+        self.seed = (1103515245 * self.seed + 12345) & 0x7FFFFFFF
+        return self.seed / float(0x7FFFFFFF) - 0.5
+
+    def grip(self, slip):
+        # peak grip at a few cm/s of slip, a spinning wheel only keeps 75% of it
+        return self.mu * self.normal * math.tanh(slip / 0.03) * (1.0 - 0.25 * math.tanh(abs(slip) / 0.5))
+
+    def rpm(self):
+        return [round(w * 60.0 / (2.0 * math.pi)) for w in self.omega]
+
+    def step(self, commands):
+        sub = 10
+        h = DT / sub
+        energy = 0.0
+        for _ in range(sub):
+            fx = fy = mz = 0.0
+            for i, command in enumerate(commands):
+                current = command * CAN_TO_AMP
+                surface = self.omega[i] / GEAR * WHEEL_RADIUS
+                ground = WHEEL_SX[i] * self.vx + WHEEL_SY[i] * self.vy - ROT_RADIUS * self.wz
+                force = self.grip(surface - ground)
+                fx += WHEEL_SX[i] * force
+                fy += WHEEL_SY[i] * force
+                mz -= ROT_RADIUS * force
+                self.omega[i] += (self.torque_constant * current - force * WHEEL_RADIUS / GEAR) / self.rotor_inertia * h
+                energy += (POWER_K[0] * current * current + POWER_K[1] * current * self.omega[i] + POWER_K[2]) * h
+            self.vx += fx / self.mass * h
+            self.vy += fy / self.mass * h
+            self.wz += mz / self.inertia_z * h
+            self.accel = (fx / self.mass, fy / self.mass)
+        return energy
+
+    def imu(self, noise, bias):
+        return self.accel[0] + noise * self.rand() + bias, self.accel[1] + noise * self.rand() - bias
+
+
+def run(mu, vx_set, vy_set, use_traction, duration, noise):
+    chassis = MecanumChassis(mu)
+    chassis_init()
+    energy = 0.0
+    reach_time = None
+    target = math.hypot(vx_set, vy_set)
+    for motor, sx, sy in zip(MOTORS, WHEEL_SX, WHEEL_SY):
+        motor.speed_set = sx * vx_set + sy * vy_set
+    for n in range(int(duration / DT)):
+        # chassis_control_loop: wheel speed PIDs, then traction control on their output
+        for motor, pid, rpm in zip(MOTORS, PIDS, chassis.rpm()):
+            motor.speed = RPM_TO_VECTOR * rpm
+            FIRMWARE.PID_calc(pid, motor.speed, motor.speed_set, DT)
+        if use_traction:
+            ODOMETRY.accel_x, ODOMETRY.accel_y = chassis.imu(noise, 0.03 * noise)
+            FIRMWARE.chassis_traction_control()
+        energy += chassis.step([float(int(pid.out)) for pid in PIDS])
+        if reach_time is None and math.hypot(chassis.vx, chassis.vy) >= 0.9 * target:
+            reach_time = (n + 1) * DT
+    kinetic = 0.5 * chassis.mass * (chassis.vx ** 2 + chassis.vy ** 2)
+    return reach_time, energy, kinetic
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate mecanum traction control on low and high friction floors")
+    parser.add_argument("--duration", type=float, default=1.5, help="simulation time, s")
+    parser.add_argument("--noise", type=float, default=1.0, help="scale of imu noise and bias")
+    args = parser.parse_args()
+
+    ok = True
+    for name, mu in (("low friction", 0.3), ("high friction", 0.9)):
+        for direction, vx_set, vy_set in (("forward", 2.5, 0.0), ("diagonal", 1.8, 1.8)):
+            results = []
+            for use_traction in (False, True):
+                reach_time, energy, kinetic = run(mu, vx_set, vy_set, use_traction, args.duration, args.noise)
+                results.append(kinetic / energy)
+                print("%-13s mu %.1f %-8s %-11s: 90%% speed at %s, energy %6.1f J, kinetic %5.1f J, %.3f J/J" % (
+                    name, mu, direction, "traction" if use_traction else "no traction",
+                    "%.3f s" % reach_time if reach_time is not None else "never", energy, kinetic, kinetic / energy))
+            if mu < 0.5 and results[1] <= results[0]:
+                ok = False
+    if not ok:
+        raise SystemExit("traction control did not improve acceleration per joule on the low friction floor")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,261 @@
+# Host simulation of the burst fire scheduler (application/fire_scheduler.c) against barrel heat and allowance.
+# Plant: trigger output shaft speed following its set-point with a first order lag (the speed PID of shoot.c and the
+# M2006), a projectile leaving each time the wheel passes SHOOT_HEAT_SHOT_PHASE of a slot. The referee heat rises by
+# one bullet per projectile and cools in 10Hz steps, its reports reach the local heat model with UART latency.
+# The scheduler is compared with the previous auto fire: trigger at AUTO_FIRE_TRIGGER_SPEED, stopped while
+# shoot_heat_is_overheated().
+# Checks:
+#   - the referee heat never goes over the limit, at every heat and cooling level
+#   - as many shots as the previous auto fire within the same time, the heat headroom at full fire rate
+#   - never more shots than the projectile allowance
+#   - a click is exactly one shot, the wheel rests on a slot boundary after a burst
+#   - the plan is the earliest schedule: no shot could go earlier without the heat over the limit
+# Scheduler and heat model are application/fire_scheduler.c and application/shoot_heat.c built by firmware_host.py with
+# SHOOT_FIRE_SCHEDULER on, fed the trigger motor feedback and referee frames the way the shoot task and the referee
+# parser get them. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["application/fire_scheduler.c", "application/shoot_heat.c", "components/algorithm/shot_detector.c",
+     "application/referee.c", "application/CAN_receive.c", "application/detect_task.c"],
+    headers=["fire_scheduler.h", "shoot_heat.h", "shoot.h", "referee.h", "protocol.h"],
+    structs={
+        "fire_scheduler_t": {"step_count": ctypes.c_uint32},
+        "shoot_heat_t": {"trigger_ecd": ctypes.c_uint32},
+        "motor_measure_t": {"ecd": ctypes.c_uint16, "speed_rpm": ctypes.c_int16},
+        "ext_game_state_t": {"stage_remain_time": ctypes.c_uint16},
+        "ext_game_robot_state_t": {"shooter_barrel_cooling_value": ctypes.c_uint16, "shooter_barrel_heat_limit": ctypes.c_uint16},
+        "ext_power_heat_data_t": {"shooter_17mm_1_barrel_heat": ctypes.c_uint16},
+        "ext_projectile_allowance_t": {"projectile_allowance_17mm": ctypes.c_uint16},
+    },
+    constants=["TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO", "TRIGGER_MOTOR_GEAR_RATIO", "TRIGGER_MOTOR_ECD_TO_ANGLE", "ECD_RANGE",
+               "AUTO_FIRE_TRIGGER_SPEED", "SHOOT_CONTROL_TIME_MS", "SHOOT_HEAT_PER_BULLET", "SHOOT_HEAT_SHOT_PHASE",
+               "SHOOT_HEAT_MARGIN", "FIRE_SCHEDULER_MAX_BURST", "FIRE_SCHEDULER_HOLD_BURST", "FIRE_SCHEDULER_MIN_INTERVAL_MS",
+               "FIRE_SCHEDULER_SLOT_ECD", "FIRE_SCHEDULER_DONE_ECD", "MOTOR_INDEX_TRIGGER", "REF_PROTOCOL_HEADER_SIZE",
+               "GAME_STATE_CMD_ID", "ROBOT_STATE_CMD_ID", "POWER_HEAT_DATA_CMD_ID", "PROJECTILE_ALLOWANCE_CMD_ID"],
+    config={"SHOOT_FIRE_SCHEDULER": 1, "SHOOT_HEAT_FRICTION_SHOT_DETECTION": 0, "REVERSE_TRIGGER_DIRECTION": 0})
+SCHEDULER = FIRMWARE.global_struct("fire_scheduler_t", "fire_scheduler_data")
+HEAT = FIRMWARE.global_struct("shoot_heat_t", "shoot_heat_data")
+TRIGGER_MOTOR = FIRMWARE.global_struct("motor_measure_t", "motor_chassis", int(FIRMWARE.MOTOR_INDEX_TRIGGER))
+
+TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO = FIRMWARE.TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO
+TRIGGER_MOTOR_GEAR_RATIO = FIRMWARE.TRIGGER_MOTOR_GEAR_RATIO
+TRIGGER_MOTOR_ECD_TO_ANGLE = FIRMWARE.TRIGGER_MOTOR_ECD_TO_ANGLE
+ECD_RANGE = int(FIRMWARE.ECD_RANGE)
+AUTO_FIRE_TRIGGER_SPEED = FIRMWARE.AUTO_FIRE_TRIGGER_SPEED
+SHOOT_CONTROL_TIME_MS = int(FIRMWARE.SHOOT_CONTROL_TIME_MS)
+SHOOT_HEAT_PER_BULLET = FIRMWARE.SHOOT_HEAT_PER_BULLET
+SHOOT_HEAT_SHOT_PHASE = FIRMWARE.SHOOT_HEAT_SHOT_PHASE
+SHOOT_HEAT_MARGIN = FIRMWARE.SHOOT_HEAT_MARGIN
+FIRE_SCHEDULER_MAX_BURST = int(FIRMWARE.FIRE_SCHEDULER_MAX_BURST)
+FIRE_SCHEDULER_HOLD_BURST = int(FIRMWARE.FIRE_SCHEDULER_HOLD_BURST)
+FIRE_SCHEDULER_MIN_INTERVAL_MS = int(FIRMWARE.FIRE_SCHEDULER_MIN_INTERVAL_MS)
+FIRE_SCHEDULER_SLOT_ECD = int(FIRMWARE.FIRE_SCHEDULER_SLOT_ECD)
+FIRE_SCHEDULER_DONE_ECD = int(FIRMWARE.FIRE_SCHEDULER_DONE_ECD)
+GAME_PROGRESS_RUNNING = 4
+
+TRIGGER_TIME_CONSTANT_MS = 15.0
+# the speed loop lag carries the wheel a little past the done threshold
+REST_ECD = 1.5 * FIRE_SCHEDULER_DONE_ECD
+REFEREE_PERIOD_MS = 100
+REFEREE_REPORT_DELAY_MS = (20, 60)  # heat packet latency after the referee's own update
+
+
+def referee_frame(cmd_id, data):
+    """a frame as referee_data_solve takes it from the unpacker, header and CRCs unchecked there"""
+    frame = bytes(int(FIRMWARE.REF_PROTOCOL_HEADER_SIZE)) + int(cmd_id).to_bytes(2, "little") + data
+    return ctypes.create_string_buffer(frame, len(frame) + 2)
+
+
+def plan(heat, heat_limit, cooling_rate, count, first_time):
+    plan_time = (ctypes.c_uint16 * FIRE_SCHEDULER_MAX_BURST)()
+    planned = FIRMWARE.fire_scheduler_plan(heat, heat_limit, cooling_rate, count, first_time, plan_time)
+    return list(plan_time[:planned])
+
+
+class Robot:
+    """Trigger and referee around the firmware heat model and scheduler"""
+
+    def __init__(self, rng, heat_limit, cooling_rate, allowance=None, referee_reports=True):
+        # allowance: projectiles reported at the start of the game, None before the game
+        self.rng = rng
+        self.referee_reports = referee_reports
+        self.heat_limit = heat_limit
+        self.cooling_rate = cooling_rate
+        self.trigger_ecd = rng.uniform(0.0, ECD_RANGE)  # rotor ecd fed
+        self.rest = self.trigger_ecd  # on a slot boundary
+        self.speed = 0.0  # output shaft rad/s
+        self.referee_heat = 0.0
+        self.max_heat = 0.0
+        self.shot_times = []
+        self.reports = []  # (arrival time, heat)
+        FIRMWARE.init_referee_struct_data()
+        state = FIRMWARE.new("ext_game_robot_state_t", shooter_barrel_cooling_value=int(cooling_rate),
+                             shooter_barrel_heat_limit=int(heat_limit))
+        FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.ROBOT_STATE_CMD_ID, state.raw()))
+        if allowance is not None:
+            # game_progress is the high nibble of the first byte
+            game_state = FIRMWARE.new("ext_game_state_t").raw()
+            FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.GAME_STATE_CMD_ID, bytes([GAME_PROGRESS_RUNNING << 4]) + game_state[1:]))
+            report = FIRMWARE.new("ext_projectile_allowance_t", projectile_allowance_17mm=allowance)
+            FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.PROJECTILE_ALLOWANCE_CMD_ID, report.raw()))
+        self.feedback()
+        FIRMWARE.shoot_heat_init()
+        FIRMWARE.fire_scheduler_init()
+
+    def shots(self):
+        return len(self.shot_times)
+
+    def feedback(self):
+        TRIGGER_MOTOR.ecd = int(self.trigger_ecd) % ECD_RANGE
+        TRIGGER_MOTOR.speed_rpm = int(self.speed * TRIGGER_MOTOR_GEAR_RATIO * 60.0 / (2.0 * math.pi))
+
+    def control(self, t):
+        """the shoot task side: feedback, then the heat model"""
+        self.feedback()
+        FIRMWARE.shoot_heat_update(t)
+
+    def step(self, t, speed_set):
+        self.speed += (speed_set - self.speed) / TRIGGER_TIME_CONSTANT_MS
+        wheel = self.speed / TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO / 1000.0
+        before = self.trigger_ecd
+        self.trigger_ecd += wheel / TRIGGER_MOTOR_ECD_TO_ANGLE
+        # projectile leaves at SHOOT_HEAT_SHOT_PHASE of each slot, slots counted from where the wheel rests
+        phase = SHOOT_HEAT_SHOT_PHASE * FIRE_SCHEDULER_SLOT_ECD
+        if math.floor((self.trigger_ecd - self.rest - phase) / FIRE_SCHEDULER_SLOT_ECD) > math.floor((before - self.rest - phase) / FIRE_SCHEDULER_SLOT_ECD):
+            self.shot_times.append(t)
+            self.referee_heat += SHOOT_HEAT_PER_BULLET
+            self.max_heat = max(self.max_heat, self.referee_heat)
+        if t % REFEREE_PERIOD_MS == 0:
+            self.referee_heat = max(0.0, self.referee_heat - self.cooling_rate * REFEREE_PERIOD_MS / 1000.0)
+            self.reports.append((t + self.rng.randint(*REFEREE_REPORT_DELAY_MS), self.referee_heat))
+        while self.referee_reports and self.reports and self.reports[0][0] <= t:
+            _, heat = self.reports.pop(0)
+            power_heat = FIRMWARE.new("ext_power_heat_data_t", shooter_17mm_1_barrel_heat=int(heat))
+            FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.POWER_HEAT_DATA_CMD_ID, power_heat.raw()))
+
+    def slot_offset(self):
+        """rotor ecd off the nearest slot boundary"""
+        rest = (self.trigger_ecd - self.rest) % FIRE_SCHEDULER_SLOT_ECD
+        return min(rest, FIRE_SCHEDULER_SLOT_ECD - rest)
+
+
+def run_scheduler(robot, fire_held, clicks, duration):
+    """fire_held(t): hold fire, clicks: times of single clicks"""
+    speed_set = 0.0
+    for t in range(1, duration + 1):
+        if t % SHOOT_CONTROL_TIME_MS == 0:
+            robot.control(t)
+            if t in clicks:
+                FIRMWARE.fire_scheduler_request(1)
+            if fire_held(t):
+                FIRMWARE.fire_scheduler_hold(FIRE_SCHEDULER_HOLD_BURST)
+            elif not clicks:
+                FIRMWARE.fire_scheduler_cancel()
+            speed_set = FIRMWARE.fire_scheduler_update(t)
+        robot.step(t, speed_set)
+
+
+def run_previous(robot, fire_held, duration):
+    speed_set = 0.0
+    for t in range(1, duration + 1):
+        if t % SHOOT_CONTROL_TIME_MS == 0:
+            robot.control(t)
+            speed_set = AUTO_FIRE_TRIGGER_SPEED if fire_held(t) and not FIRMWARE.shoot_heat_is_overheated() else 0.0
+        robot.step(t, speed_set)
+
+
+# barrel heat limit and cooling per second, from the lowest to the highest infantry levels
+LEVELS = [(50.0, 10.0), (100.0, 20.0), (200.0, 40.0), (300.0, 60.0), (400.0, 80.0)]
+
+
+def test_sustained(report, seed):
+    duration = 10000
+    for heat_limit, cooling_rate in LEVELS:
+        name = "limit %d cooling %d" % (heat_limit, cooling_rate)
+        robot = Robot(random.Random(seed), heat_limit, cooling_rate)
+        run_scheduler(robot, lambda t: True, set(), duration)
+        previous = Robot(random.Random(seed), heat_limit, cooling_rate)
+        run_previous(previous, lambda t: True, duration)
+        report.check("%s: heat never over the limit" % name, robot.max_heat <= heat_limit,
+                     "max %.0f, previous auto fire max %.0f" % (robot.max_heat, previous.max_heat))
+        # the upper bound: the headroom, then the cooling
+        bound = int((heat_limit - SHOOT_HEAT_MARGIN + cooling_rate * duration / 1000.0) / SHOOT_HEAT_PER_BULLET)
+        report.check("%s: as many shots as the previous auto fire" % name, robot.shots() >= previous.shots() - 1,
+                     "%d shots, previous %d, bound %d" % (robot.shots(), previous.shots(), bound))
+        # the headroom goes at full fire rate; the re-sync counts the shots of the report latency again, so without
+        # the reports to see the scheduler alone
+        exact = Robot(random.Random(seed), heat_limit, cooling_rate, referee_reports=False)
+        run_scheduler(exact, lambda t: True, set(), 3000)
+        headroom = int((heat_limit - SHOOT_HEAT_MARGIN) / SHOOT_HEAT_PER_BULLET)
+        span = exact.shot_times[headroom - 1] - exact.shot_times[0]
+        full_rate = (headroom - 1) * FIRE_SCHEDULER_MIN_INTERVAL_MS
+        report.check("%s: the headroom at full fire rate" % name, span <= full_rate + SHOOT_CONTROL_TIME_MS,
+                     "%d shots in %d ms, full rate %d ms" % (headroom, span, full_rate))
+
+
+def test_allowance(report, seed):
+    robot = Robot(random.Random(seed), 400.0, 80.0, 7)
+    run_scheduler(robot, lambda t: True, set(), 3000)
+    report.check("allowance: never more shots than allowed", robot.shots() == 7,
+                 "%d shots of 7, %d steps" % (robot.shots(), SCHEDULER.step_count))
+
+
+def test_clicks(report, seed):
+    robot = Robot(random.Random(seed), 200.0, 40.0)
+    clicks = {400, 1000, 1004, 2000}
+    run_scheduler(robot, lambda t: False, clicks, 3000)
+    rest = robot.slot_offset()
+    report.check("clicks: one shot per click", robot.shots() == len(clicks), "%d shots for %d clicks" % (robot.shots(), len(clicks)))
+    report.check("clicks: wheel rests on a slot boundary", FIRMWARE.fire_scheduler_is_idle() and rest <= REST_ECD,
+                 "%.0f ecd off" % rest)
+    # released mid burst: the current step finishes, nothing after it
+    robot = Robot(random.Random(seed), 200.0, 40.0)
+    run_scheduler(robot, lambda t: t < 502, set(), 1500)
+    rest = robot.slot_offset()
+    report.check("release: burst stops on a slot boundary", robot.shots() == SCHEDULER.step_count and rest <= REST_ECD,
+                 "%d shots, %d steps, %.0f ecd off" % (robot.shots(), SCHEDULER.step_count, rest))
+
+
+def test_plan(report, seed):
+    rng = random.Random(seed)
+    worst = 0
+    for _ in range(500):
+        heat_limit, cooling_rate = rng.choice(LEVELS)
+        heat = rng.uniform(0.0, heat_limit)
+        count = rng.randint(1, FIRE_SCHEDULER_MAX_BURST)
+        times = plan(heat, heat_limit, cooling_rate, count, 0)
+        # every shot is feasible, and one ms earlier is not unless the interval is the limit
+        h, last = heat, 0.0
+        for k, time in enumerate(times):
+            h = max(h - cooling_rate * (time - last) / 1000.0, 0.0)
+            assert h + SHOOT_HEAT_PER_BULLET + SHOOT_HEAT_MARGIN <= heat_limit + 1e-3, (heat, heat_limit, times)
+            earlier = h + cooling_rate / 1000.0 + SHOOT_HEAT_PER_BULLET + SHOOT_HEAT_MARGIN > heat_limit
+            interval = time == 0 if k == 0 else time - times[k - 1] <= FIRE_SCHEDULER_MIN_INTERVAL_MS + 1
+            worst += 0 if (earlier or interval) else 1
+            h += SHOOT_HEAT_PER_BULLET
+            last = time
+    report.check("plan: every shot at its earliest time", worst == 0, "%d shots could go earlier" % worst)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the burst fire scheduler against barrel heat and allowance")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    report = Report()
+    test_sustained(report, args.seed)
+    test_allowance(report, args.seed)
+    test_clicks(report, args.seed)
+    test_plan(report, args.seed)
+    if not report.ok:
+        raise SystemExit("fire scheduler simulation failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,371 @@
+# Builds firmware sources for the host with gcc and loads them with ctypes, so the Scripts tests drive the C that runs on
+# the robot instead of a copy of it.
+#   firmware = Firmware(["components/algorithm/biquad_filter.c"],
+#                       headers=["biquad_filter.h", "gimbal_task.h"],
+#                       structs={"biquad_filter_t": {"stages": c_uint8, "coeffs": c_float}},
+#                       constants=["GIMBAL_CONTROL_TIME_S"])
+#   f = firmware.new("biquad_filter_t")
+#   firmware.biquad_filter_init(f, None, 0, 250.0)
+#   firmware.biquad_filter_calc(f, 1.0), f.stages, f.coeffs[0], firmware.GIMBAL_CONTROL_TIME_S
+# Sources are compiled together with components/algorithm/user_lib.c and the host fakes of Scripts/host into one shared
+# library. Scripts/host is searched first for includes: it holds stand-ins for what only builds for the target
+# (CMSIS-DSP, the FreeRTOS port, the DWT cycle counter, the hardware RNG) and the fakes a test links in place of tasks
+# and drivers; chassis_task_host.c and referee_usart_task_host.c are those tasks with their statics callable.
+# Whatever a source refers to and nothing defines is filled in: a function that aborts naming itself if called, a zeroed
+# block for data, so a source builds without dragging in its whole task; a test that gets there needs a fake.
+# Function prototypes are read from the headers, every extern declaration with plain scalar or pointer parameters gets
+# its ctypes argtypes and restype. Struct layouts and macro values come from the compiler: a generated source exports
+# sizeof and offsetof of the fields named in structs, and the value of every name in constants. Arrays are found from
+# the field size, so a field is declared with its element type only. A Struct is passed to a function by pointer.
+# Compile switches of the firmware headers are set with config={"NAME": value}: the build then runs on a copy of the
+# sources and headers with those #define lines replaced, so every translation unit sees the same value.
+
+import ctypes
+import ctypes.util
+import glob
+import os
+import re
+import shutil
+import subprocess
+import tempfile
+
+SCRIPTS_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.dirname(SCRIPTS_DIR)
+HOST_DIR = os.path.join(SCRIPTS_DIR, "host")
+# firmware directories copied for a config build, the rest are vendor code
+FIRMWARE_DIRS = ["Inc", "application", "application/protocol", "components/algorithm", "components/controller",
+                 "components/support", "components/devices", "bsp/boards"]
+INCLUDE_DIRS = [
+    HOST_DIR,
+    "Inc",
+    "application",
+    "application/protocol",
+    "components/algorithm",
+    "components/controller",
+    "components/support",
+    "components/devices",
+    "bsp/boards",
+    "Drivers/STM32F4xx_HAL_Driver/Inc",
+    "Drivers/CMSIS/Device/ST/STM32F4xx/Include",
+    "Drivers/CMSIS/Include",
+    "Middlewares/Third_Party/FreeRTOS/Source/include",
+    "Middlewares/Third_Party/FreeRTOS/Source/CMSIS_RTOS",
+]
+BASE_SOURCES = ["components/algorithm/user_lib.c"]
+HOST_SOURCES = [os.path.join(HOST_DIR, name) for name in ("arm_math_host.c", "rtos_host.c", "bsp_delay_host.c", "bsp_rng_host.c")]
+HOST_LIBS = [ctypes.CDLL(None), ctypes.CDLL(ctypes.util.find_library("m"))]
+CFLAGS = [
+    "-std=gnu11", "-O2", "-fPIC", "-ffp-contract=off", "-fno-strict-aliasing",
+    "-ffreestanding", "-U__INT64_TYPE__", "-D__INT64_TYPE__=long long int", "-U__UINT64_TYPE__",
+    "-D__UINT64_TYPE__=long long unsigned int", "-D__packed=", "-DSTM32F407xx", "-DUSE_HAL_DRIVER", "-w",
+]
+
+C_TYPES = {
+    "void": None,
+    "fp32": ctypes.c_float,
+    "float": ctypes.c_float,
+    "float32_t": ctypes.c_float,
+    "fp64": ctypes.c_double,
+    "double": ctypes.c_double,
+    "bool_t": ctypes.c_uint8,
+    "uint8_t": ctypes.c_uint8,
+    "int8_t": ctypes.c_int8,
+    "uint16_t": ctypes.c_uint16,
+    "int16_t": ctypes.c_int16,
+    "uint32_t": ctypes.c_uint32,
+    "int32_t": ctypes.c_int32,
+    "int": ctypes.c_int,
+    "unsigned int": ctypes.c_uint,
+    "char": ctypes.c_char,
+}
+PROTOTYPE = re.compile(r"^\s*(?:extern\s+)?((?:const\s+)?(?:unsigned\s+)?\w+)\s*(\**)\s*(\w+)\s*\(([^;{}()]*)\)\s*;", re.M)
+
+
+def _repo_path(path):
+    return path if os.path.isabs(path) else os.path.join(REPO_DIR, path)
+
+
+def _find_header(name):
+    for directory in INCLUDE_DIRS:
+        path = os.path.join(_repo_path(directory), name)
+        if os.path.exists(path):
+            return path
+    raise FileNotFoundError(name)
+
+
+def _scalar_type(text):
+    """ctypes type of a C type name, enums (_e) are int, None if it is not a plain scalar"""
+    text = re.sub(r"\b(const|volatile|struct)\b", "", text).strip()
+    text = re.sub(r"\s+", " ", text)
+    if text in C_TYPES:
+        return C_TYPES[text]
+    if text.endswith("_e"):
+        return ctypes.c_int
+    raise KeyError(text)
+
+
+def _parse_prototypes(header_text):
+    prototypes = {}
+    text = re.sub(r"/\*.*?\*/", "", header_text, flags=re.S)
+    text = re.sub(r"//[^\n]*", "", text)
+    for match in PROTOTYPE.finditer(text):
+        ret, ret_ptr, name, params = match.groups()
+        if ret.strip() in ("return", "typedef", "define"):
+            continue
+        try:
+            restype = ctypes.c_void_p if ret_ptr else _scalar_type(ret)
+            argtypes = []
+            params = params.strip()
+            if params not in ("", "void"):
+                for param in params.split(","):
+                    if ("*" in param) or ("[" in param):
+                        argtypes.append(ctypes.c_void_p)
+                    else:
+                        argtypes.append(_scalar_type(re.sub(r"\w+\s*$", "", param.strip()) or param))
+        except KeyError:
+            # struct by value or a function pointer type, declared by the test if it needs the function
+            continue
+        prototypes[name] = (restype, argtypes)
+    return prototypes
+
+
+class Struct:
+    """a firmware struct in memory owned by python, fields read and written by name"""
+
+    def __init__(self, layout, buffer=None):
+        object.__setattr__(self, "_layout", layout)
+        if buffer is None:
+            buffer = ctypes.create_string_buffer(layout["size"])
+        object.__setattr__(self, "_buffer", buffer)
+        object.__setattr__(self, "_as_parameter_", ctypes.c_void_p(ctypes.addressof(buffer)))
+
+    @property
+    def address(self):
+        return ctypes.addressof(self._buffer)
+
+    def field_address(self, name):
+        """address of a field, for a view of a struct or struct array inside this one"""
+        return ctypes.addressof(self._field(name))
+
+    def _field(self, name):
+        try:
+            offset, field_type = self._layout["fields"][name]
+        except KeyError:
+            raise AttributeError("%s has no field %s in the test's struct list" % (self._layout["name"], name))
+        return field_type.from_address(self.address + offset)
+
+    def __getattr__(self, name):
+        value = self._field(name)
+        if isinstance(value, ctypes.Array):
+            return list(value)
+        return value.value
+
+    def __setattr__(self, name, value):
+        field = self._field(name)
+        if isinstance(field, ctypes.Array):
+            for i, item in enumerate(value):
+                field[i] = item
+        else:
+            field.value = value
+
+    def raw(self):
+        return bytes(self._buffer)
+
+
+class StructArray:
+    def __init__(self, layout, rows):
+        self._layout = layout
+        self._buffer = ctypes.create_string_buffer(max(1, layout["size"] * len(rows)))
+        self._as_parameter_ = ctypes.c_void_p(ctypes.addressof(self._buffer))
+        self._items = []
+        for i, row in enumerate(rows):
+            item = Struct(layout, (ctypes.c_char * layout["size"]).from_buffer(self._buffer, i * layout["size"]))
+            for name, value in row.items():
+                setattr(item, name, value)
+            self._items.append(item)
+
+    def __getitem__(self, index):
+        return self._items[index]
+
+    def __len__(self):
+        return len(self._items)
+
+
+class Firmware:
+    def __init__(self, sources, headers=(), structs=None, constants=(), defines=None, prototypes=None, config=None):
+        structs = structs or {}
+        defines = defines or {}
+        self._build_dir = tempfile.TemporaryDirectory(prefix="firmware_host_")
+        self._root = self._configure(config) if config else REPO_DIR
+        layout_source = os.path.join(self._build_dir.name, "host_layout.c")
+        with open(layout_source, "w") as layout_file:
+            layout_file.write(self._layout_code(headers, structs, constants))
+        library = self._build(list(sources) + [layout_source], defines)
+        self.lib = ctypes.CDLL(library)
+        self._prototypes = {}
+        for header in headers:
+            with open(_find_header(header), encoding="latin-1") as header_file:
+                self._prototypes.update(_parse_prototypes(header_file.read()))
+        self._prototypes.update(prototypes or {})
+        self._layouts = {}
+        for type_name, fields in structs.items():
+            self._layouts[type_name] = self._read_layout(type_name, fields)
+        for name in constants:
+            self.__dict__[name] = ctypes.c_double.in_dll(self.lib, "host_const_" + name).value
+
+    def _configure(self, config):
+        """copy of the firmware sources and headers with the config switches set, returns its root"""
+        root = os.path.join(self._build_dir.name, "firmware")
+        for directory in FIRMWARE_DIRS:
+            os.makedirs(os.path.join(root, directory), exist_ok=True)
+            for path in glob.glob(os.path.join(REPO_DIR, directory, "*.[ch]")):
+                shutil.copy(path, os.path.join(root, directory))
+        for name, value in config.items():
+            pattern = re.compile(r"^([ \t]*#define[ \t]+%s)\b.*$" % name, re.M)
+            found = False
+            for directory in FIRMWARE_DIRS:
+                for path in glob.glob(os.path.join(root, directory, "*.h")):
+                    with open(path, encoding="latin-1") as header_file:
+                        text = header_file.read()
+                    text, count = pattern.subn(lambda match: "%s %s" % (match.group(1), value), text)
+                    if count:
+                        found = True
+                        with open(path, "w", encoding="latin-1") as header_file:
+                            header_file.write(text)
+            if not found:
+                raise KeyError("no firmware header defines %s" % name)
+        return root
+
+    def _source_path(self, path):
+        if os.path.isabs(path):
+            return path
+        return os.path.join(self._root, path)
+
+    def _compile(self, source, defines):
+        include_dirs = [d if os.path.isabs(d) else os.path.join(self._root if d in FIRMWARE_DIRS else REPO_DIR, d) for d in INCLUDE_DIRS]
+        case_dir = os.path.join(self._build_dir.name, "case_include")
+        command = ["gcc", "-c"] + CFLAGS + ["-I" + d for d in include_dirs] + ["-I" + case_dir]
+        command += ["-D%s=%s" % (name, value) for name, value in defines.items()]
+        obj = os.path.join(self._build_dir.name, "%d_%s.o" % (len(glob.glob(os.path.join(self._build_dir.name, "*.o"))), os.path.basename(source)))
+        while True:
+            result = subprocess.run(command + ["-o", obj, self._source_path(source)], cwd=REPO_DIR, capture_output=True, text=True)
+            if result.returncode == 0:
+                return obj
+            # Keil builds on a case-insensitive file system, an include spelled in another case gets a forwarding header
+            missing = re.search(r"fatal error: ([\w.]+): No such file", result.stderr)
+            found = self._find_header_nocase(missing.group(1), include_dirs) if missing else None
+            if found is None:
+                raise RuntimeError("host build of %s failed:\n%s" % (source, result.stderr))
+            os.makedirs(case_dir, exist_ok=True)
+            with open(os.path.join(case_dir, missing.group(1)), "w") as forward_file:
+                forward_file.write('#include "%s"\n' % found)
+
+    @staticmethod
+    def _find_header_nocase(name, include_dirs):
+        for directory in include_dirs:
+            for path in glob.glob(os.path.join(directory, "*.h")):
+                if os.path.basename(path).lower() == name.lower():
+                    return path
+        return None
+
+    def _build(self, sources, defines):
+        objects = [self._compile(source, defines) for source in BASE_SOURCES + HOST_SOURCES + sources]
+        combined = os.path.join(self._build_dir.name, "firmware.o")
+        subprocess.run(["ld", "-r", "-o", combined] + objects, check=True)
+        placeholder_source = os.path.join(self._build_dir.name, "host_placeholders.c")
+        with open(placeholder_source, "w") as placeholder_file:
+            placeholder_file.write(self._placeholder_code(combined))
+        library = os.path.join(self._build_dir.name, "firmware.so")
+        command = ["gcc", "-shared", "-o", library, combined, self._compile(placeholder_source, {}), "-lm"]
+        subprocess.run(command, check=True)
+        return library
+
+    @staticmethod
+    def _placeholder_code(combined):
+        """symbols the firmware sources use but neither they, the fakes nor the C library define"""
+        undefined = subprocess.run(["nm", "-u", combined], capture_output=True, text=True, check=True).stdout.split()
+        undefined = [name for name in undefined if name not in ("U", "w") and not name.startswith("_") and not any(hasattr(lib, name) for lib in HOST_LIBS)]
+        relocations = subprocess.run(["objdump", "-r", combined], capture_output=True, text=True, check=True).stdout
+        called = set(re.findall(r"R_X86_64_PLT32\s+(\w+)", relocations))
+        lines = ["#include <stdio.h>", "#include <stdlib.h>"]
+        for name in undefined:
+            if name in called:
+                lines.append('void %s(void) { fprintf(stderr, "firmware_host: %s has no fake\\n"); abort(); }' % (name, name))
+            else:
+                lines.append("char %s[4096] __attribute__((aligned(16)));" % name)
+        return "\n".join(lines) + "\n"
+
+    @staticmethod
+    def _symbol(*parts):
+        return "_".join(re.sub(r"\W", "_", part) for part in parts)
+
+    def _layout_code(self, headers, structs, constants):
+        lines = ["#include <stddef.h>"] + ['#include "%s"' % header for header in headers]
+        for type_name, fields in structs.items():
+            lines.append("const unsigned long %s = sizeof(%s);" % (self._symbol("host_sizeof", type_name), type_name))
+            for field in fields:
+                lines.append("const unsigned long %s = offsetof(%s, %s);" % (self._symbol("host_offsetof", type_name, field), type_name, field))
+                lines.append("const unsigned long %s = sizeof(((%s *)0)->%s);" % (self._symbol("host_fieldsize", type_name, field), type_name, field))
+        for name in constants:
+            lines.append("const double host_const_%s = (double)(%s);" % (name, name))
+        return "\n".join(lines) + "\n"
+
+    def _read_layout(self, type_name, fields):
+        def exported(*parts):
+            return ctypes.c_ulong.in_dll(self.lib, self._symbol(*parts)).value
+
+        layout = {"name": type_name, "size": exported("host_sizeof", type_name), "fields": {}}
+        for field, element_type in fields.items():
+            size = exported("host_fieldsize", type_name, field)
+            element_size = ctypes.sizeof(element_type)
+            if size % element_size != 0:
+                raise TypeError("%s.%s is %d bytes, not a whole number of %s" % (type_name, field, size, element_type.__name__))
+            field_type = element_type if size == element_size else element_type * (size // element_size)
+            layout["fields"][field] = (exported("host_offsetof", type_name, field), field_type)
+        return layout
+
+    def new(self, type_name, **values):
+        struct = Struct(self._layouts[type_name])
+        for name, value in values.items():
+            setattr(struct, name, value)
+        return struct
+
+    def new_array(self, type_name, rows):
+        """contiguous structs filled from a list of field dicts, passed to a function as a pointer to the first"""
+        return StructArray(self._layouts[type_name], rows)
+
+    def view(self, type_name, address, index=0):
+        """a Struct over firmware memory, a global or a pointer returned by a function, element index of an array there"""
+        size = self._layouts[type_name]["size"]
+        return Struct(self._layouts[type_name], (ctypes.c_char * size).from_address(address + index * size))
+
+    def global_struct(self, type_name, name, index=0):
+        """a Struct over a firmware global, element index of a global array"""
+        return self.view(type_name, ctypes.addressof(ctypes.c_char.in_dll(self.lib, name)), index)
+
+    def global_value(self, c_type, name):
+        return c_type.in_dll(self.lib, name)
+
+    def __getattr__(self, name):
+        if name.startswith("_"):
+            raise AttributeError(name)
+        function = getattr(self.lib, name)
+        if name in self._prototypes:
+            function.restype, function.argtypes = self._prototypes[name]
+        else:
+            raise AttributeError("no prototype of %s in the test's headers" % name)
+        self.__dict__[name] = function
+        return function
+
+
+def floats(values):
+    return (ctypes.c_float * len(values))(*values)
+
+
+class Report:
+    def __init__(self):
+        self.ok = True
+
+    def check(self, name, passed, detail=""):
+        print("%s %s%s" % ("ok  " if passed else "FAIL", name, (", " + detail) if detail else ""))
+        self.ok = self.ok and passed
@@ -0,0 +1,146 @@
+# Offline LQR gain computation for gimbal axes (angle, rate, integral state)
+# Plant model per axis: J * dw/dt + B * w = u, with u in the unit of the motor command (Nm for 4310, raw current for 6020)
+# Output gains are pasted into the *_LQR_K* macros of application/gimbal_task.h
+# The step response is run on LQR_calc of components/controller/lqr.c, built by firmware_host.py with GIMBAL_USE_LQR on;
+# control period, saturation and integral limit default to the values of application/gimbal_task.h.
+
+import argparse
+import ctypes
+import math
+
+from firmware_host import Firmware
+
+FIRMWARE = Firmware(["components/controller/lqr.c", "components/controller/pid.c"],
+                    headers=["lqr.h", "gimbal_task.h"],
+                    structs={"lqr_type_def": {"out": ctypes.c_float}},
+                    constants=["GIMBAL_CONTROL_TIME_S", "YAW_LQR_MAX_OUT", "YAW_LQR_MAX_INTEGRAL", "PITCH_LQR_MAX_OUT",
+                               "PITCH_LQR_MAX_INTEGRAL"],
+                    config={"GIMBAL_USE_LQR": 1})
+
+
+def mat_mul(a, b):
+    return [[sum(a[i][k] * b[k][j] for k in range(len(b))) for j in range(len(b[0]))] for i in range(len(a))]
+
+
+def mat_add(a, b):
+    return [[a[i][j] + b[i][j] for j in range(len(a[0]))] for i in range(len(a))]
+
+
+def mat_sub(a, b):
+    return [[a[i][j] - b[i][j] for j in range(len(a[0]))] for i in range(len(a))]
+
+
+def mat_scale(a, s):
+    return [[a[i][j] * s for j in range(len(a[0]))] for i in range(len(a))]
+
+
+def mat_t(a):
+    return [list(row) for row in zip(*a)]
+
+
+def mat_eye(n):
+    return [[1.0 if i == j else 0.0 for j in range(n)] for i in range(n)]
+
+
+def expm(m, terms=30):
+    result = mat_eye(len(m))
+    term = mat_eye(len(m))
+    for k in range(1, terms):
+        term = mat_scale(mat_mul(term, m), 1.0 / k)
+        result = mat_add(result, term)
+    return result
+
+
+def discretize(inertia, damping, dt):
+    # continuous states: [angle error, rate, integral of angle error]
+    a = [[0.0, 1.0, 0.0],
+         [0.0, -damping / inertia, 0.0],
+         [1.0, 0.0, 0.0]]
+    b = [[0.0], [1.0 / inertia], [0.0]]
+    # zero-order hold via exponential of augmented matrix
+    aug = [a[i] + b[i] for i in range(3)] + [[0.0, 0.0, 0.0, 0.0]]
+    phi = expm(mat_scale(aug, dt))
+    ad = [row[:3] for row in phi[:3]]
+    bd = [[row[3]] for row in phi[:3]]
+    return ad, bd
+
+
+def dlqr(ad, bd, q, r, iterations=20000, tol=1e-12):
+    p = [row[:] for row in q]
+    for _ in range(iterations):
+        bt_p = mat_mul(mat_t(bd), p)
+        s = r + mat_mul(bt_p, bd)[0][0]
+        k = mat_scale(mat_mul(bt_p, ad), 1.0 / s)
+        p_next = mat_add(q, mat_sub(mat_mul(mat_mul(mat_t(ad), p), ad), mat_mul(mat_mul(mat_t(ad), mat_t(bt_p)), k)))
+        diff = max(abs(p_next[i][j] - p[i][j]) for i in range(3) for j in range(3))
+        p = p_next
+        if diff < tol * max(1.0, max(abs(v) for row in p for v in row)):
+            break
+    bt_p = mat_mul(mat_t(bd), p)
+    s = r + mat_mul(bt_p, bd)[0][0]
+    return mat_scale(mat_mul(bt_p, ad), 1.0 / s)[0]
+
+
+def simulate(gains, inertia, damping, dt, step, max_out, max_integral, duration):
+    lqr = FIRMWARE.new("lqr_type_def")
+    FIRMWARE.LQR_init(lqr, (ctypes.c_float * 3)(*gains), max_out, max_integral)
+    angle = rate = 0.0
+    peak = 0.0
+    peak_u = 0.0
+    settle_time = None
+    for n in range(int(duration / dt)):
+        u = FIRMWARE.LQR_calc(lqr, angle, step, rate, dt)
+        peak_u = max(peak_u, abs(u))
+        # plant integrated with a finer step than the controller
+        sub = 10
+        for _ in range(sub):
+            rate += (u - damping * rate) / inertia * dt / sub
+            angle += rate * dt / sub
+        peak = max(peak, angle)
+        if abs(step - angle) > 0.02 * abs(step):
+            settle_time = None
+        elif settle_time is None:
+            settle_time = (n + 1) * dt
+    return peak, settle_time, peak_u, angle
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compute gimbal LQR gains for the angle/rate/integral state feedback controller")
+    parser.add_argument("--inertia", type=float, required=True, help="J, command unit / (rad/s^2)")
+    parser.add_argument("--damping", type=float, required=True, help="B, command unit / (rad/s)")
+    parser.add_argument("--dt", type=float, default=FIRMWARE.GIMBAL_CONTROL_TIME_S, help="control period in seconds")
+    parser.add_argument("--q", type=float, nargs=3, default=[400.0, 1.0, 2000.0], help="state weights: angle, rate, integral")
+    parser.add_argument("--r", type=float, default=1.0, help="input weight")
+    parser.add_argument("--max-out", type=float, help="command saturation used in simulation, default *_LQR_MAX_OUT")
+    parser.add_argument("--max-integral", type=float, help="integral state limit used in simulation in rad*s, default *_LQR_MAX_INTEGRAL")
+    parser.add_argument("--step", type=float, default=0.2, help="simulated step in rad")
+    parser.add_argument("--prefix", default="YAW", help="macro prefix, YAW or PITCH")
+    args = parser.parse_args()
+    if args.max_out is None:
+        args.max_out = getattr(FIRMWARE, args.prefix + "_LQR_MAX_OUT")
+    if args.max_integral is None:
+        args.max_integral = getattr(FIRMWARE, args.prefix + "_LQR_MAX_INTEGRAL")
+
+    ad, bd = discretize(args.inertia, args.damping, args.dt)
+    q = [[args.q[0], 0.0, 0.0], [0.0, args.q[1], 0.0], [0.0, 0.0, args.q[2]]]
+    k = dlqr(ad, bd, q, args.r)
+    # u = -K x with x = [angle - set, rate, integral(angle - set)], firmware uses err = set - angle
+    gains = [k[0], k[1], k[2]]
+
+    print("#define %s_LQR_K_ANGLE %.6ff" % (args.prefix, gains[0]))
+    print("#define %s_LQR_K_RATE %.6ff" % (args.prefix, gains[1]))
+    print("#define %s_LQR_K_INTEGRAL %.6ff" % (args.prefix, gains[2]))
+
+    peak, settle_time, peak_u, final = simulate(gains, args.inertia, args.damping, args.dt, args.step, args.max_out, args.max_integral, 3.0)
+    print("// step %.3f rad: overshoot %.1f%%, 2%% settling %s, peak command %.3f, final error %.5f rad" % (
+        args.step,
+        max(0.0, (peak - args.step) / args.step * 100.0),
+        "%.3f s" % settle_time if settle_time is not None else "not reached",
+        peak_u,
+        args.step - final))
+    if settle_time is None or not math.isfinite(final):
+        raise SystemExit("closed loop did not settle, adjust weights")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,343 @@
+# Host simulation of the gimbal patrol scan pattern engine (application/gimbal_patrol.c) as gimbal_cv_control_patrol in
+# application/gimbal_behaviour.c runs it at the gimbal loop rate, and of the camera coverage it gives.
+# The field is a grid of 2deg yaw x 1deg pitch cells over the sector; a cell is seen while it is inside the camera field
+# of view. Reported per pattern: time to see the whole sector, coverage rate (sector area over that time, deg^2/s), and
+# the longest time any cell waits between two looks once all were seen. Patterns compared:
+#   - raster helix (slip ring, full circle), the default table of the sentry
+#   - lissajous on the full circle, and raster and lissajous on a +-60deg sector (no slip ring)
+#   - baseline: the yaw sweep at fixed pitch, as an operator would hold the gimbal
+# Checks:
+#   - set-point speed and acceleration never over the patrol limits, no jump, also across sector changes, entering the
+#     mode, and resuming after a CV lock
+#   - the sentry table sees the whole pitch band within a turn per row, the fixed pitch sweep never does
+#   - a +-60deg sector is fully seen by both patterns
+#   - once CV loses the target, the search starts where it was and finds it again within the search width, then the
+#     scan resumes
+# Patrol and trajectory generator are the firmware's, built by firmware_host.py. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["application/gimbal_patrol.c", "components/controller/trajectory_generator.c"],
+    headers=["gimbal_patrol.h", "trajectory_generator.h", "gimbal_task.h"],
+    structs={
+        "patrol_sector_t": {"yaw": ctypes.c_float, "half_width": ctypes.c_float, "pitch_min": ctypes.c_float,
+                            "pitch_max": ctypes.c_float, "dwell_s": ctypes.c_float, "pattern": ctypes.c_int},
+        "gimbal_patrol_t": {"state": ctypes.c_int},
+        "trajectory_generator_t": {"position": ctypes.c_float},
+    },
+    constants=["GIMBAL_CONTROL_TIME_S", "PATROL_CAMERA_FOV_H", "PATROL_CAMERA_FOV_V", "PATROL_YAW_MAX_SPEED",
+               "PATROL_YAW_MAX_ACCEL", "PATROL_PITCH_MAX_SPEED", "PATROL_PITCH_MAX_ACCEL", "PATROL_PITCH_MIN",
+               "PATROL_PITCH_MAX", "PATROL_SEARCH_HALF_WIDTH", "PATROL_SEARCH_TIME_S", "PATROL_ROW_OVERLAP",
+               "PATROL_MAX_ROWS", "PATROL_PATTERN_RASTER", "PATROL_PATTERN_LISSAJOUS", "PATROL_SCAN"])
+GIMBAL_CONTROL_TIME_S = FIRMWARE.GIMBAL_CONTROL_TIME_S
+PATROL_CAMERA_FOV_H = FIRMWARE.PATROL_CAMERA_FOV_H
+PATROL_CAMERA_FOV_V = FIRMWARE.PATROL_CAMERA_FOV_V
+PATROL_YAW_MAX_SPEED = FIRMWARE.PATROL_YAW_MAX_SPEED
+PATROL_YAW_MAX_ACCEL = FIRMWARE.PATROL_YAW_MAX_ACCEL
+PATROL_PITCH_MAX_SPEED = FIRMWARE.PATROL_PITCH_MAX_SPEED
+PATROL_PITCH_MAX_ACCEL = FIRMWARE.PATROL_PITCH_MAX_ACCEL
+PATROL_PITCH_MIN = FIRMWARE.PATROL_PITCH_MIN
+PATROL_PITCH_MAX = FIRMWARE.PATROL_PITCH_MAX
+PATROL_SEARCH_HALF_WIDTH = FIRMWARE.PATROL_SEARCH_HALF_WIDTH
+PATROL_SEARCH_TIME_S = FIRMWARE.PATROL_SEARCH_TIME_S
+RASTER, LISSAJOUS = int(FIRMWARE.PATROL_PATTERN_RASTER), int(FIRMWARE.PATROL_PATTERN_LISSAJOUS)
+CELL_YAW = math.radians(2.0)
+CELL_PITCH = math.radians(1.0)
+# the set-points are fp32
+EPS = 1e-4
+
+
+def rad_format(angle):
+    while angle > math.pi:
+        angle -= 2.0 * math.pi
+    while angle < -math.pi:
+        angle += 2.0 * math.pi
+    return angle
+
+
+class Sector:
+    def __init__(self, yaw, half_width, pitch_min, pitch_max, dwell_s, pattern):
+        self.yaw, self.half_width, self.pitch_min, self.pitch_max = yaw, half_width, pitch_min, pitch_max
+        self.dwell_s, self.pattern = dwell_s, pattern
+
+    def fields(self):
+        return {"yaw": self.yaw, "half_width": self.half_width, "pitch_min": self.pitch_min,
+                "pitch_max": self.pitch_max, "dwell_s": self.dwell_s, "pattern": self.pattern}
+
+
+def row_count(sector):
+    """rows of camera height, overlap shared, it takes to cover the band; for the coverage time bound"""
+    span = sector.pitch_max - sector.pitch_min - PATROL_CAMERA_FOV_V
+    if span <= 0.0:
+        return 1
+    return min(int(math.ceil(span / (PATROL_CAMERA_FOV_V * (1.0 - FIRMWARE.PATROL_ROW_OVERLAP)))) + 1, int(FIRMWARE.PATROL_MAX_ROWS))
+
+
+class TrajectoryGenerator:
+    """a trajectory_generator_t"""
+
+    def __init__(self, max_speed, max_accel, dt):
+        self.traj = FIRMWARE.new("trajectory_generator_t")
+        FIRMWARE.TRAJ_init(self.traj, max_speed, max_accel, dt)
+
+    def reset(self, position, speed):
+        FIRMWARE.TRAJ_reset(self.traj, position, speed)
+
+    def calc(self, target):
+        return FIRMWARE.TRAJ_calc(self.traj, target)
+
+    @property
+    def position(self):
+        return self.traj.position
+
+
+class Patrol:
+    """a gimbal_patrol_t running a table of sectors"""
+
+    def __init__(self, sectors, dt):
+        # kept by the patrol
+        self.table = FIRMWARE.new_array("patrol_sector_t", [sector.fields() for sector in sectors])
+        self.patrol = FIRMWARE.new("gimbal_patrol_t")
+        FIRMWARE.gimbal_patrol_init(self.patrol, self.table, len(sectors), dt)
+        self.yaw, self.pitch = ctypes.c_float(), ctypes.c_float()
+
+    def reset(self, yaw, pitch):
+        FIRMWARE.gimbal_patrol_reset(self.patrol, yaw, pitch)
+
+    def mark_target(self, yaw, pitch):
+        FIRMWARE.gimbal_patrol_mark_target(self.patrol, yaw, pitch)
+
+    def calc(self):
+        FIRMWARE.gimbal_patrol_calc(self.patrol, ctypes.byref(self.yaw), ctypes.byref(self.pitch))
+        return self.yaw.value, self.pitch.value
+
+    @property
+    def scanning(self):
+        return self.patrol.state == int(FIRMWARE.PATROL_SCAN)
+
+
+class FixedPitchSweep:
+    """baseline: yaw turning at the patrol speed, pitch held mid band"""
+
+    FULL_CIRCLE_HALF_WIDTH = math.pi - 1e-3
+    EDGE_TOLERANCE = 1e-4
+
+    def __init__(self, sector, dt):
+        self.sector, self.dt = sector, dt
+        self.yaw_traj = TrajectoryGenerator(PATROL_YAW_MAX_SPEED, PATROL_YAW_MAX_ACCEL, dt)
+        self.pitch_traj = TrajectoryGenerator(PATROL_PITCH_MAX_SPEED, PATROL_PITCH_MAX_ACCEL, dt)
+        self.yaw_dir = 1.0
+
+    def calc(self):
+        sector = self.sector
+        if sector.half_width >= self.FULL_CIRCLE_HALF_WIDTH:
+            yaw_target = rad_format(self.yaw_traj.position + 0.5 * math.pi)
+        else:
+            yaw_target = rad_format(sector.yaw + self.yaw_dir * max(sector.half_width - 0.5 * PATROL_CAMERA_FOV_H, 0.0))
+        yaw = self.yaw_traj.calc(yaw_target)
+        if abs(rad_format(yaw - yaw_target)) < self.EDGE_TOLERANCE:
+            self.yaw_dir = -self.yaw_dir
+        return yaw, self.pitch_traj.calc(0.5 * (sector.pitch_min + sector.pitch_max))
+
+
+class Coverage:
+    """cells of the sector, and when each was last inside the camera field of view"""
+
+    def __init__(self, sector):
+        self.sector = sector
+        yaw_cells = int(round(2.0 * sector.half_width / CELL_YAW))
+        pitch_cells = int(round((sector.pitch_max - sector.pitch_min) / CELL_PITCH))
+        self.yaws = [sector.yaw - sector.half_width + (i + 0.5) * 2.0 * sector.half_width / yaw_cells for i in range(yaw_cells)]
+        self.pitches = [sector.pitch_min + (j + 0.5) * (sector.pitch_max - sector.pitch_min) / pitch_cells for j in range(pitch_cells)]
+        self.last_seen = [[None] * pitch_cells for _ in range(yaw_cells)]
+        self.unseen = yaw_cells * pitch_cells
+        self.full_time = None
+        self.max_revisit = 0.0
+
+    def area_deg2(self):
+        return math.degrees(2.0 * self.sector.half_width) * math.degrees(self.sector.pitch_max - self.sector.pitch_min)
+
+    def look(self, time, yaw, pitch):
+        for i, cell_yaw in enumerate(self.yaws):
+            if abs(rad_format(cell_yaw - yaw)) > 0.5 * PATROL_CAMERA_FOV_H:
+                continue
+            column = self.last_seen[i]
+            for j, cell_pitch in enumerate(self.pitches):
+                if abs(cell_pitch - pitch) > 0.5 * PATROL_CAMERA_FOV_V:
+                    continue
+                if column[j] is None:
+                    self.unseen -= 1
+                    if self.unseen == 0:
+                        self.full_time = time
+                elif self.full_time is not None:
+                    self.max_revisit = max(self.max_revisit, time - column[j])
+                column[j] = time
+
+    def close(self, time):
+        # cells still waiting at the end count as a revisit gap too
+        if self.full_time is None:
+            return
+        for column in self.last_seen:
+            for seen in column:
+                self.max_revisit = max(self.max_revisit, time - seen)
+
+    def seen_fraction(self):
+        total = len(self.yaws) * len(self.pitches)
+        return 1.0 - self.unseen / total
+
+
+class LimitMonitor:
+    """worst excess of the set-point over the patrol speed and acceleration limits"""
+
+    def __init__(self, dt):
+        self.dt, self.last, self.excess = dt, None, 0.0
+
+    def restart(self, yaw, pitch):
+        self.last = (yaw, pitch, 0.0, 0.0)
+
+    def step(self, yaw, pitch):
+        if self.last is not None:
+            last_yaw, last_pitch, last_yaw_speed, last_pitch_speed = self.last
+            yaw_speed = rad_format(yaw - last_yaw) / self.dt
+            pitch_speed = (pitch - last_pitch) / self.dt
+            # the last period of a move lands on the target, so speed is compared per period, acceleration too
+            self.excess = max(self.excess, abs(yaw_speed) - PATROL_YAW_MAX_SPEED, abs(pitch_speed) - PATROL_PITCH_MAX_SPEED,
+                              abs(yaw_speed - last_yaw_speed) - 2.0 * PATROL_YAW_MAX_ACCEL * self.dt,
+                              abs(pitch_speed - last_pitch_speed) - 2.0 * PATROL_PITCH_MAX_ACCEL * self.dt)
+            self.last = (yaw, pitch, yaw_speed, pitch_speed)
+        else:
+            self.last = (yaw, pitch, 0.0, 0.0)
+
+
+def run(generator, sector, duration, start_yaw=0.0, start_pitch=0.0):
+    dt = GIMBAL_CONTROL_TIME_S
+    if hasattr(generator, "reset"):
+        generator.reset(start_yaw, start_pitch)
+    else:
+        generator.yaw_traj.reset(start_yaw, 0.0)
+        generator.pitch_traj.reset(start_pitch, 0.0)
+    coverage, monitor = Coverage(sector), LimitMonitor(dt)
+    monitor.restart(start_yaw, start_pitch)
+    steps = int(round(duration / dt))
+    for k in range(steps):
+        yaw, pitch = generator.calc()
+        monitor.step(yaw, pitch)
+        coverage.look((k + 1) * dt, yaw, pitch)
+    coverage.close(steps * dt)
+    return coverage, monitor
+
+
+def describe(coverage):
+    if coverage.full_time is None:
+        return "%.0f%% seen, never all" % (100.0 * coverage.seen_fraction())
+    return "all seen in %.2fs, %.0f deg^2/s, longest revisit %.2fs" % (
+        coverage.full_time, coverage.area_deg2() / coverage.full_time, coverage.max_revisit)
+
+
+def test_full_circle(report, rng, duration):
+    dt = GIMBAL_CONTROL_TIME_S
+    band = Sector(0.0, math.pi, PATROL_PITCH_MIN, PATROL_PITCH_MAX, 10.0, RASTER)
+    rows = row_count(band)
+    start_yaw, start_pitch = rng.uniform(-math.pi, math.pi), rng.uniform(PATROL_PITCH_MIN, PATROL_PITCH_MAX)
+    raster, raster_limits = run(Patrol([band], dt), band, duration, start_yaw, start_pitch)
+    lissajous_band = Sector(0.0, math.pi, PATROL_PITCH_MIN, PATROL_PITCH_MAX, 10.0, LISSAJOUS)
+    lissajous, lissajous_limits = run(Patrol([lissajous_band], dt), band, duration, start_yaw, start_pitch)
+    sweep, _ = run(FixedPitchSweep(band, dt), band, duration, start_yaw, start_pitch)
+    print("full circle, %d rows: raster helix %s" % (rows, describe(raster)))
+    print("full circle: lissajous %s" % describe(lissajous))
+    print("full circle: fixed pitch sweep %s" % describe(sweep))
+    # a turn per row at full speed, plus getting up to speed and onto the first row
+    bound = rows * 2.0 * math.pi / PATROL_YAW_MAX_SPEED + 1.0
+    report.check("raster helix sees the whole band within a turn per row", raster.full_time is not None and raster.full_time <= bound,
+                 "bound %.2fs" % bound)
+    report.check("fixed pitch sweep never sees the whole band", sweep.full_time is None)
+    report.check("full circle set-points within the patrol limits", max(raster_limits.excess, lissajous_limits.excess) < EPS,
+                 "worst excess %.2g" % max(raster_limits.excess, lissajous_limits.excess))
+
+
+def test_limited_sector(report, rng, duration):
+    dt = GIMBAL_CONTROL_TIME_S
+    worst_excess = 0.0
+    for pattern, name in [(RASTER, "raster"), (LISSAJOUS, "lissajous")]:
+        sector = Sector(0.0, math.radians(60.0), PATROL_PITCH_MIN, PATROL_PITCH_MAX, 10.0, pattern)
+        coverage, limits = run(Patrol([sector], dt), sector, duration, rng.uniform(-1.0, 1.0), rng.uniform(-0.3, 0.2))
+        worst_excess = max(worst_excess, limits.excess)
+        print("+-60deg sector: %s %s" % (name, describe(coverage)))
+        report.check("+-60deg sector fully seen by " + name, coverage.full_time is not None)
+    # a table of sectors, the moves between them included
+    sectors = [Sector(math.radians(90.0), math.radians(40.0), -0.3, 0.1, 1.5, RASTER),
+               Sector(math.radians(-120.0), math.radians(30.0), -0.2, 0.2, 1.5, LISSAJOUS),
+               Sector(math.radians(170.0), math.radians(20.0), -0.1, 0.1, 1.0, RASTER)]
+    _, limits = run(Patrol(sectors, dt), sectors[0], duration)
+    worst_excess = max(worst_excess, limits.excess)
+    report.check("sector set-points within the patrol limits, moves between sectors included", worst_excess < EPS,
+                 "worst excess %.2g" % worst_excess)
+
+
+def test_search_last_seen(report, rng, cases):
+    dt = GIMBAL_CONTROL_TIME_S
+    band = Sector(0.0, math.pi, PATROL_PITCH_MIN, PATROL_PITCH_MAX, 10.0, RASTER)
+    worst_jump, worst_reacquire, worst_excess, resumed = 0.0, 0.0, 0.0, True
+    for _ in range(cases):
+        patrol = Patrol([band], dt)
+        patrol.reset(rng.uniform(-math.pi, math.pi), 0.0)
+        for _ in range(int(rng.uniform(0.5, 3.0) / dt)):
+            patrol.calc()
+        # cv locks on: the gimbal follows a target that moves, the patrol only records where
+        target_yaw, target_pitch = rng.uniform(-math.pi, math.pi), rng.uniform(PATROL_PITCH_MIN, PATROL_PITCH_MAX)
+        target_speed = rng.uniform(-0.5, 0.5)
+        for _ in range(int(rng.uniform(0.2, 1.0) / dt)):
+            target_yaw = rad_format(target_yaw + target_speed * dt)
+            patrol.mark_target(target_yaw, target_pitch)
+        # lost behind cover, it shows again anywhere within the search width of where it was
+        last_yaw = target_yaw
+        target_yaw = rad_format(last_yaw + rng.uniform(-1.0, 1.0) * (PATROL_SEARCH_HALF_WIDTH - math.radians(5.0)))
+        monitor = LimitMonitor(dt)
+        monitor.restart(last_yaw, target_pitch)
+        reacquire = None
+        t = 0.0
+        first = True
+        while t < PATROL_SEARCH_TIME_S + 2.0:
+            yaw, pitch = patrol.calc()
+            if first:
+                worst_jump = max(worst_jump, abs(rad_format(yaw - last_yaw)) - PATROL_YAW_MAX_SPEED * dt,
+                                 abs(pitch - target_pitch) - PATROL_PITCH_MAX_SPEED * dt)
+                first = False
+            monitor.step(yaw, pitch)
+            t += dt
+            in_view = abs(rad_format(target_yaw - yaw)) <= 0.5 * PATROL_CAMERA_FOV_H and abs(target_pitch - pitch) <= 0.5 * PATROL_CAMERA_FOV_V
+            if reacquire is None and in_view:
+                reacquire = t
+        worst_reacquire = max(worst_reacquire, reacquire if reacquire is not None else float("inf"))
+        worst_excess = max(worst_excess, monitor.excess)
+        resumed = resumed and patrol.scanning
+    report.check("search starts on the last seen direction", worst_jump < EPS, "worst step over the speed limit %.2g rad" % worst_jump)
+    report.check("target seen again during the search", worst_reacquire <= PATROL_SEARCH_TIME_S,
+                 "worst %.2fs" % worst_reacquire)
+    report.check("scan resumes after the search", resumed)
+    report.check("search set-points within the patrol limits", worst_excess < EPS, "worst excess %.2g" % worst_excess)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the gimbal patrol scan patterns and their camera coverage")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--duration", type=float, default=20.0)
+    parser.add_argument("--cases", type=int, default=20)
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    report = Report()
+    test_full_circle(report, rng, args.duration)
+    test_limited_sector(report, rng, args.duration)
+    test_search_last_seen(report, rng, args.cases)
+    if not report.ok:
+        raise SystemExit("gimbal patrol simulation failed")
+
+
+if __name__ == "__main__":
+    main()
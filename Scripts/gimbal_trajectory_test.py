@@ -0,0 +1,261 @@
+# Host test of the gimbal set-point trajectory generator (components/controller/trajectory_generator.c) and of the
+# gyro mode cascade fed by it (gimbal_motor_absolute_angle_control in application/gimbal_task.c).
+# Generator checks, on random jumps, re-plans while moving, slow moving requests and jumps across +-PI:
+#   - reference speed never over max_speed, speed change per period never over max_accel * dt
+#   - a held jump settles exactly on the request within a couple of periods of the analytic minimum time, no overshoot
+#   - a request moving slower than max_speed is followed without lag once caught up
+#   - a jump across +-PI takes the short way round
+# Closed loop checks, default robot yaw (4310) and pitch models, angle and speed pid of gimbal_task.h set up as
+# gimbal_*_abs_angle_PID_init does, "turn around" and CV sized jumps:
+#   - with the generator, speed and acceleration feedforward the gimbal settles within 0.5 deg no later than with the
+#     step, and without overshoot. *_TRAJECTORY_INERTIA are 0 until identified, the inertia of the plant stands in
+#   - GIMBAL_TRAJECTORY_GENERATOR is not on without the inertias
+#   - the motor command stays off its limit, where the step may saturate it
+# trajectory_generator.c and pid.c are built by firmware_host.py; the cascade is the one of
+# gimbal_motor_absolute_angle_control, the command filters are bypassed on this robot and left out.
+# Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["components/controller/trajectory_generator.c", "components/controller/pid.c"],
+    headers=["trajectory_generator.h", "pid.h", "user_lib.h", "gimbal_task.h"],
+    structs={"trajectory_generator_t": {"position": ctypes.c_float, "speed": ctypes.c_float, "accel": ctypes.c_float},
+             "pid_type_def": {"max_out": ctypes.c_float}},
+    constants=["GIMBAL_CONTROL_TIME_S", "PID_POSITION", "GIMBAL_TRAJECTORY_GENERATOR", "YAW_DOB_NOMINAL_INERTIA",
+               "YAW_DOB_NOMINAL_DAMPING"]
+    + ["%s_%s" % (axis, name) for axis in ("YAW", "PITCH")
+       for name in ("TRAJECTORY_MAX_SPEED", "TRAJECTORY_MAX_ACCEL", "TRAJECTORY_INERTIA", "ANGLE_PID_KP",
+                    "ANGLE_PID_KI", "ANGLE_PID_KD", "ANGLE_PID_MAX_OUT", "ANGLE_PID_MAX_IOUT", "SPEED_PID_KP",
+                    "SPEED_PID_KI", "SPEED_PID_KD", "SPEED_PID_MAX_OUT", "SPEED_PID_MAX_IOUT")],
+    prototypes={"PID_init": (None, [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_void_p, ctypes.c_float, ctypes.c_float,
+                                    ctypes.c_float, ctypes.c_void_p])})
+
+DT = FIRMWARE.GIMBAL_CONTROL_TIME_S
+# single precision reference
+EPS = 1e-5
+# plant models the gains are tuned on: yaw is YAW_DOB_NOMINAL_*, pitch the 6020 model of gimbal_lqr_gain.py
+PLANTS = {
+    "yaw": dict(inertia=FIRMWARE.YAW_DOB_NOMINAL_INERTIA, damping=FIRMWARE.YAW_DOB_NOMINAL_DAMPING),
+    "pitch": dict(inertia=600.0, damping=100.0),
+}
+PLANT_SUBSTEPS = 8
+SETTLE_TOLERANCE = math.radians(0.5)
+
+
+def rad_format(angle):
+    while angle > math.pi:
+        angle -= 2.0 * math.pi
+    while angle < -math.pi:
+        angle += 2.0 * math.pi
+    return angle
+
+
+def f32(value):
+    return ctypes.c_float(value).value
+
+
+class TrajectoryGenerator:
+    """a trajectory_generator_t"""
+
+    def __init__(self, max_speed, max_accel, dt):
+        self.traj = FIRMWARE.new("trajectory_generator_t")
+        FIRMWARE.TRAJ_init(self.traj, max_speed, max_accel, dt)
+
+    def reset(self, position, speed):
+        FIRMWARE.TRAJ_reset(self.traj, position, speed)
+
+    def calc(self, target):
+        return FIRMWARE.TRAJ_calc(self.traj, target)
+
+    def __getattr__(self, name):
+        if name in ("position", "speed", "accel"):
+            return getattr(self.traj, name)
+        raise AttributeError(name)
+
+
+class GimbalAxis:
+    """gimbal_motor_absolute_angle_control of one motor in gyro mode"""
+
+    def __init__(self, axis, use_trajectory):
+        prefix = axis.upper()
+        self.angle_pid = self._pid(prefix + "_ANGLE_PID", 0.0, FIRMWARE.lib.rad_err_handler)
+        self.speed_pid = self._pid(prefix + "_SPEED_PID", 0.85, FIRMWARE.lib.filter_err_handler)
+        self.traj = TrajectoryGenerator(getattr(FIRMWARE, prefix + "_TRAJECTORY_MAX_SPEED"),
+                                        getattr(FIRMWARE, prefix + "_TRAJECTORY_MAX_ACCEL"), DT)
+        # what identification of the plant gives
+        self.trajectory_inertia = getattr(FIRMWARE, prefix + "_TRAJECTORY_INERTIA") or PLANTS[axis]["inertia"]
+        self.use_trajectory = use_trajectory
+
+    @staticmethod
+    def _pid(prefix, filter_coeff, handler):
+        gains = (ctypes.c_float * 3)(*(getattr(FIRMWARE, "%s_%s" % (prefix, k)) for k in ("KP", "KI", "KD")))
+        pid = FIRMWARE.new("pid_type_def")
+        FIRMWARE.PID_init(pid.address, int(FIRMWARE.PID_POSITION), gains, getattr(FIRMWARE, prefix + "_MAX_OUT"),
+                          getattr(FIRMWARE, prefix + "_MAX_IOUT"), filter_coeff, ctypes.cast(handler, ctypes.c_void_p))
+        return pid
+
+    def step(self, angle, gyro, angle_set):
+        """command of one control period, and whether it is on the limit"""
+        if self.use_trajectory:
+            reference = self.traj.calc(angle_set)
+            speed_feedforward, cmd_feedforward = self.traj.speed, self.trajectory_inertia * self.traj.accel
+        else:
+            reference, speed_feedforward, cmd_feedforward = angle_set, 0.0, 0.0
+        gyro_set = FIRMWARE.PID_calc_with_dot(self.angle_pid, angle, reference, DT, gyro) + speed_feedforward
+        cmd = FIRMWARE.PID_calc(self.speed_pid, gyro, gyro_set, DT) + cmd_feedforward
+        return FIRMWARE.fp32_abs_constrain(cmd, self.speed_pid.max_out), abs(cmd) >= self.speed_pid.max_out
+
+
+def minimum_time(distance, max_speed, max_accel):
+    """bang-coast-bang time of a rest to rest move"""
+    distance = abs(distance)
+    if distance * max_accel < max_speed * max_speed:
+        return 2.0 * math.sqrt(distance / max_accel)
+    return distance / max_speed + max_speed / max_accel
+
+
+def test_limits_and_settling(report, rng, cases):
+    worst_late, overshoot, limit_violation = 0.0, 0.0, 0.0
+    for _ in range(cases):
+        max_speed, max_accel = f32(rng.uniform(2.0, 12.0)), f32(rng.uniform(20.0, 300.0))
+        traj = TrajectoryGenerator(max_speed, max_accel, DT)
+        start = f32(rng.uniform(-math.pi, math.pi))
+        traj.reset(start, 0.0)
+        distance = rng.choice([-1.0, 1.0]) * rng.uniform(0.001, math.pi)
+        target = f32(rad_format(start + distance))
+        settled_at, last_speed, travelled = None, 0.0, 0.0
+        for k in range(1, 2000):
+            last_position = traj.position
+            traj.calc(target)
+            travelled += rad_format(traj.position - last_position)
+            limit_violation = max(limit_violation, abs(traj.speed) - max_speed,
+                                  abs(traj.speed - last_speed) - max_accel * DT)
+            last_speed = traj.speed
+            overshoot = max(overshoot, (travelled - distance) * (1.0 if distance > 0.0 else -1.0))
+            if settled_at is None and abs(rad_format(target - traj.position)) < EPS and abs(traj.speed) < EPS:
+                settled_at = k * DT
+            elif settled_at is not None and abs(rad_format(target - traj.position)) > EPS:
+                settled_at = float("inf")
+        if settled_at is None:
+            settled_at = float("inf")
+        worst_late = max(worst_late, settled_at - minimum_time(distance, max_speed, max_accel))
+    report.check("speed and acceleration limits held", limit_violation < EPS, "worst excess %.2e" % limit_violation)
+    report.check("jumps land exactly, no overshoot", overshoot < EPS, "worst overshoot %.2e rad" % overshoot)
+    report.check("jumps settle near the minimum time", worst_late <= 2.0 * DT,
+                 "at most %.1f ms after the bang-coast-bang time" % (worst_late * 1000.0))
+
+
+def test_replan(report, rng, cases):
+    limit_violation, unsettled = 0.0, 0
+    for _ in range(cases):
+        max_speed, max_accel = f32(rng.uniform(2.0, 12.0)), f32(rng.uniform(20.0, 300.0))
+        traj = TrajectoryGenerator(max_speed, max_accel, DT)
+        traj.reset(0.0, rng.uniform(-1.5, 1.5) * max_speed)
+        target, last_speed = 0.0, traj.speed
+        for k in range(1500):
+            if k < 500 and rng.random() < 0.02:
+                target = f32(rng.uniform(-math.pi, math.pi))
+            traj.calc(target)
+            excess_speed = abs(traj.speed) - max(max_speed, abs(last_speed))
+            limit_violation = max(limit_violation, excess_speed, abs(traj.speed - last_speed) - max_accel * DT)
+            last_speed = traj.speed
+        unsettled += 0 if (abs(rad_format(target - traj.position)) < EPS and abs(traj.speed) < EPS) else 1
+    report.check("re-planned every period within limits", limit_violation < EPS, "worst excess %.2e" % limit_violation)
+    report.check("re-planned requests settle", unsettled == 0, "%d of %d not settled" % (unsettled, cases))
+
+
+def test_moving_request(report, rng, cases):
+    worst_lag = 0.0
+    for _ in range(cases):
+        max_speed, max_accel = f32(rng.uniform(4.0, 12.0)), f32(rng.uniform(20.0, 300.0))
+        traj = TrajectoryGenerator(max_speed, max_accel, DT)
+        rate = rng.uniform(-0.8, 0.8) * max_speed
+        target = 0.0
+        for k in range(1000):
+            # mouse and joystick add a slowly changing increment every period
+            target = f32(rad_format(target + rate * DT * (1.0 + 0.2 * math.sin(k * 0.01))))
+            traj.calc(target)
+            if k > 500:
+                worst_lag = max(worst_lag, abs(rad_format(target - traj.position)))
+    report.check("slow request followed without lag", worst_lag < math.radians(0.05), "worst lag %.4f deg" % math.degrees(worst_lag))
+
+
+def test_wrap(report):
+    traj = TrajectoryGenerator(FIRMWARE.YAW_TRAJECTORY_MAX_SPEED, FIRMWARE.YAW_TRAJECTORY_MAX_ACCEL, DT)
+    traj.reset(3.0, 0.0)
+    crossed, ok = False, True
+    for _ in range(200):
+        traj.calc(-3.0)
+        ok = ok and traj.speed >= -EPS
+        crossed = crossed or traj.position < 0.0
+    report.check("jump across +-PI takes the short way", ok and crossed and abs(traj.position + 3.0) < EPS,
+                 "ends at %.4f" % traj.position)
+
+
+def closed_loop(axis, distance, use_trajectory, duration=1.5):
+    """gyro mode cascade on the axis model, returns (settling time, overshoot, time speed loop saturated)"""
+    plant = PLANTS[axis]
+    loop = GimbalAxis(axis, use_trajectory)
+    angle, rate = 0.0, 0.0
+    settled_at, overshoot, saturated = 0.0, 0.0, 0.0
+    for k in range(int(round(duration / DT))):
+        # gimbal_absolute_angle_limit: the request jumps, then holds
+        out, on_limit = loop.step(angle, rate, distance)
+        if on_limit:
+            saturated += DT
+        for _ in range(PLANT_SUBSTEPS):
+            h = DT / PLANT_SUBSTEPS
+            rate += (out - plant["damping"] * rate) / plant["inertia"] * h
+            angle += rate * h
+        error = distance - angle
+        overshoot = max(overshoot, -error if distance > 0.0 else error)
+        if abs(error) > SETTLE_TOLERANCE:
+            settled_at = (k + 1) * DT
+    return settled_at, overshoot, saturated
+
+
+def test_closed_loop(report):
+    for axis, distance in [("yaw", math.pi), ("yaw", math.radians(20.0)), ("pitch", math.radians(30.0)), ("pitch", math.radians(5.0))]:
+        step = closed_loop(axis, distance, False)
+        shaped = closed_loop(axis, distance, True)
+        name = "%s %.0f deg" % (axis, math.degrees(distance))
+        report.check(name + " settles no later", shaped[0] <= step[0] + EPS,
+                     "%.0f ms with the generator, %.0f ms with the step" % (shaped[0] * 1000.0, step[0] * 1000.0))
+        report.check(name + " without overshoot", shaped[1] < SETTLE_TOLERANCE,
+                     "%.2f deg with the generator, %.2f deg with the step" % (math.degrees(shaped[1]), math.degrees(step[1])))
+        report.check(name + " motor command off its limit", shaped[2] == 0.0,
+                     "saturated %.0f ms with the generator, %.0f ms with the step" % (shaped[2] * 1000.0, step[2] * 1000.0))
+
+
+def test_switch(report):
+    inertias = [getattr(FIRMWARE, axis + "_TRAJECTORY_INERTIA") for axis in ("YAW", "PITCH")]
+    report.check("generator off until the inertias are identified",
+                 not FIRMWARE.GIMBAL_TRAJECTORY_GENERATOR or all(inertias),
+                 "GIMBAL_TRAJECTORY_GENERATOR %d, inertia yaw %g, pitch %g" % (FIRMWARE.GIMBAL_TRAJECTORY_GENERATOR, *inertias))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the gimbal set-point trajectory generator")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--cases", type=int, default=300)
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    report = Report()
+    test_limits_and_settling(report, rng, args.cases)
+    test_replan(report, rng, args.cases // 3)
+    test_moving_request(report, rng, args.cases // 3)
+    test_wrap(report)
+    test_closed_loop(report)
+    test_switch(report)
+    if not report.ok:
+        raise SystemExit("gimbal trajectory test failed")
+
+
+if __name__ == "__main__":
+    main()
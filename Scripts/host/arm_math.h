@@ -0,0 +1,49 @@
+/**
+ * @file       arm_math.h
+ * @brief      Host stand-in for the part of CMSIS-DSP the firmware calls, for the tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ * Only the types and functions used under application/ and components/ are declared. They are implemented in
+ * arm_math_host.c after the CMSIS documentation of each function, data layout included, in plain C.
+ */
+#ifndef ARM_MATH_H
+#define ARM_MATH_H
+
+#include "string.h"
+#include "math.h"
+
+#define PI 3.14159265358979f
+
+typedef float float32_t;
+
+typedef enum
+{
+    ARM_MATH_SUCCESS = 0,
+    ARM_MATH_ARGUMENT_ERROR = -1,
+    ARM_MATH_LENGTH_ERROR = -2,
+    ARM_MATH_SIZE_MISMATCH = -3,
+    ARM_MATH_NANINF = -4,
+    ARM_MATH_SINGULAR = -5,
+    ARM_MATH_TEST_FAILURE = -6
+} arm_status;
+
+typedef struct
+{
+    unsigned char numStages;
+    float32_t *pState;
+    float32_t *pCoeffs;
+} arm_biquad_cascade_df2T_instance_f32;
+
+typedef struct
+{
+    unsigned short fftLenRFFT;
+} arm_rfft_fast_instance_f32;
+
+extern float32_t arm_sin_f32(float32_t x);
+extern float32_t arm_cos_f32(float32_t x);
+extern arm_status arm_sqrt_f32(float32_t in, float32_t *pOut);
+extern void arm_biquad_cascade_df2T_init_f32(arm_biquad_cascade_df2T_instance_f32 *S, unsigned char numStages, float32_t *pCoeffs, float32_t *pState);
+extern void arm_biquad_cascade_df2T_f32(const arm_biquad_cascade_df2T_instance_f32 *S, float32_t *pSrc, float32_t *pDst, unsigned int blockSize);
+extern arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, unsigned short fftLen);
+extern void arm_rfft_fast_f32(arm_rfft_fast_instance_f32 *S, float32_t *p, float32_t *pOut, unsigned char ifftFlag);
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * @file       arm_math_host.c
+ * @brief      Host implementation of the CMSIS-DSP functions declared in the arm_math.h stand-in
+ * @arthur     MacFalcons Control Team
+ */
+#include "arm_math.h"
+
+float32_t arm_sin_f32(float32_t x)
+{
+    return sinf(x);
+}
+
+float32_t arm_cos_f32(float32_t x)
+{
+    return cosf(x);
+}
+
+arm_status arm_sqrt_f32(float32_t in, float32_t *pOut)
+{
+    if (in >= 0.0f)
+    {
+        *pOut = sqrtf(in);
+        return ARM_MATH_SUCCESS;
+    }
+    *pOut = 0.0f;
+    return ARM_MATH_ARGUMENT_ERROR;
+}
+
+void arm_biquad_cascade_df2T_init_f32(arm_biquad_cascade_df2T_instance_f32 *S, unsigned char numStages, float32_t *pCoeffs, float32_t *pState)
+{
+    S->numStages = numStages;
+    S->pCoeffs = pCoeffs;
+    S->pState = pState;
+    for (unsigned int i = 0; i < 2u * numStages; i++)
+    {
+        pState[i] = 0.0f;
+    }
+}
+
+// per stage {b0, b1, b2, a1, a2}: y = b0 x + d1, d1 = b1 x + a1 y + d2, d2 = b2 x + a2 y
+void arm_biquad_cascade_df2T_f32(const arm_biquad_cascade_df2T_instance_f32 *S, float32_t *pSrc, float32_t *pDst, unsigned int blockSize)
+{
+    for (unsigned int n = 0; n < blockSize; n++)
+    {
+        float32_t x = pSrc[n];
+        for (unsigned int i = 0; i < S->numStages; i++)
+        {
+            const float32_t *b = &S->pCoeffs[5 * i];
+            float32_t *d = &S->pState[2 * i];
+            float32_t y = b[0] * x + d[0];
+            d[0] = b[1] * x + b[3] * y + d[1];
+            d[1] = b[2] * x + b[4] * y;
+            x = y;
+        }
+        pDst[n] = x;
+    }
+}
+
+arm_status arm_rfft_fast_init_f32(arm_rfft_fast_instance_f32 *S, unsigned short fftLen)
+{
+    if ((fftLen < 32) || (fftLen > 4096) || ((fftLen & (fftLen - 1)) != 0))
+    {
+        return ARM_MATH_ARGUMENT_ERROR;
+    }
+    S->fftLenRFFT = fftLen;
+    return ARM_MATH_SUCCESS;
+}
+
+// forward transform only, output {X[0], X[N/2], re X[1], im X[1], ..., re X[N/2-1], im X[N/2-1]}, input overwritten
+// as the CMSIS one does; a direct DFT in double, the test tolerances are far above the rounding of either
+void arm_rfft_fast_f32(arm_rfft_fast_instance_f32 *S, float32_t *p, float32_t *pOut, unsigned char ifftFlag)
+{
+    unsigned int n = S->fftLenRFFT;
+    if (ifftFlag != 0)
+    {
+        return;
+    }
+    for (unsigned int k = 0; k <= n / 2; k++)
+    {
+        double re = 0.0;
+        double im = 0.0;
+        for (unsigned int i = 0; i < n; i++)
+        {
+            double phase = -2.0 * 3.14159265358979323846 * (double)((k * i) % n) / n;
+            re += p[i] * cos(phase);
+            im += p[i] * sin(phase);
+        }
+        if (k == 0)
+        {
+            pOut[0] = (float32_t)re;
+        }
+        else if (k == n / 2)
+        {
+            pOut[1] = (float32_t)re;
+        }
+        else
+        {
+            pOut[2 * k] = (float32_t)re;
+            pOut[2 * k + 1] = (float32_t)im;
+        }
+    }
+    for (unsigned int i = 0; i < n; i++)
+    {
+        p[i] = 0.0f;
+    }
+}
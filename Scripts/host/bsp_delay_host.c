@@ -0,0 +1,36 @@
+/**
+ * @file       bsp_delay_host.c/h
+ * @brief      Host fake of the DWT cycle counter of bsp_delay.c, for the tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ */
+#include "bsp_delay_host.h"
+#include "bsp_delay.h"
+
+volatile uint32_t host_cycle = 0;
+
+void host_set_cycle(uint32_t cycle)
+{
+    host_cycle = cycle;
+}
+
+void delay_init(void)
+{
+}
+
+void delay_us(uint16_t nus)
+{
+}
+
+void delay_ms(uint16_t nms)
+{
+}
+
+uint32_t delay_get_cycle(void)
+{
+    return host_cycle;
+}
+
+fp32 delay_cycle_to_us(uint32_t cycles)
+{
+    return (fp32)cycles / (fp32)HOST_CYCLES_PER_US;
+}
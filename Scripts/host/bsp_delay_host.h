@@ -0,0 +1,18 @@
+/**
+ * @file       bsp_delay_host.c/h
+ * @brief      Host fake of the DWT cycle counter of bsp_delay.c, for the tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ * The counter does not run by itself: the test sets it to the time of the event it plays, at the 168MHz core clock.
+ * Waiting calls return at once.
+ */
+#ifndef BSP_DELAY_HOST_H
+#define BSP_DELAY_HOST_H
+#include "global_inc.h"
+
+#define HOST_CYCLES_PER_US 168
+
+extern volatile uint32_t host_cycle;
+
+extern void host_set_cycle(uint32_t cycle);
+
+#endif
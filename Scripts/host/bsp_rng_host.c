@@ -0,0 +1,34 @@
+/**
+ * @file       bsp_rng_host.c/h
+ * @brief      Host fake of the hardware random number generator of bsp_rng.c, for the tests built by
+ *             firmware_host.py
+ * @arthur     MacFalcons Control Team
+ */
+#include "bsp_rng_host.h"
+#include "bsp_rng.h"
+
+static uint32_t host_rng_state = 1;
+
+void host_rng_seed(uint32_t seed)
+{
+    // xorshift stays at 0 forever
+    host_rng_state = (seed != 0) ? seed : 1;
+}
+
+uint32_t RNG_get_random_num(void)
+{
+    host_rng_state ^= host_rng_state << 13;
+    host_rng_state ^= host_rng_state >> 17;
+    host_rng_state ^= host_rng_state << 5;
+    return host_rng_state;
+}
+
+int32_t RNG_get_random_range_int32(int min, int max)
+{
+    return (RNG_get_random_num() % (max - min + 1)) + min;
+}
+
+fp32 RNG_get_random_range_fp32(fp32 min, fp32 max)
+{
+    return ((fp32)RNG_get_random_num()) / ((fp32)0xFFFFFFFF) * (max - min) + min;
+}
@@ -0,0 +1,14 @@
+/**
+ * @file       bsp_rng_host.c/h
+ * @brief      Host fake of the hardware random number generator of bsp_rng.c, for the tests built by
+ *             firmware_host.py
+ * @arthur     MacFalcons Control Team
+ * A xorshift32 sequence the test seeds, so a simulation repeats run to run.
+ */
+#ifndef BSP_RNG_HOST_H
+#define BSP_RNG_HOST_H
+#include "global_inc.h"
+
+extern void host_rng_seed(uint32_t seed);
+
+#endif
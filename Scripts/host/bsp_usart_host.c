@@ -0,0 +1,37 @@
+/**
+ * @file       bsp_usart_host.c/h
+ * @brief      Host fake of the USART6 TX DMA of bsp_usart.c, for the tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ */
+#include "bsp_usart_host.h"
+#include "bsp_usart.h"
+#include <stddef.h>
+
+uint8_t *volatile host_usart6_tx_data = NULL;
+volatile uint16_t host_usart6_tx_len = 0;
+volatile uint32_t host_usart6_tx_starts = 0;
+static void (*host_usart6_tx_cplt_callback)(void) = NULL;
+
+void host_usart6_tx_cplt(void)
+{
+    if (host_usart6_tx_cplt_callback != NULL)
+    {
+        host_usart6_tx_cplt_callback();
+    }
+}
+
+void usart6_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_buf_num)
+{
+}
+
+void usart6_tx_dma_set_callback(void (*tx_cplt_callback)(void))
+{
+    host_usart6_tx_cplt_callback = tx_cplt_callback;
+}
+
+void usart6_tx_dma_enable(uint8_t *data, uint16_t len)
+{
+    host_usart6_tx_data = data;
+    host_usart6_tx_len = len;
+    host_usart6_tx_starts++;
+}
@@ -0,0 +1,19 @@
+/**
+ * @file       bsp_usart_host.c/h
+ * @brief      Host fake of the USART6 TX DMA of bsp_usart.c, for the tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ * A transfer does not run by itself: usart6_tx_dma_enable notes the buffer and counts the start, the test takes the
+ * bytes and calls host_usart6_tx_cplt at the time the last of them leaves, which runs the callback as the interrupt
+ * does. A test links Scripts/host/bsp_usart_host.c in place of bsp/boards/bsp_usart.c.
+ */
+#ifndef BSP_USART_HOST_H
+#define BSP_USART_HOST_H
+#include "global_inc.h"
+
+extern uint8_t *volatile host_usart6_tx_data;
+extern volatile uint16_t host_usart6_tx_len;
+extern volatile uint32_t host_usart6_tx_starts;
+
+extern void host_usart6_tx_cplt(void);
+
+#endif
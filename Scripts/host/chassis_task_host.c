@@ -0,0 +1,18 @@
+/**
+ * @file       chassis_task_host.c/h
+ * @brief      application/chassis_task.c with the static set-point shaping and spinning compensation callable, for the
+ *             tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ */
+#include "chassis_task.c"
+#include "chassis_task_host.h"
+
+fp32 host_chassis_cmd_shape(s_curve_ramp_type_t *s_curve_ramp, fp32 target, fp32 accel_max)
+{
+    return chassis_cmd_shape(s_curve_ramp, target, accel_max);
+}
+
+fp32 host_chassis_spin_compensated_relative_angle(void)
+{
+    return chassis_spin_compensated_relative_angle();
+}
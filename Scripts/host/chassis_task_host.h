@@ -0,0 +1,15 @@
+/**
+ * @file       chassis_task_host.c/h
+ * @brief      application/chassis_task.c with the static set-point shaping and spinning compensation callable, for the
+ *             tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ * A test builds Scripts/host/chassis_task_host.c in place of application/chassis_task.c.
+ */
+#ifndef CHASSIS_TASK_HOST_H
+#define CHASSIS_TASK_HOST_H
+#include "chassis_task.h"
+
+extern fp32 host_chassis_cmd_shape(s_curve_ramp_type_t *s_curve_ramp, fp32 target, fp32 accel_max);
+extern fp32 host_chassis_spin_compensated_relative_angle(void);
+
+#endif
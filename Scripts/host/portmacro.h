@@ -0,0 +1,51 @@
+/**
+ * @file       portmacro.h
+ * @brief      Host stand-in for the FreeRTOS ARM_CM4F port, for the tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ * Types as the Cortex-M4 port has them. Critical sections are counted by rtos_host.c, there is nothing to mask on the
+ * host: a test runs the firmware from one thread and plays the interrupts itself.
+ */
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#define portCHAR char
+#define portFLOAT float
+#define portDOUBLE double
+#define portLONG long
+#define portSHORT short
+#define portSTACK_TYPE uint32_t
+#define portBASE_TYPE long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+#define portMAX_DELAY (TickType_t)0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC 1
+
+#define portSTACK_GROWTH (-1)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portBYTE_ALIGNMENT 8
+
+#define portYIELD()
+#define portEND_SWITCHING_ISR(xSwitchRequired) (void)(xSwitchRequired)
+#define portYIELD_FROM_ISR(x) portEND_SWITCHING_ISR(x)
+
+extern void vPortEnterCritical(void);
+extern void vPortExitCritical(void);
+extern uint32_t ulPortRaiseBASEPRI(void);
+extern void vPortSetBASEPRI(uint32_t ulBASEPRI);
+#define portDISABLE_INTERRUPTS() (void)ulPortRaiseBASEPRI()
+#define portENABLE_INTERRUPTS() vPortSetBASEPRI(0)
+#define portENTER_CRITICAL() vPortEnterCritical()
+#define portEXIT_CRITICAL() vPortExitCritical()
+#define portSET_INTERRUPT_MASK_FROM_ISR() ulPortRaiseBASEPRI()
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x) vPortSetBASEPRI(x)
+
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction(void *pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters) void vFunction(void *pvParameters)
+#define portNOP()
+#define portFORCE_INLINE inline
+
+#endif
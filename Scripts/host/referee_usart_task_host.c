@@ -0,0 +1,63 @@
+/**
+ * @file       referee_usart_task_host.c/h
+ * @brief      application/referee_usart_task.c with the static unpacker callable and the frames it accepts handed to
+ *             the test, for the tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ */
+// ISO C only: the BSD extras of glibc's stdlib.h, which fifo.h includes, typedef an int64_t of their own
+#define _ISOC11_SOURCE
+#include "referee_usart_task.c"
+#include "referee_usart_task_host.h"
+#include <string.h>
+
+// fifo.c masks the interrupts with the Cortex-M PRIMASK, a flag here
+static uint32_t host_primask = 0;
+
+static uint32_t host_get_primask(void)
+{
+    return host_primask;
+}
+
+static void host_disable_irq(void)
+{
+    host_primask = 1;
+}
+
+static void host_set_primask(uint32_t primask)
+{
+    host_primask = primask;
+}
+
+#undef FIFO_ENTER_CRITICAL
+#undef FIFO_EXIT_CRITICAL
+#undef FIFO_GET_CPU_SR
+#undef FIFO_RESTORE_CPU_SR
+#define FIFO_ENTER_CRITICAL host_disable_irq
+#define FIFO_EXIT_CRITICAL() host_set_primask(0)
+#define FIFO_GET_CPU_SR host_get_primask
+#define FIFO_RESTORE_CPU_SR(CPU_SR) host_set_primask(CPU_SR)
+#include "fifo.c"
+
+void (*host_referee_frame_hook)(uint8_t *frame) = NULL;
+
+void referee_data_solve(uint8_t *frame)
+{
+    if (host_referee_frame_hook != NULL)
+    {
+        host_referee_frame_hook(frame);
+    }
+}
+
+void host_referee_unpack_init(void)
+{
+    memset(&referee_unpack_obj, 0, sizeof(referee_unpack_obj));
+    fifo_s_init(&referee_fifo, referee_fifo_buf, REFEREE_FIFO_BUF_LENGTH);
+}
+
+int host_referee_unpack(uint8_t *data, uint16_t len)
+{
+    // the USART6 interrupt puts what the DMA received, the task unpacks it
+    int put = fifo_s_puts(&referee_fifo, (char *)data, len);
+    referee_unpack_fifo_data();
+    return put;
+}
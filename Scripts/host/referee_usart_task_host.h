@@ -0,0 +1,19 @@
+/**
+ * @file       referee_usart_task_host.c/h
+ * @brief      application/referee_usart_task.c with the static unpacker callable and the frames it accepts handed to
+ *             the test, for the tests built by firmware_host.py
+ * @arthur     MacFalcons Control Team
+ * A test builds Scripts/host/referee_usart_task_host.c in place of application/referee_usart_task.c and
+ * components/support/fifo.c, which it takes in with the interrupt masking faked, and without application/referee.c:
+ * referee_data_solve is defined here and calls host_referee_frame_hook with every frame.
+ */
+#ifndef REFEREE_USART_TASK_HOST_H
+#define REFEREE_USART_TASK_HOST_H
+#include "referee_usart_task.h"
+
+extern void (*host_referee_frame_hook)(uint8_t *frame);
+
+extern void host_referee_unpack_init(void);
+extern int host_referee_unpack(uint8_t *data, uint16_t len);
+
+#endif
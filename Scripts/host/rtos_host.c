@@ -0,0 +1,69 @@
+/**
+ * @file       rtos_host.c/h
+ * @brief      Host fake of the FreeRTOS and CMSIS-RTOS calls the firmware makes, for the tests built by
+ *             firmware_host.py
+ * @arthur     MacFalcons Control Team
+ */
+#include "rtos_host.h"
+#include "cmsis_os.h"
+
+volatile uint32_t host_tick = 0;
+volatile int32_t host_critical_nesting = 0;
+void (*host_delay_hook)(uint32_t millisec) = NULL;
+
+void host_set_tick(uint32_t tick)
+{
+    host_tick = tick;
+}
+
+uint32_t host_get_critical_nesting(void)
+{
+    return (uint32_t)host_critical_nesting;
+}
+
+void vPortEnterCritical(void)
+{
+    host_critical_nesting++;
+}
+
+void vPortExitCritical(void)
+{
+    host_critical_nesting--;
+}
+
+uint32_t ulPortRaiseBASEPRI(void)
+{
+    return 0;
+}
+
+void vPortSetBASEPRI(uint32_t ulBASEPRI)
+{
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return host_tick;
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return host_tick;
+}
+
+uint32_t osKernelSysTick(void)
+{
+    return host_tick;
+}
+
+osStatus osDelay(uint32_t millisec)
+{
+    if (host_delay_hook != NULL)
+    {
+        host_delay_hook(millisec);
+    }
+    else
+    {
+        host_tick += millisec;
+    }
+    return osOK;
+}
@@ -0,0 +1,20 @@
+/**
+ * @file       rtos_host.c/h
+ * @brief      Host fake of the FreeRTOS and CMSIS-RTOS calls the firmware makes, for the tests built by
+ *             firmware_host.py
+ * @arthur     MacFalcons Control Team
+ * The tick does not run by itself: the test sets it, and osDelay either calls host_delay_hook, where the test plays
+ * what happens meanwhile and moves the tick, or moves the tick by the delay.
+ */
+#ifndef RTOS_HOST_H
+#define RTOS_HOST_H
+#include "global_inc.h"
+
+extern volatile uint32_t host_tick;
+extern volatile int32_t host_critical_nesting;
+extern void (*host_delay_hook)(uint32_t millisec);
+
+extern void host_set_tick(uint32_t tick);
+extern uint32_t host_get_critical_nesting(void);
+
+#endif
@@ -0,0 +1,183 @@
+# Host simulation of the muzzle speed regulator (application/muzzle_speed.c) against a noisy projectile speed model.
+# Plant: measured speed = gain(t) * set-point + noise, gain drifting as in a match: barrel and wheels warming with
+# sustained fire and cooling in pauses, projectile wear lowering it slowly, a fresh projectile batch stepping it, and
+# occasional outliers (damaged projectile). Referee reports every shot's speed at 0.1 m/s resolution.
+# The regulator is compared with a fixed set-point chosen so the worst gain of the scenario stays under the limit.
+# Checks:
+#   - no projectile over the limit
+#   - mean speed close to the limit and higher than with the fixed set-point
+#   - a gain step is followed within a few shots, upward steps stay under the limit
+#   - outliers don't move the set-point far
+#   - the set-point stays within what the wheels held in tests, on a robot too slow to reach the target as well
+# The regulator is application/muzzle_speed.c built by firmware_host.py, the speeds reach it as referee shoot data
+# frames. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["application/muzzle_speed.c", "application/referee.c"],
+    headers=["muzzle_speed.h", "shoot.h", "referee.h", "protocol.h"],
+    structs={
+        "muzzle_speed_t": {"speed_set": ctypes.c_float, "overspeed_count": ctypes.c_uint32},
+        "ext_shoot_data_t": {"shooter_number": ctypes.c_uint8, "initial_speed": ctypes.c_float},
+    },
+    constants=["MUZZLE_SPEED_LIMIT", "MUZZLE_SPEED_MAX_STEP", "MUZZLE_SPEED_SET_MAX", "REF_PROTOCOL_HEADER_SIZE", "SHOOT_DATA_CMD_ID"],
+    config={"ENABLE_SHOOT_REDUNDANT_SWITCH": 1, "MUZZLE_SPEED_REGULATION": 1})
+MUZZLE_SPEED_LIMIT = FIRMWARE.MUZZLE_SPEED_LIMIT
+MUZZLE_SPEED_MAX_STEP = FIRMWARE.MUZZLE_SPEED_MAX_STEP
+MUZZLE_SPEED_SET_MAX = FIRMWARE.MUZZLE_SPEED_SET_MAX
+MUZZLE = FIRMWARE.global_struct("muzzle_speed_t", "muzzle_speed_data")
+# the wheels held this in tests, shoot.h
+WHEEL_SPEED_MEASURED_MAX = 26.2
+
+SPEED_NOISE = 0.25  # m/s, shot to shot
+OUTLIER_PROBABILITY = 0.01
+OUTLIER_SPEED = (-3.0, 1.0)  # m/s on top of the nominal speed
+
+
+def referee_frame(cmd_id, data):
+    """a frame as referee_data_solve takes it from the unpacker, header and CRCs unchecked there"""
+    frame = bytes(int(FIRMWARE.REF_PROTOCOL_HEADER_SIZE)) + int(cmd_id).to_bytes(2, "little") + data.raw()
+    return ctypes.create_string_buffer(frame, len(frame) + 2)
+
+
+class Regulator:
+    """muzzle_speed_data, updated every shoot period after the referee parser took a shoot data report"""
+
+    def __init__(self):
+        FIRMWARE.muzzle_speed_init()
+
+    @property
+    def speed_set(self):
+        return MUZZLE.speed_set
+
+    @property
+    def overspeed_count(self):
+        return MUZZLE.overspeed_count
+
+    def shot(self, speed):
+        shoot_data = FIRMWARE.new("ext_shoot_data_t", shooter_number=1, initial_speed=speed)
+        FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.SHOOT_DATA_CMD_ID, shoot_data))
+        FIRMWARE.muzzle_speed_update()
+
+
+class Fixed:
+    def __init__(self, speed_set):
+        self.speed_set = speed_set
+
+    def shot(self, speed):
+        pass
+
+
+def gain_profile(rng, shots, batch_step):
+    """Gain per shot: thermal drift with fire bursts, slow wear, a projectile batch step half way."""
+    gains, bursts = [], []
+    # measured over nominal speed, robot to robot; on a robot below MUZZLE_SPEED_LIMIT / MUZZLE_SPEED_SET_MAX the wheels
+    # reach their limit before the target, there is nothing to regulate (test_set_point_range)
+    base = rng.uniform(1.10, 1.12)
+    heat = 0.0
+    i = 0
+    while i < shots:
+        burst = rng.randint(5, 40)
+        for _ in range(burst):
+            if i >= shots:
+                break
+            heat = min(1.0, heat + 0.02)
+            wear = -0.015 * i / shots
+            step = batch_step if i >= shots // 2 else 0.0
+            gains.append(base * (1.0 + 0.02 * heat + wear + step))
+            i += 1
+        bursts.append(i)
+        heat *= rng.uniform(0.3, 0.9)  # pause
+    return gains
+
+
+def run(controller, gains, seed):
+    """Returns the speed of every shot and whether the set-point was at MUZZLE_SPEED_SET_MAX (wheels can't go faster)."""
+    rng = random.Random(seed)
+    speeds, saturation = [], []
+    for gain in gains:
+        saturated = controller.speed_set >= MUZZLE_SPEED_SET_MAX
+        speed = gain * controller.speed_set + rng.gauss(0.0, SPEED_NOISE)
+        if rng.random() < OUTLIER_PROBABILITY:
+            speed = gain * controller.speed_set + rng.uniform(*OUTLIER_SPEED)
+        speed = round(speed, 1)
+        speeds.append(speed)
+        saturation.append(saturated)
+        controller.shot(speed)
+    return speeds, saturation
+
+
+def test_match(report, seed, batch_step, name):
+    rng = random.Random(seed)
+    shots = 600
+    gains = gain_profile(rng, shots, batch_step)
+    # a fixed set-point has to keep the worst gain with 3 sigma and the outliers below the limit
+    fixed_set = (MUZZLE_SPEED_LIMIT - 3.0 * SPEED_NOISE - OUTLIER_SPEED[1]) / max(gains)
+    fixed, _ = run(Fixed(fixed_set), gains, seed)
+    regulator = Regulator()
+    adaptive, saturation = run(regulator, gains, seed)
+    # shots at the wheel speed limit say nothing about the regulation
+    regulated = [None if saturated else v for v, saturated in zip(adaptive, saturation)]
+    settled = [v for v in regulated[30:] if v is not None]
+    over = sum(1 for v in adaptive if v > MUZZLE_SPEED_LIMIT)
+    mean = sum(settled) / len(settled)
+    mean_fixed = sum(fixed[30:]) / len(fixed[30:])
+    report.check("%s: never over the limit" % name, over == 0,
+                 "%d over, max %.1f m/s, %d in the overspeed band, %d shots at the wheel limit"
+                 % (over, max(adaptive), regulator.overspeed_count, sum(saturation)))
+    report.check("%s: mean speed near the limit" % name, MUZZLE_SPEED_LIMIT - 1.8 <= mean < MUZZLE_SPEED_LIMIT - 0.5 and mean > mean_fixed + 0.3,
+                 "%.2f m/s, fixed set-point %.2f m/s" % (mean, mean_fixed))
+    # after the batch step the mean of the next shots recovers
+    half = shots // 2
+    after = [v for v in regulated[half + 15:half + 60] if v is not None]
+    if len(after) < 10:
+        print("     %s: wheels at their speed limit after the batch step" % name)
+        return
+    mean_after = sum(after) / len(after)
+    report.check("%s: follows the batch step" % name, abs(mean_after - mean) < 0.5, "%.2f m/s 15..60 shots after it" % mean_after)
+
+
+def test_outliers(report, seed):
+    regulator = Regulator()
+    rng = random.Random(seed)
+    for _ in range(100):
+        regulator.shot(round(1.12 * regulator.speed_set + rng.gauss(0.0, SPEED_NOISE), 1))
+    before = regulator.speed_set
+    regulator.shot(round(1.12 * regulator.speed_set - 6.0, 1))
+    regulator.shot(3.0)  # misfeed report
+    report.check("outliers: set-point barely moves", abs(regulator.speed_set - before) <= MUZZLE_SPEED_MAX_STEP + 1e-6,
+                 "%.2f -> %.2f m/s" % (before, regulator.speed_set))
+
+
+def test_set_point_range(report, seed):
+    # slow projectiles ask for more than the wheels can do
+    regulator = Regulator()
+    rng = random.Random(seed)
+    for _ in range(100):
+        regulator.shot(round(0.95 * regulator.speed_set + rng.gauss(0.0, SPEED_NOISE), 1))
+    report.check("set-point capped at the measured wheel limit",
+                 MUZZLE_SPEED_SET_MAX <= WHEEL_SPEED_MEASURED_MAX + 1e-6 and MUZZLE_SPEED_SET_MAX < MUZZLE_SPEED_LIMIT
+                 and regulator.speed_set <= MUZZLE_SPEED_SET_MAX + 1e-6,
+                 "%.2f m/s, cap %.2f m/s" % (regulator.speed_set, MUZZLE_SPEED_SET_MAX))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the muzzle speed regulator against a noisy speed model")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    report = Report()
+    test_match(report, args.seed, -0.03, "slower batch")
+    test_match(report, args.seed + 1, 0.03, "faster batch")
+    test_outliers(report, args.seed)
+    test_set_point_range(report, args.seed)
+    if not report.ok:
+        raise SystemExit("muzzle speed simulation failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,159 @@
+# Host simulation of the relay feedback PID auto-tuner (components/controller/pid_autotune.c)
+# Runs the tuner on representative plants of the tuned loops, then closes the loop with the resulting gains
+# (PID_calc of components/controller/pid.c) and checks that the step response settles. Tuner and PID are built by
+# firmware_host.py. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+
+from firmware_host import Firmware
+
+FIRMWARE = Firmware(["components/controller/pid_autotune.c", "components/controller/pid.c"],
+                    headers=["pid_autotune.h", "pid.h", "user_lib.h"],
+                    structs={"pid_autotune_t": {"state": ctypes.c_uint8, "ultimate_gain": ctypes.c_float,
+                                                "ultimate_period": ctypes.c_float, "gains": ctypes.c_float},
+                             "pid_type_def": {"out": ctypes.c_float}},
+                    constants=["PID_AUTOTUNE_RULE_ZN_PI", "PID_AUTOTUNE_RULE_ZN_PID", "PID_AUTOTUNE_RULE_TL_PI",
+                               "PID_AUTOTUNE_RUNNING", "PID_AUTOTUNE_DONE", "PID_POSITION"],
+                    prototypes={"PID_init": (None, [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_void_p, ctypes.c_float,
+                                                    ctypes.c_float, ctypes.c_float, ctypes.c_void_p])})
+RULE_ZN_PI = int(FIRMWARE.PID_AUTOTUNE_RULE_ZN_PI)
+RULE_ZN_PID = int(FIRMWARE.PID_AUTOTUNE_RULE_ZN_PID)
+RULE_TL_PI = int(FIRMWARE.PID_AUTOTUNE_RULE_TL_PI)
+
+
+class RelayTuner:
+    """a pid_autotune_t"""
+
+    def __init__(self, relay_amplitude, hysteresis, max_out, max_error, rule, timeout, dt):
+        self.tune = FIRMWARE.new("pid_autotune_t")
+        FIRMWARE.PID_autotune_init(self.tune, relay_amplitude, hysteresis, max_out, max_error, rule, timeout, dt)
+
+    def start(self, bias):
+        FIRMWARE.PID_autotune_start(self.tune, bias)
+
+    def calc(self, ref, set_point):
+        return FIRMWARE.PID_autotune_calc(self.tune, ref, set_point)
+
+    @property
+    def running(self):
+        return self.tune.state == FIRMWARE.PID_AUTOTUNE_RUNNING
+
+    @property
+    def done(self):
+        return self.tune.state == FIRMWARE.PID_AUTOTUNE_DONE
+
+    def __getattr__(self, name):
+        if name in ("ultimate_gain", "ultimate_period", "gains"):
+            return getattr(self.tune, name)
+        raise AttributeError(name)
+
+
+class Plant:
+    # speed loop: gain * u = inertia * dw/dt + damping * w + load, with command delay, actuator lag and feedback filter
+    def __init__(self, gain, inertia, damping, load, delay, actuator_tau, feedback_coeff, noise, dt):
+        self.gain = gain
+        self.inertia = inertia
+        self.damping = damping
+        self.load = load
+        self.delay_line = [0.0] * delay
+        self.actuator_tau = actuator_tau
+        self.feedback_coeff = feedback_coeff
+        self.noise = noise
+        self.dt = dt
+        self.speed = 0.0
+        self.actuator = 0.0
+        self.feedback = 0.0
+        self.seed = 12345
+
+    def rand(self):
+        # small lcg so results don't depend on the python version
+        self.seed = (1103515245 * self.seed + 12345) & 0x7FFFFFFF
+        return self.seed / float(0x7FFFFFFF) - 0.5
+
+    def step(self, command):
+        self.delay_line.append(command)
+        applied = self.delay_line.pop(0)
+        sub = 20
+        h = self.dt / sub
+        for _ in range(sub):
+            if self.actuator_tau > 0.0:
+                self.actuator += (applied - self.actuator) * h / self.actuator_tau
+            else:
+                self.actuator = applied
+            self.speed += (self.gain * self.actuator - self.damping * self.speed - self.load) / self.inertia * h
+        measured = self.speed + self.noise * self.rand()
+        # filtered in the task with first_order_filter of user_lib.c
+        self.feedback = FIRMWARE.first_order_filter(measured, self.feedback, self.feedback_coeff)
+        return self.feedback
+
+
+def closed_loop_step(make_plant, gains, set_point, max_out, max_iout, dt, duration):
+    # PID_calc, PID_POSITION with raw_err_handler
+    plant = make_plant()
+    pid = FIRMWARE.new("pid_type_def")
+    FIRMWARE.PID_init(pid.address, int(FIRMWARE.PID_POSITION), (ctypes.c_float * 3)(*gains), max_out, max_iout, 0.0,
+                      ctypes.cast(FIRMWARE.lib.raw_err_handler, ctypes.c_void_p))
+    fdb = 0.0
+    peak = 0.0
+    settle_time = None
+    for n in range(int(duration / dt)):
+        fdb = plant.step(FIRMWARE.PID_calc(pid, fdb, set_point, dt))
+        peak = max(peak, fdb / set_point)
+        if abs(set_point - fdb) > 0.05 * abs(set_point):
+            settle_time = None
+        elif settle_time is None:
+            settle_time = (n + 1) * dt
+    return peak, settle_time, fdb
+
+
+def run_case(name, make_plant, tuner, tune_set, bias, step_set, max_out, max_iout, dt):
+    plant = make_plant()
+    fdb = 0.0
+    tuner.start(bias)
+    samples = 0
+    while tuner.running:
+        fdb = plant.step(tuner.calc(fdb, tune_set))
+        samples += 1
+    if not tuner.done:
+        print("%-16s tuning failed after %.2f s" % (name, samples * dt))
+        return False
+    peak, settle_time, final = closed_loop_step(make_plant, tuner.gains, step_set, max_out, max_iout, dt, 3.0)
+    ok = settle_time is not None and math.isfinite(final)
+    print("%-16s tuned in %5.2f s: Ku %10.3f Tu %.4f s -> kp %10.3f ki %10.3f kd %8.4f | step overshoot %5.1f%%, 5%% settling %s" % (
+        name, samples * dt, tuner.ultimate_gain, tuner.ultimate_period, tuner.gains[0], tuner.gains[1], tuner.gains[2],
+        max(0.0, peak - 1.0) * 100.0, "%.3f s" % settle_time if settle_time is not None else "not reached"))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate relay auto-tuning on representative plants of the tuned loops")
+    parser.add_argument("--noise", type=float, default=1.0, help="scale of feedback noise")
+    args = parser.parse_args()
+
+    ok = True
+    # chassis wheel speed, m/s, raw 3508 current, chassis loop period, lifted robot
+    dt = 0.001
+    ok &= run_case("wheel speed",
+                   lambda: Plant(1.0, 150.0, 200.0, 0.0, 1, 0.002, 1.0, 0.01 * args.noise, dt),
+                   RelayTuner(2000.0, 0.03, 16000.0, 3.0, RULE_ZN_PI, 20.0, dt), 0.5, 0.0, 1.0, 16000.0, 2000.0, dt)
+    # gimbal yaw rate, rad/s from imu, raw 6020 command, gimbal loop period
+    dt = 0.004
+    ok &= run_case("yaw rate",
+                   lambda: Plant(1.0, 180.0, 150.0, 0.0, 2, 0.001, 1.0, 0.02 * args.noise, dt),
+                   RelayTuner(3000.0, 0.08, 30000.0, 20.0, RULE_TL_PI, 20.0, dt), 0.0, 0.0, 2.0, 30000.0, 5000.0, dt)
+    # gimbal pitch rate with gravity load, bias has to be found by the tuner
+    ok &= run_case("pitch rate",
+                   lambda: Plant(1.0, 120.0, 100.0, 4000.0, 2, 0.001, 1.0, 0.02 * args.noise, dt),
+                   RelayTuner(2000.0, 0.08, 30000.0, 20.0, RULE_TL_PI, 20.0, dt), 0.0, 0.0, 2.0, 30000.0, 5000.0, dt)
+    # friction wheel, rpm with the 0.8 first order filter of shoot.c, set point is negative for motor 1
+    ok &= run_case("friction speed",
+                   lambda: Plant(1.0, 0.075, 0.225, 0.0, 1, 0.002, 0.8, 20.0 * args.noise, dt),
+                   RelayTuner(1000.0, 40.0, 16000.0, 8000.0, RULE_TL_PI, 20.0, dt), -5000.0, 0.0, -5000.0, 16000.0, 16000.0, dt)
+    if not ok:
+        raise SystemExit("auto-tuning did not converge on every plant")
+
+
+if __name__ == "__main__":
+    main()
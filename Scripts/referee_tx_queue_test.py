@@ -0,0 +1,349 @@
+# Host test of the referee transmit queue (application/referee_tx.c) and of the UI sends through it (graphic.c,
+# custom_ui_task.c).
+# Frame packer checks:
+#   - every frame packed is accepted by the referee unpacker (referee_unpack_fifo_data in referee_usart_task.c), with its
+#     cmd id, data and sequence number, for all data lengths the unpacker takes
+#   - UI frames are byte for byte the ones the blocking code sent (referee_data_pack_handle, ui_delete before the queue)
+# Queue checks, the UI task of custom_ui_task.c sending through referee_data_pack_handle, and a second task sending with
+# referee_tx_send when it likes, on a 115200 baud link and 1ms system tick:
+#   - the byte stream on the wire unpacks into exactly the admitted frames, in order, sequence numbers consecutive
+#   - every completion callback is called once, in order, when its last byte was handed to the UART
+#   - bytes admitted in any window of T seconds never exceed REFEREE_TX_BURST_BYTES + bandwidth * T
+#   - the queue never overflows, and a refused send leaves it untouched
+#   - every UI element still gets through, none dropped on UI_SEND_TIMEOUT_MS, and the reserve the waiting UI leaves
+#     lets most sends of the task that does not wait through
+# The UART time the blocking code spent per UI cycle is printed for comparison. referee_tx.c and graphic.c on the
+# USART6 TX DMA fake of Scripts/host, and the unpacker of referee_usart_task.c, are built by firmware_host.py.
+# Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import random
+
+from firmware_host import Firmware, HOST_DIR, Report
+
+CRC_PROTOTYPES = {"get_CRC8_check_sum": (ctypes.c_uint8, [ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint8]),
+                  "get_CRC16_check_sum": (ctypes.c_uint16, [ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint16])}
+FIRMWARE = Firmware(["application/referee_tx.c", "application/graphic.c", "components/support/CRC8_CRC16.c",
+                     HOST_DIR + "/bsp_usart_host.c"],
+                    headers=["referee_tx.h", "graphic.h", "bsp_usart_host.h", "rtos_host.h"],
+                    structs={"referee_tx_t": {"slots": ctypes.c_uint8, "head": ctypes.c_uint8, "count": ctypes.c_uint8,
+                                              "seq": ctypes.c_uint8, "budget": ctypes.c_float}},
+                    constants=["REFEREE_TX_BANDWIDTH_BYTES_PER_S", "REFEREE_TX_BURST_BYTES", "REFEREE_TX_QUEUE_LEN",
+                               "REFEREE_TX_FRAME_MAX_SIZE", "REFEREE_TX_DATA_MAX_SIZE", "REF_HEADER_CRC_CMDID_LEN",
+                               "UI_CMD_Robo_Exchange"],
+                    prototypes=dict(CRC_PROTOTYPES,
+                                    referee_tx_send=(ctypes.c_uint8, [ctypes.c_uint16, ctypes.c_char_p, ctypes.c_uint16,
+                                                                      ctypes.c_void_p])))
+UNPACKER_FIRMWARE = Firmware([HOST_DIR + "/referee_usart_task_host.c", "components/support/CRC8_CRC16.c"],
+                             headers=["referee_usart_task_host.h"])
+
+BANDWIDTH = FIRMWARE.REFEREE_TX_BANDWIDTH_BYTES_PER_S
+BURST = int(FIRMWARE.REFEREE_TX_BURST_BYTES)
+QUEUE_LEN = int(FIRMWARE.REFEREE_TX_QUEUE_LEN)
+FRAME_MAX_SIZE = int(FIRMWARE.REFEREE_TX_FRAME_MAX_SIZE)
+DATA_MAX_SIZE = int(FIRMWARE.REFEREE_TX_DATA_MAX_SIZE)
+OVERHEAD = int(FIRMWARE.REF_HEADER_CRC_CMDID_LEN)
+UI_CMD_ID = int(FIRMWARE.UI_CMD_Robo_Exchange)
+CRC8_INIT = FIRMWARE.global_value(ctypes.c_uint8, "CRC8_INIT").value
+CRC16_INIT = FIRMWARE.global_value(ctypes.c_uint16, "CRC16_INIT").value
+# usart6 of the board
+UART_BAUD = 115200
+UART_BITS_PER_BYTE = 10
+# custom_ui_task.c
+CUSTOM_UI_TIME_MS = 10
+# custom_ui_task.c main loop: update_char sends the first 45 bytes of its payload, update_ui 6 + 15
+UI_CHAR_DATA_LEN = 45
+UI_GRAPHIC_DATA_LEN = 21
+UI_LOOP_FRAMES = [UI_CHAR_DATA_LEN] * 14 + [UI_GRAPHIC_DATA_LEN] * 4
+# cmd ids of the task that does not wait, one per frame so its callbacks tell them apart
+OTHER_CMD_ID_BASE = 0x0200
+
+CALLBACK = ctypes.CFUNCTYPE(None, ctypes.c_uint16)
+DELAY_HOOK = ctypes.CFUNCTYPE(None, ctypes.c_uint32)
+FRAME_HOOK = ctypes.CFUNCTYPE(None, ctypes.POINTER(ctypes.c_uint8))
+
+
+def pack_frame(seq, cmd_id, data):
+    frame = ctypes.create_string_buffer(FRAME_MAX_SIZE)
+    length = FIRMWARE.referee_tx_pack_frame(frame, seq, cmd_id, data, len(data))
+    return frame.raw[:length]
+
+
+def crc8(data, crc=CRC8_INIT):
+    return FIRMWARE.get_CRC8_check_sum(bytes(data), len(data), crc)
+
+
+def crc16(data, crc=CRC16_INIT):
+    return FIRMWARE.get_CRC16_check_sum(bytes(data), len(data), crc)
+
+
+def old_referee_data_pack_handle(seq, cmd_id, data):
+    """graphic.c before the queue: frame built in tx_buff, sent byte by byte"""
+    tx_buff = bytearray(FRAME_MAX_SIZE)
+    frame_length = 5 + 2 + len(data) + 2
+    tx_buff[0] = 0xA5
+    tx_buff[1:3] = len(data).to_bytes(2, "little")
+    tx_buff[3] = seq
+    tx_buff[4] = crc8(tx_buff[:4])
+    tx_buff[5:7] = cmd_id.to_bytes(2, "little")
+    tx_buff[7:7 + len(data)] = data
+    crc = crc16(tx_buff[:frame_length - 2])
+    tx_buff[frame_length - 2:frame_length] = crc.to_bytes(2, "little")
+    return bytes(tx_buff[:frame_length])
+
+
+def old_ui_delete(seq, datahead, delete):
+    """graphic.c before the queue: header struct, crc16 chained over the three parts, sent byte by byte"""
+    head = bytearray([0xA5]) + (8).to_bytes(2, "little") + bytes([seq])
+    head += bytes([crc8(head)]) + (0x0301).to_bytes(2, "little")
+    crc = crc16(head)
+    crc = crc16(datahead, crc)
+    crc = crc16(delete, crc)
+    return bytes(head + datahead + delete) + crc.to_bytes(2, "little")
+
+
+def unpack(stream):
+    """(seq, cmd id, data) of every frame referee_unpack_fifo_data hands to referee_data_solve"""
+    frames = []
+
+    def solve(frame):
+        length = frame[1] | (frame[2] << 8)
+        frames.append((frame[3], frame[5] | (frame[6] << 8), bytes(frame[7:7 + length])))
+
+    hook = FRAME_HOOK(solve)
+    UNPACKER_FIRMWARE.global_value(ctypes.c_void_p, "host_referee_frame_hook").value = ctypes.cast(hook, ctypes.c_void_p).value
+    UNPACKER_FIRMWARE.host_referee_unpack_init()
+    # as the USART6 interrupt puts it into the fifo, half a DMA buffer at a time
+    for start in range(0, len(stream), 256):
+        chunk = bytes(stream[start:start + 256])
+        UNPACKER_FIRMWARE.host_referee_unpack(chunk, len(chunk))
+    UNPACKER_FIRMWARE.global_value(ctypes.c_void_p, "host_referee_frame_hook").value = None
+    return frames
+
+
+class Link:
+    """referee_tx on the USART6 TX DMA fake, a transfer of n bytes completes n byte times after it starts.
+    Time moves in ticks of 1ms; on_tick is called at every tick, after the transfers that completed within it."""
+
+    def __init__(self, on_tick=None):
+        self.tick = 0
+        FIRMWARE.host_set_tick(0)
+        FIRMWARE.referee_tx_init()
+        self.queue = FIRMWARE.global_struct("referee_tx_t", "referee_tx")
+        self.starts = FIRMWARE.global_value(ctypes.c_uint32, "host_usart6_tx_starts").value
+        self.done_time = None
+        self.wire = bytearray()
+        self.admitted = []      # (tick, frame length)
+        self.max_count = 0
+        self.completions = []   # (time s, cmd id)
+        self.on_tick = on_tick
+        self._callback = CALLBACK(lambda cmd_id: self.completions.append((self.now, cmd_id)))
+        self.callback = ctypes.cast(self._callback, ctypes.c_void_p)
+        self._delay_hook = DELAY_HOOK(self.advance)
+        self.now = 0.0
+
+    def poll(self):
+        """take the transfer referee_tx started, if any"""
+        starts = FIRMWARE.global_value(ctypes.c_uint32, "host_usart6_tx_starts").value
+        if starts != self.starts:
+            self.starts = starts
+            length = FIRMWARE.global_value(ctypes.c_uint16, "host_usart6_tx_len").value
+            data = FIRMWARE.global_value(ctypes.c_void_p, "host_usart6_tx_data").value
+            self.wire += ctypes.string_at(data, length)
+            self.done_time = self.now + length * UART_BITS_PER_BYTE / UART_BAUD
+
+    def admit(self, length):
+        self.admitted.append((self.tick, length + OVERHEAD))
+        self.max_count = max(self.max_count, self.queue.count)
+        self.poll()
+
+    def send(self, cmd_id, data):
+        """referee_tx_send with the completion callback"""
+        if not FIRMWARE.referee_tx_send(cmd_id, data, len(data), self.callback):
+            return False
+        self.admit(len(data))
+        return True
+
+    def advance(self, millisec):
+        """osDelay: the DMA interrupts and the other tasks run meanwhile"""
+        for _ in range(millisec):
+            end = (self.tick + 1) / 1000.0
+            while self.done_time is not None and self.done_time <= end:
+                self.now, self.done_time = self.done_time, None
+                FIRMWARE.host_usart6_tx_cplt()
+                self.poll()
+            self.tick += 1
+            self.now = self.tick / 1000.0
+            FIRMWARE.host_set_tick(self.tick)
+            if self.on_tick is not None:
+                self.on_tick(self)
+
+    def hook(self):
+        FIRMWARE.global_value(ctypes.c_void_p, "host_delay_hook").value = ctypes.cast(self._delay_hook, ctypes.c_void_p).value
+
+    def unhook(self):
+        FIRMWARE.global_value(ctypes.c_void_p, "host_delay_hook").value = None
+
+    def drain(self):
+        while self.done_time is not None:
+            self.advance(1)
+
+
+def test_packer(report, rng):
+    stream, expected = bytearray(), []
+    for seq in range(600):
+        length = rng.randrange(0, DATA_MAX_SIZE)
+        data = bytes(rng.randrange(256) for _ in range(length))
+        cmd_id = rng.randrange(0x10000)
+        expected.append((seq & 0xFF, cmd_id, data))
+        stream += pack_frame(seq & 0xFF, cmd_id, data)
+    frames = unpack(stream)
+    report.check("packed frames accepted by the referee unpacker", frames == expected,
+                 "%d of %d frames" % (len(frames), len(expected)))
+
+    same = True
+    for _ in range(200):
+        seq = rng.randrange(256)
+        data = bytes(rng.randrange(256) for _ in range(rng.choice([UI_CHAR_DATA_LEN, UI_GRAPHIC_DATA_LEN])))
+        same = same and pack_frame(seq, UI_CMD_ID, data) == old_referee_data_pack_handle(seq, UI_CMD_ID, data)
+        datahead = bytes(rng.randrange(256) for _ in range(6))
+        delete = bytes([rng.randrange(3), rng.randrange(10)])
+        same = same and pack_frame(seq, UI_CMD_ID, datahead + delete) == old_ui_delete(seq, datahead, delete)
+    report.check("UI and delete frames byte for byte as the blocking code sent them", same)
+
+
+class OtherTask:
+    """sends a frame of its own with referee_tx_send every 20 to 200ms, gives up on it if refused"""
+
+    def __init__(self, rng):
+        self.rng = rng
+        self.next = rng.randint(0, 50)
+        self.sent = []
+        self.refused = 0
+
+    def __call__(self, link):
+        if link.tick < self.next:
+            return
+        data = bytes(self.rng.randrange(256) for _ in range(self.rng.randrange(1, 40)))
+        cmd_id = OTHER_CMD_ID_BASE + len(self.sent) % 0x100
+        if link.send(cmd_id, data):
+            self.sent.append((cmd_id, data))
+        else:
+            self.refused += 1
+        self.next = link.tick + self.rng.randint(20, 200)
+
+
+def run_queue(rng, duration):
+    """UI task and an occasional sender on one queue, the UI task sleeping in referee_tx_send_wait"""
+    other = OtherTask(rng)
+    link = Link(other)
+    link.hook()
+    ui_log, ui_dropped, loop_times = [], 0, []
+    wake = 0
+    while link.tick < duration * 1000:
+        loop_start = link.tick
+        for length in UI_LOOP_FRAMES:
+            # the first bytes number the element, so the order on the wire shows
+            data = len(ui_log).to_bytes(3, "little") + bytes(rng.randrange(256) for _ in range(length - 3))
+            if FIRMWARE.referee_data_pack_handle(UI_CMD_ID, data, len(data)) == 0:
+                link.admit(len(data))
+                ui_log.append(data)
+            else:
+                ui_dropped += 1
+        loop_times.append(link.tick - loop_start)
+        # osDelayUntil: the next cycle CUSTOM_UI_TIME_MS after the last, at once if that has passed
+        wake += CUSTOM_UI_TIME_MS
+        if wake > link.tick:
+            link.advance(wake - link.tick)
+    link.drain()
+    link.unhook()
+    return link, ui_log, other, ui_dropped, loop_times
+
+
+def test_queue(report, rng, duration):
+    link, ui_log, other, ui_dropped, loop_times = run_queue(rng, duration)
+    sent = unpack(link.wire)
+    report.check("wire unpacks into the admitted frames", len(sent) == len(link.admitted) and
+                 all(len(data) + OVERHEAD == length for (_, _, data), (_, length) in zip(sent, link.admitted)),
+                 "%d frames, %d bytes" % (len(sent), len(link.wire)))
+    report.check("sequence numbers consecutive", all(seq == i & 0xFF for i, (seq, _, _) in enumerate(sent)))
+    ui_sent = [data for _, cmd_id, data in sent if cmd_id == UI_CMD_ID]
+    other_sent = [(cmd_id, data) for _, cmd_id, data in sent if cmd_id != UI_CMD_ID]
+    report.check("UI frames in order", ui_sent == ui_log)
+    report.check("other frames in order", other_sent == other.sent)
+
+    # the UI sends without a callback
+    called = [cmd_id for _, cmd_id in link.completions]
+    report.check("completion callbacks once each, in order", called == [cmd_id for cmd_id, _ in other.sent],
+                 "%d callbacks" % len(called))
+
+    worst = 0.0
+    admitted = link.admitted
+    for window in (0.1, 1.0, 5.0):
+        start = 0
+        total = 0
+        for end in range(len(admitted)):
+            total += admitted[end][1]
+            while (admitted[end][0] - admitted[start][0]) / 1000.0 > window:
+                total -= admitted[start][1]
+                start += 1
+            worst = max(worst, total - (BURST + BANDWIDTH * window))
+    rate = sum(length for _, length in admitted) / duration
+    report.check("admitted bytes within the token bucket in any window", worst <= 0.0,
+                 "%.0f bytes/s of %d" % (rate, BANDWIDTH))
+    report.check("queue never overflows", link.max_count <= QUEUE_LEN, "at most %d slots used" % link.max_count)
+    report.check("no UI element dropped on the send timeout", ui_dropped == 0,
+                 "%d UI frames, %d other frames, %d other sends refused" % (len(ui_log), len(other.sent), other.refused))
+    attempts = len(other.sent) + other.refused
+    report.check("sends that do not wait get through next to the UI", other.refused <= 0.05 * attempts,
+                 "%d of %d refused" % (other.refused, attempts))
+
+    ui_bytes = sum(length + OVERHEAD for length in UI_LOOP_FRAMES)
+    blocking_ms = ui_bytes * UART_BITS_PER_BYTE / UART_BAUD * 1000.0
+    mean_loop = sum(loop_times) / max(len(loop_times), 1)
+    print("UI loop of %d frames, %d bytes: blocking HAL transmit busy-waited %.0fms of it, the queue sleeps through a "
+          "%.0fms loop paced by the referee bandwidth" % (len(UI_LOOP_FRAMES), ui_bytes, blocking_ms, mean_loop))
+
+
+def queue_state(link):
+    return (link.queue.head, link.queue.count, link.queue.seq, link.queue.budget, tuple(link.queue.slots))
+
+
+def test_refused(report):
+    # no time passes, the DMA never completes
+    link = Link()
+    data = bytes(DATA_MAX_SIZE)
+    accepted = 0
+    while link.send(UI_CMD_ID, data):
+        accepted += 1
+    snapshot = queue_state(link)
+    refused_budget = not link.send(UI_CMD_ID, data)
+    refused_size = not link.send(UI_CMD_ID, bytes(DATA_MAX_SIZE + 1))
+    untouched = snapshot == queue_state(link)
+    report.check("over the budget refused, queue untouched", accepted == BURST // FRAME_MAX_SIZE and
+                 refused_budget and refused_size and untouched, "%d full frames in a burst" % accepted)
+    # a full queue refuses even with budget
+    link = Link()
+    small = 0
+    while link.send(UI_CMD_ID, b"\x00"):
+        small += 1
+    report.check("full queue refused", small == QUEUE_LEN and link.queue.budget >= 10, "%d frames queued" % small)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the referee transmit queue")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--duration", type=float, default=20.0)
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    report = Report()
+    test_packer(report, rng)
+    test_queue(report, rng, args.duration)
+    test_refused(report)
+    if not report.ok:
+        raise SystemExit("referee transmit queue test failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,214 @@
+# Host test of the S-curve set-point ramp (s_curve_ramp_calc in components/algorithm/user_lib.c) and of the chassis
+# set-point shaping built on it (chassis_cmd_shape in application/chassis_task.c).
+# Checks on steps, reversals, random targets and limits changing every period (power level, sprint, braking ratio):
+#   - rate never exceeds max_rate, rate change per period never exceeds max_jerk * dt
+#   - output never overshoots a held target it could brake for, and settles exactly on it
+#   - after a limit drop the rate may stay above the new limit, but only decreasing
+#   - a step settles within a few periods of the analytic minimum time of a jerk limited move
+#   - the chassis set-point drops to zero at once on a stop command, stick in the deadband and no key
+# The ramp and chassis_rc_to_control_vector are the firmware's, built by firmware_host.py; the chassis is driven through
+# its remote control, referee power limit and sprint key. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware
+
+FIRMWARE = Firmware(
+    ["application/chassis_task.c", "application/referee.c"],
+    headers=["user_lib.h", "chassis_task.h", "remote_control.h", "referee.h"],
+    structs={"s_curve_ramp_type_t": {"out": ctypes.c_float, "rate": ctypes.c_float, "max_rate": ctypes.c_float,
+                                     "max_jerk": ctypes.c_float},
+             "chassis_move_t": {"chassis_RC": ctypes.c_void_p, "chassis_cmd_slow_set_vx": ctypes.c_uint8,
+                                "chassis_cmd_slow_set_vy": ctypes.c_uint8, "vx_max_speed": ctypes.c_float,
+                                "vy_max_speed": ctypes.c_float, "accel_max": ctypes.c_float},
+             "chassis_loop_timing_t": {"dt": ctypes.c_float},
+             "RC_ctrl_t": {"rc": ctypes.c_int16, "key": ctypes.c_uint16},
+             "ext_game_robot_state_t": {"chassis_power_limit": ctypes.c_uint16}},
+    constants=["CHASSIS_CONTROL_TIME_S", "CHASSIS_CMD_JERK_TIME_S", "JOYSTICK_LEFT_VERTICAL_CHANNEL",
+               "JOYSTICK_LEFT_HORIZONTAL_CHANNEL", "JOYSTICK_HALF_RANGE", "KEY_PRESSED_OFFSET_SHIFT"],
+    prototypes={"chassis_rc_to_control_vector": (None, [ctypes.c_void_p, ctypes.c_void_p])})
+
+DT = FIRMWARE.CHASSIS_CONTROL_TIME_S
+EPS = 1e-6
+
+
+def f32(value):
+    return ctypes.c_float(value).value
+
+
+class SCurveRamp:
+    """an s_curve_ramp_type_t"""
+
+    def __init__(self, frame_period, max_rate, max_jerk, ramp=None):
+        self.ramp = ramp or FIRMWARE.new("s_curve_ramp_type_t")
+        FIRMWARE.s_curve_ramp_init(self.ramp, frame_period, max_rate, max_jerk)
+
+    def calc(self, target):
+        return FIRMWARE.s_curve_ramp_calc(self.ramp, target)
+
+    def __getattr__(self, name):
+        if name in ("out", "rate", "max_rate", "max_jerk"):
+            return getattr(self.ramp, name)
+        raise AttributeError(name)
+
+
+def min_move_time(distance, max_rate, max_jerk):
+    # rest to rest, jerk limited: triangular rate profile if max_rate is not reached
+    distance = abs(distance)
+    if distance * max_jerk <= max_rate * max_rate:
+        return 2.0 * math.sqrt(distance / max_jerk)
+    return distance / max_rate + max_rate / max_jerk
+
+
+class Checker:
+    def __init__(self, name):
+        self.name = name
+        self.errors = []
+        self.overshoot_allowed = False
+        self.last_target = None
+        self.last_max_jerk = 0.0
+
+    def step(self, ramp, last_rate, last_out, target, max_rate, max_jerk):
+        # after a limit drop the rate may be above the new limit, but then it may only come down
+        if abs(ramp.rate) > max_rate * (1.0 + EPS) + EPS and abs(ramp.rate) > abs(last_rate) + EPS:
+            self.errors.append("rate %.4f above %.4f" % (ramp.rate, max_rate))
+        # a reset to rest is a jerk of at most max_jerk too, since rest is only entered from |rate| <= max_jerk * dt
+        if abs(ramp.rate - last_rate) > max_jerk * DT * (1.0 + EPS) + EPS:
+            self.errors.append("jerk %.1f above %.1f" % ((ramp.rate - last_rate) / DT, max_jerk))
+        if target != self.last_target or max_jerk < self.last_max_jerk:
+            # a new target, or a lower limit, closer than the braking distance can't be reached without overshoot
+            distance = target - last_out
+            unavoidable = (last_rate * distance > 0.0) and (last_rate * last_rate / (2.0 * max_jerk) + abs(last_rate) * DT >= abs(distance))
+            self.overshoot_allowed = unavoidable or (self.overshoot_allowed and target == self.last_target)
+            self.last_target = target
+        self.last_max_jerk = max_jerk
+        if (last_out - target) * (ramp.out - target) < 0.0 and not self.overshoot_allowed:
+            self.errors.append("overshoot to %.6f crossing %.6f" % (ramp.out, target))
+
+    def report(self):
+        if self.errors:
+            print("FAIL %-32s %d violations, first: %s" % (self.name, len(self.errors), self.errors[0]))
+        else:
+            print("ok   %s" % self.name)
+        return not self.errors
+
+
+def test_steps():
+    ok = True
+    for distance, max_rate, max_jerk in ((2.0, 3.0, 30.0), (-2.45, 4.5, 45.0), (0.01, 3.0, 30.0), (6.0, 12.0, 120.0)):
+        check = Checker("step %.2f rate %.1f jerk %.0f" % (distance, max_rate, max_jerk))
+        ramp = SCurveRamp(DT, max_rate, max_jerk)
+        distance = f32(distance)
+        settle = None
+        for n in range(5000):
+            last_rate, last_out = ramp.rate, ramp.out
+            ramp.calc(distance)
+            check.step(ramp, last_rate, last_out, distance, max_rate, max_jerk)
+            if settle is None and ramp.out == distance and ramp.rate == 0.0:
+                settle = (n + 1) * DT
+        best = min_move_time(distance, max_rate, max_jerk)
+        if settle is None:
+            check.errors.append("never settled")
+        elif settle > best + 0.01 + 0.02 * best:
+            check.errors.append("settled in %.3f s, minimum %.3f s" % (settle, best))
+        else:
+            check.name += ", settled in %.3f s (minimum %.3f s)" % (settle, best)
+        ok &= check.report()
+    return ok
+
+
+def test_reversal():
+    check = Checker("reversal while accelerating")
+    ramp = SCurveRamp(DT, 3.0, 30.0)
+    for n in range(3000):
+        target = 2.0 if n < 150 else -2.0
+        last_rate, last_out = ramp.rate, ramp.out
+        ramp.calc(target)
+        check.step(ramp, last_rate, last_out, target, 3.0, 30.0)
+    if ramp.out != -2.0:
+        check.errors.append("ended at %.4f" % ramp.out)
+    return check.report()
+
+
+def test_random_targets(seed):
+    rng = random.Random(seed)
+    check = Checker("random targets, seed %d" % seed)
+    ramp = SCurveRamp(DT, 3.0, 30.0)
+    target = 0.0
+    for n in range(200000):
+        if rng.random() < 0.002:
+            target = f32(rng.uniform(-2.5, 2.5)) if rng.random() < 0.8 else 0.0
+        last_rate, last_out = ramp.rate, ramp.out
+        ramp.calc(target)
+        check.step(ramp, last_rate, last_out, target, 3.0, 30.0)
+    return check.report()
+
+
+def test_chassis_shaping(seed):
+    # joystick moves, power level and sprint change the limits, braking doubles them; bounds hold for the limit in use
+    rng = random.Random(seed)
+    checks = [Checker("chassis shaping vx, changing limits"), Checker("chassis shaping vy, changing limits")]
+    stops = [[0, 0], [0, 0]]  # stop commands of each axis, and those not at rest at once
+    chassis = FIRMWARE.global_struct("chassis_move_t", "chassis_move")
+    robot_state = FIRMWARE.global_struct("ext_game_robot_state_t", "robot_state")
+    FIRMWARE.global_struct("chassis_loop_timing_t", "chassis_loop_timing").dt = DT
+    remote = FIRMWARE.new("RC_ctrl_t")
+    chassis.chassis_RC = remote.address
+    ramps = []
+    for field in ("chassis_cmd_slow_set_vx", "chassis_cmd_slow_set_vy"):
+        ramp = FIRMWARE.view("s_curve_ramp_type_t", chassis.field_address(field))
+        # as chassis_init, before the first power level is known
+        ramps.append(SCurveRamp(DT, chassis.accel_max, chassis.accel_max / FIRMWARE.CHASSIS_CMD_JERK_TIME_S, ramp))
+    vx_channel = int(FIRMWARE.JOYSTICK_LEFT_VERTICAL_CHANNEL)
+    vy_channel = int(FIRMWARE.JOYSTICK_LEFT_HORIZONTAL_CHANNEL)
+    sticks = [0, 0]
+    robot_state.chassis_power_limit = 60
+    vx_set, vy_set = ctypes.c_float(), ctypes.c_float()
+    for n in range(100000):
+        for axis in range(2):
+            if rng.random() < 0.002:
+                sticks[axis] = rng.choice((0, 660, -660, 480, -480, 250))
+        if rng.random() < 0.001:
+            robot_state.chassis_power_limit = rng.choice((45, 60, 80, 100, 140))
+        channels = [0] * 6
+        channels[vx_channel], channels[vy_channel] = sticks
+        remote.rc = channels
+        remote.key = int(FIRMWARE.KEY_PRESSED_OFFSET_SHIFT) if (n // 700) % 3 == 0 else 0
+        last = [(ramp.rate, ramp.out) for ramp in ramps]
+        FIRMWARE.chassis_rc_to_control_vector(ctypes.byref(vx_set), ctypes.byref(vy_set))
+        # joystick target as chassis_rc_to_control_vector maps it, with the speed limits of this period
+        targets = [f32(sticks[0] * f32(chassis.vx_max_speed / FIRMWARE.JOYSTICK_HALF_RANGE)),
+                   f32(sticks[1] * -f32(chassis.vy_max_speed / FIRMWARE.JOYSTICK_HALF_RANGE))]
+        for check, stop, ramp, (last_rate, last_out), target, stick in zip(checks, stops, ramps, last, targets, sticks):
+            if stick == 0:
+                stop[0] += 1
+                stop[1] += (ramp.out != 0.0) or (ramp.rate != 0.0)
+                # the next move starts from rest
+                check.last_target = None
+            else:
+                # bounds are the limits chassis_cmd_shape set for this period
+                check.step(ramp, last_rate, last_out, target, ramp.max_rate, ramp.max_jerk)
+    ok = all([check.report() for check in checks])
+    passed = all(stop[1] == 0 for stop in stops)
+    print("%s chassis stop command sets zero at once, %d of %d periods not at rest" %
+          ("ok  " if passed else "FAIL", sum(stop[1] for stop in stops), sum(stop[0] for stop in stops)))
+    return ok and passed
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check bounds of the S-curve set-point ramp")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    ok = test_steps()
+    ok &= test_reversal()
+    ok &= test_random_targets(args.seed)
+    ok &= test_chassis_shaping(args.seed)
+    if not ok:
+        raise SystemExit("S-curve ramp bound violated")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,237 @@
+# Host simulation of the local barrel heat model (application/shoot_heat.c) against the referee heat rules.
+# Plant: trigger wheel following the fire rate set-point with a lag, a bullet leaving half way through each ammo slot
+# (none while the hopper is empty), the rotor encoder and rpm sampled by the 4ms shoot loop. Referee: 10 heat per
+# bullet registered a little after it leaves, cooling at 10Hz, heat reports at 10Hz with UART latency.
+# Gating on the referee report with SHOOT_HEAT_LIMIT_CLEARANCE (previous) is compared with the local model while the
+# driver holds fire, for the opening burst and sustained fire. Checks:
+#   - local shot count is exact while ammo flows, wrap of the fast rotor included
+#   - the referee limit is never exceeded
+#   - more bullets within the same heat budget, for several limit / cooling levels
+#   - an empty hopper (trigger turning, no bullets) only makes the model conservative until the next report
+# The heat model is application/shoot_heat.c built by firmware_host.py, fed the trigger motor feedback and referee
+# frames the way the shoot task and the referee parser get them. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["application/shoot_heat.c", "components/algorithm/shot_detector.c", "application/referee.c", "application/CAN_receive.c",
+     "application/detect_task.c"],
+    headers=["shoot_heat.h", "shoot.h", "referee.h", "protocol.h"],
+    structs={
+        "shoot_heat_t": {"shot_count": ctypes.c_uint32},
+        "motor_measure_t": {"ecd": ctypes.c_uint16, "speed_rpm": ctypes.c_int16},
+        "ext_game_robot_state_t": {"shooter_barrel_cooling_value": ctypes.c_uint16, "shooter_barrel_heat_limit": ctypes.c_uint16},
+        "ext_power_heat_data_t": {"shooter_17mm_1_barrel_heat": ctypes.c_uint16},
+    },
+    constants=["SHOOT_CONTROL_TIME_MS", "TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO", "TRIGGER_WHEEL_CAPACITY", "TRIGGER_MOTOR_GEAR_RATIO",
+               "ECD_RANGE", "AUTO_FIRE_RATE", "SHOOT_HEAT_LIMIT_CLEARANCE", "SHOOT_HEAT_PER_BULLET", "SHOOT_HEAT_SHOT_PHASE",
+               "MOTOR_INDEX_TRIGGER", "REF_PROTOCOL_HEADER_SIZE", "ROBOT_STATE_CMD_ID", "POWER_HEAT_DATA_CMD_ID"],
+    config={"SHOOT_HEAT_LOCAL_MODEL": 1, "SHOOT_HEAT_FRICTION_SHOT_DETECTION": 0})
+HEAT = FIRMWARE.global_struct("shoot_heat_t", "shoot_heat_data")
+TRIGGER_MOTOR = FIRMWARE.global_struct("motor_measure_t", "motor_chassis", int(FIRMWARE.MOTOR_INDEX_TRIGGER))
+
+SHOOT_CONTROL_TIME_MS = int(FIRMWARE.SHOOT_CONTROL_TIME_MS)
+TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO = FIRMWARE.TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO
+TRIGGER_WHEEL_CAPACITY = FIRMWARE.TRIGGER_WHEEL_CAPACITY
+TRIGGER_MOTOR_GEAR_RATIO = FIRMWARE.TRIGGER_MOTOR_GEAR_RATIO
+ECD_RANGE = int(FIRMWARE.ECD_RANGE)
+TRIGGER_ANGLE_INCREMENT = 2.0 * math.pi / TRIGGER_WHEEL_CAPACITY
+AUTO_FIRE_RATE = FIRMWARE.AUTO_FIRE_RATE
+SHOOT_HEAT_LIMIT_CLEARANCE = FIRMWARE.SHOOT_HEAT_LIMIT_CLEARANCE
+SHOOT_HEAT_PER_BULLET = FIRMWARE.SHOOT_HEAT_PER_BULLET
+SHOOT_HEAT_SHOT_PHASE = FIRMWARE.SHOOT_HEAT_SHOT_PHASE
+
+# referee
+REFEREE_COOLING_PERIOD_MS = 100
+REFEREE_REPORT_PERIOD_MS = 100
+REFEREE_SHOT_DELAY_MS = 20  # speed module to heat
+UART_LATENCY_MS = (10, 60)
+
+# trigger wheel
+TRIGGER_LAG_S = 0.015
+SIM_DT_MS = 1
+# opening burst: heat limited on every level, cooling not yet dominant
+BURST_MS = 5000
+
+
+def referee_frame(cmd_id, data):
+    """a frame as referee_data_solve takes it from the unpacker, header and CRCs unchecked there"""
+    frame = bytes(int(FIRMWARE.REF_PROTOCOL_HEADER_SIZE)) + int(cmd_id).to_bytes(2, "little") + data.raw()
+    return ctypes.create_string_buffer(frame, len(frame) + 2)
+
+
+class LocalHeat:
+    """shoot_heat_data, updated every shoot period after the referee parser took the latest reports"""
+
+    def __init__(self, ecd):
+        TRIGGER_MOTOR.ecd = ecd
+        TRIGGER_MOTOR.speed_rpm = 0
+        FIRMWARE.shoot_heat_init()
+        self.referee_update = 0
+
+    @property
+    def shot_count(self):
+        return HEAT.shot_count
+
+    def update(self, now_ms, ecd, speed_rpm, referee):
+        while self.referee_update != referee.update_count:
+            self.referee_update += 1
+            state = FIRMWARE.new("ext_game_robot_state_t", shooter_barrel_cooling_value=referee.cooling_value,
+                                 shooter_barrel_heat_limit=referee.heat_limit)
+            FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.ROBOT_STATE_CMD_ID, state))
+            power_heat = FIRMWARE.new("ext_power_heat_data_t", shooter_17mm_1_barrel_heat=referee.reported_heat)
+            FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.POWER_HEAT_DATA_CMD_ID, power_heat))
+        TRIGGER_MOTOR.ecd = ecd
+        TRIGGER_MOTOR.speed_rpm = speed_rpm
+        FIRMWARE.shoot_heat_update(now_ms)
+
+    def overheated(self):
+        return FIRMWARE.shoot_heat_is_overheated()
+
+
+class RefereeGate:
+    # isOverheated() with SHOOT_HEAT_LOCAL_MODEL 0
+    def __init__(self, ecd):
+        self.shot_count = 0
+
+    def update(self, now_ms, ecd, speed_rpm, referee):
+        self.referee = referee
+
+    def overheated(self):
+        limit = self.referee.heat_limit
+        if SHOOT_HEAT_LIMIT_CLEARANCE > limit:
+            return self.referee.reported_heat + SHOOT_HEAT_LIMIT_CLEARANCE / 2 > limit
+        return self.referee.reported_heat + SHOOT_HEAT_LIMIT_CLEARANCE > limit
+
+
+class Referee:
+    def __init__(self, heat_limit, cooling_value, rng):
+        self.heat_limit = heat_limit
+        self.cooling_value = cooling_value
+        self.rng = rng
+        self.heat = 0.0
+        self.pending_shots = []  # registration times
+        self.reports = []  # (arrival time, heat)
+        self.reported_heat = 0
+        self.update_count = 0
+        self.over_limit = 0
+        self.max_heat = 0.0
+
+    def shot(self, now_ms):
+        self.pending_shots.append(now_ms + REFEREE_SHOT_DELAY_MS)
+
+    def step(self, now_ms):
+        while self.pending_shots and self.pending_shots[0] <= now_ms:
+            self.pending_shots.pop(0)
+            self.heat += SHOOT_HEAT_PER_BULLET
+            self.max_heat = max(self.max_heat, self.heat)
+            if self.heat > self.heat_limit:
+                self.over_limit += 1
+        if now_ms % REFEREE_COOLING_PERIOD_MS == 0:
+            self.heat = max(self.heat - self.cooling_value * REFEREE_COOLING_PERIOD_MS / 1000.0, 0.0)
+        if now_ms % REFEREE_REPORT_PERIOD_MS == 50:
+            self.reports.append((now_ms + self.rng.randint(*UART_LATENCY_MS), int(self.heat)))
+        while self.reports and self.reports[0][0] <= now_ms:
+            self.reported_heat = self.reports.pop(0)[1]
+            self.update_count += 1
+
+
+class Trigger:
+    # wheel angle in slots, rotor encoder and rpm as the C620 reports them
+    def __init__(self, rng):
+        self.rng = rng
+        self.wheel_angle = 0.0
+        self.wheel_speed = 0.0
+        self.rotor_angle = rng.uniform(0.0, 2.0 * math.pi)
+        self.slot = 0
+
+    def ecd(self):
+        return int(self.rotor_angle / (2.0 * math.pi) * ECD_RANGE) % ECD_RANGE
+
+    def speed_rpm(self):
+        return int(self.wheel_speed * TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO * TRIGGER_MOTOR_GEAR_RATIO * 60.0 / (2.0 * math.pi))
+
+    def step(self, speed_set, dt):
+        # returns the number of ammo slots whose bullet left during dt
+        self.wheel_speed += (speed_set - self.wheel_speed) * (1.0 - math.exp(-dt / TRIGGER_LAG_S))
+        delta = self.wheel_speed * dt
+        self.wheel_angle += delta
+        self.rotor_angle += delta * TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO * TRIGGER_MOTOR_GEAR_RATIO
+        fired = 0
+        while self.wheel_angle >= (self.slot + SHOOT_HEAT_SHOT_PHASE) * TRIGGER_ANGLE_INCREMENT:
+            self.slot += 1
+            fired += 1
+        return fired
+
+
+def run(gate_class, heat_limit, cooling_value, seed, duration_ms=20000, empty_hopper=None):
+    # driver holds auto fire the whole time; empty_hopper: (start, end) ms with no ammo
+    rng = random.Random(seed)
+    referee = Referee(heat_limit, cooling_value, rng)
+    trigger = Trigger(rng)
+    gate = gate_class(trigger.ecd())
+    fire_speed = AUTO_FIRE_RATE / 60.0 * TRIGGER_ANGLE_INCREMENT
+    speed_set = 0.0
+    bullets = 0
+    burst = 0
+    slots = 0
+    for now_ms in range(1, duration_ms + 1, SIM_DT_MS):
+        if now_ms % SHOOT_CONTROL_TIME_MS == 0:
+            gate.update(now_ms, trigger.ecd(), trigger.speed_rpm(), referee)
+            speed_set = 0.0 if gate.overheated() else fire_speed
+        fired = trigger.step(speed_set, SIM_DT_MS / 1000.0)
+        slots += fired
+        if empty_hopper and empty_hopper[0] <= now_ms < empty_hopper[1]:
+            fired = 0
+        for _ in range(fired):
+            referee.shot(now_ms)
+        bullets += fired
+        if now_ms == BURST_MS:
+            burst = bullets
+        referee.step(now_ms)
+    return {"bullets": bullets, "burst": burst, "slots": slots, "counted": gate.shot_count, "over_limit": referee.over_limit,
+            "max_heat": referee.max_heat, "gate": gate}
+
+
+def test_levels(report, seed):
+    # (heat limit, cooling value per second) over the robot levels of the 2024 rules, burst and cooling oriented
+    for limit, cooling in ((50, 40), (100, 60), (200, 40), (400, 80), (240, 20)):
+        old = run(RefereeGate, limit, cooling, seed)
+        new = run(LocalHeat, limit, cooling, seed)
+        # all heat the rules allow: the initial budget plus cooling over the run
+        budget = (limit + cooling * 20.0) / SHOOT_HEAT_PER_BULLET
+        print("     limit %d cooling %d: burst %d -> %d, %d -> %d bullets of %.0f, peak heat %.0f -> %.0f, over the limit %d -> %d"
+              % (limit, cooling, old["burst"], new["burst"], old["bullets"], new["bullets"], budget, old["max_heat"], new["max_heat"], old["over_limit"], new["over_limit"]))
+        report.check("limit %d cooling %d: never over the limit" % (limit, cooling), new["over_limit"] == 0)
+        report.check("limit %d cooling %d: shot count exact" % (limit, cooling), new["counted"] == new["slots"] == new["bullets"])
+        # the clearance was halved below 60, there the previous gate was about as tight as the local model
+        gain = 2 if limit >= 2 * SHOOT_HEAT_LIMIT_CLEARANCE else -1
+        report.check("limit %d cooling %d: more bullets" % (limit, cooling),
+                     new["burst"] >= old["burst"] + gain and new["bullets"] >= old["bullets"] and new["bullets"] >= 0.93 * budget)
+
+
+def test_empty_hopper(report, seed):
+    new = run(LocalHeat, 200, 40, seed, empty_hopper=(2000, 5000))
+    full = run(LocalHeat, 200, 40, seed)
+    report.check("empty hopper: conservative, never over the limit", new["over_limit"] == 0 and new["counted"] > new["bullets"],
+                 "%d slots counted, %d bullets fired, %d with a full hopper" % (new["counted"], new["bullets"], full["bullets"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the local barrel heat model against referee heat rules")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    report = Report()
+    test_levels(report, args.seed)
+    test_empty_hopper(report, args.seed)
+    if not report.ok:
+        raise SystemExit("shoot heat simulation failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,284 @@
+# Host test of the friction wheel shot detector (components/algorithm/shot_detector.c) and its two wheel fusion
+# (shoot_heat_friction_feedback() queueing the dips in the CAN interrupt, shoot_heat_update() pairing them in the shoot
+# task, application/shoot_heat.c), built by firmware_host.py with SHOOT_HEAT_FRICTION_SHOT_DETECTION on.
+# Synthetic traces: two direct drive 3508 friction wheels under the P speed loop of shoot.c at 4ms, each projectile
+# taking its kinetic energy from both wheels over the contact time, speed_rpm sampled at 1kHz as integers with ripple.
+# Checks:
+#   - detection rate and false detections at several fire rates
+#   - no detection on spin-up, spin-down, set-point steps and idle spinning
+#   - shot timestamp and muzzle speed error
+#   - a single wheel (other one offline) still counts every shot
+# --trace replays a recorded CSV (time_ms,left_rpm,right_rpm[,shot]) instead, shot is 1 on the sample a projectile was
+# fired if known, and prints the detections.
+# Exit code is non-zero on failure.
+
+import argparse
+import csv
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["components/algorithm/shot_detector.c", "application/shoot_heat.c", "application/referee.c"],
+    headers=["shoot_heat.h", "shoot.h"],
+    structs={
+        "shoot_heat_t": {"shot_count": ctypes.c_uint32, "shot_time": ctypes.c_uint32, "friction_dip": ctypes.c_uint8,
+                         "friction_dip_count": ctypes.c_uint32,
+                         "fire_rate": ctypes.c_float, "muzzle_speed": ctypes.c_float},
+        "shoot_heat_friction_dip_t": {"time": ctypes.c_uint32, "muzzle_speed": ctypes.c_float},
+    },
+    constants=["SHOOT_HEAT_SHOT_HISTORY", "FRICTION_MOTOR_RPM_TO_SPEED", "FRICTION_1_SPEED_PID_KP",
+               "FRICTION_1_SPEED_PID_MAX_OUT", "SHOOT_CONTROL_TIME_MS"],
+    config={"SHOOT_HEAT_FRICTION_SHOT_DETECTION": 1})
+SHOOT_HEAT_SHOT_HISTORY = int(FIRMWARE.SHOOT_HEAT_SHOT_HISTORY)
+FRICTION_MOTOR_RPM_TO_SPEED = FIRMWARE.FRICTION_MOTOR_RPM_TO_SPEED
+# FRICTION_MOTOR_SPEED with ENABLE_SHOOT_REDUNDANT_SWITCH, the build without it spins at 1m/s for the bench
+FRICTION_MOTOR_SPEED = 26.0
+FRICTION_SPEED_PID_KP = FIRMWARE.FRICTION_1_SPEED_PID_KP
+FRICTION_SPEED_PID_MAX_OUT = FIRMWARE.FRICTION_1_SPEED_PID_MAX_OUT
+SHOOT_CONTROL_TIME_MS = int(FIRMWARE.SHOOT_CONTROL_TIME_MS)
+HEAT = FIRMWARE.global_struct("shoot_heat_t", "shoot_heat_data")
+
+# plant
+WHEEL_INERTIA = 4.0e-5  # kg m^2, rotor and wheel
+MOTOR_TORQUE_PER_CMD = 20.0 / 16384.0 * 0.0157  # N m, rotor without gearbox
+DRAG_TORQUE = 0.01  # N m
+PROJECTILE_MASS = 0.0032  # kg, 17mm
+CONTACT_MS = 1.5
+RIPPLE_RPM = 8.0
+SIM_DT_MS = 0.1
+
+
+class FrictionShots:
+    """shoot_heat_data: both friction wheels fed at 1kHz from the CAN interrupt, the shoot task every control period"""
+
+    def __init__(self):
+        FIRMWARE.shoot_heat_init()
+        self.shot_time = []
+        self.muzzle_samples = []  # (dip time, per wheel estimate)
+        self.dip_count = 0
+        self.last_fire_rate = 0.0  # at the latest shot, reset after a pause
+
+    def feedback(self, wheel, speed_rpm, time_ms):
+        FIRMWARE.shoot_heat_friction_feedback(wheel, int(speed_rpm), time_ms)
+        while self.dip_count != HEAT.friction_dip_count:
+            dip = FIRMWARE.view("shoot_heat_friction_dip_t", HEAT.field_address("friction_dip"), self.dip_count % SHOOT_HEAT_SHOT_HISTORY)
+            self.muzzle_samples.append((dip.time, dip.muzzle_speed))
+            self.dip_count += 1
+
+    def update(self, now_ms):
+        shot_count = HEAT.shot_count
+        FIRMWARE.shoot_heat_update(now_ms)
+        shot_time = HEAT.shot_time
+        for i in range(shot_count, HEAT.shot_count):
+            self.shot_time.append(shot_time[i % SHOOT_HEAT_SHOT_HISTORY])
+        if HEAT.shot_count != shot_count:
+            self.last_fire_rate = HEAT.fire_rate
+
+    @property
+    def fire_rate(self):
+        return HEAT.fire_rate
+
+    @property
+    def muzzle_speed(self):
+        return HEAT.muzzle_speed
+
+
+class FrictionWheel:
+    def __init__(self, rng):
+        self.rng = rng
+        self.omega = 0.0  # rad/s
+        self.cmd = 0.0
+        self.shot_power = 0.0
+        self.shot_end = -1.0
+        self.ripple_phase = rng.uniform(0.0, 2.0 * math.pi)
+
+    def rpm(self):
+        return self.omega * 60.0 / (2.0 * math.pi)
+
+    def sample(self, t_ms):
+        # integer speed_rpm with commutation ripple and noise
+        ripple = 0.5 * RIPPLE_RPM * math.sin(self.omega * t_ms / 1000.0 * 7.0 + self.ripple_phase)
+        return int(round(self.rpm() + ripple + self.rng.gauss(0.0, RIPPLE_RPM)))
+
+    def control(self, rpm_set, rpm_measured):
+        self.cmd = max(-FRICTION_SPEED_PID_MAX_OUT, min(FRICTION_SPEED_PID_MAX_OUT, FRICTION_SPEED_PID_KP * (rpm_set - rpm_measured)))
+
+    def shoot(self, t_ms, energy):
+        self.shot_power = energy / (CONTACT_MS / 1000.0)
+        self.shot_end = t_ms + CONTACT_MS
+
+    def step(self, t_ms):
+        torque = self.cmd * MOTOR_TORQUE_PER_CMD - math.copysign(DRAG_TORQUE, self.omega) * min(1.0, abs(self.omega))
+        if t_ms < self.shot_end and self.omega > 1.0:
+            torque -= self.shot_power / self.omega
+        self.omega += torque / WHEEL_INERTIA * SIM_DT_MS / 1000.0
+
+
+def simulate(seed, duration_ms, speed_profile, shot_times, wheels_online=(True, True), mass_spread=0.03):
+    """speed_profile(t_ms) -> muzzle speed set-point in m/s, shot_times in ms. Returns fusion, truth list."""
+    rng = random.Random(seed)
+    wheel = [FrictionWheel(rng), FrictionWheel(rng)]
+    fusion = FrictionShots()
+    shots = sorted(shot_times)
+    truth = []  # (time, muzzle speed)
+    pending = []  # (exit time, index in truth)
+    next_shot = 0
+    last_rpm = [0, 0]
+    steps_per_ms = int(round(1.0 / SIM_DT_MS))
+    for ms in range(duration_ms):
+        if ms % SHOOT_CONTROL_TIME_MS == 0:
+            rpm_set = speed_profile(ms) / FRICTION_MOTOR_RPM_TO_SPEED
+            for i in range(2):
+                wheel[i].control(rpm_set, last_rpm[i])
+        for k in range(steps_per_ms):
+            t = ms + k * SIM_DT_MS
+            while next_shot < len(shots) and shots[next_shot] <= t:
+                # the projectile leaves with the surface speed at the end of the contact, half its energy from each wheel
+                v = FRICTION_MOTOR_RPM_TO_SPEED * 0.5 * (wheel[0].rpm() + wheel[1].rpm()) * 0.97
+                energy = 0.5 * PROJECTILE_MASS * rng.uniform(1.0 - mass_spread, 1.0 + mass_spread) * v * v / 2.0
+                for w in wheel:
+                    w.shoot(t, energy)
+                truth.append([shots[next_shot], 0.0])
+                pending.append((t + CONTACT_MS, len(truth) - 1))
+                next_shot += 1
+            for w in wheel:
+                w.step(t)
+            while pending and pending[0][0] <= t:
+                truth[pending[0][1]][1] = FRICTION_MOTOR_RPM_TO_SPEED * 0.5 * (wheel[0].rpm() + wheel[1].rpm())
+                pending.pop(0)
+        for i in range(2):
+            last_rpm[i] = wheel[i].sample(ms)
+            if wheels_online[i]:
+                fusion.feedback(i, last_rpm[i], ms)
+        if ms % SHOOT_CONTROL_TIME_MS == 0:
+            fusion.update(ms)
+    fusion.update(duration_ms)
+    return fusion, truth
+
+
+def constant_speed(spin_up_ms=0, spin_down_ms=None, speed=FRICTION_MOTOR_SPEED):
+    def profile(t):
+        if t < spin_up_ms or (spin_down_ms is not None and t >= spin_down_ms):
+            return 0.0
+        return speed
+    return profile
+
+
+def match(detected, truth, tolerance_ms=6):
+    """Pair detections with true shots. Returns hits [(detected, truth index)], misses, false detections."""
+    hits, used, false_count = [], set(), 0
+    j = 0
+    for d in detected:
+        while j < len(truth) and truth[j][0] < d - tolerance_ms:
+            j += 1
+        if j < len(truth) and abs(truth[j][0] - d) <= tolerance_ms and j not in used:
+            hits.append((d, j))
+            used.add(j)
+            j += 1
+        else:
+            false_count += 1
+    return hits, len(truth) - len(used), false_count
+
+
+def burst_times(rng, start, end, rate_hz):
+    times, t = [], float(start)
+    period = 1000.0 / rate_hz
+    while t < end:
+        times.append(t)
+        t += period * rng.uniform(0.9, 1.1)
+    return times
+
+
+def test_fire_rates(report, seed):
+    for rate in (5, 10, 20, 25):
+        rng = random.Random(seed * 100 + rate)
+        shots = burst_times(rng, 1500, 7500, rate)
+        fusion, truth = simulate(seed + rate, 8000, constant_speed(), shots)
+        hits, misses, false_count = match(fusion.shot_time, truth)
+        detection = len(hits) / float(len(truth))
+        timing = max([abs(d - truth[j][0]) for d, j in hits] or [0.0])
+        errors = []
+        for t, speed in fusion.muzzle_samples:
+            j = min(range(len(truth)), key=lambda k: abs(truth[k][0] - t))
+            errors.append(speed - truth[j][1])
+        rms = math.sqrt(sum(e * e for e in errors) / max(1, len(errors)))
+        report.check("%d Hz: detection" % rate, detection >= 0.99 and false_count <= 0.005 * len(truth),
+                     "%d of %d, %d missed, %d false" % (len(hits), len(truth), misses, false_count))
+        report.check("%d Hz: timestamp within 2ms" % rate, timing <= 2.0, "worst %.1fms" % timing)
+        report.check("%d Hz: muzzle speed" % rate, rms < 0.15, "rms error %.3f m/s, filtered %.2f m/s" % (rms, fusion.muzzle_speed))
+        report.check("%d Hz: fire rate" % rate, abs(fusion.last_fire_rate - rate) < 0.15 * rate and fusion.fire_rate == 0.0,
+                     "%.1f Hz at the last shot, %.1f Hz after the burst" % (fusion.last_fire_rate, fusion.fire_rate))
+
+
+def test_no_shots(report, seed):
+    # spin-up, idle spinning, set-point steps, spin-down
+    def profile(t):
+        if t < 500 or t >= 9000:
+            return 0.0
+        if 4000 <= t < 6000:
+            return 23.0
+        if 6000 <= t < 7000:
+            return 28.0
+        return FRICTION_MOTOR_SPEED
+    fusion, _ = simulate(seed, 11000, profile, [])
+    report.check("no shots: spin-up, steps, spin-down", len(fusion.shot_time) == 0,
+                 "%d false detections at %s" % (len(fusion.shot_time), fusion.shot_time[:5]))
+
+
+def test_single_wheel(report, seed):
+    rng = random.Random(seed)
+    shots = burst_times(rng, 1500, 5500, 20)
+    for online in ((True, False), (False, True)):
+        fusion, truth = simulate(seed, 6000, constant_speed(), shots, wheels_online=online)
+        hits, misses, false_count = match(fusion.shot_time, truth)
+        report.check("%s wheel only: detection" % ("left" if online[0] else "right"), misses <= 0.01 * len(truth) and false_count == 0,
+                     "%d of %d, %d false" % (len(hits), len(truth), false_count))
+
+
+def replay(path):
+    fusion = FrictionShots()
+    truth = []
+    last_time = 0
+    with open(path) as f:
+        for row in csv.DictReader(f):
+            t = int(float(row["time_ms"]))
+            fusion.feedback(0, float(row["left_rpm"]), t)
+            fusion.feedback(1, float(row["right_rpm"]), t)
+            if t % SHOOT_CONTROL_TIME_MS == 0:
+                fusion.update(t)
+            if int(float(row.get("shot") or 0)):
+                truth.append([t, 0.0])
+            last_time = t
+    fusion.update(last_time)
+    print("%d shots detected, fire rate %.1f Hz, muzzle speed %.2f m/s" % (len(fusion.shot_time), fusion.last_fire_rate, fusion.muzzle_speed))
+    for t in fusion.shot_time:
+        print("  %d ms" % t)
+    if truth:
+        hits, misses, false_count = match(fusion.shot_time, truth)
+        print("%d of %d marked shots detected, %d missed, %d false" % (len(hits), len(truth), misses, false_count))
+        return misses == 0 and false_count == 0
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Test the friction wheel shot detector on synthetic or recorded traces")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--trace", help="CSV with time_ms,left_rpm,right_rpm[,shot]")
+    args = parser.parse_args()
+    if args.trace:
+        if not replay(args.trace):
+            raise SystemExit("trace replay: detections don't match the marked shots")
+        return
+    report = Report()
+    test_fire_rates(report, args.seed)
+    test_no_shots(report, args.seed)
+    test_single_wheel(report, args.seed)
+    if not report.ok:
+        raise SystemExit("shot detector test failed")
+
+
+if __name__ == "__main__":
+    main()
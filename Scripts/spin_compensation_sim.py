@@ -0,0 +1,265 @@
+# Host simulation of spinning mode (application/chassis_task.c, application/chassis_behaviour.c).
+# Part 1, drift: the chassis spins under a gimbal holding its world heading while translating in the gimbal frame. The
+# command is mapped with the relative angle the gimbal task last read (previous code) or with
+# chassis_spin_compensated_relative_angle, its prediction for the middle of the period plus latency. The gimbal task
+# reads the quantized yaw encoder and the yaw motor speed of the last 1kHz feedback on its own period, out of phase
+# with the chassis, and tracks the relative rate with its angle tracker. Reports the sideways drift of the world
+# velocity and checks the compensation removes most of it, on the 1kHz event driven loop and the 5ms loop of the biped.
+# Part 2, random spin profile: the previous random speed generator against the band alternating one of
+# chassis_spinning_speed_manager, both through the power limited set-point shaping (chassis_cmd_shape). Evasion is
+# the rms heading error of enemy aim predictors over the bullet flight time; checks the new profile is harder to
+# predict and doesn't sit at the acceleration limit, which is where the power goes.
+# chassis_task.c (through Scripts/host/chassis_task_host.c), chassis_behaviour.c and angle_tracker.c are built by
+# firmware_host.py, the random numbers are the seeded host RNG. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import HOST_DIR, Firmware, Report
+
+CHASSIS_STRUCTS = {
+    "chassis_move_t": {"chassis_yaw_motor": ctypes.c_void_p, "relative_angle_dot": ctypes.c_float,
+                       "chassis_cmd_slow_set_wz": ctypes.c_uint8, "wz_max_speed": ctypes.c_float,
+                       "accel_max": ctypes.c_float, "wheel_rot_radii": ctypes.c_float, "fRandomSpinOn": ctypes.c_uint8,
+                       "dial_channel_out": ctypes.c_int16},
+    "chassis_loop_timing_t": {"dt": ctypes.c_float, "latency_avg_us": ctypes.c_float},
+    "gimbal_motor_t": {"relative_angle": ctypes.c_float},
+    "angle_tracker_t": {"speed": ctypes.c_float},
+    "s_curve_ramp_type_t": {"out": ctypes.c_float},
+}
+CHASSIS_CONSTANTS = ["CHASSIS_CONTROL_TIME_S", "CHASSIS_EVENT_DRIVEN_LOOP", "CHASSIS_SPIN_COMP_EXTRA_LEAD_S",
+                     "GIMBAL_CONTROL_TIME_S", "YAW_RELATIVE_TRACKER_BANDWIDTH_HZ", "SPINNING_CHASSIS_MAX_OMEGA",
+                     "CHASSIS_CMD_ACCEL_PER_WATT", "CHASSIS_CMD_JERK_TIME_S", "MOTOR_DISTANCE_TO_CENTER_DEFAULT"]
+
+
+def chassis_firmware(config=None):
+    return Firmware([HOST_DIR + "/chassis_task_host.c", "application/chassis_behaviour.c",
+                     "components/algorithm/angle_tracker.c"],
+                    headers=["chassis_task_host.h", "gimbal_task.h", "angle_tracker.h", "user_lib.h", "rtos_host.h",
+                             "bsp_rng_host.h"],
+                    structs=CHASSIS_STRUCTS, constants=CHASSIS_CONSTANTS, config=config,
+                    prototypes={"chassis_spinning_speed_manager": (None, [ctypes.c_void_p])})
+
+
+FIRMWARE = chassis_firmware()
+SPINNING_CHASSIS_MAX_OMEGA = FIRMWARE.SPINNING_CHASSIS_MAX_OMEGA
+WHEEL_ROT_RADIUS = FIRMWARE.MOTOR_DISTANCE_TO_CENTER_DEFAULT
+ECD_RANGE = 8192
+DT = FIRMWARE.CHASSIS_CONTROL_TIME_S
+SIM_DT = 0.00005
+
+
+def rad_format(angle):
+    return (angle + math.pi) % (2.0 * math.pi) - math.pi
+
+
+def rotate(angle, v):
+    c, s = math.cos(angle), math.sin(angle)
+    return c * v[0] - s * v[1], s * v[0] + c * v[1]
+
+
+def drift(fw, wz, latency, wheel_tau, compensate, seed=1):
+    # returns the mean world velocity error, m/s, for 1 m/s commanded forward in the gimbal frame
+    rng = random.Random(seed)
+    period = fw.CHASSIS_CONTROL_TIME_S
+    gimbal_period = fw.GIMBAL_CONTROL_TIME_S
+    chassis = fw.global_struct("chassis_move_t", "chassis_move")
+    timing = fw.global_struct("chassis_loop_timing_t", "chassis_loop_timing")
+    yaw_motor = fw.new("gimbal_motor_t")
+    tracker = fw.new("angle_tracker_t")
+    fw.angle_tracker_init(tracker, fw.YAW_RELATIVE_TRACKER_BANDWIDTH_HZ, gimbal_period)
+    fw.angle_tracker_reset(tracker, 0.0, -wz)
+    chassis.chassis_yaw_motor = yaw_motor.address
+    timing.dt = period
+    timing.latency_avg_us = latency * 1e6
+    v_gimbal = (1.0, 0.0)
+    duration = 4.0
+    settle = 1.0
+    t = 0.0
+    next_control = 0.0
+    # the gimbal task runs on its own clock
+    next_gimbal = rng.uniform(0.0, gimbal_period)
+    pending = []  # (apply time, command)
+    command = (0.0, 0.0)
+    v_chassis = [0.0, 0.0]
+    sum_err = [0.0, 0.0]
+    samples = 0
+    while t < duration:
+        if t >= next_gimbal:
+            # relative angle of the gimbal, chassis heading wz * t, gimbal world heading 0, from the last yaw motor
+            # feedback, sent at 1kHz, and its speed in rpm
+            age = rng.uniform(0.0, 0.001)
+            angle = round(rad_format(-wz * (t - age)) / (2.0 * math.pi) * ECD_RANGE) * 2.0 * math.pi / ECD_RANGE
+            rate = round(-wz * 60.0 / (2.0 * math.pi)) * 2.0 * math.pi / 60.0
+            yaw_motor.relative_angle = angle
+            fw.angle_tracker_update(tracker, angle, rate)
+            next_gimbal += gimbal_period
+        if t >= next_control:
+            # chassis_feedback_update takes the rate from the gimbal tracker
+            chassis.relative_angle_dot = tracker.speed
+            angle = fw.host_chassis_spin_compensated_relative_angle() if compensate else yaw_motor.relative_angle
+            pending.append((t + latency, rotate(angle, v_gimbal)))
+            next_control += period
+        while pending and pending[0][0] <= t:
+            command = pending.pop(0)[1]
+        # wheel speed loop as a first order lag in the chassis frame
+        k = 1.0 if wheel_tau <= 0.0 else 1.0 - math.exp(-SIM_DT / wheel_tau)
+        v_chassis[0] += k * (command[0] - v_chassis[0])
+        v_chassis[1] += k * (command[1] - v_chassis[1])
+        if t >= settle:
+            v_world = rotate(wz * t, v_chassis)
+            sum_err[0] += v_world[0] - v_gimbal[0]
+            sum_err[1] += v_world[1] - v_gimbal[1]
+            samples += 1
+        t += SIM_DT
+    return math.hypot(sum_err[0], sum_err[1]) / samples
+
+
+class PreviousSpinGenerator:
+    # chassis_spinning_speed_manager before the band alternating profile, dial at 0
+    def __init__(self, rng, wz_max):
+        self.rng = rng
+        self.wz_max = wz_max
+        self.min_speed = SPINNING_CHASSIS_MAX_OMEGA * 0.583
+        self.max_speed = SPINNING_CHASSIS_MAX_OMEGA * 0.667
+        self.counter = 0
+        self.param_period = 5
+        self.period = 1.0
+        self.last = -1e9
+        self.speed = self.min_speed
+
+    def update(self, t):
+        if t - self.last >= self.period:
+            self.speed = self.rng.uniform(self.min_speed, self.max_speed)
+            self.last = t
+            self.counter += 1
+            if self.counter >= self.param_period:
+                self.min_speed = self.wz_max * 0.667
+                self.max_speed = (self.wz_max + self.min_speed) / 2.0
+                self.param_period = self.rng.randint(1, 5)
+                self.period = self.rng.uniform(0.25, 1.0)
+                self.counter = 0
+        return self.speed
+
+
+class BandSpinGenerator:
+    """the fRandomSpinOn branch of chassis_spinning_speed_manager, dial at 0"""
+
+    def __init__(self, seed, wz_max):
+        FIRMWARE.host_rng_seed(seed)
+        chassis = FIRMWARE.global_struct("chassis_move_t", "chassis_move")
+        chassis.fRandomSpinOn = 1
+        chassis.dial_channel_out = 0
+        chassis.wz_max_speed = wz_max
+        self.wz_set = ctypes.c_float()
+
+    def update(self, t):
+        FIRMWARE.host_set_tick(int(round(t * 1000.0)))
+        FIRMWARE.chassis_spinning_speed_manager(ctypes.byref(self.wz_set))
+        return self.wz_set.value
+
+
+def spin_profile(generator, accel_max, duration=60.0):
+    """wz_set of chassis_set_control in spinning mode, shaped by chassis_cmd_shape as the power level allows"""
+    chassis = FIRMWARE.global_struct("chassis_move_t", "chassis_move")
+    chassis.accel_max = accel_max
+    chassis.wheel_rot_radii = [WHEEL_ROT_RADIUS] * 4
+    FIRMWARE.global_struct("chassis_loop_timing_t", "chassis_loop_timing").dt = DT
+    wz_accel = accel_max / WHEEL_ROT_RADIUS
+    # as chassis_init
+    ramp = FIRMWARE.view("s_curve_ramp_type_t", chassis.field_address("chassis_cmd_slow_set_wz"))
+    FIRMWARE.s_curve_ramp_init(ramp, DT, wz_accel, wz_accel / FIRMWARE.CHASSIS_CMD_JERK_TIME_S)
+    wz = []
+    for n in range(int(round(duration / DT))):
+        wz.append(FIRMWARE.host_chassis_cmd_shape(ramp, generator.update(n * DT), wz_accel))
+    return wz
+
+
+def evasion(wz, horizon, rate_tau, dt=DT, settle=5.0):
+    # rms heading miss of an aim predictor extrapolating its spin rate estimate, a first order filter of the true rate
+    # with time constant rate_tau (0: the rate right now), over horizon
+    heading = [0.0]
+    for w in wz:
+        heading.append(heading[-1] + w * dt)
+    h = int(horizon / dt)
+    k = 1.0 if rate_tau <= 0.0 else 1.0 - math.exp(-dt / rate_tau)
+    rate = wz[0]
+    err = 0.0
+    count = 0
+    for n in range(len(wz) - h):
+        rate += k * (wz[n] - rate)
+        if n * dt >= settle:
+            err += (heading[n + h] - heading[n] - rate * horizon) ** 2
+            count += 1
+    return math.sqrt(err / count)
+
+
+def accel_stats(wz, accel_limit, dt=DT):
+    accel = [(b - a) / dt for a, b in zip(wz, wz[1:])]
+    at_limit = sum(1 for x in accel if abs(x) > 0.5 * accel_limit) / len(accel)
+    # mean |wz * wz_dot| is the rotational power up to the chassis inertia
+    power = sum(abs(w * x) for w, x in zip(wz, accel)) / len(accel)
+    return at_limit, max(abs(x) for x in accel), power, sum(wz) / len(wz)
+
+
+def test_drift(report):
+    # event driven 1kHz loop with measured latency, and the 5ms loop of the biped without
+    latency = 0.0003
+    for name, fw in (("1kHz loop", FIRMWARE), ("5ms loop", chassis_firmware({"ROBOT_TYPE": "INFANTRY_2024_BIPED"}))):
+        for wz in (SPINNING_CHASSIS_MAX_OMEGA, 1.5 * SPINNING_CHASSIS_MAX_OMEGA):
+            old = drift(fw, wz, latency, 0.0, False)
+            new = drift(fw, wz, latency, 0.0, True)
+            report.check("%s, wz %.1f rad/s" % (name, wz), new < 0.25 * old,
+                         "drift %.1f -> %.1f mm/s per m/s (%.2f -> %.2f deg)" % (old * 1e3, new * 1e3, math.degrees(old), math.degrees(new)))
+    # wheel speed loop lag is not in the default lead, CHASSIS_SPIN_COMP_EXTRA_LEAD_S is where it goes
+    tau = 0.01
+    wz = SPINNING_CHASSIS_MAX_OMEGA
+    tuned_fw = chassis_firmware({"CHASSIS_SPIN_COMP_EXTRA_LEAD_S": "%.6ff" % (FIRMWARE.CHASSIS_SPIN_COMP_EXTRA_LEAD_S + tau)})
+    old = drift(FIRMWARE, wz, latency, tau, False)
+    new = drift(FIRMWARE, wz, latency, tau, True)
+    tuned = drift(tuned_fw, wz, latency, tau, True)
+    report.check("1kHz loop, 10ms wheel lag", new < old and tuned < 0.25 * old,
+                 "drift %.1f -> %.1f mm/s per m/s, %.1f with the lag in the extra lead" % (old * 1e3, new * 1e3, tuned * 1e3))
+
+
+def test_spin_profile(report, seed):
+    # 60W: power level 4
+    accel_max = FIRMWARE.CHASSIS_CMD_ACCEL_PER_WATT * 60.0
+    wz_accel = accel_max / WHEEL_ROT_RADIUS
+    wz_max = 1.5 * SPINNING_CHASSIS_MAX_OMEGA
+    horizon = 0.3  # bullet flight plus enemy system latency
+    rate_taus = (0.0, 0.1, 0.3, 1.0)
+    results = {}
+    for name, generator in (("previous", PreviousSpinGenerator(random.Random(seed), wz_max)),
+                            ("band", BandSpinGenerator(seed, wz_max))):
+        wz = spin_profile(generator, accel_max)
+        results[name] = [evasion(wz, horizon, tau) for tau in rate_taus] + list(accel_stats(wz, wz_accel))
+        r = results[name]
+        print("     %-8s miss %s rad for rate filters of %s s, %.0f%% time accelerating, peak %.1f rad/s^2, "
+              "power proxy %.1f, mean %.2f rad/s" % (name, "/".join("%.3f" % x for x in r[:4]), "/".join("%g" % t for t in rate_taus),
+                                                     100.0 * r[4], r[5], r[6], r[7]))
+    old, new = results["previous"], results["band"]
+    ratios = [new[i] / old[i] for i in range(len(rate_taus))]
+    # fast trackers are what an auto-aim uses against spinning; a slow average is not fooled less than before
+    report.check("band profile harder to predict", ratios[0] > 1.5 and ratios[1] > 1.5 and min(ratios) >= 1.0,
+                 "miss x%s" % "/x".join("%.1f" % x for x in ratios))
+    # shaping keeps the acceleration within the power limited one (braking may use twice)
+    report.check("within power", new[5] <= 2.0 * wz_accel * 1.001 and new[4] < 0.6,
+                 "%.0f%% of the time accelerating" % (100.0 * new[4]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate spinning mode drift compensation and random spin profile")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    report = Report()
+    test_drift(report)
+    test_spin_profile(report, args.seed)
+    if not report.ok:
+        raise SystemExit("spinning mode simulation failed")
+
+
+if __name__ == "__main__":
+    main()
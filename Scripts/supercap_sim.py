@@ -0,0 +1,447 @@
+# Host simulation of the supercapacitor energy manager (application/supercap_manager.c) in a game.
+# Plant: capacitor bank with charge/discharge efficiency behind a cap controller that follows the command frame, the
+# referee power meter with its buffer energy, and a chassis drawing what the driver asks for within the budget of
+# chassis_power_control. The cap voltage comes back over CAN at 100 Hz, quantized and noisy.
+# Compares the manager with the previous behaviour (cap energy always on top of the budget, controller charging at
+# the referee limit on its own) over a game with a preparation stage, cruising above the limit and shift sprints.
+# Checks:
+#   - more power during sprints and more cap energy when a sprint starts
+#   - referee buffer never runs out
+#   - cap goes into the battle nearly full, and the energy left at the end of the game is spent
+#   - boost time prediction under a constant drain
+#   - command frame layout and scaling
+#   - the power model is fitted only while the budget leaves the cap alone
+# Manager, budget and referee parsing are application/supercap_manager.c, chassis_power_control.c and referee.c built
+# by firmware_host.py, fed the cap feedback and the referee reports as frames. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+import struct
+
+from firmware_host import Firmware, Report
+
+SOURCES = ["application/supercap_manager.c", "application/chassis_power_control.c", "application/chassis_task.c",
+           "application/referee.c", "application/detect_task.c", "application/CAN_receive.c", "components/controller/pid.c"]
+HEADERS = ["supercap_manager.h", "chassis_power_control.h", "chassis_task.h", "referee.h", "protocol.h", "detect_task.h"]
+STRUCTS = {
+    "supcap_manager_t": {"mode": ctypes.c_int, "energy_reserve": ctypes.c_float, "boost_time_left": ctypes.c_float,
+                         "input_power_limit": ctypes.c_float, "discharge_allowance": ctypes.c_float,
+                         "charge_power": ctypes.c_float},
+    "supcap_cmd_t": {"can_buf": ctypes.c_uint8},
+    "supcap_t": {"can_buf": ctypes.c_uint8},
+    "chassis_power_control_t": {"budget": ctypes.c_float, "fSupcapUsed": ctypes.c_uint8},
+    "chassis_move_t": {"motor_chassis": ctypes.c_uint8},
+    "chassis_motor_t": {"chassis_motor_measure": ctypes.c_void_p},
+    "chassis_loop_timing_t": {"dt": ctypes.c_float},
+    "error_t": {"error_exist": ctypes.c_uint8},
+    "ext_game_state_t": {"stage_remain_time": ctypes.c_uint16},
+    "ext_game_robot_state_t": {"robot_id": ctypes.c_uint8, "chassis_power_limit": ctypes.c_uint16},
+    "ext_power_heat_data_t": {"chassis_power": ctypes.c_float, "buffer_energy": ctypes.c_uint16},
+}
+CONSTANTS = ["SUPCAP_VOLTAGE_MIN", "SUPCAP_VOLTAGE_MAX", "SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD", "SUPCAP_CAPACITANCE",
+             "SUPCAP_MAX_DISCHARGE_POWER", "SUPCAP_DISCHARGE_HORIZON_S", "SUPCAP_MAX_CHARGE_POWER", "SUPCAP_COMMAND_DIVIDER",
+             "SUPCAP_MODE_OFFLINE", "SUPCAP_MODE_NORMAL", "SUPCAP_MODE_RECHARGE", "SUPCAP_MODE_BOOST",
+             "CHASSIS_POWER_BUFFER_RESERVE", "CHASSIS_POWER_BUFFER_SPEND_TIME_S", "CHASSIS_CONTROL_TIME_S",
+             "PROGRESS_PREPARE", "PROGRESS_5sCOUNTDOWN", "PROGRESS_BATTLE", "PROGRESS_CALCULATING", "SUPCAP_END_GAME_WINDOW_S",
+             "SUPCAP_TOE", "REFEREE_TOE", "REF_PROTOCOL_HEADER_SIZE", "GAME_STATE_CMD_ID", "ROBOT_STATE_CMD_ID",
+             "POWER_HEAT_DATA_CMD_ID"]
+FIRMWARE = Firmware(SOURCES, headers=HEADERS, structs=STRUCTS, constants=CONSTANTS)
+
+SUPCAP_VOLTAGE_MIN = FIRMWARE.SUPCAP_VOLTAGE_MIN
+SUPCAP_VOLTAGE_MAX = FIRMWARE.SUPCAP_VOLTAGE_MAX
+SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD = FIRMWARE.SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD
+SUPCAP_CAPACITANCE = FIRMWARE.SUPCAP_CAPACITANCE
+SUPCAP_MAX_DISCHARGE_POWER = FIRMWARE.SUPCAP_MAX_DISCHARGE_POWER
+SUPCAP_DISCHARGE_HORIZON_S = FIRMWARE.SUPCAP_DISCHARGE_HORIZON_S
+SUPCAP_MAX_CHARGE_POWER = FIRMWARE.SUPCAP_MAX_CHARGE_POWER
+SUPCAP_COMMAND_DIVIDER = int(FIRMWARE.SUPCAP_COMMAND_DIVIDER)
+SUPCAP_END_GAME_WINDOW_S = FIRMWARE.SUPCAP_END_GAME_WINDOW_S
+CHASSIS_POWER_BUFFER_RESERVE = FIRMWARE.CHASSIS_POWER_BUFFER_RESERVE
+CHASSIS_POWER_BUFFER_SPEND_TIME_S = FIRMWARE.CHASSIS_POWER_BUFFER_SPEND_TIME_S
+CHASSIS_CONTROL_TIME_S = FIRMWARE.CHASSIS_CONTROL_TIME_S
+MODE_OFFLINE, MODE_NORMAL, MODE_RECHARGE, MODE_BOOST = (int(FIRMWARE.SUPCAP_MODE_OFFLINE), int(FIRMWARE.SUPCAP_MODE_NORMAL),
+                                                        int(FIRMWARE.SUPCAP_MODE_RECHARGE), int(FIRMWARE.SUPCAP_MODE_BOOST))
+PROGRESS_PREPARE, PROGRESS_5sCOUNTDOWN, PROGRESS_BATTLE, PROGRESS_CALCULATING = (
+    int(FIRMWARE.PROGRESS_PREPARE), int(FIRMWARE.PROGRESS_5sCOUNTDOWN), int(FIRMWARE.PROGRESS_BATTLE), int(FIRMWARE.PROGRESS_CALCULATING))
+SUPCAP_ENERGY_MAX = 0.5 * SUPCAP_CAPACITANCE * (SUPCAP_VOLTAGE_MAX ** 2 - SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD ** 2)
+# a robot id of a red infantry, 0 means no referee data yet
+ROBOT_ID = 3
+
+# referee rules
+REFEREE_BUFFER_MAX = 60.0
+REFEREE_PERIOD_S = 0.02
+
+# cap controller hardware
+CAP_CHARGE_EFFICIENCY = 0.9
+CAP_DISCHARGE_EFFICIENCY = 0.92
+CAP_FEEDBACK_PERIOD_S = 0.01
+CAP_VOLTAGE_NOISE = 0.01  # V rms
+
+
+def constrain(value, low, high):
+    return max(low, min(high, value))
+
+
+def usable_energy(voltage):
+    return max(0.5 * SUPCAP_CAPACITANCE * (voltage * voltage - SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD ** 2), 0.0)
+
+
+def referee_frame(cmd_id, data):
+    """a frame as referee_data_solve takes it from the unpacker, header and CRCs unchecked there"""
+    frame = bytes(int(FIRMWARE.REF_PROTOCOL_HEADER_SIZE)) + int(cmd_id).to_bytes(2, "little") + data
+    return ctypes.create_string_buffer(frame, len(frame) + 2)
+
+
+class SupercapManager:
+    """supercap_manager_update() and the budget of chassis_power_control(), the chassis motors at rest"""
+
+    def __init__(self):
+        fw = FIRMWARE
+        for toe in (fw.SUPCAP_TOE, fw.REFEREE_TOE):
+            fw.global_struct("error_t", "error_list", int(toe)).error_exist = 0
+        fw.global_struct("chassis_loop_timing_t", "chassis_loop_timing").dt = CHASSIS_CONTROL_TIME_S
+        chassis = fw.global_struct("chassis_move_t", "chassis_move")
+        for i in range(4):
+            # motor_chassis of CAN_receive.c, all zero
+            wheel = fw.view("chassis_motor_t", chassis.field_address("motor_chassis"), i)
+            wheel.chassis_motor_measure = ctypes.addressof(ctypes.c_char.in_dll(fw.lib, "motor_chassis"))
+        self.data = fw.global_struct("supcap_manager_t", "supercap_manager_data")
+        self.power = fw.global_struct("chassis_power_control_t", "chassis_power_control_data")
+        self.feedback = fw.global_struct("supcap_t", "cap_message_rx")
+        fw.init_referee_struct_data()
+        fw.supercap_manager_init()
+        fw.chassis_power_control_init()
+        self.power_limit = None
+        self.game_state = None
+
+    @property
+    def discharge_allowance(self):
+        return self.data.discharge_allowance
+
+    @property
+    def boost_time_left(self):
+        return self.data.boost_time_left
+
+    def referee(self, referee):
+        """the reports of the referee, game and robot state only when they change"""
+        game_state = (referee.game.progress, referee.game.time_remain)
+        if game_state != self.game_state:
+            self.game_state = game_state
+            data = FIRMWARE.new("ext_game_state_t", stage_remain_time=referee.game.time_remain).raw()
+            FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.GAME_STATE_CMD_ID, bytes([referee.game.progress << 4]) + data[1:]))
+        if referee.power_limit != self.power_limit:
+            self.power_limit = referee.power_limit
+            state = FIRMWARE.new("ext_game_robot_state_t", robot_id=ROBOT_ID, chassis_power_limit=int(referee.power_limit))
+            FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.ROBOT_STATE_CMD_ID, state.raw()))
+        power_heat = FIRMWARE.new("ext_power_heat_data_t", chassis_power=referee.reported_power, buffer_energy=int(referee.reported_buffer))
+        FIRMWARE.referee_data_solve(referee_frame(FIRMWARE.POWER_HEAT_DATA_CMD_ID, power_heat.raw()))
+
+    def cap_feedback(self, voltage):
+        """frame 0x301 of the cap controller"""
+        self.feedback.can_buf = struct.pack("<BBHf", 1, 0, int(round(voltage * 1000.0)), 0.0)
+
+    def update(self, sprint, chassis_power):
+        """returns the chassis budget"""
+        FIRMWARE.supercap_manager_update(int(sprint), chassis_power)
+        FIRMWARE.chassis_power_control()
+        return self.power.budget
+
+    def command(self):
+        cmd = FIRMWARE.new("supcap_cmd_t")
+        FIRMWARE.supercap_manager_command(cmd)
+        return bytes(cmd.can_buf)
+
+
+class PreviousManager(SupercapManager):
+    """chassis_power_budget before the manager: all usable energy on top of the referee budget, no command frame"""
+
+    def update(self, sprint, chassis_power):
+        FIRMWARE.supercap_manager_update(int(sprint), chassis_power)
+        voltage = struct.unpack("<BBHf", bytes(self.feedback.can_buf))[2] / 1000.0
+        self.data.mode = MODE_NORMAL
+        self.data.discharge_allowance = min(SUPCAP_MAX_DISCHARGE_POWER, usable_energy(voltage) / SUPCAP_DISCHARGE_HORIZON_S)
+        FIRMWARE.chassis_power_control()
+        return self.power.budget
+
+    def command(self):
+        return None
+
+
+class Game:
+    # end_game_clock=False: the remaining time reported never goes below the end of game window
+    def __init__(self, prepare_s, battle_s, end_game_clock=True):
+        self.prepare_s = prepare_s
+        self.battle_s = battle_s
+        self.end_game_clock = end_game_clock
+        self.progress = PROGRESS_PREPARE
+        self.time_remain = 0
+
+    def update(self, t):
+        if t < self.prepare_s - 5.0:
+            self.progress = PROGRESS_PREPARE
+        elif t < self.prepare_s:
+            self.progress = PROGRESS_5sCOUNTDOWN
+        elif t < self.prepare_s + self.battle_s:
+            self.progress = PROGRESS_BATTLE
+            self.time_remain = int(self.prepare_s + self.battle_s - t)
+            if not self.end_game_clock:
+                self.time_remain = max(self.time_remain, int(SUPCAP_END_GAME_WINDOW_S))
+        else:
+            self.progress = PROGRESS_CALCULATING
+            self.time_remain = 0
+
+
+class Referee:
+    # power meter on the cap controller input, reports every REFEREE_PERIOD_S
+    def __init__(self, power_limit, game):
+        self.power_limit = power_limit
+        self.buffer = REFEREE_BUFFER_MAX
+        self.reported_power = 0.0
+        self.reported_buffer = REFEREE_BUFFER_MAX
+        self.game = game
+        self.energy_in = 0.0
+        self.time_in = 0.0
+        self.overrun_s = 0.0
+
+    def step(self, input_power, dt):
+        """returns True when a report is due"""
+        self.energy_in += input_power * dt
+        self.time_in += dt
+        if self.time_in >= REFEREE_PERIOD_S - 1e-9:
+            self.reported_power = self.energy_in / self.time_in
+            self.buffer += (self.power_limit - self.reported_power) * self.time_in
+            if self.buffer < 0.0:
+                self.overrun_s += self.time_in
+                self.buffer = 0.0
+            self.buffer = min(self.buffer, REFEREE_BUFFER_MAX)
+            self.reported_buffer = self.buffer
+            self.energy_in = 0.0
+            self.time_in = 0.0
+            return True
+        return False
+
+
+class CapController:
+    # with a command: holds its input at min(input limit, chassis + charge power). Without: holds it at the referee
+    # limit. Chassis draw above the input comes from the cap; when the cap is empty the input has to cover it all.
+    def __init__(self, energy, rng):
+        self.stored = 0.5 * SUPCAP_CAPACITANCE * SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD ** 2 + energy
+        self.rng = rng
+        self.cmd = None
+        self.measured_voltage = self.voltage()
+        self.since_feedback = 0.0
+
+    def voltage(self):
+        return math.sqrt(2.0 * self.stored / SUPCAP_CAPACITANCE)
+
+    def energy(self):
+        return usable_energy(self.voltage())
+
+    def step(self, chassis_power, power_limit, dt):
+        if self.cmd is None:
+            target_input = power_limit
+            charge_max = SUPCAP_MAX_CHARGE_POWER
+        else:
+            input_limit, charge, _, _, _ = struct.unpack("<HHBBH", self.cmd)
+            target_input = min(input_limit / 100.0, chassis_power + charge / 100.0)
+            charge_max = charge / 100.0
+        if self.voltage() >= SUPCAP_VOLTAGE_MAX:
+            target_input = min(target_input, chassis_power)
+        input_power = target_input
+        if chassis_power > input_power:
+            need = (chassis_power - input_power) / CAP_DISCHARGE_EFFICIENCY * dt
+            floor = 0.5 * SUPCAP_CAPACITANCE * SUPCAP_VOLTAGE_MIN ** 2
+            taken = min(need, max(self.stored - floor, 0.0))
+            self.stored -= taken
+            input_power += (need - taken) / dt * CAP_DISCHARGE_EFFICIENCY
+        else:
+            charge_power = min(input_power - chassis_power, charge_max)
+            input_power = chassis_power + charge_power
+            self.stored += charge_power * CAP_CHARGE_EFFICIENCY * dt
+        self.stored = min(self.stored, 0.5 * SUPCAP_CAPACITANCE * SUPCAP_VOLTAGE_MAX ** 2)
+
+        self.since_feedback += dt
+        if self.since_feedback >= CAP_FEEDBACK_PERIOD_S - 1e-9:
+            self.since_feedback = 0.0
+            self.measured_voltage = round((self.voltage() + self.rng.gauss(0.0, CAP_VOLTAGE_NOISE)) * 1000.0) / 1000.0
+        return input_power
+
+
+class Driver:
+    # cruising demand changing every couple of seconds, a shift sprint every sprint_period_s (None: no sprints)
+    def __init__(self, rng, start_s, sprint_period_s=15.0, sprint_s=3.0):
+        self.rng = rng
+        self.start_s = start_s
+        self.sprint_period_s = sprint_period_s
+        self.sprint_s = sprint_s
+        self.cruise = 0.0
+        self.next_change = 0.0
+
+    def demand(self, t):
+        # returns (chassis power wanted, shift pressed)
+        if t < self.start_s:
+            return 0.0, False
+        since = t - self.start_s
+        if self.sprint_period_s and since % self.sprint_period_s >= self.sprint_period_s - self.sprint_s:
+            return 260.0, True
+        if t >= self.next_change:
+            self.cruise = self.rng.uniform(20.0, 110.0)
+            self.next_change = t + self.rng.uniform(0.5, 3.0)
+        return self.cruise, False
+
+
+def run_game(manager, seed, power_limit=60.0, prepare_s=60.0, battle_s=180.0, sprint_period_s=15.0, end_game_clock=True):
+    rng = random.Random(seed)
+    game = Game(prepare_s, battle_s, end_game_clock)
+    referee = Referee(power_limit, game)
+    cap = CapController(0.0, rng)
+    driver = Driver(random.Random(seed + 1), prepare_s, sprint_period_s)
+    dt = CHASSIS_CONTROL_TIME_S
+    chassis_power = 0.0
+    sprint_energy = 0.0
+    sprint_time = 0.0
+    sprint_start_energy = []
+    last_sprint = False
+    energy_at_battle_start = None
+    cmd_slot = 0
+    game.update(0.0)
+    manager.referee(referee)
+    steps = int((prepare_s + battle_s) / dt)
+    for n in range(steps):
+        t = n * dt
+        game.update(t)
+        if energy_at_battle_start is None and game.progress == PROGRESS_BATTLE:
+            energy_at_battle_start = cap.energy()
+        wanted, sprint = driver.demand(t)
+        manager.cap_feedback(cap.measured_voltage)
+        budget = manager.update(sprint, chassis_power)
+        cmd_slot = (cmd_slot + 1) % SUPCAP_COMMAND_DIVIDER
+        if cmd_slot == 0:
+            cap.cmd = manager.command()
+        chassis_power = min(wanted, budget)
+        input_power = cap.step(chassis_power, power_limit, dt)
+        if referee.step(input_power, dt):
+            manager.referee(referee)
+        if sprint:
+            if not last_sprint:
+                sprint_start_energy.append(cap.energy())
+            sprint_energy += chassis_power * dt
+            sprint_time += dt
+        last_sprint = sprint
+    return {
+        "sprint_power": sprint_energy / sprint_time if sprint_time else 0.0,
+        "sprint_start_energy": sum(sprint_start_energy) / len(sprint_start_energy) if sprint_start_energy else 0.0,
+        "overrun_s": referee.overrun_s,
+        "battle_start_energy": energy_at_battle_start,
+        "end_energy": cap.energy(),
+    }
+
+
+def boost_prediction_error(drain_power, seed):
+    # cap drained at a constant power from full, prediction against the true time to empty, worst relative error
+    # once the filters settled and before the last second
+    rng = random.Random(seed)
+    manager = SupercapManager()
+    game = Game(0.0, 600.0)
+    game.update(1.0)
+    manager.referee(Referee(60.0, game))
+    cap = CapController(SUPCAP_ENERGY_MAX, rng)
+    dt = CHASSIS_CONTROL_TIME_S
+    empty_time = SUPCAP_ENERGY_MAX * CAP_DISCHARGE_EFFICIENCY / drain_power
+    worst = 0.0
+    t = 0.0
+    while t < empty_time - 1.0:
+        manager.cap_feedback(cap.measured_voltage)
+        manager.update(True, 0.0)
+        cap.stored -= drain_power / CAP_DISCHARGE_EFFICIENCY * dt
+        cap.since_feedback += dt
+        if cap.since_feedback >= CAP_FEEDBACK_PERIOD_S - 1e-9:
+            cap.since_feedback = 0.0
+            cap.measured_voltage = round((cap.voltage() + rng.gauss(0.0, CAP_VOLTAGE_NOISE)) * 1000.0) / 1000.0
+        t += dt
+        if t > 2.0:
+            truth = empty_time - t
+            worst = max(worst, abs(manager.boost_time_left - truth) / truth)
+    return worst
+
+
+def test_game(report, seed):
+    for power_limit in (45.0, 60.0, 80.0):
+        old = run_game(PreviousManager(), seed, power_limit)
+        new = run_game(SupercapManager(), seed, power_limit)
+        print("     %gW: sprint power %.0f -> %.0f W, cap at sprint start %.0f -> %.0f J, at battle start %.0f -> %.0f J, "
+              "buffer out %.2f -> %.2f s"
+              % (power_limit, old["sprint_power"], new["sprint_power"], old["sprint_start_energy"], new["sprint_start_energy"],
+                 old["battle_start_energy"], new["battle_start_energy"], old["overrun_s"], new["overrun_s"]))
+        report.check("%gW: more power while sprinting" % power_limit,
+                     new["sprint_power"] > 1.1 * old["sprint_power"] and new["sprint_start_energy"] > old["sprint_start_energy"])
+        report.check("%gW: referee buffer never runs out" % power_limit, new["overrun_s"] == 0.0)
+        report.check("%gW: full cap into the battle" % power_limit, new["battle_start_energy"] > 0.9 * SUPCAP_ENERGY_MAX)
+
+
+def test_end_game(report, seed):
+    # cruising above a low limit without sprints holds the cap at the reserve, which is only worth something while the
+    # game goes on
+    kept = run_game(SupercapManager(), seed, power_limit=45.0, battle_s=90.0, sprint_period_s=None, end_game_clock=False)
+    new = run_game(SupercapManager(), seed, power_limit=45.0, battle_s=90.0, sprint_period_s=None)
+    report.check("reserve spent before the game ends", new["end_energy"] < 0.5 * kept["end_energy"],
+                 "left at the end %.0f J, %.0f J with the remaining time held above the window" % (new["end_energy"], kept["end_energy"]))
+
+
+def test_boost_prediction(report, seed):
+    errors = [boost_prediction_error(drain, seed) for drain in (30.0, 80.0, 150.0)]
+    # sprint drains within 10%, a slow drain is dominated by the voltage noise
+    report.check("boost time prediction under constant drain", errors[0] < 0.25 and max(errors[1:]) < 0.1,
+                 "worst error %s" % "/".join("%.1f%%" % (100.0 * e) for e in errors))
+
+
+def test_command_frame(report):
+    manager = SupercapManager()
+    manager.data.input_power_limit = 60.0 + (60.0 - CHASSIS_POWER_BUFFER_RESERVE) / CHASSIS_POWER_BUFFER_SPEND_TIME_S
+    manager.data.charge_power = 87.654
+    manager.data.mode = MODE_RECHARGE
+    data = manager.command()
+    input_limit, charge, enable, mode, reserve = struct.unpack("<HHBBH", data)
+    report.check("command frame layout", len(data) == 8 and input_limit == 26000 and charge == 8765 and enable == 1
+                 and mode == MODE_RECHARGE and reserve == 0, data.hex())
+    # largest input limit: 120W limit and a full buffer, must not wrap
+    biggest = 120.0 + (REFEREE_BUFFER_MAX - CHASSIS_POWER_BUFFER_RESERVE) / CHASSIS_POWER_BUFFER_SPEND_TIME_S
+    report.check("command frame range", biggest * 100.0 < 65536.0 and SUPCAP_MAX_CHARGE_POWER * 100.0 < 65536.0)
+
+
+def test_model_fit_gate(report):
+    # the referee meter sees the chassis power only while the cap is left alone, the power model skips the reports
+    # of a budget drawing on the cap
+    game = Game(0.0, 600.0)
+    game.update(1.0)
+    used = {}
+    for name, energy, sprint in (("recharge", 0.1, False), ("normal", 0.9, False), ("boost", 0.9, True)):
+        manager = SupercapManager()
+        manager.referee(Referee(60.0, game))
+        voltage = math.sqrt(2.0 * (energy * SUPCAP_ENERGY_MAX) / SUPCAP_CAPACITANCE + SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD ** 2)
+        manager.cap_feedback(voltage)
+        manager.update(sprint, 40.0)
+        used[name] = (manager.data.mode, manager.power.fSupcapUsed)
+    report.check("power model fitted while recharging, not while discharging",
+                 used["recharge"] == (MODE_RECHARGE, 0) and used["normal"] == (MODE_NORMAL, 1) and used["boost"] == (MODE_BOOST, 1),
+                 ", ".join("%s %d/%d" % (name, mode, flag) for name, (mode, flag) in used.items()))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the supercap energy manager over a game")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    report = Report()
+    test_command_frame(report)
+    test_model_fit_gate(report)
+    test_boost_prediction(report, args.seed)
+    test_game(report, args.seed)
+    test_end_game(report, args.seed)
+    if not report.ok:
+        raise SystemExit("supercap simulation failed")
+
+
+if __name__ == "__main__":
+    main()
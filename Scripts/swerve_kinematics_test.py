@@ -0,0 +1,162 @@
+# Host test of the swerve forward kinematics (application/swerve_kinematics.c) with synthetic module states.
+# Module states come from the inverse kinematics of swerve_chassis_vector_to_wheel_vector (CHASSIS_WZ_SET_SCALE left
+# out, it is a command fudge and not geometry), with random twists, leg radii and hip speeds.
+# Checks:
+#   - twist recovered exactly, residual zero, for forward and reversed (angle + PI, negative speed) modules
+#   - hip motion is removed: leaving it in would bias the twist
+#   - drive speed noise doesn't flag slip
+#   - one slipping module is flagged and left out, the twist stays close to the truth
+# swerve_kinematics.c of a swerve build is built by firmware_host.py. Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report, floats
+
+FIRMWARE = Firmware(["application/swerve_kinematics.c", "components/algorithm/AHRS_middleware.c"],
+                    headers=["swerve_kinematics.h", "chassis_task.h"],
+                    structs={"swerve_kinematics_t": {"vx": ctypes.c_float, "vy": ctypes.c_float, "wz": ctypes.c_float,
+                                                     "module_residual": ctypes.c_float, "excluded_module": ctypes.c_uint8,
+                                                     "slip_mask": ctypes.c_uint8}},
+                    constants=["CHASSIS_LEG_TO_HORIZONTAL_ANGLE", "CHASSIS_HALF_A_LENGTH", "CHASSIS_L1_LENGTH",
+                               "CHASSIS_THETA_LOWER_LIMIT", "CHASSIS_THETA_UPPER_LIMIT", "SWERVE_SLIP_RESIDUAL_SPEED",
+                               "SWERVE_SLIP_RESIDUAL_RATIO", "SWERVE_NO_MODULE_EXCLUDED", "STEER_MOTOR_UPSIDE_DOWN_MOUNTING"],
+                    config={"ROBOT_TYPE": "INFANTRY_2023_SWERVE"})
+
+GAMMA = FIRMWARE.CHASSIS_LEG_TO_HORIZONTAL_ANGLE
+R_MIN = FIRMWARE.CHASSIS_HALF_A_LENGTH + FIRMWARE.CHASSIS_L1_LENGTH * math.cos(FIRMWARE.CHASSIS_THETA_UPPER_LIMIT)
+R_MAX = FIRMWARE.CHASSIS_HALF_A_LENGTH + FIRMWARE.CHASSIS_L1_LENGTH * math.cos(FIRMWARE.CHASSIS_THETA_LOWER_LIMIT)
+SLIP_RESIDUAL_SPEED = FIRMWARE.SWERVE_SLIP_RESIDUAL_SPEED
+SLIP_RESIDUAL_RATIO = FIRMWARE.SWERVE_SLIP_RESIDUAL_RATIO
+NO_MODULE_EXCLUDED = int(FIRMWARE.SWERVE_NO_MODULE_EXCLUDED)
+# fp32 rounding of the least squares, m/s
+FLOAT_BOUND = 2e-5
+
+WZ_SIGN = ((1.0, -1.0), (-1.0, -1.0), (-1.0, 1.0), (1.0, 1.0))
+HIP_SIGN = ((1.0, 1.0), (1.0, -1.0), (-1.0, -1.0), (-1.0, 1.0))
+
+
+def rad_format(angle):
+    return (angle + math.pi) % (2.0 * math.pi) - math.pi
+
+
+def inverse_kinematics(vx, vy, wz, radii, radii_dot):
+    # module velocities as swerve_chassis_vector_to_wheel_vector builds them, vy positive left on input
+    s, c = math.sin(GAMMA), math.cos(GAMMA)
+    modules = []
+    for i in range(4):
+        ux = vx + wz * radii[i] * WZ_SIGN[i][0] * s + radii_dot[i] * HIP_SIGN[i][0] * s
+        uy = -vy + wz * radii[i] * WZ_SIGN[i][1] * c + radii_dot[i] * HIP_SIGN[i][1] * c
+        modules.append((ux, -uy if FIRMWARE.STEER_MOTOR_UPSIDE_DOWN_MOUNTING else uy))
+    return modules
+
+
+def module_states(modules, rng):
+    # drive speed and steering angle, randomly on the reversed solution
+    speeds, angles = [], []
+    for ux, uy in modules:
+        speed, angle = math.hypot(ux, uy), math.atan2(uy, ux)
+        if rng.random() < 0.5:
+            speed, angle = -speed, rad_format(angle + math.pi)
+        speeds.append(speed)
+        angles.append(angle)
+    return speeds, angles
+
+
+def forward_kinematics(speeds, angles, radii, radii_dot):
+    """swerve_forward_kinematics(), returns (vx, vy, wz), module residuals, excluded module, slip mask"""
+    kinematics = FIRMWARE.new("swerve_kinematics_t")
+    FIRMWARE.swerve_forward_kinematics(floats(speeds), floats(angles), floats(radii), floats(radii_dot), kinematics)
+    return ((kinematics.vx, kinematics.vy, kinematics.wz), kinematics.module_residual, kinematics.excluded_module,
+            kinematics.slip_mask)
+
+
+def random_case(rng):
+    twist = (rng.uniform(-2.5, 2.5), rng.uniform(-2.0, 2.0), rng.uniform(-8.0, 8.0))
+    radii = [rng.uniform(R_MIN, R_MAX) for _ in range(4)]
+    radii_dot = [rng.uniform(-0.16, 0.16) if rng.random() < 0.5 else 0.0 for _ in range(4)]
+    return twist, radii, radii_dot
+
+
+def twist_error(a, b, radius=0.3):
+    # wz error as speed at a module
+    return math.hypot(a[0] - b[0], a[1] - b[1]) + abs(a[2] - b[2]) * radius
+
+
+def test_exact(report, rng):
+    worst_err = worst_res = 0.0
+    for _ in range(2000):
+        twist, radii, radii_dot = random_case(rng)
+        speeds, angles = module_states(inverse_kinematics(*twist, radii, radii_dot), rng)
+        est, residuals, excluded, slip_mask = forward_kinematics(speeds, angles, radii, radii_dot)
+        worst_err = max(worst_err, twist_error(est, twist))
+        worst_res = max(worst_res, max(residuals))
+        if slip_mask or excluded != NO_MODULE_EXCLUDED:
+            worst_res = float("inf")
+    report.check("exact twist from consistent modules", worst_err < FLOAT_BOUND and worst_res < FLOAT_BOUND,
+                 "max twist error %.1e m/s, max residual %.1e m/s" % (worst_err, worst_res))
+
+
+def test_hip(report, rng):
+    err_with = err_without = 0.0
+    for _ in range(500):
+        twist, radii, _ = random_case(rng)
+        radii_dot = [rng.choice((-0.15, 0.15)) for _ in range(4)]
+        speeds, angles = module_states(inverse_kinematics(*twist, radii, radii_dot), rng)
+        err_with = max(err_with, twist_error(forward_kinematics(speeds, angles, radii, radii_dot)[0], twist))
+        err_without = max(err_without, twist_error(forward_kinematics(speeds, angles, radii, [0.0] * 4)[0], twist))
+    report.check("hip motion removed", err_with < FLOAT_BOUND and err_without > 0.05,
+                 "twist error %.1e m/s with, %.3f m/s without" % (err_with, err_without))
+
+
+def test_noise(report, rng):
+    false_slips = 0
+    for _ in range(2000):
+        twist, radii, radii_dot = random_case(rng)
+        speeds, angles = module_states(inverse_kinematics(*twist, radii, radii_dot), rng)
+        # drive speed noise and steering model error
+        speeds = [sp + rng.gauss(0.0, 0.02) for sp in speeds]
+        angles = [a + rng.gauss(0.0, 0.01) for a in angles]
+        if forward_kinematics(speeds, angles, radii, radii_dot)[3]:
+            false_slips += 1
+    report.check("no slip flag from noise", false_slips == 0, "%d of 2000 flagged" % false_slips)
+
+
+def test_slip(report, rng):
+    missed = wrong = 0
+    worst_err = 0.0
+    for _ in range(2000):
+        twist, radii, radii_dot = random_case(rng)
+        speeds, angles = module_states(inverse_kinematics(*twist, radii, radii_dot), rng)
+        k = rng.randrange(4)
+        # module k spinning ahead of the ground, by more than the slip threshold at its new speed
+        slip = (SLIP_RESIDUAL_SPEED + SLIP_RESIDUAL_RATIO * abs(speeds[k]) + rng.uniform(0.1, 1.0)) / (1.0 - SLIP_RESIDUAL_RATIO)
+        speeds[k] += math.copysign(slip, speeds[k])
+        est, _, excluded, slip_mask = forward_kinematics(speeds, angles, radii, radii_dot)
+        if not slip_mask & (1 << k):
+            missed += 1
+        if excluded != k:
+            wrong += 1
+        worst_err = max(worst_err, twist_error(est, twist))
+    report.check("slipping module flagged and left out", missed == 0 and wrong == 0 and worst_err < FLOAT_BOUND,
+                 "%d missed, %d wrong module, twist error %.1e m/s" % (missed, wrong, worst_err))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check swerve forward kinematics")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    report = Report()
+    test_exact(report, rng)
+    test_hip(report, rng)
+    test_noise(report, rng)
+    test_slip(report, rng)
+    if not report.ok:
+        raise SystemExit("swerve forward kinematics check failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,181 @@
+# Host test of the swerve module optimizer (application/swerve_module_optimizer.c) and of fast_atan2f
+# (components/algorithm/user_lib.c).
+# Checks:
+#   - fast_atan2f error over the full circle
+#   - wrap-around: steering takes the short way through +-PI
+#   - a velocity more than 90 degrees off the steering angle reverses the drive wheel instead of steering
+#   - a velocity oscillating around 90 degrees off the wheel doesn't flip the drive direction every period
+#   - hip motion: the leg extending then retracting reverses the drive wheel, the module doesn't steer half a turn
+#   - random driving against the previous solver (flip decided from the last target, no cos scaling): less steering
+#     travel and less error between delivered and commanded module velocity
+# swerve_module_optimizer.c and fast_atan2f of a swerve build are built by firmware_host.py. Exit code is non-zero on
+# failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(["application/swerve_module_optimizer.c", "components/algorithm/AHRS_middleware.c"],
+                    headers=["swerve_module_optimizer.h", "user_lib.h", "chassis_task.h"],
+                    structs={"swerve_module_t": {"angle_set": ctypes.c_float}},
+                    constants=["CHASSIS_CONTROL_TIME_S", "STEER_MOTOR_MAX_RATE", "STEER_TURN_HIP_RADIUS_SPEED_DEADZONE"],
+                    config={"ROBOT_TYPE": "INFANTRY_2023_SWERVE"})
+DT = FIRMWARE.CHASSIS_CONTROL_TIME_S
+STEER_MOTOR_MAX_RATE = FIRMWARE.STEER_MOTOR_MAX_RATE
+
+
+def rad_format(angle):
+    return (angle + math.pi) % (2.0 * math.pi) - math.pi
+
+
+class SteerModel:
+    # steering 6020 under its position loop, slews toward target
+    def __init__(self, angle=0.0):
+        self.angle = angle
+
+    def step(self, target):
+        max_step = STEER_MOTOR_MAX_RATE * DT
+        self.angle = rad_format(self.angle + max(-max_step, min(max_step, rad_format(target - self.angle))))
+
+
+class SwerveModule:
+    """a swerve_module_t"""
+
+    def __init__(self, angle=0.0):
+        self.module = FIRMWARE.new("swerve_module_t")
+        FIRMWARE.swerve_module_init(self.module, DT, angle)
+
+    def optimize(self, vx, vy, hold):
+        wheel_speed = ctypes.c_float()
+        angle = FIRMWARE.swerve_module_optimize(self.module, vx, vy, hold, ctypes.byref(wheel_speed))
+        return angle, wheel_speed.value
+
+
+class PreviousSolver:
+    # swerve_chassis_vector_to_wheel_vector before the optimizer
+    def __init__(self):
+        self.last_target = 0.0
+        self.reversed = False
+
+    def optimize(self, vx, vy, hold):
+        speed = math.sqrt(vx * vx + vy * vy)
+        if not hold:
+            angle = math.atan2(vy, vx)
+            self.reversed = abs(rad_format(angle - self.last_target)) > math.pi / 2
+            if self.reversed:
+                angle = rad_format(angle + math.pi)
+            self.last_target = angle
+        return self.last_target, (-speed if self.reversed else speed)
+
+
+def run(solver, velocities, holds=None, steer=None):
+    # returns steering travel, rms delivered velocity error, angles, speeds
+    steer = steer or SteerModel()
+    travel = 0.0
+    err = 0.0
+    angles, speeds = [], []
+    for n, (vx, vy) in enumerate(velocities):
+        hold = holds[n] if holds else False
+        target, speed = solver.optimize(vx, vy, hold)
+        last = steer.angle
+        steer.step(target)
+        travel += abs(rad_format(steer.angle - last))
+        # delivered module velocity: drive speed along the actual wheel heading
+        err += (speed * math.cos(steer.angle) - vx) ** 2 + (speed * math.sin(steer.angle) - vy) ** 2
+        angles.append(target)
+        speeds.append(speed)
+    return travel, math.sqrt(err / len(velocities)), angles, speeds
+
+
+def test_atan2(report):
+    worst = 0.0
+    for n in range(3600):
+        angle = -math.pi + 2.0 * math.pi * (n + 0.5) / 3600
+        for radius in (1e-3, 1.0, 250.0):
+            worst = max(worst, abs(rad_format(FIRMWARE.fast_atan2f(radius * math.sin(angle), radius * math.cos(angle)) - angle)))
+    report.check("fast_atan2f", worst < 2e-5, "max error %.2e rad" % worst)
+
+
+def test_wrap_around(report):
+    module = SwerveModule(math.radians(170.0))
+    steer = SteerModel(math.radians(170.0))
+    velocity = (math.cos(math.radians(-170.0)), math.sin(math.radians(-170.0)))
+    travel, _, angles, speeds = run(module, [velocity] * 100, steer=steer)
+    passed = (abs(rad_format(angles[-1] - math.radians(-170.0))) < 1e-4 and speeds[-1] > 0.99
+              and abs(travel - math.radians(20.0)) < 1e-3 and all(abs(rad_format(a)) > math.radians(160.0) for a in angles))
+    report.check("wrap-around through +-PI", passed, "steered %.1f deg" % math.degrees(travel))
+
+
+def test_reverse(report):
+    module = SwerveModule(0.0)
+    velocity = (math.cos(math.radians(135.0)), math.sin(math.radians(135.0)))
+    travel, _, angles, speeds = run(module, [velocity] * 100)
+    passed = abs(rad_format(angles[-1] - math.radians(-45.0))) < 1e-4 and speeds[-1] < -0.99 and travel < math.radians(45.1)
+    report.check("reverse instead of steering past 90 deg", passed, "steered %.1f deg" % math.degrees(travel))
+
+
+def test_hysteresis(report):
+    module = SwerveModule(0.0)
+    velocities = []
+    for n in range(1000):
+        angle = math.radians(90.0 + (1.0 if n % 2 else -1.0))
+        velocities.append((math.cos(angle), math.sin(angle)))
+    _, _, _, speeds = run(module, velocities)
+    flips = sum(1 for a, b in zip(speeds, speeds[1:]) if a * b < 0.0)
+    report.check("no drive direction chatter near 90 deg", flips <= 1, "%d flips" % flips)
+
+
+def test_hip_motion(report):
+    # chassis at rest, leg at 35 degrees extending and retracting: module velocity is radial, sign follows hip
+    leg_angle = math.radians(35.0)
+    velocities, holds = [], []
+    for n in range(3000):
+        radial = 0.15 * math.sin(2.0 * math.pi * 1.5 * n * DT)
+        velocities.append((radial * math.cos(leg_angle), radial * math.sin(leg_angle)))
+        holds.append(abs(radial) < FIRMWARE.STEER_TURN_HIP_RADIUS_SPEED_DEADZONE)
+    travel, _, _, _ = run(SwerveModule(0.0), velocities, holds)
+    # only the first alignment to the leg
+    report.check("hip extend/retract reverses drive, no half turn", travel < leg_angle + 1e-3, "steered %.1f deg" % math.degrees(travel))
+
+
+def random_drive(seed):
+    # one module 0.2 m from center at 45 degrees: chassis velocity plus spin
+    rng = random.Random(seed)
+    velocities = []
+    vx = vy = wz = 0.0
+    for n in range(20000):
+        if rng.random() < 0.004:
+            vx, vy = rng.uniform(-2.0, 2.0), rng.uniform(-1.5, 1.5)
+            wz = rng.choice((0.0, 0.0, rng.uniform(-6.0, 6.0)))
+        velocities.append((vx - wz * 0.2 * math.sin(math.pi / 4), vy + wz * 0.2 * math.cos(math.pi / 4)))
+    return velocities
+
+
+def test_random_drive(report, seed):
+    velocities = random_drive(seed)
+    travel_new, err_new, _, _ = run(SwerveModule(0.0), velocities)
+    travel_old, err_old, _, _ = run(PreviousSolver(), velocities)
+    report.check("random drive, seed %d" % seed, travel_new <= travel_old * 1.001 and err_new < err_old,
+                 "steering travel %.1f vs %.1f rad, velocity error rms %.3f vs %.3f m/s" % (travel_new, travel_old, err_new, err_old))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the swerve module optimizer")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    report = Report()
+    test_atan2(report)
+    test_wrap_around(report)
+    test_reverse(report)
+    test_hysteresis(report)
+    test_hip_motion(report)
+    test_random_drive(report, args.seed)
+    if not report.ok:
+        raise SystemExit("swerve module optimizer check failed")
+
+
+if __name__ == "__main__":
+    main()
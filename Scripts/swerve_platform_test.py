@@ -0,0 +1,163 @@
+# Host test of the swerve hip platform posture mapping (swerve_convert_from_rpy_to_alpha / swerve_convert_from_alpha_to_rpy,
+# the rotation cache and the alpha limit of swerve_platform_rc_mapping in application/chassis_task.c) against the
+# analytic functions.
+# Checks:
+#   - the roll/pitch <-> alpha1/alpha2 rotation by PI/4 plus the yaw motor angle matches the analytic rotation to float
+#     precision, both ways and round trip. The host arm_sin_f32 / arm_cos_f32 are libm, on the board the CMSIS ones
+#     interpolate a 512 entry table and add their own error of about 1.9e-5 per unit of roll and pitch
+#   - the rotation cache never hands out a stale rotation: a still gimbal, the chassis spinning under it, and the
+#     forward and inverse conversion of one tick at the same angle
+#   - the branch-free alpha limit equals the piecewise triangular workspace limit
+# chassis_task.c of a swerve build is built by firmware_host.py. Exit code is non-zero on failure.
+
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(["application/chassis_task.c", "components/algorithm/AHRS_middleware.c"],
+                    headers=["chassis_task.h", "gimbal_task.h"],
+                    structs={"chassis_move_t": {"chassis_RC": ctypes.c_void_p, "chassis_yaw_motor": ctypes.c_void_p,
+                                                "chassis_platform": ctypes.c_uint8},
+                             "chassis_platform_t": {"target_roll": ctypes.c_float, "target_pitch": ctypes.c_float,
+                                                    "target_height": ctypes.c_float, "alpha_upper_limit": ctypes.c_float},
+                             "gimbal_motor_t": {"relative_angle": ctypes.c_float}},
+                    constants=["CHASSIS_H_LOWER_LIMIT", "CHASSIS_H_UPPER_LIMIT", "CHASSIS_H_WORKSPACE_PEAK",
+                               "CHASSIS_ALPHA_WORKSPACE_PEAK", "CHASSIS_H_WORKSPACE_SLOPE1", "CHASSIS_H_WORKSPACE_SLOPE2",
+                               "CHASSIS_ROLL_UPPER_LIMIT", "CHASSIS_PITCH_UPPER_LIMIT"],
+                    config={"ROBOT_TYPE": "INFANTRY_2023_SWERVE"},
+                    prototypes={"swerve_convert_from_rpy_to_alpha": (None, [ctypes.c_float, ctypes.c_float, ctypes.c_void_p,
+                                                                            ctypes.c_void_p, ctypes.c_float]),
+                                "swerve_convert_from_alpha_to_rpy": (None, [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_float,
+                                                                            ctypes.c_float, ctypes.c_float]),
+                                "swerve_platform_rc_mapping": (None, [])})
+
+H_LOWER = FIRMWARE.CHASSIS_H_LOWER_LIMIT
+H_UPPER = FIRMWARE.CHASSIS_H_UPPER_LIMIT
+H_PEAK = FIRMWARE.CHASSIS_H_WORKSPACE_PEAK
+ALPHA_PEAK = FIRMWARE.CHASSIS_ALPHA_WORKSPACE_PEAK
+SLOPE1 = FIRMWARE.CHASSIS_H_WORKSPACE_SLOPE1
+SLOPE2 = FIRMWARE.CHASSIS_H_WORKSPACE_SLOPE2
+ROLL_LIMIT = FIRMWARE.CHASSIS_ROLL_UPPER_LIMIT
+PITCH_LIMIT = FIRMWARE.CHASSIS_PITCH_UPPER_LIMIT
+ECD_RANGE = 8192
+# float rounding of the rotation, per unit of roll and pitch
+FLOAT_BOUND = 1e-6
+
+
+def ecd_to_yaw(ecd):
+    return ecd * 2.0 * math.pi / ECD_RANGE - math.pi
+
+
+def rpy_to_alpha(roll, pitch, yaw):
+    alpha1, alpha2 = ctypes.c_float(), ctypes.c_float()
+    FIRMWARE.swerve_convert_from_rpy_to_alpha(roll, pitch, ctypes.byref(alpha1), ctypes.byref(alpha2), yaw)
+    return alpha1.value, alpha2.value
+
+
+def alpha_to_rpy(alpha1, alpha2, yaw):
+    roll, pitch = ctypes.c_float(), ctypes.c_float()
+    FIRMWARE.swerve_convert_from_alpha_to_rpy(ctypes.byref(roll), ctypes.byref(pitch), alpha1, alpha2, yaw)
+    return roll.value, pitch.value
+
+
+def analytic_rpy_to_alpha(roll, pitch, yaw):
+    c, s = math.cos(math.pi / 4.0 + yaw), math.sin(math.pi / 4.0 + yaw)
+    return s * roll + c * pitch, c * roll - s * pitch
+
+
+def analytic_alpha_to_rpy(alpha1, alpha2, yaw):
+    c, s = math.cos(math.pi / 4.0 + yaw), math.sin(math.pi / 4.0 + yaw)
+    return c * alpha2 + s * alpha1, -s * alpha2 + c * alpha1
+
+
+def f32(value):
+    return ctypes.c_float(value).value
+
+
+def test_rotation(report, rng):
+    worst_fwd = worst_inv = worst_trip = 0.0
+    for _ in range(20000):
+        yaw = f32(ecd_to_yaw(rng.randrange(ECD_RANGE)))
+        roll, pitch = f32(rng.uniform(-ROLL_LIMIT, ROLL_LIMIT)), f32(rng.uniform(-PITCH_LIMIT, PITCH_LIMIT))
+        scale = abs(roll) + abs(pitch)
+        alpha = rpy_to_alpha(roll, pitch, yaw)
+        alpha_ref = analytic_rpy_to_alpha(roll, pitch, yaw)
+        worst_fwd = max(worst_fwd, max(abs(a - r) for a, r in zip(alpha, alpha_ref)) / scale)
+        rpy = alpha_to_rpy(f32(alpha_ref[0]), f32(alpha_ref[1]), yaw)
+        rpy_ref = analytic_alpha_to_rpy(f32(alpha_ref[0]), f32(alpha_ref[1]), yaw)
+        worst_inv = max(worst_inv, max(abs(a - r) for a, r in zip(rpy, rpy_ref)) / scale)
+        rpy = alpha_to_rpy(alpha[0], alpha[1], yaw)
+        worst_trip = max(worst_trip, max(abs(rpy[0] - roll), abs(rpy[1] - pitch)) / scale)
+    report.check("rpy -> alpha matches the analytic rotation", worst_fwd <= FLOAT_BOUND, "max error %.1e rad per rad" % worst_fwd)
+    report.check("alpha -> rpy matches the analytic rotation", worst_inv <= FLOAT_BOUND, "max error %.1e rad per rad" % worst_inv)
+    report.check("round trip within twice the bound", worst_trip <= 2.0 * FLOAT_BOUND, "max error %.1e rad per rad" % worst_trip)
+
+
+def test_rotation_cache(report):
+    # 1 kHz ticks: gimbal still for a second, then the chassis spinning under it at about 18 rad/s, then the encoder
+    # dithering between two counts; forward and back at the same angle every tick as in swerve_platform_rc_mapping.
+    # A one count step moves alpha by 7.7e-4 rad per rad of tilt, a stale rotation shows far above the float bound.
+    roll, pitch = f32(0.5), f32(-0.3)
+    yaw_ecd = 1234
+    worst = 0.0
+    for n in range(3000):
+        if 1000 <= n < 2000:
+            yaw_ecd = (yaw_ecd + 3) % ECD_RANGE
+        elif n >= 2000:
+            yaw_ecd += 1 if n % 2 else -1
+        yaw = f32(ecd_to_yaw(yaw_ecd))
+        alpha = rpy_to_alpha(roll, pitch, yaw)
+        alpha_ref = analytic_rpy_to_alpha(roll, pitch, yaw)
+        rpy = alpha_to_rpy(alpha[0], alpha[1], yaw)
+        worst = max(worst, max(abs(a - r) for a, r in zip(alpha, alpha_ref)), abs(rpy[0] - roll), abs(rpy[1] - pitch))
+    report.check("rotation cache never stale", worst <= 2.0 * FLOAT_BOUND * (abs(roll) + abs(pitch)), "max error %.1e rad" % worst)
+
+
+def alpha_limit_piecewise(height):
+    # swerve_platform_rc_mapping before the branch-free limit
+    if height >= H_PEAK:
+        return (height - H_UPPER) / SLOPE2
+    return (height - H_LOWER) / SLOPE1
+
+
+def alpha_limit(height):
+    """alpha_upper_limit of swerve_platform_rc_mapping at a target height, no key pressed"""
+    chassis = FIRMWARE.global_struct("chassis_move_t", "chassis_move")
+    platform = FIRMWARE.view("chassis_platform_t", chassis.field_address("chassis_platform"))
+    platform.target_height = height
+    platform.target_roll = 0.0
+    platform.target_pitch = 0.0
+    FIRMWARE.swerve_platform_rc_mapping()
+    return platform.alpha_upper_limit
+
+
+def test_alpha_limit(report):
+    # no key pressed, gimbal straight ahead
+    remote = ctypes.create_string_buffer(256)
+    yaw_motor = FIRMWARE.new("gimbal_motor_t", relative_angle=0.0)
+    chassis = FIRMWARE.global_struct("chassis_move_t", "chassis_move")
+    chassis.chassis_RC = ctypes.addressof(remote)
+    chassis.chassis_yaw_motor = yaw_motor.address
+    worst = 0.0
+    for n in range(10001):
+        height = H_LOWER + (H_UPPER - H_LOWER) * n / 10000
+        worst = max(worst, abs(alpha_limit(height) - alpha_limit_piecewise(height)))
+    peak_error = abs(alpha_limit(H_PEAK) - ALPHA_PEAK)
+    report.check("alpha limit equals piecewise workspace", worst < 1e-5 and peak_error < 1e-5,
+                 "max difference %.1e rad, %.1e rad off the peak" % (worst, peak_error))
+
+
+def main():
+    report = Report()
+    rng = random.Random(1)
+    test_rotation(report, rng)
+    test_rotation_cache(report)
+    test_alpha_limit(report)
+    if not report.ok:
+        raise SystemExit("swerve platform mapping check failed")
+
+
+if __name__ == "__main__":
+    main()
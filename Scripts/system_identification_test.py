@@ -0,0 +1,215 @@
+# Host test of the motor system identification (components/algorithm/system_identification.c) and of the hook the
+# gimbal task calls with it, sysid_override_cmd() (application/calibrate_task.c), built by firmware_host.py with
+# SYSID_ENABLE on. Synthetic records of plants with known parameters, at the gimbal loop period:
+#   - first order J * dy/dt + B * y = u(t - delay), zero-order hold, speed noise: J, B within 5%, delay exact, for the
+#     chirp and the PRBS excitation
+#   - second order K * wn^2 / (s^2 + 2 * zeta * wn * s + wn^2): wn, zeta within 10%, dc gain within 5%
+#   - excitation: chirp within its amplitude and as long as asked, PRBS +-amplitude held prbs_hold samples
+# Hook checks, the pitch motor run through sysid_start / sysid_override_cmd and fed back as CAN speed in rpm:
+#   - the command is replaced for the whole record, then zeroed, other motors untouched
+#   - the record is taken in the controller's direction, PITCH_TURN included, so the fit finds a positive gain
+#   - a lost remote aborts and gives control back
+# Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report, floats
+
+FIRMWARE = Firmware(
+    ["components/algorithm/system_identification.c", "components/algorithm/AHRS_middleware.c", "application/calibrate_task.c",
+     "application/CAN_receive.c", "application/detect_task.c"],
+    headers=["system_identification.h", "calibrate_task.h", "CAN_receive.h", "detect_task.h", "gimbal_task.h"],
+    structs={
+        "sysid_excitation_t": {"length": ctypes.c_uint32},
+        "sysid_first_order_t": {"inertia": ctypes.c_float, "damping": ctypes.c_float, "delay": ctypes.c_uint8,
+                                "fit_residual": ctypes.c_float},
+        "sysid_second_order_t": {"natural_freq": ctypes.c_float, "damping_ratio": ctypes.c_float, "dc_gain": ctypes.c_float,
+                                 "delay": ctypes.c_uint8, "fit_residual": ctypes.c_float},
+        "sysid_t": {"state": ctypes.c_int, "dt": ctypes.c_float, "record_len": ctypes.c_uint16, "u": ctypes.c_float,
+                    "y": ctypes.c_float},
+        "motor_measure_t": {"speed_rpm": ctypes.c_int16},
+        "error_t": {"error_exist": ctypes.c_uint8},
+    },
+    constants=["GIMBAL_CONTROL_TIME_S", "SYSID_RECORD_LENGTH", "SYSID_MAX_DELAY", "SYSID_CHIRP_F_START", "SYSID_CHIRP_F_END",
+               "SYSID_PRBS_HOLD", "SYSID_PITCH_AMPLITUDE", "SYSID_EXCITATION_CHIRP", "SYSID_EXCITATION_PRBS",
+               "SYSID_TARGET_YAW", "SYSID_TARGET_PITCH", "SYSID_RUNNING", "SYSID_FITTING", "SYSID_FAILED", "PITCH_TURN",
+               "MOTOR_INDEX_PITCH", "DBUS_TOE"],
+    config={"SYSID_ENABLE": 1})
+SYSID = FIRMWARE.global_struct("sysid_t", "sysid")
+PITCH_MOTOR = FIRMWARE.global_struct("motor_measure_t", "motor_chassis", int(FIRMWARE.MOTOR_INDEX_PITCH))
+DBUS_ERROR = FIRMWARE.global_struct("error_t", "error_list", int(FIRMWARE.DBUS_TOE))
+
+DT = FIRMWARE.GIMBAL_CONTROL_TIME_S
+RECORD_LENGTH = int(FIRMWARE.SYSID_RECORD_LENGTH)
+MAX_DELAY = int(FIRMWARE.SYSID_MAX_DELAY)
+AMPLITUDE = FIRMWARE.SYSID_PITCH_AMPLITUDE
+CHIRP, PRBS = int(FIRMWARE.SYSID_EXCITATION_CHIRP), int(FIRMWARE.SYSID_EXCITATION_PRBS)
+RPM_PER_RADS = 60.0 / (2.0 * math.pi)
+# speed noise, fraction of the speed amplitude
+NOISE = 0.005
+
+
+def excitation(kind, amplitude=AMPLITUDE, length=RECORD_LENGTH):
+    exc = FIRMWARE.new("sysid_excitation_t")
+    if kind == PRBS:
+        FIRMWARE.sysid_prbs_init(exc, amplitude, int(FIRMWARE.SYSID_PRBS_HOLD), length * DT, DT)
+    else:
+        FIRMWARE.sysid_chirp_init(exc, amplitude, FIRMWARE.SYSID_CHIRP_F_START, FIRMWARE.SYSID_CHIRP_F_END, length * DT, DT)
+    out = ctypes.c_float()
+    samples = []
+    while FIRMWARE.sysid_excitation_calc(exc, ctypes.byref(out)):
+        samples.append(out.value)
+    return samples
+
+
+class FirstOrder:
+    # J * dy/dt + B * y = u(t - delay * dt), exact under zero-order hold
+    def __init__(self, inertia, damping, delay):
+        self.a = math.exp(-damping / inertia * DT)
+        self.b = (1.0 - self.a) / damping
+        self.inputs = [0.0] * (delay + 1)
+        self.y = 0.0
+
+    def step(self, u):
+        """speed at the beginning of the cycle, then u applied during it"""
+        y = self.y
+        self.inputs = [u] + self.inputs[:-1]
+        self.y = self.a * self.y + self.b * self.inputs[-1]
+        return y
+
+
+class SecondOrder:
+    # K * wn^2 / (s^2 + 2 * zeta * wn * s + wn^2), integrated in fine steps over the zero-order hold
+    SUBSTEPS = 200
+
+    def __init__(self, natural_freq, damping_ratio, gain):
+        self.wn, self.zeta, self.gain = natural_freq, damping_ratio, gain
+        self.y = 0.0
+        self.dy = 0.0
+
+    def step(self, u):
+        y = self.y
+        h = DT / self.SUBSTEPS
+        for _ in range(self.SUBSTEPS):
+            ddy = self.wn * self.wn * (self.gain * u - self.y) - 2.0 * self.zeta * self.wn * self.dy
+            self.dy += ddy * h
+            self.y += self.dy * h
+        return y
+
+
+def record(plant, u, rng):
+    y = [plant.step(value) for value in u]
+    scale = NOISE * math.sqrt(sum(v * v for v in y) / len(y))
+    return [v + rng.gauss(0.0, scale) for v in y]
+
+
+def relative_error(value, expected):
+    return abs(value - expected) / abs(expected)
+
+
+def test_excitation(report):
+    chirp = excitation(CHIRP)
+    report.check("chirp: length and amplitude", len(chirp) == RECORD_LENGTH and max(abs(v) for v in chirp) <= AMPLITUDE * (1 + 1e-6),
+                 "%d samples, peak %.0f of %.0f" % (len(chirp), max(abs(v) for v in chirp), AMPLITUDE))
+    # the sweep ends near its last frequency: half periods of the sign changes of the last second
+    tail = chirp[-int(1.0 / DT):]
+    crossings = sum(1 for i in range(1, len(tail)) if (tail[i - 1] < 0.0) != (tail[i] < 0.0))
+    expected = 2.0 * (FIRMWARE.SYSID_CHIRP_F_START + (FIRMWARE.SYSID_CHIRP_F_END - FIRMWARE.SYSID_CHIRP_F_START) * (1.0 - 0.5 / (RECORD_LENGTH * DT)))
+    report.check("chirp: sweeps up to its end frequency", relative_error(crossings, expected) < 0.15,
+                 "%d sign changes in the last second, %.0f expected" % (crossings, expected))
+    prbs = excitation(PRBS)
+    hold = int(FIRMWARE.SYSID_PRBS_HOLD)
+    runs_held = all(prbs[i] == prbs[i - i % hold] for i in range(len(prbs)))
+    report.check("prbs: +-amplitude, bits held", len(prbs) == RECORD_LENGTH and set(prbs) == {AMPLITUDE, -AMPLITUDE} and runs_held,
+                 "%d samples" % len(prbs))
+    report.check("prbs: balanced", abs(sum(prbs)) < 0.1 * AMPLITUDE * len(prbs), "mean %.0f" % (sum(prbs) / len(prbs)))
+
+
+def test_first_order(report, seed):
+    rng = random.Random(seed)
+    # (J, B, delay): pitch, yaw with slip ring drag, trigger
+    for inertia, damping, delay in ((7.5, 150.0, 1), (40.0, 400.0, 2), (3.0, 200.0, 0), (20.0, 100.0, 3)):
+        for kind, name in ((CHIRP, "chirp"), (PRBS, "prbs")):
+            u = excitation(kind)
+            y = record(FirstOrder(inertia, damping, delay), u, rng)
+            fit = FIRMWARE.new("sysid_first_order_t")
+            valid = FIRMWARE.sysid_fit_first_order(floats(u), floats(y), len(u), MAX_DELAY, DT, fit)
+            report.check("first order J %.1f B %.0f delay %d, %s" % (inertia, damping, delay, name),
+                         valid and relative_error(fit.inertia, inertia) < 0.05 and relative_error(fit.damping, damping) < 0.05 and fit.delay == delay,
+                         "J %.2f B %.1f delay %d residual %.3f" % (fit.inertia, fit.damping, fit.delay, fit.fit_residual))
+
+
+def test_second_order(report, seed):
+    rng = random.Random(seed)
+    for natural_freq_hz, damping_ratio, gain in ((8.0, 0.3, 0.01), (15.0, 0.6, 0.004), (4.0, 1.5, 0.02)):
+        natural_freq = 2.0 * math.pi * natural_freq_hz
+        u = excitation(CHIRP)
+        y = record(SecondOrder(natural_freq, damping_ratio, gain), u, rng)
+        fit = FIRMWARE.new("sysid_second_order_t")
+        valid = FIRMWARE.sysid_fit_second_order(floats(u), floats(y), len(u), MAX_DELAY, DT, fit)
+        report.check("second order wn %.0fHz zeta %.1f" % (natural_freq_hz, damping_ratio),
+                     valid and relative_error(fit.natural_freq, natural_freq) < 0.1 and relative_error(fit.damping_ratio, damping_ratio) < 0.1
+                     and relative_error(fit.dc_gain, gain) < 0.05,
+                     "wn %.1fHz zeta %.2f dc gain %.4f delay %d residual %.3f"
+                     % (fit.natural_freq / (2.0 * math.pi), fit.damping_ratio, fit.dc_gain, fit.delay, fit.fit_residual))
+
+
+def run_hook(plant, cycles, controller_cmd=123.0, lost_at=None):
+    """the gimbal task cycle: controller output, sysid_override_cmd, gimbal_safety_manager's direction, the motor"""
+    replaced = 0
+    others_untouched = True
+    motor_speed = 0.0
+    for k in range(cycles):
+        DBUS_ERROR.error_exist = 1 if (lost_at is not None and k >= lost_at) else 0
+        PITCH_MOTOR.speed_rpm = int(round(motor_speed * RPM_PER_RADS))
+        cmd = ctypes.c_float(controller_cmd)
+        replaced += FIRMWARE.sysid_override_cmd(int(FIRMWARE.SYSID_TARGET_PITCH), ctypes.byref(cmd))
+        yaw_cmd = ctypes.c_float(controller_cmd)
+        others_untouched = others_untouched and not FIRMWARE.sysid_override_cmd(int(FIRMWARE.SYSID_TARGET_YAW), ctypes.byref(yaw_cmd)) \
+            and yaw_cmd.value == controller_cmd
+        can_value = -cmd.value if FIRMWARE.PITCH_TURN else cmd.value
+        plant.step(can_value)
+        motor_speed = plant.y
+    DBUS_ERROR.error_exist = 0
+    return replaced, others_untouched, cmd.value
+
+
+def test_hook(report):
+    inertia, damping = 7.5, 150.0
+    FIRMWARE.sysid_start(int(FIRMWARE.SYSID_TARGET_PITCH), CHIRP)
+    replaced, others_untouched, last_cmd = run_hook(FirstOrder(inertia, damping, 0), RECORD_LENGTH + 10)
+    report.check("hook: command replaced for the record, then zeroed", replaced == RECORD_LENGTH + 1 and last_cmd == 123.0
+                 and SYSID.state == int(FIRMWARE.SYSID_FITTING) and SYSID.record_len == RECORD_LENGTH,
+                 "%d commands replaced, %d recorded" % (replaced, SYSID.record_len))
+    report.check("hook: other motors untouched", others_untouched)
+    fit = FIRMWARE.new("sysid_first_order_t")
+    valid = FIRMWARE.sysid_fit_first_order(floats(SYSID.u), floats(SYSID.y), SYSID.record_len, MAX_DELAY, SYSID.dt, fit)
+    # the speed is quantized to the rpm of the CAN feedback
+    report.check("hook: fit in the controller's direction", valid and relative_error(fit.inertia, inertia) < 0.1 and relative_error(fit.damping, damping) < 0.1,
+                 "valid %d J %.2f B %.1f delay %d" % (valid, fit.inertia, fit.damping, fit.delay))
+
+    SYSID.state = int(FIRMWARE.SYSID_FAILED)
+    FIRMWARE.sysid_start(int(FIRMWARE.SYSID_TARGET_PITCH), PRBS)
+    replaced, _, last_cmd = run_hook(FirstOrder(inertia, damping, 0), 300, lost_at=100)
+    report.check("hook: a lost remote aborts", replaced == 100 and last_cmd == 123.0 and SYSID.state == int(FIRMWARE.SYSID_FAILED),
+                 "%d commands replaced" % replaced)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Test the motor system identification on synthetic plants")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    report = Report()
+    test_excitation(report)
+    test_first_order(report, args.seed)
+    test_second_order(report, args.seed)
+    test_hook(report)
+    if not report.ok:
+        raise SystemExit("system identification test failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,380 @@
+# Host test of the trigger jam detector (components/algorithm/jam_detector.c), fed by shoot_trigger_feedback() and
+# used in trigger_motor_stall_handler() (application/shoot.c).
+# Synthetic traces: M2006 trigger with the back-EMF current limit, its 1kHz current and rpm feedback, the 4ms speed
+# PID of shoot.c with its speed filter, Coulomb and viscous friction, a push for every projectile fed, and jams as a
+# stiff wedge at a given angle that only releases once the wheel backs off past a release depth.
+# Checks:
+#   - jams are declared within a few ms of the wedge contact, at fire and ready speeds (contacts the wheel bounces
+#     off by itself before any jam is declared need no reverse and are left out)
+#   - no jam on spin-up, steady feeding, an empty hopper, stop and start
+#   - every jam is cleared, with a small mean reverse angle, escalating for deep jams
+#   - a wheel blocked both ways ends the reverse on time and counts it
+#   - a repeated sample or two within one tick don't restart the load onset
+# Feedback frames arrive with jitter against the 1ms tick, timed on the cycle counter.
+# --trace replays a recorded CSV (time_ms,speed_rpm,current,speed_set[,jam]) instead: trigger motor rotor rpm and
+# feedback current, output shaft speed set-point in rad/s, jam is 1 on the sample of wedge contact if known.
+# Detector, feedback hook and trigger PID are the firmware's, built by firmware_host.py with TRIGGER_JAM_PREDICTION on;
+# the speed filter and the stall handler around them are played by the test. Exit code is non-zero on failure.
+
+import argparse
+import csv
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report, floats
+
+FIRMWARE = Firmware(
+    ["application/shoot.c", "components/algorithm/jam_detector.c", "components/controller/pid.c"],
+    headers=["shoot.h", "jam_detector.h", "pid.h", "bsp_delay_host.h"],
+    structs={
+        "shoot_control_t": {"trigger_speed_set": ctypes.c_float, "jam_detector": ctypes.c_uint8},
+        "jam_detector_t": {"state": ctypes.c_int, "direction": ctypes.c_int8, "reverse_angle": ctypes.c_float,
+                           "jam_count": ctypes.c_uint32, "cleared_count": ctypes.c_uint32, "repeat_jam_count": ctypes.c_uint32,
+                           "reverse_timeout_count": ctypes.c_uint32, "max_repeat": ctypes.c_uint16, "onset_time": ctypes.c_uint32},
+        "motor_measure_t": {"speed_rpm": ctypes.c_int16, "feedback_current": ctypes.c_int16},
+        "pid_type_def": {"max_out": ctypes.c_float, "out": ctypes.c_float},
+    },
+    constants=["TRIGGER_SLOT_MOTOR_ANGLE", "TRIGGER_MOTOR_RPM_TO_SPEED", "AUTO_FIRE_TRIGGER_SPEED", "READY_TRIGGER_SPEED",
+               "BLOCK_TRIGGER_SPEED", "IDLE_TRIGGER_SPEED", "BLOCK_TIME", "TRIGGER_ANGLE_PID_KP", "TRIGGER_ANGLE_PID_KI",
+               "TRIGGER_ANGLE_PID_KD", "TRIGGER_BULLET_PID_MAX_OUT", "TRIGGER_BULLET_PID_MAX_IOUT", "TRIGGER_JAM_INERTIA",
+               "TRIGGER_JAM_LOAD_THRESHOLD", "TRIGGER_JAM_MIN_REVERSE", "TRIGGER_JAM_MAX_REVERSE", "TRIGGER_JAM_REPEAT_REVERSE",
+               "TRIGGER_JAM_REPEAT_ANGLE", "TRIGGER_JAM_REVERSE_SPEED", "SHOOT_CONTROL_TIME_MS", "SHOOT_CONTROL_TIME_S",
+               "JAM_DETECTOR_REVERSING", "MOTOR_INDEX_TRIGGER", "PID_POSITION", "HOST_CYCLES_PER_US"],
+    prototypes={"PID_init": (None, [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_void_p, ctypes.c_float, ctypes.c_float,
+                                    ctypes.c_float, ctypes.c_void_p])},
+    config={"TRIGGER_JAM_PREDICTION": 1, "REVERSE_TRIGGER_DIRECTION": 0})
+SHOOT_CONTROL = FIRMWARE.global_struct("shoot_control_t", "shoot_control")
+TRIGGER_MOTOR = FIRMWARE.global_struct("motor_measure_t", "motor_chassis", int(FIRMWARE.MOTOR_INDEX_TRIGGER))
+RAW_ERR_HANDLER = ctypes.cast(FIRMWARE.lib.raw_err_handler, ctypes.c_void_p)
+
+TRIGGER_SLOT_MOTOR_ANGLE = FIRMWARE.TRIGGER_SLOT_MOTOR_ANGLE
+TRIGGER_MOTOR_RPM_TO_SPEED = FIRMWARE.TRIGGER_MOTOR_RPM_TO_SPEED
+AUTO_FIRE_TRIGGER_SPEED = FIRMWARE.AUTO_FIRE_TRIGGER_SPEED
+READY_TRIGGER_SPEED = FIRMWARE.READY_TRIGGER_SPEED
+BLOCK_TRIGGER_SPEED = FIRMWARE.BLOCK_TRIGGER_SPEED
+IDLE_TRIGGER_SPEED = FIRMWARE.IDLE_TRIGGER_SPEED
+BLOCK_TIME = int(FIRMWARE.BLOCK_TIME)
+TRIGGER_BULLET_PID_MAX_OUT = FIRMWARE.TRIGGER_BULLET_PID_MAX_OUT
+TRIGGER_JAM_REVERSE_SPEED = FIRMWARE.TRIGGER_JAM_REVERSE_SPEED
+SHOOT_CONTROL_TIME_MS = int(FIRMWARE.SHOOT_CONTROL_TIME_MS)
+JAM_DETECTOR_REVERSING = int(FIRMWARE.JAM_DETECTOR_REVERSING)
+CYCLES_PER_MS = int(FIRMWARE.HOST_CYCLES_PER_US) * 1000
+# speed filter of shoot_feedback_update()
+SPEED_FILTER = (1.725709860247969, -0.75594777109163436, 0.030237910843665373)
+# CAN receive time of a feedback against its 1ms slot
+FEEDBACK_JITTER_MS = 0.3
+
+# plant, output shaft of the M2006 gearbox
+INERTIA = 6.5e-4  # kg m^2
+TORQUE_PER_CURRENT = 0.18 / 1000.0  # N m per feedback unit (mA)
+NO_LOAD_SPEED = 30.0  # rad/s where the back-EMF leaves no current
+CURRENT_TAU_MS = 0.8
+FRICTION = 0.12  # N m
+DAMPING = 0.004  # N m per rad/s
+PUSH_TORQUE = 0.35  # N m while a projectile is pushed into the feed
+PUSH_ANGLE = 0.3  # rad of each slot
+WEDGE_STIFFNESS = 40.0  # N m / rad
+CURRENT_NOISE = 40.0
+SIM_DT_MS = 0.1
+
+
+class JamDetector:
+    """shoot_control.jam_detector, fed through shoot_trigger_feedback() like the CAN receive interrupt does"""
+
+    def __init__(self):
+        self.detector = FIRMWARE.view("jam_detector_t", SHOOT_CONTROL.field_address("jam_detector"))
+        FIRMWARE.jam_detector_init(self.detector, FIRMWARE.TRIGGER_JAM_INERTIA, FIRMWARE.TRIGGER_JAM_LOAD_THRESHOLD,
+                                   FIRMWARE.TRIGGER_JAM_MIN_REVERSE, FIRMWARE.TRIGGER_JAM_MAX_REVERSE,
+                                   FIRMWARE.TRIGGER_JAM_REPEAT_REVERSE, FIRMWARE.TRIGGER_JAM_REPEAT_ANGLE)
+        self.reverse_angles = []
+
+    def __getattr__(self, name):
+        return getattr(self.detector, name)
+
+    def update(self, speed_rpm, current, trigger_speed_set, time_ms):
+        """returns 1 when a jam was declared with this sample"""
+        jam_count = self.detector.jam_count
+        TRIGGER_MOTOR.speed_rpm = int(speed_rpm)
+        TRIGGER_MOTOR.feedback_current = int(current)
+        SHOOT_CONTROL.trigger_speed_set = trigger_speed_set
+        cycle = int(round(time_ms * CYCLES_PER_MS)) & 0xFFFFFFFF
+        FIRMWARE.host_set_cycle(cycle)
+        FIRMWARE.shoot_trigger_feedback(cycle)
+        if self.detector.jam_count == jam_count:
+            return False
+        self.reverse_angles.append(self.detector.reverse_angle)
+        return True
+
+
+class Pid:
+    """the trigger speed PID of shoot_init()"""
+
+    def __init__(self):
+        self.pid = FIRMWARE.new("pid_type_def")
+        gains = floats([FIRMWARE.TRIGGER_ANGLE_PID_KP, FIRMWARE.TRIGGER_ANGLE_PID_KI, FIRMWARE.TRIGGER_ANGLE_PID_KD])
+        FIRMWARE.PID_init(self.pid, int(FIRMWARE.PID_POSITION), gains, TRIGGER_BULLET_PID_MAX_OUT,
+                          FIRMWARE.TRIGGER_BULLET_PID_MAX_IOUT, 0.0, RAW_ERR_HANDLER)
+
+    @property
+    def max_out(self):
+        return self.pid.max_out
+
+    @max_out.setter
+    def max_out(self, value):
+        self.pid.max_out = value
+
+    def clear(self):
+        FIRMWARE.PID_clear(self.pid)
+
+    def calc(self, ref, set_value):
+        return FIRMWARE.PID_calc(self.pid, ref, set_value, FIRMWARE.SHOOT_CONTROL_TIME_S)
+
+
+class Trigger:
+    def __init__(self, rng, hopper=True):
+        self.rng = rng
+        self.angle = 0.0
+        self.omega = 0.0
+        self.current = 0.0  # feedback units
+        self.command = 0.0
+        self.hopper = hopper
+        self.wedges = []  # [angle, release depth, blocked both ways]
+        self.contact_times = []
+        self.release_times = []
+
+    def add_jam(self, angle, depth, blocked=False):
+        self.wedges.append([angle, depth, blocked, False])
+
+    def load_torque(self, t_ms):
+        torque = math.copysign(FRICTION, self.omega) if abs(self.omega) > 0.05 else 0.0
+        torque += DAMPING * self.omega
+        if self.hopper and self.omega > 0.0 and (self.angle % TRIGGER_SLOT_MOTOR_ANGLE) < PUSH_ANGLE:
+            torque += PUSH_TORQUE
+        for wedge in self.wedges:
+            angle, depth, blocked, touching = wedge
+            if self.angle > angle:
+                if not touching:
+                    wedge[3] = True
+                    self.contact_times.append(t_ms)
+                torque += WEDGE_STIFFNESS * (self.angle - angle)
+            elif blocked and self.angle < angle - depth:
+                torque -= WEDGE_STIFFNESS * (angle - depth - self.angle)
+            elif touching and not blocked and self.angle < angle - depth:
+                # backed off far enough, the projectile drops into place
+                self.wedges.remove(wedge)
+                self.release_times.append(t_ms)
+            elif touching and self.angle < angle - 0.01:
+                wedge[3] = False if blocked else True
+        return torque
+
+    def step(self, t_ms):
+        limit = TRIGGER_BULLET_PID_MAX_OUT * max(0.0, 1.0 - abs(self.omega) / NO_LOAD_SPEED)
+        command = self.command
+        # back-EMF only limits current driving the rotation further
+        if command * self.omega > 0.0:
+            command = math.copysign(min(abs(command), limit), command)
+        self.current += (command - self.current) * SIM_DT_MS / CURRENT_TAU_MS
+        torque = self.current * TORQUE_PER_CURRENT - self.load_torque(t_ms)
+        if self.omega == 0.0 and abs(self.current * TORQUE_PER_CURRENT) < FRICTION and not any(self.angle > w[0] for w in self.wedges):
+            torque = 0.0
+        new_omega = self.omega + torque / INERTIA * SIM_DT_MS / 1000.0
+        if self.omega != 0.0 and new_omega * self.omega < 0.0 and abs(self.current * TORQUE_PER_CURRENT) < FRICTION:
+            new_omega = 0.0
+        self.omega = new_omega
+        self.angle += self.omega * SIM_DT_MS / 1000.0
+
+    def feedback(self):
+        rpm = int(round(self.omega / TRIGGER_MOTOR_RPM_TO_SPEED + self.rng.gauss(0.0, 8.0)))
+        current = int(round(self.current + self.rng.gauss(0.0, CURRENT_NOISE)))
+        return rpm, current
+
+
+class Shooter:
+    """shoot.c trigger loop: speed filter, stall handler, PID at 4ms; the jam detector on every feedback."""
+
+    def __init__(self, rng, legacy=False, hopper=True):
+        self.trigger = Trigger(rng, hopper)
+        self.rng = rng
+        self.detector = JamDetector()
+        self.pid = Pid()
+        self.filter = [0.0, 0.0, 0.0]
+        self.legacy = legacy
+        self.block_time = 0
+        self.handled_jam_count = 0
+        self.trigger_speed_set = 0.0
+        self.declared_times = []
+        self.legacy_block_times = []
+        self.rpm, self.current = 0, 0
+
+    def control(self):
+        speed = self.rpm * TRIGGER_MOTOR_RPM_TO_SPEED
+        self.filter = [self.filter[1], self.filter[2],
+                       self.filter[2] * SPEED_FILTER[0] + self.filter[1] * SPEED_FILTER[1] + speed * SPEED_FILTER[2]]
+        filtered = self.filter[2]
+        speed_set = self.trigger_speed_set
+        if abs(self.trigger_speed_set) < BLOCK_TRIGGER_SPEED:
+            self.block_time = 0
+            self.pid.max_out = 0.0 if abs(filtered) < IDLE_TRIGGER_SPEED else TRIGGER_BULLET_PID_MAX_OUT
+        else:
+            self.pid.max_out = TRIGGER_BULLET_PID_MAX_OUT
+            if self.legacy:
+                if self.block_time >= BLOCK_TIME:
+                    speed_set = 0.0
+                if abs(filtered) < BLOCK_TRIGGER_SPEED and self.block_time < BLOCK_TIME:
+                    self.block_time += SHOOT_CONTROL_TIME_MS
+                    if self.block_time >= BLOCK_TIME:
+                        self.legacy_block_times.append(self.time)
+            elif self.detector.state == JAM_DETECTOR_REVERSING:
+                if self.handled_jam_count != self.detector.jam_count:
+                    self.handled_jam_count = self.detector.jam_count
+                    self.pid.clear()
+                speed_set = -TRIGGER_JAM_REVERSE_SPEED * self.detector.direction
+        self.trigger.command = self.pid.calc(filtered, speed_set)
+
+    def run(self, duration_ms, speed_profile, start_ms=0):
+        steps = int(round(1.0 / SIM_DT_MS))
+        for ms in range(start_ms, start_ms + duration_ms):
+            self.time = ms
+            self.trigger_speed_set = speed_profile(ms)
+            if ms % SHOOT_CONTROL_TIME_MS == 0:
+                self.control()
+            for k in range(steps):
+                self.trigger.step(ms + k * SIM_DT_MS)
+            self.rpm, self.current = self.trigger.feedback()
+            if self.detector.update(self.rpm, self.current, self.trigger_speed_set, ms + self.rng.uniform(-FEEDBACK_JITTER_MS, FEEDBACK_JITTER_MS)):
+                self.declared_times.append(ms)
+
+
+def constant(speed, start=0, stop=None):
+    return lambda t: speed if t >= start and (stop is None or t < stop) else 0.0
+
+
+def test_no_false_jams(report, seed):
+    rng = random.Random(seed)
+    for name, hopper, profile in (
+            ("fire, full hopper", True, constant(AUTO_FIRE_TRIGGER_SPEED, 100)),
+            ("fire, empty hopper", False, constant(AUTO_FIRE_TRIGGER_SPEED, 100)),
+            ("ready speed", True, constant(READY_TRIGGER_SPEED, 100)),
+            ("stop and start", True, lambda t: AUTO_FIRE_TRIGGER_SPEED if (t // 300) % 2 else 0.0),
+            ("reversed direction", True, constant(-AUTO_FIRE_TRIGGER_SPEED, 100))):
+        shooter = Shooter(rng, hopper=hopper)
+        if profile(1000) < 0.0:
+            shooter.trigger.hopper = False
+        shooter.run(6000, profile)
+        report.check("no jam: %s" % name, shooter.detector.jam_count == 0,
+                     "%d declared, fed %.1f slots" % (shooter.detector.jam_count, abs(shooter.trigger.angle) / TRIGGER_SLOT_MOTOR_ANGLE))
+
+
+def run_jams(rng, speed, count, depth_range, legacy=False):
+    shooter = Shooter(rng, legacy=legacy)
+    angle = 3.0 * TRIGGER_SLOT_MOTOR_ANGLE
+    for _ in range(count):
+        angle += rng.uniform(2.0, 4.0) * TRIGGER_SLOT_MOTOR_ANGLE
+        shooter.trigger.add_jam(angle, rng.uniform(*depth_range))
+    shooter.run(30000 if not legacy else 8000, constant(speed, 100))
+    return shooter
+
+
+def latency(shooter):
+    """ms from each wedge contact to the jam declared on it, contacts the wheel bounced off by itself are left out."""
+    result = []
+    for contact in shooter.trigger.contact_times:
+        declared = min([d for d in shooter.declared_times if d >= contact] or [float("inf")])
+        if any(contact <= r < declared for r in shooter.trigger.release_times):
+            continue
+        result.append(declared - contact)
+    return result
+
+
+def test_jams(report, seed):
+    for name, speed in (("fire speed", AUTO_FIRE_TRIGGER_SPEED), ("ready speed", READY_TRIGGER_SPEED)):
+        rng = random.Random(seed)
+        shooter = run_jams(rng, speed, 20, (0.02, 0.15))
+        det = shooter.detector
+        delays = latency(shooter)
+        bounced = len(shooter.trigger.contact_times) - len(delays)
+        report.check("%s: jams declared within a few ms" % name, delays and max(delays) <= 8,
+                     "%d contacts, %d bounced off, worst %.1f ms, mean %.1f ms"
+                     % (len(shooter.trigger.contact_times), bounced, max(delays or [0]), sum(delays) / max(1, len(delays))))
+        remaining = len(shooter.trigger.wedges)
+        mean_reverse = sum(det.reverse_angles) / max(1, len(det.reverse_angles)) / TRIGGER_SLOT_MOTOR_ANGLE
+        report.check("%s: every jam cleared with a small reverse" % name, remaining == 0 and det.cleared_count + bounced >= 20 and mean_reverse < 0.35,
+                     "%d left, %d jams, %d cleared, %d repeated, mean reverse %.2f slot, %d reverse timeouts"
+                     % (remaining, det.jam_count, det.cleared_count, det.repeat_jam_count, mean_reverse, det.reverse_timeout_count))
+    # deep jams need the reverse to grow
+    rng = random.Random(seed + 1)
+    shooter = run_jams(rng, AUTO_FIRE_TRIGGER_SPEED, 8, (0.35, 0.6))
+    det = shooter.detector
+    report.check("deep jams: escalated until cleared", len(shooter.trigger.wedges) == 0 and det.repeat_jam_count > 0 and det.cleared_count == 8,
+                 "%d jams, %d repeated, max %d in a row, %d cleared" % (det.jam_count, det.repeat_jam_count, det.max_repeat, det.cleared_count))
+    # previous handler for comparison
+    rng = random.Random(seed)
+    legacy = run_jams(rng, AUTO_FIRE_TRIGGER_SPEED, 1, (0.02, 0.15), legacy=True)
+    legacy_delay = legacy.legacy_block_times[0] - legacy.trigger.contact_times[0] if legacy.legacy_block_times else None
+    print("     previous handler: first jam noticed after %s ms" % legacy_delay)
+
+
+def test_blocked(report, seed):
+    rng = random.Random(seed)
+    shooter = Shooter(rng)
+    angle = 2.0 * TRIGGER_SLOT_MOTOR_ANGLE
+    shooter.trigger.add_jam(angle, 0.03, blocked=True)
+    shooter.run(3000, constant(AUTO_FIRE_TRIGGER_SPEED, 100))
+    det = shooter.detector
+    report.check("blocked both ways: reverse times out", det.reverse_timeout_count > 0 and det.jam_count >= det.reverse_timeout_count,
+                 "%d jams, %d reverse timeouts" % (det.jam_count, det.reverse_timeout_count))
+
+
+def test_feedback_timing(report):
+    # wheel at speed pushing against a load, no jam declared yet
+    detector = JamDetector()
+    rpm = AUTO_FIRE_TRIGGER_SPEED / TRIGGER_MOTOR_RPM_TO_SPEED
+    current = 2.0 * FIRMWARE.TRIGGER_JAM_LOAD_THRESHOLD
+    onset = []
+    for time_ms in (0.0, 1.0, 2.0, 2.0, 2.4):
+        detector.update(rpm, current, AUTO_FIRE_TRIGGER_SPEED, time_ms)
+        onset.append(detector.onset_time)
+    report.check("feedback timing: onset kept over a repeated sample and a short interval", onset[1:] == [1000, 2000, 2000, 2400],
+                 "onset %s us" % onset[1:])
+
+
+def replay(path):
+    detector = JamDetector()
+    marked, declared = [], []
+    with open(path) as f:
+        for row in csv.DictReader(f):
+            t = int(float(row["time_ms"]))
+            if detector.update(float(row["speed_rpm"]), float(row["current"]), float(row["speed_set"]), float(row["time_ms"])):
+                declared.append(t)
+            if int(float(row.get("jam") or 0)):
+                marked.append(t)
+    print("%d jams declared at %s ms, reverse angles %s slot" % (len(declared), declared,
+                                                                 ["%.2f" % (a / TRIGGER_SLOT_MOTOR_ANGLE) for a in detector.reverse_angles]))
+    if marked:
+        delays = [min([d - m for d in declared if d >= m] or [None]) for m in marked]
+        print("marked jams at %s ms, declared after %s ms" % (marked, delays))
+        return all(d is not None and d <= 8 for d in delays)
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Test the trigger jam detector on synthetic or recorded traces")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--trace", help="CSV with time_ms,speed_rpm,current,speed_set[,jam]")
+    args = parser.parse_args()
+    if args.trace:
+        if not replay(args.trace):
+            raise SystemExit("trace replay: marked jams not declared in time")
+        return
+    report = Report()
+    test_no_false_jams(report, args.seed)
+    test_jams(report, args.seed)
+    test_blocked(report, args.seed)
+    test_feedback_timing(report)
+    if not report.ok:
+        raise SystemExit("trigger jam test failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,286 @@
+# Host test of the multi-turn angle tracker (components/algorithm/angle_tracker.c) on the gimbal yaw, as
+# gimbal_feedback_update feeds it at the gimbal loop rate, and of the 4310 position decode (decode_4310_motor_feedback in
+# application/CAN_receive.c). Tracker, decode and motor_ecd_to_angle_change are the firmware's, built by
+# firmware_host.py; the test plays the yaw motor: the chassis spins through the slip ring, back and forth, for tens of
+# turns:
+#   - 4310 decode: ecd stays continuous where the MIT position wraps at +-12.5rad, the position without the carried
+#     remainder jumps 7.6deg there
+#   - the multi-turn relative angle follows the unwrapped truth through every +-PI wrap, 6020 and 4310 feedback,
+#     no turn lost or added
+#   - its speed is less noisy than differencing the encoder in the chassis task at 1kHz (the code it replaces)
+#   - the multi-turn absolute yaw follows INS yaw with a biased gyro, and its speed carries no bias
+#   - an encoder jump (offset calibrated) is taken at once, turns kept
+#   - without rate measurement a constant spin is still tracked without lag
+# Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["components/algorithm/angle_tracker.c", "application/gimbal_task.c", "application/CAN_receive.c"],
+    headers=["angle_tracker.h", "gimbal_task.h", "chassis_task.h"],
+    structs={
+        "angle_tracker_t": {"speed": ctypes.c_float},
+        "motor_measure_t": {"ecd": ctypes.c_uint16, "output_angle": ctypes.c_float,
+                            "output_angle_wrap_offset": ctypes.c_float, "velocity": ctypes.c_float},
+    },
+    constants=["GIMBAL_CONTROL_TIME_S", "CHASSIS_CONTROL_TIME_S", "YAW_RELATIVE_TRACKER_BANDWIDTH_HZ",
+               "YAW_ABSOLUTE_TRACKER_BANDWIDTH_HZ", "CHASSIS_SPIN_COMP_RATE_FILTER_COEFF", "ECD_RANGE", "MOTOR_INDEX_YAW",
+               "DM_4310"],
+    prototypes={"decode_4310_motor_feedback": (ctypes.c_int, [ctypes.c_void_p, ctypes.c_uint8])})
+GIMBAL_CONTROL_TIME_S = FIRMWARE.GIMBAL_CONTROL_TIME_S
+CHASSIS_CONTROL_TIME_S = FIRMWARE.CHASSIS_CONTROL_TIME_S
+ECD_RANGE = int(FIRMWARE.ECD_RANGE)
+MOTOR_RAD_TO_ECD = (ECD_RANGE / 2) / math.pi
+MOTOR_ECD_TO_RAD = math.pi / (ECD_RANGE / 2)
+_mit_index = int(FIRMWARE.DM_4310)
+P_MIN = FIRMWARE.global_value(ctypes.c_float * 3, "MIT_CONTROL_P_MIN")[_mit_index]
+P_MAX = FIRMWARE.global_value(ctypes.c_float * 3, "MIT_CONTROL_P_MAX")[_mit_index]
+V_MIN = FIRMWARE.global_value(ctypes.c_float * 3, "MIT_CONTROL_V_MIN")[_mit_index]
+V_MAX = FIRMWARE.global_value(ctypes.c_float * 3, "MIT_CONTROL_V_MAX")[_mit_index]
+YAW_MOTOR = FIRMWARE.global_struct("motor_measure_t", "motor_chassis", int(FIRMWARE.MOTOR_INDEX_YAW))
+# yaw motor feedback arrives at 1kHz, read at any time by the gimbal task
+FEEDBACK_PERIOD_S = 0.001
+
+
+def rad_format(angle):
+    return (angle + math.pi) % (2.0 * math.pi) - math.pi
+
+
+class AngleTracker:
+    """an angle_tracker_t"""
+
+    def __init__(self, bandwidth_hz, dt):
+        self.tracker = FIRMWARE.new("angle_tracker_t")
+        FIRMWARE.angle_tracker_init(self.tracker, bandwidth_hz, dt)
+
+    def reset(self, angle, rate):
+        FIRMWARE.angle_tracker_reset(self.tracker, angle, rate)
+
+    def update(self, angle, rate):
+        FIRMWARE.angle_tracker_update(self.tracker, angle, rate)
+
+    def multi_turn(self):
+        return FIRMWARE.angle_tracker_get_multi_turn(self.tracker)
+
+    @property
+    def speed(self):
+        return self.tracker.speed
+
+
+def motor_ecd_to_angle_change(ecd, offset_ecd):
+    return FIRMWARE.motor_ecd_to_angle_change(ecd, offset_ecd)
+
+
+def to_uint(value, low, high, bits):
+    """what the motor puts in its MIT feedback frame"""
+    return int(round((min(max(value, low), high) - low) / (high - low) * ((1 << bits) - 1)))
+
+
+class Motor4310:
+    """DaMiao 4310 feedback frames of a rotor angle and speed, decoded by decode_4310_motor_feedback"""
+
+    def __init__(self):
+        YAW_MOTOR.output_angle = 0.0
+        YAW_MOTOR.output_angle_wrap_offset = 0.0
+
+    def decode(self, rotor_angle, rotor_speed):
+        # the motor reports its multi-turn position modulo the frame range
+        p_int = to_uint((rotor_angle - P_MIN) % (P_MAX - P_MIN) + P_MIN, P_MIN, P_MAX, 16)
+        v_int = to_uint(rotor_speed, V_MIN, V_MAX, 12)
+        frame = (ctypes.c_uint8 * 8)(0x10, p_int >> 8, p_int & 0xFF, v_int >> 4, (v_int & 0xF) << 4, 0, 30, 0)
+        assert FIRMWARE.decode_4310_motor_feedback(frame, int(FIRMWARE.MOTOR_INDEX_YAW)) == 0
+        return YAW_MOTOR.ecd, YAW_MOTOR.velocity
+
+
+def spin_profile(rng, duration):
+    """chassis spin relative to the gimbal: speed steps, reversals and a wobble, as (t, angle, speed) at 0.1ms"""
+    dt = 0.0001
+    segments = []
+    t = 0.0
+    while t < duration:
+        length = rng.uniform(2.0, 6.0)
+        segments.append((t, rng.choice([-1.0, 1.0]) * rng.uniform(2.0, 9.0), rng.uniform(0.0, 1.5), rng.uniform(0.5, 3.0)))
+        t += length
+    angle, speed = rng.uniform(-math.pi, math.pi), 0.0
+    profile = []
+    for i in range(int(duration / dt)):
+        t = i * dt
+        base, wobble, wobble_hz = [(s[1], s[2], s[3]) for s in segments if s[0] <= t][-1]
+        target = base + wobble * math.sin(2.0 * math.pi * wobble_hz * t)
+        # speed change of the chassis is limited by the wheels
+        speed += max(min(target - speed, 40.0 * dt), -40.0 * dt)
+        angle += speed * dt
+        profile.append((t, angle, speed))
+    return profile
+
+
+def sample_at(profile, t):
+    return profile[min(int(t / 0.0001), len(profile) - 1)]
+
+
+def run_relative(rng, motor, duration, offset_jump_at=None):
+    """gimbal task at 250Hz reading the last yaw feedback; returns worst angle error, speed rms, turn error"""
+    profile = spin_profile(rng, duration)
+    offset_ecd = rng.randrange(ECD_RANGE)
+    rotor_zero = offset_ecd * MOTOR_ECD_TO_RAD
+    decoder = Motor4310()
+    feedback = {}
+
+    def read_feedback(t):
+        # latest 1kHz frame at time t
+        frame_t = math.floor(t / FEEDBACK_PERIOD_S) * FEEDBACK_PERIOD_S
+        if frame_t not in feedback:
+            _, angle, speed = sample_at(profile, frame_t)
+            rotor = rotor_zero + angle
+            if motor == "4310":
+                ecd, velocity = decoder.decode(rotor, speed)
+                rate = velocity
+            else:
+                ecd = int((rotor % (2.0 * math.pi)) * MOTOR_RAD_TO_ECD) % ECD_RANGE
+                rate = int(round(speed * 60.0 / (2.0 * math.pi))) * 2.0 * math.pi / 60.0
+            feedback.clear()
+            feedback[frame_t] = (ecd, rate)
+        return feedback[frame_t]
+
+    tracker = AngleTracker(FIRMWARE.YAW_RELATIVE_TRACKER_BANDWIDTH_HZ, GIMBAL_CONTROL_TIME_S)
+    ecd, rate = read_feedback(0.0)
+    tracker.reset(motor_ecd_to_angle_change(ecd, offset_ecd), 0.0)
+    start_truth = sample_at(profile, 0.0)[1] - tracker.multi_turn()
+    worst, speed_sq, count, jumped = 0.0, 0.0, 0, False
+    t = GIMBAL_CONTROL_TIME_S
+    while t < duration:
+        if offset_jump_at is not None and not jumped and t >= offset_jump_at:
+            # calibrated offset moves the relative zero by 1rad
+            offset_ecd = (offset_ecd + int(1.0 * MOTOR_RAD_TO_ECD)) % ECD_RANGE
+            start_truth += int(1.0 * MOTOR_RAD_TO_ECD) * MOTOR_ECD_TO_RAD
+            jumped = True
+        ecd, rate = read_feedback(t)
+        tracker.update(motor_ecd_to_angle_change(ecd, offset_ecd), rate)
+        _, truth, speed = sample_at(profile, t)
+        if t > 0.5:
+            # the feedback is up to one frame old, compare with the truth at its middle
+            error = abs(tracker.multi_turn() - (truth - start_truth - 0.5 * FEEDBACK_PERIOD_S * speed))
+            worst = max(worst, error)
+            speed_sq += (tracker.speed - speed) ** 2
+            count += 1
+        t += GIMBAL_CONTROL_TIME_S
+    _, truth, _ = sample_at(profile, duration - GIMBAL_CONTROL_TIME_S)
+    turns = (truth - start_truth) / (2.0 * math.pi)
+    return worst, math.sqrt(speed_sq / count), round(turns - tracker.multi_turn() / (2.0 * math.pi)), abs(turns)
+
+
+def run_differencing(rng, duration):
+    """chassis_task relative_angle_dot without the tracker: 6020 encoder differenced and filtered at 1kHz"""
+    profile = spin_profile(rng, duration)
+    offset_ecd = rng.randrange(ECD_RANGE)
+    rotor_zero = offset_ecd * MOTOR_ECD_TO_RAD
+    dot, last, speed_sq, count = 0.0, None, 0.0, 0
+    t = 0.0
+    while t < duration:
+        _, angle, speed = sample_at(profile, t)
+        ecd = int(((rotor_zero + angle) % (2.0 * math.pi)) * MOTOR_RAD_TO_ECD) % ECD_RANGE
+        relative = motor_ecd_to_angle_change(ecd, offset_ecd)
+        if last is not None:
+            dot += FIRMWARE.CHASSIS_SPIN_COMP_RATE_FILTER_COEFF * (rad_format(relative - last) / CHASSIS_CONTROL_TIME_S - dot)
+        last = relative
+        if t > 0.5:
+            speed_sq += (dot - speed) ** 2
+            count += 1
+        t += CHASSIS_CONTROL_TIME_S
+    return math.sqrt(speed_sq / count)
+
+
+def test_4310_decode(report, rng):
+    decoder = Motor4310()
+    rotor, worst, worst_uncarried = rng.uniform(-3.0, 3.0), 0.0, 0.0
+    last_ecd, _ = decoder.decode(rotor, 0.0)
+    last_uncarried = YAW_MOTOR.output_angle
+    for _ in range(20000):
+        step = 8.0 * 0.001
+        rotor += step
+        ecd, _ = decoder.decode(rotor, 8.0)
+        change = ((ecd - last_ecd + ECD_RANGE // 2) % ECD_RANGE - ECD_RANGE // 2) * MOTOR_ECD_TO_RAD
+        worst = max(worst, abs(change - step))
+        last_ecd = ecd
+        # what ecd followed before the carried remainder: the decoded position alone
+        worst_uncarried = max(worst_uncarried, abs(rad_format(YAW_MOTOR.output_angle - last_uncarried) - step))
+        last_uncarried = YAW_MOTOR.output_angle
+    report.check("4310 decode continuous across the +-12.5rad wrap", worst < 3.0 * MOTOR_ECD_TO_RAD, "worst step error %.4f rad" % worst)
+    report.check("4310 position without the carry jumps 7.6deg", abs(math.degrees(worst_uncarried) - 7.6) < 0.2,
+                 "worst step error %.1f deg" % math.degrees(worst_uncarried))
+
+
+def test_relative(report, rng, runs, duration):
+    for motor in ["6020", "4310"]:
+        worst, speed_rms, lost, turns = 0.0, 0.0, 0, 0.0
+        for _ in range(runs):
+            w, s, l, n = run_relative(rng, motor, duration)
+            worst, speed_rms, lost, turns = max(worst, w), max(speed_rms, s), lost + abs(l), max(turns, n)
+        differencing = max(run_differencing(rng, duration) for _ in range(runs))
+        report.check("%s multi-turn relative angle" % motor, worst < 0.01, "worst %.4f rad over up to %.0f turns" % (worst, turns))
+        report.check("%s no turn lost" % motor, lost == 0, "%d turns off" % lost)
+        report.check("%s speed quieter than encoder differencing" % motor, speed_rms < 0.5 * differencing,
+                     "rms %.3f rad/s, differencing %.3f rad/s" % (speed_rms, differencing))
+
+
+def test_offset_jump(report, rng, duration):
+    worst, _, lost, _ = run_relative(rng, "6020", duration, offset_jump_at=0.5 * duration)
+    report.check("offset jump taken at once, turns kept", worst < 0.01 and lost == 0, "worst %.4f rad" % worst)
+
+
+def test_absolute(report, rng, duration):
+    profile = spin_profile(rng, duration)
+    tracker = AngleTracker(FIRMWARE.YAW_ABSOLUTE_TRACKER_BANDWIDTH_HZ, GIMBAL_CONTROL_TIME_S)
+    bias = rng.uniform(-0.05, 0.05)
+    tracker.reset(rad_format(profile[0][1]), 0.0)
+    start = profile[0][1] - tracker.multi_turn()
+    worst, speed_error, count, t = 0.0, 0.0, 0, GIMBAL_CONTROL_TIME_S
+    while t < duration:
+        _, angle, speed = sample_at(profile, t)
+        tracker.update(rad_format(angle + rng.gauss(0.0, 0.001)), speed + bias + rng.gauss(0.0, 0.01))
+        if t > 1.0:
+            worst = max(worst, abs(tracker.multi_turn() - (angle - start)))
+            speed_error += tracker.speed - speed
+            count += 1
+        t += GIMBAL_CONTROL_TIME_S
+    speed_error /= count
+    report.check("multi-turn absolute yaw with biased gyro", worst < 0.01 and abs(speed_error) < 0.005,
+                 "worst %.4f rad, gyro bias %.3f rad/s, mean speed error %.4f rad/s" % (worst, bias, speed_error))
+
+
+def test_no_rate(report):
+    tracker = AngleTracker(FIRMWARE.YAW_RELATIVE_TRACKER_BANDWIDTH_HZ, GIMBAL_CONTROL_TIME_S)
+    speed, angle = 7.0, 0.0
+    for _ in range(2000):
+        angle += speed * GIMBAL_CONTROL_TIME_S
+        tracker.update(rad_format(angle), 0.0)
+    error = abs(tracker.multi_turn() - angle)
+    # a few fp32 quanta of the angle within the turn
+    report.check("constant spin tracked without rate measurement", error < 1e-5 and abs(tracker.speed - speed) < 1e-5,
+                 "angle error %.1e rad, speed %.4f rad/s" % (error, tracker.speed))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the multi-turn yaw angle tracker")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--runs", type=int, default=3)
+    parser.add_argument("--duration", type=float, default=30.0)
+    args = parser.parse_args()
+    rng = random.Random(args.seed)
+    report = Report()
+    test_4310_decode(report, rng)
+    test_relative(report, rng, args.runs, args.duration)
+    test_offset_jump(report, rng, args.duration)
+    test_absolute(report, rng, args.duration)
+    test_no_rate(report)
+    if not report.ok:
+        raise SystemExit("yaw angle tracker test failed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,191 @@
+# Host simulation of the yaw disturbance observer (components/controller/disturbance_observer.c) against the slip ring
+# coupling of a spinning chassis. The yaw loop is the firmware's for the default robot: the angle PID and the speed PID
+# of components/controller/pid.c set up as gimbal_init does, then DOB_calc, the constrain to the speed PID max_out and
+# DOB_set_applied_cmd in the order gimbal_yaw_disturbance_compensation in application/gimbal_task.c calls them, with
+# DOB_clear on every change of activation. The yaw command and gyro filters are bypassed on this robot and left out.
+# Plant: the gimbal in the world frame, inertia and damping off the nominal model, dragged by the chassis through the
+# slip ring with viscous and Coulomb friction on the relative speed plus a ripple over the relative angle, gyro noise,
+# the command held over the 4 ms period. The chassis spins up, changes rate, reverses and stops.
+# YAW_DOB_ENABLE is off until the nominal model is identified, the build turns it on with the placeholder model of the
+# default robot.
+# Checks:
+#   - the world yaw hold error while spinning is at most half of what the loop alone does
+#   - the estimate settles on the friction torque at every spin rate
+#   - no kick: the estimate starts from zero on activation, also when the chassis spins up again after a stop
+#   - compensation within YAW_DOB_MAX_COMPENSATION, command within the speed PID max_out
+# Exit code is non-zero on failure.
+
+import argparse
+import ctypes
+import math
+import random
+
+from firmware_host import Firmware, Report
+
+FIRMWARE = Firmware(
+    ["components/controller/disturbance_observer.c", "components/controller/pid.c"],
+    headers=["disturbance_observer.h", "pid.h", "user_lib.h", "gimbal_task.h"],
+    structs={"disturbance_observer_t": {"disturbance": ctypes.c_float, "compensation": ctypes.c_float},
+             "pid_type_def": {"out": ctypes.c_float, "Iout": ctypes.c_float, "max_out": ctypes.c_float}},
+    constants=["GIMBAL_CONTROL_TIME_S", "YAW_DOB_NOMINAL_INERTIA", "YAW_DOB_NOMINAL_DAMPING",
+               "YAW_DOB_CUTOFF_HZ", "YAW_DOB_MAX_COMPENSATION", "YAW_SPEED_PID_KP", "YAW_SPEED_PID_KI",
+               "YAW_SPEED_PID_KD", "YAW_SPEED_PID_MAX_OUT", "YAW_SPEED_PID_MAX_IOUT", "YAW_ANGLE_PID_KP",
+               "YAW_ANGLE_PID_KI", "YAW_ANGLE_PID_KD", "YAW_ANGLE_PID_MAX_OUT", "YAW_ANGLE_PID_MAX_IOUT",
+               "PID_POSITION"],
+    prototypes={"PID_init": (None, [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_void_p, ctypes.c_float, ctypes.c_float,
+                                    ctypes.c_float, ctypes.c_void_p])},
+    config={"YAW_DOB_ENABLE": 1})
+
+DT = FIRMWARE.GIMBAL_CONTROL_TIME_S
+MAX_COMPENSATION = FIRMWARE.YAW_DOB_MAX_COMPENSATION
+# plant integration steps per control period
+SUBSTEPS = 8
+# gimbal off the nominal model
+INERTIA = 1.25 * FIRMWARE.YAW_DOB_NOMINAL_INERTIA
+DAMPING = 1.5 * FIRMWARE.YAW_DOB_NOMINAL_DAMPING
+# slip ring and yaw bearing, on the speed relative to the chassis
+RING_VISCOUS = 0.04  # Nm/(rad/s)
+RING_COULOMB = 0.35  # Nm
+RING_RIPPLE = 0.08  # Nm, 6 per turn
+RING_STICTION_SPEED = 0.05  # rad/s, Coulomb friction blended in below it
+GYRO_NOISE = 0.01  # rad/s rms
+# chassis spin profile: (time s, rate rad/s), linear in between
+SPIN_PROFILE = [(0.0, 0.0), (1.0, 0.0), (1.5, 8.0), (4.0, 8.0), (4.5, 12.0), (7.0, 12.0), (7.8, -10.0), (10.5, -10.0),
+                (11.0, 0.0), (12.0, 0.0), (12.3, 10.0), (14.0, 10.0)]
+# time the spin is held at each rate before the estimate is judged, from the end of the ramp
+SETTLE_S = 1.0
+
+
+def spin_rate(t):
+    for (t0, w0), (t1, w1) in zip(SPIN_PROFILE, SPIN_PROFILE[1:]):
+        if t < t1:
+            return w0 + (w1 - w0) * (t - t0) / (t1 - t0)
+    return SPIN_PROFILE[-1][1]
+
+
+def plateaus():
+    """(start, end, rate) of the constant non zero spin rates, start after the settling time"""
+    return [(t0 + SETTLE_S, t1, w0) for (t0, w0), (t1, w1) in zip(SPIN_PROFILE, SPIN_PROFILE[1:]) if w0 == w1 and w0 != 0.0]
+
+
+def ring_torque(relative_speed, relative_angle):
+    """torque the chassis puts on the gimbal through the slip ring, relative_speed is chassis minus gimbal"""
+    coulomb = RING_COULOMB * max(-1.0, min(1.0, relative_speed / RING_STICTION_SPEED))
+    return RING_VISCOUS * relative_speed + coulomb + RING_RIPPLE * math.sin(6.0 * relative_angle)
+
+
+class YawLoop:
+    """gimbal_motor_absolute_angle_control and gimbal_yaw_disturbance_compensation of the yaw motor"""
+
+    def __init__(self, dob_enable):
+        self.angle_pid = self._pid("YAW_ANGLE_PID", 0.0, FIRMWARE.lib.rad_err_handler)
+        self.speed_pid = self._pid("YAW_SPEED_PID", 0.85, FIRMWARE.lib.filter_err_handler)
+        self.dob = FIRMWARE.new("disturbance_observer_t")
+        FIRMWARE.DOB_init(self.dob, FIRMWARE.YAW_DOB_NOMINAL_INERTIA, FIRMWARE.YAW_DOB_NOMINAL_DAMPING,
+                          FIRMWARE.YAW_DOB_CUTOFF_HZ, MAX_COMPENSATION, DT)
+        self.dob_enable = dob_enable
+        self.fActive = False
+
+    @staticmethod
+    def _pid(prefix, filter_coeff, handler):
+        gains = (ctypes.c_float * 3)(*(getattr(FIRMWARE, "%s_%s" % (prefix, k)) for k in ("KP", "KI", "KD")))
+        pid = FIRMWARE.new("pid_type_def")
+        FIRMWARE.PID_init(pid.address, int(FIRMWARE.PID_POSITION), gains, getattr(FIRMWARE, prefix + "_MAX_OUT"),
+                          getattr(FIRMWARE, prefix + "_MAX_IOUT"), filter_coeff, ctypes.cast(handler, ctypes.c_void_p))
+        return pid
+
+    def step(self, angle, gyro, angle_set, spinning):
+        """command of one control period"""
+        gyro_set = FIRMWARE.PID_calc_with_dot(self.angle_pid, angle, angle_set, DT, gyro)
+        cmd = FIRMWARE.PID_calc(self.speed_pid, gyro, gyro_set, DT)
+        cmd = FIRMWARE.fp32_abs_constrain(cmd, self.speed_pid.max_out)
+        active = self.dob_enable and spinning
+        if active != self.fActive:
+            FIRMWARE.DOB_clear(self.dob)
+            self.fActive = active
+        self.compensation = 0.0
+        if active:
+            self.compensation = FIRMWARE.DOB_calc(self.dob, gyro)
+            cmd = FIRMWARE.fp32_abs_constrain(cmd + self.compensation, self.speed_pid.max_out)
+            FIRMWARE.DOB_set_applied_cmd(self.dob, cmd)
+        return cmd
+
+
+def run(dob_enable, rng, duration=SPIN_PROFILE[-1][0]):
+    """trace of (t, chassis rate, world yaw, cmd, compensation, ring torque, activation) per control period"""
+    loop = YawLoop(dob_enable)
+    yaw = speed = chassis_angle = 0.0
+    trace = []
+    for n in range(int(round(duration / DT))):
+        t = n * DT
+        spinning = spin_rate(t) != 0.0
+        cmd = loop.step(yaw, speed + rng.gauss(0.0, GYRO_NOISE), 0.0, spinning)
+        ring = 0.0
+        h = DT / SUBSTEPS
+        for k in range(SUBSTEPS):
+            rate = spin_rate(t + k * h)
+            ring = ring_torque(rate - speed, chassis_angle - yaw)
+            speed += (cmd + ring - DAMPING * speed) / INERTIA * h
+            yaw += speed * h
+            chassis_angle += rate * h
+        trace.append((t, spin_rate(t), yaw, cmd, loop.compensation, ring, loop.fActive))
+    return trace
+
+
+def rms(values):
+    return math.sqrt(sum(v * v for v in values) / len(values)) if values else 0.0
+
+
+def test_hold(report, with_dob, without_dob):
+    error_dob = rms([row[2] for row in with_dob if row[1] != 0.0])
+    error_pid = rms([row[2] for row in without_dob if row[1] != 0.0])
+    report.check("world yaw held tighter with the observer", error_dob <= 0.5 * error_pid,
+                 "rms %.2f mrad with, %.2f mrad without" % (error_dob * 1e3, error_pid * 1e3))
+
+
+def test_estimate(report, trace):
+    # the speed loop adds its own integral, the observer has to take over the friction, not share it
+    passed = True
+    details = []
+    for start, end, rate in plateaus():
+        rows = [row for row in trace if start <= row[0] < end]
+        compensation = sum(row[4] for row in rows) / len(rows)
+        friction = sum(row[5] for row in rows) / len(rows)
+        passed &= abs(compensation + friction) <= 0.1 * abs(friction)
+        details.append("%+.0f rad/s: %.3f of %.3f Nm" % (rate, -compensation, friction))
+    report.check("estimate settles on the slip ring torque", passed, "; ".join(details))
+
+
+def test_activation(report, trace):
+    starts = [n for n in range(1, len(trace)) if trace[n][6] and not trace[n - 1][6]]
+    first = [trace[n][4] for n in starts]
+    report.check("no kick on activation", len(starts) == 2 and all(c == 0.0 for c in first),
+                 "%d activations, first compensation %s" % (len(starts), ", ".join("%.3f" % c for c in first)))
+
+
+def test_bounds(report, trace):
+    worst_comp = max(abs(row[4]) for row in trace)
+    worst_cmd = max(abs(row[3]) for row in trace)
+    report.check("compensation and command within limits",
+                 worst_comp <= MAX_COMPENSATION and worst_cmd <= FIRMWARE.YAW_SPEED_PID_MAX_OUT,
+                 "|compensation| %.2f of %.2f Nm, |cmd| %.2f of %.2f Nm" % (worst_comp, MAX_COMPENSATION, worst_cmd,
+                                                                         FIRMWARE.YAW_SPEED_PID_MAX_OUT))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Simulate the yaw disturbance observer on a spinning chassis")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    report = Report()
+    with_dob = run(True, random.Random(args.seed))
+    without_dob = run(False, random.Random(args.seed))
+    test_hold(report, with_dob, without_dob)
+    test_estimate(report, with_dob)
+    test_activation(report, with_dob)
+    test_bounds(report, with_dob)
+    if not report.ok:
+        raise SystemExit("yaw disturbance observer check failed")
+
+
+if __name__ == "__main__":
+    main()
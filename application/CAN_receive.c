@@ -30,6 +30,9 @@
 #include "chassis_behaviour.h"
 #include "string.h"
 #include "shoot.h"
+#include "bsp_delay.h"
+#include "supercap_manager.h"
+#include "shoot_heat.h"
 
 // Warning: for safety, PLEASE ALWAYS keep those default values as 0 when you commit
 // Warning: because #if directive will assume the expression as 0 even if the macro is not defined, positive logic, for example, ENABLE_MOTOR_POWER, is safer that if and only if it's defined and set to 1 that the power is enabled
@@ -119,10 +122,7 @@ uint8_t decode_swerve_chassis_target_radius_dot(uint8_t *data);
 uint8_t decode_swerve_chassis_feedback(uint8_t *data);
 
 #elif (ROBOT_TYPE == INFANTRY_2024_BIPED)
-#define BIPED_METER_PER_SEC_ECD_MAX_LIMIT 3.5f
-#define BIPED_METER_ECD_MAX_LIMIT 0.5f
-#define BIPED_RAD_ECD_MAX_LIMIT PI
-#define BIPED_RAD_PER_SEC_ECD_MAX_LIMIT 2.5f
+#include "biped_link.h"
 
 const fp32 biped_speed_encoding_ratio = (1 << 15) / BIPED_METER_PER_SEC_ECD_MAX_LIMIT;
 const fp32 biped_meter_encoding_ratio = (1 << 16) / BIPED_METER_ECD_MAX_LIMIT;
@@ -132,6 +132,18 @@ const fp32 biped_angle_speed_encoding_ratio = (1 << 15) / BIPED_RAD_PER_SEC_ECD_
 uint8_t decode_biped_chassis_feedback(uint8_t *data);
 #endif
 
+#if CHASSIS_EVENT_DRIVEN_LOOP
+#define CHASSIS_FEEDBACK_ALL_WHEELS 0x0F
+static TaskHandle_t chassis_feedback_notify_task = NULL;
+static uint8_t chassis_feedback_rx_mask = 0;
+static volatile uint32_t chassis_feedback_cycle = 0;
+static void chassis_feedback_arrived(uint8_t bMotorId);
+#endif
+// auxiliary chassis frames are sent once per this many chassis periods, same 5ms rate as before the 1kHz loop
+#define CHASSIS_AUX_FRAME_DIVIDER 5
+// supercap command goes out in a slot no auxiliary frame uses, SUPCAP_COMMAND_DIVIDER is a multiple of CHASSIS_AUX_FRAME_DIVIDER
+#define SUPCAP_COMMAND_SLOT 2
+
 /**
  * @brief          hal CAN fifo call back, receive motor data
  * @param[in]      hcan, the point to CAN handle
@@ -161,6 +173,9 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 				bMotorId = MOTOR_INDEX_FRICTION_LEFT;
 				decode_rm_motor_feedback(rx_data, bMotorId);
 				detect_hook(FRIC1_MOTOR_TOE);
+#if SHOOT_HEAT_FRICTION_SHOT_DETECTION
+				shoot_heat_friction_feedback(0, motor_chassis[bMotorId].speed_rpm, osKernelSysTick());
+#endif
 				break;
 			}
 			case CAN_FRICTION_MOTOR_RIGHT_ID:
@@ -168,6 +183,9 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 				bMotorId = MOTOR_INDEX_FRICTION_RIGHT;
 				decode_rm_motor_feedback(rx_data, bMotorId);
 				detect_hook(FRIC2_MOTOR_TOE);
+#if SHOOT_HEAT_FRICTION_SHOT_DETECTION
+				shoot_heat_friction_feedback(1, motor_chassis[bMotorId].speed_rpm, osKernelSysTick());
+#endif
 				break;
 			}
 #if IS_TRIGGER_ON_GIMBAL
@@ -176,6 +194,9 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
         		bMotorId = MOTOR_INDEX_TRIGGER;
 				decode_rm_motor_feedback(rx_data, bMotorId);
 				detect_hook(TRIGGER_MOTOR_TOE);
+#if TRIGGER_JAM_PREDICTION
+				shoot_trigger_feedback(delay_get_cycle());
+#endif
 				break;
 			}
 #endif
@@ -194,6 +215,9 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 				bMotorId = MOTOR_INDEX_3508_M1;
 				decode_rm_motor_feedback(rx_data, bMotorId);
         		detect_hook(CHASSIS_MOTOR1_TOE);
+#if CHASSIS_EVENT_DRIVEN_LOOP
+				chassis_feedback_arrived(bMotorId);
+#endif
 				break;
 			}
 			case CAN_3508_M2_ID:
@@ -201,7 +225,9 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
         		bMotorId = MOTOR_INDEX_3508_M2;
 				decode_rm_motor_feedback(rx_data, bMotorId);
 				detect_hook(CHASSIS_MOTOR2_TOE);
-        
+#if CHASSIS_EVENT_DRIVEN_LOOP
+				chassis_feedback_arrived(bMotorId);
+#endif
 				break;
 			}
 			case CAN_3508_M3_ID:
@@ -209,6 +235,9 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
         		bMotorId = MOTOR_INDEX_3508_M3;
 				decode_rm_motor_feedback(rx_data, bMotorId);
 				detect_hook(CHASSIS_MOTOR3_TOE);
+#if CHASSIS_EVENT_DRIVEN_LOOP
+				chassis_feedback_arrived(bMotorId);
+#endif
 				break;
 			}
 			case CAN_3508_M4_ID:
@@ -216,6 +245,9 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
         		bMotorId = MOTOR_INDEX_3508_M4;
 				decode_rm_motor_feedback(rx_data, bMotorId);
 				detect_hook(CHASSIS_MOTOR4_TOE);
+#if CHASSIS_EVENT_DRIVEN_LOOP
+				chassis_feedback_arrived(bMotorId);
+#endif
 				break;
 			}
 			case SUPCAP_RX_ID:
@@ -249,6 +281,9 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
         		bMotorId = MOTOR_INDEX_TRIGGER;
 				decode_rm_motor_feedback(rx_data, bMotorId);
 				detect_hook(TRIGGER_MOTOR_TOE);
+#if TRIGGER_JAM_PREDICTION
+				shoot_trigger_feedback(delay_get_cycle());
+#endif
 				break;
 			}
 #endif
@@ -288,6 +323,46 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 	}
 }
 
+#if CHASSIS_EVENT_DRIVEN_LOOP
+/**
+ * @brief          mark feedback of one chassis M3508 as received, wake up chassis task when all four are in
+ * @param[in]      bMotorId: MOTOR_INDEX_3508_M1 to MOTOR_INDEX_3508_M4
+ * @retval         none
+ */
+static void chassis_feedback_arrived(uint8_t bMotorId)
+{
+	chassis_feedback_rx_mask |= (1 << (bMotorId - MOTOR_INDEX_3508_M1));
+	if (chassis_feedback_rx_mask == CHASSIS_FEEDBACK_ALL_WHEELS)
+	{
+		chassis_feedback_rx_mask = 0;
+		chassis_feedback_cycle = delay_get_cycle();
+		if ((chassis_feedback_notify_task != NULL) && (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED))
+		{
+			BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+			vTaskNotifyGiveFromISR(chassis_feedback_notify_task, &xHigherPriorityTaskWoken);
+			portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+		}
+	}
+}
+#endif
+
+void CAN_chassis_feedback_notify_init(void)
+{
+#if CHASSIS_EVENT_DRIVEN_LOOP
+	chassis_feedback_rx_mask = 0;
+	chassis_feedback_notify_task = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+uint32_t CAN_get_chassis_feedback_cycle(void)
+{
+#if CHASSIS_EVENT_DRIVEN_LOOP
+	return chassis_feedback_cycle;
+#else
+	return 0;
+#endif
+}
+
 void decode_rm_motor_feedback(uint8_t *data, uint8_t bMotorId)
 {
 	uint16_t temp_ecd = (uint16_t)(data[0] << 8 | data[1]);
@@ -402,8 +477,21 @@ HAL_StatusTypeDef decode_4310_motor_feedback(uint8_t *data, uint8_t bMotorId)
 		uint16_t v_int = (data[3] << 4) | (data[4] >> 4);  // rad/s
 		uint16_t t_int = ((data[4] & 0xF) << 8) | data[5]; // Nm
 
+		fp32 last_output_angle = motor_chassis[bMotorId].output_angle;
 		motor_chassis[bMotorId].output_angle = uint_to_fp32_motor(p_int, MIT_CONTROL_P_MIN[DM_4310], MIT_CONTROL_P_MAX[DM_4310], 16);
-		motor_chassis[bMotorId].ecd = loop_fp32_constrain(motor_chassis[bMotorId].output_angle, 0, 2 * PI) * MOTOR_RAD_TO_ECD;
+		// the position jumps by the whole range when it wraps at +-12.5rad, about 4 turns minus 7.6deg: carry the remainder
+		// so ecd stays continuous on a yaw that spins through the slip ring
+		fp32 position_range = MIT_CONTROL_P_MAX[DM_4310] - MIT_CONTROL_P_MIN[DM_4310];
+		fp32 position_change = motor_chassis[bMotorId].output_angle - last_output_angle;
+		if (position_change < -0.5f * position_range)
+		{
+			motor_chassis[bMotorId].output_angle_wrap_offset = loop_fp32_constrain(motor_chassis[bMotorId].output_angle_wrap_offset + position_range, 0, 2 * PI);
+		}
+		else if (position_change > 0.5f * position_range)
+		{
+			motor_chassis[bMotorId].output_angle_wrap_offset = loop_fp32_constrain(motor_chassis[bMotorId].output_angle_wrap_offset - position_range, 0, 2 * PI);
+		}
+		motor_chassis[bMotorId].ecd = (uint16_t)(loop_fp32_constrain(motor_chassis[bMotorId].output_angle + motor_chassis[bMotorId].output_angle_wrap_offset, 0, 2 * PI) * MOTOR_RAD_TO_ECD) % ECD_RANGE;
 		motor_chassis[bMotorId].velocity = uint_to_fp32_motor(v_int, MIT_CONTROL_V_MIN[DM_4310], MIT_CONTROL_V_MAX[DM_4310], 12);
 		motor_chassis[bMotorId].torque = uint_to_fp32_motor(t_int, MIT_CONTROL_T_MIN[DM_4310], MIT_CONTROL_T_MAX[DM_4310], 12);
 		motor_chassis[bMotorId].temperate = data[6];
@@ -558,11 +646,23 @@ void CAN_cmd_biped_chassis_mode(void)
 
 uint8_t decode_biped_chassis_feedback(uint8_t *data)
 {
+#if BIPED_LINK_MULTI_FRAME
+	// only complete sets count for detect_task, full leg state in biped_link_data.state
+	uint8_t fDataValid = biped_link_receive(&biped_link_data, data);
+	if (fDataValid)
+	{
+		chassis_move.chassis_platform.feedback_yaw = biped_link_data.state.yaw;
+		chassis_move.chassis_platform.feedback_simplified_L0 = (biped_link_data.state.L0[BIPED_LEG_LEFT] + biped_link_data.state.L0[BIPED_LEG_RIGHT]) * 0.5f;
+		chassis_move.chassis_platform.feedback_roll = biped_link_data.state.roll;
+		chassis_move.chassis_platform.feedback_pitch = biped_link_data.state.pitch;
+	}
+#else
 	uint8_t fDataValid = 1;
 	chassis_move.chassis_platform.feedback_yaw = fp32_constrain((int16_t)((data[1] << 8) | data[0]) / biped_angle_encoding_ratio, -PI, PI);
 	chassis_move.chassis_platform.feedback_simplified_L0 = (int16_t)((data[3] << 8) | data[2]) / biped_meter_encoding_ratio;
 	chassis_move.chassis_platform.feedback_roll = (int16_t)((data[5] << 8) | data[4]) / biped_angle_encoding_ratio;
 	chassis_move.chassis_platform.feedback_pitch = (int16_t)((data[7] << 8) | data[6]) / biped_angle_encoding_ratio;
+#endif
 	return fDataValid;
 }
 #endif
@@ -694,6 +794,20 @@ void CAN_cmd_chassis_reset_ID(void)
 #endif
 }
 
+void CAN_cmd_supcap(void)
+{
+	uint32_t send_mail_box;
+	supcap_cmd_t supcap_cmd;
+	supercap_manager_command(&supcap_cmd);
+	chassis_tx_message.StdId = SUPCAP_TX_ID;
+	chassis_tx_message.IDE = CAN_ID_STD;
+	chassis_tx_message.RTR = CAN_RTR_DATA;
+	chassis_tx_message.DLC = 0x08;
+	memcpy(chassis_can_send_data, supcap_cmd.can_buf, sizeof(supcap_cmd.can_buf));
+
+	HAL_CAN_AddTxMessage(&CHASSIS_CAN, &chassis_tx_message, chassis_can_send_data, &send_mail_box);
+}
+
 #if (ROBOT_TYPE == SENTRY_2023_MECANUM)
 void CAN_cmd_upper_head(void)
 {
@@ -747,22 +861,43 @@ void CAN_cmd_upper_head(void)
 
 void CAN_cmd_chassis(void)
 {
+#if (ROBOT_TYPE == INFANTRY_2023_SWERVE) || (ROBOT_TYPE == SENTRY_2023_MECANUM)
+	// wheel current goes out every period; auxiliary frames are spread over different periods instead of
+	// waiting for free TX mailboxes with osDelay, which would stall the 1kHz chassis loop
+	static uint8_t bAuxFrameSlot = 0;
+	bAuxFrameSlot = (bAuxFrameSlot + 1) % CHASSIS_AUX_FRAME_DIVIDER;
+#endif
 #if (ROBOT_TYPE == INFANTRY_2023_SWERVE)
 	CAN_cmd_3508_chassis();
-	osDelay(1);
-	CAN_cmd_swerve_steer();
-	osDelay(1);
-	CAN_cmd_swerve_hip();
+	if (bAuxFrameSlot == 1)
+	{
+		CAN_cmd_swerve_steer();
+	}
+	else if (bAuxFrameSlot == 3)
+	{
+		CAN_cmd_swerve_hip();
+	}
 #elif (ROBOT_TYPE == SENTRY_2023_MECANUM)
 	CAN_cmd_3508_chassis();
-	osDelay(1);
-	CAN_cmd_upper_head();
+	if (bAuxFrameSlot == 1)
+	{
+		CAN_cmd_upper_head();
+	}
 #elif (ROBOT_TYPE == INFANTRY_2024_BIPED)
 	CAN_cmd_biped_chassis();
 	CAN_cmd_biped_chassis_mode();
 #else
 	CAN_cmd_3508_chassis();
 #endif
+
+#if SUPCAP_COMMAND_ENABLE && (ROBOT_TYPE != INFANTRY_2024_BIPED)
+	static uint8_t bSupcapFrameSlot = 0;
+	bSupcapFrameSlot = (bSupcapFrameSlot + 1) % SUPCAP_COMMAND_DIVIDER;
+	if (bSupcapFrameSlot == SUPCAP_COMMAND_SLOT)
+	{
+		CAN_cmd_supcap();
+	}
+#endif
 }
 
 /**
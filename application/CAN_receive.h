@@ -84,6 +84,7 @@ typedef enum
   CAN_6020_HIGH_RANGE_TX_ID = 0x2FF,
 
   SUPCAP_RX_ID = 0x301,
+  SUPCAP_TX_ID = 0x302,
 #if (ROBOT_TYPE == SENTRY_2023_MECANUM)
 	CAN_UPPER_HEAD_TX_ID = 0x110,
 #elif (ROBOT_TYPE == INFANTRY_2023_SWERVE)
@@ -119,6 +120,7 @@ typedef struct
     uint8_t temperate;
     int16_t last_ecd;
     fp32 output_angle; // rad
+    fp32 output_angle_wrap_offset; // rad, [0, 2PI): MIT position wraps at +-P_MAX, which isn't a whole number of turns
     fp32 velocity;     // rad/s
     fp32 torque;       // Nm
 } motor_measure_t;
@@ -160,6 +162,26 @@ extern void CAN_cmd_chassis_reset_ID(void);
   */
 extern void CAN_cmd_chassis(void);
 
+/**
+  * @brief          send power limits and mode of supercap_manager to the cap controller, frame layout in supcap_cmd_t,
+  *                 sent by CAN_cmd_chassis only with SUPCAP_COMMAND_ENABLE
+  * @retval         none
+  */
+extern void CAN_cmd_supcap(void);
+
+/**
+  * @brief          register calling task to be notified once feedback of all four chassis M3508 has arrived,
+  *                 only effective when CHASSIS_EVENT_DRIVEN_LOOP is set
+  * @retval         none
+  */
+extern void CAN_chassis_feedback_notify_init(void);
+
+/**
+  * @brief          cycle counter value (see delay_get_cycle) when the latest full set of chassis M3508 feedback arrived
+  * @retval         cycle count
+  */
+extern uint32_t CAN_get_chassis_feedback_cycle(void);
+
 #if (ROBOT_TYPE == INFANTRY_2023_SWERVE)
 #if USE_SERVO_TO_STIR_AMMO
 void CAN_cmd_load_servo(uint8_t fServoSwitch, uint8_t bTrialTimes);
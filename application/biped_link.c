@@ -0,0 +1,147 @@
+/**
+ * @file       biped_link.c/h
+ * @brief      Multi-frame CAN link to the biped lower board: full leg state in sequence-numbered frame sets
+ * @arthur     MacFalcons Control Team
+ */
+#include "biped_link.h"
+#include "stddef.h"
+
+typedef struct
+{
+    uint16_t offset; // of the fp32 in biped_leg_state_t
+    uint8_t frame;
+    uint8_t pos;  // first bit in the payload
+    uint8_t bits;
+    fp32 ratio;   // levels per unit, 2^(bits - 1) / limit
+    fp32 scale;   // unit per level
+} biped_link_field_t;
+
+#define BIPED_LINK_FIELD(member, frame, pos, bits, limit) \
+    {offsetof(biped_leg_state_t, member), (frame), (pos), (bits), (fp32)(1 << ((bits)-1)) / (limit), (limit) / (fp32)(1 << ((bits)-1))}
+
+// resolution in the comments, fields of one frame fit its 56 payload bits
+static const biped_link_field_t biped_link_fields[] = {
+    BIPED_LINK_FIELD(yaw, 0, 0, 16, BIPED_RAD_ECD_MAX_LIMIT),                     // 9.6e-5 rad
+    BIPED_LINK_FIELD(roll, 0, 16, 16, BIPED_TILT_RAD_ECD_MAX_LIMIT),              // 2.4e-5 rad
+    BIPED_LINK_FIELD(pitch, 0, 32, 16, BIPED_TILT_RAD_ECD_MAX_LIMIT),             // 2.4e-5 rad
+    BIPED_LINK_FIELD(L0[BIPED_LEG_LEFT], 1, 0, 16, BIPED_METER_ECD_MAX_LIMIT),    // 1.5e-5 m
+    BIPED_LINK_FIELD(L0[BIPED_LEG_RIGHT], 1, 16, 16, BIPED_METER_ECD_MAX_LIMIT),  // 1.5e-5 m
+};
+
+#define BIPED_LINK_FIELD_NUM (sizeof(biped_link_fields) / sizeof(biped_link_fields[0]))
+#define BIPED_LINK_ALL_FRAMES ((1 << BIPED_LINK_FRAME_NUM) - 1)
+// rx_mask after its set was published, later duplicates of that set are ignored
+#define BIPED_LINK_SET_PUBLISHED 0x80
+
+biped_link_t biped_link_data;
+
+void biped_link_resync(biped_link_t *link)
+{
+    link->fSynced = 0;
+    link->rx_mask = 0;
+}
+
+void biped_link_pack(const biped_leg_state_t *state, uint8_t frame_index, uint8_t seq, uint8_t data[8])
+{
+    uint64_t payload = 0;
+    for (uint8_t i = 0; i < BIPED_LINK_FIELD_NUM; i++)
+    {
+        const biped_link_field_t *field = &biped_link_fields[i];
+        if (field->frame != frame_index)
+        {
+            continue;
+        }
+        const int32_t level_max = (1 << (field->bits - 1)) - 1;
+        fp32 value = *(const fp32 *)((const uint8_t *)state + field->offset) * field->ratio;
+        int32_t level = (int32_t)(value + ((value >= 0.0f) ? 0.5f : -0.5f));
+        if (level > level_max)
+        {
+            level = level_max;
+        }
+        else if (level < -level_max - 1)
+        {
+            level = -level_max - 1;
+        }
+        payload |= ((uint64_t)level & ((1ULL << field->bits) - 1)) << field->pos;
+    }
+
+    data[0] = (frame_index & BIPED_LINK_FRAME_INDEX_MASK) | ((seq & BIPED_LINK_SEQ_MASK) << BIPED_LINK_SEQ_SHIFT);
+    for (uint8_t i = 1; i < 8; i++)
+    {
+        data[i] = (uint8_t)payload;
+        payload >>= 8;
+    }
+}
+
+uint8_t biped_link_unpack(const uint8_t data[8], biped_leg_state_t *state)
+{
+    uint8_t frame_index = data[0] & BIPED_LINK_FRAME_INDEX_MASK;
+    if (frame_index >= BIPED_LINK_FRAME_NUM)
+    {
+        return frame_index;
+    }
+
+    uint64_t payload = 0;
+    for (uint8_t i = 7; i >= 1; i--)
+    {
+        payload = (payload << 8) | data[i];
+    }
+    for (uint8_t i = 0; i < BIPED_LINK_FIELD_NUM; i++)
+    {
+        const biped_link_field_t *field = &biped_link_fields[i];
+        if (field->frame != frame_index)
+        {
+            continue;
+        }
+        int32_t level = (int32_t)((payload >> field->pos) & ((1ULL << field->bits) - 1));
+        // sign extend
+        if (level & (1 << (field->bits - 1)))
+        {
+            level -= (1 << field->bits);
+        }
+        *(fp32 *)((uint8_t *)state + field->offset) = level * field->scale;
+    }
+    return frame_index;
+}
+
+uint8_t biped_link_receive(biped_link_t *link, const uint8_t data[8])
+{
+    uint8_t seq = (data[0] >> BIPED_LINK_SEQ_SHIFT) & BIPED_LINK_SEQ_MASK;
+    if ((data[0] & BIPED_LINK_FRAME_INDEX_MASK) >= BIPED_LINK_FRAME_NUM)
+    {
+        link->bad_frames++;
+        return 0;
+    }
+
+    if (link->fSynced == 0)
+    {
+        link->fSynced = 1;
+        link->seq = seq;
+        link->rx_mask = 0;
+    }
+    else if (seq != link->seq)
+    {
+        if ((link->rx_mask != 0) && (link->rx_mask != BIPED_LINK_SET_PUBLISHED))
+        {
+            link->broken_sets++;
+        }
+        // sets in between never showed up; 6 bit sequence is 64 ms at 1 kHz, longer outages go through resync
+        link->lost_sets += ((seq - link->seq) & BIPED_LINK_SEQ_MASK) - 1;
+        link->seq = seq;
+        link->rx_mask = 0;
+    }
+    else if (link->rx_mask == BIPED_LINK_SET_PUBLISHED)
+    {
+        return 0;
+    }
+
+    link->rx_mask |= (1 << biped_link_unpack(data, &link->staging));
+    if (link->rx_mask == BIPED_LINK_ALL_FRAMES)
+    {
+        link->state = link->staging;
+        link->rx_mask = BIPED_LINK_SET_PUBLISHED;
+        link->complete_sets++;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file       biped_link.c/h
+ * @brief      Multi-frame CAN link to the biped lower board: leg state in sequence-numbered frame sets
+ * @arthur     MacFalcons Control Team
+ * The lower board sends one state set per control period (1 kHz) on CAN_BIPED_CONTROLLER_RX_ID, split into
+ * BIPED_LINK_FRAME_NUM frames. Byte 0 of every frame is the header: bits 0-1 frame index, bits 2-7 set sequence.
+ * Bytes 1-7 are a 56 bit little endian payload of bit fields, laid out by the scaling table in biped_link.c.
+ * Each field is signed, q = round(value * ratio) with ratio = 2^(bits - 1) / limit. At 16 bits the yaw field has the
+ * biped_angle_encoding_ratio of the single frame protocol; biped_meter_encoding_ratio is 2^16 / limit instead, so the
+ * single frame L0 has twice the resolution over half the range, where the L0 fields here cover the whole limit.
+ * The state carries what decode_biped_chassis_feedback hands to chassis_platform; a field the upper board has no use
+ * for doesn't go on the bus, add it to the table together with its consumer.
+ * Frames are decoded into a staging state, the state is published only when every frame of one sequence has arrived,
+ * so a consumer never sees fields of two different sets. Sequence gaps count whole sets lost, a sequence change
+ * before a set completes counts a broken set.
+ * Bus load: 2 frames of 8 bytes at 1 kHz, about 0.26 Mbit/s on the 1 Mbit/s chassis bus.
+ */
+#ifndef BIPED_LINK_H
+#define BIPED_LINK_H
+#include "global_inc.h"
+#include "AHRS_middleware.h"
+
+// 0: single frame protocol (yaw, L0, roll, pitch) of decode_biped_chassis_feedback
+// 1: multi-frame protocol of this file, the lower board has to be flashed with the same setting
+// @TODO: switch once the lower board firmware sends the multi-frame sets
+#define BIPED_LINK_MULTI_FRAME 0
+
+// field limits, command frames of CAN_cmd_biped_chassis use the first four as well
+#define BIPED_METER_PER_SEC_ECD_MAX_LIMIT 3.5f
+#define BIPED_METER_ECD_MAX_LIMIT 0.5f
+#define BIPED_RAD_ECD_MAX_LIMIT PI
+#define BIPED_RAD_PER_SEC_ECD_MAX_LIMIT 2.5f
+#define BIPED_TILT_RAD_ECD_MAX_LIMIT (PI / 4.0f)
+
+#define BIPED_LINK_FRAME_NUM 2
+#define BIPED_LINK_FRAME_INDEX_MASK 0x03
+#define BIPED_LINK_SEQ_SHIFT 2
+#define BIPED_LINK_SEQ_MASK 0x3F
+#define BIPED_LINK_PAYLOAD_BITS 56
+
+#define BIPED_LEG_LEFT 0
+#define BIPED_LEG_RIGHT 1
+
+typedef struct
+{
+    fp32 yaw;   // rad
+    fp32 roll;  // rad
+    fp32 pitch; // rad
+    fp32 L0[2]; // m, virtual leg length, BIPED_LEG_LEFT / BIPED_LEG_RIGHT
+} biped_leg_state_t;
+
+typedef struct
+{
+    biped_leg_state_t state;   // last complete set
+    biped_leg_state_t staging; // set being assembled
+    uint8_t seq;               // sequence of the set being assembled
+    uint8_t rx_mask;           // bit i: frame i of seq received
+    uint8_t fSynced;           // 0 until the first frame, and after biped_link_resync
+    uint32_t complete_sets;
+    uint32_t lost_sets;   // sets of which no frame arrived
+    uint32_t broken_sets; // sets of which some frames arrived
+    uint32_t bad_frames;  // invalid frame index
+} biped_link_t;
+
+extern biped_link_t biped_link_data;
+
+/**
+  * @brief          reset sequence tracking, call when the link was offline so the next sequence isn't counted as a gap
+  * @param[out]     link: link
+  * @retval         none
+  */
+extern void biped_link_resync(biped_link_t *link);
+
+/**
+  * @brief          encode one frame of a state set, used by the lower board and host tests
+  * @param[in]      state: leg state, values beyond the field limits are saturated
+  * @param[in]      frame_index: 0 to BIPED_LINK_FRAME_NUM - 1
+  * @param[in]      seq: set sequence, only the low 6 bits are sent
+  * @param[out]     data: 8 byte CAN payload
+  * @retval         none
+  */
+extern void biped_link_pack(const biped_leg_state_t *state, uint8_t frame_index, uint8_t seq, uint8_t data[8]);
+
+/**
+  * @brief          decode one frame into state, fields of other frames are untouched
+  * @param[in]      data: 8 byte CAN payload
+  * @param[out]     state: leg state
+  * @retval         frame index, BIPED_LINK_FRAME_NUM or above if invalid
+  */
+extern uint8_t biped_link_unpack(const uint8_t data[8], biped_leg_state_t *state);
+
+/**
+  * @brief          feed one received frame, publish link->state when its set is complete
+  * @param[out]     link: link
+  * @param[in]      data: 8 byte CAN payload
+  * @retval         1 when a complete set was published
+  */
+extern uint8_t biped_link_receive(biped_link_t *link, const uint8_t data[8]);
+
+#endif
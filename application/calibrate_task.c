@@ -21,6 +21,8 @@
   *             third:hold for 2 seconds, two joysticks set to ./\., begin the gyro calibration
   *                     or set to '\/', begin the gimbal calibration
   *                     or set to /''\, begin the chassis calibration
+  *                     or set to ././, begin the system identification of "sysid_target" (only when SYSID_ENABLE)
+  *                     or set to /'/', begin the pid auto-tune of "pid_autotune_loop"
   *
   *             data in flash, include cali data and name[3] and cali_flag
   *             for example, head_cali has 8 bytes, and it need 12 bytes in flash. if it starts in 0x080A0000
@@ -68,10 +70,17 @@
 #include "remote_control.h"
 #include "INS_task.h"
 #include "gimbal_task.h"
+#include "chassis_task.h"
+#include "shoot.h"
+#include "detect_task.h"
+#if (SYSID_ENABLE || SPECTRUM_ENABLE)
+#include "usb_task.h"
+#include "user_lib.h"
+#endif
 
 
-//include head,gimbal,gyro,accel,mag. gyro,accel and mag have the same data struct. total 5(CALI_LIST_LENGTH) devices, need data length + 5 * 4 bytes(name[3]+cali)
-#define FLASH_WRITE_BUF_LENGTH  (sizeof(head_cali_t) + sizeof(gimbal_cali_t) + sizeof(imu_cali_t) * 3  + CALI_LIST_LENGTH * 4)
+//include head,gimbal,gyro,accel,mag,pid auto-tune. gyro,accel and mag have the same data struct. total 6(CALI_LIST_LENGTH) devices, need data length + 6 * 4 bytes(name[3]+cali)
+#define FLASH_WRITE_BUF_LENGTH  (sizeof(head_cali_t) + sizeof(gimbal_cali_t) + sizeof(imu_cali_t) * 3 + sizeof(pid_autotune_cali_t) + CALI_LIST_LENGTH * 4)
 
 
 
@@ -131,6 +140,25 @@ static bool_t cali_gyro_hook(uint32_t *cali, bool_t cmd);   //gyro device cali f
   */
 static bool_t cali_gimbal_hook(uint32_t *cali, bool_t cmd); //gimbal device cali function
 
+/**
+  * @brief          pid auto-tune function
+  * @param[in][out] cali:the point to pid auto-tune data, when cmd == CALI_FUNC_CMD_INIT, param is [in],cmd == CALI_FUNC_CMD_ON, param is [out]
+  * @param[in]      cmd: 
+                    CALI_FUNC_CMD_INIT: means to use cali data to initialize original data
+                    CALI_FUNC_CMD_ON: means need to calibrate
+  * @retval         0:means cali task has not been done
+                    1:means cali task has been done
+  */
+static bool_t cali_pid_autotune_hook(uint32_t *cali, bool_t cmd); //pid auto-tune function
+
+#if SYSID_ENABLE
+/**
+  * @brief          fit models of the finished system identification record, called by calibrate task
+  * @param[in]      none
+  * @retval         none
+  */
+static void sysid_fit(void);
+#endif
 
 
 #if INCLUDE_uxTaskGetStackHighWaterMark
@@ -144,30 +172,73 @@ static gimbal_cali_t   gimbal_cali;     //gimbal cali data
 static imu_cali_t      accel_cali;      //accel cali data
 static imu_cali_t      gyro_cali;       //gyro cali data
 static imu_cali_t      mag_cali;        //mag cali data
+static pid_autotune_cali_t pid_autotune_cali; //pid auto-tune data
 
 
 static uint8_t flash_write_buf[FLASH_WRITE_BUF_LENGTH];
 
 cali_sensor_t cali_sensor[CALI_LIST_LENGTH]; 
 
-static const uint8_t cali_name[CALI_LIST_LENGTH][3] = {"HD", "GM", "GYR", "ACC", "MAG"};
+static const uint8_t cali_name[CALI_LIST_LENGTH][3] = {"HD", "GM", "GYR", "ACC", "MAG", "PID"};
 
 //cali data address
 static uint32_t *cali_sensor_buf[CALI_LIST_LENGTH] = {
         (uint32_t *)&head_cali, (uint32_t *)&gimbal_cali,
         (uint32_t *)&gyro_cali, (uint32_t *)&accel_cali,
-        (uint32_t *)&mag_cali};
+        (uint32_t *)&mag_cali, (uint32_t *)&pid_autotune_cali};
 
 
 static uint8_t cali_sensor_size[CALI_LIST_LENGTH] =
     {
         sizeof(head_cali_t) / 4, sizeof(gimbal_cali_t) / 4,
-        sizeof(imu_cali_t) / 4, sizeof(imu_cali_t) / 4, sizeof(imu_cali_t) / 4};
+        sizeof(imu_cali_t) / 4, sizeof(imu_cali_t) / 4, sizeof(imu_cali_t) / 4,
+        sizeof(pid_autotune_cali_t) / 4};
 
-void *cali_hook_fun[CALI_LIST_LENGTH] = {cali_head_hook, cali_gimbal_hook, cali_gyro_hook, NULL, NULL};
+void *cali_hook_fun[CALI_LIST_LENGTH] = {cali_head_hook, cali_gimbal_hook, cali_gyro_hook, NULL, NULL, cali_pid_autotune_hook};
 
 static uint32_t calibrate_systemTick;
 
+typedef struct
+{
+    fp32 set;               // set point the relay oscillates around
+    fp32 relay_amplitude;
+    fp32 hysteresis;
+    fp32 max_out;
+    fp32 max_error;
+    uint8_t rule;           // pid_autotune_rule_e
+    fp32 dt;                // period of the task running the loop
+    uint8_t motor_toe;
+} pid_autotune_loop_config_t;
+
+//in the order of pid_autotune_loop_e, friction uses the set point of friction 1 in shoot.c
+static const pid_autotune_loop_config_t pid_autotune_loop_config[PID_AUTOTUNE_LOOP_LIST_LENGTH] = {
+    {PID_AUTOTUNE_WHEEL_SET, PID_AUTOTUNE_WHEEL_RELAY, PID_AUTOTUNE_WHEEL_HYSTERESIS, MAX_3508_MOTOR_CAN_CURRENT, PID_AUTOTUNE_WHEEL_MAX_ERROR, PID_AUTOTUNE_RULE_ZN_PI, CHASSIS_CONTROL_TIME_S, CHASSIS_MOTOR1_TOE},
+    {0.0f, PID_AUTOTUNE_YAW_RELAY, PID_AUTOTUNE_GIMBAL_HYSTERESIS, YAW_SPEED_PID_MAX_OUT, PID_AUTOTUNE_GIMBAL_MAX_ERROR, PID_AUTOTUNE_RULE_TL_PI, GIMBAL_CONTROL_TIME_S, YAW_GIMBAL_MOTOR_TOE},
+    {0.0f, PID_AUTOTUNE_PITCH_RELAY, PID_AUTOTUNE_GIMBAL_HYSTERESIS, PITCH_SPEED_PID_MAX_OUT, PID_AUTOTUNE_GIMBAL_MAX_ERROR, PID_AUTOTUNE_RULE_TL_PI, GIMBAL_CONTROL_TIME_S, PITCH_GIMBAL_MOTOR_TOE},
+    {-FRICTION_MOTOR_SPEED * FRICTION_MOTOR_SPEED_TO_RPM, PID_AUTOTUNE_FRICTION_RELAY, PID_AUTOTUNE_FRICTION_HYSTERESIS, FRICTION_1_SPEED_PID_MAX_OUT, PID_AUTOTUNE_FRICTION_MAX_ERROR, PID_AUTOTUNE_RULE_TL_PI, SHOOT_CONTROL_TIME_S, FRIC1_MOTOR_TOE},
+};
+
+// loop tuned by remote control, can be changed by debugger before triggering
+pid_autotune_loop_e pid_autotune_loop = PID_AUTOTUNE_DEFAULT_LOOP;
+pid_autotune_t pid_autotune;
+static pid_autotune_loop_e pid_autotune_running_loop;
+static volatile uint8_t fPidAutotuneArmed = 0; // set by calibrate task, relay starts once the control task sees it
+
+#if SYSID_ENABLE
+sysid_t sysid;
+// target and excitation started by remote control, can be changed by debugger before triggering
+sysid_target_e sysid_target = SYSID_DEFAULT_TARGET;
+sysid_excitation_e sysid_excitation_type = SYSID_DEFAULT_EXCITATION;
+#endif
+
+#if SPECTRUM_ENABLE
+spectrum_analyzer_t spectrum_analyzer;
+// recorded by gimbal task, can be changed by debugger
+spectrum_source_e spectrum_source = SPECTRUM_DEFAULT_SOURCE;
+static spectrum_source_e spectrum_averaged_source;
+static uint16_t spectrum_usb_dump_cursor = 0;
+#endif
+
 
 /**
   * @brief          calibrate task, created by main function
@@ -179,12 +250,33 @@ void calibrate_task(void const *pvParameters)
     static uint8_t i = 0;
     
     calibrate_RC = get_remote_ctrl_point_cali();
+#if SPECTRUM_ENABLE
+    spectrum_averaged_source = spectrum_source;
+    spectrum_analyzer_init(&spectrum_analyzer, 1.0f / GIMBAL_CONTROL_TIME_S, SPECTRUM_AVERAGE_COEFF);
+#endif
 
     while (1)
     {
 
         RC_cmd_to_calibrate();
 
+#if SYSID_ENABLE
+        if (sysid.state == SYSID_FITTING)
+        {
+            sysid_fit();
+        }
+#endif
+
+#if SPECTRUM_ENABLE
+        if (spectrum_source != spectrum_averaged_source)
+        {
+            // a different signal, the average starts over
+            spectrum_averaged_source = spectrum_source;
+            spectrum_analyzer_init(&spectrum_analyzer, 1.0f / GIMBAL_CONTROL_TIME_S, SPECTRUM_AVERAGE_COEFF);
+        }
+        spectrum_analyzer_calc(&spectrum_analyzer);
+#endif
+
         for (i = 0; i < CALI_LIST_LENGTH; i++)
         {
             if (cali_sensor[i].cali_cmd)
@@ -261,6 +353,10 @@ static void RC_cmd_to_calibrate(void)
     static const uint8_t GIMBAL_FLAG  = 2;
     static const uint8_t GYRO_FLAG    = 3;
     static const uint8_t CHASSIS_FLAG = 4;
+#if SYSID_ENABLE
+    static const uint8_t SYSID_FLAG   = 5;
+#endif
+    static const uint8_t PID_AUTOTUNE_FLAG = 6;
 
     static uint8_t  i;
     static uint32_t rc_cmd_systemTick = 0;
@@ -280,6 +376,16 @@ static void RC_cmd_to_calibrate(void)
             return;
         }
     }
+#if SYSID_ENABLE
+    if ((sysid.state == SYSID_RUNNING) || (sysid.state == SYSID_FITTING))
+    {
+        buzzer_time = 0;
+        rc_cmd_time = 0;
+        rc_action_flag = 0;
+
+        return;
+    }
+#endif
 
     if (rc_action_flag == 0 && rc_cmd_time > RC_CMD_LONG_TIME)
     {
@@ -319,6 +425,22 @@ static void RC_cmd_to_calibrate(void)
         CAN_cmd_chassis_reset_ID();
         cali_buzzer_off();
     }
+#if SYSID_ENABLE
+    else if (rc_action_flag == SYSID_FLAG && rc_cmd_time > RC_CMD_LONG_TIME)
+    {
+        rc_action_flag = 0;
+        rc_cmd_time = 0;
+        sysid_start(sysid_target, sysid_excitation_type);
+        cali_buzzer_off();
+    }
+#endif
+    else if (rc_action_flag == PID_AUTOTUNE_FLAG && rc_cmd_time > RC_CMD_LONG_TIME)
+    {
+        rc_action_flag = 0;
+        rc_cmd_time = 0;
+        cali_sensor[CALI_PID_AUTOTUNE].cali_cmd = 1;
+        cali_buzzer_off();
+    }
 
     if (calibrate_RC->rc.ch[0] < -RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[1] < -RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[2] > RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[3] < -RC_CALI_VALUE_HOLE && switch_is_down(calibrate_RC->rc.s[0]) && switch_is_down(calibrate_RC->rc.s[1]) && rc_action_flag == 0)
     {
@@ -343,6 +465,20 @@ static void RC_cmd_to_calibrate(void)
         rc_cmd_time++;
         rc_action_flag = CHASSIS_FLAG;
     }
+#if SYSID_ENABLE
+    else if (calibrate_RC->rc.ch[0] < -RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[1] < -RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[2] < -RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[3] < -RC_CALI_VALUE_HOLE && switch_is_down(calibrate_RC->rc.s[0]) && switch_is_down(calibrate_RC->rc.s[1]) && rc_action_flag != 0)
+    {
+        //two joystick set to //, hold for 2 seconds
+        rc_cmd_time++;
+        rc_action_flag = SYSID_FLAG;
+    }
+#endif
+    else if (calibrate_RC->rc.ch[0] > RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[1] > RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[2] > RC_CALI_VALUE_HOLE && calibrate_RC->rc.ch[3] > RC_CALI_VALUE_HOLE && switch_is_down(calibrate_RC->rc.s[0]) && switch_is_down(calibrate_RC->rc.s[1]) && rc_action_flag != 0)
+    {
+        //two joystick set to /'/', hold for 2 seconds
+        rc_cmd_time++;
+        rc_action_flag = PID_AUTOTUNE_FLAG;
+    }
     else
     {
         rc_cmd_time = 0;
@@ -398,6 +534,13 @@ void cali_param_init(void)
 
     cali_data_read();
 
+    // pid auto-tune only starts by remote control, and flash content of a never tuned device must not be used as gains
+    if (cali_sensor[CALI_PID_AUTOTUNE].cali_done != CALIED_FLAG)
+    {
+        cali_sensor[CALI_PID_AUTOTUNE].cali_cmd = 0;
+        memset(&pid_autotune_cali, 0, sizeof(pid_autotune_cali_t));
+    }
+
     for (i = 0; i < CALI_LIST_LENGTH; i++)
     {
         if (cali_sensor[i].cali_done == CALIED_FLAG)
@@ -595,3 +738,413 @@ static bool_t cali_gimbal_hook(uint32_t *cali, bool_t cmd)
     
     return 0;
 }
+
+/**
+  * @brief          pid auto-tune function
+  * @param[in][out] cali:the point to pid auto-tune data, when cmd == CALI_FUNC_CMD_INIT, param is [in],cmd == CALI_FUNC_CMD_ON, param is [out]
+  * @param[in]      cmd: 
+                    CALI_FUNC_CMD_INIT: means to use cali data to initialize original data
+                    CALI_FUNC_CMD_ON: means need to calibrate
+  * @retval         0:means cali task has not been done
+                    1:means cali task has been done
+  */
+static bool_t cali_pid_autotune_hook(uint32_t *cali, bool_t cmd)
+{
+    pid_autotune_cali_t *local_cali_t = (pid_autotune_cali_t *)cali;
+    if (cmd == CALI_FUNC_CMD_INIT)
+    {
+        // gains are pulled by pid_autotune_load_gains after each task initializes its pid
+        return 0;
+    }
+    else if (cmd == CALI_FUNC_CMD_ON)
+    {
+        if (fPidAutotuneArmed == 0)
+        {
+            const pid_autotune_loop_config_t *config = &pid_autotune_loop_config[pid_autotune_loop];
+            pid_autotune_running_loop = pid_autotune_loop;
+            PID_autotune_init(&pid_autotune, config->relay_amplitude, config->hysteresis, config->max_out, config->max_error, config->rule, PID_AUTOTUNE_TIMEOUT, config->dt);
+            fPidAutotuneArmed = 1;
+        }
+
+        if (pid_autotune.state == PID_AUTOTUNE_DONE)
+        {
+            local_cali_t->gains[pid_autotune_running_loop][0] = pid_autotune.gains[0];
+            local_cali_t->gains[pid_autotune_running_loop][1] = pid_autotune.gains[1];
+            local_cali_t->gains[pid_autotune_running_loop][2] = pid_autotune.gains[2];
+            local_cali_t->tuned_mask |= (1 << pid_autotune_running_loop);
+            fPidAutotuneArmed = 0;
+            PID_autotune_clear(&pid_autotune);
+
+            // apply to the running controllers
+            switch (pid_autotune_running_loop)
+            {
+                case PID_AUTOTUNE_WHEEL_SPEED:
+                {
+#if (ROBOT_TYPE != INFANTRY_2024_BIPED)
+                    for (uint8_t i = 0; i < 4; i++)
+                    {
+                        pid_autotune_load_gains(PID_AUTOTUNE_WHEEL_SPEED, &chassis_move.motor_speed_pid[i]);
+                    }
+#endif
+                    break;
+                }
+                case PID_AUTOTUNE_YAW_RATE:
+                {
+                    pid_autotune_load_gains(PID_AUTOTUNE_YAW_RATE, &gimbal_control.gimbal_yaw_motor.gimbal_motor_speed_pid);
+                    break;
+                }
+                case PID_AUTOTUNE_PITCH_RATE:
+                {
+                    pid_autotune_load_gains(PID_AUTOTUNE_PITCH_RATE, &gimbal_control.gimbal_pitch_motor.gimbal_motor_speed_pid);
+                    break;
+                }
+                case PID_AUTOTUNE_FRICTION_SPEED:
+                default:
+                {
+                    pid_autotune_load_gains(PID_AUTOTUNE_FRICTION_SPEED, &shoot_control.friction_motor1_pid);
+                    pid_autotune_load_gains(PID_AUTOTUNE_FRICTION_SPEED, &shoot_control.friction_motor2_pid);
+                    break;
+                }
+            }
+            cali_buzzer_off();
+
+            return 1;
+        }
+        else if (pid_autotune.state == PID_AUTOTUNE_FAILED)
+        {
+            // give up without touching flash
+            fPidAutotuneArmed = 0;
+            PID_autotune_clear(&pid_autotune);
+            cali_sensor[CALI_PID_AUTOTUNE].cali_cmd = 0;
+            cali_buzzer_off();
+
+            return 0;
+        }
+        else
+        {
+            gimbal_start_buzzer();
+
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+/**
+  * @brief          load auto-tuned gains into the pid if the loop has been tuned, call after PID_init
+  * @param[in]      loop: pid_autotune_loop_e
+  * @param[out]     pid: PID struct data point
+  * @retval         none
+  */
+void pid_autotune_load_gains(pid_autotune_loop_e loop, pid_type_def *pid)
+{
+    if ((pid == NULL) || (loop >= PID_AUTOTUNE_LOOP_LIST_LENGTH) || ((pid_autotune_cali.tuned_mask & (1 << loop)) == 0))
+    {
+        return;
+    }
+    pid->Kp = pid_autotune_cali.gains[loop][0];
+    pid->Ki = pid_autotune_cali.gains[loop][1];
+    pid->Kd = pid_autotune_cali.gains[loop][2];
+    // integral term of the old gains is meaningless under the new ones
+    pid->Iout = 0.0f;
+}
+
+/**
+  * @brief          called by the control task owning the loop, right after the pid output is calculated. Replaces the
+  *                 pid output by the relay output while the loop is being tuned
+  * @param[in]      loop: pid_autotune_loop_e
+  * @param[in]      fdb: loop feedback, same unit as the pid feedback
+  * @param[in][out] cmd: pid output, replaced by relay output if running
+  * @retval         1: command has been replaced, 0: untouched
+  */
+bool_t pid_autotune_override_cmd(pid_autotune_loop_e loop, fp32 fdb, fp32 *cmd)
+{
+    if ((cmd == NULL) || (fPidAutotuneArmed == 0) || (pid_autotune_running_loop != loop))
+    {
+        return 0;
+    }
+
+    bool_t fSafe = !(toe_is_error(DBUS_TOE) || toe_is_error(pid_autotune_loop_config[loop].motor_toe));
+    bool_t fUnderControl = 1;
+    if (loop == PID_AUTOTUNE_PITCH_RATE)
+    {
+        const gimbal_motor_t *pitch_motor = &gimbal_control.gimbal_pitch_motor;
+        fUnderControl = (pitch_motor->gimbal_motor_mode != GIMBAL_MOTOR_RAW);
+        fSafe = fSafe && (pitch_motor->relative_angle < pitch_motor->max_relative_angle) && (pitch_motor->relative_angle > pitch_motor->min_relative_angle);
+    }
+    else if (loop == PID_AUTOTUNE_YAW_RATE)
+    {
+        const gimbal_motor_t *yaw_motor = &gimbal_control.gimbal_yaw_motor;
+        fUnderControl = (yaw_motor->gimbal_motor_mode != GIMBAL_MOTOR_RAW);
+#if !ROBOT_YAW_HAS_SLIP_RING
+        fSafe = fSafe && (yaw_motor->relative_angle < yaw_motor->max_relative_angle) && (yaw_motor->relative_angle > yaw_motor->min_relative_angle);
+#endif
+    }
+
+    if (pid_autotune.state == PID_AUTOTUNE_IDLE)
+    {
+        if ((fSafe == 0) || (fUnderControl == 0))
+        {
+            return 0;
+        }
+        // current controller output holds the load (e.g. gravity of pitch), start relay around it
+        PID_autotune_start(&pid_autotune, *cmd);
+    }
+    else if (pid_autotune.state != PID_AUTOTUNE_RUNNING)
+    {
+        return 0;
+    }
+
+    if (fSafe == 0)
+    {
+        pid_autotune.state = PID_AUTOTUNE_FAILED;
+        return 0;
+    }
+
+    fp32 relay_out = PID_autotune_calc(&pid_autotune, fdb, pid_autotune_loop_config[loop].set);
+    if (pid_autotune.state != PID_AUTOTUNE_RUNNING)
+    {
+        // finished in this cycle, keep the controller output
+        return 0;
+    }
+    *cmd = relay_out;
+    return 1;
+}
+
+#if SYSID_ENABLE
+/**
+  * @brief          start system identification of one motor, ignored if another one is running
+  * @param[in]      target: motor to identify
+  * @param[in]      excitation_type: SYSID_EXCITATION_CHIRP or SYSID_EXCITATION_PRBS
+  * @retval         1: started, 0: busy
+  */
+bool_t sysid_start(sysid_target_e target, sysid_excitation_e excitation_type)
+{
+    fp32 amplitude;
+
+    if ((sysid.state == SYSID_RUNNING) || (sysid.state == SYSID_FITTING) || (target >= SYSID_TARGET_LIST_LENGTH))
+    {
+        return 0;
+    }
+
+    switch (target)
+    {
+        case SYSID_TARGET_YAW:
+        {
+            amplitude = SYSID_YAW_AMPLITUDE;
+            sysid.dt = GIMBAL_CONTROL_TIME_S;
+            break;
+        }
+        case SYSID_TARGET_PITCH:
+        {
+            amplitude = SYSID_PITCH_AMPLITUDE;
+            sysid.dt = GIMBAL_CONTROL_TIME_S;
+            break;
+        }
+        case SYSID_TARGET_WHEEL:
+        {
+            amplitude = SYSID_WHEEL_AMPLITUDE;
+            sysid.dt = CHASSIS_CONTROL_TIME_S;
+            break;
+        }
+        case SYSID_TARGET_TRIGGER:
+        default:
+        {
+            amplitude = SYSID_TRIGGER_AMPLITUDE;
+            sysid.dt = GIMBAL_CONTROL_TIME_S;
+            break;
+        }
+    }
+
+    if (excitation_type == SYSID_EXCITATION_PRBS)
+    {
+        sysid_prbs_init(&sysid.excitation, amplitude, SYSID_PRBS_HOLD, SYSID_RECORD_LENGTH * sysid.dt, sysid.dt);
+    }
+    else
+    {
+        sysid_chirp_init(&sysid.excitation, amplitude, SYSID_CHIRP_F_START, SYSID_CHIRP_F_END, SYSID_RECORD_LENGTH * sysid.dt, sysid.dt);
+    }
+    sysid.target = target;
+    sysid.record_len = 0;
+    sysid.usb_dump_cursor = 0;
+    sysid.fFirstOrderValid = 0;
+    sysid.fSecondOrderValid = 0;
+    // set state last, control tasks start injecting once they see RUNNING
+    sysid.state = SYSID_RUNNING;
+    return 1;
+}
+
+/**
+  * @brief          called by the control task owning the motor, right after the controller output and before its safety
+  *                 checks. Replaces the command by excitation and records the response while identification of this
+  *                 motor is running
+  * @param[in]      target: motor the caller is about to command
+  * @param[in][out] cmd: motor command, replaced by excitation if running
+  * @retval         1: command has been replaced, 0: untouched
+  */
+bool_t sysid_override_cmd(sysid_target_e target, fp32 *cmd)
+{
+    const motor_measure_t *motor_measure;
+    uint8_t motor_toe;
+    fp32 speed;
+
+    if ((cmd == NULL) || (sysid.state != SYSID_RUNNING) || (sysid.target != target))
+    {
+        return 0;
+    }
+
+    switch (target)
+    {
+        case SYSID_TARGET_YAW:
+        {
+            motor_measure = get_yaw_gimbal_motor_measure_point();
+            motor_toe = YAW_GIMBAL_MOTOR_TOE;
+            break;
+        }
+        case SYSID_TARGET_PITCH:
+        {
+            motor_measure = get_pitch_gimbal_motor_measure_point();
+            motor_toe = PITCH_GIMBAL_MOTOR_TOE;
+            break;
+        }
+        case SYSID_TARGET_WHEEL:
+        {
+            motor_measure = get_chassis_motor_measure_point(MOTOR_INDEX_3508_M1);
+            motor_toe = CHASSIS_MOTOR1_TOE;
+            break;
+        }
+        case SYSID_TARGET_TRIGGER:
+        default:
+        {
+            motor_measure = &motor_chassis[MOTOR_INDEX_TRIGGER];
+            motor_toe = TRIGGER_MOTOR_TOE;
+            break;
+        }
+    }
+
+    // abort and give control back when the operator or the motor is lost
+    if (toe_is_error(DBUS_TOE) || toe_is_error(motor_toe))
+    {
+        sysid.state = SYSID_FAILED;
+        return 0;
+    }
+
+#if ROBOT_YAW_IS_4310
+    if (target == SYSID_TARGET_YAW)
+    {
+        speed = motor_measure->velocity;
+    }
+    else
+#endif
+    {
+        speed = RPM_TO_RADS((fp32)motor_measure->speed_rpm);
+    }
+    // gimbal commands are taken in the controller's direction, gimbal_safety_manager turns them to the motor's
+#if YAW_TURN
+    if (target == SYSID_TARGET_YAW)
+    {
+        speed = -speed;
+    }
+#endif
+#if PITCH_TURN
+    if (target == SYSID_TARGET_PITCH)
+    {
+        speed = -speed;
+    }
+#endif
+
+    fp32 excitation_out;
+    if ((sysid.record_len >= SYSID_RECORD_LENGTH) || (sysid_excitation_calc(&sysid.excitation, &excitation_out) == 0))
+    {
+        *cmd = 0.0f;
+        sysid.state = SYSID_FITTING;
+        return 1;
+    }
+    sysid.u[sysid.record_len] = excitation_out;
+    sysid.y[sysid.record_len] = speed;
+    sysid.record_len++;
+    *cmd = excitation_out;
+    return 1;
+}
+
+/**
+  * @brief          fit models of the finished system identification record, called by calibrate task
+  * @param[in]      none
+  * @retval         none
+  */
+static void sysid_fit(void)
+{
+    sysid.fFirstOrderValid = sysid_fit_first_order(sysid.u, sysid.y, sysid.record_len, SYSID_MAX_DELAY, sysid.dt, &sysid.first_order);
+    sysid.fSecondOrderValid = sysid_fit_second_order(sysid.u, sysid.y, sysid.record_len, SYSID_MAX_DELAY, sysid.dt, &sysid.second_order);
+    sysid.usb_dump_cursor = 0;
+    sysid.state = (sysid.fFirstOrderValid || sysid.fSecondOrderValid) ? SYSID_DONE : SYSID_FAILED;
+}
+
+/**
+  * @brief          print identification result and record through usb, a few lines per call, called by usb task
+  * @param[in]      none
+  * @retval         none
+  */
+void sysid_usb_dump(void)
+{
+    // one line per call, cdc drops the frame if the previous one is still in transfer
+    static const uint16_t SYSID_DUMP_HEADER_LINES = 3;
+
+    if ((sysid.state != SYSID_DONE) && (sysid.state != SYSID_FAILED))
+    {
+        return;
+    }
+    if (sysid.usb_dump_cursor == 0)
+    {
+        usb_printf("sysid target %d state %d dt %f len %d\r\n", sysid.target, sysid.state, sysid.dt, sysid.record_len);
+    }
+    else if (sysid.usb_dump_cursor == 1)
+    {
+        usb_printf("order1 valid %d J %f B %f delay %d residual %f\r\n", sysid.fFirstOrderValid, sysid.first_order.inertia, sysid.first_order.damping, sysid.first_order.delay, sysid.first_order.fit_residual);
+    }
+    else if (sysid.usb_dump_cursor == 2)
+    {
+        usb_printf("order2 valid %d wn %f zeta %f dc %f delay %d residual %f\r\n", sysid.fSecondOrderValid, sysid.second_order.natural_freq, sysid.second_order.damping_ratio, sysid.second_order.dc_gain, sysid.second_order.delay, sysid.second_order.fit_residual);
+    }
+    else if (sysid.usb_dump_cursor < sysid.record_len + SYSID_DUMP_HEADER_LINES)
+    {
+        // raw record as csv: index, command, speed(rad/s)
+        uint16_t index = sysid.usb_dump_cursor - SYSID_DUMP_HEADER_LINES;
+        usb_printf("%d,%f,%f\r\n", index, sysid.u[index], sysid.y[index]);
+    }
+    else
+    {
+        return;
+    }
+    sysid.usb_dump_cursor++;
+}
+#endif
+
+#if SPECTRUM_ENABLE
+/**
+  * @brief          print spectrum peaks and bins through usb, one line per call, called by usb task
+  * @param[in]      none
+  * @retval         none
+  */
+void spectrum_usb_dump(void)
+{
+    if (spectrum_analyzer.block_count == 0)
+    {
+        return;
+    }
+    if (spectrum_usb_dump_cursor == 0)
+    {
+        usb_printf("spectrum source %d blocks %d peaks %f Hz %f, %f Hz %f, %f Hz %f\r\n", spectrum_averaged_source, spectrum_analyzer.block_count,
+                   spectrum_analyzer.peak_freq[0], spectrum_analyzer.peak_amplitude[0], spectrum_analyzer.peak_freq[1], spectrum_analyzer.peak_amplitude[1],
+                   spectrum_analyzer.peak_freq[2], spectrum_analyzer.peak_amplitude[2]);
+    }
+    else
+    {
+        // averaged spectrum as csv: bin, frequency(Hz), amplitude
+        uint16_t bin = spectrum_usb_dump_cursor - 1;
+        usb_printf("%d,%f,%f\r\n", bin, bin * spectrum_analyzer.sample_rate_hz / SPECTRUM_FFT_LENGTH, spectrum_analyzer.amplitude[bin]);
+    }
+    spectrum_usb_dump_cursor = (spectrum_usb_dump_cursor < SPECTRUM_BIN_COUNT) ? (spectrum_usb_dump_cursor + 1) : 0;
+}
+#endif
@@ -21,6 +21,8 @@
   *             third:hold for 2 seconds, two joysticks set to ./\., begin the gyro calibration
   *                     or set to '\/', begin the gimbal calibration
   *                     or set to /''\, begin the chassis calibration
+  *                     or set to ././, begin the system identification of "sysid_target" (only when SYSID_ENABLE)
+  *                     or set to /'/', begin the pid auto-tune of "pid_autotune_loop"
   *
   *             data in flash, include cali data and name[3] and cali_flag
   *             for example, head_cali has 8 bytes, and it need 12 bytes in flash. if it starts in 0x080A0000
@@ -60,6 +62,10 @@
 #define CALIBRATE_TASK_H
 
 #include "global_inc.h"
+#include "system_identification.h"
+#include "spectrum_analyzer.h"
+#include "pid.h"
+#include "pid_autotune.h"
 
 //when imu is calibrating, buzzer set frequency and strength.
 #define imu_start_buzzer()          buzzer_on(95, 10000)    
@@ -120,6 +126,64 @@
 
 #define GYRO_CALIBRATE_TIME         20000   //gyro calibrate time
 
+// System identification: inject chirp/PRBS excitation to one motor, record command and speed, fit first/second order models.
+// Bench use only: lift the chassis off the ground and keep gimbal travel clear before triggering.
+// Excitation overrides the control output of gimbal and chassis tasks, so it also works in zero force mode.
+#define SYSID_ENABLE 0
+
+#if SYSID_ENABLE
+#define SYSID_RECORD_LENGTH         1024    // record buffer, 4.1s for gimbal motors, 1.0s for chassis motors
+#define SYSID_MAX_DELAY             5       // unit: sample
+#define SYSID_CHIRP_F_START         0.5f    // Hz
+#define SYSID_CHIRP_F_END           40.0f   // Hz, below nyquist frequency of the 4ms gimbal loop
+#define SYSID_PRBS_HOLD             3       // samples per PRBS bit
+
+#define SYSID_DEFAULT_TARGET        SYSID_TARGET_YAW
+#define SYSID_DEFAULT_EXCITATION    SYSID_EXCITATION_CHIRP
+
+#if ROBOT_YAW_IS_4310
+#define SYSID_YAW_AMPLITUDE         1.0f    // Nm
+#else
+#define SYSID_YAW_AMPLITUDE         5000.0f
+#endif
+#define SYSID_PITCH_AMPLITUDE       3000.0f
+#define SYSID_WHEEL_AMPLITUDE       3000.0f
+#define SYSID_TRIGGER_AMPLITUDE     2000.0f
+#endif
+
+// Spectrum capture: averaged amplitude spectrum of one gimbal signal at the gimbal loop rate and its peaks, printed
+// through usb, to locate the resonances the biquad tables in gimbal_task.h should notch.
+// Records continuously while enabled; "spectrum_source" can be changed by debugger at any time, which restarts the average.
+#define SPECTRUM_ENABLE 0
+
+#if SPECTRUM_ENABLE
+#define SPECTRUM_DEFAULT_SOURCE     SPECTRUM_SOURCE_PITCH_GYRO
+#define SPECTRUM_AVERAGE_COEFF      0.2f    // weight of the newest 2s block
+#endif
+
+// PID auto-tune: relay feedback on one speed loop, gains are stored in flash and override the PID macros at boot.
+// Bench use only: lift the chassis off the ground. Gimbal loops start once the gimbal is under control (not zero force).
+#define PID_AUTOTUNE_DEFAULT_LOOP           PID_AUTOTUNE_WHEEL_SPEED
+#define PID_AUTOTUNE_TIMEOUT                20.0f   // s
+
+#define PID_AUTOTUNE_WHEEL_SET              0.5f    // m/s
+#define PID_AUTOTUNE_WHEEL_RELAY            2000.0f
+#define PID_AUTOTUNE_WHEEL_HYSTERESIS       0.03f   // m/s
+#define PID_AUTOTUNE_WHEEL_MAX_ERROR        3.0f    // m/s
+
+#if ROBOT_YAW_IS_4310
+#define PID_AUTOTUNE_YAW_RELAY              0.5f    // Nm
+#else
+#define PID_AUTOTUNE_YAW_RELAY              3000.0f
+#endif
+#define PID_AUTOTUNE_PITCH_RELAY            2000.0f
+#define PID_AUTOTUNE_GIMBAL_HYSTERESIS      0.08f   // rad/s, above imu gyro noise
+#define PID_AUTOTUNE_GIMBAL_MAX_ERROR       10.0f   // rad/s
+
+#define PID_AUTOTUNE_FRICTION_RELAY         1000.0f
+#define PID_AUTOTUNE_FRICTION_HYSTERESIS    40.0f   // rpm
+#define PID_AUTOTUNE_FRICTION_MAX_ERROR     (FRICTION_MOTOR_SPEED * FRICTION_MOTOR_SPEED_TO_RPM + 2000.0f) // rpm, tuning starts from standstill
+
 //cali device name
 typedef enum
 {
@@ -128,6 +192,7 @@ typedef enum
     CALI_GYRO = 2,
     CALI_ACC = 3,
     CALI_MAG = 4,
+    CALI_PID_AUTOTUNE = 5,
     //add more...
     CALI_LIST_LENGTH,
 } cali_id_e;
@@ -169,6 +234,79 @@ typedef struct
     fp32 scale[3];  //x,y,z
 } imu_cali_t;
 
+//loops that can be auto-tuned
+typedef enum
+{
+    PID_AUTOTUNE_WHEEL_SPEED = 0,   // chassis motor speed, relay on motor 1, gains go to all wheels
+    PID_AUTOTUNE_YAW_RATE,          // gimbal yaw speed loop
+    PID_AUTOTUNE_PITCH_RATE,        // gimbal pitch speed loop
+    PID_AUTOTUNE_FRICTION_SPEED,    // friction wheel speed, relay on friction 1, gains go to both friction wheels
+    PID_AUTOTUNE_LOOP_LIST_LENGTH,
+} pid_autotune_loop_e;
+
+//pid auto-tune device
+typedef struct
+{
+    fp32 gains[PID_AUTOTUNE_LOOP_LIST_LENGTH][3]; //kp, ki, kd
+    uint32_t tuned_mask;                          //bit n set: gains[n] is valid
+} pid_autotune_cali_t;
+
+#if SYSID_ENABLE
+typedef enum
+{
+    SYSID_TARGET_YAW = 0,
+    SYSID_TARGET_PITCH,
+    SYSID_TARGET_WHEEL, // chassis motor 1
+    SYSID_TARGET_TRIGGER,
+    SYSID_TARGET_LIST_LENGTH,
+} sysid_target_e;
+
+typedef enum
+{
+    SYSID_IDLE = 0,
+    SYSID_RUNNING,  // excitation injected and recorded by the control task owning the motor
+    SYSID_FITTING,  // record full, waiting for calibrate task to fit
+    SYSID_DONE,
+    SYSID_FAILED,
+} sysid_state_e;
+
+typedef struct
+{
+    sysid_target_e target;
+    volatile sysid_state_e state;
+    sysid_excitation_t excitation;
+    fp32 dt;
+    uint16_t record_len;
+    fp32 u[SYSID_RECORD_LENGTH]; // command, unit of motor command
+    fp32 y[SYSID_RECORD_LENGTH]; // speed, rad/s
+    sysid_first_order_t first_order;
+    sysid_second_order_t second_order;
+    bool_t fFirstOrderValid;
+    bool_t fSecondOrderValid;
+    uint16_t usb_dump_cursor;
+} sysid_t;
+
+extern sysid_t sysid;
+extern sysid_target_e sysid_target;
+extern sysid_excitation_e sysid_excitation_type;
+#endif
+
+#if SPECTRUM_ENABLE
+typedef enum
+{
+    SPECTRUM_SOURCE_YAW_GYRO = 0,       // speed loop feedback before the gyro filter, rad/s
+    SPECTRUM_SOURCE_PITCH_GYRO,
+    SPECTRUM_SOURCE_YAW_GYRO_FILTERED,  // after the gyro filter, to check the notches
+    SPECTRUM_SOURCE_PITCH_GYRO_FILTERED,
+    SPECTRUM_SOURCE_YAW_CMD,            // motor command after the command filter
+    SPECTRUM_SOURCE_PITCH_CMD,
+    SPECTRUM_SOURCE_LIST_LENGTH,
+} spectrum_source_e;
+
+extern spectrum_analyzer_t spectrum_analyzer;
+extern spectrum_source_e spectrum_source;
+#endif
+
 
 /**
   * @brief          use remote control to begin a calibrate,such as gyro, gimbal, chassis
@@ -197,5 +335,59 @@ extern void get_flash_latitude(float *latitude);
   */
 extern void calibrate_task(void const *pvParameters);
 
+/**
+  * @brief          load auto-tuned gains into the pid if the loop has been tuned, call after PID_init
+  * @param[in]      loop: pid_autotune_loop_e
+  * @param[out]     pid: PID struct data point
+  * @retval         none
+  */
+extern void pid_autotune_load_gains(pid_autotune_loop_e loop, pid_type_def *pid);
+
+/**
+  * @brief          called by the control task owning the loop, right after the pid output is calculated. Replaces the
+  *                 pid output by the relay output while the loop is being tuned
+  * @param[in]      loop: pid_autotune_loop_e
+  * @param[in]      fdb: loop feedback, same unit as the pid feedback
+  * @param[in][out] cmd: pid output, replaced by relay output if running
+  * @retval         1: command has been replaced, 0: untouched
+  */
+extern bool_t pid_autotune_override_cmd(pid_autotune_loop_e loop, fp32 fdb, fp32 *cmd);
+
+#if SYSID_ENABLE
+/**
+  * @brief          start system identification of one motor, ignored if another one is running
+  * @param[in]      target: motor to identify
+  * @param[in]      excitation_type: SYSID_EXCITATION_CHIRP or SYSID_EXCITATION_PRBS
+  * @retval         1: started, 0: busy
+  */
+extern bool_t sysid_start(sysid_target_e target, sysid_excitation_e excitation_type);
+
+/**
+  * @brief          called by the control task owning the motor, right after the controller output and before its safety
+  *                 checks. Replaces the command by excitation and records the response while identification of this
+  *                 motor is running
+  * @param[in]      target: motor the caller is about to command
+  * @param[in][out] cmd: motor command, replaced by excitation if running
+  * @retval         1: command has been replaced, 0: untouched
+  */
+extern bool_t sysid_override_cmd(sysid_target_e target, fp32 *cmd);
+
+/**
+  * @brief          print identification result and record through usb, a few lines per call, called by usb task
+  * @param[in]      none
+  * @retval         none
+  */
+extern void sysid_usb_dump(void);
+#endif
+
+#if SPECTRUM_ENABLE
+/**
+  * @brief          print spectrum peaks and bins through usb, one line per call, called by usb task
+  * @param[in]      none
+  * @retval         none
+  */
+extern void spectrum_usb_dump(void);
+#endif
+
 
 #endif
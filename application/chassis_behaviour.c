@@ -24,12 +24,13 @@
 #include "gimbal_behaviour.h"
 
 // random spin mode parameters
-#define MIN_SPIN_PARAM_CHANGE_PERIOD 1.0f
-#define NORMAL_SPIN_PARAM_CHANGE_PERIOD 5.0f
-#define DELTA_SPIN_PARAM_CHANGE_PERIOD 2.0f
-#define MIN_SPIN_SPEED_CHANGE_PERIOD 250.0f
-#define MID_SPIN_SPEED_CHANGE_PERIOD 1000.0f
-#define DELTA_SPIN_SPEED_CHANGE_PERIOD (MID_SPIN_SPEED_CHANGE_PERIOD / 2.0f)
+// targets alternate between the low and the high band of the speed range, so every change is as large as the range
+// allows and a constant speed aim predictor misses the most; each speed is held for the time the power limited
+// set-point shaping needs to reach it plus a random dwell, so the chassis isn't accelerating all the time
+#define RANDOM_SPIN_BAND_RATIO 0.35f
+#define RANDOM_SPIN_MIN_DWELL_MS 100.0f
+#define RANDOM_SPIN_MID_DWELL_MS 400.0f
+#define RANDOM_SPIN_DELTA_DWELL_MS (RANDOM_SPIN_MID_DWELL_MS / 2.0f)
 
 #define MOUSE_SCROLL_TO_DIAL_SEN_INC -(JOYSTICK_HALF_RANGE / MOUSE_X_EFFECTIVE_SPEED * 30)
 #define MOUSE_SCROLL_FILTER_COEFF 0.6f
@@ -324,9 +325,9 @@ static void chassis_zero_force_control(fp32 *vx_can_set, fp32 *vy_can_set, fp32
 	*vx_can_set = 0;
 	*vy_can_set = 0;
 	*wz_can_set = 0;
-	chassis_move.chassis_cmd_slow_set_vx.out = 0;
-	chassis_move.chassis_cmd_slow_set_vy.out = 0;
-	chassis_move.chassis_cmd_slow_set_wz.out = 0;
+	s_curve_ramp_reset(&chassis_move.chassis_cmd_slow_set_vx, 0.0f);
+	s_curve_ramp_reset(&chassis_move.chassis_cmd_slow_set_vy, 0.0f);
+	s_curve_ramp_reset(&chassis_move.chassis_cmd_slow_set_wz, 0.0f);
 }
 
 /**
@@ -409,40 +410,40 @@ void chassis_spinning_speed_manager(fp32* wz_set)
 	{
 		// Dial changes: range of possible speed and interval to change speed; positive dial value more rapid, negative less rapid
 		static uint32_t ulLastUpdateTime = 0;
-		static fp32 random_wz_max_speed = SPINNING_CHASSIS_MED_OMEGA;
-		static fp32 random_wz_min_speed = SPINNING_CHASSIS_LOW_OMEGA;
-		static uint8_t param_change_counter = 0;
-		static uint32_t speed_change_period = MID_SPIN_SPEED_CHANGE_PERIOD;
-		static uint8_t param_change_period = NORMAL_SPIN_PARAM_CHANGE_PERIOD;
+		static uint32_t speed_change_period = 0;
+		static uint8_t fHighBand = 0;
 		static fp32 spinning_sign = 1;
 		fp32 dial_ratio = chassis_move.dial_channel_out / JOYSTICK_HALF_RANGE;
 
-		// once per speed_change_period, update spinning speed to a random number in between random_wz_min_speed and random_wz_max_speed
 		if (osKernelSysTick() - ulLastUpdateTime >= speed_change_period)
 		{
-			spinning_speed = spinning_sign * RNG_get_random_range_fp32(random_wz_min_speed, random_wz_max_speed);
-			ulLastUpdateTime = osKernelSysTick();
-			param_change_counter++;
-
-			// change the speed changing period after certain number of changes
-			if (param_change_counter >= param_change_period)
+			// range follows the power level through wz_max_speed, the dial moves its top
+			fp32 random_wz_min_speed = chassis_get_low_wz_limit();
+			fp32 random_wz_param_a = ((chassis_move.wz_max_speed - random_wz_min_speed) / 2.0f);
+			fp32 random_wz_param_b = ((chassis_move.wz_max_speed + random_wz_min_speed) / 2.0f);
+			fp32 random_wz_max_speed = fmaxf(random_wz_param_a * (-dial_ratio) + random_wz_param_b, random_wz_min_speed);
+			fp32 band = (random_wz_max_speed - random_wz_min_speed) * RANDOM_SPIN_BAND_RATIO;
+			fp32 next_speed;
+			fHighBand = !fHighBand;
+			if (fHighBand)
 			{
-				// calc random_wz_max_speed
-				random_wz_min_speed = chassis_get_med_wz_limit();
-				fp32 random_wz_param_a = ((chassis_move.wz_max_speed - random_wz_min_speed) / 2.0f);
-				fp32 random_wz_param_b = ((chassis_move.wz_max_speed + random_wz_min_speed) / 2.0f);
-				random_wz_max_speed = random_wz_param_a * (-dial_ratio) + random_wz_param_b;
-
-				// change direction
-				//spinning_sign = RNG_get_random_range_int32(0, 1) ? -1 : 1;
+				next_speed = RNG_get_random_range_fp32(random_wz_max_speed - band, random_wz_max_speed);
+			}
+			else
+			{
+				next_speed = RNG_get_random_range_fp32(random_wz_min_speed, random_wz_min_speed + band);
+			}
 
-				// calc periods
-				param_change_period = RNG_get_random_range_int32(MIN_SPIN_PARAM_CHANGE_PERIOD, roundf(NORMAL_SPIN_PARAM_CHANGE_PERIOD + dial_ratio * DELTA_SPIN_PARAM_CHANGE_PERIOD));
-				fp32 param_change_period_max = MID_SPIN_SPEED_CHANGE_PERIOD + dial_ratio * DELTA_SPIN_SPEED_CHANGE_PERIOD;
-				speed_change_period = RNG_get_random_range_fp32(MIN_SPIN_SPEED_CHANGE_PERIOD, param_change_period_max);
+			// change direction
+			//spinning_sign = RNG_get_random_range_int32(0, 1) ? -1 : 1;
 
-				param_change_counter = 0;
-			}
+			// time chassis_cmd_shape takes for the change at the power limited acceleration, jerk phases included
+			fp32 wz_accel_max = chassis_move.accel_max / chassis_move.wheel_rot_radii[0];
+			fp32 ramp_time_ms = (fabsf(next_speed - fabsf(spinning_speed)) / wz_accel_max + CHASSIS_CMD_JERK_TIME_S) * 1000.0f;
+			fp32 dwell_max = RANDOM_SPIN_MID_DWELL_MS + dial_ratio * RANDOM_SPIN_DELTA_DWELL_MS;
+			speed_change_period = ramp_time_ms + RNG_get_random_range_fp32(RANDOM_SPIN_MIN_DWELL_MS, dwell_max);
+			spinning_speed = spinning_sign * next_speed;
+			ulLastUpdateTime = osKernelSysTick();
 		}
 	}
 	else
@@ -0,0 +1,185 @@
+/**
+ * @file       chassis_odometry.c/h
+ * @brief      Chassis velocity and 2D pose estimator fusing wheel kinematics with INS gyro and accelerometer
+ * @arthur     MacFalcons Control Team
+ */
+#include "chassis_odometry.h"
+#include "chassis_task.h"
+#include "swerve_kinematics.h"
+#include "INS_task.h"
+#include "AHRS_middleware.h"
+#include "user_lib.h"
+#include "math.h"
+
+chassis_odometry_t chassis_odometry_data;
+
+#if CHASSIS_ODOMETRY_ACTIVE
+static void odometry_axis_reset(chassis_odometry_axis_t *axis);
+static void odometry_axis_predict(chassis_odometry_axis_t *axis, fp32 accel, fp32 dt);
+static void odometry_axis_update(chassis_odometry_axis_t *axis, fp32 wheel_v, fp32 wheel_std);
+#endif
+
+void chassis_odometry_init(void)
+{
+    chassis_odometry_data.INS_quat = get_INS_quat_point();
+    chassis_odometry_data.INS_accel = get_accel_data_point();
+#if CHASSIS_ODOMETRY_ACTIVE
+    odometry_axis_reset(&chassis_odometry_data.axis[0]);
+    odometry_axis_reset(&chassis_odometry_data.axis[1]);
+#endif
+    chassis_odometry_data.accel_x = 0.0f;
+    chassis_odometry_data.accel_y = 0.0f;
+    chassis_odometry_data.vx = 0.0f;
+    chassis_odometry_data.vy = 0.0f;
+    chassis_odometry_data.wz = 0.0f;
+    chassis_odometry_data.wz_gyro_offset = 0.0f;
+    chassis_odometry_data.fWheelSlip = 0;
+    chassis_odometry_reset_pose();
+}
+
+void chassis_odometry_reset_pose(void)
+{
+    chassis_odometry_data.x = 0.0f;
+    chassis_odometry_data.y = 0.0f;
+    chassis_odometry_data.yaw = 0.0f;
+    // chassis_yaw may not be valid yet, origin is taken on the next update
+    chassis_odometry_data.fPoseResetPending = 1;
+}
+
+void chassis_odometry_update(void)
+{
+#if CHASSIS_ODOMETRY_ACTIVE
+    chassis_odometry_t *odom = &chassis_odometry_data;
+    const fp32 *q = odom->INS_quat;
+    const fp32 *a = odom->INS_accel;
+
+    // INS acceleration to navigation frame; gravity is along z there, horizontal components need no compensation
+    fp32 accel_nav_x = (1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3])) * a[0] + 2.0f * (q[1] * q[2] - q[0] * q[3]) * a[1] + 2.0f * (q[1] * q[3] + q[0] * q[2]) * a[2];
+    fp32 accel_nav_y = 2.0f * (q[1] * q[2] + q[0] * q[3]) * a[0] + (1.0f - 2.0f * (q[1] * q[1] + q[3] * q[3])) * a[1] + 2.0f * (q[2] * q[3] - q[0] * q[1]) * a[2];
+
+    // chassis heading in navigation frame is INS yaw minus gimbal relative yaw
+    fp32 cos_yaw = AHRS_cosf(chassis_move.chassis_yaw);
+    fp32 sin_yaw = AHRS_sinf(chassis_move.chassis_yaw);
+
+    // wheel kinematics from chassis_feedback_update; a single slipping wheel shows up in the kinematic residual
+#if ROBOT_CHASSIS_USE_MECANUM
+    fp32 residual = chassis_move.motor_chassis[0].speed - chassis_move.motor_chassis[1].speed + chassis_move.motor_chassis[2].speed - chassis_move.motor_chassis[3].speed;
+#else
+    fp32 residual = swerve_kinematics_data.residual;
+#endif
+    fp32 wheel_nav_x = cos_yaw * chassis_move.vx - sin_yaw * chassis_move.vy;
+    fp32 wheel_nav_y = sin_yaw * chassis_move.vx + cos_yaw * chassis_move.vy;
+
+    odometry_axis_predict(&odom->axis[0], accel_nav_x, chassis_loop_timing.dt);
+    odometry_axis_predict(&odom->axis[1], accel_nav_y, chassis_loop_timing.dt);
+
+    // all wheels spinning together: the wheel velocity runs away from the prediction
+    fp32 disagreement = sqrtf((wheel_nav_x - odom->axis[0].v) * (wheel_nav_x - odom->axis[0].v) + (wheel_nav_y - odom->axis[1].v) * (wheel_nav_y - odom->axis[1].v));
+    if (disagreement > ODOM_SLIP_SPEED)
+    {
+        odom->fWheelSlip = 1;
+    }
+    else if (disagreement < 0.5f * ODOM_SLIP_SPEED)
+    {
+        odom->fWheelSlip = 0;
+    }
+    fp32 wheel_std = (odom->fWheelSlip ? ODOM_SLIP_WHEEL_STD : ODOM_WHEEL_SPEED_STD) + 0.25f * fabsf(residual);
+    odometry_axis_update(&odom->axis[0], wheel_nav_x, wheel_std);
+    odometry_axis_update(&odom->axis[1], wheel_nav_y, wheel_std);
+
+    accel_nav_x -= odom->axis[0].bias;
+    accel_nav_y -= odom->axis[1].bias;
+    odom->accel_x = cos_yaw * accel_nav_x + sin_yaw * accel_nav_y;
+    odom->accel_y = -sin_yaw * accel_nav_x + cos_yaw * accel_nav_y;
+    odom->vx = cos_yaw * odom->axis[0].v + sin_yaw * odom->axis[1].v;
+    odom->vy = -sin_yaw * odom->axis[0].v + cos_yaw * odom->axis[1].v;
+
+    // yaw rate: gyro has no slip but the yaw motor speed is coarse (1rpm), so low pass its difference to wheel yaw rate
+#if YAW_TURN
+    fp32 relative_yaw_rate = -RPM_TO_RADS((fp32)chassis_move.chassis_yaw_motor->gimbal_motor_measure->speed_rpm);
+#else
+    fp32 relative_yaw_rate = RPM_TO_RADS((fp32)chassis_move.chassis_yaw_motor->gimbal_motor_measure->speed_rpm);
+#endif
+    fp32 wz_gyro = chassis_move.chassis_yaw_motor->motor_gyro - relative_yaw_rate;
+    odom->wz_gyro_offset += (wz_gyro - chassis_move.wz - odom->wz_gyro_offset) * chassis_loop_timing.dt / ODOM_WZ_GYRO_TRUST_TIME_S;
+    odom->wz = chassis_move.wz + odom->wz_gyro_offset;
+
+    // heading comes from INS directly, only position is integrated
+    if (odom->fPoseResetPending)
+    {
+        odom->yaw_origin = chassis_move.chassis_yaw;
+        odom->fPoseResetPending = 0;
+    }
+    odom->yaw = rad_format(chassis_move.chassis_yaw - odom->yaw_origin);
+    fp32 cos_odom_yaw = AHRS_cosf(odom->yaw);
+    fp32 sin_odom_yaw = AHRS_sinf(odom->yaw);
+    odom->x += (cos_odom_yaw * odom->vx - sin_odom_yaw * odom->vy) * chassis_loop_timing.dt;
+    odom->y += (sin_odom_yaw * odom->vx + cos_odom_yaw * odom->vy) * chassis_loop_timing.dt;
+#endif
+}
+
+const chassis_odometry_t *get_chassis_odometry_point(void)
+{
+    return &chassis_odometry_data;
+}
+
+#if CHASSIS_ODOMETRY_ACTIVE
+/**
+  * @brief          reset one axis filter to zero velocity and zero bias
+  * @param[out]     axis: axis filter point
+  * @retval         none
+  */
+static void odometry_axis_reset(chassis_odometry_axis_t *axis)
+{
+    axis->v = 0.0f;
+    axis->bias = 0.0f;
+    axis->innovation = 0.0f;
+    axis->P[0][0] = ODOM_WHEEL_SPEED_STD * ODOM_WHEEL_SPEED_STD;
+    axis->P[0][1] = 0.0f;
+    axis->P[1][0] = 0.0f;
+    axis->P[1][1] = ODOM_ACCEL_BIAS_INIT_STD * ODOM_ACCEL_BIAS_INIT_STD;
+}
+
+/**
+  * @brief          kalman prediction, v += (accel - bias) * dt
+  * @param[out]     axis: axis filter point
+  * @param[in]      accel: measured acceleration, m/s^2
+  * @param[in]      dt: time step, s
+  * @retval         none
+  */
+static void odometry_axis_predict(chassis_odometry_axis_t *axis, fp32 accel, fp32 dt)
+{
+    axis->v += (accel - axis->bias) * dt;
+    // P = F * P * F' + Q, F = [1 -dt; 0 1]
+    fp32 p11 = axis->P[1][1];
+    axis->P[0][0] += -dt * (axis->P[0][1] + axis->P[1][0]) + dt * dt * p11 + (ODOM_ACCEL_NOISE_STD * dt) * (ODOM_ACCEL_NOISE_STD * dt);
+    axis->P[0][1] -= dt * p11;
+    axis->P[1][0] -= dt * p11;
+    axis->P[1][1] += ODOM_ACCEL_BIAS_WALK_STD * ODOM_ACCEL_BIAS_WALK_STD * dt;
+}
+
+/**
+  * @brief          kalman update with wheel velocity, bias bounded to ODOM_ACCEL_BIAS_MAX
+  * @param[out]     axis: axis filter point
+  * @param[in]      wheel_v: velocity from wheel kinematics, m/s
+  * @param[in]      wheel_std: standard deviation of wheel_v, m/s
+  * @retval         none
+  */
+static void odometry_axis_update(chassis_odometry_axis_t *axis, fp32 wheel_v, fp32 wheel_std)
+{
+    fp32 y = wheel_v - axis->v;
+    fp32 s = axis->P[0][0] + wheel_std * wheel_std;
+    fp32 k0 = axis->P[0][0] / s;
+    fp32 k1 = axis->P[1][0] / s;
+    axis->innovation = y;
+    axis->v += k0 * y;
+    axis->bias = fp32_constrain(axis->bias + k1 * y, -ODOM_ACCEL_BIAS_MAX, ODOM_ACCEL_BIAS_MAX);
+    // P = (I - K * H) * P, H = [1 0]
+    fp32 p00 = axis->P[0][0];
+    fp32 p01 = axis->P[0][1];
+    axis->P[0][0] -= k0 * p00;
+    axis->P[0][1] -= k0 * p01;
+    axis->P[1][0] -= k1 * p00;
+    axis->P[1][1] -= k1 * p01;
+}
+#endif
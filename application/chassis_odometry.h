@@ -0,0 +1,93 @@
+/**
+ * @file       chassis_odometry.c/h
+ * @brief      Chassis velocity and 2D pose estimator fusing wheel kinematics with INS gyro and accelerometer
+ * @arthur     MacFalcons Control Team
+ * Velocity is estimated in the navigation frame (INS frame, z up), one Kalman filter per horizontal axis with state
+ * (velocity, accelerometer bias): INS acceleration drives the prediction, velocity from wheel kinematics is the
+ * measurement. Most of the horizontal accelerometer bias comes from attitude error times gravity, which is fixed in the
+ * navigation frame, so the bias is estimated there instead of in the spinning chassis frame.
+ * Wheel measurement noise grows with the kinematic residual (one wheel slipping): the mecanum redundant direction, or
+ * the swerve least-squares residual. All four wheels spinning together leave no residual, but make the wheel velocity
+ * run away from the prediction: above ODOM_SLIP_SPEED the wheels are treated as slipping and barely trusted until they
+ * agree again. The bias is bounded to what an attitude error can produce, so a slow slip can't be learned as bias either.
+ * Yaw rate is gimbal yaw rate from the gyro minus yaw motor speed, blended with wheel yaw rate; heading is chassis_yaw.
+ * Pose is integrated in the odometry frame, which is the chassis pose at the last chassis_odometry_reset_pose.
+ */
+#ifndef CHASSIS_ODOMETRY_H
+#define CHASSIS_ODOMETRY_H
+#include "global_inc.h"
+
+#define CHASSIS_ODOMETRY_ENABLE 1
+// needs wheel kinematics: mecanum, or swerve through swerve_kinematics
+#define CHASSIS_ODOMETRY_ACTIVE (CHASSIS_ODOMETRY_ENABLE && (ROBOT_CHASSIS_USE_MECANUM || (ROBOT_TYPE == INFANTRY_2023_SWERVE)))
+
+// process noise
+#define ODOM_ACCEL_NOISE_STD 0.3f         // m/s^2, accelerometer noise and chassis vibration
+#define ODOM_ACCEL_BIAS_WALK_STD 0.02f    // m/s^2 per sqrt(s)
+#define ODOM_ACCEL_BIAS_INIT_STD 0.2f     // m/s^2
+#define ODOM_ACCEL_BIAS_MAX 0.3f          // m/s^2, about 1.7 degrees of attitude error
+// wheel velocity measurement noise, m/s: ODOM_WHEEL_SPEED_STD (or ODOM_SLIP_WHEEL_STD) + 0.25 * |kinematic residual|
+#define ODOM_WHEEL_SPEED_STD 0.02f
+#define ODOM_SLIP_WHEEL_STD 1.0f
+// wheels slipping when they disagree with the prediction by more than this, back to normal below half of it
+#define ODOM_SLIP_SPEED 0.1f              // m/s
+// yaw rate: low pass time constant of gyro yaw rate minus wheel yaw rate
+#define ODOM_WZ_GYRO_TRUST_TIME_S 0.05f
+
+typedef struct
+{
+    fp32 v;           // m/s, navigation frame
+    fp32 bias;        // m/s^2, accelerometer bias in navigation frame
+    fp32 P[2][2];
+    fp32 innovation;  // m/s, last wheel velocity minus predicted velocity
+} chassis_odometry_axis_t;
+
+typedef struct
+{
+    const fp32 *INS_quat;
+    const fp32 *INS_accel;
+
+    chassis_odometry_axis_t axis[2]; // navigation frame x, y
+
+    fp32 accel_x;    // m/s^2, chassis frame, gravity and bias removed
+    fp32 accel_y;
+    fp32 vx;         // m/s, chassis frame, same convention as chassis_move.vx
+    fp32 vy;
+    fp32 wz;         // rad/s, positive counterclockwise
+    fp32 wz_gyro_offset; // rad/s, low passed gyro yaw rate minus wheel yaw rate
+    uint8_t fWheelSlip;
+
+    fp32 x;          // m, odometry frame
+    fp32 y;
+    fp32 yaw;        // rad, odometry frame, [-PI, PI]
+    fp32 yaw_origin; // chassis_yaw at pose reset
+    uint8_t fPoseResetPending;
+} chassis_odometry_t;
+
+extern chassis_odometry_t chassis_odometry_data;
+
+/**
+  * @brief          odometry init, velocity and bias reset, pose reset on the next update
+  * @retval         none
+  */
+extern void chassis_odometry_init(void);
+
+/**
+  * @brief          make the current chassis pose the origin of the odometry frame
+  * @retval         none
+  */
+extern void chassis_odometry_reset_pose(void);
+
+/**
+  * @brief          run one estimator step, call in chassis_feedback_update after wheel speeds and chassis_yaw are updated
+  * @retval         none
+  */
+extern void chassis_odometry_update(void);
+
+/**
+  * @brief          get odometry data point, for cv and chassis power control
+  * @retval         odometry data point
+  */
+extern const chassis_odometry_t *get_chassis_odometry_point(void);
+
+#endif
@@ -2,12 +2,12 @@
   ****************************(C) COPYRIGHT 2019 DJI****************************
   * @file       chassis_power_control.c/h
   * @brief      chassis power control
-  * @note       this is only controling 80w power, mainly limit motor current set.
-  *             if power limit is 40w, reduce the value JUDGE_TOTAL_CURRENT_LIMIT 
-  *             and POWER_CURRENT_LIMIT, and chassis max speed (including max_vx_speed, min_vx_speed)
+  * @note       limit the command current of the four drive motors with a per-wheel power model,
+  *             see chassis_power_control.h for the model
   * @history
   *  Version    Date            Author          Modification
   *  V1.0.0     Nov-11-2019     RM              1. add chassis power control
+  *  V2.0.0     2024            MacFalcons      1. predictive power model with buffer and supercap budget
   *
   @verbatim
   ==============================================================================
@@ -21,106 +21,219 @@
 #include "arm_math.h"
 #include "detect_task.h"
 #include "chassis_task.h"
+#include "user_lib.h"
 
-// #define WARNING_POWER_RATIO 0.7f
-// #define POWER_BUFF_TOTAL 60.0f
-// #if (ROBOT_TYPE == INFANTRY_2023_SWERVE)
-// #define WARNING_POWER_BUFF (POWER_BUFF_TOTAL / 2.0f)
-// #else
-// #define WARNING_POWER_BUFF (POWER_BUFF_TOTAL / 3.0f)
-// #endif
-// #define NO_JUDGE_TOTAL_CURRENT_LIMIT (MAX_3508_MOTOR_CAN_CURRENT * 4.0f)
-
-// #define M3508_CURRENT_TO_POWER_RATIO 0.025f // power is approx 25V * 1/1000 mA
-// #define M3508_CURRENT_TO_POWER(_current) ((_current) * M3508_CURRENT_TO_POWER_RATIO)
-// #define M3508_POWER_TO_CURRENT(_power) ((_power) / M3508_CURRENT_TO_POWER_RATIO)
-// // assumption of time that power stay unchanged despite command changes
-// #define M3508_POWER_CONTROL_DELAY_S (0.1f)
-// #define M3508_POWER_CONTROL_SHRINKED_DELAY_S (M3508_POWER_CONTROL_DELAY_S / 2.0f)
-// #define CURRENT_LIMIT_FILTER_COEFF 0.3f
+#define CHASSIS_POWER_RLS_INIT_P_K1 (0.1f * 0.1f)
+#define CHASSIS_POWER_RLS_INIT_P_K2 (0.005f * 0.005f)
+
+chassis_power_control_t chassis_power_control_data;
+
+static fp32 chassis_power_budget(void);
+#if CHASSIS_POWER_MODEL_ONLINE_FIT
+static void chassis_power_model_update(fp32 sum_sq, fp32 sum_cross);
+static void chassis_power_rls_reset(void);
+static void chassis_power_regressor_reset(void);
+#endif
+
+void chassis_power_control_init(void)
+{
+    chassis_power_control_data.k1 = CHASSIS_POWER_K1;
+    chassis_power_control_data.k2 = CHASSIS_POWER_K2;
+    chassis_power_control_data.k3 = CHASSIS_POWER_K3;
+    chassis_power_control_data.last_referee_update = get_power_heat_data_update_count();
+    chassis_power_control_data.budget = 0.0f;
+    chassis_power_control_data.predicted_power = 0.0f;
+    chassis_power_control_data.limited_power = 0.0f;
+    chassis_power_control_data.scale = 1.0f;
+    chassis_power_control_data.fSupcapUsed = 0;
+#if CHASSIS_POWER_MODEL_ONLINE_FIT
+    chassis_power_rls_reset();
+    chassis_power_regressor_reset();
+#endif
+}
 
 /**
-  * @brief          limit the power, mainly limit driver motor current
+  * @brief          limit the power, scale the output of the four motor_speed_pid so the predicted draw stays within budget
   * @retval         none
   */
 void chassis_power_control(void)
 {
-    // static fp32 total_current_limit = 0;
-    // if (toe_is_error(REFEREE_TOE) || (get_robot_id() == 0))
-    // {
-    //     total_current_limit = NO_JUDGE_TOTAL_CURRENT_LIMIT;
-    // }
-    // else
-    // {
-    //     fp32 chassis_power;
-    //     fp32 chassis_power_buffer;
-    //     fp32 chassis_power_limit;
-    //     fp32 cap_voltage = cap_message_rx.cap_message.cap_milivoltage / 1000.0f;
-    //     get_chassis_power_data(&chassis_power, &chassis_power_buffer, &chassis_power_limit);
-
-    //     // Not use supercap
-    //     if (toe_is_error(SUPCAP_TOE) || (cap_voltage <= SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD))
-    //     {
-    //         // Avoid windup after power being limited
-    //         // @TODO: fix unsynchronization issue of M3508 speed after power limiter is triggered
-    //         if (chassis_move.motor_speed_pid[0].max_iout != 0)
-    //         {
-    //             for (uint8_t i = 0; i < 4; i++)
-    //             {
-    //                 chassis_move.motor_speed_pid[i].max_iout = 0;
-    //                 chassis_move.motor_speed_pid[i].Kp = M3508_MOTOR_SPEED_PID_KP * 0.8f;
-    //             }
-    //         }
-
-    //         fp32 raw_current_limit = M3508_POWER_TO_CURRENT(chassis_power_limit / M3508_POWER_CONTROL_DELAY_S);
-    //         if (chassis_power_buffer >= WARNING_POWER_BUFF)
-    //         {
-    //             if ((chassis_power <= (chassis_power_limit * WARNING_POWER_RATIO)) || (chassis_move.chassis_RC->key.v & KEY_PRESSED_OFFSET_SHIFT))
-    //             {
-    //                 raw_current_limit += M3508_POWER_TO_CURRENT(chassis_power_buffer / M3508_POWER_CONTROL_SHRINKED_DELAY_S);
-    //             }
-    //             else
-    //             {
-    //                 raw_current_limit += M3508_POWER_TO_CURRENT(chassis_power_buffer / M3508_POWER_CONTROL_DELAY_S);
-    //             }
-    //         }
-    //         else
-    //         {
-    //             raw_current_limit = M3508_POWER_TO_CURRENT(chassis_power_buffer / M3508_POWER_CONTROL_DELAY_S);
-    //         }
-    //         total_current_limit = first_order_filter(raw_current_limit, total_current_limit, CURRENT_LIMIT_FILTER_COEFF);
-    //     }
-    //     // Use supercap
-    //     else
-    //     {
-    //         // turn back integral term
-    //         if (chassis_move.motor_speed_pid[0].max_iout == 0)
-    //         {
-    //             for (uint8_t i = 0; i < 4; i++)
-    //             {
-    //                 chassis_move.motor_speed_pid[i].max_iout = M3508_MOTOR_SPEED_PID_MAX_IOUT;
-    //                 chassis_move.motor_speed_pid[i].Kp = M3508_MOTOR_SPEED_PID_KP;
-    //             }
-    //         }
-    //         total_current_limit = NO_JUDGE_TOTAL_CURRENT_LIMIT;
-    //     }
-    // }
-
-    // fp32 total_current = 0.0f;
-    // //calculate the original motor current set
-    // for(uint8_t i = 0; i < 4; i++)
-    // {
-    //     total_current += fabs(chassis_move.motor_speed_pid[i].out);
-    // }
-    
-
-    // if(total_current > total_current_limit)
-    // {
-    //     // only limit current of driver motors, because power usage by steering motors is small and difficult to estimate. Because we control voltage input to steering motor (GM6020), not current
-    //     fp32 current_scale = total_current_limit / total_current;
-    //     chassis_move.motor_speed_pid[0].out*=current_scale;
-    //     chassis_move.motor_speed_pid[1].out*=current_scale;
-    //     chassis_move.motor_speed_pid[2].out*=current_scale;
-    //     chassis_move.motor_speed_pid[3].out*=current_scale;
-    // }
+#if (ROBOT_TYPE != INFANTRY_2024_BIPED)
+    chassis_power_control_t *power = &chassis_power_control_data;
+    fp32 sum_sq = 0.0f;
+    fp32 sum_cross = 0.0f;
+    uint8_t i;
+
+    for (i = 0; i < 4; i++)
+    {
+        fp32 current = chassis_move.motor_speed_pid[i].out * M3508_CAN_CURRENT_TO_AMP;
+        fp32 omega = chassis_move.motor_chassis[i].chassis_motor_measure->speed_rpm * M3508_RPM_TO_RAD_S;
+        sum_sq += current * current;
+        sum_cross += current * omega;
+    }
+
+    // a * s^2 + b * s + c: predicted draw with all currents scaled by s
+    fp32 a = power->k1 * sum_sq;
+    fp32 b = power->k2 * sum_cross;
+    fp32 c = 4.0f * power->k3;
+    fp32 scale = 1.0f;
+
+    power->predicted_power = a + b + c;
+    power->budget = chassis_power_budget();
+    if ((power->budget > 0.0f) && (power->predicted_power > power->budget))
+    {
+        c -= power->budget;
+        if (a > 1e-6f)
+        {
+            fp32 disc = b * b - 4.0f * a * c;
+            // budget is above the static draw (c < 0), so one root is positive; the fallback is the minimum of the parabola
+            scale = (disc >= 0.0f) ? ((-b + sqrtf(disc)) / (2.0f * a)) : (-b / (2.0f * a));
+        }
+        else if (b > 1e-6f)
+        {
+            scale = -c / b;
+        }
+        else
+        {
+            scale = 0.0f;
+        }
+        scale = fp32_constrain(scale, 0.0f, 1.0f);
+
+        for (i = 0; i < 4; i++)
+        {
+            chassis_move.motor_speed_pid[i].out *= scale;
+            // integral follows the limited output, otherwise it winds up while power is limited
+            chassis_move.motor_speed_pid[i].Iout *= scale;
+        }
+    }
+    power->scale = scale;
+    power->limited_power = power->k1 * sum_sq * scale * scale + power->k2 * sum_cross * scale + 4.0f * power->k3;
+
+#if CHASSIS_POWER_MODEL_ONLINE_FIT
+    chassis_power_model_update(sum_sq * scale * scale, sum_cross * scale);
+#endif
+#endif
+}
+
+/**
+  * @brief          power budget of the next control period
+  * @retval         W, negative means no limit (referee offline)
+  */
+static fp32 chassis_power_budget(void)
+{
+    chassis_power_control_data.fSupcapUsed = 0;
+    if (toe_is_error(REFEREE_TOE) || (get_robot_id() == 0))
+    {
+        return -1.0f;
+    }
+
+    fp32 chassis_power;
+    fp32 chassis_power_buffer;
+    fp32 chassis_power_limit;
+    get_chassis_power_data(&chassis_power, &chassis_power_buffer, &chassis_power_limit);
+
+    // spend buffer above the reserve, refill it below
+    fp32 budget = chassis_power_limit + (chassis_power_buffer - CHASSIS_POWER_BUFFER_RESERVE) / CHASSIS_POWER_BUFFER_SPEND_TIME_S;
+
+    // cap energy on top, or input power given to charging while the cap is below its reserve
+    if (supercap_manager_data.mode != SUPCAP_MODE_OFFLINE)
+    {
+        budget += supercap_manager_data.discharge_allowance;
+        // only a budget drawing on the cap discharges it, recharging takes input power away from the chassis
+        chassis_power_control_data.fSupcapUsed = (supercap_manager_data.discharge_allowance > 0.0f);
+    }
+
+    if (budget < CHASSIS_POWER_MIN_BUDGET)
+    {
+        budget = CHASSIS_POWER_MIN_BUDGET;
+    }
+    return budget;
+}
+
+#if CHASSIS_POWER_MODEL_ONLINE_FIT
+/**
+  * @brief          accumulate model regressors every control period, run one RLS step on (k1, k2) when referee reports a new power sample
+  * @param[in]      sum_sq: sum of I^2 of the applied currents, A^2
+  * @param[in]      sum_cross: sum of I * w of the applied currents, A * rad/s
+  * @retval         none
+  */
+static void chassis_power_model_update(fp32 sum_sq, fp32 sum_cross)
+{
+    chassis_power_control_t *power = &chassis_power_control_data;
+    // no reports to average over while the referee is offline, and a window that long compares with none of them
+    if (toe_is_error(REFEREE_TOE) || (power->regressor_count == UINT16_MAX))
+    {
+        chassis_power_regressor_reset();
+        if (toe_is_error(REFEREE_TOE))
+        {
+            return;
+        }
+    }
+    power->regressor_sum[0] += sum_sq;
+    power->regressor_sum[1] += sum_cross;
+    power->regressor_count++;
+
+    uint32_t referee_update = get_power_heat_data_update_count();
+    if (referee_update == power->last_referee_update)
+    {
+        return;
+    }
+    power->last_referee_update = referee_update;
+
+    // referee reports an average, compare with the average of the model over the same window
+    fp32 phi[2] = {power->regressor_sum[0] / power->regressor_count, power->regressor_sum[1] / power->regressor_count};
+    chassis_power_regressor_reset();
+
+    if (power->fSupcapUsed || (phi[0] < CHASSIS_POWER_RLS_MIN_EXCITATION))
+    {
+        return;
+    }
+
+    fp32 chassis_power;
+    fp32 chassis_power_buffer;
+    fp32 chassis_power_limit;
+    get_chassis_power_data(&chassis_power, &chassis_power_buffer, &chassis_power_limit);
+
+    fp32 (*P)[2] = power->rls_p;
+    fp32 P_phi[2] = {P[0][0] * phi[0] + P[0][1] * phi[1], P[1][0] * phi[0] + P[1][1] * phi[1]};
+    fp32 denom = CHASSIS_POWER_RLS_FORGETTING + phi[0] * P_phi[0] + phi[1] * P_phi[1];
+    fp32 gain[2] = {P_phi[0] / denom, P_phi[1] / denom};
+    fp32 error = chassis_power - 4.0f * power->k3 - (power->k1 * phi[0] + power->k2 * phi[1]);
+
+    power->k1 = fp32_constrain(power->k1 + gain[0] * error, CHASSIS_POWER_K1_MIN, CHASSIS_POWER_K1_MAX);
+    power->k2 = fp32_constrain(power->k2 + gain[1] * error, CHASSIS_POWER_K2_MIN, CHASSIS_POWER_K2_MAX);
+
+    // P = (P - gain * P_phi') / lambda, P is symmetric
+    P[0][0] = (P[0][0] - gain[0] * P_phi[0]) / CHASSIS_POWER_RLS_FORGETTING;
+    P[0][1] = (P[0][1] - gain[0] * P_phi[1]) / CHASSIS_POWER_RLS_FORGETTING;
+    P[1][1] = (P[1][1] - gain[1] * P_phi[1]) / CHASSIS_POWER_RLS_FORGETTING;
+    P[1][0] = P[0][1];
+
+    // forgetting inflates the direction that is not excited, restart before it blows up
+    if ((P[0][0] > CHASSIS_POWER_RLS_INIT_P_K1) || (P[1][1] > CHASSIS_POWER_RLS_INIT_P_K2) || (P[0][0] < 0.0f) || (P[1][1] < 0.0f))
+    {
+        chassis_power_rls_reset();
+    }
+}
+
+static void chassis_power_rls_reset(void)
+{
+    chassis_power_control_data.rls_p[0][0] = CHASSIS_POWER_RLS_INIT_P_K1;
+    chassis_power_control_data.rls_p[0][1] = 0.0f;
+    chassis_power_control_data.rls_p[1][0] = 0.0f;
+    chassis_power_control_data.rls_p[1][1] = CHASSIS_POWER_RLS_INIT_P_K2;
+}
+
+/**
+  * @brief          start a new averaging window of the model regressors, and take the referee power report it ends at
+  *                 from the next one
+  * @retval         none
+  */
+static void chassis_power_regressor_reset(void)
+{
+    chassis_power_control_data.regressor_sum[0] = 0.0f;
+    chassis_power_control_data.regressor_sum[1] = 0.0f;
+    chassis_power_control_data.regressor_count = 0;
+    chassis_power_control_data.last_referee_update = get_power_heat_data_update_count();
 }
+#endif
@@ -2,12 +2,18 @@
   ****************************(C) COPYRIGHT 2019 DJI****************************
   * @file       chassis_power_control.c/h
   * @brief      chassis power control
-  * @note       this is only controling 80 w power, mainly limit motor current set.
-  *             if power limit is 40w, reduce the value JUDGE_TOTAL_CURRENT_LIMIT 
-  *             and POWER_CURRENT_LIMIT, and chassis max speed (include max_vx_speed, min_vx_speed)
+  * @note       per-wheel power model of M3508 with C620 ESC:
+  *                 P_i = k1 * I_i^2 + k2 * I_i * w_i + k3
+  *             I_i: commanded current (A), w_i: rotor speed (rad/s). k1 is copper and switching loss,
+  *             k2 is the rotor torque constant (mechanical power), k3 is the static draw of one ESC.
+  *             The command about to be sent is evaluated against the latest speed feedback, which is the
+  *             draw of the next control period. When it exceeds the budget, all four currents are scaled
+  *             by the same factor (largest k in [0, 1] with predicted power == budget), so the ratio between
+  *             wheels and hence the direction of chassis motion is kept.
   * @history
   *  Version    Date            Author          Modification
   *  V1.1.0     Nov-11-2019     RM              1. add chassis power control
+  *  V2.0.0     2024            MacFalcons      1. predictive power model with buffer and supercap budget
   *
   @verbatim
   ==============================================================================
@@ -20,17 +26,59 @@
 #define CHASSIS_POWER_CONTROL_H
 #include "chassis_task.h"
 #include "main.h"
-// #include "math.h" // sqrtf
+#include "supercap_manager.h"
 
-#define SUPCAP_VOLTAGE_MIN 3.0f
-// #define SUPCAP_VOLTAGE_MAX 26.697f
-// #define SUPCAP_ENERGY_CLEARANCE_RATIO 0.1f
-// #define SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD (sqrtf((1 - SUPCAP_ENERGY_CLEARANCE_RATIO) * SUPCAP_VOLTAGE_MAX * SUPCAP_VOLTAGE_MAX + SUPCAP_ENERGY_CLEARANCE_RATIO * SUPCAP_VOLTAGE_MIN * SUPCAP_VOLTAGE_MIN))
-#define SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD SUPCAP_VOLTAGE_MIN
-// #define SUPCAP_CAPACITANCE 5.0f // unit: Farad
+// M3508 + C620: CAN command range [-16384, 16384] maps to [-20A, 20A]
+#define M3508_CAN_CURRENT_TO_AMP (20.0f / 16384.0f)
+#define M3508_RPM_TO_RAD_S (2.0f * PI / 60.0f)
+// default power model, refit from logged data with Scripts/chassis_power_sim.py
+#define CHASSIS_POWER_K1 0.30f   // W / A^2
+#define CHASSIS_POWER_K2 0.0156f // W / (A * rad/s), 0.3Nm/A at output shaft / gear ratio
+#define CHASSIS_POWER_K3 0.80f   // W per wheel
+// refine k1 and k2 online by recursive least squares against referee chassis power.
+// Only while supercap is offline: with supercap in between, referee measures the charger input instead of the motors.
+#define CHASSIS_POWER_MODEL_ONLINE_FIT 1
+#define CHASSIS_POWER_RLS_FORGETTING 0.995f
+#define CHASSIS_POWER_RLS_MIN_EXCITATION 4.0f // A^2, skip samples with tiny current, they carry no information on k1
+#define CHASSIS_POWER_K1_MIN 0.05f
+#define CHASSIS_POWER_K1_MAX 1.0f
+#define CHASSIS_POWER_K2_MIN 0.005f
+#define CHASSIS_POWER_K2_MAX 0.04f
+
+// buffer energy management: buffer above the reserve is spent over CHASSIS_POWER_BUFFER_SPEND_TIME_S,
+// buffer below the reserve is refilled by budgeting under the limit
+#define CHASSIS_POWER_BUFFER_RESERVE 20.0f     // J
+#define CHASSIS_POWER_BUFFER_SPEND_TIME_S 0.2f
+#define CHASSIS_POWER_MIN_BUDGET 5.0f          // W, budget never goes below this, chassis is not frozen completely
+
+typedef struct
+{
+    fp32 k1;
+    fp32 k2;
+    fp32 k3;
+    fp32 rls_p[2][2];         // covariance of (k1, k2)
+    fp32 regressor_sum[2];    // sum of (I^2, I*w) over wheels, accumulated between referee power updates
+    uint16_t regressor_count;
+    uint32_t last_referee_update;
+
+    fp32 budget;              // W
+    fp32 predicted_power;     // W, before limiting
+    fp32 limited_power;       // W, after limiting
+    fp32 scale;               // 1: not limited
+    uint8_t fSupcapUsed;      // budget draws on the cap energy, the referee power is not the chassis power
+} chassis_power_control_t;
+
+extern chassis_power_control_t chassis_power_control_data;
+
+/**
+  * @brief          reset power model to default coefficients
+  * @retval         none
+  */
+extern void chassis_power_control_init(void);
 
 /**
-  * @brief          limit the power, mainly limit motor current
+  * @brief          limit the power, scale the output of the four motor_speed_pid so the predicted draw stays within budget.
+  *                 Call after PID_calc and before the outputs are copied to give_current
   * @retval         none
   */
 extern void chassis_power_control(void);
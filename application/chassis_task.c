@@ -24,6 +24,11 @@
 #include "CAN_receive.h"
 #include "INS_task.h"
 #include "chassis_power_control.h"
+#include "supercap_manager.h"
+#include "chassis_traction_control.h"
+#include "chassis_odometry.h"
+#include "swerve_kinematics.h"
+#include "biped_link.h"
 #include "cv_usart_task.h"
 #include "detect_task.h"
 #include "pid.h"
@@ -31,8 +36,9 @@
 #include "user_lib.h"
 #include <assert.h>
 #include "referee.h"
+#include "calibrate_task.h"
+#include "bsp_delay.h"
 
-#define STEER_MOTOR_UPSIDE_DOWN_MOUNTING 0
 #define SWERVE_INVALID_HIP_DATA_RESET_TIMEOUT 1000
 
 /**
@@ -67,6 +73,8 @@ static void chassis_control_loop(void);
 static uint16_t motor_angle_to_ecd_change(fp32 angle);
 void swerve_convert_from_rpy_to_alpha(fp32 roll, fp32 pitch, fp32 *alpha1, fp32 *alpha2, fp32 gimbal_chassis_relative_yaw_angle);
 void swerve_convert_from_alpha_to_rpy(fp32 *roll, fp32 *pitch, fp32 alpha1, fp32 alpha2, fp32 gimbal_chassis_relative_yaw_angle);
+static void swerve_platform_rotation(fp32 gimbal_chassis_relative_yaw_angle, fp32 *cos_total, fp32 *sin_total);
+static fp32 swerve_platform_alpha_limit(fp32 height);
 #endif
 
 #if INCLUDE_uxTaskGetStackHighWaterMark
@@ -75,6 +83,44 @@ uint32_t chassis_high_water;
 supcap_t cap_message_rx;
 
 chassis_move_t chassis_move;
+chassis_loop_timing_t chassis_loop_timing;
+
+#if CHASSIS_EVENT_DRIVEN_LOOP
+#define CHASSIS_LATENCY_AVG_COEFF 0.01f
+/**
+ * @brief          update chassis loop period statistics, call when the loop wakes up
+ * @param[in]      fFeedbackArrived: 1 if woken up by wheel feedback, 0 by timeout
+ * @retval         none
+ */
+static void chassis_loop_timing_wakeup(uint8_t fFeedbackArrived)
+{
+	static uint32_t ulLastWakeCycle = 0;
+	uint32_t ulNowCycle = delay_get_cycle();
+	if (chassis_loop_timing.loop_count > 0)
+	{
+		chassis_loop_timing.period_us = delay_cycle_to_us(ulNowCycle - ulLastWakeCycle);
+		chassis_loop_timing.period_max_us = fmaxf(chassis_loop_timing.period_max_us, chassis_loop_timing.period_us);
+		chassis_loop_timing.dt = fp32_constrain(chassis_loop_timing.period_us * 1e-6f, CHASSIS_CONTROL_TIME_MIN_S, CHASSIS_CONTROL_TIME_MAX_S);
+	}
+	ulLastWakeCycle = ulNowCycle;
+	chassis_loop_timing.loop_count++;
+	if (fFeedbackArrived == 0)
+	{
+		chassis_loop_timing.timeout_count++;
+	}
+}
+
+/**
+ * @brief          update control-to-actuation latency, call right after the chassis command is queued on CAN
+ * @retval         none
+ */
+static void chassis_loop_timing_actuated(void)
+{
+	chassis_loop_timing.latency_us = delay_cycle_to_us(delay_get_cycle() - CAN_get_chassis_feedback_cycle());
+	chassis_loop_timing.latency_max_us = fmaxf(chassis_loop_timing.latency_max_us, chassis_loop_timing.latency_us);
+	chassis_loop_timing.latency_avg_us += CHASSIS_LATENCY_AVG_COEFF * (chassis_loop_timing.latency_us - chassis_loop_timing.latency_avg_us);
+}
+#endif
 
 #if CHASSIS_TEST_MODE
 fp32 rot_radius0;
@@ -100,13 +146,15 @@ static void J_scope_chassis_test(void)
 #endif
 
 /**
- * @brief          chassis task, osDelay CHASSIS_CONTROL_TIME_MS (2ms)
+ * @brief          chassis task, triggered by wheel feedback every CHASSIS_CONTROL_TIME_MS (1ms)
  * @param[in]      pvParameters: null
  * @retval         none
  */
 void chassis_task(void const *pvParameters)
 {
+#if (CHASSIS_EVENT_DRIVEN_LOOP == 0)
 	uint32_t ulSystemTime = osKernelSysTick();
+#endif
 	// wait a time
 	osDelay(CHASSIS_TASK_INIT_TIME);
 
@@ -116,9 +164,17 @@ void chassis_task(void const *pvParameters)
 	// }
 
 	chassis_init();
+#if CHASSIS_EVENT_DRIVEN_LOOP
+	CAN_chassis_feedback_notify_init();
+#endif
 
 	while (1)
 	{
+#if CHASSIS_EVENT_DRIVEN_LOOP
+		// wait for all four wheel feedback frames, timeout keeps the chassis controlled when a wheel is offline
+		uint8_t fFeedbackArrived = (ulTaskNotifyTake(pdTRUE, CHASSIS_FEEDBACK_TIMEOUT_MS) != 0);
+		chassis_loop_timing_wakeup(fFeedbackArrived);
+#endif
 		chassis_behaviour_set_mode();
 		// operation when behaviour mode changes
 		chassis_behaviour_change_transit();
@@ -128,10 +184,31 @@ void chassis_task(void const *pvParameters)
 		chassis_set_control();
 		// chassis control pid calculate
 		chassis_control_loop();
+#if (ROBOT_TYPE != INFANTRY_2024_BIPED)
+		fp32 autotune_wheel_cmd = chassis_move.motor_chassis[0].give_current;
+		if (pid_autotune_override_cmd(PID_AUTOTUNE_WHEEL_SPEED, chassis_move.motor_chassis[0].speed, &autotune_wheel_cmd))
+		{
+			chassis_move.motor_chassis[0].give_current = (int16_t)autotune_wheel_cmd;
+		}
+#endif
+#if (SYSID_ENABLE && (ROBOT_TYPE != INFANTRY_2024_BIPED))
+		fp32 sysid_wheel_cmd = chassis_move.motor_chassis[0].give_current;
+		if (sysid_override_cmd(SYSID_TARGET_WHEEL, &sysid_wheel_cmd))
+		{
+			chassis_move.motor_chassis[0].give_current = (int16_t)sysid_wheel_cmd;
+		}
+#endif
 		// send CAN msg
 		CAN_cmd_chassis();
 
+#if CHASSIS_EVENT_DRIVEN_LOOP
+		if (fFeedbackArrived)
+		{
+			chassis_loop_timing_actuated();
+		}
+#else
 		osDelayUntil(&ulSystemTime, CHASSIS_CONTROL_TIME_MS);
+#endif
 
 #if CHASSIS_TEST_MODE
 		J_scope_chassis_test();
@@ -153,15 +230,14 @@ static void chassis_init(void)
 	// chassis angle PID
 	const static fp32 chassis_yaw_pid[3] = {CHASSIS_FOLLOW_GIMBAL_PID_KP, CHASSIS_FOLLOW_GIMBAL_PID_KI, CHASSIS_FOLLOW_GIMBAL_PID_KD};
 
-	const static fp32 chassis_x_order_filter[1] = {CHASSIS_ACCEL_X_NUM};
-	const static fp32 chassis_y_order_filter[1] = {CHASSIS_ACCEL_Y_NUM};
-	const static fp32 chassis_wz_order_filter[1] = {CHASSIS_ACCEL_WZ_NUM};
-
+	// nominal until the loop has measured its period
+	chassis_loop_timing.dt = CHASSIS_CONTROL_TIME_S;
 	chassis_move.chassis_coord_sys = CHASSIS_COORDINATE_FOLLOW_CHASSIS_RELATIVE_FRONT;
 	chassis_move.chassis_RC = get_remote_control_point();
 	chassis_move.chassis_INS_angle = get_INS_angle_point();
 	chassis_move.chassis_yaw_motor = get_yaw_motor_point();
 	chassis_move.chassis_pitch_motor = get_pitch_motor_point();
+	chassis_move.relative_angle_last = chassis_move.chassis_yaw_motor->relative_angle;
 
 #if (ROBOT_TYPE == INFANTRY_2024_BIPED)
 	for (uint8_t i = 0; i < sizeof(chassis_move.wheel_rot_radii) / sizeof(chassis_move.wheel_rot_radii[0]); i++)
@@ -174,18 +250,24 @@ static void chassis_init(void)
 	{
 		chassis_move.motor_chassis[i].chassis_motor_measure = get_chassis_motor_measure_point(i);
 		PID_init(&chassis_move.motor_speed_pid[i], PID_POSITION, motor_speed_pid, M3508_MOTOR_SPEED_PID_MAX_OUT, M3508_MOTOR_SPEED_PID_MAX_IOUT, 0, &raw_err_handler);
+		pid_autotune_load_gains(PID_AUTOTUNE_WHEEL_SPEED, &chassis_move.motor_speed_pid[i]);
 		chassis_move.wheel_rot_radii[i] = MOTOR_DISTANCE_TO_CENTER_DEFAULT;
 	}
+	chassis_power_control_init();
+	supercap_manager_init();
+	chassis_traction_control_init();
+	chassis_odometry_init();
 #endif
 	PID_init(&chassis_move.chassis_angle_pid, PID_POSITION, chassis_yaw_pid, CHASSIS_FOLLOW_GIMBAL_PID_MAX_OUT, CHASSIS_FOLLOW_GIMBAL_PID_MAX_IOUT, 0, &rad_err_handler);
 
-	first_order_filter_init(&chassis_move.chassis_cmd_slow_set_vx, CHASSIS_CONTROL_TIME_S, chassis_x_order_filter);
-	first_order_filter_init(&chassis_move.chassis_cmd_slow_set_vy, CHASSIS_CONTROL_TIME_S, chassis_y_order_filter);
-	first_order_filter_init(&chassis_move.chassis_cmd_slow_set_wz, CHASSIS_CONTROL_TIME_S, chassis_wz_order_filter);
-
 	chassis_move.vx_max_speed = NORMAL_MAX_CHASSIS_SPEED_X;
 	chassis_move.vy_max_speed = NORMAL_MAX_CHASSIS_SPEED_Y;
 	chassis_move.wz_max_speed = SPINNING_CHASSIS_MAX_OMEGA;
+	chassis_move.accel_max = CHASSIS_CMD_ACCEL_PER_WATT * CHASSIS_CMD_MIN_POWER_LIMIT;
+
+	s_curve_ramp_init(&chassis_move.chassis_cmd_slow_set_vx, CHASSIS_CONTROL_TIME_S, chassis_move.accel_max, chassis_move.accel_max / CHASSIS_CMD_JERK_TIME_S);
+	s_curve_ramp_init(&chassis_move.chassis_cmd_slow_set_vy, CHASSIS_CONTROL_TIME_S, chassis_move.accel_max, chassis_move.accel_max / CHASSIS_CMD_JERK_TIME_S);
+	s_curve_ramp_init(&chassis_move.chassis_cmd_slow_set_wz, CHASSIS_CONTROL_TIME_S, chassis_move.accel_max / chassis_move.wheel_rot_radii[0], chassis_move.accel_max / chassis_move.wheel_rot_radii[0] / CHASSIS_CMD_JERK_TIME_S);
 
 	chassis_move.dial_channel_latched = 0;
 
@@ -200,6 +282,10 @@ static void chassis_init(void)
 	// special assignment to ensure fHipDisabledEdge not being miscalculated by the garbage data
 	chassis_move.fHipEnabled = 0;
 	swerve_chassis_params_reset();
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		swerve_module_init(&chassis_move.steer_motor_chassis[i].module, CHASSIS_CONTROL_TIME_S, 0.0f);
+	}
 #elif (ROBOT_TYPE == INFANTRY_2024_BIPED)
 	biped_chassis_params_reset();
 #endif
@@ -264,6 +350,8 @@ void biped_chassis_params_reset(void)
 	chassis_move.chassis_platform.target_dis_dot = 0;
 	chassis_move.chassis_platform.fBackToHome = 0;
 	chassis_move.chassis_platform.fJumpStart = 0;
+	// sequence after an outage says nothing about lost sets
+	biped_link_resync(&biped_link_data);
 
 	chassis_enable_platform_flag(0);
 }
@@ -290,6 +378,9 @@ static void chassis_feedback_update(void)
 	chassis_move.vx = (-chassis_move.motor_chassis[0].speed + chassis_move.motor_chassis[1].speed + chassis_move.motor_chassis[2].speed - chassis_move.motor_chassis[3].speed) * MOTOR_SPEED_TO_CHASSIS_SPEED_VX;
 	chassis_move.vy = (-chassis_move.motor_chassis[0].speed - chassis_move.motor_chassis[1].speed + chassis_move.motor_chassis[2].speed + chassis_move.motor_chassis[3].speed) * MOTOR_SPEED_TO_CHASSIS_SPEED_VY;
 	chassis_move.wz = (-chassis_move.motor_chassis[0].speed - chassis_move.motor_chassis[1].speed - chassis_move.motor_chassis[2].speed - chassis_move.motor_chassis[3].speed) * MOTOR_SPEED_TO_CHASSIS_SPEED_WZ / chassis_move.wheel_rot_radii[0];
+#else
+	// least squares over the four modules, hip motion removed
+	swerve_kinematics_update();
 #endif
 #endif
 
@@ -298,6 +389,23 @@ static void chassis_feedback_update(void)
 	chassis_move.chassis_pitch = rad_format(*(chassis_move.chassis_INS_angle + INS_PITCH_ADDRESS_OFFSET) - chassis_move.chassis_pitch_motor->relative_angle);
 	chassis_move.chassis_roll = *(chassis_move.chassis_INS_angle + INS_ROLL_ADDRESS_OFFSET);
 
+	// rate of the relative angle for spinning compensation
+#if GIMBAL_YAW_ANGLE_TRACKER
+	// yaw motor rate corrected by the encoder, no quantization noise to filter out
+	chassis_move.relative_angle_dot = get_gimbal_yaw_relative_speed();
+#else
+	// differencing the yaw encoder is exact up to quantization
+	fp32 relative_angle_delta = rad_format(chassis_move.chassis_yaw_motor->relative_angle - chassis_move.relative_angle_last);
+	chassis_move.relative_angle_dot = first_order_filter(relative_angle_delta / chassis_loop_timing.dt, chassis_move.relative_angle_dot, CHASSIS_SPIN_COMP_RATE_FILTER_COEFF);
+	chassis_move.relative_angle_last = chassis_move.chassis_yaw_motor->relative_angle;
+#endif
+
+#if (ROBOT_TYPE != INFANTRY_2024_BIPED)
+	chassis_odometry_update();
+	// before chassis_speed_max_adj and the power control read its allowance
+	supercap_manager_update((chassis_move.chassis_RC->key.v & KEY_PRESSED_OFFSET_SHIFT) != 0, chassis_power_control_data.limited_power);
+#endif
+
 	// KEY_PRESSED_OFFSET_E toggles random spinning mode
 	// no need to debounce because keyboard signal is clean
 	static uint8_t fLastKeyESignal = 0;
@@ -322,7 +430,13 @@ void chassis_speed_max_adj(void)
 	// Tuning guide: normal mode only uses 10% power buffer; sprint mode only use 75%
 	fp32 vx_speed_limit = 0;
 	fp32 vy_speed_limit = 0;
-	uint16_t uiPowerLevel = fp32_constrain(ref_chassis_power_limit - 40, 0, 100) / 5;
+	// sustained power: cap energy counts while sprinting or recharging, the normal allowance only covers transients
+	fp32 sustained_power_limit = ref_chassis_power_limit;
+	if ((supercap_manager_data.mode == SUPCAP_MODE_BOOST) || (supercap_manager_data.mode == SUPCAP_MODE_RECHARGE))
+	{
+		sustained_power_limit += supercap_manager_data.discharge_allowance;
+	}
+	uint16_t uiPowerLevel = fp32_constrain(sustained_power_limit - 40, 0, 100) / 5;
 	switch (uiPowerLevel)
 	{
 		case 0:
@@ -410,6 +524,8 @@ void chassis_speed_max_adj(void)
 		chassis_move.vx_max_speed = vx_speed_limit;
 	}
 	chassis_move.vy_max_speed = vy_speed_limit;
+	// acceleration a chassis of this power level can hold near full speed
+	chassis_move.accel_max = CHASSIS_CMD_ACCEL_PER_WATT * (CHASSIS_CMD_MIN_POWER_LIMIT + 5.0f * uiPowerLevel);
 
 	const fp32 vx_to_wz_limit_coeff = 1.5f / NORMAL_MAX_CHASSIS_SPEED_X * SPINNING_CHASSIS_MAX_OMEGA;
 	fp32 wz_decay_by_v_coeff = fp32_constrain(1 - sqrtf(chassis_move.vx_set * chassis_move.vx_set + chassis_move.vy_set * chassis_move.vy_set) / chassis_move.vx_max_speed, 0, 1);
@@ -420,7 +536,46 @@ void chassis_speed_max_adj(void)
 		chassis_move.vx_max_speed = fp32_abs_constrain(chassis_move.vx_max_speed * NORMAL_TO_SPRINT_MAX_CHASSIS_SPEED_RATIO, SPRINT_MAX_CHASSIS_SPEED_X);
 		chassis_move.vy_max_speed = fp32_abs_constrain(chassis_move.vy_max_speed * NORMAL_TO_SPRINT_MAX_CHASSIS_SPEED_RATIO, SPRINT_MAX_CHASSIS_SPEED_Y);
 		chassis_move.wz_max_speed = fp32_abs_constrain(chassis_move.wz_max_speed * NORMAL_TO_SPRINT_MAX_CHASSIS_SPEED_RATIO, SPINNING_CHASSIS_MAX_OMEGA);
+		chassis_move.accel_max *= NORMAL_TO_SPRINT_MAX_CHASSIS_SPEED_RATIO;
+	}
+}
+
+/**
+ * @brief          shape a set-point with an S-curve ramp, braking toward zero may use a larger acceleration
+ * @param[out]     s_curve_ramp: ramp of the set-point
+ * @param[in]      target: raw set-point
+ * @param[in]      accel_max: max acceleration of the set-point
+ * @retval         shaped set-point
+ */
+static fp32 chassis_cmd_shape(s_curve_ramp_type_t *s_curve_ramp, fp32 target, fp32 accel_max)
+{
+	if ((fabsf(target) < fabsf(s_curve_ramp->out)) || (target * s_curve_ramp->out < 0.0f))
+	{
+		accel_max *= CHASSIS_CMD_BRAKE_ACCEL_RATIO;
 	}
+	s_curve_ramp_set_limit(s_curve_ramp, accel_max, accel_max / CHASSIS_CMD_JERK_TIME_S);
+	s_curve_ramp->frame_period = chassis_loop_timing.dt;
+	return s_curve_ramp_calc(s_curve_ramp, target);
+}
+
+/**
+ * @brief          gimbal relative angle to map the gimbal frame command with. The command reaches the wheels after the
+ *                 feedback-to-command latency and is held for one period, while spinning the relative angle keeps
+ *                 turning: use its prediction for the middle of that window, or the chassis drifts sideways. The
+ *                 relative angle itself was read by the gimbal task, on average half a gimbal period ago
+ * @retval         relative angle, rad
+ */
+static fp32 chassis_spin_compensated_relative_angle(void)
+{
+#if CHASSIS_SPIN_COMPENSATION_ENABLE
+	fp32 lead_time = (CHASSIS_CONTROL_TIME_S + GIMBAL_CONTROL_TIME_S) * 0.5f + CHASSIS_SPIN_COMP_EXTRA_LEAD_S;
+#if CHASSIS_EVENT_DRIVEN_LOOP
+	lead_time += chassis_loop_timing.latency_avg_us * 1e-6f;
+#endif
+	return rad_format(chassis_move.chassis_yaw_motor->relative_angle + chassis_move.relative_angle_dot * lead_time);
+#else
+	return chassis_move.chassis_yaw_motor->relative_angle;
+#endif
 }
 
 /**
@@ -470,22 +625,21 @@ void chassis_rc_to_control_vector(fp32 *vx_set, fp32 *vy_set)
 		vy_set_channel = -chassis_move.vy_max_speed;
 	}
 
-	// first order low-pass replace ramp function, calculate chassis speed set-point to improve control performance
-	first_order_filter_cali(&chassis_move.chassis_cmd_slow_set_vx, vx_set_channel);
-	first_order_filter_cali(&chassis_move.chassis_cmd_slow_set_vy, vy_set_channel);
-	// stop command, need not slow change, set zero derectly
-	if (fabs(vx_set_channel) < CHASSIS_RC_DEADLINE * vx_rc_sen)
+	// stop command, need not slow change, set zero derectly: the wheel speed loop brakes within the power limit
+	if (fabsf(vx_set_channel) < CHASSIS_RC_DEADLINE * vx_rc_sen)
 	{
-		chassis_move.chassis_cmd_slow_set_vx.out = 0.0f;
+		s_curve_ramp_reset(&chassis_move.chassis_cmd_slow_set_vx, 0.0f);
 	}
 
-	if (fabs(vy_set_channel) < CHASSIS_RC_DEADLINE * vy_rc_sen)
+	if (fabsf(vy_set_channel) < CHASSIS_RC_DEADLINE * vy_rc_sen)
 	{
-		chassis_move.chassis_cmd_slow_set_vy.out = 0.0f;
+		s_curve_ramp_reset(&chassis_move.chassis_cmd_slow_set_vy, 0.0f);
 	}
 
-	*vx_set = chassis_move.chassis_cmd_slow_set_vx.out;
-	*vy_set = chassis_move.chassis_cmd_slow_set_vy.out;
+	// acceleration and jerk limited set-point, so a key press doesn't saturate wheel current and trip the power limit
+	// slowing down without stopping is shaped as well, with CHASSIS_CMD_BRAKE_ACCEL_RATIO more acceleration
+	*vx_set = chassis_cmd_shape(&chassis_move.chassis_cmd_slow_set_vx, vx_set_channel, chassis_move.accel_max);
+	*vy_set = chassis_cmd_shape(&chassis_move.chassis_cmd_slow_set_vy, vy_set_channel, chassis_move.accel_max);
 }
 
 #if (ROBOT_TYPE == INFANTRY_2024_BIPED)
@@ -595,14 +749,7 @@ void swerve_platform_rc_mapping(void)
 
 		// constrain target alpha1 and alpha2 values
 		// calculation for alpha limit: According to the matlab calculation, the available workspace in height-alpha space is triangular, so we assume height target has more priority than alpha target, and calculate alpha limit based on height
-		if (chassis_move.chassis_platform.target_height >= CHASSIS_H_WORKSPACE_PEAK)
-		{
-			chassis_move.chassis_platform.alpha_upper_limit = (chassis_move.chassis_platform.target_height - CHASSIS_H_UPPER_LIMIT) / CHASSIS_H_WORKSPACE_SLOPE2;
-		}
-		else
-		{
-			chassis_move.chassis_platform.alpha_upper_limit = (chassis_move.chassis_platform.target_height - CHASSIS_H_LOWER_LIMIT) / CHASSIS_H_WORKSPACE_SLOPE1;
-		}
+		chassis_move.chassis_platform.alpha_upper_limit = swerve_platform_alpha_limit(chassis_move.chassis_platform.target_height);
 		chassis_move.chassis_platform.alpha_lower_limit = -chassis_move.chassis_platform.alpha_upper_limit;
 
 		chassis_move.chassis_platform.target_alpha1 = fp32_constrain(chassis_move.chassis_platform.target_alpha1, chassis_move.chassis_platform.alpha_lower_limit, chassis_move.chassis_platform.alpha_upper_limit);
@@ -613,6 +760,42 @@ void swerve_platform_rc_mapping(void)
 	}
 }
 
+/**
+ * @brief          rotation between roll/pitch and alpha1/alpha2, cached: the yaw motor angle comes from a 13 bit encoder
+ *                 and repeats across ticks, and each tick converts forward and back with the same angle
+ * @param[in]      gimbal_chassis_relative_yaw_angle: yaw motor relative angle
+ * @param[out]     cos_total: cos(PI / 4 + gimbal_chassis_relative_yaw_angle)
+ * @param[out]     sin_total: sin(PI / 4 + gimbal_chassis_relative_yaw_angle)
+ * @retval         none
+ */
+static void swerve_platform_rotation(fp32 gimbal_chassis_relative_yaw_angle, fp32 *cos_total, fp32 *sin_total)
+{
+	static uint8_t fCacheValid = 0;
+	static fp32 cached_yaw_angle;
+	static fp32 cached_cos_total;
+	static fp32 cached_sin_total;
+	if ((fCacheValid == 0) || (gimbal_chassis_relative_yaw_angle != cached_yaw_angle))
+	{
+		cached_yaw_angle = gimbal_chassis_relative_yaw_angle;
+		cached_cos_total = AHRS_cosf(PI / 4.0f + gimbal_chassis_relative_yaw_angle);
+		cached_sin_total = AHRS_sinf(PI / 4.0f + gimbal_chassis_relative_yaw_angle);
+		fCacheValid = 1;
+	}
+	*cos_total = cached_cos_total;
+	*sin_total = cached_sin_total;
+}
+
+/**
+ * @brief          max |alpha| of the platform at a height: the triangular workspace in height-alpha space, nearer edge
+ * @param[in]      height: platform height, [CHASSIS_H_LOWER_LIMIT, CHASSIS_H_UPPER_LIMIT]
+ * @retval         alpha limit, rad
+ */
+static fp32 swerve_platform_alpha_limit(fp32 height)
+{
+	// both edges meet at (CHASSIS_H_WORKSPACE_PEAK, CHASSIS_ALPHA_WORKSPACE_PEAK), so the smaller one is the edge in use
+	return fminf((height - CHASSIS_H_LOWER_LIMIT) * CHASSIS_H_WORKSPACE_SLOPE1_INV, (height - CHASSIS_H_UPPER_LIMIT) * CHASSIS_H_WORKSPACE_SLOPE2_INV);
+}
+
 void swerve_convert_from_rpy_to_alpha(fp32 roll, fp32 pitch, fp32 *alpha1, fp32 *alpha2, fp32 gimbal_chassis_relative_yaw_angle)
 {
 	// roll: positive tilting right
@@ -624,8 +807,9 @@ void swerve_convert_from_rpy_to_alpha(fp32 roll, fp32 pitch, fp32 *alpha1, fp32
 	// *alpha1 = (roll + pitch) / 2.0f;
 	// *alpha2 = (roll - pitch) / 2.0f;
 
-	fp32 cos_total = AHRS_cosf(PI / 4.0f + gimbal_chassis_relative_yaw_angle);
-	fp32 sin_total = AHRS_sinf(PI / 4.0f + gimbal_chassis_relative_yaw_angle);
+	fp32 cos_total;
+	fp32 sin_total;
+	swerve_platform_rotation(gimbal_chassis_relative_yaw_angle, &cos_total, &sin_total);
 	*alpha2 = cos_total * roll - sin_total * pitch;
 	*alpha1 = sin_total * roll + cos_total * pitch;
 
@@ -642,8 +826,9 @@ void swerve_convert_from_alpha_to_rpy(fp32 *roll, fp32 *pitch, fp32 alpha1, fp32
 	// *roll = alpha1 + alpha2;
 	// *pitch = alpha1 - alpha2;
 
-	fp32 cos_total = AHRS_cosf(PI / 4.0f + gimbal_chassis_relative_yaw_angle);
-	fp32 sin_total = AHRS_sinf(PI / 4.0f + gimbal_chassis_relative_yaw_angle);
+	fp32 cos_total;
+	fp32 sin_total;
+	swerve_platform_rotation(gimbal_chassis_relative_yaw_angle, &cos_total, &sin_total);
 	*roll = cos_total * alpha2 + sin_total * alpha1;
 	*pitch = -sin_total * alpha2 + cos_total * alpha1;
 }
@@ -676,15 +861,16 @@ static void chassis_set_control(void)
 		}
 		case CHASSIS_COORDINATE_FOLLOW_GIMBAL:
 		{
-			fp32 sin_yaw = AHRS_sinf(chassis_move.chassis_yaw_motor->relative_angle);
-			fp32 cos_yaw = AHRS_cosf(chassis_move.chassis_yaw_motor->relative_angle);
+			fp32 relative_angle = chassis_spin_compensated_relative_angle();
+			fp32 sin_yaw = AHRS_sinf(relative_angle);
+			fp32 cos_yaw = AHRS_cosf(relative_angle);
 			chassis_move.vx_set = cos_yaw * vx_set + (-sin_yaw) * vy_set;
 			chassis_move.vy_set = sin_yaw * vx_set + cos_yaw * vy_set;
 
 			if (chassis_behaviour_mode == CHASSIS_FOLLOW_GIMBAL_MODE)
 			{
 				chassis_move.chassis_relative_angle_set = rad_format(angle_set);
-				chassis_move.wz_set = -PID_calc(&chassis_move.chassis_angle_pid, chassis_move.chassis_yaw_motor->relative_angle, chassis_move.chassis_relative_angle_set, CHASSIS_CONTROL_TIME_S);
+				chassis_move.wz_set = -PID_calc(&chassis_move.chassis_angle_pid, chassis_move.chassis_yaw_motor->relative_angle, chassis_move.chassis_relative_angle_set, chassis_loop_timing.dt);
 			}
 			else
 			{
@@ -700,6 +886,16 @@ static void chassis_set_control(void)
 			chassis_move.wz_set = wz_set;
 		}
 	}
+	// spinning speed is shaped here, chassis following gimbal is closed loop and keeps the pid output
+	if (chassis_behaviour_mode == CHASSIS_FOLLOW_GIMBAL_MODE)
+	{
+		s_curve_ramp_reset(&chassis_move.chassis_cmd_slow_set_wz, chassis_move.wz_set);
+	}
+	else
+	{
+		chassis_move.wz_set = chassis_cmd_shape(&chassis_move.chassis_cmd_slow_set_wz, chassis_move.wz_set, chassis_move.accel_max / chassis_move.wheel_rot_radii[0]);
+	}
+
 	// speed limit
 	chassis_move.vx_set = fp32_abs_constrain(chassis_move.vx_set, chassis_move.vx_max_speed);
 	chassis_move.vy_set = fp32_abs_constrain(chassis_move.vy_set, chassis_move.vy_max_speed);
@@ -809,21 +1005,16 @@ void swerve_chassis_vector_to_wheel_vector(fp32 vx_set, fp32 vy_set, fp32 wz_set
 	wheel_velocity[3][1] = -wheel_velocity[3][1];
 #endif
 
-	static fp32 last_steer_wheel_angle_target[4];
-	static uint8_t reverse_flag[4];
 	uint8_t i;
 	// On the edge of turning off, vx,vy,vz are all zero yet 6020 still needs to turn
-	uint8_t fNoChangeUniversal = ((chassis_move.fHipDisabledEdge == 0) && (fabs(vy_set) <= STEER_TURN_X_SPEED_DEADZONE) && (fabs(vx_set) < STEER_TURN_X_SPEED_DEADZONE) && (fabs(wz_set) < STEER_TURN_W_SPEED_DEADZONE));
+	uint8_t fNoChangeUniversal = ((chassis_move.fHipDisabledEdge == 0) && (fabsf(vy_set) <= STEER_TURN_X_SPEED_DEADZONE) && (fabsf(vx_set) < STEER_TURN_X_SPEED_DEADZONE) && (fabsf(wz_set) < STEER_TURN_W_SPEED_DEADZONE));
 	uint8_t fNoChangeUnique;
 	for (i = 0; i < 4; i++)
 	{
-		// drive wheel speed
-		wheel_speed[i] = sqrt(pow(wheel_velocity[i][0], 2) + pow(wheel_velocity[i][1], 2));
-
 		// determine whether to calculate steering wheel angle again
 		if (chassis_move.fHipEnabled)
 		{
-			fNoChangeUnique = (fabs(chassis_move.target_wheel_rot_radii_dot[i]) < STEER_TURN_HIP_RADIUS_SPEED_DEADZONE);
+			fNoChangeUnique = (fabsf(chassis_move.target_wheel_rot_radii_dot[i]) < STEER_TURN_HIP_RADIUS_SPEED_DEADZONE);
 		}
 		else
 		{
@@ -839,30 +1030,9 @@ void swerve_chassis_vector_to_wheel_vector(fp32 vx_set, fp32 vy_set, fp32 wz_set
 			}
 		}
 
-		if (fNoChangeUniversal && fNoChangeUnique)
-		{
-			steer_wheel_angle[i] = last_steer_wheel_angle_target[i];
-		}
-		else
-		{
-			// (https://en.cppreference.com/w/c/numeric/math/atan2)
-			// steer_wheel_angle: unit rad; range is [-PI, PI]; positive direction is clockwise
-			steer_wheel_angle[i] = atan2f(wheel_velocity[i][1], wheel_velocity[i][0]);
-
-			reverse_flag[i] = (fabs(rad_format(steer_wheel_angle[i] - last_steer_wheel_angle_target[i])) > PI / 2);
-			if (reverse_flag[i])
-			{
-				// if angle between last and target is greater than 90 deg, simply reverse drive wheel reduces time to turn
-				steer_wheel_angle[i] = rad_format(steer_wheel_angle[i] + PI);
-			}
-
-			last_steer_wheel_angle_target[i] = steer_wheel_angle[i];
-		}
-
-		if (reverse_flag[i])
-		{
-			wheel_speed[i] = -wheel_speed[i];
-		}
+		// steer_wheel_angle: unit rad; range is [-PI, PI]; positive direction is clockwise
+		// shortest steering time from the modelled 6020 angle, drive wheel reversed if that is faster
+		steer_wheel_angle[i] = swerve_module_optimize(&chassis_move.steer_motor_chassis[i].module, wheel_velocity[i][0], wheel_velocity[i][1], (fNoChangeUniversal && fNoChangeUnique), &wheel_speed[i]);
 	}
 
 	// reverse direction because of special initial direction
@@ -1011,9 +1181,10 @@ static void chassis_control_loop(void)
 		// calculate pid
 		for (i = 0; i < 4; i++)
 		{
-			PID_calc(&chassis_move.motor_speed_pid[i], chassis_move.motor_chassis[i].speed, chassis_move.motor_chassis[i].speed_set, CHASSIS_CONTROL_TIME_S);
+			PID_calc(&chassis_move.motor_speed_pid[i], chassis_move.motor_chassis[i].speed, chassis_move.motor_chassis[i].speed_set, chassis_loop_timing.dt);
 		}
 
+		chassis_traction_control();
 		chassis_power_control();
 
 		for (i = 0; i < 4; i++)
@@ -23,6 +23,7 @@
 #include "pid.h"
 #include "remote_control.h"
 #include "user_lib.h"
+#include "swerve_module_optimizer.h"
 
 // default values
 #define SPINNING_CHASSIS_MAX_OMEGA RPM_TO_RADS(60.0f)
@@ -31,12 +32,22 @@
 #define SPINNING_CHASSIS_LOW_OMEGA (SPINNING_CHASSIS_MAX_OMEGA * 0.583f)
 #define SPINNING_CHASSIS_ULTRA_LOW_OMEGA (SPINNING_CHASSIS_MAX_OMEGA * 0.167f)
 
+// spinning: the gimbal frame command is rotated by the relative angle predicted for the middle of the period it is
+// held, plus the feedback-to-command latency and the age of the gimbal task's reading, instead of the angle sampled
+// at the start of the period
+#define CHASSIS_SPIN_COMPENSATION_ENABLE 1
+#define CHASSIS_SPIN_COMP_RATE_FILTER_COEFF 0.1f
+// yaw motor feedback is read asynchronously at 1kHz, half a period old on average; add the wheel speed loop response time once measured
+#define CHASSIS_SPIN_COMP_EXTRA_LEAD_S 0.0005f
+
 // in the beginning of task ,wait a time
 #define CHASSIS_TASK_INIT_TIME 357
 
-#define CHASSIS_ACCEL_WZ_NUM 0.06f
-#define CHASSIS_ACCEL_X_NUM 0.5f
-#define CHASSIS_ACCEL_Y_NUM 0.5f
+// set-point shaping (S-curve): max acceleration scales with referee power limit, max jerk reaches it in CHASSIS_CMD_JERK_TIME_S
+#define CHASSIS_CMD_ACCEL_PER_WATT 0.05f // m/s^2 per W, 3m/s^2 at 60W
+#define CHASSIS_CMD_BRAKE_ACCEL_RATIO 2.0f // slowing down, a stop command is not shaped
+#define CHASSIS_CMD_JERK_TIME_S 0.1f
+#define CHASSIS_CMD_MIN_POWER_LIMIT 40.0f
 
 // joystick value deadline
 #define CHASSIS_RC_DEADLINE 20
@@ -61,6 +72,9 @@
 #define CHASSIS_ALPHA_WORKSPACE_PEAK 0.206667f
 #define CHASSIS_H_WORKSPACE_SLOPE1 0.302051f
 #define CHASSIS_H_WORKSPACE_SLOPE2 (-0.231672f)
+// workspace edges as alpha per height, so the limit is a multiply instead of a divide
+#define CHASSIS_H_WORKSPACE_SLOPE1_INV (1.0f / CHASSIS_H_WORKSPACE_SLOPE1)
+#define CHASSIS_H_WORKSPACE_SLOPE2_INV (1.0f / CHASSIS_H_WORKSPACE_SLOPE2)
 // @TODO: calculate for roll and pitch limits
 #define CHASSIS_ROLL_UPPER_LIMIT (PI / 4.0f)
 #define CHASSIS_PITCH_UPPER_LIMIT (PI / 4.0f)
@@ -84,9 +98,24 @@
 #define MOTOR_DISTANCE_TO_CENTER_DEFAULT 0.235f
 #endif
 
+#if (ROBOT_TYPE == INFANTRY_2024_BIPED)
+// wheels are driven by the biped controller board, chassis task runs on a fixed period
+#define CHASSIS_EVENT_DRIVEN_LOOP 0
 #define CHASSIS_CONTROL_TIME_MS 5.0f
+#else
+// chassis task wakes up when feedback of all four M3508 has arrived (1kHz), so speed PIDs always run on fresh data
+#define CHASSIS_EVENT_DRIVEN_LOOP 1
+#define CHASSIS_CONTROL_TIME_MS 1.0f
+// fallback when a wheel is offline, unit: tick (ms)
+#define CHASSIS_FEEDBACK_TIMEOUT_MS 2
+#endif
+// print chassis loop period and control-to-actuation latency over usb once per second
+#define CHASSIS_LOOP_TIMING_USB_REPORT 0
 #define CHASSIS_CONTROL_TIME_S (CHASSIS_CONTROL_TIME_MS / 1000.0f)
 #define CHASSIS_CONTROL_FREQUENCE (1.0f / CHASSIS_CONTROL_TIME_S)
+// bounds of the measured loop period the chassis integrates over, a stall isn't integrated in one step
+#define CHASSIS_CONTROL_TIME_MIN_S (0.5f * CHASSIS_CONTROL_TIME_S)
+#define CHASSIS_CONTROL_TIME_MAX_S (4.0f * CHASSIS_CONTROL_TIME_S)
 
 // chassis 3508 max motor control current
 #define MAX_3508_MOTOR_CAN_CURRENT 16000.0f
@@ -143,6 +172,7 @@
 #define STEER_TURN_W_SPEED_DEADZONE 0.01f
 // Measured approx max in normal mode: 0.159f
 #define STEER_TURN_HIP_RADIUS_SPEED_DEADZONE 0.01f
+#define STEER_MOTOR_UPSIDE_DOWN_MOUNTING 0
 #elif (ROBOT_TYPE == INFANTRY_2024_BIPED)
 #define BIPED_W_SPEED_DEADZONE 0.01f
 #define BIPED_X_SPEED_DEADZONE 0.01f
@@ -264,10 +294,25 @@ typedef union
 
 extern supcap_t cap_message_rx;
 
+typedef struct
+{
+	uint32_t loop_count;
+	uint32_t timeout_count;  // loops started by timeout instead of wheel feedback
+	fp32 period_us;          // last loop period
+	fp32 dt;                 // s, last loop period within the bounds, CHASSIS_CONTROL_TIME_S on a fixed period loop
+	fp32 period_max_us;
+	fp32 latency_us;         // last delay from complete wheel feedback to chassis command queued on CAN
+	fp32 latency_avg_us;
+	fp32 latency_max_us;
+} chassis_loop_timing_t;
+
+extern chassis_loop_timing_t chassis_loop_timing;
+
 #if (ROBOT_TYPE == INFANTRY_2023_SWERVE)
 typedef struct
 {
 	uint16_t target_ecd; ///< unit encoder unit; range is [0, 8191]; positive direction is clockwise; forward direction of chassis is 0 ecd
+	swerve_module_t module; ///< steering target, modelled steering angle and drive direction
 } chassis_steer_motor_t;
 #endif
 
@@ -300,24 +345,25 @@ typedef struct
 	pid_type_def motor_speed_pid[4];           // motor speed PID
 #endif
 
-	first_order_filter_type_t chassis_cmd_slow_set_vx; // use first order filter to slow set-point
-	first_order_filter_type_t chassis_cmd_slow_set_vy; // use first order filter to slow set-point
-	first_order_filter_type_t chassis_cmd_slow_set_wz; // use first order filter to slow set-point
+	s_curve_ramp_type_t chassis_cmd_slow_set_vx; // use S-curve ramp to bound set-point acceleration and jerk
+	s_curve_ramp_type_t chassis_cmd_slow_set_vy; // use S-curve ramp to bound set-point acceleration and jerk
+	s_curve_ramp_type_t chassis_cmd_slow_set_wz; // use S-curve ramp to bound set-point acceleration and jerk
 
-#if !(ROBOT_TYPE == INFANTRY_2023_SWERVE)
 	fp32 vx; // chassis vertical speed, positive means forward,unit m/s
 	fp32 vy; // chassis horizontal speed, positive means letf,unit m/s
 	fp32 wz; // chassis rotation speed, positive means counterclockwise,unit rad/s
-#endif
 	fp32 vx_set;                     // chassis set vertical speed,positive means forward,unit m/s
 	fp32 vy_set;                     // chassis set horizontal speed,positive means left,unit m/s
 	fp32 wz_set;                     // chassis set rotation speed,positive means counterclockwise,unit rad/s
 	fp32 chassis_relative_angle_set; // the set relative angle
+	fp32 relative_angle_dot;         // filtered rate of the gimbal yaw relative angle, unit rad/s
+	fp32 relative_angle_last;
 	fp32 chassis_yaw_set;
 
 	fp32 vx_max_speed; // max forward speed, unit m/s
 	fp32 vy_max_speed; // max letf speed, unit m/s
 	fp32 wz_max_speed; // max spinning speed, unit rad/s.
+	fp32 accel_max;    // max set-point acceleration from power level, unit m/s^2
 
 	fp32 chassis_yaw;   // the yaw angle calculated by gyro sensor and gimbal motor
 	fp32 chassis_pitch; // the pitch angle calculated by gyro sensor and gimbal motor
@@ -333,7 +379,7 @@ typedef struct
 } chassis_move_t;
 
 /**
- * @brief          chassis task, osDelay CHASSIS_CONTROL_TIME_MS (2ms)
+ * @brief          chassis task, triggered by wheel feedback every CHASSIS_CONTROL_TIME_MS (1ms)
  * @param[in]      pvParameters: null
  * @retval         none
  */
@@ -0,0 +1,131 @@
+/**
+ * @file       chassis_traction_control.c/h
+ * @brief      Wheel slip detection and per-wheel torque limiting for mecanum chassis
+ * @arthur     MacFalcons Control Team
+ */
+#include "chassis_traction_control.h"
+#include "chassis_task.h"
+#include "chassis_odometry.h"
+#include "user_lib.h"
+#include "math.h"
+
+chassis_traction_control_t chassis_traction_control_data;
+
+#if (ROBOT_CHASSIS_USE_MECANUM && CHASSIS_TRACTION_CONTROL_ENABLE)
+// wheel speed = WHEEL_SX * vx + WHEEL_SY * vy - R * wz, see mecanum_chassis_vector_to_wheel_speed
+static const fp32 WHEEL_SX[4] = {-1.0f, 1.0f, 1.0f, -1.0f};
+static const fp32 WHEEL_SY[4] = {-1.0f, -1.0f, 1.0f, 1.0f};
+// redundant direction of mecanum kinematics: sum(WHEEL_N * speed) is 0 without slip
+static const fp32 WHEEL_N[4] = {1.0f, -1.0f, 1.0f, -1.0f};
+#endif
+
+void chassis_traction_control_init(void)
+{
+    chassis_traction_control_data.vx_est = 0.0f;
+    chassis_traction_control_data.vy_est = 0.0f;
+    chassis_traction_control_data.wz_est = 0.0f;
+    chassis_traction_control_data.excluded_wheel = TRACTION_NO_WHEEL_EXCLUDED;
+    chassis_traction_control_data.slip_mask = 0;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        chassis_traction_control_data.wheel_slip[i] = 0.0f;
+        chassis_traction_control_data.current_limit[i] = MAX_3508_MOTOR_CAN_CURRENT;
+    }
+}
+
+void chassis_traction_control(void)
+{
+#if (ROBOT_CHASSIS_USE_MECANUM && CHASSIS_TRACTION_CONTROL_ENABLE)
+    chassis_traction_control_t *tc = &chassis_traction_control_data;
+    fp32 radius = chassis_move.wheel_rot_radii[0];
+    fp32 speed[4];
+    fp32 vx_kin = 0.0f;
+    fp32 vy_kin = 0.0f;
+    fp32 wz_kin = 0.0f;
+    fp32 residual = 0.0f;
+    uint8_t i;
+
+    fp32 vx_pred = tc->vx_est + chassis_odometry_data.accel_x * chassis_loop_timing.dt;
+    fp32 vy_pred = tc->vy_est + chassis_odometry_data.accel_y * chassis_loop_timing.dt;
+
+    // least squares kinematics of all four wheels, same as chassis_feedback_update
+    for (i = 0; i < 4; i++)
+    {
+        speed[i] = chassis_move.motor_chassis[i].speed;
+        vx_kin += 0.25f * WHEEL_SX[i] * speed[i];
+        vy_kin += 0.25f * WHEEL_SY[i] * speed[i];
+        wz_kin -= 0.25f * speed[i] / radius;
+        residual += WHEEL_N[i] * speed[i];
+    }
+
+    // leaving wheel k out is the same as moving its speed by -WHEEL_N[k] * residual, keep the three wheels closest to imu
+    uint8_t best_wheel = 0;
+    fp32 best_error = -1.0f;
+    fp32 best_vx = vx_kin;
+    fp32 best_vy = vy_kin;
+    fp32 best_wz = wz_kin;
+    for (i = 0; i < 4; i++)
+    {
+        fp32 shift = -WHEEL_N[i] * residual;
+        fp32 vx_k = vx_kin + 0.25f * WHEEL_SX[i] * shift;
+        fp32 vy_k = vy_kin + 0.25f * WHEEL_SY[i] * shift;
+        fp32 error = sqrtf((vx_k - vx_pred) * (vx_k - vx_pred) + (vy_k - vy_pred) * (vy_k - vy_pred));
+        if ((best_error < 0.0f) || (error < best_error))
+        {
+            best_error = error;
+            best_wheel = i;
+            best_vx = vx_k;
+            best_vy = vy_k;
+            best_wz = wz_kin - 0.25f * shift / radius;
+        }
+    }
+
+    fp32 correction;
+    if (best_error < TRACTION_CONSISTENT_SPEED)
+    {
+        correction = chassis_loop_timing.dt / TRACTION_WHEEL_TRUST_TIME_S;
+        tc->excluded_wheel = (fabsf(residual) > TRACTION_CONSISTENT_SPEED) ? best_wheel : TRACTION_NO_WHEEL_EXCLUDED;
+    }
+    else
+    {
+        correction = chassis_loop_timing.dt / TRACTION_IMU_TRUST_TIME_S;
+        tc->excluded_wheel = best_wheel;
+    }
+    tc->vx_est = vx_pred + correction * (best_vx - vx_pred);
+    tc->vy_est = vy_pred + correction * (best_vy - vy_pred);
+    tc->wz_est = best_wz;
+
+    uint8_t last_slip_mask = tc->slip_mask;
+    tc->slip_mask = 0;
+    for (i = 0; i < 4; i++)
+    {
+        pid_type_def *pid = &chassis_move.motor_speed_pid[i];
+        fp32 ground_speed = WHEEL_SX[i] * tc->vx_est + WHEEL_SY[i] * tc->vy_est - radius * tc->wz_est;
+        tc->wheel_slip[i] = speed[i] - ground_speed;
+
+        // only slip driven by the wheel's own torque is limited, a wheel dragged by the others is left alone
+        if ((fabsf(tc->wheel_slip[i]) > TRACTION_SLIP_SPEED + TRACTION_SLIP_RATIO * fabsf(ground_speed)) && (tc->wheel_slip[i] * pid->out > 0.0f))
+        {
+            tc->slip_mask |= (1 << i);
+            if ((last_slip_mask & (1 << i)) == 0)
+            {
+                tc->current_limit[i] = fminf(tc->current_limit[i], fabsf(pid->out)) * TRACTION_LIMIT_DROP;
+            }
+            else
+            {
+                // still slipping, keep lowering twice as fast as recovery
+                tc->current_limit[i] -= 2.0f * TRACTION_RECOVER_RATE * chassis_loop_timing.dt;
+            }
+            tc->current_limit[i] = fmaxf(tc->current_limit[i], TRACTION_MIN_CURRENT);
+        }
+        else
+        {
+            tc->current_limit[i] = fminf(tc->current_limit[i] + TRACTION_RECOVER_RATE * chassis_loop_timing.dt, MAX_3508_MOTOR_CAN_CURRENT);
+        }
+
+        pid->out = fp32_constrain(pid->out, -tc->current_limit[i], tc->current_limit[i]);
+        // integral follows the limit, otherwise it winds up while the wheel is held back
+        pid->Iout = fp32_constrain(pid->Iout, -tc->current_limit[i], tc->current_limit[i]);
+    }
+#endif
+}
@@ -0,0 +1,59 @@
+/**
+ * @file       chassis_traction_control.c/h
+ * @brief      Wheel slip detection and per-wheel torque limiting for mecanum chassis
+ * @arthur     MacFalcons Control Team
+ * Mecanum wheel speeds w = J * (vx, vy, wz) have only one redundant direction, n = (1, -1, 1, -1), so a slipping
+ * wheel can't be told apart from the other three by kinematics alone. Chassis velocity is therefore estimated by a
+ * complementary filter: INS acceleration (chassis frame, from chassis_odometry) is integrated, and corrected by
+ * the wheel kinematics solved from the three wheels that agree best with the integrated velocity.
+ * Each wheel is compared with the speed the estimated chassis motion implies for it. A wheel running ahead of the
+ * ground in the direction of its torque is slipping: its current limit drops, then ramps back while it grips again.
+ */
+#ifndef CHASSIS_TRACTION_CONTROL_H
+#define CHASSIS_TRACTION_CONTROL_H
+#include "global_inc.h"
+
+#define CHASSIS_TRACTION_CONTROL_ENABLE 1
+
+// velocity estimate: time constant of the correction toward wheel kinematics
+#define TRACTION_WHEEL_TRUST_TIME_S 0.02f   // wheels agree with imu
+#define TRACTION_IMU_TRUST_TIME_S 2.0f      // wheels disagree: all may be spinning, mostly integrate imu
+#define TRACTION_CONSISTENT_SPEED 0.1f      // m/s, max disagreement between imu and wheel kinematics still trusted
+// slip: |wheel speed - ground speed| above TRACTION_SLIP_SPEED + TRACTION_SLIP_RATIO * |ground speed|
+#define TRACTION_SLIP_SPEED 0.2f            // m/s
+#define TRACTION_SLIP_RATIO 0.15f
+// torque limiting, unit of CAN current command
+#define TRACTION_LIMIT_DROP 0.7f            // limit becomes this ratio of the current that made the wheel slip
+#define TRACTION_MIN_CURRENT 2000.0f
+#define TRACTION_RECOVER_RATE 40000.0f      // per second, full range in 0.4s
+
+#define TRACTION_NO_WHEEL_EXCLUDED 0xFF
+
+typedef struct
+{
+    fp32 vx_est;               // m/s, same convention as chassis_move.vx
+    fp32 vy_est;
+    fp32 wz_est;               // rad/s
+    uint8_t excluded_wheel;    // wheel left out of the kinematic velocity, TRACTION_NO_WHEEL_EXCLUDED if wheels agree with imu
+
+    fp32 wheel_slip[4];        // m/s, wheel speed minus ground speed
+    fp32 current_limit[4];
+    uint8_t slip_mask;         // bit i: wheel i is slipping
+} chassis_traction_control_t;
+
+extern chassis_traction_control_t chassis_traction_control_data;
+
+/**
+  * @brief          traction control init, velocity estimate reset and current limits opened
+  * @retval         none
+  */
+extern void chassis_traction_control_init(void);
+
+/**
+  * @brief          update chassis velocity estimate and limit the output of the four motor_speed_pid of slipping wheels.
+  *                 Call after PID_calc and before chassis_power_control
+  * @retval         none
+  */
+extern void chassis_traction_control(void);
+
+#endif
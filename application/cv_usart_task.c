@@ -19,6 +19,7 @@
 #include "usart.h"
 #include "referee.h"
 #include "gimbal_task.h"
+#include "chassis_odometry.h"
 #if DEBUG_CV_WITH_USB
 #include "usb_task.h"
 #include <stdio.h>
@@ -44,6 +45,7 @@ typedef enum
 {
 	MSG_MODE_CONTROL = 0x10,
 	MSG_CV_CMD = 0x20,
+	MSG_CV_TARGET = 0x21,
 	MSG_ACK = 0x40,
 	MSG_INFO_REQUEST = 0x50,
 	MSG_INFO_DATA = 0x51,
@@ -55,7 +57,9 @@ typedef enum
 	CV_INFO_CVSYNCTIME_BIT = 1 << 1,
 	CV_INFO_REF_STATUS_BIT = 1 << 2,
 	CV_INFO_GIMBAL_ANGLE_BIT = 1 << 3,
-	CV_INFO_LAST_BIT = 1 << 4,
+	CV_INFO_CHASSIS_POSE_BIT = 1 << 4,
+	CV_INFO_CHASSIS_VELOCITY_BIT = 1 << 5,
+	CV_INFO_LAST_BIT = 1 << 6,
 } eInfoBits;
 STATIC_ASSERT(CV_INFO_LAST_BIT <= (1 << 8));
 
@@ -89,6 +93,24 @@ typedef struct __attribute__((packed))
 } tGimbalAngleMsgPayload;
 STATIC_ASSERT(sizeof(tGimbalAngleMsgPayload) <= DATA_PACKAGE_PAYLOAD_SIZE);
 
+typedef struct __attribute__((packed))
+{
+	uint8_t infobit;
+	fp32 x;   ///< unit: m, odometry frame
+	fp32 y;   ///< unit: m
+	fp32 yaw; ///< unit: rad
+} tChassisPoseMsgPayload;
+STATIC_ASSERT(sizeof(tChassisPoseMsgPayload) <= DATA_PACKAGE_PAYLOAD_SIZE);
+
+typedef struct __attribute__((packed))
+{
+	uint8_t infobit;
+	fp32 vx; ///< unit: m/s, chassis frame
+	fp32 vy; ///< unit: m/s
+	fp32 wz; ///< unit: rad/s
+} tChassisVelocityMsgPayload;
+STATIC_ASSERT(sizeof(tChassisVelocityMsgPayload) <= DATA_PACKAGE_PAYLOAD_SIZE);
+
 typedef union __attribute__((packed))
 {
 	struct __attribute__((packed))
@@ -102,6 +124,8 @@ typedef union __attribute__((packed))
 			tCvAckMsgPayload CvAckMsgPayload;
 			tRefStatusMsgPayload RefStatusMsgPayload;
 			tGimbalAngleMsgPayload GimbalAngleMsgPayload;
+			tChassisPoseMsgPayload ChassisPoseMsgPayload;
+			tChassisVelocityMsgPayload ChassisVelocityMsgPayload;
 		};
 	} tData;
 	uint8_t abData[DATA_PACKAGE_SIZE];
@@ -328,6 +352,22 @@ void CvCmder_SendInfoData(eInfoBits InfoBit)
 			CvTxBuffer.tData.GimbalAngleMsgPayload.gimbal_pitch_angle = get_gimbal_pitch_angle();
 			break;
 		}
+		case CV_INFO_CHASSIS_POSE_BIT:
+		{
+			const chassis_odometry_t *odom = get_chassis_odometry_point();
+			CvTxBuffer.tData.ChassisPoseMsgPayload.x = odom->x;
+			CvTxBuffer.tData.ChassisPoseMsgPayload.y = odom->y;
+			CvTxBuffer.tData.ChassisPoseMsgPayload.yaw = odom->yaw;
+			break;
+		}
+		case CV_INFO_CHASSIS_VELOCITY_BIT:
+		{
+			const chassis_odometry_t *odom = get_chassis_odometry_point();
+			CvTxBuffer.tData.ChassisVelocityMsgPayload.vx = odom->vx;
+			CvTxBuffer.tData.ChassisVelocityMsgPayload.vy = odom->vy;
+			CvTxBuffer.tData.ChassisVelocityMsgPayload.wz = odom->wz;
+			break;
+		}
 		default:
 		{
 			// should not reach here
@@ -354,6 +394,7 @@ void CvCmder_RxParser(void)
 				CvCmder_UpdateTranDelta();
 				memcpy(&(CvCmdHandler.CvCmdMsg), CvRxBuffer.tData.abPayload, sizeof(CvCmdHandler.CvCmdMsg));
 				CvCmdHandler.fCvCmdValid = 1;
+				CvCmdHandler.ulCmdMsgTime = osKernelSysTick();
 			}
 			else
 			{
@@ -361,6 +402,18 @@ void CvCmder_RxParser(void)
 			}
 			break;
 		}
+		case MSG_CV_TARGET:
+		{
+			// optional, cv without it leaves the gravity drop to itself
+			fValid = (memcmp(&CvRxBuffer.tData.abPayload[sizeof(tCvTargetMsg)], abExpectedUnusedPayload, DATA_PACKAGE_PAYLOAD_SIZE - sizeof(tCvTargetMsg)) == 0);
+			if (fValid)
+			{
+				CvCmder_UpdateTranDelta();
+				memcpy(&(CvCmdHandler.CvTargetMsg), CvRxBuffer.tData.abPayload, sizeof(CvCmdHandler.CvTargetMsg));
+				CvCmdHandler.ulTargetMsgTime = osKernelSysTick();
+			}
+			break;
+		}
 		case MSG_ACK:
 		{
 			fValid = (memcmp(CvRxBuffer.tData.CvAckMsgPayload.abUnusedPayload, abExpectedUnusedPayload, DATA_PACKAGE_PAYLOAD_SIZE - sizeof(tCvAckMsgPayload)) == 0);
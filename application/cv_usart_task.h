@@ -12,6 +12,8 @@
 #include "remote_control.h"
 
 #define CV_CONTROL_TIME_MS 500.0f
+// target range older than this is not used for ballistic compensation
+#define CV_TARGET_MSG_TIMEOUT_MS 200
 
 #if CV_INTERFACE
 
@@ -23,6 +25,11 @@ typedef struct __attribute__((packed))
     fp32 ySpeed;
 } tCvCmdMsg;
 
+typedef struct __attribute__((packed))
+{
+    fp32 fTargetRange; ///< unit: m, line of sight distance from the muzzle to the target
+} tCvTargetMsg;
+
 typedef enum
 {
     CV_MODE_AUTO_AIM_BIT = 1 << 0,
@@ -41,6 +48,9 @@ STATIC_ASSERT(CV_MODE_LAST_BIT <= (1 << 8));
 typedef struct
 {
     tCvCmdMsg CvCmdMsg;
+    tCvTargetMsg CvTargetMsg;
+    uint32_t ulTargetMsgTime; ///< system time of the latest target msg
+    uint32_t ulCmdMsgTime; ///< system time of the latest valid cmd msg, CV sends them while it holds a target
     uint8_t fCvCmdValid; ///< to be used by gimbal_task, but not chassis_task. chassis_task should maintain previous speed if cv is offline for a short time
     uint8_t fIsWaitingForAck;
     uint8_t fCvMode; ///< contains individual CV control flag bits defined by eModeControlBits
@@ -0,0 +1,162 @@
+/**
+ * @file       fire_scheduler.c/h
+ * @brief      Burst fire scheduler: plans the time of every trigger step of a requested burst against barrel heat,
+ *             cooling and the remaining projectile allowance, and feeds the steps with position control
+ * @arthur     MacFalcons Control Team
+ */
+#include "fire_scheduler.h"
+#include "shoot.h"
+#include "shoot_heat.h"
+#include "detect_task.h"
+#include "referee.h"
+#include "math.h"
+
+fire_scheduler_t fire_scheduler_data;
+
+static void fire_scheduler_update_allowance(void);
+
+void fire_scheduler_init(void)
+{
+    fire_scheduler_data.last_step_time = 0;
+    fire_scheduler_data.step_count = 0;
+    fire_scheduler_data.last_allowance_update = get_projectile_allowance_update_count();
+    fire_scheduler_data.allowance_shot_count = shoot_heat_data.shot_count;
+    fire_scheduler_data.allowance = FIRE_SCHEDULER_NO_ALLOWANCE_LIMIT;
+    fire_scheduler_data.planned_shots = 0;
+    fire_scheduler_reset();
+}
+
+uint16_t fire_scheduler_plan(fp32 heat, fp32 heat_limit, fp32 cooling_rate, uint16_t count, uint16_t first_time, uint16_t *plan_time)
+{
+    // a bullet never fits under this limit, however long the barrel cools
+    if (heat_limit < SHOOT_HEAT_PER_BULLET + SHOOT_HEAT_MARGIN)
+    {
+        return 0;
+    }
+    if (count > FIRE_SCHEDULER_MAX_BURST)
+    {
+        count = FIRE_SCHEDULER_MAX_BURST;
+    }
+
+    fp32 time = first_time;
+    fp32 last_time = 0.0f;
+    uint16_t planned;
+    for (planned = 0; planned < count; planned++)
+    {
+        fp32 excess = heat - cooling_rate * (time - last_time) / 1000.0f + SHOOT_HEAT_PER_BULLET + SHOOT_HEAT_MARGIN - heat_limit;
+        if (excess > 0.0f)
+        {
+            if (cooling_rate <= 0.0f)
+            {
+                break;
+            }
+            time += excess / cooling_rate * 1000.0f;
+        }
+        if (time > 65535.0f)
+        {
+            break;
+        }
+        heat = fmaxf(heat - cooling_rate * (time - last_time) / 1000.0f, 0.0f) + SHOOT_HEAT_PER_BULLET;
+        plan_time[planned] = (uint16_t)ceilf(time);
+        last_time = time;
+        time += FIRE_SCHEDULER_MIN_INTERVAL_MS;
+    }
+    return planned;
+}
+
+void fire_scheduler_reset(void)
+{
+    fire_scheduler_data.requested = 0;
+    fire_scheduler_data.target_ecd = shoot_heat_data.trigger_ecd;
+    fire_scheduler_data.trigger_speed_set = 0.0f;
+}
+
+void fire_scheduler_request(uint16_t count)
+{
+    uint16_t requested = fire_scheduler_data.requested + count;
+    fire_scheduler_data.requested = (requested > FIRE_SCHEDULER_MAX_BURST) ? FIRE_SCHEDULER_MAX_BURST : requested;
+}
+
+void fire_scheduler_hold(uint16_t count)
+{
+    if (fire_scheduler_data.requested < count)
+    {
+        fire_scheduler_data.requested = count;
+    }
+}
+
+void fire_scheduler_cancel(void)
+{
+    fire_scheduler_data.requested = 0;
+}
+
+fp32 fire_scheduler_update(uint32_t now_ms)
+{
+    fire_scheduler_t *scheduler = &fire_scheduler_data;
+    fire_scheduler_update_allowance();
+
+    // steps whose projectile hasn't left yet count as fired
+    int32_t error_ecd = (int32_t)(scheduler->target_ecd - shoot_heat_data.trigger_ecd);
+    int32_t unfired_ecd = error_ecd - (int32_t)(FIRE_SCHEDULER_SLOT_ECD * (1.0f - SHOOT_HEAT_SHOT_PHASE));
+    uint16_t unfired = (unfired_ecd > 0) ? (uint16_t)(unfired_ecd / FIRE_SCHEDULER_SLOT_ECD + 1) : 0;
+    fp32 heat = shoot_heat_data.heat + SHOOT_HEAT_PER_BULLET * unfired;
+    fp32 heat_limit = toe_is_error(REFEREE_TOE) ? FIRE_SCHEDULER_NO_HEAT_LIMIT : shoot_heat_data.heat_limit;
+    uint16_t allowance = (scheduler->allowance > unfired) ? (scheduler->allowance - unfired) : 0;
+
+    uint16_t count = (scheduler->requested < allowance) ? scheduler->requested : allowance;
+    int32_t since_step = (int32_t)(now_ms - scheduler->last_step_time);
+    uint16_t first_time = ((scheduler->step_count == 0) || (since_step >= FIRE_SCHEDULER_MIN_INTERVAL_MS)) ? 0 : (uint16_t)(FIRE_SCHEDULER_MIN_INTERVAL_MS - since_step);
+    scheduler->planned_shots = fire_scheduler_plan(heat, heat_limit, shoot_heat_data.cooling_rate, count, first_time, scheduler->plan_time);
+    // out of allowance, or a limit the cooling can't reach
+    scheduler->requested = scheduler->planned_shots;
+
+    // a step due within this period goes now, timed from its planned time so the full fire rate isn't rounded down
+    if ((scheduler->planned_shots != 0) && (scheduler->plan_time[0] < SHOOT_CONTROL_TIME_MS))
+    {
+        scheduler->target_ecd += FIRE_SCHEDULER_SLOT_ECD;
+        error_ecd += FIRE_SCHEDULER_SLOT_ECD;
+        scheduler->requested--;
+        scheduler->last_step_time = now_ms + scheduler->plan_time[0];
+        scheduler->step_count++;
+    }
+
+    // no backing off an overshoot, the wheel only feeds
+    if (error_ecd <= FIRE_SCHEDULER_DONE_ECD)
+    {
+        scheduler->trigger_speed_set = 0.0f;
+    }
+    else
+    {
+        fp32 error = error_ecd * TRIGGER_MOTOR_ECD_TO_ANGLE * TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO;
+        scheduler->trigger_speed_set = fp32_constrain(FIRE_SCHEDULER_POSITION_KP * error, FIRE_SCHEDULER_MIN_TRIGGER_SPEED, FIRE_SCHEDULER_MAX_TRIGGER_SPEED);
+    }
+    return scheduler->trigger_speed_set;
+}
+
+bool_t fire_scheduler_is_idle(void)
+{
+    return (fire_scheduler_data.requested == 0) && ((int32_t)(fire_scheduler_data.target_ecd - shoot_heat_data.trigger_ecd) <= FIRE_SCHEDULER_DONE_ECD);
+}
+
+/**
+  * @brief          projectiles left, from the latest allowance report minus the shots counted since
+  * @retval         none
+  */
+static void fire_scheduler_update_allowance(void)
+{
+    fire_scheduler_t *scheduler = &fire_scheduler_data;
+    uint32_t allowance_update = get_projectile_allowance_update_count();
+    if (toe_is_error(REFEREE_TOE) || (is_game_started() == 0) || (allowance_update == 0))
+    {
+        scheduler->allowance = FIRE_SCHEDULER_NO_ALLOWANCE_LIMIT;
+        return;
+    }
+    if (allowance_update != scheduler->last_allowance_update)
+    {
+        scheduler->last_allowance_update = allowance_update;
+        scheduler->allowance_shot_count = shoot_heat_data.shot_count;
+    }
+    uint32_t fired = shoot_heat_data.shot_count - scheduler->allowance_shot_count;
+    uint16_t reported = get_projectile_allowance_17mm();
+    scheduler->allowance = (fired < reported) ? (uint16_t)(reported - fired) : 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file       fire_scheduler.c/h
+ * @brief      Burst fire scheduler: plans the time of every trigger step of a requested burst against barrel heat,
+ *             cooling and the remaining projectile allowance, and feeds the steps with position control
+ * @arthur     MacFalcons Control Team
+ * A burst is a number of shots requested by a click (semi auto) or kept topped up while the fire button or the CV
+ * shoot bit is held. Every shoot control period the remaining burst is planned again from the local heat model
+ * (shoot_heat.c): each shot goes at the earliest time that is at least FIRE_SCHEDULER_MIN_INTERVAL_MS after the
+ * previous one and that keeps the heat, cooled at the referee rate since, one bullet plus SHOOT_HEAT_MARGIN under the
+ * limit. Earliest-first is the most shots by any deadline, so a burst empties the heat headroom at full fire rate and
+ * then continues at the rate the cooling sustains. Shots beyond the projectile allowance are dropped from the plan.
+ * Once the first planned shot is due, the target of the trigger wheel advances by one ammo slot; a P position loop on
+ * the rotor ecd turns it into the trigger speed set-point, so a step cut short by a jam reverse is finished afterwards
+ * and the wheel rests on a slot boundary between bursts. Steps issued but not yet past SHOOT_HEAT_SHOT_PHASE are added
+ * to the heat before planning, the heat model only sees the projectile once it has left.
+ */
+#ifndef FIRE_SCHEDULER_H
+#define FIRE_SCHEDULER_H
+#include "global_inc.h"
+#include "shoot_heat.h"
+
+// 0: trigger at constant speed in auto fire, one step per click in semi auto, gated on shoot_heat_is_overheated()
+// @TODO: enable once validated on the robot; the allowance is counted from trigger steps until the friction wheel
+// shot detection is, see below
+#define SHOOT_FIRE_SCHEDULER 0
+// longest burst planned, shots
+#define FIRE_SCHEDULER_MAX_BURST 32
+// kept queued while fire is held, a release cancels the rest
+#define FIRE_SCHEDULER_HOLD_BURST 3
+// full fire rate, ms between steps
+#define FIRE_SCHEDULER_MIN_INTERVAL_MS ((uint16_t)(60000.0f / AUTO_FIRE_RATE))
+// trigger output shaft rad/s per rad of error
+#define FIRE_SCHEDULER_POSITION_KP 40.0f
+// trigger output shaft speed limits of a step, rad/s; slower than the min sticks on the trigger friction
+#define FIRE_SCHEDULER_MAX_TRIGGER_SPEED (1.5f * AUTO_FIRE_TRIGGER_SPEED)
+#define FIRE_SCHEDULER_MIN_TRIGGER_SPEED IDLE_TRIGGER_SPEED
+// rotor ecd of one ammo slot
+#define FIRE_SCHEDULER_SLOT_ECD ((int32_t)(TRIGGER_ANGLE_INCREMENT / TRIGGER_MOTOR_ECD_TO_ANGLE + 0.5f))
+// a step is done within this, rotor ecd
+#define FIRE_SCHEDULER_DONE_ECD ((int32_t)(TRIGGER_MOTOR_ANGLE_THRESHOLD / TRIGGER_MOTOR_ECD_TO_ANGLE))
+// heat limit without referee, never reached
+#define FIRE_SCHEDULER_NO_HEAT_LIMIT 1.0e6f
+// allowance without referee or before the game
+#define FIRE_SCHEDULER_NO_ALLOWANCE_LIMIT 0xFFFF
+
+#if SHOOT_FIRE_SCHEDULER && SHOOT_HEAT_FRICTION_SHOT_DETECTION
+#error "fire scheduler not validated with friction wheel shot detection"
+#endif
+
+typedef struct
+{
+    uint16_t requested;      // shots of the burst not stepped yet
+    uint32_t target_ecd;     // trigger rotor ecd the wheel is driven to, same scale as shoot_heat_data.trigger_ecd
+    uint32_t last_step_time; // ms
+    uint32_t step_count;
+
+    // allowance reports only include the shots the referee had seen
+    uint32_t last_allowance_update;
+    uint32_t allowance_shot_count; // shoot_heat_data.shot_count at the latest allowance report
+    uint16_t allowance;            // projectiles left now
+
+    // latest plan, offsets from the planning time
+    uint16_t planned_shots;
+    uint16_t plan_time[FIRE_SCHEDULER_MAX_BURST]; // ms
+    fp32 trigger_speed_set;                       // rad/s, output shaft, positive feeds
+} fire_scheduler_t;
+
+extern fire_scheduler_t fire_scheduler_data;
+
+/**
+  * @brief          plan the shot times of a burst, earliest first
+  * @param[in]      heat: current barrel heat, including shots on their way
+  * @param[in]      heat_limit: barrel heat limit
+  * @param[in]      cooling_rate: heat per second
+  * @param[in]      count: shots of the burst
+  * @param[in]      first_time: earliest time of the first shot, ms from now
+  * @param[out]     plan_time: time of every planned shot, ms from now
+  * @retval         number of planned shots, smaller than count if the heat can't allow the rest
+  */
+extern uint16_t fire_scheduler_plan(fp32 heat, fp32 heat_limit, fp32 cooling_rate, uint16_t count, uint16_t first_time, uint16_t *plan_time);
+
+/**
+  * @brief          scheduler init, after shoot_heat_init()
+  * @retval         none
+  */
+extern void fire_scheduler_init(void);
+
+/**
+  * @brief          drop any burst and hold the trigger where it is, call while the trigger isn't scheduled
+  * @retval         none
+  */
+extern void fire_scheduler_reset(void);
+
+/**
+  * @brief          add shots to the burst
+  * @param[in]      count: shots
+  * @retval         none
+  */
+extern void fire_scheduler_request(uint16_t count);
+
+/**
+  * @brief          keep at least this many shots queued, call every period while fire is held
+  * @param[in]      count: shots
+  * @retval         none
+  */
+extern void fire_scheduler_hold(uint16_t count);
+
+/**
+  * @brief          drop the shots not stepped yet, the current step is finished
+  * @retval         none
+  */
+extern void fire_scheduler_cancel(void);
+
+/**
+  * @brief          plan, issue due steps and run the position loop, call every shoot control period
+  * @param[in]      now_ms: system time
+  * @retval         trigger speed set-point, rad/s of the output shaft, positive feeds
+  */
+extern fp32 fire_scheduler_update(uint32_t now_ms);
+
+/**
+  * @brief          whether the burst is done and the wheel on its target
+  * @retval         1: idle
+  */
+extern bool_t fire_scheduler_is_idle(void);
+
+#endif
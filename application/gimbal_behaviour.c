@@ -57,8 +57,15 @@
 
 #include "user_lib.h"
 #include "cv_usart_task.h"
+#include "cmsis_os.h"
+#include "shoot.h"
+#include "muzzle_speed.h"
+#include "ballistic_solver.h"
+#include "gimbal_patrol.h"
 
 #define CV_ABS_ANGLE_INPUT 1 // 1 means abs angle input from cv, 0 means delta angle input from cv
+#define CV_BALLISTIC_COMPENSATION 1 // 1 means aim above the cv target for the projectile drop, once cv sends the target range
+#define SENTRY_AUTO_AIM_PATROL 1 // 1 means the sentry scans the field with gimbal_patrol.c while cv has no target, 0 means it holds still
 
 //when gimbal is being calibrated, set buzzer frequency and strength
 #define gimbal_warn_buzzer_on() buzzer_on(31, 20000)
@@ -143,6 +150,9 @@ static void gimbal_absolute_angle_control(fp32 *yaw, fp32 *pitch, gimbal_control
 #if CV_INTERFACE
 static void gimbal_cv_control(fp32 *yaw, fp32 *pitch, gimbal_control_t *gimbal_control_set);
 static void gimbal_cv_control_patrol(fp32 *yaw, fp32 *pitch, gimbal_control_t *gimbal_control_set);
+#if CV_BALLISTIC_COMPENSATION
+static fp32 gimbal_cv_ballistic_offset(fp32 line_of_sight);
+#endif
 #endif
 
 /**
@@ -168,6 +178,11 @@ static void gimbal_motionless_control(fp32 *yaw, fp32 *pitch, gimbal_control_t *
 // Watchout for the default value
 gimbal_behaviour_e gimbal_behaviour = GIMBAL_ZERO_FORCE;
 
+#if CV_INTERFACE
+static const patrol_sector_t patrol_sectors[] = PATROL_SECTOR_TABLE;
+static gimbal_patrol_t gimbal_patrol;
+#endif
+
 #if GIMBAL_TEST_MODE
 static void J_scope_gimbal_behavior_test(void)
 {
@@ -421,7 +436,9 @@ static void gimbal_behavour_set(gimbal_control_t *gimbal_mode_set)
 		{
 			case RC_SW_UP:
 			{
-#if (ROBOT_TYPE == SENTRY_2023_MECANUM)
+#if (ROBOT_TYPE == SENTRY_2023_MECANUM) && SENTRY_AUTO_AIM_PATROL
+                gimbal_behaviour = GIMBAL_AUTO_AIM_PATROL;
+#elif (ROBOT_TYPE == SENTRY_2023_MECANUM)
                 gimbal_behaviour = GIMBAL_AUTO_AIM;
 #else
                 gimbal_behaviour = GIMBAL_ABSOLUTE_ANGLE;
@@ -690,6 +707,9 @@ static void gimbal_cv_control(fp32 *yaw, fp32 *pitch, gimbal_control_t *gimbal_c
 #else
 		yaw_target_adjustment = -CvCmdHandler.CvCmdMsg.xAngle - rad_format(gimbal_control_set->gimbal_yaw_motor.absolute_angle_set - gimbal_control_set->gimbal_yaw_motor.absolute_angle);
 		pitch_target_adjustment = -CvCmdHandler.CvCmdMsg.yAngle - rad_format(gimbal_control_set->gimbal_pitch_motor.absolute_angle_set - gimbal_control_set->gimbal_pitch_motor.absolute_angle);
+#endif
+#if CV_BALLISTIC_COMPENSATION
+		pitch_target_adjustment += gimbal_cv_ballistic_offset(gimbal_control_set->gimbal_pitch_motor.absolute_angle_set + pitch_target_adjustment);
 #endif
 	}
     // brakeband_limit(yaw_target_adjustment, yaw_target_adjustment, CV_CAMERA_YAW_BRAKEBAND);
@@ -715,10 +735,71 @@ static void gimbal_cv_control_patrol(fp32 *yaw, fp32 *pitch, gimbal_control_t *g
         return;
     }
 
-    // @TODO: patrol mode state machine
-    *yaw = 0.0f;
-    *pitch = 0.0f;
+    static uint8_t fPatrolInit = 0;
+    static uint32_t ulLastCallTime = 0;
+    uint32_t ulSystemTime = osKernelSysTick();
+    uint8_t fEnterMode = (fPatrolInit == 0) || (ulSystemTime - ulLastCallTime > 2 * (uint32_t)GIMBAL_CONTROL_TIME_MS);
+    ulLastCallTime = ulSystemTime;
+    if (fPatrolInit == 0)
+    {
+        gimbal_patrol_init(&gimbal_patrol, patrol_sectors, sizeof(patrol_sectors) / sizeof(patrol_sectors[0]), GIMBAL_CONTROL_TIME_S);
+        fPatrolInit = 1;
+    }
+
+    // patrol angles are from the power-on heading, as the cv angles
+    fp32 yaw_set = rad_format(gimbal_control_set->gimbal_yaw_motor.absolute_angle_set - gimbal_control_set->gimbal_yaw_motor.absolute_angle_offset);
+    fp32 pitch_set = gimbal_control_set->gimbal_pitch_motor.absolute_angle_set - gimbal_control_set->gimbal_pitch_motor.absolute_angle_offset;
+    if (fEnterMode)
+    {
+        // start from the set-point, at rest
+        gimbal_patrol_reset(&gimbal_patrol, yaw_set, pitch_set);
+    }
+
+    if (ulSystemTime - CvCmdHandler.ulCmdMsgTime <= PATROL_CV_LOCK_TIMEOUT_MS)
+    {
+        // cv holds a target: follow it, the patrol searches there once it is lost
+        gimbal_cv_control(yaw, pitch, gimbal_control_set);
+        gimbal_patrol_mark_target(&gimbal_patrol, yaw_set + *yaw, pitch_set + *pitch);
+        return;
+    }
+
+    fp32 patrol_yaw;
+    fp32 patrol_pitch;
+    gimbal_patrol_calc(&gimbal_patrol, &patrol_yaw, &patrol_pitch);
+    *yaw = rad_format(patrol_yaw - yaw_set);
+    *pitch = patrol_pitch - pitch_set;
 }
+
+#if CV_BALLISTIC_COMPENSATION
+// latest solution, time of flight for lead prediction
+ballistic_solution_t cv_ballistic_solution;
+
+/**
+ * @brief          pitch increment from the cv line of sight to the launch angle that drops the projectile onto the target
+ * @param[in]      line_of_sight: absolute pitch angle of the target, unit rad, positive down as the IMU
+ * @retval         pitch increment, unit rad, positive down; 0 without a fresh target range or when out of reach
+ */
+static fp32 gimbal_cv_ballistic_offset(fp32 line_of_sight)
+{
+    if (osKernelSysTick() - CvCmdHandler.ulTargetMsgTime > CV_TARGET_MSG_TIMEOUT_MS)
+    {
+        return 0.0f;
+    }
+    // latest referee measurement, or what the friction wheel regulator expects before the first one
+    fp32 speed = shoot_control.bullet_init_speed[0];
+    if (speed < MUZZLE_SPEED_VALID_MIN)
+    {
+        speed = muzzle_speed_data.gain * muzzle_speed_data.speed_set;
+    }
+    fp32 elevation = -line_of_sight;
+    fp32 range = CvCmdHandler.CvTargetMsg.fTargetRange;
+    if (ballistic_solve(range * cosf(elevation), range * sinf(elevation), speed, BALLISTIC_SOLVER_DRAG_17MM, &cv_ballistic_solution) == 0)
+    {
+        return 0.0f;
+    }
+    return elevation - cv_ballistic_solution.pitch;
+}
+#endif
 #endif
 
 /**
@@ -0,0 +1,282 @@
+/**
+ * @file       gimbal_patrol.c/h
+ * @brief      Patrol scan pattern engine: yaw and pitch set-points that sweep the camera over the field while CV has no
+ *             target, within the gimbal rate limits
+ * @arthur     MacFalcons Control Team
+ */
+#include "gimbal_patrol.h"
+#include "math.h"
+
+// a sector reaching this is the full circle
+#define PATROL_FULL_CIRCLE_HALF_WIDTH (PI - 1e-3f)
+// yaw set on the edge of a raster row, rad
+#define PATROL_EDGE_TOLERANCE 1e-4f
+
+static const patrol_sector_t *gimbal_patrol_sector(const gimbal_patrol_t *patrol);
+static void gimbal_patrol_start_sector(gimbal_patrol_t *patrol);
+
+/**
+  * @brief          number of raster rows that cover the pitch band of a sector
+  * @param[in]      sector: patrol sector
+  * @retval         rows, 1 to PATROL_MAX_ROWS
+  */
+static uint8_t gimbal_patrol_row_count(const patrol_sector_t *sector)
+{
+    fp32 span = sector->pitch_max - sector->pitch_min - PATROL_CAMERA_FOV_V;
+    if (span <= 0.0f)
+    {
+        return 1;
+    }
+    uint8_t rows = (uint8_t)ceilf(span / (PATROL_CAMERA_FOV_V * (1.0f - PATROL_ROW_OVERLAP))) + 1;
+    return (rows > PATROL_MAX_ROWS) ? PATROL_MAX_ROWS : rows;
+}
+
+/**
+  * @brief          camera center pitch of a raster row, the first row at the pitch_min side
+  * @param[in]      sector: patrol sector
+  * @param[in]      row: row index
+  * @retval         pitch, unit rad
+  */
+static fp32 gimbal_patrol_row_pitch(const patrol_sector_t *sector, uint8_t row)
+{
+    uint8_t rows = gimbal_patrol_row_count(sector);
+    if (rows <= 1)
+    {
+        return 0.5f * (sector->pitch_min + sector->pitch_max);
+    }
+    fp32 span = sector->pitch_max - sector->pitch_min - PATROL_CAMERA_FOV_V;
+    return sector->pitch_min + 0.5f * PATROL_CAMERA_FOV_V + span * row / (rows - 1);
+}
+
+/**
+  * @brief          yaw range of the camera center, half a field of view inside the sector edges
+  * @param[in]      sector: patrol sector
+  * @retval         half width, unit rad, 0 if the sector is narrower than the field of view
+  */
+static fp32 gimbal_patrol_yaw_span(const patrol_sector_t *sector)
+{
+    fp32 span = sector->half_width - 0.5f * PATROL_CAMERA_FOV_H;
+    return (span > 0.0f) ? span : 0.0f;
+}
+
+/**
+  * @brief          visit rows back and forth, so the pitch never jumps across the band
+  * @param[out]     patrol: gimbal patrol struct point
+  * @param[in]      rows: row count of the sector
+  * @retval         none
+  */
+static void gimbal_patrol_next_row(gimbal_patrol_t *patrol, uint8_t rows)
+{
+    if (rows <= 1)
+    {
+        patrol->row = 0;
+        return;
+    }
+    if (((patrol->row_step > 0) && (patrol->row + 1 >= rows)) || ((patrol->row_step < 0) && (patrol->row == 0)))
+    {
+        patrol->row_step = -patrol->row_step;
+    }
+    patrol->row = (uint8_t)(patrol->row + patrol->row_step);
+}
+
+void gimbal_patrol_init(gimbal_patrol_t *patrol, const patrol_sector_t *sectors, uint8_t sector_count, fp32 dt)
+{
+    if ((patrol == NULL) || (sectors == NULL) || (sector_count == 0))
+    {
+        return;
+    }
+    patrol->sectors = sectors;
+    patrol->sector_count = sector_count;
+    patrol->sector_index = 0;
+    patrol->state = PATROL_SCAN;
+    patrol->state_time = 0.0f;
+    patrol->search = sectors[0];
+    patrol->yaw_dir = 1.0f;
+    TRAJ_init(&patrol->yaw_traj, PATROL_YAW_MAX_SPEED, PATROL_YAW_MAX_ACCEL, dt);
+    TRAJ_init(&patrol->pitch_traj, PATROL_PITCH_MAX_SPEED, PATROL_PITCH_MAX_ACCEL, dt);
+    gimbal_patrol_start_sector(patrol);
+}
+
+void gimbal_patrol_reset(gimbal_patrol_t *patrol, fp32 yaw, fp32 pitch)
+{
+    if (patrol == NULL)
+    {
+        return;
+    }
+    TRAJ_reset(&patrol->yaw_traj, rad_format(yaw), 0.0f);
+    TRAJ_reset(&patrol->pitch_traj, pitch, 0.0f);
+    gimbal_patrol_start_sector(patrol);
+}
+
+void gimbal_patrol_mark_target(gimbal_patrol_t *patrol, fp32 yaw, fp32 pitch)
+{
+    if (patrol == NULL)
+    {
+        return;
+    }
+    // one row through the target, the search starts sweeping from it
+    patrol->state = PATROL_SEARCH_LAST_SEEN;
+    patrol->state_time = 0.0f;
+    patrol->search.yaw = rad_format(yaw);
+    patrol->search.half_width = PATROL_SEARCH_HALF_WIDTH;
+    patrol->search.pitch_min = pitch - 0.5f * PATROL_CAMERA_FOV_V;
+    patrol->search.pitch_max = pitch + 0.5f * PATROL_CAMERA_FOV_V;
+    patrol->search.dwell_s = PATROL_SEARCH_TIME_S;
+    patrol->search.pattern = PATROL_PATTERN_RASTER;
+    gimbal_patrol_reset(patrol, yaw, pitch);
+}
+
+void gimbal_patrol_calc(gimbal_patrol_t *patrol, fp32 *yaw, fp32 *pitch)
+{
+    if ((patrol == NULL) || (yaw == NULL) || (pitch == NULL) || (patrol->sectors == NULL))
+    {
+        return;
+    }
+    fp32 dt = patrol->yaw_traj.dt;
+    const patrol_sector_t *sector = gimbal_patrol_sector(patrol);
+    patrol->state_time += dt;
+    if (patrol->state_time >= sector->dwell_s)
+    {
+        patrol->state_time = 0.0f;
+        if ((patrol->state == PATROL_SEARCH_LAST_SEEN) || (patrol->sector_count > 1))
+        {
+            // a single sector table just goes on with its pattern
+            if (patrol->state == PATROL_SEARCH_LAST_SEEN)
+            {
+                patrol->state = PATROL_SCAN;
+            }
+            else
+            {
+                patrol->sector_index = (patrol->sector_index + 1) % patrol->sector_count;
+            }
+            gimbal_patrol_start_sector(patrol);
+            sector = gimbal_patrol_sector(patrol);
+        }
+    }
+
+    uint8_t rows = gimbal_patrol_row_count(sector);
+    fp32 yaw_span = gimbal_patrol_yaw_span(sector);
+    uint8_t fFullCircle = (sector->half_width >= PATROL_FULL_CIRCLE_HALF_WIDTH);
+    fp32 yaw_target;
+    fp32 pitch_target;
+    if (fFullCircle)
+    {
+        // a target always a quarter turn ahead keeps the yaw turning at full speed
+        yaw_target = rad_format(patrol->yaw_traj.position + patrol->yaw_dir * 0.5f * PI);
+    }
+    else if (sector->pattern == PATROL_PATTERN_LISSAJOUS)
+    {
+        fp32 omega = (yaw_span > 0.0f) ? fminf(PATROL_YAW_MAX_SPEED / yaw_span, sqrtf(PATROL_YAW_MAX_ACCEL / yaw_span)) : 0.0f;
+        patrol->yaw_phase = rad_format(patrol->yaw_phase + omega * dt);
+        yaw_target = rad_format(sector->yaw + yaw_span * sinf(patrol->yaw_phase));
+    }
+    else
+    {
+        yaw_target = rad_format(sector->yaw + patrol->yaw_dir * yaw_span);
+    }
+
+    if (sector->pattern == PATROL_PATTERN_LISSAJOUS)
+    {
+        fp32 amplitude = 0.5f * (sector->pitch_max - sector->pitch_min - PATROL_CAMERA_FOV_V);
+        fp32 omega = 0.0f;
+        if (amplitude > 0.0f)
+        {
+            // a full circle has no yaw frequency, a half turn at full speed stands for its period
+            fp32 yaw_omega = fFullCircle ? (PATROL_YAW_MAX_SPEED / PI) : ((yaw_span > 0.0f) ? fminf(PATROL_YAW_MAX_SPEED / yaw_span, sqrtf(PATROL_YAW_MAX_ACCEL / yaw_span)) : (PATROL_YAW_MAX_SPEED / PI));
+            omega = fminf(PATROL_LISSAJOUS_PITCH_RATIO * yaw_omega, fminf(PATROL_PITCH_MAX_SPEED / amplitude, sqrtf(PATROL_PITCH_MAX_ACCEL / amplitude)));
+        }
+        else
+        {
+            amplitude = 0.0f;
+        }
+        patrol->pitch_phase = rad_format(patrol->pitch_phase + omega * dt);
+        pitch_target = 0.5f * (sector->pitch_min + sector->pitch_max) + amplitude * sinf(patrol->pitch_phase);
+    }
+    else
+    {
+        pitch_target = gimbal_patrol_row_pitch(sector, patrol->row);
+    }
+
+    fp32 last_yaw = patrol->yaw_traj.position;
+    *yaw = TRAJ_calc(&patrol->yaw_traj, yaw_target);
+    *pitch = TRAJ_calc(&patrol->pitch_traj, pitch_target);
+
+    if (sector->pattern != PATROL_PATTERN_RASTER)
+    {
+        return;
+    }
+    if (fFullCircle)
+    {
+        patrol->row_travel += fabsf(rad_format(*yaw - last_yaw));
+        if (patrol->row_travel >= 2.0f * PI)
+        {
+            patrol->row_travel -= 2.0f * PI;
+            gimbal_patrol_next_row(patrol, rows);
+        }
+    }
+    else if ((fabsf(rad_format(*yaw - yaw_target)) < PATROL_EDGE_TOLERANCE) && (fabsf(*pitch - pitch_target) < PATROL_EDGE_TOLERANCE))
+    {
+        // on the edge: next row first, reverse once the pitch is on it
+        if (patrol->fRowChanged || (rows <= 1))
+        {
+            patrol->yaw_dir = -patrol->yaw_dir;
+            patrol->fRowChanged = 0;
+        }
+        else
+        {
+            gimbal_patrol_next_row(patrol, rows);
+            patrol->fRowChanged = 1;
+        }
+    }
+}
+
+/**
+  * @brief          sector scanned now
+  * @param[in]      patrol: gimbal patrol struct point
+  * @retval         sector
+  */
+static const patrol_sector_t *gimbal_patrol_sector(const gimbal_patrol_t *patrol)
+{
+    return (patrol->state == PATROL_SEARCH_LAST_SEEN) ? &patrol->search : &patrol->sectors[patrol->sector_index];
+}
+
+/**
+  * @brief          start the pattern of the current sector from the present set-point: nearest row, heading to the
+  *                 nearest yaw edge, sine phases on the present angles
+  * @param[out]     patrol: gimbal patrol struct point
+  * @retval         none
+  */
+static void gimbal_patrol_start_sector(gimbal_patrol_t *patrol)
+{
+    const patrol_sector_t *sector = gimbal_patrol_sector(patrol);
+    fp32 yaw_offset = rad_format(patrol->yaw_traj.position - sector->yaw);
+    fp32 pitch = patrol->pitch_traj.position;
+
+    uint8_t rows = gimbal_patrol_row_count(sector);
+    patrol->row = 0;
+    for (uint8_t i = 1; i < rows; i++)
+    {
+        if (fabsf(gimbal_patrol_row_pitch(sector, i) - pitch) < fabsf(gimbal_patrol_row_pitch(sector, patrol->row) - pitch))
+        {
+            patrol->row = i;
+        }
+    }
+    patrol->row_step = (patrol->row + 1 >= rows) ? -1 : 1;
+    patrol->row_travel = 0.0f;
+    patrol->fRowChanged = 0;
+    if (patrol->yaw_traj.speed != 0.0f)
+    {
+        // keep turning the way the gimbal already turns
+        patrol->yaw_dir = (patrol->yaw_traj.speed > 0.0f) ? 1.0f : -1.0f;
+    }
+    else
+    {
+        patrol->yaw_dir = (yaw_offset >= 0.0f) ? 1.0f : -1.0f;
+    }
+
+    fp32 yaw_span = gimbal_patrol_yaw_span(sector);
+    patrol->yaw_phase = (yaw_span > 0.0f) ? asinf(fp32_constrain(yaw_offset / yaw_span, -1.0f, 1.0f)) : 0.0f;
+    fp32 amplitude = 0.5f * (sector->pitch_max - sector->pitch_min - PATROL_CAMERA_FOV_V);
+    fp32 pitch_offset = pitch - 0.5f * (sector->pitch_min + sector->pitch_max);
+    patrol->pitch_phase = (amplitude > 0.0f) ? asinf(fp32_constrain(pitch_offset / amplitude, -1.0f, 1.0f)) : 0.0f;
+}
@@ -0,0 +1,138 @@
+/**
+ * @file       gimbal_patrol.c/h
+ * @brief      Patrol scan pattern engine: yaw and pitch set-points that sweep the camera over the field while CV has no
+ *             target, within the gimbal rate limits
+ * @arthur     MacFalcons Control Team
+ * The field is split in sectors of a table, each scanned for its dwell time in turn. A sector is the yaw range and pitch
+ * band the camera should see; the camera center keeps half a field of view inside its edges.
+ *   - raster: rows of constant pitch, PATROL_ROW_OVERLAP of the vertical field of view shared between neighbours, swept
+ *     back and forth over the yaw range, the yaw waiting on the edge until the pitch is on the next row so no corner
+ *     is missed. On a full circle the yaw never reverses: it turns on at full speed and the
+ *     pitch moves to the next row once per turn, a helix
+ *   - lissajous: yaw and pitch follow sines at the fastest frequency their speed and acceleration limits allow, the pitch
+ *     frequency PATROL_LISSAJOUS_PITCH_RATIO times the yaw one so the path doesn't close on itself
+ * Raster is the pattern of both default tables: in Scripts/gimbal_patrol_sim.py it sees a +-60deg sector in 2s where
+ * lissajous takes 8s, and the lissajous helix on the full circle leaves gaps in the band.
+ * Coverage per second is yaw speed times the vertical field of view, so the yaw sweeps at PATROL_YAW_MAX_SPEED, the
+ * fastest the camera still detects at. Every set-point goes through a trajectory generator (trajectory_generator.c)
+ * with the patrol limits, so row changes, reversals and moves between sectors are smooth.
+ * While CV holds a target the gimbal follows CV and the patrol only records where: once the target is lost, a single
+ * row around that direction is searched for PATROL_SEARCH_TIME_S before the table resumes.
+ * Angles are absolute, yaw from the power-on heading (absolute_angle_offset), both positive as the IMU.
+ */
+#ifndef GIMBAL_PATROL_H
+#define GIMBAL_PATROL_H
+#include "global_inc.h"
+#include "user_lib.h"
+#include "trajectory_generator.h"
+
+// camera field of view, rad
+// @TODO: measure on the sentry camera, 8 mm lens on a 1/2.9" sensor for now
+#define PATROL_CAMERA_FOV_H DEG_TO_RAD(30.0f)
+#define PATROL_CAMERA_FOV_V DEG_TO_RAD(23.0f)
+#define PATROL_ROW_OVERLAP 0.2f
+#define PATROL_MAX_ROWS 4
+// detection needs the armor sharp: faster than this it blurs over too many pixels within the exposure
+#define PATROL_YAW_MAX_SPEED 2.5f     // rad/s
+#define PATROL_YAW_MAX_ACCEL 15.0f    // rad/s^2
+#define PATROL_PITCH_MAX_SPEED 1.5f   // rad/s
+#define PATROL_PITCH_MAX_ACCEL 10.0f  // rad/s^2
+#define PATROL_LISSAJOUS_PITCH_RATIO 1.618f
+// band of the field seen, absolute pitch, positive down
+#define PATROL_PITCH_MIN (-0.35f)
+#define PATROL_PITCH_MAX 0.25f
+#define PATROL_SEARCH_HALF_WIDTH DEG_TO_RAD(45.0f)
+#define PATROL_SEARCH_TIME_S 2.0f
+// CV keeps sending aim commands while it holds a target
+#define PATROL_CV_LOCK_TIMEOUT_MS 100
+
+typedef enum
+{
+    PATROL_PATTERN_RASTER = 0,
+    PATROL_PATTERN_LISSAJOUS,
+} patrol_pattern_e;
+
+typedef enum
+{
+    PATROL_SCAN = 0,          // sectors of the table
+    PATROL_SEARCH_LAST_SEEN,  // around the last CV target
+} patrol_state_e;
+
+typedef struct
+{
+    fp32 yaw;        // center, rad
+    fp32 half_width; // rad, PI for the full circle
+    fp32 pitch_min;  // rad
+    fp32 pitch_max;
+    fp32 dwell_s;
+    patrol_pattern_e pattern;
+} patrol_sector_t;
+
+// {yaw, half_width, pitch_min, pitch_max, dwell_s, pattern}
+#if ROBOT_YAW_HAS_SLIP_RING
+#define PATROL_SECTOR_TABLE {{0.0f, PI, PATROL_PITCH_MIN, PATROL_PITCH_MAX, 10.0f, PATROL_PATTERN_RASTER}}
+#else
+#define PATROL_SECTOR_TABLE {{0.0f, DEG_TO_RAD(60.0f), PATROL_PITCH_MIN, PATROL_PITCH_MAX, 10.0f, PATROL_PATTERN_RASTER}}
+#endif
+
+typedef struct
+{
+    const patrol_sector_t *sectors;
+    uint8_t sector_count;
+    uint8_t sector_index;
+    patrol_state_e state;
+    fp32 state_time;          // s in the current sector or search
+    patrol_sector_t search;   // sector around the last CV target
+
+    trajectory_generator_t yaw_traj;
+    trajectory_generator_t pitch_traj;
+
+    // raster
+    fp32 yaw_dir;             // +1 or -1
+    uint8_t row;
+    int8_t row_step;          // +1 or -1, rows are visited back and forth
+    uint8_t fRowChanged;      // the row was changed on the edge reached, the yaw reverses once the pitch is on it
+    fp32 row_travel;          // yaw turned in the current row of a full circle, rad
+    // lissajous
+    fp32 yaw_phase;           // rad
+    fp32 pitch_phase;
+} gimbal_patrol_t;
+
+/**
+  * @brief          patrol init, starts the first sector of the table at 0
+  * @param[out]     patrol: gimbal patrol struct point
+  * @param[in]      sectors: sector table, kept by the patrol
+  * @param[in]      sector_count: number of sectors, at least 1
+  * @param[in]      dt: sample time, unit s
+  * @retval         none
+  */
+extern void gimbal_patrol_init(gimbal_patrol_t *patrol, const patrol_sector_t *sectors, uint8_t sector_count, fp32 dt);
+
+/**
+  * @brief          start patrolling from where the gimbal is, at rest, in the current state
+  * @param[out]     patrol: gimbal patrol struct point
+  * @param[in]      yaw: absolute yaw set, unit rad
+  * @param[in]      pitch: absolute pitch set, unit rad
+  * @retval         none
+  */
+extern void gimbal_patrol_reset(gimbal_patrol_t *patrol, fp32 yaw, fp32 pitch);
+
+/**
+  * @brief          record the direction of the target CV holds; the patrol searches there from when it resumes
+  * @param[out]     patrol: gimbal patrol struct point
+  * @param[in]      yaw: absolute yaw set, unit rad
+  * @param[in]      pitch: absolute pitch set, unit rad
+  * @retval         none
+  */
+extern void gimbal_patrol_mark_target(gimbal_patrol_t *patrol, fp32 yaw, fp32 pitch);
+
+/**
+  * @brief          next patrol set-point, called once per sample time
+  * @param[out]     patrol: gimbal patrol struct point
+  * @param[out]     yaw: absolute yaw set, unit rad
+  * @param[out]     pitch: absolute pitch set, unit rad
+  * @retval         none
+  */
+extern void gimbal_patrol_calc(gimbal_patrol_t *patrol, fp32 *yaw, fp32 *pitch);
+
+#endif
@@ -41,6 +41,7 @@
 #include "bsp_laser.h"
 #include "pid.h"
 #include "cv_usart_task.h"
+#include "calibrate_task.h"
 
 //motor encoder value format, range[0-8191]
 #define ecd_format(ecd)         \
@@ -51,17 +52,32 @@
             (ecd) += ECD_RANGE; \
     }
 
+#if GIMBAL_USE_LQR
+#define gimbal_motor_lqr_clear(gimbal_motor) LQR_clear(&(gimbal_motor)->gimbal_motor_lqr)
+#else
+#define gimbal_motor_lqr_clear(gimbal_motor)
+#endif
+
+#if GIMBAL_TRAJECTORY_GENERATOR
+// restart the set-point trajectory from where the gimbal is
+#define gimbal_motor_trajectory_reset(gimbal_motor) TRAJ_reset(&(gimbal_motor)->absolute_angle_trajectory, (gimbal_motor)->absolute_angle, (gimbal_motor)->motor_gyro)
+#else
+#define gimbal_motor_trajectory_reset(gimbal_motor)
+#endif
+
 #define gimbal_yaw_pid_clear(gimbal_clear)                                                     \
     {                                                                                          \
         PID_clear(&(gimbal_clear)->gimbal_yaw_motor.gimbal_motor_absolute_angle_pid);   \
         PID_clear(&(gimbal_clear)->gimbal_yaw_motor.gimbal_motor_relative_angle_pid);   \
         PID_clear(&(gimbal_clear)->gimbal_yaw_motor.gimbal_motor_speed_pid);                    \
+        gimbal_motor_lqr_clear(&(gimbal_clear)->gimbal_yaw_motor);                              \
     }
 #define gimbal_pitch_pid_clear(gimbal_clear)                                                   \
     {                                                                                          \
         PID_clear(&(gimbal_clear)->gimbal_pitch_motor.gimbal_motor_absolute_angle_pid); \
         PID_clear(&(gimbal_clear)->gimbal_pitch_motor.gimbal_motor_relative_angle_pid); \
         PID_clear(&(gimbal_clear)->gimbal_pitch_motor.gimbal_motor_speed_pid);                  \
+        gimbal_motor_lqr_clear(&(gimbal_clear)->gimbal_pitch_motor);                            \
     }
 
 #define GIMBAL_YAW_MOTOR 0
@@ -143,6 +159,22 @@ static void gimbal_motor_relative_angle_control(gimbal_motor_t *gimbal_motor);
   * @retval         none
   */
 static void gimbal_motor_raw_angle_control(gimbal_motor_t *gimbal_motor);
+#if YAW_DOB_ENABLE
+/**
+  * @brief          yaw disturbance observer, add estimated reaction torque compensation to yaw command while chassis is spinning
+  * @param[out]     control_loop: "gimbal_control" valiable point
+  * @retval         none
+  */
+static void gimbal_yaw_disturbance_compensation(gimbal_control_t *control_loop);
+#endif
+#if SPECTRUM_ENABLE
+/**
+  * @brief          record the signal selected by "spectrum_source" into the spectrum analyzer
+  * @param[in]      gimbal_record: "gimbal_control" valiable point
+  * @retval         none
+  */
+static void gimbal_spectrum_record(const gimbal_control_t *gimbal_record);
+#endif
 /**
   * @brief          limit angle set in GIMBAL_MOTOR_GYRO mode, avoid exceeding the max angle
   * @param[out]     gimbal_motor: yaw motor or pitch motor
@@ -209,7 +241,26 @@ void gimbal_task(void const *pvParameters)
         gimbal_set_control(&gimbal_control);
         gimbal_control_loop(&gimbal_control);
         trigger_set_current = shoot_control_loop();
+        pid_autotune_override_cmd(PID_AUTOTUNE_YAW_RATE, gimbal_control.gimbal_yaw_motor.motor_gyro, &gimbal_control.gimbal_yaw_motor.cmd_value);
+        pid_autotune_override_cmd(PID_AUTOTUNE_PITCH_RATE, gimbal_control.gimbal_pitch_motor.motor_gyro, &gimbal_control.gimbal_pitch_motor.cmd_value);
+        fp32 autotune_fric1_cmd = shoot_control.fric1_given_current;
+        if (pid_autotune_override_cmd(PID_AUTOTUNE_FRICTION_SPEED, shoot_control.friction_motor1_rpm, &autotune_fric1_cmd))
+        {
+            shoot_control.fric1_given_current = (int16_t)autotune_fric1_cmd;
+        }
+#if SYSID_ENABLE
+        sysid_override_cmd(SYSID_TARGET_YAW, &gimbal_control.gimbal_yaw_motor.cmd_value);
+        sysid_override_cmd(SYSID_TARGET_PITCH, &gimbal_control.gimbal_pitch_motor.cmd_value);
+        fp32 sysid_trigger_cmd = trigger_set_current;
+        if (sysid_override_cmd(SYSID_TARGET_TRIGGER, &sysid_trigger_cmd))
+        {
+            trigger_set_current = (int16_t)sysid_trigger_cmd;
+        }
+#endif
         gimbal_safety_manager(&yaw_can_set_value, &pitch_can_set_value, &trigger_set_current, &shoot_control.fric1_given_current, &shoot_control.fric2_given_current);
+#if SPECTRUM_ENABLE
+        gimbal_spectrum_record(&gimbal_control);
+#endif
         CAN_cmd_gimbal(yaw_can_set_value, pitch_can_set_value, trigger_set_current, shoot_control.fric1_given_current, shoot_control.fric2_given_current);
 
 #if GIMBAL_TEST_MODE
@@ -514,6 +565,11 @@ static void gimbal_yaw_abs_angle_PID_init(gimbal_control_t *init)
     PID_init(&init->gimbal_yaw_motor.gimbal_motor_absolute_angle_pid, PID_POSITION, angle_pid_ptr, angle_pid_max_out, angle_pid_max_iout, 0, &rad_err_handler);
     // yaw speed is fast, so benefit of filtering on noise is insignificant comparing to the delay effect
     PID_init(&init->gimbal_yaw_motor.gimbal_motor_speed_pid, PID_POSITION, speed_pid_ptr, speed_pid_max_out, speed_pid_max_iout, 0.85f, &filter_err_handler);
+    if (speed_pid_ptr == yaw_speed_pid)
+    {
+        // auto-tuned gains replace the default speed loop gains, camera mode keeps its own
+        pid_autotune_load_gains(PID_AUTOTUNE_YAW_RATE, &init->gimbal_yaw_motor.gimbal_motor_speed_pid);
+    }
 }
 
 /**
@@ -558,6 +614,10 @@ static void gimbal_pitch_abs_angle_PID_init(gimbal_control_t *init)
     }
     PID_init(&init->gimbal_pitch_motor.gimbal_motor_absolute_angle_pid, PID_POSITION, angle_pid_ptr, angle_pid_max_out, angle_pid_max_iout, 0, &rad_err_handler);
     PID_init(&init->gimbal_pitch_motor.gimbal_motor_speed_pid, PID_POSITION, speed_pid_ptr, speed_pid_max_out, speed_pid_max_iout, 0.85f, &filter_err_handler);
+    if (speed_pid_ptr == pitch_speed_pid)
+    {
+        pid_autotune_load_gains(PID_AUTOTUNE_PITCH_RATE, &init->gimbal_pitch_motor.gimbal_motor_speed_pid);
+    }
 }
 
 /**
@@ -583,6 +643,25 @@ static void gimbal_init(gimbal_control_t *init)
     PID_init(&init->gimbal_pitch_motor.gimbal_motor_relative_angle_pid, PID_POSITION, pitch_encode_relative_angle_pid, PITCH_ENCODE_RELATIVE_PID_MAX_OUT, PITCH_ENCODE_RELATIVE_PID_MAX_IOUT, 0, &rad_err_handler);
     gimbal_pitch_abs_angle_PID_init(init);
 
+#if GIMBAL_USE_LQR
+    static const fp32 yaw_lqr_gain[3] = {YAW_LQR_K_ANGLE, YAW_LQR_K_RATE, YAW_LQR_K_INTEGRAL};
+    static const fp32 pitch_lqr_gain[3] = {PITCH_LQR_K_ANGLE, PITCH_LQR_K_RATE, PITCH_LQR_K_INTEGRAL};
+    LQR_init(&init->gimbal_yaw_motor.gimbal_motor_lqr, yaw_lqr_gain, YAW_LQR_MAX_OUT, YAW_LQR_MAX_INTEGRAL);
+    LQR_init(&init->gimbal_pitch_motor.gimbal_motor_lqr, pitch_lqr_gain, PITCH_LQR_MAX_OUT, PITCH_LQR_MAX_INTEGRAL);
+#endif
+
+#if GIMBAL_TRAJECTORY_GENERATOR
+    TRAJ_init(&init->gimbal_yaw_motor.absolute_angle_trajectory, YAW_TRAJECTORY_MAX_SPEED, YAW_TRAJECTORY_MAX_ACCEL, GIMBAL_CONTROL_TIME_S);
+    TRAJ_init(&init->gimbal_pitch_motor.absolute_angle_trajectory, PITCH_TRAJECTORY_MAX_SPEED, PITCH_TRAJECTORY_MAX_ACCEL, GIMBAL_CONTROL_TIME_S);
+    init->gimbal_yaw_motor.trajectory_inertia = YAW_TRAJECTORY_INERTIA;
+    init->gimbal_pitch_motor.trajectory_inertia = PITCH_TRAJECTORY_INERTIA;
+#endif
+
+#if YAW_DOB_ENABLE
+    DOB_init(&init->yaw_dob, YAW_DOB_NOMINAL_INERTIA, YAW_DOB_NOMINAL_DAMPING, YAW_DOB_CUTOFF_HZ, YAW_DOB_MAX_COMPENSATION, GIMBAL_CONTROL_TIME_S);
+    init->fYawDobActive = 0;
+#endif
+
   #if CV_INTERFACE
     init->gimbal_pitch_motor.CvCmdAngleFilter.size = CV_ANGLE_FILTER_SIZE;
     init->gimbal_pitch_motor.CvCmdAngleFilter.cursor = 0;
@@ -595,21 +674,51 @@ static void gimbal_init(gimbal_control_t *init)
     init->gimbal_yaw_motor.CvCmdAngleFilter.sum = 0;
   #endif
 
+#if GIMBAL_BIQUAD_FILTER
+    static const biquad_stage_config_t yaw_gyro_filter_table[] = YAW_GYRO_FILTER_TABLE;
+    static const biquad_stage_config_t pitch_gyro_filter_table[] = PITCH_GYRO_FILTER_TABLE;
+    static const biquad_stage_config_t yaw_cmd_filter_table[] = YAW_CMD_FILTER_TABLE;
+    static const biquad_stage_config_t pitch_cmd_filter_table[] = PITCH_CMD_FILTER_TABLE;
+    biquad_filter_init(&init->gimbal_yaw_motor.gyro_filter, yaw_gyro_filter_table, sizeof(yaw_gyro_filter_table) / sizeof(biquad_stage_config_t), 1.0f / GIMBAL_CONTROL_TIME_S);
+    biquad_filter_init(&init->gimbal_pitch_motor.gyro_filter, pitch_gyro_filter_table, sizeof(pitch_gyro_filter_table) / sizeof(biquad_stage_config_t), 1.0f / GIMBAL_CONTROL_TIME_S);
+    biquad_filter_init(&init->gimbal_yaw_motor.cmd_filter, yaw_cmd_filter_table, sizeof(yaw_cmd_filter_table) / sizeof(biquad_stage_config_t), 1.0f / GIMBAL_CONTROL_TIME_S);
+    biquad_filter_init(&init->gimbal_pitch_motor.cmd_filter, pitch_cmd_filter_table, sizeof(pitch_cmd_filter_table) / sizeof(biquad_stage_config_t), 1.0f / GIMBAL_CONTROL_TIME_S);
+#endif
+
+#if GIMBAL_YAW_ANGLE_TRACKER
+    angle_tracker_init(&init->yaw_relative_tracker, YAW_RELATIVE_TRACKER_BANDWIDTH_HZ, GIMBAL_CONTROL_TIME_S);
+    angle_tracker_init(&init->yaw_absolute_tracker, YAW_ABSOLUTE_TRACKER_BANDWIDTH_HZ, GIMBAL_CONTROL_TIME_S);
+#endif
+
     gimbal_yaw_pid_clear(init);
     gimbal_pitch_pid_clear(init);
 
     gimbal_feedback_update(init);
+#if GIMBAL_YAW_ANGLE_TRACKER
+    // count turns from power on
+    angle_tracker_reset(&init->yaw_relative_tracker, init->gimbal_yaw_motor.relative_angle, 0.0f);
+    angle_tracker_reset(&init->yaw_absolute_tracker, init->gimbal_yaw_motor.absolute_angle, init->gimbal_yaw_motor.motor_gyro);
+#endif
+#if GIMBAL_BIQUAD_FILTER
+    // start the gyro filters at rest on the present rate, not from zero
+    biquad_filter_reset(&init->gimbal_yaw_motor.gyro_filter, init->gimbal_yaw_motor.motor_gyro_raw);
+    biquad_filter_reset(&init->gimbal_pitch_motor.gyro_filter, init->gimbal_pitch_motor.motor_gyro_raw);
+    init->gimbal_yaw_motor.motor_gyro = init->gimbal_yaw_motor.motor_gyro_raw;
+    init->gimbal_pitch_motor.motor_gyro = init->gimbal_pitch_motor.motor_gyro_raw;
+#endif
 
     init->gimbal_yaw_motor.absolute_angle_set = init->gimbal_yaw_motor.absolute_angle;
     init->gimbal_yaw_motor.absolute_angle_offset = 0;
     init->gimbal_yaw_motor.relative_angle_set = init->gimbal_yaw_motor.relative_angle;
     init->gimbal_yaw_motor.motor_gyro_set = init->gimbal_yaw_motor.motor_gyro;
+    gimbal_motor_trajectory_reset(&init->gimbal_yaw_motor);
 
 
     init->gimbal_pitch_motor.absolute_angle_set = init->gimbal_pitch_motor.absolute_angle;
     init->gimbal_pitch_motor.absolute_angle_offset = 0;
     init->gimbal_pitch_motor.relative_angle_set = init->gimbal_pitch_motor.relative_angle;
     init->gimbal_pitch_motor.motor_gyro_set = init->gimbal_pitch_motor.motor_gyro;
+    gimbal_motor_trajectory_reset(&init->gimbal_pitch_motor);
 #if ENABLE_LASER
     laser_enable(1);
 #endif
@@ -664,6 +773,28 @@ static void gimbal_feedback_update(gimbal_control_t *feedback_update)
 #endif
     feedback_update->gimbal_yaw_motor.motor_gyro = AHRS_cosf(feedback_update->gimbal_pitch_motor.relative_angle) * (*(feedback_update->gimbal_INT_gyro_point + INS_GYRO_Z_ADDRESS_OFFSET))
                                                         - AHRS_sinf(feedback_update->gimbal_pitch_motor.relative_angle) * (*(feedback_update->gimbal_INT_gyro_point + INS_GYRO_X_ADDRESS_OFFSET));
+
+#if GIMBAL_YAW_ANGLE_TRACKER
+    // yaw motors are direct drive, the rotor speed is the rate of the relative angle
+#if ROBOT_YAW_IS_4310
+    fp32 yaw_relative_rate = feedback_update->gimbal_yaw_motor.gimbal_motor_measure->velocity;
+#else
+    fp32 yaw_relative_rate = RPM_TO_RADS(feedback_update->gimbal_yaw_motor.gimbal_motor_measure->speed_rpm);
+#endif
+#if YAW_TURN
+    yaw_relative_rate = -yaw_relative_rate;
+#endif
+    angle_tracker_update(&feedback_update->yaw_relative_tracker, feedback_update->gimbal_yaw_motor.relative_angle, yaw_relative_rate);
+    angle_tracker_update(&feedback_update->yaw_absolute_tracker, feedback_update->gimbal_yaw_motor.absolute_angle, feedback_update->gimbal_yaw_motor.motor_gyro);
+#endif
+
+#if GIMBAL_BIQUAD_FILTER
+    // loops close on the filtered rate, resonances of the gimbal structure are notched out of the feedback
+    feedback_update->gimbal_pitch_motor.motor_gyro_raw = feedback_update->gimbal_pitch_motor.motor_gyro;
+    feedback_update->gimbal_pitch_motor.motor_gyro = biquad_filter_calc(&feedback_update->gimbal_pitch_motor.gyro_filter, feedback_update->gimbal_pitch_motor.motor_gyro_raw);
+    feedback_update->gimbal_yaw_motor.motor_gyro_raw = feedback_update->gimbal_yaw_motor.motor_gyro;
+    feedback_update->gimbal_yaw_motor.motor_gyro = biquad_filter_calc(&feedback_update->gimbal_yaw_motor.gyro_filter, feedback_update->gimbal_yaw_motor.motor_gyro_raw);
+#endif
 }
 
 /**
@@ -715,6 +846,7 @@ static void gimbal_mode_change_control_transit(gimbal_control_t *gimbal_mode_cha
             gimbal_yaw_abs_angle_PID_init(gimbal_mode_change);
             gimbal_yaw_pid_clear(gimbal_mode_change);
             gimbal_mode_change->gimbal_yaw_motor.absolute_angle_set = gimbal_mode_change->gimbal_yaw_motor.absolute_angle;
+            gimbal_motor_trajectory_reset(&gimbal_mode_change->gimbal_yaw_motor);
             break;
         }
         case GIMBAL_MOTOR_CAMERA:
@@ -724,6 +856,7 @@ static void gimbal_mode_change_control_transit(gimbal_control_t *gimbal_mode_cha
             gimbal_yaw_pid_clear(gimbal_mode_change);
             gimbal_mode_change->gimbal_yaw_motor.absolute_angle_offset = gimbal_mode_change->gimbal_yaw_motor.absolute_angle;
             gimbal_mode_change->gimbal_yaw_motor.absolute_angle_set = gimbal_mode_change->gimbal_yaw_motor.absolute_angle;
+            gimbal_motor_trajectory_reset(&gimbal_mode_change->gimbal_yaw_motor);
             break;
         }
         case GIMBAL_MOTOR_ENCODER:
@@ -751,6 +884,7 @@ static void gimbal_mode_change_control_transit(gimbal_control_t *gimbal_mode_cha
             gimbal_pitch_abs_angle_PID_init(gimbal_mode_change);
             gimbal_pitch_pid_clear(gimbal_mode_change);
             gimbal_mode_change->gimbal_pitch_motor.absolute_angle_set = gimbal_mode_change->gimbal_pitch_motor.absolute_angle;
+            gimbal_motor_trajectory_reset(&gimbal_mode_change->gimbal_pitch_motor);
             break;
         }
         case GIMBAL_MOTOR_CAMERA:
@@ -760,6 +894,7 @@ static void gimbal_mode_change_control_transit(gimbal_control_t *gimbal_mode_cha
             gimbal_pitch_pid_clear(gimbal_mode_change);
             gimbal_mode_change->gimbal_pitch_motor.absolute_angle_offset = gimbal_mode_change->gimbal_pitch_motor.absolute_angle;
             gimbal_mode_change->gimbal_pitch_motor.absolute_angle_set = gimbal_mode_change->gimbal_pitch_motor.absolute_angle;
+            gimbal_motor_trajectory_reset(&gimbal_mode_change->gimbal_pitch_motor);
             break;
         }
         case GIMBAL_MOTOR_ENCODER:
@@ -917,6 +1052,9 @@ static void gimbal_control_loop(gimbal_control_t *control_loop)
     {
         gimbal_motor_relative_angle_control(&control_loop->gimbal_yaw_motor);
     }
+#if YAW_DOB_ENABLE
+    gimbal_yaw_disturbance_compensation(control_loop);
+#endif
 
     if (control_loop->gimbal_pitch_motor.gimbal_motor_mode == GIMBAL_MOTOR_RAW)
     {
@@ -943,9 +1081,31 @@ static void gimbal_motor_absolute_angle_control(gimbal_motor_t *gimbal_motor)
     {
         return;
     }
+#if GIMBAL_TRAJECTORY_GENERATOR
+    // the loops follow the shaped trajectory instead of the raw request, with its speed and acceleration fed forward
+    fp32 angle_reference = TRAJ_calc(&gimbal_motor->absolute_angle_trajectory, gimbal_motor->absolute_angle_set);
+    fp32 speed_feedforward = gimbal_motor->absolute_angle_trajectory.speed;
+    fp32 cmd_feedforward = gimbal_motor->trajectory_inertia * gimbal_motor->absolute_angle_trajectory.accel;
+#else
+    fp32 angle_reference = gimbal_motor->absolute_angle_set;
+    fp32 speed_feedforward = 0.0f;
+    fp32 cmd_feedforward = 0.0f;
+#endif
+#if GIMBAL_USE_LQR
+    // full-state feedback: angle, rate and integral of angle error in one step, no speed set-point in between
+    // the rate term acts on the rate error to the feedforward speed
+    gimbal_motor->motor_gyro_set = speed_feedforward;
+    gimbal_motor->cmd_value = LQR_calc(&gimbal_motor->gimbal_motor_lqr, gimbal_motor->absolute_angle, angle_reference, gimbal_motor->motor_gyro - speed_feedforward, GIMBAL_CONTROL_TIME_S);
+    gimbal_motor->cmd_value = fp32_abs_constrain(gimbal_motor->cmd_value + cmd_feedforward, gimbal_motor->gimbal_motor_lqr.max_out);
+#else
     // cascade pid: angle loop & speed loop
-    gimbal_motor->motor_gyro_set = PID_calc_with_dot(&gimbal_motor->gimbal_motor_absolute_angle_pid, gimbal_motor->absolute_angle, gimbal_motor->absolute_angle_set, GIMBAL_CONTROL_TIME_S, gimbal_motor->motor_gyro);
+    gimbal_motor->motor_gyro_set = PID_calc_with_dot(&gimbal_motor->gimbal_motor_absolute_angle_pid, gimbal_motor->absolute_angle, angle_reference, GIMBAL_CONTROL_TIME_S, gimbal_motor->motor_gyro) + speed_feedforward;
     gimbal_motor->cmd_value = PID_calc(&gimbal_motor->gimbal_motor_speed_pid, gimbal_motor->motor_gyro, gimbal_motor->motor_gyro_set, GIMBAL_CONTROL_TIME_S);
+    gimbal_motor->cmd_value = fp32_abs_constrain(gimbal_motor->cmd_value + cmd_feedforward, gimbal_motor->gimbal_motor_speed_pid.max_out);
+#endif
+#if GIMBAL_BIQUAD_FILTER
+    gimbal_motor->cmd_value = biquad_filter_calc(&gimbal_motor->cmd_filter, gimbal_motor->cmd_value);
+#endif
 }
 /**
   * @brief          gimbal control mode :GIMBAL_MOTOR_ENCODER, use the encode relative angle  to control. 
@@ -962,6 +1122,9 @@ static void gimbal_motor_relative_angle_control(gimbal_motor_t *gimbal_motor)
     // cascade pid: angle loop & speed loop
     gimbal_motor->motor_gyro_set = PID_calc_with_dot(&gimbal_motor->gimbal_motor_relative_angle_pid, gimbal_motor->relative_angle, gimbal_motor->relative_angle_set, GIMBAL_CONTROL_TIME_S, gimbal_motor->motor_gyro);
     gimbal_motor->cmd_value = PID_calc(&gimbal_motor->gimbal_motor_speed_pid, gimbal_motor->motor_gyro, gimbal_motor->motor_gyro_set, GIMBAL_CONTROL_TIME_S);
+#if GIMBAL_BIQUAD_FILTER
+    gimbal_motor->cmd_value = biquad_filter_calc(&gimbal_motor->cmd_filter, gimbal_motor->cmd_value);
+#endif
 }
 
 /**
@@ -976,8 +1139,95 @@ static void gimbal_motor_raw_angle_control(gimbal_motor_t *gimbal_motor)
         return;
     }
     gimbal_motor->cmd_value = gimbal_motor->raw_cmd_current;
+#if GIMBAL_BIQUAD_FILTER
+    // raw command isn't filtered, the filter waits at rest on it so the loops take over without a bump
+    biquad_filter_reset(&gimbal_motor->cmd_filter, gimbal_motor->cmd_value);
+#endif
 }
 
+#if YAW_DOB_ENABLE
+/**
+  * @brief          yaw disturbance observer, add estimated reaction torque compensation to yaw command while chassis is spinning
+  * @param[out]     control_loop: "gimbal_control" valiable point
+  * @retval         none
+  */
+static void gimbal_yaw_disturbance_compensation(gimbal_control_t *control_loop)
+{
+    gimbal_motor_t *yaw_motor = &control_loop->gimbal_yaw_motor;
+    uint8_t fActive = (chassis_behaviour_mode == CHASSIS_SPINNING_MODE) && ((yaw_motor->gimbal_motor_mode == GIMBAL_MOTOR_GYRO) || (yaw_motor->gimbal_motor_mode == GIMBAL_MOTOR_CAMERA));
+
+    if (fActive != control_loop->fYawDobActive)
+    {
+        // start from zero estimate on every activation, so that stale estimate won't kick the gimbal
+        DOB_clear(&control_loop->yaw_dob);
+        control_loop->fYawDobActive = fActive;
+    }
+
+    if (fActive)
+    {
+        // motor_gyro is the yaw rate in world frame, which is the state the yaw torque directly drives
+        fp32 compensation = DOB_calc(&control_loop->yaw_dob, yaw_motor->motor_gyro);
+        yaw_motor->cmd_value = fp32_abs_constrain(yaw_motor->cmd_value + compensation, yaw_motor->gimbal_motor_speed_pid.max_out);
+        DOB_set_applied_cmd(&control_loop->yaw_dob, yaw_motor->cmd_value);
+    }
+}
+#endif
+
+#if SPECTRUM_ENABLE
+/**
+  * @brief          record the signal selected by "spectrum_source" into the spectrum analyzer
+  * @param[in]      gimbal_record: "gimbal_control" valiable point
+  * @retval         none
+  */
+static void gimbal_spectrum_record(const gimbal_control_t *gimbal_record)
+{
+    fp32 sample;
+    switch (spectrum_source)
+    {
+        case SPECTRUM_SOURCE_YAW_GYRO:
+        {
+#if GIMBAL_BIQUAD_FILTER
+            sample = gimbal_record->gimbal_yaw_motor.motor_gyro_raw;
+#else
+            sample = gimbal_record->gimbal_yaw_motor.motor_gyro;
+#endif
+            break;
+        }
+        case SPECTRUM_SOURCE_PITCH_GYRO:
+        {
+#if GIMBAL_BIQUAD_FILTER
+            sample = gimbal_record->gimbal_pitch_motor.motor_gyro_raw;
+#else
+            sample = gimbal_record->gimbal_pitch_motor.motor_gyro;
+#endif
+            break;
+        }
+        case SPECTRUM_SOURCE_YAW_GYRO_FILTERED:
+        {
+            sample = gimbal_record->gimbal_yaw_motor.motor_gyro;
+            break;
+        }
+        case SPECTRUM_SOURCE_PITCH_GYRO_FILTERED:
+        {
+            sample = gimbal_record->gimbal_pitch_motor.motor_gyro;
+            break;
+        }
+        case SPECTRUM_SOURCE_YAW_CMD:
+        {
+            sample = gimbal_record->gimbal_yaw_motor.cmd_value;
+            break;
+        }
+        case SPECTRUM_SOURCE_PITCH_CMD:
+        default:
+        {
+            sample = gimbal_record->gimbal_pitch_motor.cmd_value;
+            break;
+        }
+    }
+    spectrum_analyzer_add(&spectrum_analyzer, sample);
+}
+#endif
+
 #if GIMBAL_TEST_MODE
 fp32 yaw_cv_delta_fp32;
 fp32 yaw_ins_fp32, pitch_ins_fp32;
@@ -991,6 +1241,9 @@ uint32_t gimbal_last_update_time;
 uint32_t gimbal_update_interval;
 fp32 fric_diff_fp32;
 uint8_t fChassisSpinning;
+#if YAW_DOB_ENABLE
+fp32 yaw_dob_compensation;
+#endif
 static void J_scope_gimbal_test(void)
 {
 #if CV_INTERFACE
@@ -1017,6 +1270,9 @@ static void J_scope_gimbal_test(void)
     fric_diff_fp32 = shoot_control.friction_motor1_rpm + shoot_control.friction_motor2_rpm;
 
     fChassisSpinning = CvCmder_GetMode(CV_MODE_CHASSIS_SPINNING_BIT);
+#if YAW_DOB_ENABLE
+    yaw_dob_compensation = gimbal_control.yaw_dob.compensation;
+#endif
 }
 #endif
 
@@ -1056,3 +1312,20 @@ fp32 get_gimbal_pitch_angle(void)
 {
     return rad_format(gimbal_control.gimbal_pitch_motor.absolute_angle - gimbal_control.gimbal_pitch_motor.absolute_angle_offset);
 }
+
+#if GIMBAL_YAW_ANGLE_TRACKER
+fp32 get_gimbal_yaw_relative_angle_multi_turn(void)
+{
+    return angle_tracker_get_multi_turn(&gimbal_control.yaw_relative_tracker);
+}
+
+fp32 get_gimbal_yaw_relative_speed(void)
+{
+    return gimbal_control.yaw_relative_tracker.speed;
+}
+
+fp32 get_gimbal_yaw_angle_multi_turn(void)
+{
+    return angle_tracker_get_multi_turn(&gimbal_control.yaw_absolute_tracker) - gimbal_control.gimbal_yaw_motor.absolute_angle_offset;
+}
+#endif
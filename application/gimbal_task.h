@@ -28,11 +28,24 @@
 #include "pid.h"
 #include "remote_control.h"
 #include "user_lib.h"
+#include "disturbance_observer.h"
+#include "lqr.h"
+#include "trajectory_generator.h"
+#include "biquad_filter.h"
+#include "angle_tracker.h"
 
 #define GIMBAL_CONTROL_TIME_MS 4.0f
 #define GIMBAL_CONTROL_TIME_S (GIMBAL_CONTROL_TIME_MS / 1000.0f)
 
 #define GIMBAL_TEST_MODE 0
+// 1: full-state feedback (angle, rate, integral) in gyro/camera mode; 0: cascaded angle-speed pid
+#define GIMBAL_USE_LQR 0
+#if (GIMBAL_USE_LQR && (ROBOT_YAW_IS_4310 == 0))
+// @TODO: generate 6020 yaw gains from the identified model (SYSID_ENABLE in calibrate_task.h)
+#warning "no 6020 yaw LQR gains for this robot type, gimbal falls back to the cascaded angle-speed pid"
+#undef GIMBAL_USE_LQR
+#define GIMBAL_USE_LQR 0
+#endif
 
 #define PITCH_TURN  1
 #define YAW_TURN    0
@@ -296,6 +309,81 @@
 #define YAW_ENCODE_RELATIVE_PID_MAX_OUT   10.0f
 #define YAW_ENCODE_RELATIVE_PID_MAX_IOUT  0.0f
 
+#if GIMBAL_USE_LQR
+// gains generated by Scripts/gimbal_lqr_gain.py, unit of output follows the motor command
+// @TODO: regenerate with identified model of each robot
+// --inertia 0.02 --damping 0.01 --max-out 7 --q 3000 3 500
+#define YAW_LQR_K_ANGLE 44.440075f
+#define YAW_LQR_K_RATE 1.909501f
+#define YAW_LQR_K_INTEGRAL 17.825488f
+#define YAW_LQR_MAX_OUT YAW_SPEED_PID_MAX_OUT
+#define YAW_LQR_MAX_INTEGRAL 0.5f
+
+// --inertia 600 --damping 100 --max-out 30000 --r 0.000001 --q 4000 2 100
+#define PITCH_LQR_K_ANGLE 62787.37f
+#define PITCH_LQR_K_RATE 8688.734f
+#define PITCH_LQR_K_INTEGRAL 9710.268f
+#define PITCH_LQR_MAX_OUT PITCH_SPEED_PID_MAX_OUT
+#define PITCH_LQR_MAX_INTEGRAL 0.5f
+#endif
+
+// yaw disturbance observer on speed loop, cancels reaction torque from slip ring friction while chassis is spinning
+// nominal model is in the unit of yaw command: Nm for 4310, raw current for 6020
+// @TODO: identify the nominal model of each robot (SYSID_ENABLE in calibrate_task.h, sysid_fit_first_order) before
+// enabling, and put the identified values here with the robot type turned on
+#define YAW_DOB_ENABLE 0
+#if ROBOT_YAW_IS_4310
+// placeholder model, not identified
+#define YAW_DOB_NOMINAL_INERTIA 0.02f // Nm/(rad/s^2)
+#define YAW_DOB_NOMINAL_DAMPING 0.01f // Nm/(rad/s)
+#define YAW_DOB_CUTOFF_HZ 15.0f
+#define YAW_DOB_MAX_COMPENSATION 3.0f // Nm
+#endif
+
+// gyro/camera mode set-point trajectory: jumps of the request (CV, turn around) are shaped to bounded speed and
+// acceleration, and fed to the cascade as angle reference plus speed and acceleration feedforward
+// limits checked against the angle and speed loops by Scripts/gimbal_trajectory_test.py
+// @TODO: try on the robot before turning on, it rate-limits the CV aim as well
+#define GIMBAL_TRAJECTORY_GENERATOR 0
+#define YAW_TRAJECTORY_MAX_SPEED 8.0f // rad/s, under YAW_ANGLE_PID_MAX_OUT
+#define YAW_TRAJECTORY_MAX_ACCEL 50.0f // rad/s^2
+#define PITCH_TRAJECTORY_MAX_SPEED 6.0f // rad/s, under PITCH_ANGLE_PID_MAX_OUT
+#define PITCH_TRAJECTORY_MAX_ACCEL 30.0f // rad/s^2
+// acceleration feedforward gain, in the unit of the motor command per rad/s^2: the nominal inertia
+// @TODO: identify the yaw and pitch inertia of each robot (SYSID_ENABLE in calibrate_task.h) and turn the generator on
+// with them: on speed feedforward alone the shaped set-point settles later than the step
+#define YAW_TRAJECTORY_INERTIA 0.0f
+#define PITCH_TRAJECTORY_INERTIA 0.0f
+
+// biquad cascades on the gyro feedback of the speed loops and on the motor command of the gimbal motors, designed at the
+// gimbal loop rate, so they act below its 125Hz Nyquist frequency. Each table holds up to BIQUAD_FILTER_MAX_STAGES
+// stages {type, Hz, Q}, e.g. {{BIQUAD_NOTCH, 48.0f, 4.0f}, {BIQUAD_LOWPASS, 100.0f, 0.707f}}.
+// Locate resonances with SPECTRUM_ENABLE in calibrate_task.h before adding a notch: every stage adds phase lag
+// to the speed loop below its frequency.
+#define GIMBAL_BIQUAD_FILTER 1
+// Tables of a robot go under its (ROBOT_TYPE == ...), a table it leaves undefined has no stage.
+// @TODO: measure the pitch arm and yaw resonances of each robot
+#ifndef YAW_GYRO_FILTER_TABLE
+#define YAW_GYRO_FILTER_TABLE {{BIQUAD_BYPASS, 0.0f, 0.0f}}
+#endif
+#ifndef PITCH_GYRO_FILTER_TABLE
+#define PITCH_GYRO_FILTER_TABLE {{BIQUAD_BYPASS, 0.0f, 0.0f}}
+#endif
+#ifndef YAW_CMD_FILTER_TABLE
+#define YAW_CMD_FILTER_TABLE {{BIQUAD_BYPASS, 0.0f, 0.0f}}
+#endif
+#ifndef PITCH_CMD_FILTER_TABLE
+#define PITCH_CMD_FILTER_TABLE {{BIQUAD_BYPASS, 0.0f, 0.0f}}
+#endif
+
+// continuous multi-turn yaw for the slip ring, where relative_angle and absolute_angle wrap at +-PI while spinning:
+// relative angle tracked from the yaw encoder with the rate of the yaw motor feedback, absolute angle from INS yaw with
+// the gyro; the observers also give the encoder angle and speed below the encoder quantum
+// checked across wraps, the 4310 position wrap and quantization by Scripts/yaw_angle_tracker_test.py
+#define GIMBAL_YAW_ANGLE_TRACKER 1
+#define YAW_RELATIVE_TRACKER_BANDWIDTH_HZ 10.0f
+#define YAW_ABSOLUTE_TRACKER_BANDWIDTH_HZ 10.0f
+
 #define PITCH_MOTOR_CURRENT_LIMIT  30000
 // @TODO: tune YAW_4310_MOTOR_TORQUE_LIMIT
 #define YAW_4310_MOTOR_TORQUE_LIMIT  7.0f
@@ -400,6 +488,13 @@ typedef struct
     pid_type_def gimbal_motor_absolute_angle_pid;
     pid_type_def gimbal_motor_relative_angle_pid;
     pid_type_def gimbal_motor_speed_pid;
+#if GIMBAL_USE_LQR
+    lqr_type_def gimbal_motor_lqr;
+#endif
+#if GIMBAL_TRAJECTORY_GENERATOR
+    trajectory_generator_t absolute_angle_trajectory; // from absolute_angle_set to the reference of the cascade
+    fp32 trajectory_inertia; // acceleration feedforward gain
+#endif
     gimbal_motor_mode_e gimbal_motor_mode;
     gimbal_motor_mode_e last_gimbal_motor_mode;
     uint16_t offset_ecd;
@@ -413,6 +508,11 @@ typedef struct
     fp32 absolute_angle_offset; //rad
     fp32 motor_gyro;         //rad/s
     fp32 motor_gyro_set;
+#if GIMBAL_BIQUAD_FILTER
+    fp32 motor_gyro_raw;     //rad/s, motor_gyro before gyro_filter
+    biquad_filter_t gyro_filter;
+    biquad_filter_t cmd_filter; // on cmd_value of the angle and speed loops
+#endif
 
     fp32 raw_cmd_current;
     fp32 cmd_value;
@@ -444,6 +544,14 @@ typedef struct
     gimbal_motor_t gimbal_yaw_motor;
     gimbal_motor_t gimbal_pitch_motor;
     gimbal_step_cali_t gimbal_cali;
+#if YAW_DOB_ENABLE
+    disturbance_observer_t yaw_dob;
+    uint8_t fYawDobActive;
+#endif
+#if GIMBAL_YAW_ANGLE_TRACKER
+    angle_tracker_t yaw_relative_tracker;
+    angle_tracker_t yaw_absolute_tracker;
+#endif
 } gimbal_control_t;
 
 /**
@@ -499,4 +607,24 @@ extern bool_t gimbal_emergency_stop(void);
 
 fp32 get_gimbal_yaw_angle(void);
 fp32 get_gimbal_pitch_angle(void);
+#if GIMBAL_YAW_ANGLE_TRACKER
+/**
+  * @brief          multi-turn yaw relative angle, continuous where relative_angle wraps at +-PI
+  * @param[in]      none
+  * @retval         relative angle, unit rad, 0 at offset_ecd at power on
+  */
+extern fp32 get_gimbal_yaw_relative_angle_multi_turn(void);
+/**
+  * @brief          rate of the yaw relative angle, from the yaw motor feedback and the encoder
+  * @param[in]      none
+  * @retval         speed, unit rad/s
+  */
+extern fp32 get_gimbal_yaw_relative_speed(void);
+/**
+  * @brief          multi-turn gimbal yaw, continuous where get_gimbal_yaw_angle wraps at +-PI
+  * @param[in]      none
+  * @retval         angle, unit rad
+  */
+extern fp32 get_gimbal_yaw_angle_multi_turn(void);
+#endif
 #endif
@@ -6,15 +6,11 @@
 #include "CRC8_CRC16.h"
 #include "protocol.h"
 #include "referee.h"
-#include "usart.h"
+#include "referee_tx.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 
-extern uint8_t CRC8_INIT;
-extern uint16_t CRC16_INIT;
-uint8_t UI_Seq; // Packet sequence number
-
 uint16_t get_receiver_id(uint16_t sender_ID)
 {
 	switch (sender_ID)
@@ -48,11 +44,6 @@ uint16_t get_receiver_id(uint16_t sender_ID)
 	}
 }
 
-void ui_sendbyte(unsigned char ch)
-{
-	HAL_UART_Transmit(&huart6, (uint8_t *)&ch, 1, 999);
-}
-
 /********************************************Delete Operation*************************************
 **Parameters: Del_Operate  Corresponding header file deletion operation
               Del_Layer    Layer to be deleted, values from 0 to 9
@@ -60,21 +51,9 @@ void ui_sendbyte(unsigned char ch)
 
 void ui_delete(uint8_t del_operate, uint8_t del_layer)
 {
-	unsigned char *framepoint;       // Read-write pointer
-	uint16_t frametail = CRC16_INIT; // CRC16 checksum value
-	int loop_control;                // For loop control variable
-
-	graphic_data_packhead framehead; // General Frame Header
-	graphic_data_head datahead;      // "Sub-header" for graphics
-	graphic_delete del;              // Delete operation
-
-	framepoint = (unsigned char *)&framehead;
-
-	framehead.SOF = UI_SOF;
-	framehead.data_length = 8;
-	framehead.seq = UI_Seq;
-	framehead.CRC8 = get_CRC8_check_sum(framepoint, 4, CRC8_INIT);
-	framehead.cmd_ID = STUDENT_INTERACTIVE_DATA_CMD_ID; // Fill in the header data
+	graphic_data_head datahead; // "Sub-header" for graphics
+	graphic_delete del;         // Delete operation
+	uint8_t payload[sizeof(graphic_data_head) + sizeof(graphic_delete)];
 
 	datahead.data_cmd_ID = UI_Data_ID_Del;
 	/*SZL 6-16-2022 Dynamically receive the referee system ID*/
@@ -129,43 +108,10 @@ void ui_delete(uint8_t del_operate, uint8_t del_layer)
 	del.delete_operate = del_operate;
 	del.layer = del_layer; // Control information
 
-	// CRC16 checksum calculation
-	frametail = get_CRC16_check_sum(framepoint, sizeof(framehead), frametail);
-	framepoint = (unsigned char *)&datahead;
-	frametail = get_CRC16_check_sum(framepoint, sizeof(datahead), frametail);
-	framepoint = (unsigned char *)&del;
-	frametail = get_CRC16_check_sum(framepoint, sizeof(del), frametail);
-
-	// Send all frames
-	framepoint = (unsigned char *)&framehead;
-	for (loop_control = 0; loop_control < sizeof(framehead); loop_control++)
-	{
-		ui_sendbyte(*framepoint);
-		framepoint++;
-	}
-	framepoint = (unsigned char *)&datahead;
-	for (loop_control = 0; loop_control < sizeof(datahead); loop_control++)
-	{
-		ui_sendbyte(*framepoint);
-		framepoint++;
-	}
-	framepoint = (unsigned char *)&del;
-	for (loop_control = 0; loop_control < sizeof(del); loop_control++)
-	{
-		ui_sendbyte(*framepoint);
-		framepoint++;
-	}
-
-	// Send CRC16 checksum value
-	framepoint = (unsigned char *)&frametail;
-	for (loop_control = 0; loop_control < sizeof(frametail); loop_control++)
-	{
-		ui_sendbyte(*framepoint);
-		framepoint++;
-	}
-
-	// Increment sequence number
-	UI_Seq++;
+	// Header, sequence number and checksums are added by the transmit queue
+	memcpy(payload, &datahead, sizeof(datahead));
+	memcpy(&payload[sizeof(datahead)], &del, sizeof(del));
+	referee_data_pack_handle(STUDENT_INTERACTIVE_DATA_CMD_ID, payload, sizeof(payload));
 }
 
 /**
@@ -451,36 +397,10 @@ void float_draw(string_data *image, char figure_name[3], uint32_t graph_operate,
 	}
 }
 
-void referee_data_pack_handle(uint8_t sof, uint16_t cmd_id, uint8_t *p_data, uint16_t len)
+int referee_data_pack_handle(uint16_t cmd_id, uint8_t *p_data, uint16_t len)
 {
-	uint8_t tx_buff[MAX_SIZE];
-
-	uint16_t frame_length = FRAMEHEADER_LEN + CMD_LEN + len + CRC_LEN; // Data frame length
-
-	memset(tx_buff, 0, frame_length); // Clear the array for storing data
-
-	/***** Frame Header Packing *****/
-	tx_buff[0] = sof;                                  // Start byte of the data frame
-	memcpy(&tx_buff[1], (uint8_t *)&len, sizeof(len)); // Length of the data in the data frame
-	tx_buff[3] = UI_Seq;                               // Packet sequence number
-	append_CRC8_check_sum(tx_buff, FRAMEHEADER_LEN);   // Frame header CRC8 checksum
-
-	/***** Command Code Packing *****/
-	memcpy(&tx_buff[FRAMEHEADER_LEN], (uint8_t *)&cmd_id, CMD_LEN);
-
-	/***** Data Packing *****/
-	memcpy(&tx_buff[FRAMEHEADER_LEN + CMD_LEN], p_data, len);
-	append_CRC16_check_sum(tx_buff, frame_length); // Data frame CRC16 checksum
-
-	if (UI_Seq == 0xff)
-		UI_Seq = 0;
-	else
-		UI_Seq++;
-
-	for (int i = 0; i < frame_length; i++)
-	{
-		HAL_UART_Transmit(&huart6, tx_buff + i, 1, 99);
-	}
+	// Sleeps, not spins, while the referee bandwidth is used up: the UI is sent in full and in order
+	return referee_tx_send_wait(cmd_id, p_data, len, NULL, UI_SEND_TIMEOUT_MS) ? 0 : -1;
 }
 
 // TODO: Maybe make it so can upload multiple graphics at once as supported by the protocol
@@ -498,9 +418,7 @@ int update_ui(graphic_data_struct_t *image_ptr)
 
 	memcpy(&custom_grapic_draw.graphic_custom.grapic_data_struct, image_ptr, sizeof(graphic_data_struct_t));
 
-	referee_data_pack_handle(UI_SOF, UI_CMD_Robo_Exchange, (uint8_t *)&custom_grapic_draw, sizeof(custom_grapic_draw));
-
-	return 0;
+	return referee_data_pack_handle(UI_CMD_Robo_Exchange, (uint8_t *)&custom_grapic_draw, sizeof(custom_grapic_draw));
 }
 
 int update_char(string_data *string_ptr)
@@ -518,7 +436,5 @@ int update_char(string_data *string_ptr)
 	// memcpy(&custom_grapic_draw.graphic_custom.grapic_data_struct, string_ptr, sizeof(graphic_data_struct_t));
 	memcpy(&custom_grapic_draw.string_custom, string_ptr, sizeof(string_data));
 
-	referee_data_pack_handle(UI_SOF, UI_CMD_Robo_Exchange, (uint8_t *)&custom_grapic_draw, 45);
-
-	return 0;
+	return referee_data_pack_handle(UI_CMD_Robo_Exchange, (uint8_t *)&custom_grapic_draw, 45);
 }
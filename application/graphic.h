@@ -12,6 +12,7 @@
 #define FRAMEHEADER_LEN 5 // Frame header length
 #define CMD_LEN 2         // Command code length
 #define CRC_LEN 2         // CRC16 checksum
+#define UI_SEND_TIMEOUT_MS 100 // Longest wait for referee bandwidth, the element is dropped after it
 
 /****************************CMD_ID Data ********************/
 // CMD_ID in the packet header denotes inter-robot interaction data,
@@ -168,6 +169,7 @@ void line_draw(graphic_data_struct_t *image, char figure_name[3], uint32_t graph
 void char_draw(string_data *image, char figure_name[3], uint32_t graph_operate, uint32_t graph_layer, uint32_t graph_color, uint32_t graph_size, uint32_t graph_digit, uint32_t graph_width, uint32_t start_x, uint32_t start_y, char *char_data);
 void float_draw(string_data *image, char figure_name[3], uint32_t graph_operate, uint32_t graph_layer, uint32_t graph_color, uint32_t graph_size, uint32_t graph_digit, uint32_t graph_width, uint32_t start_x, uint32_t start_y, float graph_float);
 void circle_draw(graphic_data_struct_t *image, char figure_name[3], uint32_t graph_operate, uint32_t graph_layer, uint32_t graph_color, uint32_t graph_width, uint32_t start_x, uint32_t start_y, uint32_t graph_radius);
+int referee_data_pack_handle(uint16_t cmd_id, uint8_t *p_data, uint16_t len);
 int update_ui(graphic_data_struct_t *image_ptr);
 int update_char(string_data *string_ptr);
 #endif
@@ -0,0 +1,62 @@
+/**
+ * @file       muzzle_speed.c/h
+ * @brief      Muzzle speed regulation: adjusts the friction wheel speed shot by shot from the referee initial speed, to
+ *             hold the projectiles just below the speed limit
+ * @arthur     MacFalcons Control Team
+ */
+#include "muzzle_speed.h"
+#include "shoot.h"
+#include "referee.h"
+#include "user_lib.h"
+#include "math.h"
+
+// shooter of this controller, as in get_shoot_heat0_limit_and_heat
+#define MUZZLE_SPEED_SHOOTER_INDEX 0
+
+muzzle_speed_t muzzle_speed_data;
+
+void muzzle_speed_init(void)
+{
+    muzzle_speed_data.speed_set = fp32_constrain(FRICTION_MOTOR_SPEED, MUZZLE_SPEED_SET_MIN, MUZZLE_SPEED_SET_MAX);
+    // FRICTION_MOTOR_RPM_TO_SPEED already holds the calibrated SPEED_COMPENSATION_RATIO
+    muzzle_speed_data.gain = 1.0f;
+    muzzle_speed_data.spread = MUZZLE_SPEED_INITIAL_SPREAD;
+    muzzle_speed_data.target = MUZZLE_SPEED_LIMIT - fmaxf(MUZZLE_SPEED_MIN_MARGIN, MUZZLE_SPEED_SPREAD_GAIN * MUZZLE_SPEED_INITIAL_SPREAD);
+    muzzle_speed_data.last_speed = 0.0f;
+    muzzle_speed_data.last_shoot_data_update = get_shoot_data_update_count(MUZZLE_SPEED_SHOOTER_INDEX);
+    muzzle_speed_data.shot_count = 0;
+    muzzle_speed_data.overspeed_count = 0;
+}
+
+void muzzle_speed_update(void)
+{
+    muzzle_speed_t *muzzle = &muzzle_speed_data;
+    uint32_t shoot_data_update = get_shoot_data_update_count(MUZZLE_SPEED_SHOOTER_INDEX);
+    if (shoot_data_update == muzzle->last_shoot_data_update)
+    {
+        return;
+    }
+    muzzle->last_shoot_data_update = shoot_data_update;
+    fp32 speed = shoot_control.bullet_init_speed[MUZZLE_SPEED_SHOOTER_INDEX];
+    if (speed < MUZZLE_SPEED_VALID_MIN)
+    {
+        return;
+    }
+    muzzle->last_speed = speed;
+    muzzle->shot_count++;
+
+    // the shot left at the current set-point, the wheels settle well within a fire period
+    fp32 error = speed - muzzle->gain * muzzle->speed_set;
+    muzzle->spread += MUZZLE_SPEED_SPREAD_FILTER_COEFF * (fabsf(error) - muzzle->spread);
+    muzzle->gain += MUZZLE_SPEED_GAIN_FILTER_COEFF * (speed / muzzle->speed_set - muzzle->gain);
+    muzzle->target = MUZZLE_SPEED_LIMIT - fmaxf(MUZZLE_SPEED_MIN_MARGIN, MUZZLE_SPEED_SPREAD_GAIN * muzzle->spread);
+
+    fp32 speed_set = fp32_constrain(muzzle->target / muzzle->gain, muzzle->speed_set - MUZZLE_SPEED_MAX_STEP, muzzle->speed_set + MUZZLE_SPEED_MAX_STEP);
+    if (speed > MUZZLE_SPEED_LIMIT - MUZZLE_SPEED_OVERSPEED_BAND)
+    {
+        // too close, scale the set-point back to the target at once
+        muzzle->overspeed_count++;
+        speed_set = fminf(speed_set, muzzle->speed_set * muzzle->target / speed);
+    }
+    muzzle->speed_set = fp32_constrain(speed_set, MUZZLE_SPEED_SET_MIN, MUZZLE_SPEED_SET_MAX);
+}
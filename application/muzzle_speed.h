@@ -0,0 +1,73 @@
+/**
+ * @file       muzzle_speed.c/h
+ * @brief      Muzzle speed regulation: adjusts the friction wheel speed shot by shot from the referee initial speed, to
+ *             hold the projectiles just below the speed limit
+ * @arthur     MacFalcons Control Team
+ * The muzzle speed for a friction wheel set-point drifts with barrel and wheel temperature and projectile wear, so a
+ * fixed FRICTION_MOTOR_SPEED has to keep a wide clearance below the limit. Each referee shoot data report (0x0207)
+ * updates the measured over set-point speed gain and the shot-to-shot spread around it; the set-point then aims at the
+ * limit minus a margin that grows with the spread:
+ *   - the set-point moves at most MUZZLE_SPEED_MAX_STEP per shot, so an outlier can't swing it
+ *   - a shot within MUZZLE_SPEED_OVERSPEED_BAND of the limit cuts the set-point right away, without the step limit
+ *   - the set-point stays within MUZZLE_SPEED_SET_MIN..MUZZLE_SPEED_SET_MAX
+ */
+#ifndef MUZZLE_SPEED_H
+#define MUZZLE_SPEED_H
+#include "global_inc.h"
+#include "shoot.h"
+
+// 0: friction wheels at the fixed FRICTION_MOTOR_SPEED
+#define MUZZLE_SPEED_REGULATION 1
+// 17mm projectile speed limit, m/s
+#define MUZZLE_SPEED_LIMIT 30.0f
+// target is the limit minus max(MUZZLE_SPEED_MIN_MARGIN, MUZZLE_SPEED_SPREAD_GAIN * spread), m/s
+#define MUZZLE_SPEED_MIN_MARGIN 1.2f
+#define MUZZLE_SPEED_SPREAD_GAIN 5.0f
+// spread assumed before the first shots, m/s
+#define MUZZLE_SPEED_INITIAL_SPREAD 0.4f
+#define MUZZLE_SPEED_GAIN_FILTER_COEFF 0.15f
+#define MUZZLE_SPEED_SPREAD_FILTER_COEFF 0.05f
+// set-point change per shot, m/s
+#define MUZZLE_SPEED_MAX_STEP 0.4f
+#define MUZZLE_SPEED_OVERSPEED_BAND 0.3f
+// reports below this are not a proper shot (jam, half-spun wheels), m/s
+#define MUZZLE_SPEED_VALID_MIN 10.0f
+#if ENABLE_SHOOT_REDUNDANT_SWITCH
+// nominal muzzle speed of the set-point, FRICTION_MOTOR_RPM_TO_SPEED; 26.99m/s is the M3508 no-load limit, the wheels
+// held 26.2m/s in tests (shoot.h), the set-point goes no further and stays a margin below the speed limit
+#define MUZZLE_SPEED_SET_MIN 20.0f
+#define MUZZLE_SPEED_WHEEL_MAX 26.2f
+#define MUZZLE_SPEED_SET_MAX ((MUZZLE_SPEED_WHEEL_MAX < MUZZLE_SPEED_LIMIT - MUZZLE_SPEED_MIN_MARGIN) ? MUZZLE_SPEED_WHEEL_MAX : (MUZZLE_SPEED_LIMIT - MUZZLE_SPEED_MIN_MARGIN))
+#else
+// wheels barely turn for bench tests, not to be spun up
+#define MUZZLE_SPEED_SET_MIN FRICTION_MOTOR_SPEED
+#define MUZZLE_SPEED_SET_MAX FRICTION_MOTOR_SPEED
+#endif
+
+typedef struct
+{
+    fp32 speed_set;  // m/s, nominal muzzle speed of the friction wheel set-point
+    fp32 gain;       // measured muzzle speed over speed_set
+    fp32 spread;     // m/s, mean absolute deviation of measured speed from gain * speed_set
+    fp32 target;     // m/s
+    fp32 last_speed; // m/s, latest referee initial speed
+    uint32_t last_shoot_data_update;
+    uint32_t shot_count;
+    uint32_t overspeed_count; // shots within MUZZLE_SPEED_OVERSPEED_BAND of the limit
+} muzzle_speed_t;
+
+extern muzzle_speed_t muzzle_speed_data;
+
+/**
+  * @brief          reset the regulator to FRICTION_MOTOR_SPEED
+  * @retval         none
+  */
+extern void muzzle_speed_init(void);
+
+/**
+  * @brief          take new referee shoot data into the set-point, call every shoot control period
+  * @retval         none
+  */
+extern void muzzle_speed_update(void);
+
+#endif
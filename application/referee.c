@@ -27,13 +27,16 @@ ext_referee_warning_t referee_warning_t; // 0x0104
 
 ext_game_robot_state_t robot_state;                // 0x0201
 ext_power_heat_data_t power_heat_data_t;           // 0x0202
+static uint32_t power_heat_data_update_count = 0;
 ext_game_robot_pos_t game_robot_pos_t;             // 0x0203
 ext_buff_musk_t buff_musk_t;                       // 0x0204
 ext_aerial_robot_energy_t robot_energy_t;          // 0x0205
 ext_robot_hurt_t robot_hurt_t;                     // 0x0206
 ext_shoot_data_t shoot_data_t;                     // 0x0207
+static uint32_t shoot_data_update_count[2] = {0};
 ext_rfid_status_t rfid_status_t;                   // 0x0208
 ext_projectile_allowance_t projectile_allowance_t; // 0x0209
+static uint32_t projectile_allowance_update_count = 0;
 // ext_dart_client_cmd_t dart_client_cmd_t;                     //0x020A
 ext_ground_robot_position_t ground_robot_position_t; // 0x020B
 ext_radar_mark_data_t radar_mark_data_t;             // 0x020C
@@ -180,6 +183,7 @@ void referee_data_solve(uint8_t *frame)
 		case POWER_HEAT_DATA_CMD_ID:
 		{
 			memcpy(&power_heat_data_t, frame + index, sizeof(power_heat_data_t));
+			power_heat_data_update_count++;
 			break;
 		}
 		case ROBOT_POS_CMD_ID:
@@ -212,6 +216,7 @@ void referee_data_solve(uint8_t *frame)
 				{
 					shoot_control.launching_frequency[shoot_data_t.shooter_number - 1] = shoot_data_t.launching_frequency;
 					shoot_control.bullet_init_speed[shoot_data_t.shooter_number - 1] = shoot_data_t.initial_speed;
+					shoot_data_update_count[shoot_data_t.shooter_number - 1]++;
 					break;
 				}
 				default:
@@ -229,6 +234,7 @@ void referee_data_solve(uint8_t *frame)
 		case PROJECTILE_ALLOWANCE_CMD_ID:
 		{
 			memcpy(&projectile_allowance_t, frame + index, sizeof(projectile_allowance_t));
+			projectile_allowance_update_count++;
 			break;
 		}
 		case GROUND_ROBOT_POSITION_CMD_ID:
@@ -330,6 +336,30 @@ void get_chassis_power_data(fp32 *power, fp32 *buffer, fp32 *power_limit)
 	}
 }
 
+uint32_t get_power_heat_data_update_count(void)
+{
+	return power_heat_data_update_count;
+}
+
+uint32_t get_shoot_data_update_count(uint8_t shooter_index)
+{
+	if (shooter_index >= 2)
+	{
+		return 0;
+	}
+	return shoot_data_update_count[shooter_index];
+}
+
+uint16_t get_projectile_allowance_17mm(void)
+{
+	return projectile_allowance_t.projectile_allowance_17mm;
+}
+
+uint32_t get_projectile_allowance_update_count(void)
+{
+	return projectile_allowance_update_count;
+}
+
 uint8_t get_robot_id(void)
 {
 	return robot_state.robot_id;
@@ -385,7 +415,12 @@ uint8_t is_game_started(void)
 	return ((game_state.game_progress == 4) && (toe_is_error(REFEREE_TOE) == 0));
 }
 
-uint8_t get_time_remain(void)
+uint8_t get_game_progress(void)
+{
+	return game_state.game_progress;
+}
+
+uint16_t get_time_remain(void)
 {
 	return game_state.stage_remain_time;
 }
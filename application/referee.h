@@ -381,6 +381,13 @@ extern void init_referee_struct_data(void);
 extern void referee_data_solve(uint8_t *frame);
 
 extern void get_chassis_power_data(fp32 *power, fp32 *buffer, fp32 *power_limit);
+// increases on every power and heat packet, tells a fresh chassis power sample from a repeated one
+extern uint32_t get_power_heat_data_update_count(void);
+// increases on every shoot data packet of the shooter (0: 17mm shooter 1, 1: 17mm shooter 2), one per projectile
+extern uint32_t get_shoot_data_update_count(uint8_t shooter_index);
+// 17mm projectiles the robot may still fire, and a count increasing on every allowance packet
+extern uint16_t get_projectile_allowance_17mm(void);
+extern uint32_t get_projectile_allowance_update_count(void);
 
 extern uint8_t get_robot_id(void);
 extern uint8_t get_team_color(void);
@@ -390,7 +397,8 @@ extern uint16_t get_blue_outpost_HP(void);
 extern void get_shoot_heat0_limit_and_heat(uint16_t *heat_limit, uint16_t *heat0);
 extern void get_shoot_heat1_limit_and_heat(uint16_t *heat_limit, uint16_t *heat1);
 uint8_t is_game_started(void);
-uint8_t get_time_remain(void);
+uint8_t get_game_progress(void);
+uint16_t get_time_remain(void);
 uint16_t get_current_HP(void);
 armor_damage_info_t get_armor_hurt(void);
 
@@ -0,0 +1,156 @@
+/**
+ * @file       referee_tx.c/h
+ * @brief      Referee transmit queue: frames packed into a ring of slots and sent by USART6 TX DMA, within the uplink
+ *             bandwidth of the referee system
+ * @arthur     MacFalcons Control Team
+ */
+#include "referee_tx.h"
+#include "bsp_usart.h"
+#include "cmsis_os.h"
+#include "CRC8_CRC16.h"
+#include <string.h>
+
+referee_tx_t referee_tx;
+
+/**
+  * @brief          hand the head slot to the DMA
+  * @param[in]      none
+  * @retval         none
+  */
+static void referee_tx_start(void)
+{
+    referee_tx_slot_t *slot = &referee_tx.slots[referee_tx.head];
+    referee_tx.fBusy = 1;
+    usart6_tx_dma_enable(slot->frame, slot->len);
+}
+
+/**
+  * @brief          transfer complete of the head slot, in the DMA interrupt: free it, start the next
+  * @param[in]      none
+  * @retval         none
+  */
+static void referee_tx_cplt(void)
+{
+    if (referee_tx.count == 0)
+    {
+        referee_tx.fBusy = 0;
+        return;
+    }
+    referee_tx_slot_t *slot = &referee_tx.slots[referee_tx.head];
+    referee_tx.sent_frames++;
+    referee_tx.sent_bytes += slot->len;
+    if (slot->callback != NULL)
+    {
+        slot->callback(slot->cmd_id);
+    }
+    referee_tx.head = (referee_tx.head + 1) % REFEREE_TX_QUEUE_LEN;
+    referee_tx.count--;
+    if (referee_tx.count > 0)
+    {
+        referee_tx_start();
+    }
+    else
+    {
+        referee_tx.fBusy = 0;
+    }
+}
+
+/**
+  * @brief          fill the token bucket for the time since the last refill
+  * @param[in]      now: system time, ms
+  * @retval         none
+  */
+static void referee_tx_refill(uint32_t now)
+{
+    referee_tx.budget += (fp32)(now - referee_tx.last_refill) * (REFEREE_TX_BANDWIDTH_BYTES_PER_S / 1000.0f);
+    if (referee_tx.budget > REFEREE_TX_BURST_BYTES)
+    {
+        referee_tx.budget = REFEREE_TX_BURST_BYTES;
+    }
+    referee_tx.last_refill = now;
+}
+
+uint16_t referee_tx_pack_frame(uint8_t *frame, uint8_t seq, uint16_t cmd_id, const uint8_t *data, uint16_t len)
+{
+    uint16_t frame_len = len + REF_HEADER_CRC_CMDID_LEN;
+    frame[0] = HEADER_SOF;
+    memcpy(&frame[1], &len, sizeof(len));
+    frame[3] = seq;
+    append_CRC8_check_sum(frame, REF_PROTOCOL_HEADER_SIZE);
+    memcpy(&frame[REF_PROTOCOL_HEADER_SIZE], &cmd_id, sizeof(cmd_id));
+    memcpy(&frame[REF_HEADER_CMDID_LEN], data, len);
+    append_CRC16_check_sum(frame, frame_len);
+    return frame_len;
+}
+
+void referee_tx_init(void)
+{
+    memset(&referee_tx, 0, sizeof(referee_tx));
+    referee_tx.budget = REFEREE_TX_BURST_BYTES;
+    referee_tx.last_refill = osKernelSysTick();
+    usart6_tx_dma_set_callback(referee_tx_cplt);
+    referee_tx.fInit = 1;
+}
+
+/**
+  * @brief          queue a frame if a slot is free and the budget holds it plus a reserve
+  * @param[in]      cmd_id: command id
+  * @param[in]      data: frame data, copied
+  * @param[in]      len: data length
+  * @param[in]      callback: called once the frame is sent, NULL for none
+  * @param[in]      reserve: bytes left in the budget for other senders
+  * @retval         1 queued, 0 refused
+  */
+static bool_t referee_tx_queue(uint16_t cmd_id, const uint8_t *data, uint16_t len, referee_tx_callback_t callback, uint16_t reserve)
+{
+    if ((referee_tx.fInit == 0) || (data == NULL) || (len > REFEREE_TX_DATA_MAX_SIZE))
+    {
+        return 0;
+    }
+
+    bool_t fQueued = 0;
+    uint16_t frame_len = len + REF_HEADER_CRC_CMDID_LEN;
+    // the transfer complete interrupt is under configMAX_SYSCALL_INTERRUPT_PRIORITY, so masked here
+    taskENTER_CRITICAL();
+    referee_tx_refill(osKernelSysTick());
+    if ((referee_tx.count < REFEREE_TX_QUEUE_LEN) && (referee_tx.budget >= frame_len + reserve))
+    {
+        referee_tx_slot_t *slot = &referee_tx.slots[(referee_tx.head + referee_tx.count) % REFEREE_TX_QUEUE_LEN];
+        slot->len = referee_tx_pack_frame(slot->frame, referee_tx.seq, cmd_id, data, len);
+        slot->cmd_id = cmd_id;
+        slot->callback = callback;
+        referee_tx.seq++;
+        referee_tx.budget -= frame_len;
+        referee_tx.count++;
+        if (referee_tx.fBusy == 0)
+        {
+            referee_tx_start();
+        }
+        fQueued = 1;
+    }
+    else
+    {
+        referee_tx.refused_frames++;
+    }
+    taskEXIT_CRITICAL();
+    return fQueued;
+}
+
+bool_t referee_tx_send(uint16_t cmd_id, const uint8_t *data, uint16_t len, referee_tx_callback_t callback)
+{
+    return referee_tx_queue(cmd_id, data, len, callback, 0);
+}
+
+bool_t referee_tx_send_wait(uint16_t cmd_id, const uint8_t *data, uint16_t len, referee_tx_callback_t callback, uint32_t timeout_ms)
+{
+    uint32_t ulStartTime = osKernelSysTick();
+    while (referee_tx_queue(cmd_id, data, len, callback, REFEREE_TX_WAIT_RESERVE_BYTES) == 0)
+    {
+        if ((len > REFEREE_TX_DATA_MAX_SIZE) || (osKernelSysTick() - ulStartTime >= timeout_ms))
+        {
+            return 0;
+        }
+        osDelay(REFEREE_TX_WAIT_PERIOD_MS);
+    }
+    return 1;
+}
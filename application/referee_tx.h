@@ -0,0 +1,105 @@
+/**
+ * @file       referee_tx.c/h
+ * @brief      Referee transmit queue: frames packed into a ring of slots and sent by USART6 TX DMA, within the uplink
+ *             bandwidth of the referee system
+ * @arthur     MacFalcons Control Team
+ * Sending a frame packs it (header, CRC8, cmd id, data, CRC16, as referee_unpack_fifo_data expects them) straight into
+ * a free slot and returns; the DMA sends the slots back to back, the transfer complete interrupt of one starting the
+ * next and calling the completion callback of the frame sent. A send costs the packing and CRC, a few microseconds,
+ * where the blocking HAL_UART_Transmit of every byte held the caller 87us per byte at 115200 baud.
+ * The referee passes on at most REFEREE_TX_BANDWIDTH_BYTES_PER_S of the robot's frames and drops the rest, so frames
+ * are admitted against a token bucket: it fills at that rate up to REFEREE_TX_BURST_BYTES, and a frame is queued only
+ * if the bucket holds its whole length, which it takes out. Everything queued is then sent at the line rate, faster
+ * than the budget, so the queue never holds more than a burst. A frame over the budget or without a free slot is
+ * refused, not queued: referee_tx_send never blocks and may be called from any task; referee_tx_send_wait sleeps
+ * until the frame is admitted, for tasks that must send everything in order (UI). Waiting senders would take every
+ * byte the moment it fills in, so they leave REFEREE_TX_WAIT_RESERVE_BYTES in the bucket for the others.
+ * The sequence number of the frame header counts every frame sent.
+ */
+#ifndef REFEREE_TX_H
+#define REFEREE_TX_H
+#include "global_inc.h"
+#include "protocol.h"
+
+// uplink limit of the referee system for the robot's own frames
+// @TODO: check against the serial protocol manual of the season
+#define REFEREE_TX_BANDWIDTH_BYTES_PER_S 3720
+#define REFEREE_TX_BURST_BYTES 256
+// kept by referee_tx_send_wait for referee_tx_send
+#define REFEREE_TX_WAIT_RESERVE_BYTES 64
+#define REFEREE_TX_QUEUE_LEN 8
+#define REFEREE_TX_FRAME_MAX_SIZE REF_PROTOCOL_FRAME_MAX_SIZE
+#define REFEREE_TX_DATA_MAX_SIZE (REFEREE_TX_FRAME_MAX_SIZE - REF_HEADER_CRC_CMDID_LEN)
+// retry period of referee_tx_send_wait, ms
+#define REFEREE_TX_WAIT_PERIOD_MS 1
+
+// called in the DMA interrupt once the frame has been handed to the UART, keep it short
+typedef void (*referee_tx_callback_t)(uint16_t cmd_id);
+
+typedef struct
+{
+    uint8_t frame[REFEREE_TX_FRAME_MAX_SIZE];
+    uint16_t len;
+    uint16_t cmd_id;
+    referee_tx_callback_t callback;
+} referee_tx_slot_t;
+
+typedef struct
+{
+    referee_tx_slot_t slots[REFEREE_TX_QUEUE_LEN];
+    uint8_t head;           // slot sent now or next
+    uint8_t count;          // slots queued, the one sent included
+    uint8_t fBusy;          // DMA running
+    uint8_t fInit;
+    uint8_t seq;
+    fp32 budget;            // bytes in the token bucket
+    uint32_t last_refill;   // ms
+    // statistics
+    uint32_t sent_frames;
+    uint32_t sent_bytes;
+    uint32_t refused_frames;
+} referee_tx_t;
+
+/**
+  * @brief          pack a referee frame
+  * @param[out]     frame: at least len + REF_HEADER_CRC_CMDID_LEN bytes
+  * @param[in]      seq: sequence number
+  * @param[in]      cmd_id: command id
+  * @param[in]      data: frame data
+  * @param[in]      len: data length
+  * @retval         frame length
+  */
+extern uint16_t referee_tx_pack_frame(uint8_t *frame, uint8_t seq, uint16_t cmd_id, const uint8_t *data, uint16_t len);
+
+/**
+  * @brief          start the queue with a full budget, after usart6_init
+  * @param[in]      none
+  * @retval         none
+  */
+extern void referee_tx_init(void);
+
+/**
+  * @brief          queue a frame for sending, never blocks; to be called from tasks, not interrupts
+  * @param[in]      cmd_id: command id
+  * @param[in]      data: frame data, copied
+  * @param[in]      len: data length, at most REFEREE_TX_DATA_MAX_SIZE
+  * @param[in]      callback: called once the frame is sent, NULL for none
+  * @retval         1 queued, 0 refused: queue not started, full, or over the budget
+  */
+extern bool_t referee_tx_send(uint16_t cmd_id, const uint8_t *data, uint16_t len, referee_tx_callback_t callback);
+
+/**
+  * @brief          queue a frame for sending, sleeping until it is admitted
+  * @param[in]      cmd_id: command id
+  * @param[in]      data: frame data, copied
+  * @param[in]      len: data length, at most REFEREE_TX_DATA_MAX_SIZE
+  * @param[in]      callback: called once the frame is sent, NULL for none
+  * @param[in]      timeout_ms: longest wait
+  * @retval         1 queued, 0 refused until the timeout
+  * @note           admitted once the budget holds the frame and REFEREE_TX_WAIT_RESERVE_BYTES more
+  */
+extern bool_t referee_tx_send_wait(uint16_t cmd_id, const uint8_t *data, uint16_t len, referee_tx_callback_t callback, uint32_t timeout_ms);
+
+extern referee_tx_t referee_tx;
+
+#endif
@@ -25,6 +25,7 @@
 #include "fifo.h"
 #include "protocol.h"
 #include "referee.h"
+#include "referee_tx.h"
 
 
 
@@ -55,6 +56,7 @@ void referee_usart_task(void const * argument)
     init_referee_struct_data();
     fifo_s_init(&referee_fifo, referee_fifo_buf, REFEREE_FIFO_BUF_LENGTH);
     usart6_init(usart6_buf[0], usart6_buf[1], USART_RX_BUF_LENGTH);
+    referee_tx_init();
 
     while(1)
     {
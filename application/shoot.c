@@ -30,6 +30,11 @@
 #include "detect_task.h"
 #include "gimbal_behaviour.h"
 #include "pid.h"
+#include "bsp_delay.h"
+#include "calibrate_task.h"
+#include "shoot_heat.h"
+#include "muzzle_speed.h"
+#include "fire_scheduler.h"
 
 // microswitch
 #define BUTTEN_TRIG_PIN HAL_GPIO_ReadPin(BUTTON_TRIG_GPIO_Port, BUTTON_TRIG_Pin)
@@ -75,6 +80,8 @@ void shoot_init(void)
 	static const fp32 trigger_speed_pid[3] = {TRIGGER_ANGLE_PID_KP, TRIGGER_ANGLE_PID_KI, TRIGGER_ANGLE_PID_KD};
 	PID_init(&shoot_control.friction_motor1_pid, PID_POSITION, shoot_speed_pid1, FRICTION_1_SPEED_PID_MAX_OUT, FRICTION_1_SPEED_PID_MAX_IOUT, 0, &raw_err_handler);
 	PID_init(&shoot_control.friction_motor2_pid, PID_POSITION, shoot_speed_pid2, FRICTION_2_SPEED_PID_MAX_OUT, FRICTION_2_SPEED_PID_MAX_IOUT, 0, &raw_err_handler);
+	pid_autotune_load_gains(PID_AUTOTUNE_FRICTION_SPEED, &shoot_control.friction_motor1_pid);
+	pid_autotune_load_gains(PID_AUTOTUNE_FRICTION_SPEED, &shoot_control.friction_motor2_pid);
 	PID_init(&shoot_control.trigger_motor_pid, PID_POSITION, trigger_speed_pid, TRIGGER_BULLET_PID_MAX_OUT, TRIGGER_BULLET_PID_MAX_IOUT, 0, &raw_err_handler);
 
 	// update data
@@ -98,9 +105,13 @@ void shoot_init(void)
 
 	shoot_control.block_time = 0;
 	shoot_control.reverse_time = 0;
+	jam_detector_init(&shoot_control.jam_detector, TRIGGER_JAM_INERTIA, TRIGGER_JAM_LOAD_THRESHOLD, TRIGGER_JAM_MIN_REVERSE, TRIGGER_JAM_MAX_REVERSE, TRIGGER_JAM_REPEAT_REVERSE, TRIGGER_JAM_REPEAT_ANGLE);
 
 	shoot_control.heat_limit = 0;
 	shoot_control.heat = 0;
+	shoot_heat_init();
+	muzzle_speed_init();
+	fire_scheduler_init();
 	shoot_control.cv_auto_shoot_start_time = 0;
 
 	memset(&shoot_control.launching_frequency, 0, sizeof(shoot_control.launching_frequency));
@@ -128,6 +139,9 @@ int16_t shoot_control_loop(void)
 			{
 #if USE_SERVO_TO_STIR_AMMO
 				CAN_cmd_load_servo(0, 3);
+#endif
+#if SHOOT_FIRE_SCHEDULER
+				fire_scheduler_reset();
 #endif
 				break;
 			}
@@ -146,6 +160,10 @@ int16_t shoot_control_loop(void)
 
 				shoot_control.friction_motor1_rpm_set = -FRICTION_MOTOR_SPEED * FRICTION_MOTOR_SPEED_TO_RPM;
 				shoot_control.friction_motor2_rpm_set = FRICTION_MOTOR_SPEED * FRICTION_MOTOR_SPEED_TO_RPM;
+#if SHOOT_FIRE_SCHEDULER
+				// the step in progress is finished
+				fire_scheduler_cancel();
+#endif
 				break;
 			}
 			case SHOOT_AUTO_FIRE:
@@ -154,8 +172,12 @@ int16_t shoot_control_loop(void)
 			}
 			case SHOOT_SEMI_AUTO_FIRE:
 			{
+#if SHOOT_FIRE_SCHEDULER
+				fire_scheduler_request(1);
+#else
 				shoot_control.set_angle = rad_format(shoot_control.angle + TRIGGER_ANGLE_INCREMENT);
 				shoot_control.trigger_speed_set = SEMI_AUTO_FIRE_TRIGGER_SPEED;
+#endif
 				break;
 			}
 			default:
@@ -249,12 +271,19 @@ int16_t shoot_control_loop(void)
 			{
 				shoot_control.shoot_mode = SHOOT_AUTO_FIRE;
 			}
+#if SHOOT_FIRE_SCHEDULER
+			else if (fire_scheduler_is_idle())
+			{
+				shoot_control.shoot_mode = SHOOT_READY_FRIC;
+			}
+#else
 			else if ((rad_format(shoot_control.set_angle - shoot_control.angle) <= TRIGGER_MOTOR_ANGLE_THRESHOLD) || isOverheated())
 			{
 				shoot_control.trigger_speed_set = 0.0f;
 				shoot_control.set_angle = shoot_control.angle;
 				shoot_control.shoot_mode = SHOOT_READY_FRIC;
 			}
+#endif
 			break;
 		}
 		case SHOOT_AUTO_FIRE:
@@ -286,6 +315,12 @@ int16_t shoot_control_loop(void)
 				}
 			}
 
+#if SHOOT_FIRE_SCHEDULER
+			if (shoot_control.shoot_mode == SHOOT_AUTO_FIRE)
+			{
+				fire_scheduler_hold(FIRE_SCHEDULER_HOLD_BURST);
+			}
+#else
 			if (isOverheated())
 			{
 				shoot_control.trigger_speed_set = 0;
@@ -294,12 +329,34 @@ int16_t shoot_control_loop(void)
 			{
 				shoot_control.trigger_speed_set = AUTO_FIRE_TRIGGER_SPEED;
 			}
+#endif
 			break;
 		}
 	}
 
+#if SHOOT_FIRE_SCHEDULER
+	// the scheduler drives the trigger whenever the friction wheels are up to speed
+	if ((shoot_control.shoot_mode == SHOOT_READY_FRIC) || (shoot_control.shoot_mode == SHOOT_SEMI_AUTO_FIRE) || (shoot_control.shoot_mode == SHOOT_AUTO_FIRE))
+	{
+		shoot_control.trigger_speed_set = fire_scheduler_update(osKernelSysTick());
+	}
+	else
+	{
+		fire_scheduler_reset();
+	}
+#endif
+
 	trigger_motor_stall_handler();
 
+#if MUZZLE_SPEED_REGULATION
+	if (shoot_control.shoot_mode != SHOOT_STOP)
+	{
+		// follows the regulator shot by shot
+		shoot_control.friction_motor1_rpm_set = -muzzle_speed_data.speed_set * FRICTION_MOTOR_SPEED_TO_RPM;
+		shoot_control.friction_motor2_rpm_set = muzzle_speed_data.speed_set * FRICTION_MOTOR_SPEED_TO_RPM;
+	}
+#endif
+
 	PID_calc(&shoot_control.friction_motor1_pid, shoot_control.friction_motor1_rpm, shoot_control.friction_motor1_rpm_set, SHOOT_CONTROL_TIME_S);
 	shoot_control.fric1_given_current = (int16_t)(shoot_control.friction_motor1_pid.out);
 
@@ -447,6 +504,8 @@ static void shoot_feedback_update(void)
 		shoot_control.left_click_hold_time = 0;
 	}
 	get_shoot_heat0_limit_and_heat(&shoot_control.heat_limit, &shoot_control.heat);
+	shoot_heat_update(osKernelSysTick());
+	muzzle_speed_update();
 }
 
 static void trigger_motor_stall_handler(void)
@@ -474,6 +533,19 @@ static void trigger_motor_stall_handler(void)
 	{
 		shoot_control.trigger_motor_pid.max_out = TRIGGER_BULLET_PID_MAX_OUT;
 
+#if TRIGGER_JAM_PREDICTION
+		static uint32_t handled_jam_count = 0;
+		if (shoot_control.jam_detector.state == JAM_DETECTOR_REVERSING)
+		{
+			if (handled_jam_count != shoot_control.jam_detector.jam_count)
+			{
+				// integral wound up against the jam would hold the wheel on it
+				handled_jam_count = shoot_control.jam_detector.jam_count;
+				PID_clear(&shoot_control.trigger_motor_pid);
+			}
+			shoot_control.speed_set = -TRIGGER_JAM_REVERSE_SPEED * shoot_control.jam_detector.direction;
+		}
+#else
 		if (shoot_control.block_time >= BLOCK_TIME)
 		{
 #if TRIGGER_ANTI_STALL_BY_WAIT
@@ -496,11 +568,34 @@ static void trigger_motor_stall_handler(void)
 		{
 			shoot_control.block_time = 0;
 		}
+#endif
 	}
 }
 
+void shoot_trigger_feedback(uint32_t cycle)
+{
+	// feedback frames are not aligned to the 1ms tick, two may arrive within one
+	static uint32_t last_cycle = 0;
+	uint32_t dt_us = (uint32_t)delay_cycle_to_us(cycle - last_cycle);
+	last_cycle = cycle;
+
+	// set by the shoot task, a single word read once
+	fp32 speed_set = shoot_control.trigger_speed_set;
+	if (fabsf(speed_set) < BLOCK_TRIGGER_SPEED)
+	{
+		speed_set = 0.0f;
+	}
+#if REVERSE_TRIGGER_DIRECTION
+	speed_set = -speed_set;
+#endif
+	jam_detector_update(&shoot_control.jam_detector, motor_chassis[MOTOR_INDEX_TRIGGER].speed_rpm * TRIGGER_MOTOR_RPM_TO_SPEED, motor_chassis[MOTOR_INDEX_TRIGGER].feedback_current, speed_set, dt_us);
+}
+
 bool_t isOverheated(void)
 {
+#if SHOOT_HEAT_LOCAL_MODEL
+	return shoot_heat_is_overheated();
+#else
 	bool_t out = 0;
 	if (toe_is_error(REFEREE_TOE) == 0)
 	{
@@ -517,4 +612,5 @@ bool_t isOverheated(void)
 		}
 	}
 	return out;
+#endif
 }
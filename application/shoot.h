@@ -23,6 +23,7 @@
 #include "remote_control.h"
 #include "user_lib.h"
 #include "chassis_task.h"
+#include "jam_detector.h"
 
 #define SHOOT_CONTROL_TIME_MS GIMBAL_CONTROL_TIME_MS
 #define SHOOT_CONTROL_TIME_S GIMBAL_CONTROL_TIME_S
@@ -92,6 +93,20 @@
 #define REVERSE_TIME                500
 #define REVERSE_SPEED_LIMIT         13.0f
 
+// 0: jam after BLOCK_TIME below BLOCK_TRIGGER_SPEED, then wait REVERSE_TIME
+// @TODO: enable once TRIGGER_JAM_INERTIA and TRIGGER_JAM_LOAD_THRESHOLD are tuned on recorded trigger traces
+#define TRIGGER_JAM_PREDICTION      0
+// feedback current to accelerate the trigger output shaft by 1 rad/s^2, about the M2006 rotor and wheel inertia
+#define TRIGGER_JAM_INERTIA         4.0f
+#define TRIGGER_JAM_LOAD_THRESHOLD  6000.0f
+// trigger output shaft angle of one ammo slot
+#define TRIGGER_SLOT_MOTOR_ANGLE    (TRIGGER_ANGLE_INCREMENT * TRIGGER_MOTOR_TO_WHEEL_GEAR_RATIO)
+#define TRIGGER_JAM_MIN_REVERSE     (0.1f * TRIGGER_SLOT_MOTOR_ANGLE)
+#define TRIGGER_JAM_MAX_REVERSE     (1.0f * TRIGGER_SLOT_MOTOR_ANGLE)
+#define TRIGGER_JAM_REPEAT_REVERSE  (0.2f * TRIGGER_SLOT_MOTOR_ANGLE)
+#define TRIGGER_JAM_REPEAT_ANGLE    (0.5f * TRIGGER_SLOT_MOTOR_ANGLE)
+#define TRIGGER_JAM_REVERSE_SPEED   8.0f
+
 #define TRIGGER_ANGLE_INCREMENT     (2.0f * PI / TRIGGER_WHEEL_CAPACITY)
 
 #define TRIGGER_ANGLE_PID_KP        800.0f
@@ -169,6 +184,8 @@ typedef struct
 
     uint16_t block_time;
     uint16_t reverse_time;
+    // fed from the trigger motor feedback interrupt
+    jam_detector_t jam_detector;
 
     bool_t key;
     // uint8_t key_time;
@@ -179,7 +196,7 @@ typedef struct
 
     uint32_t cv_auto_shoot_start_time;
 
-    // @TODO: automatically adjust SPEED_COMPENSATION_RATIO using ref feedbacks here
+    // referee feedback, muzzle_speed.c regulates the friction wheels on it
     uint8_t launching_frequency[2];
 	fp32 bullet_init_speed[2];
 } shoot_control_t;
@@ -187,6 +204,12 @@ typedef struct
 // because the shooting and gimbal use the same can id, the shooting task is also executed in the gimbal task
 extern void shoot_init(void);
 extern int16_t shoot_control_loop(void);
+/**
+  * @brief          feed the trigger jam detector, call on every trigger motor feedback when TRIGGER_JAM_PREDICTION
+  * @param[in]      cycle: cycle counter at the feedback, see delay_get_cycle
+  * @retval         none
+  */
+extern void shoot_trigger_feedback(uint32_t cycle);
 
 extern shoot_control_t shoot_control;
 
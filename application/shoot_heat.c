@@ -0,0 +1,196 @@
+/**
+ * @file       shoot_heat.c/h
+ * @brief      Local barrel heat model: counts shots from the trigger wheel, cools at the referee rate and re-syncs to
+ *             referee heat reports, so firing is cut right before the limit instead of a fixed clearance below it
+ * @arthur     MacFalcons Control Team
+ */
+#include "shoot_heat.h"
+#include "shoot.h"
+#include "detect_task.h"
+#include "referee.h"
+#include "string.h"
+
+shoot_heat_t shoot_heat_data;
+
+static void shoot_heat_add_shot(uint32_t time_ms);
+static void shoot_heat_friction_dip(uint32_t time_ms, fp32 muzzle_speed);
+
+void shoot_heat_init(void)
+{
+    shoot_heat_data.heat = 0.0f;
+    shoot_heat_data.heat_limit = 0.0f;
+    shoot_heat_data.cooling_rate = 0.0f;
+    // the wheel rests at a slot boundary, the bullet leaves part way into the next step
+    shoot_heat_data.trigger_progress = TRIGGER_ANGLE_INCREMENT * (1.0f - SHOOT_HEAT_SHOT_PHASE);
+    shoot_heat_data.last_ecd = motor_chassis[MOTOR_INDEX_TRIGGER].ecd;
+    shoot_heat_data.trigger_ecd = 0;
+    shoot_heat_data.shot_count = 0;
+    memset(shoot_heat_data.shot_time, 0, sizeof(shoot_heat_data.shot_time));
+    shoot_heat_data.last_update_time = 0;
+    shoot_heat_data.last_referee_update = get_power_heat_data_update_count();
+    shoot_heat_data.resync_error = 0.0f;
+    shot_detector_init(&shoot_heat_data.friction_detector[0], FRICTION_MOTOR_RPM_TO_SPEED);
+    shot_detector_init(&shoot_heat_data.friction_detector[1], FRICTION_MOTOR_RPM_TO_SPEED);
+    memset((void *)shoot_heat_data.friction_dip, 0, sizeof(shoot_heat_data.friction_dip));
+    shoot_heat_data.friction_dip_count = 0;
+    shoot_heat_data.read_friction_dips = 0;
+    shoot_heat_data.friction_shot_count = 0;
+    shoot_heat_data.last_friction_shot_time = 0;
+    shoot_heat_data.fire_rate = 0.0f;
+    shoot_heat_data.muzzle_speed = 0.0f;
+}
+
+void shoot_heat_update(uint32_t now_ms)
+{
+    shoot_heat_t *heat = &shoot_heat_data;
+    const motor_measure_t *trigger = &motor_chassis[MOTOR_INDEX_TRIGGER];
+
+    // the rotor may turn over half a revolution per shoot period at full fire rate, resolve the wrap with its speed
+    int32_t delta_ecd = (int32_t)trigger->ecd - heat->last_ecd;
+    fp32 wrap_error = trigger->speed_rpm / 60.0f * ECD_RANGE * SHOOT_CONTROL_TIME_S - delta_ecd;
+    while (wrap_error > HALF_ECD_RANGE)
+    {
+        delta_ecd += ECD_RANGE;
+        wrap_error -= ECD_RANGE;
+    }
+    while (wrap_error < -HALF_ECD_RANGE)
+    {
+        delta_ecd -= ECD_RANGE;
+        wrap_error += ECD_RANGE;
+    }
+    heat->last_ecd = trigger->ecd;
+#if REVERSE_TRIGGER_DIRECTION
+    delta_ecd = -delta_ecd;
+#endif
+    heat->trigger_ecd += (uint32_t)delta_ecd;
+
+    // backing off a jam makes progress negative, the same ammo isn't counted twice when the wheel moves forward again
+    heat->trigger_progress += delta_ecd * TRIGGER_MOTOR_ECD_TO_ANGLE;
+    while (heat->trigger_progress >= TRIGGER_ANGLE_INCREMENT)
+    {
+        heat->trigger_progress -= TRIGGER_ANGLE_INCREMENT;
+#if !SHOOT_HEAT_FRICTION_SHOT_DETECTION
+        shoot_heat_add_shot(now_ms);
+#endif
+    }
+#if SHOOT_HEAT_FRICTION_SHOT_DETECTION
+    // the ring holds far more dips than one shoot period, after a stall only the latest are left
+    uint32_t friction_dip_count = heat->friction_dip_count;
+    if (friction_dip_count - heat->read_friction_dips > SHOOT_HEAT_SHOT_HISTORY)
+    {
+        heat->read_friction_dips = friction_dip_count - SHOOT_HEAT_SHOT_HISTORY;
+    }
+    while (heat->read_friction_dips != friction_dip_count)
+    {
+        const volatile shoot_heat_friction_dip_t *dip = &heat->friction_dip[heat->read_friction_dips % SHOOT_HEAT_SHOT_HISTORY];
+        shoot_heat_friction_dip(dip->time, dip->muzzle_speed);
+        heat->read_friction_dips++;
+    }
+    if ((heat->friction_shot_count != 0) && (now_ms - heat->last_friction_shot_time > SHOOT_HEAT_FIRE_RATE_MAX_INTERVAL_MS))
+    {
+        heat->fire_rate = 0.0f;
+    }
+#endif
+
+    heat->heat_limit = robot_state.shooter_barrel_heat_limit;
+    heat->cooling_rate = robot_state.shooter_barrel_cooling_value;
+    if (heat->last_update_time != 0)
+    {
+        heat->heat -= heat->cooling_rate * (now_ms - heat->last_update_time) / 1000.0f;
+        if (heat->heat < 0.0f)
+        {
+            heat->heat = 0.0f;
+        }
+    }
+    heat->last_update_time = now_ms;
+
+    uint32_t referee_update = get_power_heat_data_update_count();
+    if (referee_update != heat->last_referee_update)
+    {
+        heat->last_referee_update = referee_update;
+        uint16_t referee_heat_limit;
+        uint16_t referee_heat;
+        get_shoot_heat0_limit_and_heat(&referee_heat_limit, &referee_heat);
+        // shots within the report latency may be missing from it
+        fp32 synced_heat = referee_heat;
+        uint32_t history = (heat->shot_count < SHOOT_HEAT_SHOT_HISTORY) ? heat->shot_count : SHOOT_HEAT_SHOT_HISTORY;
+        for (uint32_t i = 1; i <= history; i++)
+        {
+            if (now_ms - heat->shot_time[(heat->shot_count - i) % SHOOT_HEAT_SHOT_HISTORY] >= SHOOT_HEAT_REFEREE_LATENCY_MS)
+            {
+                break;
+            }
+            synced_heat += SHOOT_HEAT_PER_BULLET;
+        }
+        heat->resync_error = heat->heat - synced_heat;
+        heat->heat = synced_heat;
+    }
+}
+
+void shoot_heat_friction_feedback(uint8_t bWheel, int16_t speed_rpm, uint32_t time_ms)
+{
+    shoot_heat_t *heat = &shoot_heat_data;
+    shot_detector_t *detector = &heat->friction_detector[bWheel & 1];
+    if (shot_detector_update(detector, speed_rpm, time_ms) == 0)
+    {
+        return;
+    }
+
+    uint32_t dip_count = heat->friction_dip_count;
+    heat->friction_dip[dip_count % SHOOT_HEAT_SHOT_HISTORY].time = detector->last_shot_time;
+    heat->friction_dip[dip_count % SHOOT_HEAT_SHOT_HISTORY].muzzle_speed = detector->last_muzzle_speed;
+    heat->friction_dip_count = dip_count + 1;
+}
+
+bool_t shoot_heat_is_overheated(void)
+{
+    // no referee, no limit
+    if (toe_is_error(REFEREE_TOE))
+    {
+        return 0;
+    }
+    return (shoot_heat_data.heat + SHOOT_HEAT_PER_BULLET + SHOOT_HEAT_MARGIN > shoot_heat_data.heat_limit);
+}
+
+/**
+  * @brief          add one shot to the heat and the history for the referee re-sync
+  * @param[in]      time_ms: time of the shot
+  * @retval         none
+  */
+static void shoot_heat_add_shot(uint32_t time_ms)
+{
+    shoot_heat_t *heat = &shoot_heat_data;
+    heat->shot_time[heat->shot_count % SHOOT_HEAT_SHOT_HISTORY] = time_ms;
+    heat->shot_count++;
+    heat->heat += SHOOT_HEAT_PER_BULLET;
+}
+
+/**
+  * @brief          take a friction wheel dip from the ring: muzzle speed, and a shot unless the other wheel's dip of the
+  *                 same projectile was taken already
+  * @param[in]      time_ms: time of the dip
+  * @param[in]      muzzle_speed: muzzle speed from the dip
+  * @retval         none
+  */
+static void shoot_heat_friction_dip(uint32_t time_ms, fp32 muzzle_speed)
+{
+    shoot_heat_t *heat = &shoot_heat_data;
+    // both wheels filter the muzzle speed, but a projectile is one shot
+    heat->muzzle_speed += SHOOT_HEAT_MUZZLE_SPEED_FILTER_COEFF * (muzzle_speed - heat->muzzle_speed);
+    if (heat->friction_shot_count != 0)
+    {
+        uint32_t interval = time_ms - heat->last_friction_shot_time;
+        if ((interval <= SHOOT_HEAT_SHOT_PAIR_MS) || (heat->last_friction_shot_time - time_ms <= SHOOT_HEAT_SHOT_PAIR_MS))
+        {
+            return;
+        }
+        if (interval < SHOOT_HEAT_FIRE_RATE_MAX_INTERVAL_MS)
+        {
+            fp32 rate = 1000.0f / interval;
+            heat->fire_rate = (heat->fire_rate == 0.0f) ? rate : (heat->fire_rate + SHOOT_HEAT_FIRE_RATE_FILTER_COEFF * (rate - heat->fire_rate));
+        }
+    }
+    heat->last_friction_shot_time = time_ms;
+    heat->friction_shot_count++;
+    shoot_heat_add_shot(time_ms);
+}
@@ -0,0 +1,107 @@
+/**
+ * @file       shoot_heat.c/h
+ * @brief      Local barrel heat model: counts shots from the trigger wheel, cools at the referee rate and re-syncs to
+ *             referee heat reports, so firing is cut right before the limit instead of a fixed clearance below it
+ * @arthur     MacFalcons Control Team
+ * Referee heat arrives at about 10Hz and lags each shot, so gating on it alone needs a clearance of several bullets.
+ * Locally, a shot is counted each time the trigger wheel advances TRIGGER_ANGLE_INCREMENT (one ammo slot). On every
+ * referee report the estimate is replaced by the referee heat plus the shots counted within the report latency, which
+ * the report can't include yet. Between reports it cools continuously at the referee cooling value.
+ * With SHOOT_HEAT_FRICTION_SHOT_DETECTION, shots are counted from the speed dips of the friction wheels instead
+ * (shot_detector.c), fed from the 1kHz CAN feedback. Each wheel sees the same projectile, a dip on either wheel is a
+ * shot unless the other wheel already reported it within SHOOT_HEAT_SHOT_PAIR_MS. The dips also give the shot
+ * timestamps for the fire rate and the muzzle speed estimate. The CAN interrupt only runs the detectors and queues
+ * each dip; pairing, heat, fire rate and muzzle speed are updated from the queue in the shoot task.
+ */
+#ifndef SHOOT_HEAT_H
+#define SHOOT_HEAT_H
+#include "global_inc.h"
+#include "shot_detector.h"
+
+// 0: gate firing on referee heat with SHOOT_HEAT_LIMIT_CLEARANCE as before
+#define SHOOT_HEAT_LOCAL_MODEL 1
+// heat of one 17mm bullet
+#define SHOOT_HEAT_PER_BULLET 10.0f
+// fraction of a trigger step after which the bullet has left the slot
+#define SHOOT_HEAT_SHOT_PHASE 0.5f
+// shots this recent may be missing from a referee heat report, ms; longer is conservative
+#define SHOOT_HEAT_REFEREE_LATENCY_MS 200
+// kept below the limit for miscounted shots and the referee's 10Hz cooling steps
+#define SHOOT_HEAT_MARGIN 5.0f
+// 0: count shots from trigger wheel steps
+// @TODO: enable once the dip detection is validated on recorded friction wheel traces
+#define SHOOT_HEAT_FRICTION_SHOT_DETECTION 0
+// dips of both wheels within this are the same projectile, ms
+#define SHOOT_HEAT_SHOT_PAIR_MS 3
+// fire rate is not reported for shots further apart than this, ms
+#define SHOOT_HEAT_FIRE_RATE_MAX_INTERVAL_MS 500
+#define SHOOT_HEAT_FIRE_RATE_FILTER_COEFF 0.2f
+#define SHOOT_HEAT_MUZZLE_SPEED_FILTER_COEFF 0.2f
+// power of 2, must cover the shots within SHOOT_HEAT_REFEREE_LATENCY_MS at full fire rate, and the dips of both
+// wheels within a shoot period
+#define SHOOT_HEAT_SHOT_HISTORY 16
+
+typedef struct
+{
+    uint32_t time;     // ms
+    fp32 muzzle_speed; // m/s, of the wheel
+} shoot_heat_friction_dip_t;
+
+typedef struct
+{
+    fp32 heat;         // estimate
+    fp32 heat_limit;
+    fp32 cooling_rate; // heat per second
+    fp32 trigger_progress; // rad of trigger wheel toward the next shot
+    uint16_t last_ecd;
+    uint32_t trigger_ecd; // rotor ecd fed since init, wraps around, differences stay valid
+    uint32_t shot_count;
+    uint32_t shot_time[SHOOT_HEAT_SHOT_HISTORY]; // ms, ring of the latest shots
+    uint32_t last_update_time;
+    uint32_t last_referee_update;
+    fp32 resync_error; // estimate minus referee-based value at the latest report, positive: overcounted
+
+    // written from the CAN receive interrupt
+    shot_detector_t friction_detector[2];
+    volatile shoot_heat_friction_dip_t friction_dip[SHOOT_HEAT_SHOT_HISTORY]; // ring of the latest dips of both wheels
+    volatile uint32_t friction_dip_count; // written after the dip
+    // read from the ring by the shoot task
+    uint32_t read_friction_dips;
+    uint32_t friction_shot_count;
+    uint32_t last_friction_shot_time; // ms
+    fp32 fire_rate;    // Hz, 0 after a pause
+    fp32 muzzle_speed; // m/s, filtered over both wheels
+} shoot_heat_t;
+
+extern shoot_heat_t shoot_heat_data;
+
+/**
+  * @brief          reset the heat model
+  * @retval         none
+  */
+extern void shoot_heat_init(void);
+
+/**
+  * @brief          count shots, cool and re-sync to the referee, call every shoot control period
+  * @param[in]      now_ms: system time
+  * @retval         none
+  */
+extern void shoot_heat_update(uint32_t now_ms);
+
+/**
+  * @brief          feed a friction wheel speed sample to its shot detector and queue its dips for shoot_heat_update,
+  *                 call from the 1kHz CAN feedback when SHOOT_HEAT_FRICTION_SHOT_DETECTION
+  * @param[in]      bWheel: 0 left, 1 right
+  * @param[in]      speed_rpm: wheel speed
+  * @param[in]      time_ms: sample time
+  * @retval         none
+  */
+extern void shoot_heat_friction_feedback(uint8_t bWheel, int16_t speed_rpm, uint32_t time_ms);
+
+/**
+  * @brief          whether another bullet would take the heat over the limit
+  * @retval         1: stop firing
+  */
+extern bool_t shoot_heat_is_overheated(void);
+
+#endif
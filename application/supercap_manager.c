@@ -0,0 +1,141 @@
+/**
+ * @file       supercap_manager.c/h
+ * @brief      Supercapacitor energy manager: cap energy tracking, boost time prediction, power split between
+ *             chassis and cap charging, command frame to the cap controller
+ * @arthur     MacFalcons Control Team
+ */
+#include "supercap_manager.h"
+#include "chassis_power_control.h"
+#include "chassis_task.h"
+#include "detect_task.h"
+#include "referee.h"
+#include "user_lib.h"
+
+#define SUPCAP_ENERGY_MAX (0.5f * SUPCAP_CAPACITANCE * (SUPCAP_VOLTAGE_MAX * SUPCAP_VOLTAGE_MAX - SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD * SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD))
+// below this drain the cap is not considered discharging for the boost time
+#define SUPCAP_DRAIN_DEADBAND 5.0f
+
+supcap_manager_t supercap_manager_data;
+
+static fp32 supercap_energy_reserve(void);
+
+void supercap_manager_init(void)
+{
+    supercap_manager_data.mode = SUPCAP_MODE_OFFLINE;
+    supercap_manager_data.voltage = 0.0f;
+    supercap_manager_data.energy = 0.0f;
+    supercap_manager_data.energy_last = 0.0f;
+    supercap_manager_data.energy_reserve = SUPCAP_ENERGY_MAX * SUPCAP_RESERVE_RATIO;
+    supercap_manager_data.net_power = 0.0f;
+    supercap_manager_data.boost_time_left = 0.0f;
+    supercap_manager_data.input_power_limit = 0.0f;
+    supercap_manager_data.discharge_allowance = 0.0f;
+    supercap_manager_data.charge_power = 0.0f;
+}
+
+void supercap_manager_update(uint8_t fSprint, fp32 chassis_power)
+{
+    supcap_manager_t *cap = &supercap_manager_data;
+
+    if (toe_is_error(SUPCAP_TOE))
+    {
+        supercap_manager_init();
+        return;
+    }
+
+    // energy and its rate
+    fp32 voltage = cap_message_rx.cap_message.cap_milivoltage / 1000.0f;
+    if (cap->mode == SUPCAP_MODE_OFFLINE)
+    {
+        cap->voltage = voltage;
+    }
+    cap->voltage = first_order_filter(voltage, cap->voltage, SUPCAP_VOLTAGE_FILTER_COEFF);
+    cap->energy = 0.5f * SUPCAP_CAPACITANCE * (cap->voltage * cap->voltage - SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD * SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD);
+    if (cap->energy < 0.0f)
+    {
+        cap->energy = 0.0f;
+    }
+    if (cap->mode != SUPCAP_MODE_OFFLINE)
+    {
+        cap->net_power = first_order_filter((cap->energy - cap->energy_last) / chassis_loop_timing.dt, cap->net_power, SUPCAP_NET_POWER_FILTER_COEFF);
+    }
+    cap->energy_last = cap->energy;
+
+    fp32 drain = -cap->net_power;
+    cap->boost_time_left = cap->energy / ((drain > SUPCAP_DRAIN_DEADBAND) ? drain : SUPCAP_MAX_DISCHARGE_POWER);
+
+    // input power the referee allows, the same base as the chassis budget
+    if (toe_is_error(REFEREE_TOE) || (get_robot_id() == 0))
+    {
+        cap->input_power_limit = 0.0f;
+    }
+    else
+    {
+        fp32 ref_chassis_power;
+        fp32 ref_chassis_power_buffer;
+        fp32 ref_chassis_power_limit;
+        get_chassis_power_data(&ref_chassis_power, &ref_chassis_power_buffer, &ref_chassis_power_limit);
+        cap->input_power_limit = fmaxf(ref_chassis_power_limit + (ref_chassis_power_buffer - CHASSIS_POWER_BUFFER_RESERVE) / CHASSIS_POWER_BUFFER_SPEND_TIME_S, CHASSIS_POWER_MIN_BUDGET);
+    }
+
+    cap->energy_reserve = supercap_energy_reserve();
+    if (fSprint && (cap->energy > 0.0f))
+    {
+        cap->mode = SUPCAP_MODE_BOOST;
+        cap->discharge_allowance = fminf(SUPCAP_MAX_DISCHARGE_POWER, cap->energy / SUPCAP_DISCHARGE_HORIZON_S);
+    }
+    else if (cap->energy < cap->energy_reserve)
+    {
+        cap->mode = SUPCAP_MODE_RECHARGE;
+        // never below the minimum chassis budget
+        cap->discharge_allowance = -fminf(SUPCAP_PRIORITY_CHARGE_POWER, fmaxf(cap->input_power_limit - CHASSIS_POWER_MIN_BUDGET, 0.0f));
+    }
+    else
+    {
+        cap->mode = SUPCAP_MODE_NORMAL;
+        cap->discharge_allowance = fminf(SUPCAP_MAX_DISCHARGE_POWER, (cap->energy - cap->energy_reserve) / SUPCAP_DISCHARGE_HORIZON_S);
+    }
+
+    // whatever input the chassis doesn't use charges the cap; without referee the cap controller uses its own default
+    if ((cap->input_power_limit > 0.0f) && (cap->mode != SUPCAP_MODE_BOOST))
+    {
+        cap->charge_power = fp32_constrain(cap->input_power_limit - chassis_power, 0.0f, SUPCAP_MAX_CHARGE_POWER);
+    }
+    else
+    {
+        cap->charge_power = 0.0f;
+    }
+}
+
+void supercap_manager_command(supcap_cmd_t *cmd)
+{
+    cmd->cmd.input_power_limit = (uint16_t)(supercap_manager_data.input_power_limit * 100.0f);
+    cmd->cmd.charge_power = (uint16_t)(supercap_manager_data.charge_power * 100.0f);
+    cmd->cmd.output_enable = (supercap_manager_data.mode != SUPCAP_MODE_OFFLINE);
+    cmd->cmd.mode = supercap_manager_data.mode;
+    cmd->cmd.reserve = 0;
+}
+
+/**
+  * @brief          energy to keep for sprint, depends on the game state
+  * @retval         J
+  */
+static fp32 supercap_energy_reserve(void)
+{
+    if (toe_is_error(REFEREE_TOE))
+    {
+        return SUPCAP_ENERGY_MAX * SUPCAP_RESERVE_RATIO;
+    }
+    uint8_t game_progress = get_game_progress();
+    if ((game_progress >= PROGRESS_PREPARE) && (game_progress <= PROGRESS_5sCOUNTDOWN))
+    {
+        // go into the battle with a full cap
+        return SUPCAP_ENERGY_MAX * SUPCAP_PREPARATION_RESERVE_RATIO;
+    }
+    uint16_t time_remain = get_time_remain();
+    if (is_game_started() && (time_remain < SUPCAP_END_GAME_WINDOW_S))
+    {
+        return SUPCAP_ENERGY_MAX * SUPCAP_RESERVE_RATIO * time_remain / SUPCAP_END_GAME_WINDOW_S;
+    }
+    return SUPCAP_ENERGY_MAX * SUPCAP_RESERVE_RATIO;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file       supercap_manager.c/h
+ * @brief      Supercapacitor energy manager: cap energy tracking, boost time prediction, power split between
+ *             chassis and cap charging, command frame to the cap controller
+ * @arthur     MacFalcons Control Team
+ * The cap controller sits between the referee power output and the chassis. Every chassis period the input power
+ * the referee allows (limit plus buffer above CHASSIS_POWER_BUFFER_RESERVE) is split between the chassis and
+ * charging, and the cap energy the chassis may draw on top of it is decided:
+ *   - boost (shift sprint): all usable energy, over SUPCAP_DISCHARGE_HORIZON_S, no charging
+ *   - normal: only energy above the reserve for transients, the rest of the input charges the cap
+ *   - below the reserve: the chassis gives up SUPCAP_PRIORITY_CHARGE_POWER so the cap refills
+ * The reserve is SUPCAP_RESERVE_RATIO of a full cap, nearly a full cap during the preparation stages, and shrinks to
+ * zero over the last SUPCAP_END_GAME_WINDOW_S of the game.
+ */
+#ifndef SUPERCAP_MANAGER_H
+#define SUPERCAP_MANAGER_H
+#include "global_inc.h"
+
+#define SUPCAP_VOLTAGE_MIN 3.0f
+#define SUPCAP_VOLTAGE_MAX 26.697f
+// #define SUPCAP_ENERGY_CLEARANCE_RATIO 0.1f
+// #define SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD (sqrtf((1 - SUPCAP_ENERGY_CLEARANCE_RATIO) * SUPCAP_VOLTAGE_MAX * SUPCAP_VOLTAGE_MAX + SUPCAP_ENERGY_CLEARANCE_RATIO * SUPCAP_VOLTAGE_MIN * SUPCAP_VOLTAGE_MIN))
+#define SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD SUPCAP_VOLTAGE_MIN
+#define SUPCAP_CAPACITANCE 5.0f // unit: Farad
+// max power drawn from supercap on top of referee limit
+#define SUPCAP_MAX_DISCHARGE_POWER 150.0f
+// time to drain usable supercap energy at full budget, keeps the budget shrinking smoothly as voltage drops
+#define SUPCAP_DISCHARGE_HORIZON_S 1.0f
+#define SUPCAP_MAX_CHARGE_POWER 120.0f
+
+// energy kept for sprint during the game, ratio of a full cap
+#define SUPCAP_RESERVE_RATIO 0.3f
+// reserve before the battle starts
+#define SUPCAP_PREPARATION_RESERVE_RATIO 0.95f
+// chassis power given to charging while the cap is below the reserve, W
+#define SUPCAP_PRIORITY_CHARGE_POWER 15.0f
+// the reserve shrinks to zero over the last part of the game, energy left at the end is wasted, s
+#define SUPCAP_END_GAME_WINDOW_S 30.0f
+// filters at the chassis period: voltage, and net power as energy derivative (tau about 0.5s at 1kHz, the
+// cap voltage feedback is 100Hz and its noise is amplified by C * V in the energy)
+#define SUPCAP_VOLTAGE_FILTER_COEFF 0.1f
+#define SUPCAP_NET_POWER_FILTER_COEFF 0.002f
+
+// command frame to the cap controller on CHASSIS_CAN, see supcap_cmd_t
+// @TODO: enable once the cap controller firmware takes the 0x302 frame, until then it keeps charging at its own limit
+#define SUPCAP_COMMAND_ENABLE 0
+#define SUPCAP_COMMAND_DIVIDER 10 // chassis periods, 100Hz at 1kHz
+
+typedef enum
+{
+    SUPCAP_MODE_OFFLINE = 0,
+    SUPCAP_MODE_NORMAL,
+    SUPCAP_MODE_RECHARGE, // below the reserve
+    SUPCAP_MODE_BOOST,
+} supcap_mode_e;
+
+typedef struct
+{
+    supcap_mode_e mode;
+    fp32 voltage;             // V, filtered
+    fp32 energy;              // J, usable above SUPCAP_VOLTAGE_LOWER_USE_THRESHOLD
+    fp32 energy_reserve;      // J
+    fp32 net_power;           // W, rate of change of energy, negative while discharging
+    fp32 boost_time_left;     // s, at the present drain, or at SUPCAP_MAX_DISCHARGE_POWER when not draining
+    fp32 input_power_limit;   // W, what the referee allows into the cap controller, 0 when referee is offline
+    fp32 discharge_allowance; // W, chassis budget on top of input_power_limit, negative while recharging
+    fp32 charge_power;        // W, charge power for the cap controller
+    fp32 energy_last;
+} supcap_manager_t;
+
+/*
+ * command frame, standard id SUPCAP_TX_ID (0x302), 8 bytes, the union copied as is so fields are little endian:
+ *   byte 0-1  input_power_limit  uint16, 0.01W  most the controller may draw from the referee power output
+ *   byte 2-3  charge_power       uint16, 0.01W  most of its input it may put into the cap, 0 in boost or without referee
+ *   byte 4    output_enable      uint8          1: power the chassis from the cap, 0: pass the input through
+ *   byte 5    mode               uint8          supcap_mode_e, for the controller's indicator only
+ *   byte 6-7  reserve            uint16         0
+ * The controller answers on SUPCAP_RX_ID (0x301) with supcap_t.
+ * @TODO: check against the frame parser of the cap controller firmware before setting SUPCAP_COMMAND_ENABLE
+ */
+typedef union
+{
+    uint8_t can_buf[8];
+    struct
+    {
+        uint16_t input_power_limit;
+        uint16_t charge_power;
+        uint8_t output_enable;
+        uint8_t mode;
+        uint16_t reserve;
+    } cmd;
+} supcap_cmd_t;
+
+extern supcap_manager_t supercap_manager_data;
+
+/**
+  * @brief          reset supercap manager
+  * @retval         none
+  */
+extern void supercap_manager_init(void);
+
+/**
+  * @brief          update cap energy and split power between chassis and charging, call every chassis period
+  *                 before the speed limits and the power control
+  * @param[in]      fSprint: driver asks for boost
+  * @param[in]      chassis_power: W, chassis draw of the last period from the power model
+  * @retval         none
+  */
+extern void supercap_manager_update(uint8_t fSprint, fp32 chassis_power);
+
+/**
+  * @brief          fill the command frame for the cap controller
+  * @param[out]     cmd: command frame
+  * @retval         none
+  */
+extern void supercap_manager_command(supcap_cmd_t *cmd);
+
+#endif
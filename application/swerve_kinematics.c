@@ -0,0 +1,161 @@
+/**
+ * @file       swerve_kinematics.c/h
+ * @brief      Swerve chassis forward kinematics: chassis twist from the four module velocities, with slip residual
+ * @arthur     MacFalcons Control Team
+ */
+#include "swerve_kinematics.h"
+#include "chassis_task.h"
+#include "AHRS_middleware.h"
+#include "user_lib.h"
+#include "math.h"
+
+swerve_kinematics_t swerve_kinematics_data;
+
+#if (ROBOT_TYPE == INFANTRY_2023_SWERVE)
+// module geometry in the frame of swerve_chassis_vector_to_wheel_vector (x forward, y right), same signs as there
+// velocity by wz per unit radius: (sign * sin(gamma), sign * cos(gamma))
+static const fp32 wz_sign[4][2] = {{1.0f, -1.0f}, {-1.0f, -1.0f}, {-1.0f, 1.0f}, {1.0f, 1.0f}};
+// velocity by hip per unit leg extension speed
+static const fp32 hip_sign[4][2] = {{1.0f, 1.0f}, {1.0f, -1.0f}, {-1.0f, -1.0f}, {-1.0f, 1.0f}};
+
+static void swerve_kinematics_solve(const fp32 u[4][2], const fp32 c[4][2], uint8_t excluded_module, fp32 twist[3]);
+static fp32 swerve_kinematics_residual(const fp32 u[4][2], const fp32 c[4][2], const fp32 twist[3], fp32 module_residual[4]);
+#endif
+
+void swerve_forward_kinematics(const fp32 wheel_speed[4], const fp32 steer_angle[4], const fp32 rot_radii[4], const fp32 rot_radii_dot[4], swerve_kinematics_t *kinematics)
+{
+#if (ROBOT_TYPE == INFANTRY_2023_SWERVE)
+    const fp32 sin_gamma = AHRS_sinf(CHASSIS_LEG_TO_HORIZONTAL_ANGLE);
+    const fp32 cos_gamma = AHRS_cosf(CHASSIS_LEG_TO_HORIZONTAL_ANGLE);
+    fp32 u[4][2];
+    fp32 c[4][2];
+    fp32 slip_speed[4];
+    fp32 twist[3];
+    uint8_t i;
+
+    for (i = 0; i < 4; i++)
+    {
+        u[i][0] = wheel_speed[i] * AHRS_cosf(steer_angle[i]);
+        u[i][1] = wheel_speed[i] * AHRS_sinf(steer_angle[i]);
+#if STEER_MOTOR_UPSIDE_DOWN_MOUNTING
+        u[i][1] = -u[i][1];
+#endif
+        // hip moves the module along its leg, that part is not chassis motion
+        u[i][0] -= rot_radii_dot[i] * hip_sign[i][0] * sin_gamma;
+        u[i][1] -= rot_radii_dot[i] * hip_sign[i][1] * cos_gamma;
+        c[i][0] = rot_radii[i] * wz_sign[i][0] * sin_gamma;
+        c[i][1] = rot_radii[i] * wz_sign[i][1] * cos_gamma;
+        slip_speed[i] = SWERVE_SLIP_RESIDUAL_SPEED + SWERVE_SLIP_RESIDUAL_RATIO * fabsf(wheel_speed[i]);
+    }
+
+    // leave each module out in turn: least squares spreads one slipping module over all four, the three that
+    // agree best tell whether the fourth is slipping
+    fp32 best_sum_sq = 0.0f;
+    kinematics->excluded_module = SWERVE_NO_MODULE_EXCLUDED;
+    for (uint8_t k = 0; k < 4; k++)
+    {
+        swerve_kinematics_solve(u, c, k, twist);
+        fp32 sum_sq = swerve_kinematics_residual(u, c, twist, kinematics->module_residual) - kinematics->module_residual[k] * kinematics->module_residual[k];
+        if ((kinematics->module_residual[k] > slip_speed[k]) && ((kinematics->excluded_module == SWERVE_NO_MODULE_EXCLUDED) || (sum_sq < best_sum_sq)))
+        {
+            best_sum_sq = sum_sq;
+            kinematics->excluded_module = k;
+        }
+    }
+
+    swerve_kinematics_solve(u, c, kinematics->excluded_module, twist);
+    kinematics->residual = sqrtf(swerve_kinematics_residual(u, c, twist, kinematics->module_residual) * 0.25f);
+    kinematics->slip_mask = 0;
+    for (i = 0; i < 4; i++)
+    {
+        if (kinematics->module_residual[i] > slip_speed[i])
+        {
+            kinematics->slip_mask |= (1 << i);
+        }
+    }
+
+    // internal y is positive right
+    kinematics->vx = twist[0];
+    kinematics->vy = -twist[1];
+    kinematics->wz = twist[2];
+#endif
+}
+
+void swerve_kinematics_update(void)
+{
+#if (ROBOT_TYPE == INFANTRY_2023_SWERVE)
+    fp32 wheel_speed[4];
+    fp32 steer_angle[4];
+    fp32 rot_radii_dot[4];
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        wheel_speed[i] = chassis_move.motor_chassis[i].speed;
+        steer_angle[i] = chassis_move.steer_motor_chassis[i].module.angle_est;
+        rot_radii_dot[i] = chassis_move.fHipEnabled ? chassis_move.target_wheel_rot_radii_dot[i] : 0.0f;
+    }
+    // special initial direction, see end of swerve_chassis_vector_to_wheel_vector
+    wheel_speed[0] = -wheel_speed[0];
+    wheel_speed[3] = -wheel_speed[3];
+
+    swerve_forward_kinematics(wheel_speed, steer_angle, chassis_move.wheel_rot_radii, rot_radii_dot, &swerve_kinematics_data);
+    chassis_move.vx = swerve_kinematics_data.vx;
+    chassis_move.vy = swerve_kinematics_data.vy;
+    chassis_move.wz = swerve_kinematics_data.wz;
+#endif
+}
+
+#if (ROBOT_TYPE == INFANTRY_2023_SWERVE)
+/**
+  * @brief          least squares chassis twist, u_i = (vx, vy) + wz * c_i for every module but the excluded one
+  * @param[in]      u: module velocities, hip motion removed
+  * @param[in]      c: module velocity per unit wz
+  * @param[in]      excluded_module: module left out, SWERVE_NO_MODULE_EXCLUDED for none
+  * @param[out]     twist: vx, vy (internal frame, positive right), wz
+  * @retval         none
+  */
+static void swerve_kinematics_solve(const fp32 u[4][2], const fp32 c[4][2], uint8_t excluded_module, fp32 twist[3])
+{
+    // normal equations [n 0 Sx; 0 n Sy; Sx Sy Scc] * twist = b, wz by Schur complement
+    fp32 n = 0.0f, sx = 0.0f, sy = 0.0f, scc = 0.0f;
+    fp32 b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        if (i == excluded_module)
+        {
+            continue;
+        }
+        n += 1.0f;
+        sx += c[i][0];
+        sy += c[i][1];
+        scc += c[i][0] * c[i][0] + c[i][1] * c[i][1];
+        b0 += u[i][0];
+        b1 += u[i][1];
+        b2 += c[i][0] * u[i][0] + c[i][1] * u[i][1];
+    }
+    // modules never sit on one point, so the complement is positive
+    twist[2] = (b2 - (sx * b0 + sy * b1) / n) / (scc - (sx * sx + sy * sy) / n);
+    twist[0] = (b0 - sx * twist[2]) / n;
+    twist[1] = (b1 - sy * twist[2]) / n;
+}
+
+/**
+  * @brief          module residuals of a chassis twist
+  * @param[in]      u: module velocities, hip motion removed
+  * @param[in]      c: module velocity per unit wz
+  * @param[in]      twist: vx, vy (internal frame, positive right), wz
+  * @param[out]     module_residual: |u_i - (vx, vy) - wz * c_i|
+  * @retval         sum of squared residuals
+  */
+static fp32 swerve_kinematics_residual(const fp32 u[4][2], const fp32 c[4][2], const fp32 twist[3], fp32 module_residual[4])
+{
+    fp32 sum_sq = 0.0f;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        fp32 rx = u[i][0] - twist[0] - twist[2] * c[i][0];
+        fp32 ry = u[i][1] - twist[1] - twist[2] * c[i][1];
+        sum_sq += rx * rx + ry * ry;
+        module_residual[i] = sqrtf(rx * rx + ry * ry);
+    }
+    return sum_sq;
+}
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file       swerve_kinematics.c/h
+ * @brief      Swerve chassis forward kinematics: chassis twist from the four module velocities, with slip residual
+ * @arthur     MacFalcons Control Team
+ * Each module velocity u_i (drive speed along steering angle) is v + wz * c_i + Rdot_i * e_i, where c_i comes from the
+ * leg radius R_i set by the hip platform and e_i is the leg direction; the hip term is known from
+ * target_wheel_rot_radii_dot and removed first. Eight equations, three unknowns (vx, vy, wz): least squares.
+ * What is left of each module velocity is its residual. Least squares spreads one slipping module over all four, so
+ * each module is left out in turn: if the left-out one is above SWERVE_SLIP_RESIDUAL_SPEED against the other three,
+ * the twist of the three that agree best is used. Modules above the threshold are flagged in slip_mask.
+ * Steering 6020s don't report to this board, the steering angle is the modelled one from swerve_module_optimizer.
+ */
+#ifndef SWERVE_KINEMATICS_H
+#define SWERVE_KINEMATICS_H
+#include "global_inc.h"
+
+// module slipping when its residual is above SWERVE_SLIP_RESIDUAL_SPEED + SWERVE_SLIP_RESIDUAL_RATIO * |module speed|
+#define SWERVE_SLIP_RESIDUAL_SPEED 0.15f // m/s
+#define SWERVE_SLIP_RESIDUAL_RATIO 0.1f
+
+#define SWERVE_NO_MODULE_EXCLUDED 0xFF
+
+typedef struct
+{
+    fp32 vx;                 // m/s, positive forward
+    fp32 vy;                 // m/s, positive left
+    fp32 wz;                 // rad/s, positive counterclockwise
+    fp32 module_residual[4]; // m/s, module velocity not explained by the chassis twist
+    fp32 residual;           // m/s, rms of module_residual
+    uint8_t excluded_module; // module left out of the twist, SWERVE_NO_MODULE_EXCLUDED if all agree
+    uint8_t slip_mask;       // bit i: module i is slipping
+} swerve_kinematics_t;
+
+extern swerve_kinematics_t swerve_kinematics_data;
+
+/**
+  * @brief          swerve forward kinematics
+  * @param[in]      wheel_speed: drive speed of each module along its steering angle, m/s
+  * @param[in]      steer_angle: steering angle of each module, rad, same convention as swerve_module_optimize
+  * @param[in]      rot_radii: distance of each module to chassis center, m
+  * @param[in]      rot_radii_dot: leg extension speed of each module from the hip platform, m/s
+  * @param[out]     kinematics: chassis twist and residuals
+  * @retval         none
+  */
+extern void swerve_forward_kinematics(const fp32 wheel_speed[4], const fp32 steer_angle[4], const fp32 rot_radii[4], const fp32 rot_radii_dot[4], swerve_kinematics_t *kinematics);
+
+/**
+  * @brief          update swerve_kinematics_data and chassis_move.vx, vy, wz from drive motor feedback, call in
+  *                 chassis_feedback_update
+  * @retval         none
+  */
+extern void swerve_kinematics_update(void);
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file       swerve_module_optimizer.c/h
+ * @brief      Steering angle and drive direction of one swerve module, chosen for the shortest steering time
+ * @arthur     MacFalcons Control Team
+ */
+#include "swerve_module_optimizer.h"
+#include "AHRS_middleware.h"
+#include "user_lib.h"
+#include "math.h"
+
+void swerve_module_init(swerve_module_t *module, fp32 frame_period, fp32 angle)
+{
+    module->frame_period = frame_period;
+    module->angle_set = rad_format(angle);
+    module->angle_est = module->angle_set;
+    module->fReversed = 0;
+}
+
+fp32 swerve_module_optimize(swerve_module_t *module, fp32 vx, fp32 vy, uint8_t fHold, fp32 *wheel_speed)
+{
+    fp32 speed = sqrtf(vx * vx + vy * vy);
+
+    if (fHold)
+    {
+        *wheel_speed = module->fReversed ? -speed : speed;
+    }
+    else
+    {
+        fp32 velocity_angle = fast_atan2f(vy, vx);
+        // steering time of both solutions from where the 6020 is now, not from where it was last told to go
+        fp32 forward_time = fabsf(rad_format(velocity_angle - module->angle_est)) / STEER_MOTOR_MAX_RATE;
+        fp32 reverse_time = fabsf(rad_format(velocity_angle + PI - module->angle_est)) / STEER_MOTOR_MAX_RATE;
+        if (module->fReversed)
+        {
+            reverse_time -= STEER_REVERSE_HYSTERESIS_TIME_S;
+        }
+        else
+        {
+            forward_time -= STEER_REVERSE_HYSTERESIS_TIME_S;
+        }
+        module->fReversed = (reverse_time < forward_time);
+        module->angle_set = module->fReversed ? rad_format(velocity_angle + PI) : velocity_angle;
+
+#if STEER_COS_SCALING_ENABLE
+        // only the component along the velocity is wanted; the error is within 90 degrees plus hysteresis, cos >= 0
+        speed *= fp32_constrain(AHRS_cosf(rad_format(module->angle_set - module->angle_est)), 0.0f, 1.0f);
+#endif
+        *wheel_speed = module->fReversed ? -speed : speed;
+    }
+
+    // steering model, slew toward target
+    fp32 max_step = STEER_MOTOR_MAX_RATE * module->frame_period;
+    module->angle_est = rad_format(module->angle_est + fp32_constrain(rad_format(module->angle_set - module->angle_est), -max_step, max_step));
+
+    return module->angle_set;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file       swerve_module_optimizer.c/h
+ * @brief      Steering angle and drive direction of one swerve module, chosen for the shortest steering time
+ * @arthur     MacFalcons Control Team
+ * Steering 6020s run a position loop on the steer controller and give no feedback to this board, so the steering angle
+ * is modelled: it slews toward the last target at STEER_MOTOR_MAX_RATE. A module velocity can be reached at its own
+ * direction, or at the opposite direction with the drive wheel reversed; the one closer to the modelled angle needs less
+ * steering time. Keeping the current drive direction gets a small bonus, so a velocity near 90 degrees off the wheel
+ * doesn't flip the drive direction every period.
+ * While steering converges, drive speed is scaled by the cosine of the angle error: the wheel only pushes along the
+ * velocity it is meant to deliver, and not sideways.
+ */
+#ifndef SWERVE_MODULE_OPTIMIZER_H
+#define SWERVE_MODULE_OPTIMIZER_H
+#include "global_inc.h"
+
+// measured steering slew rate of the 6020 under chassis weight, rad/s
+#define STEER_MOTOR_MAX_RATE 15.0f
+// keep the current drive direction unless the other one saves more steering time than this
+#define STEER_REVERSE_HYSTERESIS_TIME_S 0.01f
+// scale drive speed by cos(steering angle error)
+#define STEER_COS_SCALING_ENABLE 1
+
+typedef struct
+{
+    fp32 angle_set;    // rad, [-PI, PI], steering target, same convention as atan2f(vy, vx) of the module velocity
+    fp32 angle_est;    // rad, [-PI, PI], modelled steering angle
+    uint8_t fReversed; // drive wheel runs against the module velocity
+    fp32 frame_period; // s
+} swerve_module_t;
+
+/**
+  * @brief          swerve module init, steering assumed at rest on angle
+  * @param[out]     module: swerve module
+  * @param[in]      frame_period: call period of swerve_module_optimize, s
+  * @param[in]      angle: steering angle at power on, rad
+  * @retval         none
+  */
+extern void swerve_module_init(swerve_module_t *module, fp32 frame_period, fp32 angle);
+
+/**
+  * @brief          choose steering angle and drive speed of a module for a module velocity, call every period
+  * @param[out]     module: swerve module
+  * @param[in]      vx: module velocity x, m/s
+  * @param[in]      vy: module velocity y, m/s
+  * @param[in]      fHold: keep steering target and drive direction, for velocities too small to give a direction
+  * @param[out]     wheel_speed: drive wheel speed, m/s, negative when reversed
+  * @retval         steering target, rad, [-PI, PI]
+  */
+extern fp32 swerve_module_optimize(swerve_module_t *module, fp32 vx, fp32 vy, uint8_t fHold, fp32 *wheel_speed);
+
+#endif
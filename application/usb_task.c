@@ -26,6 +26,8 @@
 
 #include "detect_task.h"
 #include "voltage_task.h"
+#include "calibrate_task.h"
+#include "chassis_task.h"
 
 
 void usb_printf(const char *fmt,...);
@@ -80,6 +82,22 @@ void usb_task(void const * argument)
         //     status[error_list_usb_local[CV_TOE].error_exist]
         // );
 
+#if (SYSID_ENABLE && !DEBUG_CV_WITH_USB)
+        sysid_usb_dump();
+#elif (SPECTRUM_ENABLE && !DEBUG_CV_WITH_USB)
+        spectrum_usb_dump();
+#elif (CHASSIS_LOOP_TIMING_USB_REPORT && !DEBUG_CV_WITH_USB)
+        static uint32_t ulLastReportTime = 0;
+        if (osKernelSysTick() - ulLastReportTime >= 1000)
+        {
+            ulLastReportTime = osKernelSysTick();
+            usb_printf("chassis loop %d timeout %d period %.1f/%.1f us latency %.1f/%.1f/%.1f us\r\n",
+                       chassis_loop_timing.loop_count, chassis_loop_timing.timeout_count,
+                       chassis_loop_timing.period_us, chassis_loop_timing.period_max_us,
+                       chassis_loop_timing.latency_us, chassis_loop_timing.latency_avg_us, chassis_loop_timing.latency_max_us);
+        }
+#endif
+
         osDelayUntil(&ulSystemTime, 3);
 	}
 
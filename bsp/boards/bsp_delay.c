@@ -9,6 +9,19 @@ void delay_init(void)
     fac_us = SystemCoreClock / 1000000;
     fac_ms = SystemCoreClock / 1000;
 
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t delay_get_cycle(void)
+{
+    return DWT->CYCCNT;
+}
+
+fp32 delay_cycle_to_us(uint32_t cycles)
+{
+    return (fp32)cycles / (fp32)fac_us;
 }
 
 void delay_us(uint16_t nus)
@@ -5,5 +5,8 @@
 extern void delay_init(void);
 extern void delay_us(uint16_t nus);
 extern void delay_ms(uint16_t nms);
+// free running core cycle counter (DWT), started by delay_init, wraps every ~25s at 168MHz
+extern uint32_t delay_get_cycle(void);
+extern fp32 delay_cycle_to_us(uint32_t cycles);
 #endif
 
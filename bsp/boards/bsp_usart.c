@@ -7,6 +7,8 @@ extern UART_HandleTypeDef huart6;
 extern DMA_HandleTypeDef hdma_usart6_rx;
 extern DMA_HandleTypeDef hdma_usart6_tx;
 
+static void (*usart6_tx_cplt_callback)(void) = NULL;
+
 /**
  * @brief Unused official code
  * Yuntian Wang: I don't think we need this. HAL init DMA already.
@@ -101,6 +103,23 @@ void usart6_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_buf_num)
 
 }
 
+/**
+ * @brief called by HAL_DMA_IRQHandler in DMA2_Stream6_IRQHandler
+ */
+static void usart6_tx_dma_cplt(DMA_HandleTypeDef *hdma)
+{
+    if (usart6_tx_cplt_callback != NULL)
+    {
+        usart6_tx_cplt_callback();
+    }
+}
+
+void usart6_tx_dma_set_callback(void (*tx_cplt_callback)(void))
+{
+    usart6_tx_cplt_callback = tx_cplt_callback;
+    hdma_usart6_tx.XferCpltCallback = usart6_tx_dma_cplt;
+}
+
 
 
 void usart6_tx_dma_enable(uint8_t *data, uint16_t len)
@@ -118,6 +137,8 @@ void usart6_tx_dma_enable(uint8_t *data, uint16_t len)
     hdma_usart6_tx.Instance->M0AR = (uint32_t)(data);
     __HAL_DMA_SET_COUNTER(&hdma_usart6_tx, len);
 
+    //HAL_DMA_IRQHandler disables the transfer complete interrupt after every transfer
+    __HAL_DMA_ENABLE_IT(&hdma_usart6_tx, DMA_IT_TC);
     __HAL_DMA_ENABLE(&hdma_usart6_tx);
 }
 
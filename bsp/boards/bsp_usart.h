@@ -4,6 +4,9 @@
 
 
 extern void usart6_init(uint8_t *rx1_buf, uint8_t *rx2_buf, uint16_t dma_buf_num);
+// callback in the DMA interrupt once a transfer of usart6_tx_dma_enable is done
+extern void usart6_tx_dma_set_callback(void (*tx_cplt_callback)(void));
+extern void usart6_tx_dma_enable(uint8_t *data, uint16_t len);
 
 // extern void usart1_tx_dma_init(void);
 // extern void usart1_tx_dma_enable(uint8_t *data, uint16_t len);
@@ -0,0 +1,84 @@
+/**
+ * @file       angle_tracker.c/h
+ * @brief      Tracking observer of a continuous multi-turn angle and its speed, from a wrapped angle measurement and a
+ *             rate measurement
+ * @arthur     MacFalcons Control Team
+ */
+#include "angle_tracker.h"
+#include "user_lib.h"
+#include "math.h"
+
+/**
+  * @brief          move whole turns out of the angle, so it stays in [-PI, PI)
+  * @param[out]     tracker: angle tracker struct point
+  * @retval         none
+  */
+static void angle_tracker_count_turns(angle_tracker_t *tracker)
+{
+    while (tracker->angle >= PI)
+    {
+        tracker->angle -= 2.0f * PI;
+        tracker->turns++;
+    }
+    while (tracker->angle < -PI)
+    {
+        tracker->angle += 2.0f * PI;
+        tracker->turns--;
+    }
+}
+
+void angle_tracker_init(angle_tracker_t *tracker, fp32 bandwidth_hz, fp32 dt)
+{
+    if (tracker == NULL)
+    {
+        return;
+    }
+    fp32 omega = 2.0f * PI * bandwidth_hz;
+    tracker->kp = 2.0f * omega;
+    tracker->ki = omega * omega;
+    tracker->dt = dt;
+    angle_tracker_reset(tracker, 0.0f, 0.0f);
+}
+
+void angle_tracker_reset(angle_tracker_t *tracker, fp32 angle, fp32 rate)
+{
+    if (tracker == NULL)
+    {
+        return;
+    }
+    tracker->turns = 0;
+    tracker->angle = rad_format(angle);
+    tracker->bias = 0.0f;
+    tracker->speed = rate;
+    angle_tracker_count_turns(tracker);
+}
+
+void angle_tracker_update(angle_tracker_t *tracker, fp32 angle, fp32 rate)
+{
+    if (tracker == NULL)
+    {
+        return;
+    }
+    tracker->angle += (rate + tracker->bias) * tracker->dt;
+    fp32 error = rad_format(angle - tracker->angle);
+    if (fabsf(error) > ANGLE_TRACKER_RESYNC_ERROR)
+    {
+        tracker->angle += error;
+    }
+    else
+    {
+        tracker->angle += tracker->kp * tracker->dt * error;
+        tracker->bias += tracker->ki * tracker->dt * error;
+    }
+    tracker->speed = rate + tracker->bias;
+    angle_tracker_count_turns(tracker);
+}
+
+fp32 angle_tracker_get_multi_turn(const angle_tracker_t *tracker)
+{
+    if (tracker == NULL)
+    {
+        return 0.0f;
+    }
+    return tracker->turns * 2.0f * PI + tracker->angle;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file       angle_tracker.c/h
+ * @brief      Tracking observer of a continuous multi-turn angle and its speed, from a wrapped angle measurement and a
+ *             rate measurement
+ * @arthur     MacFalcons Control Team
+ * Encoders and the INS give an angle wrapped to [-PI, PI], quantized (6020: 8192 counts per turn), and differencing it
+ * gives a speed as noisy as the quantum over the period. The tracker predicts the angle with the measured rate plus an
+ * estimated rate bias, and corrects it with the wrapped innovation rad_format(measure - estimate):
+ *   angle += (rate + bias) * dt;  e = rad_format(measure - angle);  angle += kp * dt * e;  bias += ki * dt * e
+ * kp = 2 * w, ki = w^2 place both observer poles at the bandwidth w. Without a rate measurement (rate = 0) the bias is
+ * the whole speed, still without lag at constant speed. The estimate is kept as whole turns plus an angle in [-PI, PI)
+ * so fp32 keeps its resolution however long the chassis spins; a turn is counted whenever the angle crosses +-PI.
+ * An innovation over ANGLE_TRACKER_RESYNC_ERROR is no tracking error but a jump of the measurement (offset
+ * calibrated, sensor back online): the angle is set to the measurement, turns are kept.
+ */
+#ifndef ANGLE_TRACKER_H
+#define ANGLE_TRACKER_H
+#include "global_inc.h"
+
+#define ANGLE_TRACKER_RESYNC_ERROR 0.5f
+
+typedef struct
+{
+    fp32 kp;        // 1/s
+    fp32 ki;        // 1/s^2
+    fp32 dt;        // sample time, unit s
+
+    int32_t turns;  // whole turns since reset
+    fp32 angle;     // [-PI, PI), rad
+    fp32 bias;      // measured rate error, or the speed without rate measurement, rad/s
+    fp32 speed;     // rate + bias, rad/s
+} angle_tracker_t;
+
+/**
+  * @brief          angle tracker init, estimate starts at 0
+  * @param[out]     tracker: angle tracker struct point
+  * @param[in]      bandwidth_hz: observer bandwidth, unit Hz, below a quarter of the sample rate
+  * @param[in]      dt: sample time, unit s
+  * @retval         none
+  */
+extern void angle_tracker_init(angle_tracker_t *tracker, fp32 bandwidth_hz, fp32 dt);
+
+/**
+  * @brief          restart the estimate from a measurement, with no turn and no rate bias
+  * @param[out]     tracker: angle tracker struct point
+  * @param[in]      angle: measured angle, unit rad
+  * @param[in]      rate: measured rate, unit rad/s
+  * @retval         none
+  */
+extern void angle_tracker_reset(angle_tracker_t *tracker, fp32 angle, fp32 rate);
+
+/**
+  * @brief          update the estimate with the measurements of this period
+  * @param[out]     tracker: angle tracker struct point
+  * @param[in]      angle: measured angle, any range, unit rad
+  * @param[in]      rate: measured rate, 0 if not measured, unit rad/s
+  * @retval         none
+  */
+extern void angle_tracker_update(angle_tracker_t *tracker, fp32 angle, fp32 rate);
+
+/**
+  * @brief          continuous angle, turns included
+  * @param[in]      tracker: angle tracker struct point
+  * @retval         angle, unit rad
+  */
+extern fp32 angle_tracker_get_multi_turn(const angle_tracker_t *tracker);
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @file       ballistic_solver.c/h
+ * @brief      Ballistic solver: launch pitch and time of flight to hit a target at a given distance and height,
+ *             with quadratic air drag
+ * @arthur     MacFalcons Control Team
+ */
+#include "ballistic_solver.h"
+#include "user_lib.h"
+#include "math.h"
+
+fp32 ballistic_trajectory(fp32 speed, fp32 pitch, fp32 distance, fp32 drag_coeff, fp32 *time)
+{
+    fp32 u = speed * cosf(pitch);
+    fp32 p = tanf(pitch);
+    fp32 y = 0.0f;
+    fp32 t = 0.0f;
+    fp32 h = distance / BALLISTIC_SOLVER_STEPS;
+    for (uint8_t i = 0; i < BALLISTIC_SOLVER_STEPS; i++)
+    {
+        // y and t don't feed back, only u and p need the intermediate stages
+        fp32 du1 = -drag_coeff * u * sqrtf(1.0f + p * p);
+        fp32 dp1 = -BALLISTIC_SOLVER_GRAVITY / (u * u);
+        fp32 u2 = u + 0.5f * h * du1;
+        fp32 p2 = p + 0.5f * h * dp1;
+        fp32 du2 = -drag_coeff * u2 * sqrtf(1.0f + p2 * p2);
+        fp32 dp2 = -BALLISTIC_SOLVER_GRAVITY / (u2 * u2);
+        fp32 u3 = u + 0.5f * h * du2;
+        fp32 p3 = p + 0.5f * h * dp2;
+        fp32 du3 = -drag_coeff * u3 * sqrtf(1.0f + p3 * p3);
+        fp32 dp3 = -BALLISTIC_SOLVER_GRAVITY / (u3 * u3);
+        fp32 u4 = u + h * du3;
+        fp32 p4 = p + h * dp3;
+        fp32 du4 = -drag_coeff * u4 * sqrtf(1.0f + p4 * p4);
+        fp32 dp4 = -BALLISTIC_SOLVER_GRAVITY / (u4 * u4);
+        y += h / 6.0f * (p + 2.0f * p2 + 2.0f * p3 + p4);
+        t += h / 6.0f * (1.0f / u + 2.0f / u2 + 2.0f / u3 + 1.0f / u4);
+        u += h / 6.0f * (du1 + 2.0f * du2 + 2.0f * du3 + du4);
+        p += h / 6.0f * (dp1 + 2.0f * dp2 + 2.0f * dp3 + dp4);
+    }
+    if (time != NULL)
+    {
+        *time = t;
+    }
+    return y;
+}
+
+bool_t ballistic_solve(fp32 distance, fp32 height, fp32 speed, fp32 drag_coeff, ballistic_solution_t *solution)
+{
+    if (solution == NULL)
+    {
+        return 0;
+    }
+    solution->iterations = 0;
+    // also false for NaN
+    if (!((distance > 0.0f) && (speed > 0.0f) && (drag_coeff >= 0.0f)))
+    {
+        return 0;
+    }
+
+    // secant on the height error, from the line of sight and the pitch raised by its drop
+    fp32 last_pitch = atan2f(height, distance);
+    fp32 last_error = ballistic_trajectory(speed, last_pitch, distance, drag_coeff, NULL) - height;
+    solution->pitch = atan2f(height - last_error, distance);
+    solution->iterations = 1;
+    while (solution->iterations < BALLISTIC_SOLVER_MAX_ITERATIONS)
+    {
+        solution->height_error = ballistic_trajectory(speed, solution->pitch, distance, drag_coeff, &solution->time) - height;
+        solution->iterations++;
+        if (fabsf(solution->height_error) < BALLISTIC_SOLVER_TOLERANCE)
+        {
+            return 1;
+        }
+        if (solution->height_error == last_error)
+        {
+            break;
+        }
+        fp32 pitch = solution->pitch - solution->height_error * (solution->pitch - last_pitch) / (solution->height_error - last_error);
+        last_pitch = solution->pitch;
+        last_error = solution->height_error;
+        solution->pitch = fp32_constrain(pitch, -BALLISTIC_SOLVER_MAX_PITCH, BALLISTIC_SOLVER_MAX_PITCH);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file       ballistic_solver.c/h
+ * @brief      Ballistic solver: launch pitch and time of flight to hit a target at a given distance and height,
+ *             with quadratic air drag
+ * @arthur     MacFalcons Control Team
+ * The projectile decelerates by drag_coeff * v^2 along its path and falls with gravity. Taking the horizontal distance
+ * x as the integration variable, with u the horizontal speed and p the slope of the path:
+ *   du/dx = -drag_coeff * u * sqrt(1 + p^2),  dp/dx = -g / u^2,  dy/dx = p,  dt/dx = 1 / u
+ * drag drops out of the slope equation, so BALLISTIC_SOLVER_STEPS classical Runge-Kutta steps over the distance give
+ * the height at the target within a fraction of a mm for the ranges and speeds of the 17mm projectile. The pitch is
+ * found with the secant method on the height error, starting from the line of sight; it converges to the low arc
+ * within 2-3 trajectories and a target out of reach is reported as not solved.
+ */
+#ifndef BALLISTIC_SOLVER_H
+#define BALLISTIC_SOLVER_H
+#include "global_inc.h"
+
+#define BALLISTIC_SOLVER_GRAVITY 9.8f
+// 0.5 * air density * drag coefficient * cross section / mass: 1.169kg/m^3, 0.47 (sphere), 16.8mm, 3.2g; unit 1/m
+#define BALLISTIC_SOLVER_DRAG_17MM 0.019f
+#define BALLISTIC_SOLVER_STEPS 4
+#define BALLISTIC_SOLVER_MAX_ITERATIONS 8
+// height error at the target, m
+#define BALLISTIC_SOLVER_TOLERANCE 0.001f
+// launch pitch limit, rad; the slope of the path grows without bound towards vertical
+#define BALLISTIC_SOLVER_MAX_PITCH 1.4f
+
+typedef struct
+{
+    fp32 pitch;         // rad, launch angle above horizontal
+    fp32 time;          // s, time of flight
+    fp32 height_error;  // m, height at the target minus its height, on the latest trajectory
+    uint8_t iterations; // trajectories computed
+} ballistic_solution_t;
+
+/**
+  * @brief          height of the projectile when it has travelled a horizontal distance
+  * @param[in]      speed: muzzle speed, m/s
+  * @param[in]      pitch: launch angle above horizontal, rad
+  * @param[in]      distance: horizontal distance, m
+  * @param[in]      drag_coeff: deceleration over speed squared, 1/m
+  * @param[out]     time: time of flight, s, may be NULL
+  * @retval         height above the muzzle, m
+  */
+extern fp32 ballistic_trajectory(fp32 speed, fp32 pitch, fp32 distance, fp32 drag_coeff, fp32 *time);
+
+/**
+  * @brief          launch pitch to hit a target
+  * @param[in]      distance: horizontal distance to the target, m
+  * @param[in]      height: height of the target above the muzzle, m
+  * @param[in]      speed: muzzle speed, m/s
+  * @param[in]      drag_coeff: deceleration over speed squared, 1/m, BALLISTIC_SOLVER_DRAG_17MM
+  * @param[out]     solution: pitch and time of flight, the latest iteration if not solved
+  * @retval         1: solved within BALLISTIC_SOLVER_TOLERANCE, 0: out of reach or bad input
+  */
+extern bool_t ballistic_solve(fp32 distance, fp32 height, fp32 speed, fp32 drag_coeff, ballistic_solution_t *solution);
+
+#endif
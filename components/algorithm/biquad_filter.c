@@ -0,0 +1,101 @@
+/**
+ * @file       biquad_filter.c/h
+ * @brief      Cascade of biquad notch and low-pass filters on CMSIS-DSP arm_biquad_cascade_df2T_f32, designed on board
+ *             from a table of stages
+ * @arthur     MacFalcons Control Team
+ */
+#include "biquad_filter.h"
+#include "user_lib.h"
+#include "math.h"
+
+bool_t biquad_design(fp32 coeffs[5], const biquad_stage_config_t *config, fp32 sample_rate_hz)
+{
+    if ((coeffs == NULL) || (config == NULL) || (config->type == BIQUAD_BYPASS))
+    {
+        return 0;
+    }
+    // also false for NaN
+    if (!((config->freq_hz > 0.0f) && (config->freq_hz < 0.5f * sample_rate_hz) && (config->q > 0.0f)))
+    {
+        return 0;
+    }
+
+    fp32 w0 = 2.0f * PI * config->freq_hz / sample_rate_hz;
+    fp32 cos_w0 = cosf(w0);
+    fp32 alpha = sinf(w0) / (2.0f * config->q);
+    fp32 a0 = 1.0f + alpha;
+    if (config->type == BIQUAD_LOWPASS)
+    {
+        coeffs[0] = 0.5f * (1.0f - cos_w0) / a0;
+        coeffs[1] = (1.0f - cos_w0) / a0;
+        coeffs[2] = coeffs[0];
+    }
+    else
+    {
+        coeffs[0] = 1.0f / a0;
+        coeffs[1] = -2.0f * cos_w0 / a0;
+        coeffs[2] = coeffs[0];
+    }
+    // CMSIS adds the feedback terms: y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] + a1 y[n-1] + a2 y[n-2]
+    coeffs[3] = 2.0f * cos_w0 / a0;
+    coeffs[4] = -(1.0f - alpha) / a0;
+    return 1;
+}
+
+bool_t biquad_filter_init(biquad_filter_t *filter, const biquad_stage_config_t *config, uint8_t config_len, fp32 sample_rate_hz)
+{
+    bool_t fAllDesigned = 1;
+    if (filter == NULL)
+    {
+        return 0;
+    }
+    filter->stages = 0;
+    for (uint8_t i = 0; (config != NULL) && (i < config_len); i++)
+    {
+        if (filter->stages >= BIQUAD_FILTER_MAX_STAGES)
+        {
+            fAllDesigned = 0;
+            break;
+        }
+        if (biquad_design(&filter->coeffs[5 * filter->stages], &config[i], sample_rate_hz))
+        {
+            filter->stages++;
+        }
+        else if (config[i].type != BIQUAD_BYPASS)
+        {
+            fAllDesigned = 0;
+        }
+    }
+    arm_biquad_cascade_df2T_init_f32(&filter->instance, filter->stages, filter->coeffs, filter->state);
+    biquad_filter_reset(filter, 0.0f);
+    return fAllDesigned;
+}
+
+void biquad_filter_reset(biquad_filter_t *filter, fp32 value)
+{
+    if (filter == NULL)
+    {
+        return;
+    }
+    fp32 x = value;
+    for (uint8_t i = 0; i < filter->stages; i++)
+    {
+        const fp32 *b = &filter->coeffs[5 * i];
+        // transposed direct form II at rest: y = b0 x + d1, d1 = b1 x + a1 y + d2, d2 = b2 x + a2 y
+        fp32 y = x * (b[0] + b[1] + b[2]) / (1.0f - b[3] - b[4]);
+        filter->state[2 * i + 1] = b[2] * x + b[4] * y;
+        filter->state[2 * i] = b[1] * x + b[3] * y + filter->state[2 * i + 1];
+        x = y;
+    }
+}
+
+fp32 biquad_filter_calc(biquad_filter_t *filter, fp32 input)
+{
+    if ((filter == NULL) || (filter->stages == 0))
+    {
+        return input;
+    }
+    fp32 output;
+    arm_biquad_cascade_df2T_f32(&filter->instance, &input, &output, 1);
+    return output;
+}
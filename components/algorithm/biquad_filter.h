@@ -0,0 +1,78 @@
+/**
+ * @file       biquad_filter.c/h
+ * @brief      Cascade of biquad notch and low-pass filters on CMSIS-DSP arm_biquad_cascade_df2T_f32, designed on board
+ *             from a table of stages
+ * @arthur     MacFalcons Control Team
+ * Each stage is designed with the bilinear transform of the RBJ audio cookbook at the sample rate of the loop it runs in:
+ *   low-pass: H(s) = 1 / (s^2 + s / Q + 1),       -3dB at freq_hz for Q = 0.707
+ *   notch:    H(s) = (s^2 + 1) / (s^2 + s / Q + 1), zero gain at freq_hz, -3dB bandwidth freq_hz / Q
+ * with s normalised to the prewarped stage frequency. Coefficients are stored as CMSIS expects them, {b0, b1, b2, a1, a2}
+ * per stage with the feedback coefficients negated. A stage can only act below the Nyquist frequency of its loop;
+ * content above it has already folded down by sampling and shows up at its alias.
+ */
+#ifndef BIQUAD_FILTER_H
+#define BIQUAD_FILTER_H
+#include "global_inc.h"
+#include "arm_math.h"
+
+#define BIQUAD_FILTER_MAX_STAGES 4
+
+typedef enum
+{
+    BIQUAD_BYPASS = 0, // stage not used, keeps a table entry for a robot without filtering
+    BIQUAD_LOWPASS,
+    BIQUAD_NOTCH,
+} biquad_type_e;
+
+typedef struct
+{
+    biquad_type_e type;
+    fp32 freq_hz; // cutoff or notch frequency, below half the sample rate
+    fp32 q;       // low-pass: 0.707 for Butterworth; notch: frequency over -3dB bandwidth
+} biquad_stage_config_t;
+
+typedef struct
+{
+    arm_biquad_cascade_df2T_instance_f32 instance;
+    fp32 coeffs[5 * BIQUAD_FILTER_MAX_STAGES];
+    fp32 state[2 * BIQUAD_FILTER_MAX_STAGES];
+    uint8_t stages;
+} biquad_filter_t;
+
+/**
+  * @brief          design one stage
+  * @param[out]     coeffs: {b0, b1, b2, a1, a2} in the CMSIS sign convention
+  * @param[in]      config: stage type, frequency and Q
+  * @param[in]      sample_rate_hz: rate the filter is run at, unit Hz
+  * @retval         1: designed, 0: bypass or out of range, coeffs untouched
+  */
+extern bool_t biquad_design(fp32 coeffs[5], const biquad_stage_config_t *config, fp32 sample_rate_hz);
+
+/**
+  * @brief          design the cascade from a table, stages that are bypassed or out of range are left out
+  * @param[out]     filter: biquad filter struct point
+  * @param[in]      config: stage table
+  * @param[in]      config_len: number of table entries, at most BIQUAD_FILTER_MAX_STAGES are used
+  * @param[in]      sample_rate_hz: rate the filter is run at, unit Hz
+  * @retval         1: every entry designed or bypassed, 0: an entry out of range was left out
+  */
+extern bool_t biquad_filter_init(biquad_filter_t *filter, const biquad_stage_config_t *config, uint8_t config_len, fp32 sample_rate_hz);
+
+/**
+  * @brief          set the filter state to its steady state for a constant input, so the output starts at DC gain times
+  *                 value without a transient
+  * @param[out]     filter: biquad filter struct point
+  * @param[in]      value: input held before now
+  * @retval         none
+  */
+extern void biquad_filter_reset(biquad_filter_t *filter, fp32 value);
+
+/**
+  * @brief          filter one sample, passes the input through when no stage is designed
+  * @param[out]     filter: biquad filter struct point
+  * @param[in]      input: new sample
+  * @retval         filtered sample
+  */
+extern fp32 biquad_filter_calc(biquad_filter_t *filter, fp32 input);
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * @file       jam_detector.c/h
+ * @brief      Trigger jam prediction from motor current and acceleration, with a minimal reverse to clear it
+ * @arthur     MacFalcons Control Team
+ */
+#include "jam_detector.h"
+#include "user_lib.h"
+#include "math.h"
+
+static void jam_detector_declare(jam_detector_t *detector);
+
+void jam_detector_init(jam_detector_t *detector, fp32 inertia, fp32 load_threshold, fp32 min_reverse, fp32 max_reverse, fp32 repeat_reverse, fp32 repeat_angle)
+{
+    if (detector == NULL)
+    {
+        return;
+    }
+    detector->inertia = inertia;
+    detector->load_threshold = load_threshold;
+    detector->min_reverse = min_reverse;
+    detector->max_reverse = max_reverse;
+    detector->repeat_reverse = repeat_reverse;
+    detector->repeat_angle = repeat_angle;
+
+    detector->speed = 0.0f;
+    detector->accel = 0.0f;
+    detector->load = 0.0f;
+    detector->position = 0.0f;
+    detector->time_us = 0;
+
+    detector->state = JAM_DETECTOR_FEEDING;
+    detector->direction = 1;
+    detector->onset_time = 0;
+    detector->onset_position = 0.0f;
+    detector->jam_position = 0.0f;
+    detector->reverse_angle = 0.0f;
+    detector->reverse_start_time = 0;
+    detector->repeat_count = 0;
+
+    detector->jam_count = 0;
+    detector->cleared_count = 0;
+    detector->repeat_jam_count = 0;
+    detector->reverse_timeout_count = 0;
+    detector->last_jam_time = 0;
+    detector->max_repeat = 0;
+}
+
+bool_t jam_detector_update(jam_detector_t *detector, fp32 speed, fp32 current, fp32 speed_set, uint32_t dt_us)
+{
+    if (detector == NULL)
+    {
+        return 0;
+    }
+    if (dt_us == 0)
+    {
+        // the same sample again, nothing to differentiate
+        return (detector->state == JAM_DETECTOR_REVERSING);
+    }
+    detector->time_us += dt_us;
+    if (dt_us > JAM_DETECTOR_MAX_GAP_US)
+    {
+        // first sample or feedback gap, no derivative
+        detector->speed = speed * detector->direction;
+        detector->onset_time = 0;
+        return (detector->state == JAM_DETECTOR_REVERSING);
+    }
+
+    // signals in the direction of the latest feeding, which a reverse keeps
+    if ((detector->state == JAM_DETECTOR_FEEDING) && (speed_set != 0.0f))
+    {
+        int8_t direction = (speed_set > 0.0f) ? 1 : -1;
+        if (direction != detector->direction)
+        {
+            detector->direction = direction;
+            detector->speed = -detector->speed;
+            detector->accel = 0.0f;
+            detector->repeat_count = 0;
+        }
+    }
+    fp32 dt = dt_us * 0.000001f;
+    fp32 speed_n = speed * detector->direction;
+    detector->accel += JAM_DETECTOR_ACCEL_FILTER_COEFF * ((speed_n - detector->speed) / dt - detector->accel);
+    detector->speed = speed_n;
+    detector->load = current * detector->direction - detector->inertia * detector->accel;
+    detector->position += speed_n * dt;
+
+    if (detector->state == JAM_DETECTOR_REVERSING)
+    {
+        if (detector->position <= detector->jam_position - detector->reverse_angle)
+        {
+            detector->state = JAM_DETECTOR_FEEDING;
+        }
+        else if (detector->time_us - detector->reverse_start_time > JAM_DETECTOR_MAX_REVERSE_MS * 1000)
+        {
+            detector->state = JAM_DETECTOR_FEEDING;
+            detector->reverse_timeout_count++;
+        }
+        detector->onset_time = 0;
+        return (detector->state == JAM_DETECTOR_REVERSING);
+    }
+
+    if ((detector->repeat_count != 0) && (detector->position > detector->jam_position + detector->repeat_angle))
+    {
+        detector->repeat_count = 0;
+        detector->cleared_count++;
+    }
+
+    fp32 speed_set_n = fabsf(speed_set);
+    if ((speed_set_n == 0.0f) || (detector->load < detector->load_threshold))
+    {
+        detector->onset_time = 0;
+        return 0;
+    }
+    if (detector->onset_time == 0)
+    {
+        detector->onset_position = detector->position;
+    }
+    detector->onset_time += dt_us;
+    fp32 predicted_speed = detector->speed + detector->accel * (JAM_DETECTOR_PREDICT_MS * 0.001f);
+    if ((detector->onset_time >= JAM_DETECTOR_CONFIRM_MS * 1000) && (predicted_speed < JAM_DETECTOR_SPEED_RATIO * speed_set_n))
+    {
+        jam_detector_declare(detector);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+  * @brief          start reversing by the minimal angle for this jam
+  * @param[out]     detector: detector struct point
+  * @retval         none
+  */
+static void jam_detector_declare(jam_detector_t *detector)
+{
+    // jammed again before getting past the last one: it needs more room
+    if ((detector->repeat_count != 0) && (detector->position <= detector->jam_position + detector->repeat_angle))
+    {
+        detector->repeat_jam_count++;
+    }
+    else
+    {
+        detector->repeat_count = 0;
+    }
+    // the wheel compressed the projectile by as much as it moved since the load rose
+    fp32 compression = fmaxf(detector->position - detector->onset_position, 0.0f);
+    detector->reverse_angle = fp32_constrain(detector->min_reverse + compression + detector->repeat_reverse * detector->repeat_count,
+                                             detector->min_reverse, detector->max_reverse);
+    if (detector->repeat_count < 0xFF)
+    {
+        detector->repeat_count++;
+    }
+    if (detector->repeat_count > detector->max_repeat)
+    {
+        detector->max_repeat = detector->repeat_count;
+    }
+    detector->jam_position = detector->position;
+    detector->state = JAM_DETECTOR_REVERSING;
+    detector->reverse_start_time = detector->time_us;
+    detector->onset_time = 0;
+    detector->jam_count++;
+    detector->last_jam_time = detector->time_us;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file       jam_detector.c/h
+ * @brief      Trigger jam prediction from motor current and acceleration, with a minimal reverse to clear it
+ * @arthur     MacFalcons Control Team
+ * A projectile wedged between the trigger wheel and the feed stops the wheel within a few ms. Fed with every motor
+ * feedback (1kHz) and the time since the previous one, measured by the caller on the cycle counter because feedback
+ * frames are not aligned to the 1ms tick, the detector estimates the load the wheel pushes against as in a disturbance observer,
+ * load = measured current - inertia * acceleration, so current spent on spinning up is not mistaken for a jam.
+ * A jam is declared when, while feeding, the load stays above load_threshold for JAM_DETECTOR_CONFIRM_MS and the speed
+ * extrapolated JAM_DETECTOR_PREDICT_MS ahead falls below JAM_DETECTOR_SPEED_RATIO of the set-point; the sharp
+ * deceleration flags the jam before the wheel has actually stopped.
+ * The wheel is then reversed by the smallest angle that releases the projectile: min_reverse plus how far the wheel
+ * pushed on after the load rose, growing by repeat_reverse for every jam again at the same place, up to max_reverse.
+ * The jam counts as cleared once the wheel gets repeat_angle past the jam position.
+ * Speed and angles are in rad of the same shaft, current and load in motor feedback units.
+ */
+#ifndef JAM_DETECTOR_H
+#define JAM_DETECTOR_H
+#include "global_inc.h"
+
+#define JAM_DETECTOR_CONFIRM_MS 3
+#define JAM_DETECTOR_PREDICT_MS 10
+#define JAM_DETECTOR_SPEED_RATIO 0.5f
+// acceleration low-pass per 1ms sample
+#define JAM_DETECTOR_ACCEL_FILTER_COEFF 0.5f
+// the wheel may not back off, feeding resumes after this and a new jam escalates the reverse angle
+#define JAM_DETECTOR_MAX_REVERSE_MS 200
+// a longer sample interval is a feedback gap, no derivative across it
+#define JAM_DETECTOR_MAX_GAP_US 10000
+
+typedef enum
+{
+    JAM_DETECTOR_FEEDING = 0,
+    JAM_DETECTOR_REVERSING,
+} jam_detector_state_e;
+
+typedef struct
+{
+    // config
+    fp32 inertia;        // current per rad/s^2
+    fp32 load_threshold; // current
+    fp32 min_reverse;    // rad
+    fp32 max_reverse;    // rad
+    fp32 repeat_reverse; // rad added per repeated jam
+    fp32 repeat_angle;   // rad of progress after which a jam counts as cleared
+
+    // signals, in the feeding direction
+    fp32 speed;    // rad/s
+    fp32 accel;    // rad/s^2
+    fp32 load;     // current
+    fp32 position; // rad, integrated speed
+    uint32_t time_us; // sum of the sample intervals
+
+    jam_detector_state_e state;
+    int8_t direction;       // feeding direction of the latest jam
+    uint32_t onset_time;    // us the load has been above the threshold
+    fp32 onset_position;    // rad, where the load rose
+    fp32 jam_position;      // rad, where the jam was declared
+    fp32 reverse_angle;     // rad, of the latest jam
+    uint32_t reverse_start_time; // us
+    uint8_t repeat_count;   // jams in a row without getting past repeat_angle
+
+    // statistics
+    uint32_t jam_count;
+    uint32_t cleared_count;
+    uint32_t repeat_jam_count;
+    uint32_t reverse_timeout_count;
+    uint32_t last_jam_time; // us
+    uint16_t max_repeat;
+} jam_detector_t;
+
+/**
+  * @brief          jam detector init
+  * @param[out]     detector: detector struct point
+  * @param[in]      inertia: current to accelerate by 1 rad/s^2
+  * @param[in]      load_threshold: load current of a jam
+  * @param[in]      min_reverse: reverse angle of a first jam, rad
+  * @param[in]      max_reverse: reverse angle limit, rad
+  * @param[in]      repeat_reverse: reverse angle added per repeated jam, rad
+  * @param[in]      repeat_angle: progress past the jam position that clears it, rad
+  * @retval         none
+  */
+extern void jam_detector_init(jam_detector_t *detector, fp32 inertia, fp32 load_threshold, fp32 min_reverse, fp32 max_reverse, fp32 repeat_reverse, fp32 repeat_angle);
+
+/**
+  * @brief          feed one motor feedback sample
+  * @param[out]     detector: detector struct point
+  * @param[in]      speed: measured speed, rad/s
+  * @param[in]      current: measured current
+  * @param[in]      speed_set: feeding speed set-point, rad/s, 0 when not feeding
+  * @param[in]      dt_us: time since the previous sample, us; a sample without time elapsed is skipped
+  * @retval         1: the wheel should reverse now
+  */
+extern bool_t jam_detector_update(jam_detector_t *detector, fp32 speed, fp32 current, fp32 speed_set, uint32_t dt_us);
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file       shot_detector.c/h
+ * @brief      Shot detection from the speed dip of one friction wheel, with muzzle speed estimate
+ * @arthur     MacFalcons Control Team
+ */
+#include "shot_detector.h"
+#include "user_lib.h"
+#include "math.h"
+
+static void shot_detector_start_dip(shot_detector_t *detector, fp32 speed, uint32_t time_ms);
+
+void shot_detector_init(shot_detector_t *detector, fp32 rpm_to_speed)
+{
+    if (detector == NULL)
+    {
+        return;
+    }
+    detector->rpm_to_speed = rpm_to_speed;
+    detector->baseline = 0.0f;
+    detector->noise = 0.0f;
+    detector->last_speed = 0.0f;
+    detector->state = SHOT_DETECTOR_IDLE;
+    detector->reference = 0.0f;
+    detector->lowest = 0.0f;
+    detector->state_time = 0;
+    detector->fall_time = 0;
+    detector->dip_start_time = 0;
+    detector->last_time = 0;
+    detector->shot_count = 0;
+    detector->last_shot_time = 0;
+    detector->last_depth = 0.0f;
+    detector->last_muzzle_speed = 0.0f;
+}
+
+bool_t shot_detector_update(shot_detector_t *detector, fp32 speed_rpm, uint32_t time_ms)
+{
+    if (detector == NULL)
+    {
+        return 0;
+    }
+    fp32 speed = fabsf(speed_rpm);
+    detector->state_time += (uint16_t)(time_ms - detector->last_time);
+    detector->last_time = time_ms;
+    fp32 threshold = fmaxf(SHOT_DETECTOR_MIN_DEPTH_RPM, SHOT_DETECTOR_NOISE_GAIN * detector->noise);
+    fp32 change = fminf(fabsf(speed - detector->last_speed), threshold);
+    detector->last_speed = speed;
+
+    switch (detector->state)
+    {
+        case SHOT_DETECTOR_DIP:
+        {
+            if (speed < detector->lowest)
+            {
+                detector->lowest = speed;
+                detector->fall_time = detector->state_time;
+            }
+            fp32 depth = detector->reference - detector->lowest;
+            if ((detector->fall_time > SHOT_DETECTOR_MAX_FALL_MS) || (detector->state_time > SHOT_DETECTOR_MAX_DIP_MS))
+            {
+                // speed change, not a shot
+                detector->state = SHOT_DETECTOR_SETTLE;
+                detector->state_time = 0;
+                detector->baseline = speed;
+            }
+            else if (speed - detector->lowest > depth * SHOT_DETECTOR_RECOVERY_RATIO)
+            {
+                detector->shot_count++;
+                detector->last_shot_time = detector->dip_start_time;
+                detector->last_depth = depth;
+                detector->last_muzzle_speed = detector->rpm_to_speed * detector->lowest;
+                detector->state = SHOT_DETECTOR_RECOVERY;
+                detector->reference = speed;
+                detector->state_time = 0;
+                return 1;
+            }
+            return 0;
+        }
+        case SHOT_DETECTOR_RECOVERY:
+        {
+            // the next shot may come before the wheel is back to the baseline
+            if (speed > detector->reference)
+            {
+                detector->reference = speed;
+            }
+            if (detector->reference - speed > threshold)
+            {
+                shot_detector_start_dip(detector, speed, time_ms);
+            }
+            else if (speed > detector->baseline - 0.5f * threshold)
+            {
+                detector->state = SHOT_DETECTOR_IDLE;
+            }
+            else if (detector->state_time > SHOT_DETECTOR_MAX_RECOVERY_MS)
+            {
+                detector->state = SHOT_DETECTOR_SETTLE;
+                detector->state_time = 0;
+                detector->baseline = speed;
+            }
+            return 0;
+        }
+        case SHOT_DETECTOR_SETTLE:
+        {
+            // follow the new speed, detect again once it stays steady
+            detector->baseline += SHOT_DETECTOR_SETTLE_FILTER_COEFF * (speed - detector->baseline);
+            if (fabsf(speed - detector->baseline) > threshold)
+            {
+                detector->state_time = 0;
+            }
+            else if (detector->state_time > SHOT_DETECTOR_SETTLE_MS)
+            {
+                detector->state = SHOT_DETECTOR_IDLE;
+            }
+            return 0;
+        }
+        case SHOT_DETECTOR_IDLE:
+        default:
+        {
+            if ((detector->baseline > SHOT_DETECTOR_MIN_BASELINE_RPM) && (detector->baseline - speed > threshold))
+            {
+                // baseline and noise stay frozen until the wheel has recovered
+                detector->reference = detector->baseline;
+                shot_detector_start_dip(detector, speed, time_ms);
+                return 0;
+            }
+            detector->baseline += SHOT_DETECTOR_BASELINE_FILTER_COEFF * (speed - detector->baseline);
+            detector->noise += SHOT_DETECTOR_NOISE_FILTER_COEFF * (change - detector->noise);
+            return 0;
+        }
+    }
+}
+
+/**
+  * @brief          enter the dip state, reference must be set
+  * @param[out]     detector: detector struct point
+  * @param[in]      speed: rpm, absolute value
+  * @param[in]      time_ms: sample time
+  * @retval         none
+  */
+static void shot_detector_start_dip(shot_detector_t *detector, fp32 speed, uint32_t time_ms)
+{
+    detector->state = SHOT_DETECTOR_DIP;
+    detector->lowest = speed;
+    detector->state_time = 0;
+    detector->fall_time = 0;
+    detector->dip_start_time = time_ms;
+}
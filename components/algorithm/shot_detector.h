@@ -0,0 +1,83 @@
+/**
+ * @file       shot_detector.c/h
+ * @brief      Shot detection from the speed dip of one friction wheel, with muzzle speed estimate
+ * @arthur     MacFalcons Control Team
+ * A projectile squeezed between the friction wheels takes its kinetic energy from them within 1-2ms, the wheel speed
+ * drops by tens to a few hundred rpm and the speed loop recovers it over tens of ms. Fed with every speed sample
+ * (1kHz motor feedback), the detector tracks the undisturbed speed (baseline) and its noise while no dip is going on.
+ * Noise is the mean absolute change between samples, which a slow recovery tail hardly raises:
+ *   - a dip starts when the speed falls below the reference by more than the threshold,
+ *     max(SHOT_DETECTOR_MIN_DEPTH_RPM, SHOT_DETECTOR_NOISE_GAIN * noise). The reference is the baseline,
+ *     or while the wheel is still recovering from the previous shot, the highest speed since that shot
+ *   - it is a shot once the speed has recovered by SHOT_DETECTOR_RECOVERY_RATIO of the dip; a drop that keeps
+ *     falling for longer than SHOT_DETECTOR_MAX_FALL_MS is a speed change (spin-down, new set-point) and is
+ *     discarded, detection resumes once the speed has been steady for SHOT_DETECTOR_SETTLE_MS
+ *   - the shot is timestamped at the first sample of the dip; the projectile leaves with the wheel surface at its
+ *     lowest speed, so the muzzle speed estimate is rpm_to_speed * lowest rpm
+ */
+#ifndef SHOT_DETECTOR_H
+#define SHOT_DETECTOR_H
+#include "global_inc.h"
+
+#define SHOT_DETECTOR_MIN_DEPTH_RPM 40.0f
+#define SHOT_DETECTOR_NOISE_GAIN 8.0f
+// recovered part of the dip at which the shot is reported
+#define SHOT_DETECTOR_RECOVERY_RATIO 0.3f
+#define SHOT_DETECTOR_MAX_FALL_MS 6
+// a dip not recovered within this is dropped, the baseline is re-acquired when a shot isn't recovered within this
+#define SHOT_DETECTOR_MAX_DIP_MS 40
+#define SHOT_DETECTOR_MAX_RECOVERY_MS 100
+#define SHOT_DETECTOR_SETTLE_MS 30
+#define SHOT_DETECTOR_SETTLE_FILTER_COEFF 0.2f
+// baseline below this is not spinning for a shot, no detection
+#define SHOT_DETECTOR_MIN_BASELINE_RPM 1000.0f
+// per sample, tau of 50ms / 100ms at 1kHz
+#define SHOT_DETECTOR_BASELINE_FILTER_COEFF 0.02f
+#define SHOT_DETECTOR_NOISE_FILTER_COEFF 0.01f
+
+typedef enum
+{
+    SHOT_DETECTOR_IDLE = 0,
+    SHOT_DETECTOR_DIP,
+    SHOT_DETECTOR_RECOVERY,
+    SHOT_DETECTOR_SETTLE,
+} shot_detector_state_e;
+
+typedef struct
+{
+    fp32 rpm_to_speed;   // muzzle speed per rpm of the wheel, m/s
+    fp32 baseline;       // rpm, absolute value
+    fp32 noise;          // rpm, mean absolute change between samples
+    fp32 last_speed;     // rpm, absolute value
+    shot_detector_state_e state;
+    fp32 reference;      // rpm, speed a dip is measured from
+    fp32 lowest;         // rpm, lowest speed of the current dip
+    uint16_t state_time; // ms in the current state
+    uint16_t fall_time;  // ms from the dip start to its lowest speed
+    uint32_t dip_start_time;
+    uint32_t last_time;
+
+    uint32_t shot_count;
+    uint32_t last_shot_time; // ms
+    fp32 last_depth;         // rpm
+    fp32 last_muzzle_speed;  // m/s
+} shot_detector_t;
+
+/**
+  * @brief          detector init
+  * @param[out]     detector: detector struct point
+  * @param[in]      rpm_to_speed: muzzle speed per wheel rpm, unit m/s
+  * @retval         none
+  */
+extern void shot_detector_init(shot_detector_t *detector, fp32 rpm_to_speed);
+
+/**
+  * @brief          feed one wheel speed sample
+  * @param[out]     detector: detector struct point
+  * @param[in]      speed_rpm: wheel speed, either direction
+  * @param[in]      time_ms: sample time
+  * @retval         1: a shot was detected with this sample, see last_shot_time, last_depth, last_muzzle_speed
+  */
+extern bool_t shot_detector_update(shot_detector_t *detector, fp32 speed_rpm, uint32_t time_ms);
+
+#endif
@@ -0,0 +1,150 @@
+/**
+ * @file       spectrum_analyzer.c/h
+ * @brief      Amplitude spectrum of a sampled signal on CMSIS-DSP arm_rfft_fast_f32, averaged over blocks, with its peaks
+ * @arthur     MacFalcons Control Team
+ */
+#include "spectrum_analyzer.h"
+#include "user_lib.h"
+#include "math.h"
+
+static void spectrum_analyzer_find_peaks(spectrum_analyzer_t *analyzer);
+
+bool_t spectrum_analyzer_init(spectrum_analyzer_t *analyzer, fp32 sample_rate_hz, fp32 average_coeff)
+{
+    if (analyzer == NULL)
+    {
+        return 0;
+    }
+    analyzer->sample_rate_hz = sample_rate_hz;
+    analyzer->average_coeff = fp32_constrain(average_coeff, 0.0f, 1.0f);
+    analyzer->sample_count = 0;
+    analyzer->block_count = 0;
+    for (uint16_t i = 0; i < SPECTRUM_BIN_COUNT; i++)
+    {
+        analyzer->amplitude[i] = 0.0f;
+    }
+    for (uint8_t i = 0; i < SPECTRUM_PEAK_COUNT; i++)
+    {
+        analyzer->peak_freq[i] = 0.0f;
+        analyzer->peak_amplitude[i] = 0.0f;
+    }
+    analyzer->state = SPECTRUM_RECORDING;
+    return (arm_rfft_fast_init_f32(&analyzer->fft, SPECTRUM_FFT_LENGTH) == ARM_MATH_SUCCESS);
+}
+
+bool_t spectrum_analyzer_add(spectrum_analyzer_t *analyzer, fp32 sample)
+{
+    if ((analyzer == NULL) || (analyzer->state != SPECTRUM_RECORDING))
+    {
+        return 1;
+    }
+    analyzer->samples[analyzer->sample_count] = sample;
+    analyzer->sample_count++;
+    if (analyzer->sample_count >= SPECTRUM_FFT_LENGTH)
+    {
+        // recording stops here, the calculating task owns the buffer until it sets RECORDING again
+        analyzer->state = SPECTRUM_BLOCK_FULL;
+        return 1;
+    }
+    return 0;
+}
+
+bool_t spectrum_analyzer_calc(spectrum_analyzer_t *analyzer)
+{
+    if ((analyzer == NULL) || (analyzer->state != SPECTRUM_BLOCK_FULL))
+    {
+        return 0;
+    }
+
+    // a DC offset leaks into the low bins through the window, so it is removed first
+    fp32 mean = 0.0f;
+    for (uint16_t i = 0; i < SPECTRUM_FFT_LENGTH; i++)
+    {
+        mean += analyzer->samples[i];
+    }
+    mean /= SPECTRUM_FFT_LENGTH;
+    for (uint16_t i = 0; i < SPECTRUM_FFT_LENGTH; i++)
+    {
+        fp32 window = 0.5f - 0.5f * cosf(2.0f * PI * i / SPECTRUM_FFT_LENGTH);
+        analyzer->samples[i] = (analyzer->samples[i] - mean) * window;
+    }
+    arm_rfft_fast_f32(&analyzer->fft, analyzer->samples, analyzer->fft_out, 0);
+
+    // a sine of amplitude A gives |X| = A * sum(window) / 2 = A * N / 4 at its bin
+    const fp32 scale = 4.0f / SPECTRUM_FFT_LENGTH;
+    fp32 coeff = (analyzer->block_count == 0) ? 1.0f : analyzer->average_coeff;
+    for (uint16_t i = 0; i < SPECTRUM_BIN_COUNT; i++)
+    {
+        fp32 magnitude;
+        if (i == 0)
+        {
+            magnitude = 0.0f;
+        }
+        else
+        {
+            fp32 re = analyzer->fft_out[2 * i];
+            fp32 im = analyzer->fft_out[2 * i + 1];
+            arm_sqrt_f32(re * re + im * im, &magnitude);
+        }
+        analyzer->amplitude[i] += coeff * (magnitude * scale - analyzer->amplitude[i]);
+    }
+    analyzer->block_count++;
+    spectrum_analyzer_find_peaks(analyzer);
+
+    analyzer->sample_count = 0;
+    analyzer->state = SPECTRUM_RECORDING;
+    return 1;
+}
+
+/**
+  * @brief          largest local maxima of the averaged spectrum, refined from the neighbouring bins with the Hann main lobe
+  * @param[out]     analyzer: spectrum analyzer struct point
+  * @retval         none
+  */
+static void spectrum_analyzer_find_peaks(spectrum_analyzer_t *analyzer)
+{
+    for (uint8_t i = 0; i < SPECTRUM_PEAK_COUNT; i++)
+    {
+        analyzer->peak_freq[i] = 0.0f;
+        analyzer->peak_amplitude[i] = 0.0f;
+    }
+    const fp32 *amplitude = analyzer->amplitude;
+    // the first bins are still inside the main lobe of what was left of DC
+    for (uint16_t k = 2; k < SPECTRUM_BIN_COUNT - 1; k++)
+    {
+        if ((amplitude[k] <= amplitude[k - 1]) || (amplitude[k] < amplitude[k + 1]))
+        {
+            continue;
+        }
+        // insertion into the list, largest first
+        uint8_t slot = SPECTRUM_PEAK_COUNT;
+        while ((slot > 0) && (amplitude[k] > analyzer->peak_amplitude[slot - 1]))
+        {
+            slot--;
+        }
+        if (slot >= SPECTRUM_PEAK_COUNT)
+        {
+            continue;
+        }
+        for (uint8_t i = SPECTRUM_PEAK_COUNT - 1; i > slot; i--)
+        {
+            analyzer->peak_freq[i] = analyzer->peak_freq[i - 1];
+            analyzer->peak_amplitude[i] = analyzer->peak_amplitude[i - 1];
+        }
+        // a sine between bins k and k + offset reads A * W(offset) at bin k, and the Hann main lobe
+        // W(d) = sin(PI d) / (PI d (1 - d^2)) gives the offset from the neighbouring bins exactly
+        fp32 offset = 0.0f;
+        fp32 lobe = 1.0f;
+        fp32 sum = amplitude[k - 1] + 2.0f * amplitude[k] + amplitude[k + 1];
+        if (sum > 0.0f)
+        {
+            offset = fp32_constrain(2.0f * (amplitude[k + 1] - amplitude[k - 1]) / sum, -0.5f, 0.5f);
+        }
+        if (fabsf(offset) > 1e-4f)
+        {
+            lobe = sinf(PI * offset) / (PI * offset * (1.0f - offset * offset));
+        }
+        analyzer->peak_freq[slot] = (k + offset) * analyzer->sample_rate_hz / SPECTRUM_FFT_LENGTH;
+        analyzer->peak_amplitude[slot] = amplitude[k] / lobe;
+    }
+}
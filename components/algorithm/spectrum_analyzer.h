@@ -0,0 +1,66 @@
+/**
+ * @file       spectrum_analyzer.c/h
+ * @brief      Amplitude spectrum of a sampled signal on CMSIS-DSP arm_rfft_fast_f32, averaged over blocks, with its peaks
+ * @arthur     MacFalcons Control Team
+ * Samples are recorded in blocks of SPECTRUM_FFT_LENGTH by the task owning the signal. A full block stops the recording
+ * until a low priority task has calculated it: the block mean is removed, a Hann window applied, and the amplitude of
+ * every bin scaled so a sine of amplitude A reads A at its bin. The block spectrum is averaged into the running one with
+ * average_coeff, then the largest local maxima are reported with frequency and amplitude refined from the neighbouring
+ * bins with the shape of the Hann main lobe. Bin spacing is sample_rate_hz / SPECTRUM_FFT_LENGTH.
+ */
+#ifndef SPECTRUM_ANALYZER_H
+#define SPECTRUM_ANALYZER_H
+#include "global_inc.h"
+#include "arm_math.h"
+
+// power of 2 supported by arm_rfft_fast_init_f32, 32 to 4096
+#define SPECTRUM_FFT_LENGTH 512
+#define SPECTRUM_BIN_COUNT (SPECTRUM_FFT_LENGTH / 2)
+#define SPECTRUM_PEAK_COUNT 3
+
+typedef enum
+{
+    SPECTRUM_RECORDING = 0,
+    SPECTRUM_BLOCK_FULL, // waiting for spectrum_analyzer_calc
+} spectrum_state_e;
+
+typedef struct
+{
+    arm_rfft_fast_instance_f32 fft;
+    fp32 sample_rate_hz;
+    fp32 average_coeff;                        // weight of the newest block, 1: no averaging
+    volatile spectrum_state_e state;
+    uint16_t sample_count;
+    uint32_t block_count;                      // blocks averaged since init
+    fp32 samples[SPECTRUM_FFT_LENGTH];         // windowed and transformed in place
+    fp32 fft_out[SPECTRUM_FFT_LENGTH];         // {DC, Nyquist, re1, im1, re2, im2, ...}
+    fp32 amplitude[SPECTRUM_BIN_COUNT];        // averaged amplitude, unit of the signal
+    fp32 peak_freq[SPECTRUM_PEAK_COUNT];       // Hz, largest first, 0 if fewer peaks
+    fp32 peak_amplitude[SPECTRUM_PEAK_COUNT];
+} spectrum_analyzer_t;
+
+/**
+  * @brief          spectrum analyzer init, clears the average and starts recording
+  * @param[out]     analyzer: spectrum analyzer struct point
+  * @param[in]      sample_rate_hz: rate samples are added at, unit Hz
+  * @param[in]      average_coeff: weight of the newest block in the average, (0, 1]
+  * @retval         1: success, 0: fft length not supported
+  */
+extern bool_t spectrum_analyzer_init(spectrum_analyzer_t *analyzer, fp32 sample_rate_hz, fp32 average_coeff);
+
+/**
+  * @brief          record one sample, ignored while a full block waits to be calculated
+  * @param[out]     analyzer: spectrum analyzer struct point
+  * @param[in]      sample: new sample
+  * @retval         1: the block is full
+  */
+extern bool_t spectrum_analyzer_add(spectrum_analyzer_t *analyzer, fp32 sample);
+
+/**
+  * @brief          calculate a full block into the averaged spectrum and its peaks, then restart recording
+  * @param[out]     analyzer: spectrum analyzer struct point
+  * @retval         1: calculated, 0: no full block
+  */
+extern bool_t spectrum_analyzer_calc(spectrum_analyzer_t *analyzer);
+
+#endif
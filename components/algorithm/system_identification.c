@@ -0,0 +1,347 @@
+/**
+ * @file       system_identification.c/h
+ * @brief      Excitation signals and least-squares model fitting for motor system identification
+ * @arthur     MacFalcons Control Team
+ */
+#include "system_identification.h"
+#include "AHRS_middleware.h"
+#include "user_lib.h"
+#include "math.h"
+
+#define SYSID_MAX_REGRESSOR 4
+#define SYSID_PIVOT_EPSILON 1e-9f
+
+static bool_t sysid_solve_linear(fp32 A[SYSID_MAX_REGRESSOR][SYSID_MAX_REGRESSOR], fp32 b[SYSID_MAX_REGRESSOR], uint8_t n, fp32 x[SYSID_MAX_REGRESSOR]);
+static bool_t sysid_least_squares(const fp32 *u, const fp32 *y, uint16_t len, uint8_t na, uint8_t delay, fp32 theta[SYSID_MAX_REGRESSOR], fp32 *residual);
+
+void sysid_chirp_init(sysid_excitation_t *excitation, fp32 amplitude, fp32 f_start, fp32 f_end, fp32 duration, fp32 dt)
+{
+    if (excitation == NULL)
+    {
+        return;
+    }
+    excitation->type = SYSID_EXCITATION_CHIRP;
+    excitation->amplitude = amplitude;
+    excitation->dt = dt;
+    excitation->step = 0;
+    excitation->length = (uint32_t)(duration / dt);
+    excitation->f_start = f_start;
+    excitation->f_end = f_end;
+    excitation->phase = 0.0f;
+}
+
+void sysid_prbs_init(sysid_excitation_t *excitation, fp32 amplitude, uint16_t prbs_hold, fp32 duration, fp32 dt)
+{
+    if (excitation == NULL)
+    {
+        return;
+    }
+    excitation->type = SYSID_EXCITATION_PRBS;
+    excitation->amplitude = amplitude;
+    excitation->dt = dt;
+    excitation->step = 0;
+    excitation->length = (uint32_t)(duration / dt);
+    excitation->lfsr = 0x1FF;
+    excitation->prbs_hold = (prbs_hold == 0) ? 1 : prbs_hold;
+}
+
+bool_t sysid_excitation_calc(sysid_excitation_t *excitation, fp32 *out)
+{
+    if (excitation == NULL || out == NULL)
+    {
+        return 0;
+    }
+    if (excitation->step >= excitation->length)
+    {
+        *out = 0.0f;
+        return 0;
+    }
+
+    switch (excitation->type)
+    {
+        case SYSID_EXCITATION_CHIRP:
+        {
+            fp32 freq = excitation->f_start + (excitation->f_end - excitation->f_start) * (fp32)excitation->step / (fp32)excitation->length;
+            *out = excitation->amplitude * AHRS_sinf(excitation->phase);
+            excitation->phase = loop_fp32_constrain(excitation->phase + 2.0f * PI * freq * excitation->dt, -PI, PI);
+            break;
+        }
+        case SYSID_EXCITATION_PRBS:
+        default:
+        {
+            if ((excitation->step % excitation->prbs_hold) == 0)
+            {
+                // x^9 + x^5 + 1, period 511 bits
+                uint16_t new_bit = ((excitation->lfsr >> 8) ^ (excitation->lfsr >> 4)) & 0x01;
+                excitation->lfsr = ((excitation->lfsr << 1) | new_bit) & 0x1FF;
+            }
+            *out = (excitation->lfsr & 0x01) ? excitation->amplitude : -excitation->amplitude;
+            break;
+        }
+    }
+    excitation->step++;
+    return 1;
+}
+
+bool_t sysid_fit_first_order(const fp32 *u, const fp32 *y, uint16_t len, uint8_t max_delay, fp32 dt, sysid_first_order_t *result)
+{
+    if (u == NULL || y == NULL || result == NULL || dt <= 0.0f)
+    {
+        return 0;
+    }
+
+    fp32 theta[SYSID_MAX_REGRESSOR];
+    fp32 residual;
+    fp32 best_residual = -1.0f;
+    uint8_t d;
+    for (d = 0; d <= max_delay; d++)
+    {
+        if (sysid_least_squares(u, y, len, 1, d, theta, &residual) && ((best_residual < 0.0f) || (residual < best_residual)))
+        {
+            best_residual = residual;
+            result->a = theta[0];
+            result->b = theta[1];
+            result->delay = d;
+        }
+    }
+    if (best_residual < 0.0f)
+    {
+        return 0;
+    }
+    result->fit_residual = best_residual;
+
+    // a stable first order plant driven by a positive gain has 0 < a <= 1 and b > 0
+    if ((result->a <= 0.0f) || (result->a > 1.0f + SYSID_PIVOT_EPSILON) || (result->b <= 0.0f))
+    {
+        return 0;
+    }
+    if (result->a >= 1.0f - 1e-6f)
+    {
+        // pure integrator, no measurable damping
+        result->damping = 0.0f;
+        result->inertia = dt / result->b;
+    }
+    else
+    {
+        // zero-order hold: a = exp(-B / J * dt), b = (1 - a) / B
+        result->damping = (1.0f - result->a) / result->b;
+        result->inertia = -result->damping * dt / logf(result->a);
+    }
+    return 1;
+}
+
+bool_t sysid_fit_second_order(const fp32 *u, const fp32 *y, uint16_t len, uint8_t max_delay, fp32 dt, sysid_second_order_t *result)
+{
+    if (u == NULL || y == NULL || result == NULL || dt <= 0.0f)
+    {
+        return 0;
+    }
+
+    fp32 theta[SYSID_MAX_REGRESSOR];
+    fp32 residual;
+    fp32 best_residual = -1.0f;
+    uint8_t d;
+    for (d = 0; d <= max_delay; d++)
+    {
+        if (sysid_least_squares(u, y, len, 2, d, theta, &residual) && ((best_residual < 0.0f) || (residual < best_residual)))
+        {
+            best_residual = residual;
+            result->a[0] = theta[0];
+            result->a[1] = theta[1];
+            result->b[0] = theta[2];
+            result->b[1] = theta[3];
+            result->delay = d;
+        }
+    }
+    if (best_residual < 0.0f)
+    {
+        return 0;
+    }
+    result->fit_residual = best_residual;
+
+    fp32 den = 1.0f - result->a[0] - result->a[1];
+    if (fabsf(den) < SYSID_PIVOT_EPSILON)
+    {
+        return 0;
+    }
+    result->dc_gain = (result->b[0] + result->b[1]) / den;
+
+    // poles of z^2 - a1 * z - a2, mapped to continuous time by s = ln(z) / dt
+    fp32 disc = result->a[0] * result->a[0] + 4.0f * result->a[1];
+    if (disc >= 0.0f)
+    {
+        fp32 root = sqrtf(disc);
+        fp32 z1 = 0.5f * (result->a[0] + root);
+        fp32 z2 = 0.5f * (result->a[0] - root);
+        if ((z1 <= 0.0f) || (z2 <= 0.0f) || (z1 >= 1.0f) || (z2 >= 1.0f))
+        {
+            // negative real pole has no continuous equivalent, pole on/outside unit circle is not a stable plant
+            return 0;
+        }
+        fp32 s1 = logf(z1) / dt;
+        fp32 s2 = logf(z2) / dt;
+        result->natural_freq = sqrtf(s1 * s2);
+        result->damping_ratio = -(s1 + s2) / (2.0f * result->natural_freq);
+    }
+    else
+    {
+        fp32 radius = sqrtf(-result->a[1]);
+        if (radius >= 1.0f)
+        {
+            return 0;
+        }
+        fp32 angle = atan2f(0.5f * sqrtf(-disc), 0.5f * result->a[0]);
+        fp32 log_radius = logf(radius);
+        fp32 magnitude = sqrtf(log_radius * log_radius + angle * angle);
+        result->natural_freq = magnitude / dt;
+        result->damping_ratio = -log_radius / magnitude;
+    }
+    return 1;
+}
+
+/**
+  * @brief          least squares of ARX model y[k+1] = sum(a_i * y[k-i]) + sum(b_i * u[k-d-i]), i in [0, na)
+  * @param[in]      na: model order, 1 or 2
+  * @param[in]      delay: input delay, unit sample
+  * @param[out]     theta: a[0..na-1] followed by b[0..na-1]
+  * @param[out]     residual: RMS of one-step prediction error divided by RMS of y
+  * @retval         1: success, 0: singular normal equation
+  */
+static bool_t sysid_least_squares(const fp32 *u, const fp32 *y, uint16_t len, uint8_t na, uint8_t delay, fp32 theta[SYSID_MAX_REGRESSOR], fp32 *residual)
+{
+    fp32 A[SYSID_MAX_REGRESSOR][SYSID_MAX_REGRESSOR] = {0};
+    fp32 b[SYSID_MAX_REGRESSOR] = {0};
+    fp32 phi[SYSID_MAX_REGRESSOR];
+    uint8_t n = 2 * na;
+    uint16_t start = delay + na - 1;
+    uint16_t k;
+    uint8_t i, j;
+
+    if ((na == 0) || (n > SYSID_MAX_REGRESSOR) || (len < start + 2 + n))
+    {
+        return 0;
+    }
+
+    // normalize u and y to unit peak, raw current (~1e4) and speed (~1e1) would make the fp32 normal equation ill-conditioned
+    fp32 u_scale = 0.0f;
+    fp32 y_scale = 0.0f;
+    for (k = 0; k < len; k++)
+    {
+        u_scale = fmaxf(u_scale, fabsf(u[k]));
+        y_scale = fmaxf(y_scale, fabsf(y[k]));
+    }
+    if ((u_scale <= 0.0f) || (y_scale <= 0.0f))
+    {
+        return 0;
+    }
+    u_scale = 1.0f / u_scale;
+    y_scale = 1.0f / y_scale;
+
+    for (k = start; k < len - 1; k++)
+    {
+        for (i = 0; i < na; i++)
+        {
+            phi[i] = y[k - i] * y_scale;
+            phi[na + i] = u[k - delay - i] * u_scale;
+        }
+        for (i = 0; i < n; i++)
+        {
+            for (j = i; j < n; j++)
+            {
+                A[i][j] += phi[i] * phi[j];
+            }
+            b[i] += phi[i] * y[k + 1] * y_scale;
+        }
+    }
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < i; j++)
+        {
+            A[i][j] = A[j][i];
+        }
+    }
+
+    if (sysid_solve_linear(A, b, n, theta) == 0)
+    {
+        return 0;
+    }
+    // back to physical unit, a is dimensionless
+    for (i = 0; i < na; i++)
+    {
+        theta[na + i] *= u_scale / y_scale;
+    }
+
+    fp32 err_sum = 0.0f;
+    fp32 y_sum = 0.0f;
+    for (k = start; k < len - 1; k++)
+    {
+        fp32 prediction = 0.0f;
+        for (i = 0; i < na; i++)
+        {
+            prediction += theta[i] * y[k - i] + theta[na + i] * u[k - delay - i];
+        }
+        err_sum += (y[k + 1] - prediction) * (y[k + 1] - prediction);
+        y_sum += y[k + 1] * y[k + 1];
+    }
+    if (y_sum <= 0.0f)
+    {
+        return 0;
+    }
+    *residual = sqrtf(err_sum / y_sum);
+    return 1;
+}
+
+/**
+  * @brief          solve A * x = b by gaussian elimination with partial pivoting, A and b are destroyed
+  * @retval         1: success, 0: singular
+  */
+static bool_t sysid_solve_linear(fp32 A[SYSID_MAX_REGRESSOR][SYSID_MAX_REGRESSOR], fp32 b[SYSID_MAX_REGRESSOR], uint8_t n, fp32 x[SYSID_MAX_REGRESSOR])
+{
+    uint8_t i, j, k;
+    for (k = 0; k < n; k++)
+    {
+        uint8_t pivot = k;
+        for (i = k + 1; i < n; i++)
+        {
+            if (fabsf(A[i][k]) > fabsf(A[pivot][k]))
+            {
+                pivot = i;
+            }
+        }
+        if (fabsf(A[pivot][k]) < SYSID_PIVOT_EPSILON)
+        {
+            return 0;
+        }
+        if (pivot != k)
+        {
+            for (j = 0; j < n; j++)
+            {
+                fp32 temp = A[k][j];
+                A[k][j] = A[pivot][j];
+                A[pivot][j] = temp;
+            }
+            fp32 temp = b[k];
+            b[k] = b[pivot];
+            b[pivot] = temp;
+        }
+        for (i = k + 1; i < n; i++)
+        {
+            fp32 factor = A[i][k] / A[k][k];
+            for (j = k; j < n; j++)
+            {
+                A[i][j] -= factor * A[k][j];
+            }
+            b[i] -= factor * b[k];
+        }
+    }
+    for (i = n; i-- > 0;)
+    {
+        fp32 sum = b[i];
+        for (j = i + 1; j < n; j++)
+        {
+            sum -= A[i][j] * x[j];
+        }
+        x[i] = sum / A[i][i];
+    }
+    return 1;
+}
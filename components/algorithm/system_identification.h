@@ -0,0 +1,115 @@
+/**
+ * @file       system_identification.c/h
+ * @brief      Excitation signals and least-squares model fitting for motor system identification
+ * @arthur     MacFalcons Control Team
+ * Recorded data is a pair of arrays sampled at fixed period dt:
+ *   u[k]: command applied during cycle k
+ *   y[k]: speed measured at the beginning of cycle k, unit rad/s
+ * First order model:  J * dy/dt + B * y = u(t - delay)
+ *   discrete form:    y[k+1] = a * y[k] + b * u[k-d]
+ * Second order model: y[k+1] = a1 * y[k] + a2 * y[k-1] + b1 * u[k-d] + b2 * u[k-d-1]
+ *   reported as natural frequency, damping ratio and dc gain of the equivalent continuous system
+ */
+#ifndef SYSTEM_IDENTIFICATION_H
+#define SYSTEM_IDENTIFICATION_H
+#include "global_inc.h"
+
+typedef enum
+{
+    SYSID_EXCITATION_CHIRP = 0,
+    SYSID_EXCITATION_PRBS,
+} sysid_excitation_e;
+
+typedef struct
+{
+    sysid_excitation_e type;
+    fp32 amplitude;
+    fp32 dt;            // s
+    uint32_t step;      // current sample
+    uint32_t length;    // total samples
+    // chirp
+    fp32 f_start;       // Hz
+    fp32 f_end;         // Hz
+    fp32 phase;         // rad
+    // prbs
+    uint16_t lfsr;
+    uint16_t prbs_hold; // samples per prbs bit
+} sysid_excitation_t;
+
+typedef struct
+{
+    fp32 inertia;       // J, command unit / (rad/s^2)
+    fp32 damping;       // B, command unit / (rad/s)
+    uint8_t delay;      // samples
+    fp32 a;
+    fp32 b;
+    fp32 fit_residual;  // RMS of one-step prediction error divided by RMS of y
+} sysid_first_order_t;
+
+typedef struct
+{
+    fp32 a[2];
+    fp32 b[2];
+    uint8_t delay;         // samples
+    fp32 natural_freq;     // rad/s
+    fp32 damping_ratio;
+    fp32 dc_gain;          // (rad/s) / command unit
+    fp32 fit_residual;
+} sysid_second_order_t;
+
+/**
+  * @brief          linear frequency sweep excitation init, out = amplitude * sin(phase), f goes from f_start to f_end in duration
+  * @param[out]     excitation: excitation struct point
+  * @param[in]      amplitude: amplitude in command unit
+  * @param[in]      f_start: start frequency, unit Hz
+  * @param[in]      f_end: end frequency, unit Hz, should be lower than 1 / (2 * dt)
+  * @param[in]      duration: unit s
+  * @param[in]      dt: sample time, unit s
+  * @retval         none
+  */
+extern void sysid_chirp_init(sysid_excitation_t *excitation, fp32 amplitude, fp32 f_start, fp32 f_end, fp32 duration, fp32 dt);
+
+/**
+  * @brief          pseudo random binary sequence excitation init, 9 bit maximal length LFSR, out = +-amplitude
+  * @param[out]     excitation: excitation struct point
+  * @param[in]      amplitude: amplitude in command unit
+  * @param[in]      prbs_hold: samples to hold each bit, sets the bandwidth of the excitation
+  * @param[in]      duration: unit s
+  * @param[in]      dt: sample time, unit s
+  * @retval         none
+  */
+extern void sysid_prbs_init(sysid_excitation_t *excitation, fp32 amplitude, uint16_t prbs_hold, fp32 duration, fp32 dt);
+
+/**
+  * @brief          calculate next excitation sample
+  * @param[out]     excitation: excitation struct point
+  * @param[out]     out: excitation value, 0 once finished
+  * @retval         1: still running, 0: finished
+  */
+extern bool_t sysid_excitation_calc(sysid_excitation_t *excitation, fp32 *out);
+
+/**
+  * @brief          fit first order model with delay by least squares, the delay with minimum residual is chosen
+  * @param[in]      u: command record
+  * @param[in]      y: speed record, unit rad/s
+  * @param[in]      len: record length
+  * @param[in]      max_delay: max delay to search, unit sample
+  * @param[in]      dt: sample time, unit s
+  * @param[out]     result: fitted model
+  * @retval         1: success, 0: data not sufficient or model not physical
+  */
+extern bool_t sysid_fit_first_order(const fp32 *u, const fp32 *y, uint16_t len, uint8_t max_delay, fp32 dt, sysid_first_order_t *result);
+
+/**
+  * @brief          fit second order ARX model with delay by least squares, the delay with minimum residual is chosen
+  * @param[in]      u: command record
+  * @param[in]      y: speed record, unit rad/s
+  * @param[in]      len: record length
+  * @param[in]      max_delay: max delay to search, unit sample
+  * @param[in]      dt: sample time, unit s
+  * @param[out]     result: fitted model
+  * @retval         1: success, 0: data not sufficient or model not physical
+  */
+extern bool_t sysid_fit_second_order(const fp32 *u, const fp32 *y, uint16_t len, uint8_t max_delay, fp32 dt, sysid_second_order_t *result);
+
+#endif
@@ -23,6 +23,34 @@ fp32 invSqrt(fp32 num)
     return y;
 }
 
+// fast single precision atan2, polynomial on [0, 1] then octant fold, max error about 1e-5 rad
+fp32 fast_atan2f(fp32 y, fp32 x)
+{
+    fp32 abs_x = fabsf(x);
+    fp32 abs_y = fabsf(y);
+    fp32 max_xy = (abs_x > abs_y) ? abs_x : abs_y;
+    if (max_xy == 0.0f)
+    {
+        return 0.0f;
+    }
+    fp32 z = ((abs_x < abs_y) ? abs_x : abs_y) / max_xy;
+    fp32 z2 = z * z;
+    fp32 angle = z * (0.9998660f + z2 * (-0.3302995f + z2 * (0.1801410f + z2 * (-0.0851330f + z2 * 0.0208351f))));
+    if (abs_y > abs_x)
+    {
+        angle = PI / 2.0f - angle;
+    }
+    if (x < 0.0f)
+    {
+        angle = PI - angle;
+    }
+    if (y < 0.0f)
+    {
+        angle = -angle;
+    }
+    return angle;
+}
+
 /**
     * @brief          Ramp function initialization
     * @author         RM
@@ -91,6 +119,90 @@ void first_order_filter_cali(first_order_filter_type_t *first_order_filter_type,
         first_order_filter_type->num[0] / (first_order_filter_type->num[0] + first_order_filter_type->frame_period) * first_order_filter_type->out + first_order_filter_type->frame_period / (first_order_filter_type->num[0] + first_order_filter_type->frame_period) * first_order_filter_type->input;
 }
 
+/**
+    * @brief          S-curve ramp initialization
+    * @param[out]     s_curve_ramp: S-curve ramp structure
+    * @param[in]      frame_period: time interval, in seconds
+    * @param[in]      max_rate: maximum rate of change of output, per second
+    * @param[in]      max_jerk: maximum change of rate, per second^2
+    * @retval         None
+    */
+void s_curve_ramp_init(s_curve_ramp_type_t *s_curve_ramp, fp32 frame_period, fp32 max_rate, fp32 max_jerk)
+{
+    s_curve_ramp->frame_period = frame_period;
+    s_curve_ramp_set_limit(s_curve_ramp, max_rate, max_jerk);
+    s_curve_ramp_reset(s_curve_ramp, 0.0f);
+}
+
+/**
+    * @brief          change S-curve ramp limits, can be called every period
+    * @param[out]     s_curve_ramp: S-curve ramp structure
+    * @param[in]      max_rate: maximum rate of change of output, per second
+    * @param[in]      max_jerk: maximum change of rate, per second^2
+    * @retval         None
+    */
+void s_curve_ramp_set_limit(s_curve_ramp_type_t *s_curve_ramp, fp32 max_rate, fp32 max_jerk)
+{
+    s_curve_ramp->max_rate = fabsf(max_rate);
+    s_curve_ramp->max_jerk = fabsf(max_jerk);
+}
+
+/**
+    * @brief          jump S-curve ramp output to a value, at rest
+    * @param[out]     s_curve_ramp: S-curve ramp structure
+    * @param[in]      out: new output
+    * @retval         None
+    */
+void s_curve_ramp_reset(s_curve_ramp_type_t *s_curve_ramp, fp32 out)
+{
+    s_curve_ramp->out = out;
+    s_curve_ramp->rate = 0.0f;
+}
+
+/**
+    * @brief          S-curve ramp calculation: output moves to target with bounded rate and bounded jerk, without
+    *                 overshoot. The rate follows the discrete braking curve, from which it steps down by max_jerk * dt
+    *                 every period to land on target (k + ... + 1 periods of rate step cover k * (k + 1) / 2 steps)
+    * @param[out]     s_curve_ramp: S-curve ramp structure
+    * @param[in]      target: target value
+    * @retval         output
+    */
+fp32 s_curve_ramp_calc(s_curve_ramp_type_t *s_curve_ramp, fp32 target)
+{
+    fp32 dt = s_curve_ramp->frame_period;
+    fp32 max_rate_step = s_curve_ramp->max_jerk * dt;
+    fp32 error = target - s_curve_ramp->out;
+
+    if ((fabsf(error) <= max_rate_step * dt) && (fabsf(s_curve_ramp->rate) <= 2.0f * max_rate_step))
+    {
+        // on target, hold it while the rate comes to rest
+        s_curve_ramp->out = target;
+        s_curve_ramp->rate -= fp32_constrain(s_curve_ramp->rate, -max_rate_step, max_rate_step);
+        return s_curve_ramp->out;
+    }
+
+    fp32 rate_set = max_rate_step * (sqrtf(0.25f + 2.0f * fabsf(error) / (max_rate_step * dt)) - 0.5f);
+    if (rate_set > s_curve_ramp->max_rate)
+    {
+        rate_set = s_curve_ramp->max_rate;
+    }
+    if (error < 0.0f)
+    {
+        rate_set = -rate_set;
+    }
+    s_curve_ramp->rate += fp32_constrain(rate_set - s_curve_ramp->rate, -max_rate_step, max_rate_step);
+    if ((fabsf(s_curve_ramp->rate * dt) >= fabsf(error)) && (s_curve_ramp->rate * error > 0.0f) && (fabsf(s_curve_ramp->rate) <= 2.0f * max_rate_step))
+    {
+        // last period of a move, land on target instead of passing it by a fraction of a period
+        s_curve_ramp->out = target;
+    }
+    else
+    {
+        s_curve_ramp->out += s_curve_ramp->rate * dt;
+    }
+    return s_curve_ramp->out;
+}
+
 fp32 moving_average_calc(fp32 input, moving_average_type_t* moving_average_type, uint8_t fInit)
 {
     fp32 output;
@@ -94,6 +94,15 @@ typedef struct
     fp32 frame_period; // Time interval for filtering in seconds
 } first_order_filter_type_t;
 
+typedef struct
+{
+    fp32 out;          // Output data
+    fp32 rate;         // Rate of change of output, per second
+    fp32 max_rate;     // Maximum rate of change, per second
+    fp32 max_jerk;     // Maximum change of rate, per second^2
+    fp32 frame_period; // Time interval in seconds
+} s_curve_ramp_type_t;
+
 typedef struct
 {
     uint8_t size;
@@ -106,6 +115,10 @@ void ramp_init(ramp_function_source_t *ramp_source_type, fp32 frame_period, fp32
 void ramp_calc(ramp_function_source_t *ramp_source_type, fp32 input);
 extern void first_order_filter_init(first_order_filter_type_t *first_order_filter_type, fp32 frame_period, const fp32 num[1]);
 extern void first_order_filter_cali(first_order_filter_type_t *first_order_filter_type, fp32 input);
+extern void s_curve_ramp_init(s_curve_ramp_type_t *s_curve_ramp, fp32 frame_period, fp32 max_rate, fp32 max_jerk);
+extern void s_curve_ramp_set_limit(s_curve_ramp_type_t *s_curve_ramp, fp32 max_rate, fp32 max_jerk);
+extern void s_curve_ramp_reset(s_curve_ramp_type_t *s_curve_ramp, fp32 out);
+extern fp32 s_curve_ramp_calc(s_curve_ramp_type_t *s_curve_ramp, fp32 target);
 extern fp32 moving_average_calc(fp32 input, moving_average_type_t* moving_average_type, uint8_t fInit);
 extern fp32 sign(fp32 value);
 extern fp32 fp32_deadline(fp32 Value, fp32 minValue, fp32 maxValue);
@@ -118,6 +131,7 @@ uint8_t checkAndResetFlag(uint8_t *pbFlag);
 fp32 first_order_filter(fp32 input, fp32 prev_output, fp32 coeff);
 
 extern fp32 invSqrt(fp32 num);
+extern fp32 fast_atan2f(fp32 y, fp32 x);
 extern fp32 loop_fp32_constrain(fp32 Input, fp32 minValue, fp32 maxValue);
 extern fp32 theta_format(fp32 Ang);
 
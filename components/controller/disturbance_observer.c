@@ -0,0 +1,71 @@
+/**
+ * @file       disturbance_observer.c/h
+ * @brief      Disturbance observer (DOB) for a speed loop
+ * @arthur     MacFalcons Control Team
+ */
+#include "disturbance_observer.h"
+#include "user_lib.h"
+
+void DOB_init(disturbance_observer_t *dob, fp32 nominal_inertia, fp32 nominal_damping, fp32 cutoff_hz, fp32 max_compensation, fp32 dt)
+{
+    if (dob == NULL)
+    {
+        return;
+    }
+    dob->nominal_inertia = nominal_inertia;
+    dob->nominal_damping = nominal_damping;
+    dob->max_compensation = max_compensation;
+    dob->dt = dt;
+    // discretized first order low-pass: coeff = dt / (tau + dt)
+    fp32 tau = 1.0f / (2.0f * PI * cutoff_hz);
+    dob->q_filter_coeff = dt / (tau + dt);
+    DOB_clear(dob);
+}
+
+fp32 DOB_calc(disturbance_observer_t *dob, fp32 speed)
+{
+    if (dob == NULL)
+    {
+        return 0.0f;
+    }
+
+    if (dob->fInited == 0)
+    {
+        // no speed history yet, avoid a derivative spike on the first sample
+        dob->last_speed = speed;
+        dob->fInited = 1;
+        return 0.0f;
+    }
+
+    // nominal inverse model: the command that would have produced the measured motion without disturbance
+    fp32 accel = (speed - dob->last_speed) / dob->dt;
+    fp32 nominal_cmd = dob->nominal_inertia * accel + dob->nominal_damping * speed;
+    dob->last_speed = speed;
+
+    // Q-filter keeps the estimate causal and attenuates gyro noise amplified by differentiation
+    dob->disturbance = first_order_filter(nominal_cmd - dob->last_cmd, dob->disturbance, dob->q_filter_coeff);
+    dob->compensation = fp32_abs_constrain(-dob->disturbance, dob->max_compensation);
+    return dob->compensation;
+}
+
+void DOB_set_applied_cmd(disturbance_observer_t *dob, fp32 cmd)
+{
+    if (dob == NULL)
+    {
+        return;
+    }
+    dob->last_cmd = cmd;
+}
+
+void DOB_clear(disturbance_observer_t *dob)
+{
+    if (dob == NULL)
+    {
+        return;
+    }
+    dob->last_speed = 0.0f;
+    dob->last_cmd = 0.0f;
+    dob->disturbance = 0.0f;
+    dob->compensation = 0.0f;
+    dob->fInited = 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file       disturbance_observer.c/h
+ * @brief      Disturbance observer (DOB) for a speed loop
+ * @arthur     MacFalcons Control Team
+ * The plant is modelled as a first-order nominal system: J_n * dw/dt + B_n * w = u + d
+ * The lumped disturbance d is estimated by passing (nominal inverse model output - applied command) through a low-pass Q-filter,
+ * and the estimate is subtracted from the next command. Unit of J_n, B_n and d follows the unit of the command (Nm, or raw current).
+ */
+#ifndef DISTURBANCE_OBSERVER_H
+#define DISTURBANCE_OBSERVER_H
+#include "global_inc.h"
+
+typedef struct
+{
+    fp32 nominal_inertia;   // J_n, command unit / (rad/s^2)
+    fp32 nominal_damping;   // B_n, command unit / (rad/s)
+    fp32 q_filter_coeff;    // first order Q-filter coefficient, range (0, 1]; larger means higher cutoff frequency
+    fp32 max_compensation;  // absolute limit of compensation output
+    fp32 dt;                // sample time, unit s
+
+    fp32 last_speed;        // rad/s
+    fp32 last_cmd;          // command applied in the last cycle, including compensation
+    fp32 disturbance;       // filtered disturbance estimate
+    fp32 compensation;      // output: value to add to the controller command
+    uint8_t fInited;
+} disturbance_observer_t;
+
+/**
+  * @brief          disturbance observer init
+  * @param[out]     dob: disturbance observer struct point
+  * @param[in]      nominal_inertia: J_n of nominal model
+  * @param[in]      nominal_damping: B_n of nominal model
+  * @param[in]      cutoff_hz: cutoff frequency of Q-filter, unit Hz
+  * @param[in]      max_compensation: absolute limit of compensation output
+  * @param[in]      dt: sample time, unit s
+  * @retval         none
+  */
+extern void DOB_init(disturbance_observer_t *dob, fp32 nominal_inertia, fp32 nominal_damping, fp32 cutoff_hz, fp32 max_compensation, fp32 dt);
+
+/**
+  * @brief          update disturbance estimate with current speed feedback, should be called once per control cycle before the command is sent
+  * @param[out]     dob: disturbance observer struct point
+  * @param[in]      speed: measured speed, unit rad/s
+  * @retval         compensation to be added to the controller command
+  */
+extern fp32 DOB_calc(disturbance_observer_t *dob, fp32 speed);
+
+/**
+  * @brief          record the command actually applied to the plant in this cycle, used by the next DOB_calc
+  * @param[out]     dob: disturbance observer struct point
+  * @param[in]      cmd: applied command
+  * @retval         none
+  */
+extern void DOB_set_applied_cmd(disturbance_observer_t *dob, fp32 cmd);
+
+/**
+  * @brief          clear disturbance estimate, next DOB_calc starts from zero compensation
+  * @param[out]     dob: disturbance observer struct point
+  * @retval         none
+  */
+extern void DOB_clear(disturbance_observer_t *dob);
+
+#endif
@@ -0,0 +1,59 @@
+/**
+ * @file       lqr.c/h
+ * @brief      Full-state feedback controller for a single rotational axis
+ * @arthur     MacFalcons Control Team
+ */
+#include "lqr.h"
+#include "pid.h"
+#include "user_lib.h"
+
+void LQR_init(lqr_type_def *lqr, const fp32 K[3], fp32 max_out, fp32 max_integral)
+{
+    if (lqr == NULL || K == NULL)
+    {
+        return;
+    }
+    lqr->K[0] = K[0];
+    lqr->K[1] = K[1];
+    lqr->K[2] = K[2];
+    lqr->max_out = max_out;
+    lqr->max_integral = max_integral;
+    LQR_clear(lqr);
+}
+
+fp32 LQR_calc(lqr_type_def *lqr, fp32 ref, fp32 set, fp32 rate, fp32 dt)
+{
+    if (lqr == NULL)
+    {
+        return 0.0f;
+    }
+
+    lqr->set = set;
+    lqr->fdb = ref;
+    lqr->error = rad_format(set - ref);
+
+    lqr->Aout = lqr->K[0] * lqr->error;
+    lqr->Rout = -lqr->K[1] * rate;
+
+    // conditional integration: stop winding up while output is saturated in the same direction
+    if (!(((lqr->out >= lqr->max_out) && (lqr->error > 0.0f)) || ((lqr->out <= -lqr->max_out) && (lqr->error < 0.0f))))
+    {
+        lqr->integral += lqr->error * dt;
+        LimitMax(&lqr->integral, lqr->max_integral);
+    }
+    lqr->Iout = lqr->K[2] * lqr->integral;
+
+    lqr->out = lqr->Aout + lqr->Rout + lqr->Iout;
+    LimitMax(&lqr->out, lqr->max_out);
+    return lqr->out;
+}
+
+void LQR_clear(lqr_type_def *lqr)
+{
+    if (lqr == NULL)
+    {
+        return;
+    }
+    lqr->set = lqr->fdb = lqr->error = lqr->integral = 0.0f;
+    lqr->out = lqr->Aout = lqr->Rout = lqr->Iout = 0.0f;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file       lqr.c/h
+ * @brief      Full-state feedback controller for a single rotational axis
+ * @arthur     MacFalcons Control Team
+ * States are angle error, angular rate and integral of angle error. Gains are computed offline
+ * by Scripts/gimbal_lqr_gain.py from an identified model and passed in as a constant table.
+ */
+#ifndef LQR_H
+#define LQR_H
+#include "global_inc.h"
+
+typedef struct
+{
+    fp32 K[3];          // 0: angle, 1: rate, 2: integral
+    fp32 max_out;
+    fp32 max_integral;  // anti-windup limit of integral state, unit rad*s
+
+    fp32 set;
+    fp32 fdb;
+    fp32 error;         // rad, wrapped to [-PI, PI]
+    fp32 integral;      // rad*s
+
+    fp32 out;
+    fp32 Aout;
+    fp32 Rout;
+    fp32 Iout;
+} lqr_type_def;
+
+/**
+  * @brief          lqr struct data init
+  * @param[out]     lqr: LQR struct data point
+  * @param[in]      K: 0: angle gain, 1: rate gain, 2: integral gain
+  * @param[in]      max_out: lqr max out
+  * @param[in]      max_integral: limit of integral state
+  * @retval         none
+  */
+extern void LQR_init(lqr_type_def *lqr, const fp32 K[3], fp32 max_out, fp32 max_integral);
+
+/**
+  * @brief          lqr calculate, u = K0 * err - K1 * rate + K2 * integral(err)
+  * @param[out]     lqr: LQR struct data point
+  * @param[in]      ref: angle feedback, unit rad
+  * @param[in]      set: angle set point, unit rad
+  * @param[in]      rate: angular rate feedback, unit rad/s
+  * @param[in]      dt: control period, unit s
+  * @retval         lqr out
+  */
+extern fp32 LQR_calc(lqr_type_def *lqr, fp32 ref, fp32 set, fp32 rate, fp32 dt);
+
+/**
+  * @brief          lqr out and integral state clear
+  * @param[out]     lqr: LQR struct data point
+  * @retval         none
+  */
+extern void LQR_clear(lqr_type_def *lqr);
+
+#endif
@@ -0,0 +1,219 @@
+/**
+ * @file       pid_autotune.c/h
+ * @brief      Relay feedback auto-tuner for single loop PID controllers (Astrom-Hagglund method)
+ * @arthur     MacFalcons Control Team
+ */
+#include "pid_autotune.h"
+#include "pid.h"
+#include "user_lib.h"
+#include "math.h"
+
+#define PID_AUTOTUNE_SETTLE_CYCLES      2       // cycles ignored while the oscillation builds up
+#define PID_AUTOTUNE_MEASURE_CYCLES     4       // cycles averaged for Ku and Tu
+#define PID_AUTOTUNE_SYMMETRY_TOLERANCE 0.15f   // max (t_high - t_low) / period of a measured cycle
+#define PID_AUTOTUNE_BIAS_ADAPT_GAIN    0.5f
+
+static void PID_autotune_finish(pid_autotune_t *tune);
+
+void PID_autotune_init(pid_autotune_t *tune, fp32 relay_amplitude, fp32 hysteresis, fp32 max_out, fp32 max_error, uint8_t rule, fp32 timeout, fp32 dt)
+{
+    if (tune == NULL || dt <= 0.0f)
+    {
+        return;
+    }
+    tune->relay_amplitude = relay_amplitude;
+    tune->hysteresis = hysteresis;
+    tune->max_out = max_out;
+    tune->max_error = max_error;
+    tune->rule = rule;
+    tune->dt = dt;
+    tune->timeout_samples = (uint32_t)(timeout / dt);
+    // a healthy oscillation of a speed loop is well below 1s per half period
+    tune->switch_timeout_samples = (uint32_t)(1.0f / dt);
+    PID_autotune_clear(tune);
+}
+
+void PID_autotune_start(pid_autotune_t *tune, fp32 bias)
+{
+    if (tune == NULL)
+    {
+        return;
+    }
+    PID_autotune_clear(tune);
+    tune->bias = bias;
+    LimitMax(&tune->bias, tune->max_out);
+    // kick the loop upward, so it still oscillates when started right at the set point
+    tune->relay_dir = 1;
+    tune->state = PID_AUTOTUNE_RUNNING;
+}
+
+fp32 PID_autotune_calc(pid_autotune_t *tune, fp32 ref, fp32 set)
+{
+    if (tune == NULL)
+    {
+        return 0.0f;
+    }
+    if (tune->state != PID_AUTOTUNE_RUNNING)
+    {
+        tune->out = 0.0f;
+        return 0.0f;
+    }
+
+    fp32 error = set - ref;
+    tune->sample++;
+    if ((tune->sample > tune->timeout_samples) || (fabsf(error) > tune->max_error))
+    {
+        tune->state = PID_AUTOTUNE_FAILED;
+        tune->out = 0.0f;
+        return 0.0f;
+    }
+
+    int8_t last_dir = tune->relay_dir;
+    if (error > tune->hysteresis)
+    {
+        tune->relay_dir = 1;
+    }
+    else if (error < -tune->hysteresis)
+    {
+        tune->relay_dir = -1;
+    }
+
+    if (tune->relay_dir != last_dir)
+    {
+        tune->samples_since_switch = 0;
+        // a cycle is from one rising edge of the relay to the next one
+        if (tune->relay_dir == 1)
+        {
+            if (tune->fCycleStarted)
+            {
+                fp32 period = (fp32)(tune->high_samples + tune->low_samples);
+                fp32 asymmetry = ((fp32)tune->high_samples - (fp32)tune->low_samples) / period;
+                // high phase lasts longer when bias is below the load, move bias toward it
+                tune->bias += PID_AUTOTUNE_BIAS_ADAPT_GAIN * tune->relay_amplitude * asymmetry;
+                LimitMax(&tune->bias, tune->max_out);
+
+                if (tune->cycle_count < PID_AUTOTUNE_SETTLE_CYCLES)
+                {
+                    tune->cycle_count++;
+                }
+                else if (fabsf(asymmetry) < PID_AUTOTUNE_SYMMETRY_TOLERANCE)
+                {
+                    tune->period_sum += period;
+                    tune->amplitude_sum += 0.5f * (tune->fdb_max - tune->fdb_min);
+                    tune->measured_cycles++;
+                }
+                else
+                {
+                    // bias still moving, measurement restarts
+                    tune->period_sum = 0.0f;
+                    tune->amplitude_sum = 0.0f;
+                    tune->measured_cycles = 0;
+                }
+
+                if (tune->measured_cycles >= PID_AUTOTUNE_MEASURE_CYCLES)
+                {
+                    PID_autotune_finish(tune);
+                    tune->out = 0.0f;
+                    return 0.0f;
+                }
+            }
+            tune->fCycleStarted = 1;
+            tune->high_samples = 0;
+            tune->low_samples = 0;
+            tune->fdb_max = ref;
+            tune->fdb_min = ref;
+        }
+    }
+    else if (++tune->samples_since_switch > tune->switch_timeout_samples)
+    {
+        // relay output can't bring feedback across the set point, shift bias toward it
+        tune->samples_since_switch = 0;
+        tune->bias += PID_AUTOTUNE_BIAS_ADAPT_GAIN * tune->relay_amplitude * tune->relay_dir;
+        LimitMax(&tune->bias, tune->max_out);
+    }
+
+    if (tune->relay_dir == 1)
+    {
+        tune->high_samples++;
+    }
+    else if (tune->relay_dir == -1)
+    {
+        tune->low_samples++;
+    }
+    if (ref > tune->fdb_max)
+    {
+        tune->fdb_max = ref;
+    }
+    if (ref < tune->fdb_min)
+    {
+        tune->fdb_min = ref;
+    }
+
+    tune->out = tune->bias + tune->relay_dir * tune->relay_amplitude;
+    LimitMax(&tune->out, tune->max_out);
+    return tune->out;
+}
+
+void PID_autotune_clear(pid_autotune_t *tune)
+{
+    if (tune == NULL)
+    {
+        return;
+    }
+    tune->state = PID_AUTOTUNE_IDLE;
+    tune->relay_dir = 0;
+    tune->fCycleStarted = 0;
+    tune->cycle_count = 0;
+    tune->measured_cycles = 0;
+    tune->bias = tune->out = 0.0f;
+    tune->sample = tune->samples_since_switch = 0;
+    tune->high_samples = tune->low_samples = 0;
+    tune->fdb_max = tune->fdb_min = 0.0f;
+    tune->period_sum = tune->amplitude_sum = 0.0f;
+}
+
+/**
+  * @brief          calculate ultimate gain, ultimate period and pid gains from the measured cycles
+  * @param[out]     tune: auto-tuner struct point
+  * @retval         none
+  */
+static void PID_autotune_finish(pid_autotune_t *tune)
+{
+    fp32 amplitude = tune->amplitude_sum / tune->measured_cycles;
+    fp32 period = tune->period_sum / tune->measured_cycles * tune->dt;
+
+    if ((amplitude <= tune->hysteresis) || (period <= 0.0f))
+    {
+        tune->state = PID_AUTOTUNE_FAILED;
+        return;
+    }
+    tune->ultimate_gain = 4.0f * tune->relay_amplitude / (PI * sqrtf(amplitude * amplitude - tune->hysteresis * tune->hysteresis));
+    tune->ultimate_period = period;
+
+    switch (tune->rule)
+    {
+        case PID_AUTOTUNE_RULE_ZN_PID:
+        {
+            tune->gains[0] = 0.6f * tune->ultimate_gain;
+            tune->gains[1] = tune->gains[0] / (0.5f * period);
+            tune->gains[2] = tune->gains[0] * 0.125f * period;
+            break;
+        }
+        case PID_AUTOTUNE_RULE_TL_PI:
+        {
+            tune->gains[0] = tune->ultimate_gain / 3.2f;
+            tune->gains[1] = tune->gains[0] / (2.2f * period);
+            tune->gains[2] = 0.0f;
+            break;
+        }
+        case PID_AUTOTUNE_RULE_ZN_PI:
+        default:
+        {
+            tune->gains[0] = 0.45f * tune->ultimate_gain;
+            tune->gains[1] = tune->gains[0] / (period / 1.2f);
+            tune->gains[2] = 0.0f;
+            break;
+        }
+    }
+    tune->state = PID_AUTOTUNE_DONE;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file       pid_autotune.c/h
+ * @brief      Relay feedback auto-tuner for single loop PID controllers (Astrom-Hagglund method)
+ * @arthur     MacFalcons Control Team
+ * The relay drives the loop with out = bias +- relay_amplitude around a fixed set point, which makes the
+ * loop oscillate at its ultimate period Tu. Ultimate gain is Ku = 4 * d / (PI * sqrt(a^2 - eps^2)), with d
+ * the relay amplitude, a the oscillation amplitude of the feedback and eps the relay hysteresis.
+ * Bias is adapted until high and low half periods are equal, so loops with load (gravity, friction) work too.
+ * Output gains follow the convention of PID_calc: Ki and Kd are continuous time gains, dt is applied by PID_calc.
+ */
+#ifndef PID_AUTOTUNE_H
+#define PID_AUTOTUNE_H
+#include "global_inc.h"
+
+typedef enum
+{
+    PID_AUTOTUNE_RULE_ZN_PI = 0,  // Ziegler-Nichols PI
+    PID_AUTOTUNE_RULE_ZN_PID,     // Ziegler-Nichols PID
+    PID_AUTOTUNE_RULE_TL_PI,      // Tyreus-Luyben PI, less overshoot, for inner loops of a cascade
+} pid_autotune_rule_e;
+
+typedef enum
+{
+    PID_AUTOTUNE_IDLE = 0,
+    PID_AUTOTUNE_RUNNING,
+    PID_AUTOTUNE_DONE,
+    PID_AUTOTUNE_FAILED,
+} pid_autotune_state_e;
+
+typedef struct
+{
+    // config
+    fp32 relay_amplitude;           // d, unit of controller output
+    fp32 hysteresis;                // eps, unit of feedback
+    fp32 max_out;                   // limit of bias and output
+    fp32 max_error;                 // abort when |set - fdb| exceeds this
+    fp32 dt;                        // s
+    uint8_t rule;                   // pid_autotune_rule_e
+    uint32_t timeout_samples;
+    uint32_t switch_timeout_samples;// relay never switches in this time: bias is shifted toward the set point
+
+    // state
+    uint8_t state;                  // pid_autotune_state_e
+    int8_t relay_dir;               // 1: high, -1: low, 0: not decided yet
+    uint8_t fCycleStarted;
+    uint8_t cycle_count;
+    uint8_t measured_cycles;
+    fp32 bias;
+    fp32 out;
+    uint32_t sample;
+    uint32_t samples_since_switch;
+    uint32_t high_samples;
+    uint32_t low_samples;
+    fp32 fdb_max;
+    fp32 fdb_min;
+    fp32 period_sum;                // unit sample
+    fp32 amplitude_sum;
+
+    // result
+    fp32 ultimate_gain;             // Ku
+    fp32 ultimate_period;           // Tu, s
+    fp32 gains[3];                  // 0: kp, 1: ki, 2: kd
+} pid_autotune_t;
+
+/**
+  * @brief          auto-tuner config init, state set to idle
+  * @param[out]     tune: auto-tuner struct point
+  * @param[in]      relay_amplitude: relay output amplitude d
+  * @param[in]      hysteresis: relay hysteresis on error, a bit above the feedback noise
+  * @param[in]      max_out: limit of output
+  * @param[in]      max_error: abort tuning when |set - fdb| exceeds this
+  * @param[in]      rule: pid_autotune_rule_e
+  * @param[in]      timeout: unit s
+  * @param[in]      dt: call period, unit s
+  * @retval         none
+  */
+extern void PID_autotune_init(pid_autotune_t *tune, fp32 relay_amplitude, fp32 hysteresis, fp32 max_out, fp32 max_error, uint8_t rule, fp32 timeout, fp32 dt);
+
+/**
+  * @brief          start relay oscillation
+  * @param[out]     tune: auto-tuner struct point
+  * @param[in]      bias: initial output offset, e.g. output needed to hold the set point
+  * @retval         none
+  */
+extern void PID_autotune_start(pid_autotune_t *tune, fp32 bias);
+
+/**
+  * @brief          auto-tuner calculate, call once per control period while running
+  * @param[out]     tune: auto-tuner struct point
+  * @param[in]      ref: feedback data
+  * @param[in]      set: set point
+  * @retval         relay output, 0 once stopped
+  */
+extern fp32 PID_autotune_calc(pid_autotune_t *tune, fp32 ref, fp32 set);
+
+/**
+  * @brief          stop tuning and go back to idle
+  * @param[out]     tune: auto-tuner struct point
+  * @retval         none
+  */
+extern void PID_autotune_clear(pid_autotune_t *tune);
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file       trajectory_generator.c/h
+ * @brief      Time-optimal set-point trajectory generator with bounded speed and acceleration
+ * @arthur     MacFalcons Control Team
+ */
+#include "trajectory_generator.h"
+#include "user_lib.h"
+#include "math.h"
+
+void TRAJ_init(trajectory_generator_t *traj, fp32 max_speed, fp32 max_accel, fp32 dt)
+{
+    if (traj == NULL)
+    {
+        return;
+    }
+    traj->max_speed = max_speed;
+    traj->max_accel = max_accel;
+    traj->dt = dt;
+    TRAJ_reset(traj, 0.0f, 0.0f);
+}
+
+void TRAJ_reset(trajectory_generator_t *traj, fp32 position, fp32 speed)
+{
+    if (traj == NULL)
+    {
+        return;
+    }
+    traj->target = position;
+    traj->target_speed = 0.0f;
+    traj->position = position;
+    traj->speed = speed;
+    traj->accel = 0.0f;
+}
+
+fp32 TRAJ_calc(trajectory_generator_t *traj, fp32 target)
+{
+    if (traj == NULL)
+    {
+        return 0.0f;
+    }
+
+    // a request moving faster than the reference may go is a jump, not a motion to follow
+    fp32 target_speed = rad_format(target - traj->target) / traj->dt;
+    if (fabsf(target_speed) > traj->max_speed)
+    {
+        target_speed = 0.0f;
+    }
+    traj->target = target;
+    traj->target_speed = target_speed;
+
+    // planned relative to the target, which is expected to keep its speed: the reference lags it by one sample of that
+    // speed before this step, and the distance left is what the reference must gain on it
+    fp32 speed_step = traj->max_accel * traj->dt;
+    fp32 distance = rad_format(target - traj->position) - target_speed * traj->dt;
+    fp32 relative_speed_set;
+    if ((fabsf(distance / traj->dt - (traj->speed - target_speed)) <= speed_step) && (fabsf(distance) / traj->dt <= speed_step))
+    {
+        // lands on the target this sample and can match its speed on the next
+        relative_speed_set = distance / traj->dt;
+    }
+    else
+    {
+        // fastest speed that can still brake to the target: n * speed_step covers n * (n + 1) / 2 * speed_step * dt
+        fp32 n = sqrtf(0.25f + 2.0f * fabsf(distance) / (speed_step * traj->dt)) - 0.5f;
+        relative_speed_set = (distance > 0.0f) ? (n * speed_step) : (-n * speed_step);
+    }
+    fp32 speed_set = fp32_constrain(target_speed + relative_speed_set, -traj->max_speed, traj->max_speed);
+    fp32 speed_change = fp32_constrain(speed_set - traj->speed, -speed_step, speed_step);
+    traj->speed += speed_change;
+    traj->accel = speed_change / traj->dt;
+    fp32 relative_speed = traj->speed - target_speed;
+    if ((fabsf(relative_speed * traj->dt) >= fabsf(distance)) && (relative_speed * distance > 0.0f) && (fabsf(relative_speed) <= 2.0f * speed_step))
+    {
+        // last period of a move, land on target instead of passing it by a fraction of a period
+        traj->position = target;
+    }
+    else
+    {
+        traj->position = rad_format(traj->position + traj->speed * traj->dt);
+    }
+    return traj->position;
+}
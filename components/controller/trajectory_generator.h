@@ -0,0 +1,59 @@
+/**
+ * @file       trajectory_generator.c/h
+ * @brief      Time-optimal set-point trajectory generator with bounded speed and acceleration
+ * @arthur     MacFalcons Control Team
+ * The generator moves its own reference towards the requested angle as fast as the speed and acceleration limits allow,
+ * and hands the reference with its speed and acceleration to the cascade as feedforward, so a large jump of the request
+ * becomes a bang-coast-bang profile instead of a step the loops saturate and overshoot on. The plan is redone every cycle from the state of the reference, so the
+ * request may change at any time, and a request that moves slower than the speed limit (joystick, mouse, CV tracking)
+ * is treated as a moving target and followed without lag.
+ * Braking is planned on the sampled motion like s_curve_ramp_calc in user_lib, one order down: at a speed of n steps of
+ * max_accel * dt, stopping covers max_accel * dt^2 * n * (n + 1) / 2, so the speed towards a target d away is
+ * n * max_accel * dt with n solved from that, and the last step lands exactly on the target.
+ * Angles are wrapped to [-PI, PI], the reference takes the short way round.
+ */
+#ifndef TRAJECTORY_GENERATOR_H
+#define TRAJECTORY_GENERATOR_H
+#include "global_inc.h"
+
+typedef struct
+{
+    fp32 max_speed;     // rad/s
+    fp32 max_accel;     // rad/s^2
+    fp32 dt;            // sample time, unit s
+
+    fp32 target;        // rad, latest request
+    fp32 target_speed;  // rad/s, speed of the request, 0 after a jump
+    fp32 position;      // rad, output: reference for the position loop
+    fp32 speed;         // rad/s, output: speed feedforward for the speed loop
+    fp32 accel;         // rad/s^2, output: acceleration feedforward for the motor command
+} trajectory_generator_t;
+
+/**
+  * @brief          trajectory generator init, the reference starts at rest at 0
+  * @param[out]     traj: trajectory generator struct point
+  * @param[in]      max_speed: speed limit of the reference, unit rad/s
+  * @param[in]      max_accel: acceleration limit of the reference, unit rad/s^2
+  * @param[in]      dt: sample time, unit s
+  * @retval         none
+  */
+extern void TRAJ_init(trajectory_generator_t *traj, fp32 max_speed, fp32 max_accel, fp32 dt);
+
+/**
+  * @brief          restart the reference from the measured state, and take the position as the request
+  * @param[out]     traj: trajectory generator struct point
+  * @param[in]      position: unit rad
+  * @param[in]      speed: unit rad/s
+  * @retval         none
+  */
+extern void TRAJ_reset(trajectory_generator_t *traj, fp32 position, fp32 speed);
+
+/**
+  * @brief          move the reference one sample towards the request, should be called once per control cycle
+  * @param[out]     traj: trajectory generator struct point
+  * @param[in]      target: requested angle, unit rad
+  * @retval         reference angle, unit rad; its speed and acceleration are in traj->speed and traj->accel
+  */
+extern fp32 TRAJ_calc(trajectory_generator_t *traj, fp32 target);
+
+#endif